@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+#include <bitset>
+#include <optional>
 #include <vector>
 
 #include "revng/ABI/FunctionType/Support.h"
@@ -12,6 +15,7 @@
 #include "revng/Model/ABI.h"
 #include "revng/Model/RawFunctionDefinition.h"
 #include "revng/Model/Register.h"
+#include "revng/Model/TypeLayoutCache.h"
 #include "revng/Support/Debug.h"
 #include "revng/TupleTree/TupleTree.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
@@ -310,12 +314,41 @@ TUPLE-TREE-YAML */
 namespace abi {
 
 class Definition : public generated::Definition {
+private:
+  /// Scalars at most this big have their alignment in `LookupTables`
+  static constexpr uint64_t MaximumTabulatedScalarSize = 32;
+
+  using RegisterMask = std::bitset<model::Register::Count>;
+  using AlignmentTable = std::array<uint64_t, MaximumTabulatedScalarSize + 1>;
+
+  /// Flat copies of the register lists and of the scalar types, for the
+  /// queries in the hot paths of the ABI detection and of the conversions.
+  struct LookupTables {
+    RegisterMask ArgumentRegisters;
+    RegisterMask ReturnValueRegisters;
+    RegisterMask CalleeSavedRegisters;
+
+    /// Indexed by size, 0 means there is no scalar of that size
+    AlignmentTable ScalarAlignments = {};
+    AlignmentTable FloatingPointScalarAlignments = {};
+  };
+
+  std::optional<LookupTables> Tables;
+
 public:
   using generated::Definition::Definition;
 
 public:
   static const Definition &get(model::ABI::Values ABI);
 
+  /// Precompute the lookup tables backing the `is*Register` and `*Alignment`
+  /// queries.
+  ///
+  /// The definitions returned by `get` already have them: only call this on
+  /// definitions built by hand, once they are complete. Without the tables,
+  /// the queries fall back on a search of the lists.
+  void buildLookupTables();
+
 public:
   std::string_view getName() const { return model::ABI::getName(ABI()); }
   uint64_t getPointerSize() const { return model::ABI::getPointerSize(ABI()); }
@@ -339,12 +372,8 @@ public:
   bool
   isPreliminarilyCompatibleWith(const model::RawFunctionDefinition &RFT) const;
 
-  struct AlignmentInfo {
-    uint64_t Value;
-    bool IsNatural;
-  };
-  using AlignmentCache = std::unordered_map<const model::TypeDefinition *,
-                                            AlignmentInfo>;
+  using AlignmentInfo = model::TypeLayoutCache::AlignmentInfo;
+  using AlignmentCache = model::TypeLayoutCache::AlignmentCache;
 
   /// Compute the natural alignment of the type in accordance with
   /// the current ABI
@@ -361,12 +390,18 @@ public:
   /// \return either an alignment or a `std::nullopt` when it's not applicable.
   template<model::AnyType AnyType>
   std::optional<uint64_t> alignment(const AnyType &Type) const {
+    if (auto *Scope = model::TypeLayoutCache::current())
+      return alignment(Type, Scope->alignments(ABI()));
+
     AlignmentCache Cache;
     return alignment(Type, Cache);
   }
 
   template<model::AnyType AnyType>
   std::optional<bool> hasNaturalAlignment(const AnyType &Type) const {
+    if (auto *Scope = model::TypeLayoutCache::current())
+      return hasNaturalAlignment(Type, Scope->alignments(ABI()));
+
     AlignmentCache Cache;
     return hasNaturalAlignment(Type, Cache);
   }
@@ -397,6 +432,63 @@ public:
     return alignedOffset(Offset, *alignment(Type));
   }
 
+public:
+  bool isArgumentRegister(model::Register::Values Register) const {
+    if (Tables)
+      return Tables->ArgumentRegisters.test(Register);
+
+    return llvm::is_contained(GeneralPurposeArgumentRegisters(), Register)
+           or llvm::is_contained(VectorArgumentRegisters(), Register);
+  }
+
+  bool isReturnValueRegister(model::Register::Values Register) const {
+    if (Tables)
+      return Tables->ReturnValueRegisters.test(Register);
+
+    return llvm::is_contained(GeneralPurposeReturnValueRegisters(), Register)
+           or llvm::is_contained(VectorReturnValueRegisters(), Register);
+  }
+
+  bool isCalleeSavedRegister(model::Register::Values Register) const {
+    if (Tables)
+      return Tables->CalleeSavedRegisters.test(Register);
+
+    return llvm::is_contained(CalleeSavedRegisters(), Register);
+  }
+
+  /// 
+eturn the alignment of the scalar type of \p Size bytes, or
+  ///         `std::nullopt` if the ABI has no such scalar type.
+  std::optional<uint64_t> scalarAlignment(uint64_t Size) const {
+    return alignmentOf(ScalarTypes(), &LookupTables::ScalarAlignments, Size);
+  }
+
+  /// 
+eturn the alignment of the floating point type of \p Size bytes, or
+  ///         `std::nullopt` if the ABI has no such type.
+  std::optional<uint64_t> floatingPointScalarAlignment(uint64_t Size) const {
+    return alignmentOf(FloatingPointScalarTypes(),
+                       &LookupTables::FloatingPointScalarAlignments,
+                       Size);
+  }
+
+private:
+  std::optional<uint64_t> alignmentOf(const SortedVector<ScalarType> &Types,
+                                      AlignmentTable LookupTables::*Table,
+                                      uint64_t Size) const {
+    if (Tables and Size <= MaximumTabulatedScalarSize) {
+      uint64_t Result = ((*Tables).*Table)[Size];
+      if (Result == 0)
+        return std::nullopt;
+      return Result;
+    }
+
+    auto Iterator = Types.find(Size);
+    if (Iterator == Types.end())
+      return std::nullopt;
+    return Iterator->alignedAt();
+  }
+
 public:
   using RegisterSet = std::set<model::Register::Values>;
 
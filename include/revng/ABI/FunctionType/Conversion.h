@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "revng/ABI/FunctionType/Support.h"
 #include "revng/Model/Binary.h"
 
 namespace abi::FunctionType {
@@ -21,4 +22,16 @@ tryConvertToCABI(const model::RawFunctionDefinition &Function,
                  std::optional<model::ABI::Values> ABI = std::nullopt,
                  bool UseSoftRegisterStateDeductions = true);
 
+/// Like the overload above, but leaves \p Function, and the references to it,
+/// in place: the replacement is recorded into \p Replacements instead.
+///
+/// Use this when converting many functions, then apply all the replacements
+/// together with `applyTypeReplacements`.
+std::optional<model::UpcastableType>
+tryConvertToCABI(const model::RawFunctionDefinition &Function,
+                 TupleTree<model::Binary> &Binary,
+                 TypeReplacements &Replacements,
+                 std::optional<model::ABI::Values> ABI = std::nullopt,
+                 bool UseSoftRegisterStateDeductions = true);
+
 } // namespace abi::FunctionType
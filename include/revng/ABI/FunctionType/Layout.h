@@ -7,6 +7,7 @@
 #include "llvm/ADT/STLExtras.h"
 
 #include "revng/ABI/Definition.h"
+#include "revng/ABI/FunctionType/Support.h"
 #include "revng/Model/Binary.h"
 
 namespace abi::FunctionType {
@@ -19,6 +20,16 @@ model::UpcastableType
 convertToRaw(const model::CABIFunctionDefinition &Prototype,
              TupleTree<model::Binary> &TheBinary);
 
+/// Like the overload above, but leaves \p Prototype, and the references to it,
+/// in place: the replacement is recorded into \p Replacements instead.
+///
+/// Use this when converting many functions, then apply all the replacements
+/// together with `applyTypeReplacements`.
+model::UpcastableType
+convertToRaw(const model::CABIFunctionDefinition &Prototype,
+             TupleTree<model::Binary> &TheBinary,
+             TypeReplacements &Replacements);
+
 namespace ArgumentKind {
 
 enum Values {
@@ -0,0 +1,93 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+
+#include "revng/ABI/FunctionType/Layout.h"
+
+namespace abi::FunctionType {
+
+/// Memoizes `Layout`, `usedRegisters` and `finalStackOffset` of the prototypes
+/// of a model, keyed by prototype definition.
+///
+/// The model must not change while the cache is in use, call `clear` if it
+/// does. Lookups can be performed from multiple threads.
+///
+/// \note the model is only read the first time a result is computed. If reads
+///       of the model are being tracked (see `revng::Tracking`), don't share a
+///       cache across tracking scopes: clear it each time a new one is pushed,
+///       otherwise the scopes hitting the cache will miss the dependencies on
+///       the prototype.
+class LayoutCache {
+private:
+  using Key = model::TypeDefinition::Key;
+
+private:
+  mutable std::shared_mutex Mutex;
+  std::map<Key, std::shared_ptr<const Layout>> Layouts;
+  std::map<Key, UsedRegisters> Registers;
+  std::map<Key, uint64_t> FinalStackOffsets;
+
+public:
+  LayoutCache() = default;
+  LayoutCache(const LayoutCache &) = delete;
+  LayoutCache &operator=(const LayoutCache &) = delete;
+
+public:
+  std::shared_ptr<const Layout> layout(const model::TypeDefinition &Prototype) {
+    auto Compute = [](const model::TypeDefinition &P) {
+      return std::make_shared<const Layout>(Layout::make(P));
+    };
+    return get(Layouts, Prototype, Compute);
+  }
+
+  UsedRegisters usedRegisters(const model::TypeDefinition &Prototype) {
+    auto Compute = [](const model::TypeDefinition &P) {
+      return FunctionType::usedRegisters(P);
+    };
+    return get(Registers, Prototype, Compute);
+  }
+
+  uint64_t finalStackOffset(const model::TypeDefinition &Prototype) {
+    auto Compute = [](const model::TypeDefinition &P) {
+      return FunctionType::finalStackOffset(P);
+    };
+    return get(FinalStackOffsets, Prototype, Compute);
+  }
+
+  void clear() {
+    std::unique_lock Lock(Mutex);
+    Layouts.clear();
+    Registers.clear();
+    FinalStackOffsets.clear();
+  }
+
+private:
+  template<typename T, typename F>
+  T get(std::map<Key, T> &Map,
+        const model::TypeDefinition &Prototype,
+        const F &Compute) {
+    Key TheKey = Prototype.key();
+    {
+      std::shared_lock Lock(Mutex);
+      auto It = Map.find(TheKey);
+      if (It != Map.end())
+        return It->second;
+    }
+
+    // Compute without holding the lock: if another thread got here first, the
+    // result is the same anyway
+    T Result = Compute(Prototype);
+    std::unique_lock Lock(Mutex);
+    return Map.try_emplace(TheKey, std::move(Result)).first->second;
+  }
+};
+
+} // namespace abi::FunctionType
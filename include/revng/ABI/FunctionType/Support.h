@@ -5,6 +5,8 @@
 //
 
 #include <concepts>
+#include <map>
+#include <ranges>
 
 #include "llvm/Support/MathExtras.h"
 
@@ -42,6 +44,35 @@ inline void replaceTypeDefinition(const model::TypeDefinition::Key &O,
   return replaceTypeDefinition(O, llvm::cast<model::DefinedType>(N), B);
 }
 
+/// The type definitions to replace, and their replacements
+using TypeReplacements = std::map<model::TypeDefinition::Key,
+                                  model::DefinitionReference>;
+
+/// Replace all the references to each of the type definitions in
+/// \p Replacements with the corresponding new type, and erase the old type
+/// definitions.
+///
+/// Unlike calling `replaceTypeDefinition` for each of them, this visits the
+/// model only once.
+inline void applyTypeReplacements(const TypeReplacements &Replacements,
+                                  TupleTree<model::Binary> &Binary) {
+  if (Replacements.empty())
+    return;
+
+  Binary.visitReferences([&Replacements](model::DefinitionReference &Path) {
+    if (Path.empty())
+      return;
+
+    auto It = Replacements.find(Path.getConst()->key());
+    if (It != Replacements.end())
+      Path = It->second;
+  });
+  Binary.evictCachedReferences();
+
+  for (const auto &Old : Replacements | std::views::keys)
+    Binary->TypeDefinitions().erase(Old);
+}
+
 /// Takes care of extending (padding) the size of a stack argument.
 ///
 /// \note This only accounts for the post-padding (extension).
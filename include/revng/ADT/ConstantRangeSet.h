@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/ConstantRange.h"
 
@@ -101,6 +103,10 @@ public:
 /// It is implemented as a vector of llvm::APInt. Each one of them represents a
 /// flip in the status of the range (`ON -> OFF` or `OFF -> ON`), starting from
 /// the initial state `OFF`.
+///
+/// The bounds are sorted: set operations are linear merges of the bounds of
+/// the operands, and testing whether a value belongs to the set is a binary
+/// search.
 class ConstantRangeSet {
 private:
   APIntVector Bounds;
@@ -133,16 +139,70 @@ public:
   }
 
 public:
-  ConstantRangeSet unionWith(const ConstantRangeSet &Other) const {
+  ConstantRangeSet unionWith(const ConstantRangeSet &Other) const & {
     return merge<false>(Other);
   }
 
-  ConstantRangeSet intersectWith(const ConstantRangeSet &Other) const {
+  ConstantRangeSet unionWith(const ConstantRangeSet &Other) && {
+    *this |= Other;
+    return std::move(*this);
+  }
+
+  ConstantRangeSet intersectWith(const ConstantRangeSet &Other) const & {
     return merge<true>(Other);
   }
 
+  ConstantRangeSet intersectWith(const ConstantRangeSet &Other) && {
+    *this &= Other;
+    return std::move(*this);
+  }
+
+  ConstantRangeSet &operator|=(const ConstantRangeSet &Other) {
+    checkWidth(Other);
+    if (Other.isEmptySet() or isFullSet())
+      setResultWidth(Other);
+    else if (isEmptySet())
+      *this = Other;
+    else
+      *this = merge<false>(Other);
+    return *this;
+  }
+
+  ConstantRangeSet &operator&=(const ConstantRangeSet &Other) {
+    checkWidth(Other);
+    if (isEmptySet() or Other.isFullSet()) {
+      setResultWidth(Other);
+    } else if (Other.isEmptySet()) {
+      setResultWidth(Other);
+      Bounds.clear();
+    } else if (isFullSet()) {
+      *this = Other;
+    } else {
+      *this = merge<true>(Other);
+    }
+    return *this;
+  }
+
   bool contains(const ConstantRangeSet &Other) const {
-    return intersectWith(Other) == Other;
+    checkWidth(Other);
+
+    // Other is contained if, between any two consecutive bounds, it's never
+    // active when this is not
+    return walk(Bounds,
+                Other.Bounds,
+                [](const llvm::APInt &, bool ThisActive, bool OtherActive) {
+                  return ThisActive or not OtherActive;
+                });
+  }
+
+  bool contains(const llvm::APInt &Value) const {
+    auto ULT = [](const llvm::APInt &LHS, const llvm::APInt &RHS) {
+      return LHS.ult(RHS);
+    };
+
+    // Value is in the set if an odd number of bounds is not greater than it
+    auto It = std::upper_bound(Bounds.begin(), Bounds.end(), Value, ULT);
+    return (It - Bounds.begin()) % 2 == 1;
   }
 
   bool operator==(const ConstantRangeSet &Other) const {
@@ -274,47 +334,74 @@ public:
   }
 
 private:
-  template<bool And>
-  ConstantRangeSet merge(const ConstantRangeSet &Other) const {
-    using namespace llvm;
-
-    auto ResultBitWidth = std::max(BitWidth, Other.BitWidth);
-    ConstantRangeSet Result(ResultBitWidth, false);
+  void checkWidth(const ConstantRangeSet &Other) const {
     revng_assert(BitWidth == 0 or Other.BitWidth == 0
                  or BitWidth == Other.BitWidth);
+  }
 
-    bool LastOutput = false;
+  void setResultWidth(const ConstantRangeSet &Other) {
+    BitWidth = std::max(BitWidth, Other.BitWidth);
+  }
+
+  /// Visit, in order, the distinct values of \p Left and \p Right, invoking
+  /// \p Visitor with each of them and whether each side is active starting
+  /// from it
+  ///
+  /// \return false if \p Visitor returned false, ending the visit early
+  template<typename F>
+  static bool
+  walk(const APIntVector &Left, const APIntVector &Right, F &&Visitor) {
     bool LeftActive = false;
     bool RightActive = false;
-    auto ZipAPIntVector = zipmap_range<const APIntVector,
-                                       const APIntVector,
-                                       APIntVectorKeyContainer>;
-    for (auto &P : ZipAPIntVector(Bounds, Other.Bounds)) {
-      const llvm::APInt *Left = P.first;
-      const llvm::APInt *Right = P.second;
-
-      if (Left != nullptr) {
-        revng_assert(Left->getBitWidth() == ResultBitWidth);
+    auto LeftIt = Left.begin();
+    auto RightIt = Right.begin();
+    while (LeftIt != Left.end() or RightIt != Right.end()) {
+      const llvm::APInt *Value = nullptr;
+      bool TakeLeft = RightIt == Right.end()
+                      or (LeftIt != Left.end() and not RightIt->ult(*LeftIt));
+      bool TakeRight = LeftIt == Left.end()
+                       or (RightIt != Right.end()
+                           and not LeftIt->ult(*RightIt));
+
+      if (TakeLeft) {
+        Value = &*LeftIt;
         LeftActive = not LeftActive;
+        ++LeftIt;
       }
 
-      if (Right != nullptr) {
-        revng_assert(Right->getBitWidth() == ResultBitWidth);
+      if (TakeRight) {
+        Value = &*RightIt;
         RightActive = not RightActive;
+        ++RightIt;
       }
 
-      const llvm::APInt *Value = P.first == nullptr ? P.second : P.first;
-      revng_assert(Value != nullptr);
+      if (not Visitor(*Value, LeftActive, RightActive))
+        return false;
+    }
 
+    return true;
+  }
+
+  template<bool And>
+  ConstantRangeSet merge(const ConstantRangeSet &Other) const {
+    checkWidth(Other);
+    ConstantRangeSet Result(std::max(BitWidth, Other.BitWidth), false);
+    Result.Bounds.reserve(Bounds.size() + Other.Bounds.size());
+
+    bool LastOutput = false;
+    auto Merge = [&](const llvm::APInt &Value,
+                     bool LeftActive,
+                     bool RightActive) {
       bool NewOutput = And ? (LeftActive and RightActive) :
                              (LeftActive or RightActive);
 
-      if (NewOutput != LastOutput) {
-        Result.Bounds.push_back(*Value);
-      }
+      if (NewOutput != LastOutput)
+        Result.Bounds.push_back(Value);
 
       LastOutput = NewOutput;
-    }
+      return true;
+    };
+    walk(Bounds, Other.Bounds, Merge);
 
     return Result;
   }
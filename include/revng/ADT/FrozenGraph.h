@@ -0,0 +1,281 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/GraphTraits.h"
+#include "llvm/ADT/iterator.h"
+
+#include "revng/ADT/GenericGraph.h"
+#include "revng/Support/Assert.h"
+
+template<typename OriginalNodeRef>
+class FrozenGraph;
+
+/// A node of a `FrozenGraph`
+template<typename OriginalNodeRef>
+class FrozenNode {
+private:
+  friend class FrozenGraph<OriginalNodeRef>;
+
+private:
+  FrozenGraph<OriginalNodeRef> *Parent = nullptr;
+  OriginalNodeRef Original;
+  FrozenNode *const *Successors = nullptr;
+  FrozenNode *const *Predecessors = nullptr;
+  uint32_t SuccessorCount = 0;
+  uint32_t PredecessorCount = 0;
+  uint32_t Index = 0;
+
+public:
+  FrozenGraph<OriginalNodeRef> *getParent() const { return Parent; }
+
+  /// \return the node of the original graph this node was created from
+  OriginalNodeRef original() const { return Original; }
+
+  /// \return the position of this node in the graph, between 0 and the size
+  ///         of the graph
+  uint32_t index() const { return Index; }
+
+public:
+  llvm::ArrayRef<FrozenNode *> successors() const {
+    return llvm::ArrayRef(Successors, SuccessorCount);
+  }
+  llvm::ArrayRef<FrozenNode *> predecessors() const {
+    return llvm::ArrayRef(Predecessors, PredecessorCount);
+  }
+
+  size_t successorCount() const { return SuccessorCount; }
+  size_t predecessorCount() const { return PredecessorCount; }
+};
+
+/// An immutable snapshot of a graph, in compressed sparse row form.
+///
+/// The nodes get dense indexes, in the order `llvm::nodes` visits them, and
+/// the successors (and the predecessors) of all of them are stored back to
+/// back in a single array. Algorithms that only traverse a finished graph
+/// will not chase pointers through the containers of each node.
+///
+/// The snapshot implements `llvm::GraphTraits`, with `llvm::Inverse` too, so
+/// that existing algorithms (post order visits, dominator trees, SCCs...) run
+/// on it unchanged. Each node refers back to the node of the original graph
+/// it has been created from (see `FrozenNode::original`).
+///
+/// \note the snapshot does not track changes to the original graph.
+///
+/// \note since the nodes point to the graph, it cannot be copied or moved.
+///       `freeze` returns it by value all the same, thanks to guaranteed copy
+///       elision.
+template<typename OriginalNodeRef>
+class FrozenGraph {
+public:
+  using Node = FrozenNode<OriginalNodeRef>;
+
+private:
+  std::vector<Node> Nodes;
+  std::vector<Node *> Successors;
+  std::vector<Node *> Predecessors;
+  llvm::DenseMap<OriginalNodeRef, uint32_t> Indexes;
+  Node *EntryNode = nullptr;
+
+public:
+  /// Snapshot \p Graph, which has to provide `llvm::GraphTraits`, including
+  /// `nodes_begin` and `nodes_end`
+  template<typename GraphType>
+  explicit FrozenGraph(GraphType Graph) {
+    using GT = llvm::GraphTraits<GraphType>;
+    static_assert(std::is_same_v<typename GT::NodeRef, OriginalNodeRef>);
+
+    for (OriginalNodeRef Original : llvm::nodes(Graph)) {
+      bool New = Indexes.try_emplace(Original, Nodes.size()).second;
+      revng_assert(New);
+      Node &Result = Nodes.emplace_back();
+      Result.Parent = this;
+      Result.Original = Original;
+      Result.Index = Nodes.size() - 1;
+    }
+
+    // Count the edges, so that successors and predecessors can be laid out
+    // without moving them afterwards
+    std::vector<uint32_t> SuccessorOffsets(Nodes.size() + 1, 0);
+    std::vector<uint32_t> PredecessorOffsets(Nodes.size() + 1, 0);
+    for (Node &From : Nodes) {
+      for (OriginalNodeRef To : llvm::children<GraphType>(From.Original)) {
+        ++SuccessorOffsets[From.Index + 1];
+        ++PredecessorOffsets[indexOf(To) + 1];
+      }
+    }
+
+    for (size_t I = 1; I < SuccessorOffsets.size(); ++I) {
+      SuccessorOffsets[I] += SuccessorOffsets[I - 1];
+      PredecessorOffsets[I] += PredecessorOffsets[I - 1];
+    }
+
+    Successors.resize(SuccessorOffsets.back());
+    Predecessors.resize(PredecessorOffsets.back());
+    std::vector<uint32_t> NextPredecessor(PredecessorOffsets.begin(),
+                                          PredecessorOffsets.end() - 1);
+    for (Node &From : Nodes) {
+      uint32_t NextSuccessor = SuccessorOffsets[From.Index];
+      for (OriginalNodeRef To : llvm::children<GraphType>(From.Original)) {
+        Node &Successor = Nodes[indexOf(To)];
+        Successors[NextSuccessor++] = &Successor;
+        Predecessors[NextPredecessor[Successor.Index]++] = &From;
+      }
+    }
+
+    for (Node &N : Nodes) {
+      uint32_t I = N.Index;
+      N.Successors = Successors.data() + SuccessorOffsets[I];
+      N.SuccessorCount = SuccessorOffsets[I + 1] - SuccessorOffsets[I];
+      N.Predecessors = Predecessors.data() + PredecessorOffsets[I];
+      N.PredecessorCount = PredecessorOffsets[I + 1] - PredecessorOffsets[I];
+    }
+
+    using RawGraph = std::remove_cvref_t<std::remove_pointer_t<GraphType>>;
+    if constexpr (SpecializationOfGenericGraph<RawGraph>) {
+      // Not all GenericGraphs have an entry node
+      if constexpr (RawGraph::hasEntryNode)
+        if (OriginalNodeRef Entry = GT::getEntryNode(Graph))
+          EntryNode = &Nodes[indexOf(Entry)];
+    } else {
+      EntryNode = &Nodes[indexOf(GT::getEntryNode(Graph))];
+    }
+  }
+
+  FrozenGraph(const FrozenGraph &) = delete;
+  FrozenGraph(FrozenGraph &&) = delete;
+  FrozenGraph &operator=(const FrozenGraph &) = delete;
+  FrozenGraph &operator=(FrozenGraph &&) = delete;
+
+public:
+  Node *getEntryNode() const { return EntryNode; }
+
+  size_t size() const { return Nodes.size(); }
+
+  Node *at(uint32_t Index) { return &Nodes.at(Index); }
+  const Node *at(uint32_t Index) const { return &Nodes.at(Index); }
+
+  /// \return the node created from \p Original, or nullptr if \p Original
+  ///         was not part of the graph
+  Node *find(OriginalNodeRef Original) {
+    auto It = Indexes.find(Original);
+    return It == Indexes.end() ? nullptr : &Nodes[It->second];
+  }
+
+public:
+  using nodes_iterator = llvm::pointer_iterator<
+    typename std::vector<Node>::iterator>;
+
+  llvm::iterator_range<nodes_iterator> nodes() {
+    return llvm::make_range(nodes_iterator(Nodes.begin()),
+                            nodes_iterator(Nodes.end()));
+  }
+
+private:
+  uint32_t indexOf(OriginalNodeRef Original) const {
+    auto It = Indexes.find(Original);
+    revng_assert(It != Indexes.end(), "Edge to a node outside of the graph");
+    return It->second;
+  }
+};
+
+/// Snapshot \p Graph, see `FrozenGraph`
+template<typename GraphType>
+FrozenGraph<typename llvm::GraphTraits<GraphType>::NodeRef>
+freeze(GraphType Graph) {
+  using NodeRef = typename llvm::GraphTraits<GraphType>::NodeRef;
+  return FrozenGraph<NodeRef>(Graph);
+}
+
+//
+// GraphTraits implementation for FrozenGraph
+//
+namespace llvm {
+
+/// Specializes GraphTraits<FrozenNode<...> *>
+template<typename OriginalNodeRef>
+struct GraphTraits<FrozenNode<OriginalNodeRef> *> {
+public:
+  using NodeRef = FrozenNode<OriginalNodeRef> *;
+  using ChildIteratorType = NodeRef const *;
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->successors().begin();
+  }
+  static ChildIteratorType child_end(NodeRef N) {
+    return N->successors().end();
+  }
+
+  static NodeRef getEntryNode(NodeRef N) { return N; }
+};
+
+/// Specializes GraphTraits<llvm::Inverse<FrozenNode<...> *>>
+template<typename OriginalNodeRef>
+struct GraphTraits<llvm::Inverse<FrozenNode<OriginalNodeRef> *>> {
+public:
+  using NodeRef = FrozenNode<OriginalNodeRef> *;
+  using ChildIteratorType = NodeRef const *;
+
+public:
+  static ChildIteratorType child_begin(NodeRef N) {
+    return N->predecessors().begin();
+  }
+  static ChildIteratorType child_end(NodeRef N) {
+    return N->predecessors().end();
+  }
+
+  static NodeRef getEntryNode(llvm::Inverse<NodeRef> N) { return N.Graph; }
+};
+
+/// Specializes GraphTraits<FrozenGraph<...> *>
+template<typename OriginalNodeRef>
+struct GraphTraits<FrozenGraph<OriginalNodeRef> *>
+  : public GraphTraits<FrozenNode<OriginalNodeRef> *> {
+  using GraphType = FrozenGraph<OriginalNodeRef>;
+  using NodeRef = FrozenNode<OriginalNodeRef> *;
+  using nodes_iterator = typename GraphType::nodes_iterator;
+
+  static NodeRef getEntryNode(GraphType *G) { return G->getEntryNode(); }
+
+  static nodes_iterator nodes_begin(GraphType *G) {
+    return G->nodes().begin();
+  }
+  static nodes_iterator nodes_end(GraphType *G) { return G->nodes().end(); }
+
+  static size_t size(GraphType *G) { return G->size(); }
+};
+
+/// Specializes GraphTraits<llvm::Inverse<FrozenGraph<...> *>>
+template<typename OriginalNodeRef>
+struct GraphTraits<llvm::Inverse<FrozenGraph<OriginalNodeRef> *>>
+  : public GraphTraits<llvm::Inverse<FrozenNode<OriginalNodeRef> *>> {
+  using GraphType = FrozenGraph<OriginalNodeRef>;
+  using NodeRef = FrozenNode<OriginalNodeRef> *;
+  using nodes_iterator = typename GraphType::nodes_iterator;
+
+  static NodeRef getEntryNode(llvm::Inverse<GraphType *> Inv) {
+    return Inv.Graph->getEntryNode();
+  }
+
+  static nodes_iterator nodes_begin(llvm::Inverse<GraphType *> Inv) {
+    return Inv.Graph->nodes().begin();
+  }
+  static nodes_iterator nodes_end(llvm::Inverse<GraphType *> Inv) {
+    return Inv.Graph->nodes().end();
+  }
+
+  static size_t size(llvm::Inverse<GraphType *> Inv) {
+    return Inv.Graph->size();
+  }
+};
+
+} // namespace llvm
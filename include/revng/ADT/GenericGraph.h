@@ -10,6 +10,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/Allocator.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/GraphWriter.h"
 
@@ -1330,16 +1331,50 @@ public:
   void setEntryNode(NodeT *EntryNode) { this->EntryNode = EntryNode; }
 };
 
+namespace revng::detail {
+
+/// Deletes the nodes owned by a GenericGraph, which are either allocated on
+/// their own or in the arena of the graph
+template<typename NodeT>
+struct GraphNodeDeleter {
+  /// The memory of a node allocated in the arena is released together with the
+  /// rest of the arena, only its destructor has to be run
+  bool InArena = false;
+
+  GraphNodeDeleter() = default;
+  explicit GraphNodeDeleter(bool InArena) : InArena(InArena) {}
+
+  /// Allows nodes allocated with `std::make_unique` to be added to the graph
+  GraphNodeDeleter(std::default_delete<NodeT>) {}
+
+  void operator()(NodeT *Node) const {
+    if (InArena)
+      Node->~NodeT();
+    else
+      delete Node;
+  }
+};
+
+} // namespace revng::detail
+
 /// Generic graph parametrized in the node type
 ///
 /// This graph owns its nodes (but not the edges).
 /// It can optionally have an elected entry point.
+///
+/// By default each node is a separate heap allocation. Graphs that are built
+/// and thrown away in large numbers can call `allocateNodesInArena`: from then
+/// on, the nodes constructed by `addNode` and `insertNode` are bump-allocated,
+/// contiguously, from slabs owned by the graph, which are released all at once
+/// when the graph is destroyed or cleared.
 template<typename NodeT, size_t SmallSize, bool HasEntryNode>
 class GenericGraph
   : public std::conditional_t<HasEntryNode, EntryNode<NodeT>, Empty> {
 public:
   static const bool is_generic_graph = true;
-  using NodesContainer = llvm::SmallVector<std::unique_ptr<NodeT>, SmallSize>;
+  using NodePointer = std::unique_ptr<NodeT,
+                                      revng::detail::GraphNodeDeleter<NodeT>>;
+  using NodesContainer = llvm::SmallVector<NodePointer, SmallSize>;
   using Node = NodeT;
   static constexpr bool hasEntryNode = HasEntryNode;
 
@@ -1358,7 +1393,7 @@ public:
     llvm::SmallPtrSet<NodeT *, 32> ValidNodes;
 
     // Collect all valid nodes and ensure there are no nullptr
-    for (const std::unique_ptr<NodeT> &Node : Nodes) {
+    for (const NodePointer &Node : Nodes) {
 
       if (Node.get() == nullptr) {
         return llvm::createStringError(llvm::inconvertibleErrorCode(),
@@ -1369,7 +1404,7 @@ public:
     }
 
     // Ensure we only point to valid nodes
-    for (const std::unique_ptr<NodeT> &Node : Nodes) {
+    for (const NodePointer &Node : Nodes) {
       for (NodeT *Successor : Node->successors()) {
         if (not ValidNodes.contains(Successor)) {
           return llvm::createStringError(llvm::inconvertibleErrorCode(),
@@ -1395,8 +1430,8 @@ public:
   void dumpGraph() const debug_function { llvm::WriteGraph(this, ""); }
 
 public:
-  static NodeT *getNode(std::unique_ptr<NodeT> &E) { return E.get(); }
-  static const NodeT *getConstNode(const std::unique_ptr<NodeT> &E) {
+  static NodeT *getNode(NodePointer &E) { return E.get(); }
+  static const NodeT *getConstNode(const NodePointer &E) {
     return E.get();
   }
 
@@ -1447,7 +1482,7 @@ public:
 
   template<class... ArgTypes>
   NodeT *addNode(ArgTypes &&...A) {
-    Nodes.push_back(std::make_unique<NodeT>(std::forward<ArgTypes>(A)...));
+    Nodes.push_back(makeNode(std::forward<ArgTypes>(A)...));
     if constexpr (NodeT::HasParent)
       Nodes.back()->setParent(this);
     return Nodes.back().get();
@@ -1472,14 +1507,45 @@ public:
   }
   template<class... ArgTypes>
   nodes_iterator insertNode(nodes_iterator Where, ArgTypes &&...A) {
-    auto Pointer = std::make_unique<NodeT>(std::forward<ArgTypes>(A)...);
+    auto Pointer = makeNode(std::forward<ArgTypes>(A)...);
     auto InternalIt = Nodes.insert(Where.getCurrent(), std::move(Pointer));
     return nodes_iterator(InternalIt, getNode);
   }
 
 public:
   void reserve(size_t Size) { Nodes.reserve(Size); }
-  void clear() { Nodes.clear(); }
+  void clear() {
+    Nodes.clear();
+    if (Arena)
+      Arena->Reset();
+  }
+
+public:
+  /// Allocate the nodes constructed from now on in an arena owned by the
+  /// graph.
+  ///
+  /// \note the memory of the nodes removed from the graph is only reclaimed
+  ///       when the whole graph is destroyed or cleared.
+  void allocateNodesInArena() {
+    if (not Arena)
+      Arena = std::make_unique<llvm::BumpPtrAllocator>();
+  }
+
+private:
+  template<class... ArgTypes>
+  NodePointer makeNode(ArgTypes &&...A) {
+    if (not Arena)
+      return std::make_unique<NodeT>(std::forward<ArgTypes>(A)...);
+
+    void *Memory = Arena->Allocate(sizeof(NodeT), alignof(NodeT));
+    auto *Result = new (Memory) NodeT(std::forward<ArgTypes>(A)...);
+    return NodePointer(Result, revng::detail::GraphNodeDeleter<NodeT>(true));
+  }
+
+private:
+  // The arena is declared before the nodes so that it outlives them. It's
+  // held by pointer so that moving the graph does not move the nodes.
+  std::unique_ptr<llvm::BumpPtrAllocator> Arena;
 
 protected:
   NodesContainer Nodes;
@@ -4,7 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <concepts>
+#include <cstdint>
 #include <optional>
 #include <set>
 
@@ -44,6 +46,63 @@ static_assert(KeyedObjectContainerCompatible<int>);
 template<typename T>
 concept KeyedObjectContainer = requires(T &&) { T::KeyedObjectContainerTag; };
 
+namespace revng {
+
+/// A counter that changes each time one of the keyed object containers
+/// attached to it is modified in a way that might move, replace or destroy
+/// its elements.
+///
+/// Each TupleTree has one, to which it attaches all of its containers (see
+/// TupleTree::initializeReferences). Pointers to elements of the tree computed
+/// when the counter had the current value are still valid. This is used to
+/// cache the resolution of TupleTreeReferences.
+///
+/// \note replacing an element by assigning it through a reference or an
+///       iterator is not tracked: erase it and insert the new one instead.
+class StructuralGeneration {
+private:
+  std::atomic<uint64_t> Value = 1;
+
+public:
+  uint64_t get() const { return Value.load(std::memory_order_relaxed); }
+  void bump() noexcept { Value.fetch_add(1, std::memory_order_relaxed); }
+};
+
+namespace detail {
+
+/// Bumped by the containers that are not attached to any generation, e.g., the
+/// ones of the elements inserted in a tree after it has been initialized. They
+/// might belong to any tree.
+inline StructuralGeneration UnattachedGeneration;
+
+/// Bumped by all the containers
+inline StructuralGeneration AnyGeneration;
+
+} // namespace detail
+
+/// \return a value that changes each time a container attached to \p Owner,
+///         or a container not attached to any generation, is modified. If
+///         \p Owner is nullptr, the value changes when any container is.
+inline uint64_t getStructuralGeneration(const StructuralGeneration *Owner) {
+  if (Owner == nullptr)
+    return detail::AnyGeneration.get();
+
+  // Both only ever increase, so their sum changes whenever one of them does
+  return Owner->get() + detail::UnattachedGeneration.get();
+}
+
+/// Invalidate the pointers to elements of a container attached to \p Owner,
+/// see getStructuralGeneration
+inline void bumpStructuralGeneration(StructuralGeneration *Owner) noexcept {
+  detail::AnyGeneration.bump();
+  if (Owner != nullptr)
+    Owner->bump();
+  else
+    detail::UnattachedGeneration.bump();
+}
+
+} // namespace revng
+
 namespace revng::detail {
 
 template<KeyedObjectContainerCompatible T>
@@ -102,7 +161,10 @@ struct llvm::yaml::SequenceTraits<T> {
 
     void postflightElement(unsigned) {
       if (not IsOutputting) {
-        BatchInserter->insert(Instance);
+        if constexpr (requires { BatchInserter->emplace(std::move(Instance)); })
+          BatchInserter->emplace(std::move(Instance));
+        else
+          BatchInserter->insert(Instance);
         Instance = KOT::fromKey(key_type());
       }
     };
@@ -5,10 +5,12 @@
 //
 
 #include <algorithm>
+#include <bit>
 #include <climits>
 #include <cstdint>
 #include <cstring>
 #include <limits>
+#include <span>
 
 #include "boost/iterator/iterator_facade.hpp"
 
@@ -129,6 +131,9 @@ private:
       return Storage[Index];
     }
 
+    uintptr_t *data() { return Storage; }
+    const uintptr_t *data() const { return Storage; }
+
     void zero(size_t From, size_t Count) {
       revng_assert(From + Count <= wordCount());
       memset(&at(From), 0, Count * sizeof(uintptr_t));
@@ -297,46 +302,18 @@ public:
     if (isSmall() && Other.isSmall())
       return false;
 
-    if (!isSmall() && !Other.isSmall()) {
-      const LargeStorage &OtherLarge = Other.getLarge();
-      const LargeStorage &ThisLarge = getLarge();
-
-      unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
-      Max /= BitsPerPointer;
-
-      for (unsigned I = 0; I < Max; I++)
-        if (ThisLarge.at(I) != OtherLarge.at(I))
-          return false;
-
-      if (ThisLarge.capacity() > OtherLarge.capacity()) {
-        for (unsigned I = Max; I < ThisLarge.wordCount(); I++)
-          if (ThisLarge.at(I) != 0)
-            return false;
-      } else {
-        for (unsigned I = Max; I < OtherLarge.wordCount(); I++)
-          if (OtherLarge.at(I) != 0)
-            return false;
-      }
-
-    } else if (!isSmall() && Other.isSmall()) {
-      const LargeStorage &ThisLarge = getLarge();
-      if (ThisLarge.at(0) != Other.getSmall())
-        return false;
-
-      for (unsigned I = 1; I < ThisLarge.wordCount(); I++)
-        if (ThisLarge.at(I) != 0)
-          return false;
-    } else if (isSmall() && !Other.isSmall()) {
-      const LargeStorage &OtherLarge = Other.getLarge();
-      if (OtherLarge.at(0) != getSmall())
-        return false;
+    uintptr_t ThisScratch = 0;
+    uintptr_t OtherScratch = 0;
+    std::span<const uintptr_t> ThisWords = words(ThisScratch);
+    std::span<const uintptr_t> OtherWords = Other.words(OtherScratch);
+    size_t Common = std::min(ThisWords.size(), OtherWords.size());
 
-      for (unsigned I = 1; I < OtherLarge.wordCount(); I++)
-        if (OtherLarge.at(I) != 0)
-          return false;
-    }
+    uintptr_t Difference = 0;
+    for (size_t I = 0; I < Common; I++)
+      Difference |= ThisWords[I] ^ OtherWords[I];
 
-    return true;
+    return Difference == 0 and allZero(ThisWords.subspan(Common))
+           and allZero(OtherWords.subspan(Common));
   }
 
   bool operator!=(const LazySmallBitVector &Other) const {
@@ -390,60 +367,49 @@ public:
   }
 
   LazySmallBitVector &operator^=(const LazySmallBitVector &Other) {
-    // Ensure we have at least the same capacity as Other
-    if (Other.capacity() > this->capacity())
-      alloc(Other.capacity());
-
-    // This situation should never happen, since we just ensured we have at
-    // least the same capacity
-    revng_assert(!(isSmall() && !Other.isSmall()));
+    ensureCapacityOf(Other);
 
-    if (isSmall() && Other.isSmall()) {
+    if (isSmall()) {
       Storage = (Storage ^ Other.Storage) | 1;
-    } else if (!isSmall() && !Other.isSmall()) {
-      const LargeStorage &OtherLarge = Other.getLarge();
-      LargeStorage &ThisLarge = getLarge();
-
-      unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
-      Max /= BitsPerPointer;
-      for (unsigned I = 0; I < Max; I++)
-        ThisLarge.at(I) = ThisLarge.at(I) ^ OtherLarge.at(I);
-
-    } else if (!isSmall() && Other.isSmall()) {
-      LargeStorage &ThisLarge = getLarge();
-      ThisLarge.at(0) = ThisLarge.at(0) ^ Other.getSmall();
+    } else {
+      uintptr_t Scratch = 0;
+      std::span<const uintptr_t> OtherWords = Other.words(Scratch);
+      uintptr_t *ThisWords = getLarge().data();
+      for (size_t I = 0; I < OtherWords.size(); I++)
+        ThisWords[I] ^= OtherWords[I];
     }
 
     return *this;
   }
 
   LazySmallBitVector &operator|=(const LazySmallBitVector &Other) {
-    // Ensure we have at least the same capacity as Other
-    if (Other.capacity() > this->capacity())
-      alloc(Other.capacity());
+    orAndTestChanged(Other);
+    return *this;
+  }
 
-    // This situation should never happen, since we just ensured we have at
-    // least the same capacity
-    revng_assert(!(isSmall() && !Other.isSmall()));
+  /// Performs `*this |= Other`
+  ///
+  /// \return true if any bit of this bit vector has been set
+  bool orAndTestChanged(const LazySmallBitVector &Other) {
+    ensureCapacityOf(Other);
 
-    if (isSmall() && Other.isSmall()) {
+    if (isSmall()) {
+      uintptr_t Old = Storage;
       Storage = Storage | Other.Storage;
-    } else if (!isSmall() && !Other.isSmall()) {
-      const LargeStorage &OtherLarge = Other.getLarge();
-      LargeStorage &ThisLarge = getLarge();
-
-      unsigned Max = std::min(ThisLarge.capacity(), OtherLarge.capacity());
-      Max /= BitsPerPointer;
-
-      for (unsigned I = 0; I < Max; I++)
-        ThisLarge.at(I) = ThisLarge.at(I) | OtherLarge.at(I);
+      return Storage != Old;
+    }
 
-    } else if (!isSmall() && Other.isSmall()) {
-      LargeStorage &ThisLarge = getLarge();
-      ThisLarge.at(0) = ThisLarge.at(0) | Other.getSmall();
+    uintptr_t Scratch = 0;
+    std::span<const uintptr_t> OtherWords = Other.words(Scratch);
+    uintptr_t *ThisWords = getLarge().data();
+    uintptr_t Changed = 0;
+    for (size_t I = 0; I < OtherWords.size(); I++) {
+      uintptr_t New = ThisWords[I] | OtherWords[I];
+      Changed |= New ^ ThisWords[I];
+      ThisWords[I] = New;
     }
 
-    return *this;
+    return Changed != 0;
   }
 
   LazySmallBitVector &operator&=(const LazySmallBitVector &Other) {
@@ -457,35 +423,47 @@ public:
       setSmall(getSmall() & OtherValue);
     } else {
       LargeStorage &Large = getLarge();
-      size_t ThisPointersCount = Large.wordCount();
+      uintptr_t Scratch = 0;
+      std::span<const uintptr_t> OtherWords = Other.words(Scratch);
+      size_t Common = std::min<size_t>(OtherWords.size(), Large.wordCount());
 
-      if (Other.isSmall()) {
-        // We have to discard everything except the first uintptr_t
-        if (ThisPointersCount > 1) {
-          // Zero out all the uintptr_t after the first one
-          Large.zero(1, ThisPointersCount - 1);
-        }
+      uintptr_t *ThisWords = Large.data();
+      for (size_t I = 0; I < Common; I++)
+        ThisWords[I] &= OtherWords[I];
 
-        Large.at(0) = Large.at(0) & Other.getSmall();
-      } else {
-        const LargeStorage &OtherLarge = Other.getLarge();
-        size_t OtherPointersCount = OtherLarge.wordCount();
-
-        if (ThisPointersCount > OtherPointersCount) {
-          // Zero out all the uintptr_t after OtherPointersCount
-          Large.zero(OtherPointersCount,
-                     ThisPointersCount - OtherPointersCount);
-        }
-
-        unsigned Max = std::min(OtherPointersCount, ThisPointersCount);
-        for (unsigned I = 0; I < Max; I++)
-          Large.at(I) = Large.at(I) & OtherLarge.at(I);
-      }
+      // Zero out all the uintptr_t that Other does not have
+      if (Large.wordCount() > Common)
+        Large.zero(Common, Large.wordCount() - Common);
     }
 
     return *this;
   }
 
+  /// \return true if all the bits set in this bit vector are set in \p Other
+  ///         too
+  bool isSubsetOf(const LazySmallBitVector &Other) const {
+    uintptr_t ThisScratch = 0;
+    uintptr_t OtherScratch = 0;
+    std::span<const uintptr_t> ThisWords = words(ThisScratch);
+    std::span<const uintptr_t> OtherWords = Other.words(OtherScratch);
+    size_t Common = std::min(ThisWords.size(), OtherWords.size());
+
+    uintptr_t Extra = 0;
+    for (size_t I = 0; I < Common; I++)
+      Extra |= ThisWords[I] & ~OtherWords[I];
+
+    return Extra == 0 and allZero(ThisWords.subspan(Common));
+  }
+
+  /// \return the number of bits set
+  unsigned count() const {
+    uintptr_t Scratch = 0;
+    unsigned Result = 0;
+    for (uintptr_t Word : words(Scratch))
+      Result += std::popcount(Word);
+    return Result;
+  }
+
   LazySmallBitVector &operator>>=(unsigned Amount) {
     revng_assert(Amount <= capacity());
 
@@ -588,30 +566,26 @@ public:
   /// \return 0 if no bits are set after \p StartIndex, the 1-based index of the
   ///         next bit set otherwise
   unsigned findNext(unsigned StartIndex) const {
-    if (StartIndex >= requiredBits())
+    uintptr_t Scratch = 0;
+    std::span<const uintptr_t> Words = words(Scratch);
+    size_t Index = StartIndex / BitsPerPointer;
+    if (Index >= Words.size())
       return 0;
 
-    if (isSmall()) {
-      return StartIndex + findFirstBit(getSmall() >> StartIndex);
-    } else {
-      const LargeStorage &Large = getLarge();
-      unsigned Index = StartIndex / BitsPerPointer;
-      unsigned ShiftAmount = StartIndex % BitsPerPointer;
-
-      uintptr_t FirstValue = Large.at(Index) >> ShiftAmount;
-      if (FirstValue != 0)
-        return StartIndex + findFirstBit(FirstValue);
+    uintptr_t FirstValue = Words[Index] >> (StartIndex % BitsPerPointer);
+    if (FirstValue != 0)
+      return StartIndex + findFirstBit(FirstValue);
 
-      do {
-        Index++;
-        if (Index * BitsPerPointer >= capacity())
-          return 0;
-      } while (Large.at(Index) == 0);
+    for (Index++; Index < Words.size(); Index++)
+      if (Words[Index] != 0)
+        return Index * BitsPerPointer + findFirstBit(Words[Index]);
 
-      return Index * BitsPerPointer + findFirstBit(Large.at(Index));
-    }
+    return 0;
   }
 
+  /// \return the 1-based index of the first set bit, or 0 if there are none
+  unsigned findFirst() const { return findNext(0); }
+
   const_iterator begin() const { return const_iterator(this); }
   const_iterator end() const { return const_iterator(this, 0); }
 
@@ -639,6 +613,34 @@ private:
     revng_assert(isSmall());
   }
 
+  /// \return the words making up the bit vector. The value of small bit vectors
+  ///         is copied in \p Scratch.
+  std::span<const uintptr_t> words(uintptr_t &Scratch) const {
+    if (isSmall()) {
+      Scratch = getSmall();
+      return std::span<const uintptr_t>(&Scratch, 1);
+    }
+
+    const LargeStorage &Large = getLarge();
+    return std::span<const uintptr_t>(Large.data(), Large.wordCount());
+  }
+
+  static bool allZero(std::span<const uintptr_t> Words) {
+    uintptr_t Result = 0;
+    for (uintptr_t Word : Words)
+      Result |= Word;
+    return Result == 0;
+  }
+
+  /// Ensure we have at least the same capacity as \p Other, so that a small
+  /// bit vector is never combined with a large one
+  void ensureCapacityOf(const LazySmallBitVector &Other) {
+    if (Other.capacity() > capacity())
+      alloc(Other.capacity());
+
+    revng_assert(!(isSmall() && !Other.isSmall()));
+  }
+
   size_t capacity() const {
     if (isSmall())
       return BitsPerPointer - 1;
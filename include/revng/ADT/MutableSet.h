@@ -5,6 +5,7 @@
 //
 
 #include <map>
+#include <optional>
 
 #include "llvm/ADT/STLExtras.h"
 
@@ -68,6 +69,9 @@ public:
 private:
   map_type TheMap;
 
+  /// Not propagated by copies and moves, the copy might end up anywhere
+  revng::StructuralGeneration *Generation = nullptr;
+
 public:
   MutableSet() {}
 
@@ -78,9 +82,42 @@ public:
     }
   }
 
+  // Inserting leaves the existing elements where they are, replacing or
+  // removing them invalidates the pointers to them (see
+  // getStructuralGeneration)
+  MutableSet(const MutableSet &Other) : TheMap(Other.TheMap) {}
+  MutableSet(MutableSet &&Other) noexcept {
+    Other.bumpGeneration();
+    TheMap = std::move(Other.TheMap);
+  }
+
+  MutableSet &operator=(const MutableSet &Other) {
+    bumpGeneration();
+    TheMap = Other.TheMap;
+    return *this;
+  }
+
+  MutableSet &operator=(MutableSet &&Other) noexcept {
+    bumpGeneration();
+    Other.bumpGeneration();
+    TheMap = std::move(Other.TheMap);
+    return *this;
+  }
+
 public:
-  void swap(MutableSet &Other) { TheMap.swap(Other.TheMap); }
-  bool operator==(const MutableSet &Other) const = default;
+  void swap(MutableSet &Other) {
+    bumpGeneration();
+    Other.bumpGeneration();
+    TheMap.swap(Other.TheMap);
+  }
+  bool operator==(const MutableSet &Other) const {
+    return TheMap == Other.TheMap;
+  }
+
+  /// Report the structural modifications to \p NewGeneration from now on
+  void attachGeneration(revng::StructuralGeneration *NewGeneration) {
+    Generation = NewGeneration;
+  }
 
 public:
   T &at(const key_type &Key) { return TheMap.at(Key); }
@@ -114,7 +151,10 @@ public:
   bool empty() const { return TheMap.empty(); }
   size_type size() const { return TheMap.size(); }
   size_type max_size() const { return TheMap.max_size(); }
-  void clear() { TheMap.clear(); }
+  void clear() {
+    bumpGeneration();
+    TheMap.clear();
+  }
 
   std::pair<iterator, bool> insert(const T &Value) {
     auto Result = TheMap.insert({ KOT::key(Value), Value });
@@ -141,22 +181,29 @@ public:
   }
 
   std::pair<iterator, bool> insert_or_assign(const T &Value) {
+    bumpGeneration();
     auto Result = TheMap.insert_or_assign(KOT::key(Value), Value);
     return { wrapIterator(Result.first), Result.second };
   }
 
   iterator erase(iterator Pos) {
+    bumpGeneration();
     return wrapIterator(TheMap.erase(unwrapIterator(Pos)));
   }
   iterator erase(iterator First, iterator Last) {
+    bumpGeneration();
     auto It = TheMap.erase(unwrapIterator(First), unwrapIterator(Last));
     return wrapIterator(It);
   }
 
-  size_type erase(const key_type &Key) { return TheMap.erase(Key); }
+  size_type erase(const key_type &Key) {
+    bumpGeneration();
+    return TheMap.erase(Key);
+  }
 
   template<typename CallableType>
   size_type erase_if(CallableType &&Callable) {
+    bumpGeneration();
     return std::erase_if(TheMap, std::forward<CallableType>(Callable));
   }
 
@@ -213,7 +260,39 @@ public:
     return BatchInsertOrAssigner(*this);
   }
 
+  /// See SortedVector::BatchTryEmplacer
+  class BatchTryEmplacer {
+  private:
+    MutableSet &MS;
+    /// Where elements with a key that is already present end up
+    std::optional<T> Discarded;
+
+  public:
+    BatchTryEmplacer(MutableSet &MS) : MS(MS) {}
+
+    template<typename... Types>
+    T &try_emplace(Types &&...Values) {
+      T NewElement{ std::forward<Types>(Values)... };
+      auto [It, Inserted] = MS.TheMap.try_emplace(KOT::key(NewElement),
+                                                  std::move(NewElement));
+      if (Inserted)
+        return It->second;
+
+      Discarded.emplace(std::move(NewElement));
+      return *Discarded;
+    }
+  };
+
+  BatchTryEmplacer batch_try_emplace() { return BatchTryEmplacer(*this); }
+
 private:
+  /// Call before modifying the container. Since null lookups are not cached,
+  /// modifying an empty container can't invalidate anything.
+  void bumpGeneration() noexcept {
+    if (not TheMap.empty())
+      revng::bumpStructuralGeneration(Generation);
+  }
+
   static inner_iterator unwrapIterator(iterator It) { return It.getCurrent(); }
 
   static const_inner_iterator unwrapIterator(const_iterator It) {
@@ -4,7 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
 #include <coroutine>
+#include <cstddef>
+#include <new>
 #include <optional>
 #include <type_traits>
 #include <utility>
@@ -16,6 +19,89 @@ struct RecursiveCoroutine;
 
 namespace revng::detail {
 
+/// Recycles the frames of the RecursiveCoroutines running on a thread
+///
+/// Each recursive call allocates a frame, which is released as soon as the
+/// call returns. Frames are grouped by size in a few classes, and released
+/// frames are kept in a free list for each class, ready for the next call of
+/// a coroutine in the same class. This way, a recursion performs at most one
+/// heap allocation for each level of its maximum depth, as long as the depth
+/// stays below MaxFreeFrames: the frames beyond that are returned to the heap,
+/// so that a single very deep recursion does not keep its memory forever.
+///
+/// Allocation failures are reported by returning nullptr, as coroutines with
+/// `get_return_object_on_allocation_failure` expect.
+///
+/// Frames released by a different thread than the one that allocated them end
+/// up in the pool of the former, which is fine since they come from the heap.
+class CoroutineFramePool {
+private:
+  static constexpr size_t Granularity = 64;
+  static constexpr size_t ClassCount = 32;
+  static constexpr size_t MaxFreeFrames = 1024;
+
+  struct FreeFrame {
+    FreeFrame *Next = nullptr;
+  };
+
+private:
+  std::array<FreeFrame *, ClassCount> FreeLists = {};
+  std::array<size_t, ClassCount> FreeCounts = {};
+
+public:
+  CoroutineFramePool() = default;
+  CoroutineFramePool(const CoroutineFramePool &) = delete;
+  CoroutineFramePool &operator=(const CoroutineFramePool &) = delete;
+
+  ~CoroutineFramePool() {
+    for (FreeFrame *&Head : FreeLists) {
+      while (Head != nullptr) {
+        FreeFrame *Next = Head->Next;
+        ::operator delete(Head);
+        Head = Next;
+      }
+    }
+  }
+
+public:
+  static CoroutineFramePool &get() {
+    thread_local CoroutineFramePool Pool;
+    return Pool;
+  }
+
+  void *allocate(size_t Size) {
+    size_t Class = classOf(Size);
+    if (Class >= ClassCount)
+      return ::operator new(Size, std::nothrow);
+
+    FreeFrame *&Head = FreeLists[Class];
+    if (Head == nullptr)
+      return ::operator new((Class + 1) * Granularity, std::nothrow);
+
+    FreeFrame *Result = Head;
+    Head = Result->Next;
+    --FreeCounts[Class];
+    return Result;
+  }
+
+  void deallocate(void *Frame, size_t Size) {
+    size_t Class = classOf(Size);
+    if (Class >= ClassCount or FreeCounts[Class] == MaxFreeFrames) {
+      ::operator delete(Frame);
+      return;
+    }
+
+    FreeLists[Class] = new (Frame) FreeFrame{ FreeLists[Class] };
+    ++FreeCounts[Class];
+  }
+
+private:
+  static size_t classOf(size_t Size) {
+    revng_assert(Size > 0);
+    return (Size - 1) / Granularity;
+  }
+};
+
 template<typename RetT>
 struct ReturnBase {
 
@@ -63,6 +149,14 @@ struct RecursivePromise : public ReturnBase<ReturnT> {
 
   [[noreturn]] void unhandled_exception() const { std::terminate(); }
 
+  static void *operator new(size_t Size) noexcept {
+    return CoroutineFramePool::get().allocate(Size);
+  }
+
+  static void operator delete(void *Frame, size_t Size) {
+    CoroutineFramePool::get().deallocate(Frame, Size);
+  }
+
   auto initial_suspend() const { return std::suspend_always(); }
 
   auto final_suspend() noexcept {
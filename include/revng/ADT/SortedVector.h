@@ -28,6 +28,16 @@ unique_last(ForwardIt First, ForwardIt Last, BinaryPredicate Predicate) {
   return ++Result;
 }
 
+/// How a batch insertion into a SortedVector handles elements with the same key
+enum class BatchPolicy {
+  /// Elements with the same key are forbidden
+  EnsureUnique,
+  /// The element inserted last wins
+  KeepLast,
+  /// The element present before the batch or inserted first wins
+  KeepFirst
+};
+
 template<KeyedObjectContainerCompatible T,
          class Compare = DefaultKeyObjectComparator<T>>
 class SortedVector {
@@ -61,6 +71,9 @@ private:
   vector_type TheVector;
   bool BatchInsertInProgress = false;
 
+  /// Not propagated by copies and moves, the copy might end up anywhere
+  revng::StructuralGeneration *Generation = nullptr;
+
 public:
   SortedVector() {}
 
@@ -73,16 +86,52 @@ public:
 
   template<std::input_iterator FromIt, std::sentinel_for<FromIt> ToIt>
   SortedVector(FromIt From, ToIt To) : TheVector(From, To) {
-    sort<true>();
+    sort<BatchPolicy::EnsureUnique>();
+  }
+
+  // Copying leaves the existing elements where they are, everything else
+  // invalidates the pointers to them (see getStructuralGeneration)
+  SortedVector(const SortedVector &Other) :
+    TheVector(Other.TheVector),
+    BatchInsertInProgress(Other.BatchInsertInProgress) {}
+  SortedVector(SortedVector &&Other) noexcept {
+    Other.bumpGeneration();
+    TheVector = std::move(Other.TheVector);
+    BatchInsertInProgress = Other.BatchInsertInProgress;
+  }
+
+  SortedVector &operator=(const SortedVector &Other) {
+    bumpGeneration();
+    TheVector = Other.TheVector;
+    BatchInsertInProgress = Other.BatchInsertInProgress;
+    return *this;
+  }
+
+  SortedVector &operator=(SortedVector &&Other) noexcept {
+    bumpGeneration();
+    Other.bumpGeneration();
+    TheVector = std::move(Other.TheVector);
+    BatchInsertInProgress = Other.BatchInsertInProgress;
+    return *this;
   }
 
 public:
   void swap(SortedVector &Other) {
     revng_assert(not BatchInsertInProgress);
+    bumpGeneration();
+    Other.bumpGeneration();
     TheVector.swap(Other.TheVector);
   }
 
-  bool operator==(const SortedVector &) const = default;
+  /// Report the structural modifications to \p NewGeneration from now on
+  void attachGeneration(revng::StructuralGeneration *NewGeneration) {
+    Generation = NewGeneration;
+  }
+
+  bool operator==(const SortedVector &Other) const {
+    return TheVector == Other.TheVector
+           and BatchInsertInProgress == Other.BatchInsertInProgress;
+  }
 
 public:
   T &at(const key_type &Key) {
@@ -186,11 +235,13 @@ public:
 
   void clear() {
     revng_assert(not BatchInsertInProgress);
+    bumpGeneration();
     TheVector.clear();
   }
 
   void reserve(size_type NewSize) {
     revng_assert(not BatchInsertInProgress);
+    bumpGeneration();
     TheVector.reserve(NewSize);
   }
 
@@ -209,11 +260,13 @@ public:
     auto Key = KeyedObjectTraits<T>::key(Value);
     auto It = lower_bound(Key);
     if (It == end()) {
+      bumpGeneration();
       TheVector.emplace_back(std::move(Value));
       return { --end(), true };
     } else if (keysEqual(KeyedObjectTraits<T>::key(*It), Key)) {
       return { It, false };
     } else {
+      bumpGeneration();
       return { TheVector.emplace(It, std::move(Value)), true };
     }
   }
@@ -229,6 +282,7 @@ public:
     T Value{ std::forward<Types>(Values)... };
     auto Key = KeyedObjectTraits<T>::key(Value);
     auto It = lower_bound(Key);
+    bumpGeneration();
     if (It == end()) {
       TheVector.emplace_back(std::move(Value));
       return { --end(), true };
@@ -242,11 +296,13 @@ public:
 
   iterator erase(iterator Pos) {
     revng_assert(not BatchInsertInProgress);
+    bumpGeneration();
     return TheVector.erase(Pos);
   }
 
   iterator erase(const_iterator First, const_iterator Last) {
     revng_assert(not BatchInsertInProgress);
+    bumpGeneration();
     return TheVector.erase(First, Last);
   }
 
@@ -264,6 +320,7 @@ public:
   template<typename CallableType>
   size_type erase_if(CallableType &&Callable) {
     revng_assert(not BatchInsertInProgress);
+    bumpGeneration();
     return std::erase_if(TheVector, std::forward<CallableType>(Callable));
   }
 
@@ -317,7 +374,7 @@ public:
   }
 
 public:
-  template<bool EnsureUnique = false>
+  template<BatchPolicy Policy>
   class BatchInserterBase {
   private:
     SortedVector *SV;
@@ -346,7 +403,8 @@ public:
     void commit() {
       if (SV != nullptr && SV->BatchInsertInProgress) {
         SV->BatchInsertInProgress = false;
-        SV->sort<EnsureUnique>();
+        SV->bumpGeneration();
+        SV->sort<Policy>();
       }
     }
 
@@ -354,14 +412,16 @@ public:
     template<typename... Types>
     T &emplaceImpl(Types &&...Values) {
       revng_assert(SV->BatchInsertInProgress);
+      SV->bumpGeneration();
       SV->TheVector.emplace_back(std::forward<Types>(Values)...);
       return SV->TheVector.back();
     }
   };
 
-  class BatchInserter : public BatchInserterBase<true> {
+  class BatchInserter : public BatchInserterBase<BatchPolicy::EnsureUnique> {
   public:
-    BatchInserter(SortedVector &SV) : BatchInserterBase<true>(SV) {}
+    BatchInserter(SortedVector &SV) :
+      BatchInserterBase<BatchPolicy::EnsureUnique>(SV) {}
 
   public:
     template<typename... Types>
@@ -376,9 +436,11 @@ public:
     return BatchInserter(*this);
   }
 
-  class BatchInsertOrAssigner : public BatchInserterBase<false> {
+  class BatchInsertOrAssigner
+    : public BatchInserterBase<BatchPolicy::KeepLast> {
   public:
-    BatchInsertOrAssigner(SortedVector &SV) : BatchInserterBase<false>(SV) {}
+    BatchInsertOrAssigner(SortedVector &SV) :
+      BatchInserterBase<BatchPolicy::KeepLast>(SV) {}
 
   public:
     template<typename... Types>
@@ -393,6 +455,28 @@ public:
     return BatchInsertOrAssigner(*this);
   }
 
+  /// Batch counterpart of try_emplace: elements whose key is already present,
+  /// either before the batch or earlier in it, are discarded on commit.
+  ///
+  /// \note the reference returned by try_emplace is only valid until the next
+  ///       insertion and it might refer to an element that will be discarded.
+  class BatchTryEmplacer : public BatchInserterBase<BatchPolicy::KeepFirst> {
+  public:
+    BatchTryEmplacer(SortedVector &SV) :
+      BatchInserterBase<BatchPolicy::KeepFirst>(SV) {}
+
+  public:
+    template<typename... Types>
+    T &try_emplace(Types &&...Values) {
+      return this->emplaceImpl(std::forward<Types>(Values)...);
+    }
+  };
+
+  BatchTryEmplacer batch_try_emplace() {
+    revng_assert(not BatchInsertInProgress);
+    return BatchTryEmplacer(*this);
+  }
+
   /// \note This function should always return true
   bool isSorted() const debug_function {
     auto It = begin();
@@ -412,6 +496,13 @@ public:
   }
 
 private:
+  /// Call before modifying the container. Since null lookups are not cached,
+  /// modifying an empty container can't invalidate anything.
+  void bumpGeneration() noexcept {
+    if (not TheVector.empty())
+      revng::bumpStructuralGeneration(Generation);
+  }
+
   static bool compareElements(const T &LHS, const T &RHS) {
     return compareKeys(KeyedObjectTraits<T>::key(LHS),
                        KeyedObjectTraits<T>::key(RHS));
@@ -430,16 +521,20 @@ private:
     return not compareKeys(LHS, RHS) and not compareKeys(RHS, LHS);
   }
 
-  template<bool EnsureUnique>
+  template<BatchPolicy Policy>
   void sort() {
-    if constexpr (EnsureUnique) {
+    if constexpr (Policy == BatchPolicy::EnsureUnique) {
       std::sort(begin(), end(), compareElements);
       revng_check(std::adjacent_find(begin(), end(), elementsEqual) == end(),
                   "Multiples of the same element in a `SortedVector`.");
-    } else {
+    } else if constexpr (Policy == BatchPolicy::KeepLast) {
       std::stable_sort(begin(), end(), compareElements);
       auto NewEnd = unique_last(begin(), end(), elementsEqual);
       TheVector.erase(NewEnd, end());
+    } else {
+      std::stable_sort(begin(), end(), compareElements);
+      auto NewEnd = std::unique(begin(), end(), elementsEqual);
+      TheVector.erase(NewEnd, end());
     }
   }
 };
@@ -79,6 +79,7 @@ public:
   /// @{
 
   void stopTracking() const { TrackingIsActive = false; }
+  bool isTrackingActive() const { return TrackingIsActive; }
   void clearTracking() const {
     Exact.clear();
     NonExisting = {};
@@ -148,6 +149,10 @@ public:
 
   void swap(TrackingContainer &Other) { Content.swap(Other.Content); }
 
+  void attachGeneration(revng::StructuralGeneration *NewGeneration) {
+    Content.attachGeneration(NewGeneration);
+  }
+
   value_type &at(const key_type &Key) { return Content.at(Key); }
 
   value_type &operator[](key_type &&Key) { return Content[Key]; }
@@ -386,6 +391,10 @@ public:
     return Content.batch_insert_or_assign();
   }
 
+  using BatchTryEmplacer = typename T::BatchTryEmplacer;
+
+  BatchTryEmplacer batch_try_emplace() { return Content.batch_try_emplace(); }
+
   /// \note This function should always return true
   bool isSorted() const { return Content.isSorted(); }
 
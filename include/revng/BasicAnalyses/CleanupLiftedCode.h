@@ -0,0 +1,47 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/IR/PassManager.h"
+
+class GeneratedCodeBasicInfo;
+
+/// The cleanups of the lifted code which can be performed together
+struct CleanupLiftedCodeOptions {
+  /// Erase the calls to `newpc` (see RemoveNewPCCallsPass)
+  bool RemoveNewPCCalls = false;
+
+  /// Replace calls to helpers with opaque calls clobbering the CSVs they write
+  /// (see RemoveHelperCallsPass)
+  bool RemoveHelperCalls = false;
+
+  /// Drop the debug locations of the function and of its instructions (see
+  /// RemoveDbgMetadata)
+  bool RemoveDbgMetadata = false;
+};
+
+/// Perform the cleanups selected in \p Options on \p F, visiting each of its
+/// instructions once no matter how many of them are selected.
+///
+/// \p GCBI is required only if helper calls have to be removed.
+///
+/// \return true if \p F has been changed
+bool cleanupLiftedCode(llvm::Function &F,
+                       const CleanupLiftedCodeOptions &Options,
+                       GeneratedCodeBasicInfo *GCBI);
+
+/// Runs `cleanupLiftedCode`, use it in place of a sequence of the passes
+/// performing each cleanup on its own
+class CleanupLiftedCodePass
+  : public llvm::PassInfoMixin<CleanupLiftedCodePass> {
+private:
+  CleanupLiftedCodeOptions Options;
+
+public:
+  CleanupLiftedCodePass(CleanupLiftedCodeOptions Options) : Options(Options) {}
+
+  llvm::PreservedAnalyses run(llvm::Function &F,
+                              llvm::FunctionAnalysisManager &FAM);
+};
@@ -7,12 +7,14 @@
 #include <cstdint>
 #include <map>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/Any.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/GlobalObject.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/IR/ValueHandle.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
 
@@ -312,9 +314,23 @@ public:
   llvm::SmallVector<std::pair<llvm::BasicBlock *, bool>, 4>
   blocksByPCRange(MetaAddress Start, MetaAddress End);
 
+  /// \return true if any of the values this object points to (functions,
+  ///         CSVs, dispatcher blocks, jump targets...) has been deleted or
+  ///         replaced since it has been collected
+  bool referencesChangedValues() const {
+    return llvm::any_of(Referenced, [](const auto &Entry) {
+      return static_cast<llvm::Value *>(Entry.first) != Entry.second;
+    });
+  }
+
 private:
   void parseRoot();
 
+  void track(llvm::Value *V) {
+    if (V != nullptr)
+      Referenced.emplace_back(V, V);
+  }
+
 private:
   const model::Binary *Binary;
   llvm::GlobalVariable *PC;
@@ -334,6 +350,10 @@ private:
   std::unique_ptr<ProgramCounterHandler> PCH;
   using PCToBlockMap = std::multimap<MetaAddress, llvm::BasicBlock *>;
   bool RootParsed = false;
+  /// A handle on each of the values above, along with the value it was
+  /// created on: handles are cleared when their value is deleted, and follow
+  /// it when it's replaced
+  std::vector<std::pair<llvm::WeakVH, const llvm::Value *>> Referenced;
 };
 
 template<>
@@ -360,9 +380,54 @@ public:
   Result run(llvm::Function &F, llvm::FunctionAnalysisManager &);
 };
 
+/// Holds the GCBI of the module for the whole lifetime of a legacy pass
+/// manager: being an immutable pass, it's never invalidated, so GCBI is
+/// computed once rather than each time a pass requires it after a pass which
+/// does not preserve it.
+///
+/// The cached GCBI is recomputed if the module no longer looks like the one it
+/// was computed on, i.e., if root, newpc, the program counter or the number of
+/// CSVs have changed, or if any of the values it points to, blocks included,
+/// has been deleted or replaced. Passes adding jump targets or changing the
+/// dispatcher or the CSVs in other ways have to invalidate it explicitly,
+/// through `GeneratedCodeBasicInfoWrapperPass::invalidateCache`.
+class GeneratedCodeBasicInfoCache : public llvm::ImmutablePass {
+private:
+  /// What the cached GCBI has been computed on
+  struct Key {
+    const llvm::Module *M = nullptr;
+    const model::Binary *Binary = nullptr;
+    llvm::WeakVH Root;
+    llvm::WeakVH NewPC;
+    llvm::WeakVH PC;
+    size_t CSVsCount = 0;
+
+    static Key compute(llvm::Module &M, const model::Binary &Binary);
+    bool operator==(const Key &Other) const;
+  };
+
+private:
+  std::unique_ptr<GeneratedCodeBasicInfo> GCBI;
+  Key CachedKey;
+
+public:
+  static char ID;
+
+  GeneratedCodeBasicInfoCache() : llvm::ImmutablePass(ID) {}
+
+  GeneratedCodeBasicInfo &get(llvm::Module &M, const model::Binary &Binary);
+
+  void invalidate() { GCBI.reset(); }
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+};
+
 /// Legacy pass manager pass to access GCBI.
 class GeneratedCodeBasicInfoWrapperPass : public llvm::ModulePass {
-  std::unique_ptr<GeneratedCodeBasicInfo> GCBI;
+  GeneratedCodeBasicInfoCache *Cache = nullptr;
+  GeneratedCodeBasicInfo *GCBI = nullptr;
 
 public:
   static char ID;
@@ -371,10 +436,19 @@ public:
 
   GeneratedCodeBasicInfo &getGCBI() { return *GCBI; }
 
+  /// To be invoked by passes changing the dispatcher or the set of CSVs: the
+  /// next pass requiring GCBI will have it computed from scratch
+  void invalidateCache() {
+    revng_assert(Cache != nullptr);
+    Cache->invalidate();
+    GCBI = nullptr;
+  }
+
   bool runOnModule(llvm::Module &M) override;
   void releaseMemory() override;
   void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
     AU.setPreservesAll();
     AU.addRequired<LoadModelWrapperPass>();
+    AU.addRequired<GeneratedCodeBasicInfoCache>();
   }
 };
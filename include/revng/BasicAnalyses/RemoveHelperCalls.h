@@ -9,10 +9,9 @@
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/Support/OpaqueFunctionsPool.h"
 
+/// \note to be combined with other cleanups, use CleanupLiftedCodePass
 class RemoveHelperCallsPass
   : public llvm::PassInfoMixin<RemoveHelperCallsPass> {
-  GeneratedCodeBasicInfo *GCBI = nullptr;
-
 public:
   RemoveHelperCallsPass() = default;
 
@@ -6,6 +6,7 @@
 
 #include "llvm/IR/PassManager.h"
 
+/// \note to be combined with other cleanups, use CleanupLiftedCodePass
 class RemoveNewPCCallsPass : public llvm::PassInfoMixin<RemoveNewPCCallsPass> {
 
 public:
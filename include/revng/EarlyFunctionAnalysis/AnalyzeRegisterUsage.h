@@ -71,11 +71,14 @@ public:
 extern template void RUAResults::dump<Logger<true>>(Logger<true> &,
                                                     const char *) const;
 
+/// \param MFPIterations if not null, incremented by the number of iterations
+///        of the data-flow analyses
 RUAResults analyzeRegisterUsage(llvm::Function *F,
                                 const GeneratedCodeBasicInfo &,
                                 model::Architecture::Values Architecture,
                                 llvm::Function *,
                                 llvm::Function *,
-                                llvm::Function *);
+                                llvm::Function *,
+                                size_t *MFPIterations = nullptr);
 
 } // namespace efa
@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <cstdint>
+#include <map>
+
 #include "llvm/ADT/SmallVector.h"
 
 #include "revng/EarlyFunctionAnalysis/CallHandler.h"
@@ -61,6 +64,31 @@ public:
                           llvm::Value *SymbolNamePointer) final;
 };
 
+/// What it took to analyze a function, summed over all the times it has been
+/// analyzed
+struct FunctionCost {
+  /// Times CFGAnalyzer::analyze has been run on the function
+  unsigned Analyses = 0;
+  /// Times the ABI analyses have been run on the function
+  unsigned ABIAnalyses = 0;
+  uint64_t OutlineUs = 0;
+  uint64_t OptimizationUs = 0;
+  uint64_t ABIAnalysesUs = 0;
+  /// Iterations of the data-flow analyses run by the ABI analyses
+  size_t MFPIterations = 0;
+  /// Size of the last CFG that has been recovered
+  size_t Blocks = 0;
+  /// Indirect branches found the last time the function has been analyzed
+  size_t IndirectBranches = 0;
+  /// Whether the last analysis exceeded its budget and the function has been
+  /// given a conservative summary
+  bool OverBudget = false;
+
+  uint64_t totalUs() const {
+    return OutlineUs + OptimizationUs + ABIAnalysesUs;
+  }
+};
+
 /// This class, given an Oracle, analyzes a function returning its CFG, the set
 /// of callee saved registers, whether it's noreturn or not and its final stack
 /// offset
@@ -88,6 +116,8 @@ private:
   std::unique_ptr<llvm::raw_ostream> OutputAAWriter;
   std::unique_ptr<llvm::raw_ostream> OutputIBI;
 
+  std::map<MetaAddress, FunctionCost> Costs;
+
 public:
   CFGAnalyzer(llvm::Module &M,
               GeneratedCodeBasicInfo &GCBI,
@@ -100,6 +130,9 @@ public:
   llvm::Function *retHook() const { return RetHook.get(); }
   const auto &abiCSVs() const { return ABICSVs; }
 
+  FunctionCost &cost(const MetaAddress &Entry) { return Costs[Entry]; }
+  const std::map<MetaAddress, FunctionCost> &costs() const { return Costs; }
+
 public:
   FunctionSummary analyze(const MetaAddress &Entry);
 
@@ -121,7 +154,9 @@ private:
 
   void materializePCValues(llvm::Function *F, llvm::IRBuilder<> &);
 
-  void runOptimizationPipeline(llvm::Function *F);
+  /// \return false if the time budget ran out before the whole pipeline could
+  ///         run
+  bool runOptimizationPipeline(llvm::Function *F);
 
   FunctionSummary milkInfo(OutlinedFunction *F,
                            SortedVector<efa::BasicBlock> &&CFG);
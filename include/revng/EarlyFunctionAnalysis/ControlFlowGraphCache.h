@@ -4,9 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/PassManager.h"
 #include "llvm/Pass.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/EarlyFunctionAnalysis/CFGStringMap.h"
 #include "revng/EarlyFunctionAnalysis/ControlFlowGraph.h"
@@ -54,35 +60,79 @@ concept ControlFlowGraphCacheTraits = requires {
   } -> std::same_as<MetaAddress>;
 };
 
+/// Maximum number of CFGs deserialized from the CFGMap that a
+/// ControlFlowGraphCache keeps around (0 means no limit)
+extern llvm::cl::opt<unsigned> ControlFlowGraphCacheSize;
+
 /// The BasicControlFlowGraphCache is implemented as a class template customised
 /// via a traits class in order to enable reuse for both LLVM IR and MLIR.
+///
+/// If ControlFlowGraphCacheSize is set, the least recently used CFGs coming
+/// from the CFGMap are dropped once there's too many of them, and have to be
+/// deserialized again the next time they're requested. A reference returned by
+/// getControlFlowGraph is therefore valid only until that many other CFGs have
+/// been requested. CFGs provided through `set` are never dropped.
+///
+/// All the methods can be called concurrently.
 template<ControlFlowGraphCacheTraits Traits>
 class BasicControlFlowGraphCache {
   using BasicBlock = typename Traits::BasicBlock;
   using Function = typename Traits::Function;
   using CallInst = typename Traits::CallInst;
 
+  struct Entry {
+    TupleTree<efa::ControlFlowGraph> CFG;
+
+    /// Position in LRU, unless the entry has been provided through `set`
+    std::optional<std::list<MetaAddress>::iterator> LRUPosition;
+  };
+
   const revng::pipes::CFGMap &CFGs;
-  std::map<MetaAddress, TupleTree<efa::ControlFlowGraph>> Deserialized;
+  std::map<MetaAddress, Entry> Deserialized;
+
+  /// The entries that can be dropped, the most recently used first
+  std::list<MetaAddress> LRU;
+
+  std::mutex Mutex;
 
 public:
   BasicControlFlowGraphCache(const revng::pipes::CFGMap &CFGs) : CFGs(CFGs) {}
 
 public:
   void set(TupleTree<efa::ControlFlowGraph> &&New) {
-    Deserialized[New->Entry()] = std::move(New);
+    std::lock_guard Lock(Mutex);
+    Entry &Slot = Deserialized[New->Entry()];
+    if (Slot.LRUPosition)
+      LRU.erase(*Slot.LRUPosition);
+    Slot.LRUPosition.reset();
+    Slot.CFG = std::move(New);
   }
 
 public:
   const efa::ControlFlowGraph &getControlFlowGraph(const MetaAddress &Address) {
+    std::lock_guard Lock(Mutex);
+
     auto It = Deserialized.find(Address);
-    if (It != Deserialized.end())
-      return *It->second.get();
+    if (It != Deserialized.end()) {
+      // Move to the front of the LRU list
+      if (It->second.LRUPosition)
+        LRU.splice(LRU.begin(), LRU, *It->second.LRUPosition);
+      return *It->second.CFG.get();
+    }
+
+    using CFGTree = TupleTree<efa::ControlFlowGraph>;
+    Entry &Result = Deserialized[Address];
+    Result.CFG = CFGTree::deserialize(CFGs.at(Address)).get();
+    Result.LRUPosition = LRU.insert(LRU.begin(), Address);
+
+    if (ControlFlowGraphCacheSize != 0) {
+      while (LRU.size() > ControlFlowGraphCacheSize) {
+        Deserialized.erase(LRU.back());
+        LRU.pop_back();
+      }
+    }
 
-    TupleTree<efa::ControlFlowGraph> &Result = Deserialized[Address];
-    Result = TupleTree<efa::ControlFlowGraph>::deserialize(CFGs.at(Address))
-               .get();
-    return *Result.get();
+    return *Result.CFG.get();
   }
 
   const efa::ControlFlowGraph &getControlFlowGraph(const Function Function) {
@@ -5,6 +5,10 @@
 //
 
 #include <set>
+#include <unordered_map>
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringMap.h"
 
 #include "revng/ADT/MutableSet.h"
 #include "revng/EarlyFunctionAnalysis/AnalyzeRegisterUsage.h"
@@ -137,18 +141,34 @@ private:
   const model::Binary &Binary;
   PrototypeImporter Importer;
 
+  // Note: all the following containers are hash tables, since they're queried
+  //       for each call site of each analyzed function. They all need to
+  //       preserve references to their elements upon insertion, which rules
+  //       out llvm::DenseMap.
+
+  using CallSiteKey = std::pair<MetaAddress, BasicBlockID>;
+  struct CallSiteKeyHash {
+    size_t operator()(const CallSiteKey &Key) const {
+      std::hash<MetaAddress> Hash;
+      return llvm::hash_combine(Hash(Key.first),
+                                Hash(Key.second.start()),
+                                Key.second.inliningIndex());
+    }
+  };
+
   /// Call site-specific overrides
   ///
   /// Key is composed by <FunctionEntryPoint, CallSiteBasicBlockAddress>
   /// Value is composed by <FunctionSummary, IsTailCall>
   using CallSiteDescriptor = std::pair<FunctionSummary, bool>;
-  std::map<std::pair<MetaAddress, BasicBlockID>, CallSiteDescriptor> CallSites;
+  std::unordered_map<CallSiteKey, CallSiteDescriptor, CallSiteKeyHash>
+    CallSites;
 
   /// Local functions
-  std::map<MetaAddress, FunctionSummary> LocalFunctions;
+  std::unordered_map<MetaAddress, FunctionSummary> LocalFunctions;
 
   /// Dynamic functions
-  std::map<std::string, FunctionSummary> DynamicFunctions;
+  llvm::StringMap<FunctionSummary> DynamicFunctions;
 
   /// Default
   std::optional<FunctionSummary> Default;
@@ -209,7 +229,9 @@ public:
   void setDefault(FunctionSummary &&Summary) { Default = std::move(Summary); }
 
   const FunctionSummary &getDynamicFunction(llvm::StringRef Name) const {
-    return DynamicFunctions.at(Name.str());
+    auto It = DynamicFunctions.find(Name);
+    revng_assert(It != DynamicFunctions.end());
+    return It->second;
   }
 
   std::pair<FunctionSummary *, bool> getExactCallSite(MetaAddress Function,
@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <tuple>
+
 #include "llvm/IR/Module.h"
 #include "llvm/Support/ModRef.h"
 #include "llvm/Transforms/Utils/CodeExtractor.h"
@@ -79,7 +82,7 @@ class Outliner {
 private:
   llvm::Module &M;
   GeneratedCodeBasicInfo &GCBI;
-  FunctionSummaryOracle &Oracle;
+  FunctionSummaryOracle *Oracle = nullptr;
 
   /// UnexpectedPCMarker is used to indicate that `unexpectedpc` basic
   /// block of a function to inline need to be adjusted to jump to
@@ -90,13 +93,25 @@ private:
 
   llvm::CodeExtractorAnalysisCache CEAC;
 
+  using CallSiteInfo = std::pair<const FunctionSummary *, bool>;
+  using CallSiteInfoKey = std::tuple<MetaAddress,
+                                     BasicBlockID,
+                                     MetaAddress,
+                                     llvm::StringRef>;
+
+  /// Results of getCallSiteInfo during the current call to outline. The oracle
+  /// does not change while outlining, and each call site is queried several
+  /// times: when collecting the blocks to clone, when fixing up their
+  /// terminators and when integrating the callee.
+  std::map<CallSiteInfoKey, CallSiteInfo> CallSiteInfoCache;
+
 public:
   Outliner(llvm::Module &M,
            GeneratedCodeBasicInfo &GCBI,
            FunctionSummaryOracle &Oracle) :
     M(M),
     GCBI(GCBI),
-    Oracle(Oracle),
+    Oracle(&Oracle),
     UnexpectedPCMarker(initializeUnexpectedPCMarker(M)),
     OpaqueReturnAddress(&M, false),
     CEAC(*M.getFunction("root")) {
@@ -116,6 +131,12 @@ public:
   OutlinedFunction outline(const MetaAddress &EntryAddress,
                            CallHandler *TheCallHandler);
 
+  /// Query \p NewOracle from now on
+  ///
+  /// What has been computed about root on construction, which is the most
+  /// expensive part of creating an Outliner, is preserved.
+  void setOracle(FunctionSummaryOracle &NewOracle) { Oracle = &NewOracle; }
+
 private:
   static TemporaryOpaqueFunction initializeUnexpectedPCMarker(llvm::Module &M) {
     return { llvm::FunctionType::get(llvm::Type::getVoidTy(M.getContext()),
@@ -75,10 +75,15 @@ public:
 
   /// Specifies the minimum possible distance between two edges.
   layout::Dimension EdgeMarginSize;
+
+public:
+  bool operator==(const Configuration &) const = default;
 };
 
 namespace detail {
 
+/// \note layouts are cached: laying out again a graph with the same topology,
+///       node sizes and configuration as a recent one just copies its result.
 bool computeImpl(InternalGraph &Internal, const Configuration &Configuration);
 
 } // namespace detail
@@ -154,6 +154,7 @@ public:
     using EdgeRef = typename LLVMTrait::EdgeRef;
 
     InternalGraph Result;
+    Result.allocateNodesInArena();
     OutputLookups<NodeRef, EdgeRef> Lookup;
     Lookup.Nodes.reserve(LLVMTrait::size(Graph));
 
@@ -4,21 +4,26 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <compare>
 #include <cstddef>
+#include <functional>
 #include <map>
+#include <numeric>
 #include <queue>
 #include <type_traits>
+#include <vector>
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/GraphTraits.h"
 #include "llvm/ADT/PostOrderIterator.h"
-#include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/Concepts.h"
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/ReversePostOrderTraversal.h"
+#include "revng/Support/Assert.h"
 
 namespace MFP {
 
@@ -50,6 +55,19 @@ concept MonotoneFrameworkInstance = requires(const MFI &I,
   { I.applyTransferFunction(L, E2) } -> std::same_as<LatticeElement>;
 };
 
+/// An instance of a monotone framework that can combine \p Source into \p
+/// Destination in place, without creating a new lattice element.
+///
+/// `combineInto` must have the effect of
+/// `Destination = combineValues(Destination, Source)` and return whether
+/// `Destination` changed, that is `not isLessOrEqual(Source, Destination)`.
+template<typename MFI, typename LatticeElement = typename MFI::LatticeElement>
+concept HasInPlaceCombine = requires(const MFI &I,
+                                     LatticeElement &Destination,
+                                     const LatticeElement &Source) {
+  { I.combineInto(Destination, Source) } -> std::same_as<bool>;
+};
+
 template<typename Label, typename LatticeElement>
 using ResultMap = std::map<Label, MFPResult<LatticeElement>>;
 
@@ -57,77 +75,161 @@ template<MonotoneFrameworkInstance MFI>
 using MFIResultMap = ResultMap<typename MFI::Label,
                                typename MFI::LatticeElement>;
 
+/// The results of an MFP analysis, stored contiguously and indexed by the
+/// number assigned to each label
+///
+/// Labels visited by the analysis are numbered in reverse post order, which is
+/// also the order in which they are prioritized in the worklist.
+template<typename Label, typename LatticeElement>
+class DenseResultMap {
+private:
+  llvm::DenseMap<Label, size_t> Indices;
+  std::vector<Label> Labels;
+  std::vector<MFPResult<LatticeElement>> Results;
+
+public:
+  size_t size() const { return Labels.size(); }
+
+  bool contains(Label L) const { return Indices.contains(L); }
+
+  /// \return the number assigned to \p L
+  size_t indexOf(Label L) const {
+    auto It = Indices.find(L);
+    revng_assert(It != Indices.end());
+    return It->second;
+  }
+
+  const std::vector<Label> &labels() const { return Labels; }
+
+  MFPResult<LatticeElement> &operator[](size_t Index) {
+    return Results[Index];
+  }
+  const MFPResult<LatticeElement> &operator[](size_t Index) const {
+    return Results[Index];
+  }
+
+  MFPResult<LatticeElement> &at(Label L) { return Results[indexOf(L)]; }
+  const MFPResult<LatticeElement> &at(Label L) const {
+    return Results[indexOf(L)];
+  }
+
+  /// \return the index assigned to \p L, numbering it if necessary
+  ///
+  /// Newly numbered labels get \p InValue as their initial value.
+  size_t getOrNumber(Label L, const LatticeElement &InValue) {
+    auto [It, IsNew] = Indices.try_emplace(L, Labels.size());
+    if (IsNew) {
+      Labels.push_back(L);
+      Results.emplace_back();
+      Results.back().InValue = InValue;
+    }
+    return It->second;
+  }
+
+  ResultMap<Label, LatticeElement> toMap() && {
+    ResultMap<Label, LatticeElement> Result;
+    for (size_t I = 0; I < Labels.size(); ++I)
+      Result.emplace(Labels[I], std::move(Results[I]));
+    return Result;
+  }
+};
+
+template<MonotoneFrameworkInstance MFI>
+using MFIDenseResultMap = DenseResultMap<typename MFI::Label,
+                                         typename MFI::LatticeElement>;
+
 /// Compute the maximum fixed points of an instance of monotone framework GT an
 /// instance of llvm::GraphTraits that tells us how to visit the graph LGT a
 /// graph type that tells us how to visit the subgraph induced by a node in the
 /// graph. This is needed for the RPOT because for certain graph (e.g.
 /// Inverse<...>) the nodes don't necessary carry all the information that
 /// GraphType has.
+///
+/// Labels are numbered once, lattice values are kept in vectors and the
+/// worklist is a heap of label numbers, so that iterating doesn't allocate.
+///
+/// If \p Iterations is not null, it's incremented by the number of times a
+/// transfer function has been applied.
 template<MonotoneFrameworkInstance MFI,
          typename GT = llvm::GraphTraits<typename MFI::GraphType>,
          typename LGT = typename MFI::Label>
-MFIResultMap<MFI>
-getMaximalFixedPoint(const MFI &Instance,
-                     typename MFI::GraphType Flow,
-                     typename MFI::LatticeElement InitialValue,
-                     typename MFI::LatticeElement ExtremalValue,
-                     const std::vector<typename MFI::Label> &ExtremalLabels,
-                     const std::vector<typename MFI::Label> &InitialNodes) {
+MFIDenseResultMap<MFI>
+getDenseMaximalFixedPoint(const MFI &Instance,
+                          typename MFI::GraphType Flow,
+                          typename MFI::LatticeElement InitialValue,
+                          typename MFI::LatticeElement ExtremalValue,
+                          const std::vector<typename MFI::Label>
+                            &ExtremalLabels,
+                          const std::vector<typename MFI::Label>
+                            &InitialNodes,
+                          size_t *Iterations = nullptr) {
   using Label = typename MFI::Label;
-  using LatticeElement = typename MFI::LatticeElement;
-
-  std::map<Label, LatticeElement> PartialAnalysis;
-  std::map<Label, MFPResult<LatticeElement>> AnalysisResult;
-
-  struct WorklistItem {
-    size_t Priority;
-    Label Item;
-
-    std::strong_ordering operator<=>(const WorklistItem &) const = default;
-  };
-  std::set<WorklistItem> Worklist;
 
-  llvm::SmallSet<Label, 8> Visited{};
-  std::map<Label, size_t> LabelPriority;
+  MFIDenseResultMap<MFI> AnalysisResult;
 
   //
-  // Initialize the worklist and extremal labels
+  // Number the labels in reverse post order, launching a visit from each
+  // remaining node
   //
-  for (Label ExtremalLabel : ExtremalLabels) {
-    AnalysisResult[ExtremalLabel].InValue = ExtremalValue;
-  }
-
+  llvm::DenseSet<Label> Visited;
   for (Label Start : InitialNodes) {
     if (!Visited.contains(Start)) {
-      // Fill the worklist with nodes in reverse post order launching a visit
-      // from each remaining node
-      ReversePostOrderTraversalExt<LGT, GT, llvm::SmallSet<Label, 8>>
+      ReversePostOrderTraversalExt<LGT, GT, llvm::DenseSet<Label>>
         RPOTE(Start, Visited);
-      for (Label Node : RPOTE) {
-        LabelPriority[Node] = LabelPriority.size();
-        Worklist.insert({ LabelPriority.at(Node), Node });
-        // initialize the analysis value for non extremal nodes
-        if (!AnalysisResult.contains(Node))
-          AnalysisResult[Node].InValue = InitialValue;
-      }
+      for (Label Node : RPOTE)
+        AnalysisResult.getOrNumber(Node, InitialValue);
     }
   }
 
+  // We start from all the labels we visited, their number is their priority
+  size_t VisitedCount = AnalysisResult.size();
+  llvm::BitVector InWorklist(VisitedCount, true);
+  std::vector<size_t> Heap(VisitedCount);
+  std::iota(Heap.begin(), Heap.end(), 0);
+  // An ascending sequence is already a min-heap
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>>
+    Worklist(std::greater<size_t>(), std::move(Heap));
+
+  // Initialize the extremal labels
+  for (Label ExtremalLabel : ExtremalLabels) {
+    size_t Index = AnalysisResult.getOrNumber(ExtremalLabel, ExtremalValue);
+    AnalysisResult[Index].InValue = ExtremalValue;
+  }
+
   // Step 2 iteration
+  std::vector<size_t> Successors;
   while (!Worklist.empty()) {
-    WorklistItem First = *Worklist.begin();
-    Label Start = First.Item;
-    Worklist.erase(First);
-    auto &LabelAnalysis = AnalysisResult.at(Start);
+    size_t StartIndex = Worklist.top();
+    Worklist.pop();
+    InWorklist.reset(StartIndex);
+    if (Iterations != nullptr)
+      ++*Iterations;
+
+    Label Start = AnalysisResult.labels()[StartIndex];
+    auto &LabelAnalysis = AnalysisResult[StartIndex];
     LabelAnalysis
       .OutValue = Instance.applyTransferFunction(Start, LabelAnalysis.InValue);
 
     for (Label End : successors<GT>(Start)) {
-      auto &PartialEnd = AnalysisResult.at(End);
-      if (!Instance.isLessOrEqual(LabelAnalysis.OutValue, PartialEnd.InValue)) {
+      size_t EndIndex = AnalysisResult.indexOf(End);
+      revng_assert(EndIndex < VisitedCount);
+      auto &PartialEnd = AnalysisResult[EndIndex];
+      bool Changed = false;
+      if constexpr (HasInPlaceCombine<MFI>) {
+        Changed = Instance.combineInto(PartialEnd.InValue,
+                                       LabelAnalysis.OutValue);
+      } else if (!Instance.isLessOrEqual(LabelAnalysis.OutValue,
+                                         PartialEnd.InValue)) {
         PartialEnd.InValue = Instance.combineValues(PartialEnd.InValue,
                                                     LabelAnalysis.OutValue);
-        Worklist.insert({ LabelPriority.at(End), End });
+        Changed = true;
+      }
+
+      if (Changed) {
+        if (not InWorklist.test(EndIndex)) {
+          InWorklist.set(EndIndex);
+          Worklist.push(EndIndex);
+        }
       }
     }
   }
@@ -143,7 +245,29 @@ getMaximalFixedPoint(const MFI &Instance,
                      typename MFI::GraphType Flow,
                      typename MFI::LatticeElement InitialValue,
                      typename MFI::LatticeElement ExtremalValue,
-                     const std::vector<typename MFI::Label> &ExtremalLabels) {
+                     const std::vector<typename MFI::Label> &ExtremalLabels,
+                     const std::vector<typename MFI::Label> &InitialNodes,
+                     size_t *Iterations = nullptr) {
+  return getDenseMaximalFixedPoint<MFI, GT, LGT>(Instance,
+                                                 Flow,
+                                                 InitialValue,
+                                                 ExtremalValue,
+                                                 ExtremalLabels,
+                                                 InitialNodes,
+                                                 Iterations)
+    .toMap();
+}
+
+template<MonotoneFrameworkInstance MFI,
+         typename GT = llvm::GraphTraits<typename MFI::GraphType>,
+         typename LGT = typename MFI::Label>
+MFIResultMap<MFI>
+getMaximalFixedPoint(const MFI &Instance,
+                     typename MFI::GraphType Flow,
+                     typename MFI::LatticeElement InitialValue,
+                     typename MFI::LatticeElement ExtremalValue,
+                     const std::vector<typename MFI::Label> &ExtremalLabels,
+                     size_t *Iterations = nullptr) {
   using Label = typename MFI::Label;
   std::vector<Label> InitialNodes(ExtremalLabels);
 
@@ -162,7 +286,8 @@ getMaximalFixedPoint(const MFI &Instance,
                                             InitialValue,
                                             ExtremalValue,
                                             ExtremalLabels,
-                                            InitialNodes);
+                                            InitialNodes,
+                                            Iterations);
 }
 
 } // namespace MFP
@@ -231,6 +231,16 @@ public:
   /// Return the first available type ID
   uint64_t getAvailableTypeID() const;
 
+  /// Reads of the model are tracked by writing into the model itself,
+  /// therefore it can be read from multiple threads only if it's not
+  /// being tracked
+  bool isBeingTracked() const {
+    if constexpr (HasTracking)
+      return TypeDefinitions().isTrackingActive();
+    else
+      return false;
+  }
+
 public:
   /// The helper for the prototype unwrapping.
   /// Use this when you need to access/modify the existing prototype,
@@ -278,6 +288,14 @@ public:
   bool verify(bool Assert) const debug_function;
   bool verify() const debug_function;
 
+  /// Verify the model after \p Diff has been applied to it, assuming it was
+  /// valid before: only what \p Diff might have affected is verified again,
+  /// falling back to verifying everything when in doubt
+  bool verify(const TupleTreeDiff<Binary> &Diff, VerifyHelper &VH) const;
+  bool verify(const TupleTreeDiff<Binary> &Diff,
+              bool Assert) const debug_function;
+  bool verify(const TupleTreeDiff<Binary> &Diff) const debug_function;
+
   bool verifyTypeDefinitions(VerifyHelper &VH) const;
   bool verifyTypeDefinitions(bool Assert) const debug_function;
   bool verifyTypeDefinitions() const debug_function;
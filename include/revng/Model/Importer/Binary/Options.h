@@ -24,6 +24,10 @@ struct ImporterOptions {
   const bool EnableRemoteDebugInfo;
 
   const llvm::ArrayRef<std::string> AdditionalDebugInfoPaths;
+
+  /// Path or URL of the store of the models of libraries shared among
+  /// projects, see LibraryModelStore
+  const llvm::StringRef LibraryModelStoreURL;
 };
 
 [[nodiscard]] const ImporterOptions importerOptions();
@@ -32,3 +36,4 @@ extern llvm::cl::opt<uint64_t> BaseAddress;
 extern llvm::cl::list<std::string> ImportDebugInfo;
 extern llvm::cl::opt<DebugInfoLevel> DebugInfo;
 extern llvm::cl::opt<bool> EnableRemoteDebugInfo;
+extern llvm::cl::opt<std::string> LibraryModelStoreURL;
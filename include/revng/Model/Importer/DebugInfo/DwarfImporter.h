@@ -10,6 +10,19 @@
 
 struct ImporterOptions;
 
+/// \return the GNU build ID of the ELF \p B, in hexadecimal, or an empty string
+///         if it has none
+std::string getBuildID(const llvm::object::Binary *B);
+
+/// Make sure the detached debug info of the ELF \p FileName, if any, is on the
+/// device, running `fetch-debuginfo` if necessary, without importing anything.
+///
+/// Not needing a model, this can run on its own thread while \p FileName is
+/// being imported, so that `DwarfImporter::import` then finds the debug info
+/// ready.
+void prefetchDebugInfo(llvm::StringRef FileName,
+                       const ImporterOptions &Options);
+
 class DwarfImporter {
 private:
   TupleTree<model::Binary> &Model;
@@ -36,7 +49,15 @@ public:
   TupleTree<model::Binary> &getModel() { return Model; }
 
 public:
-  void import(llvm::StringRef FileName, const ImporterOptions &Options);
+  /// Import the debug info of \p FileName, from the file itself or from its
+  /// detached debug info file.
+  ///
+  /// \param FetchDebugInfo whether to run `fetch-debuginfo` if the detached
+  ///        debug info file is not on the device. Pass false if
+  ///        `prefetchDebugInfo` has already been run on \p FileName.
+  void import(llvm::StringRef FileName,
+              const ImporterOptions &Options,
+              bool FetchDebugInfo = true);
 
 private:
   void import(const llvm::object::Binary &TheBinary,
@@ -4,31 +4,101 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <limits>
 #include <optional>
 #include <utility>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 
 #include "revng/Model/Binary.h"
 #include "revng/Support/Generator.h"
 #include "revng/Support/OverflowSafeInt.h"
 
 /// Provide a view onto a raw binary through the lens of the model
+///
+/// Addresses and offsets are resolved through two indexes of the segments,
+/// sorted by start address and by start offset, built when the view is
+/// created. If segments are added to (or removed from) the model afterwards,
+/// the view falls back to scanning all of them, until `reindexSegments` is
+/// called.
 class RawBinaryView {
 private:
   using OverflowSafeInt = OverflowSafeInt<uint64_t>;
 
+  /// A half-open range of addresses (or offsets) covered by a segment
+  struct IndexEntry {
+    uint64_t Start = 0;
+    uint64_t End = 0;
+
+    /// The highest End among this entry and all the ones preceding it
+    uint64_t MaxEnd = 0;
+
+    /// Whether the range intersects the range of any other segment
+    bool Overlaps = false;
+
+    const model::Segment *Segment = nullptr;
+  };
+
 private:
   const model::Binary &Binary;
   llvm::ArrayRef<uint8_t> Data;
 
+  std::vector<IndexEntry> ByAddress;
+  std::vector<IndexEntry> ByOffset;
+
+  /// The number of segments in the model when the indexes have been built
+  size_t IndexedSegments = 0;
+
+  /// The entry of ByAddress which resolved the last address, sequential
+  /// accesses tend to hit the same segment over and over
+  mutable std::atomic<size_t> LastHit = 0;
+
 public:
   RawBinaryView(const model::Binary &Binary, llvm::StringRef Data) :
     RawBinaryView(Binary, { Data.bytes_begin(), Data.bytes_end() }) {}
 
   RawBinaryView(const model::Binary &Binary, llvm::ArrayRef<uint8_t> Data) :
-    Binary(Binary), Data(Data) {}
+    Binary(Binary), Data(Data) {
+    reindexSegments();
+  }
+
+  RawBinaryView(const RawBinaryView &Other) :
+    Binary(Other.Binary),
+    Data(Other.Data),
+    ByAddress(Other.ByAddress),
+    ByOffset(Other.ByOffset),
+    IndexedSegments(Other.IndexedSegments),
+    LastHit(Other.LastHit.load(std::memory_order_relaxed)) {}
+
+public:
+  /// Rebuild the indexes of the segments, to be called after changing the
+  /// segments of the model this view has been created from
+  void reindexSegments() {
+    ByAddress.clear();
+    ByOffset.clear();
+    LastHit.store(0, std::memory_order_relaxed);
+
+    for (const model::Segment &Segment : Binary.Segments()) {
+      uint64_t StartAddress = Segment.StartAddress().address();
+      ByAddress.push_back({ .Start = StartAddress,
+                            .End = saturatingAdd(StartAddress,
+                                                 Segment.VirtualSize()),
+                            .Segment = &Segment });
+      ByOffset.push_back({ .Start = Segment.StartOffset(),
+                           .End = saturatingAdd(Segment.StartOffset(),
+                                                Segment.FileSize()),
+                           .Segment = &Segment });
+    }
+
+    finalizeIndex(ByAddress);
+    finalizeIndex(ByOffset);
+    IndexedSegments = Binary.Segments().size();
+  }
 
 public:
   uint64_t size() { return Data.size(); }
@@ -131,16 +201,24 @@ public:
   MetaAddress offsetToAddress(uint64_t Offset) const {
     using namespace model;
 
+    auto Contains = [Offset](const Segment &Segment) {
+      return Segment.StartOffset() <= Offset and Offset < Segment.endOffset();
+    };
+
     const Segment *Match = nullptr;
-    for (const Segment &Segment : Binary.Segments()) {
-      if (Segment.StartOffset() <= Offset and Offset < Segment.endOffset()) {
-        if (Match != nullptr) {
-          // We have more than one match!
-          Match = nullptr;
-          break;
+    if (isIndexCurrent()) {
+      Match = findUnique(ByOffset, Offset, Contains);
+    } else {
+      for (const Segment &Segment : Binary.Segments()) {
+        if (Contains(Segment)) {
+          if (Match != nullptr) {
+            // We have more than one match!
+            Match = nullptr;
+            break;
+          }
+
+          Match = &Segment;
         }
-
-        Match = &Segment;
       }
     }
 
@@ -155,6 +233,19 @@ public:
   }
 
   [[nodiscard]] bool isReadOnly(MetaAddress Address, uint64_t Size) const {
+    if (isIndexCurrent()) {
+      bool Result = false;
+      visitCandidates(ByAddress, Address.address(), [&](const IndexEntry &E) {
+        if (E.Segment->contains(Address, Size)
+            and not E.Segment->IsWriteable()) {
+          Result = true;
+          return false;
+        }
+        return true;
+      });
+      return Result;
+    }
+
     for (const model::Segment &Segment : Binary.Segments()) {
       if (Segment.contains(Address, Size)) {
         if (!Segment.IsWriteable()) {
@@ -180,16 +271,20 @@ private:
   std::pair<const model::Segment *, uint64_t>
   findOffsetInSegment(MetaAddress Address, uint64_t Size) const {
     const model::Segment *Match = nullptr;
-    for (const model::Segment &Segment : Binary.Segments()) {
-      if (Segment.contains(Address, Size)) {
+    if (isIndexCurrent()) {
+      Match = findSegment(Address, Size);
+    } else {
+      for (const model::Segment &Segment : Binary.Segments()) {
+        if (Segment.contains(Address, Size)) {
 
-        if (Match != nullptr) {
-          // We have more than one match!
-          Match = nullptr;
-          break;
-        }
+          if (Match != nullptr) {
+            // We have more than one match!
+            Match = nullptr;
+            break;
+          }
 
-        Match = &Segment;
+          Match = &Segment;
+        }
       }
     }
 
@@ -202,4 +297,115 @@ private:
 
     return { nullptr, 0 };
   }
+
+  bool isIndexCurrent() const {
+    return IndexedSegments == Binary.Segments().size();
+  }
+
+  /// \return the only segment containing \p Size bytes starting at
+  ///         \p Address, if there's one and only one.
+  const model::Segment *findSegment(MetaAddress Address, uint64_t Size) const {
+    // Segments not overlapping any other cannot be ambiguous, if the last one
+    // we found still contains the address, it's the answer
+    size_t Last = LastHit.load(std::memory_order_relaxed);
+    if (Last < ByAddress.size()) {
+      const IndexEntry &Entry = ByAddress[Last];
+      if (not Entry.Overlaps and Entry.Segment->contains(Address, Size))
+        return Entry.Segment;
+    }
+
+    const model::Segment *Match = nullptr;
+    const IndexEntry *MatchEntry = nullptr;
+    visitCandidates(ByAddress, Address.address(), [&](const IndexEntry &E) {
+      if (not E.Segment->contains(Address, Size))
+        return true;
+
+      if (Match != nullptr) {
+        // We have more than one match!
+        Match = nullptr;
+        return false;
+      }
+
+      Match = E.Segment;
+      MatchEntry = &E;
+      return true;
+    });
+
+    if (Match != nullptr)
+      LastHit.store(MatchEntry - ByAddress.data(), std::memory_order_relaxed);
+
+    return Match;
+  }
+
+  template<typename PredicateType>
+  static const model::Segment *findUnique(llvm::ArrayRef<IndexEntry> Index,
+                                          uint64_t Position,
+                                          PredicateType &&Predicate) {
+    const model::Segment *Match = nullptr;
+    visitCandidates(Index, Position, [&](const IndexEntry &E) {
+      if (not Predicate(*E.Segment))
+        return true;
+
+      if (Match != nullptr) {
+        // We have more than one match!
+        Match = nullptr;
+        return false;
+      }
+
+      Match = E.Segment;
+      return true;
+    });
+    return Match;
+  }
+
+  /// Call \p Visitor on all the entries of \p Index whose range contains
+  /// \p Position, until it returns false.
+  template<typename VisitorType>
+  static void visitCandidates(llvm::ArrayRef<IndexEntry> Index,
+                              uint64_t Position,
+                              VisitorType &&Visitor) {
+    auto IsBefore = [](uint64_t Value, const IndexEntry &Entry) {
+      return Value < Entry.Start;
+    };
+
+    // Walk backwards from the last range starting at or before Position, as
+    // long as some range can still reach it
+    auto It = std::upper_bound(Index.begin(), Index.end(), Position, IsBefore);
+    while (It != Index.begin()) {
+      --It;
+      if (It->MaxEnd <= Position)
+        break;
+
+      if (Position < It->End and not Visitor(*It))
+        break;
+    }
+  }
+
+  static void finalizeIndex(std::vector<IndexEntry> &Index) {
+    llvm::stable_sort(Index, [](const IndexEntry &LHS, const IndexEntry &RHS) {
+      return LHS.Start < RHS.Start;
+    });
+
+    uint64_t MaxEnd = 0;
+    for (IndexEntry &Entry : Index) {
+      // Since entries are sorted by start, any range overlapping this one and
+      // preceding it reaches beyond its start
+      Entry.Overlaps = MaxEnd > Entry.Start;
+      MaxEnd = std::max(MaxEnd, Entry.End);
+      Entry.MaxEnd = MaxEnd;
+    }
+
+    // Symmetrically, a range overlapping a later one overlaps the next one
+    for (size_t I = 0; I + 1 < Index.size(); ++I) {
+      if (Index[I + 1].Start < Index[I].End) {
+        Index[I].Overlaps = true;
+        Index[I + 1].Overlaps = true;
+      }
+    }
+  }
+
+  static uint64_t saturatingAdd(uint64_t LHS, uint64_t RHS) {
+    auto Sum = OverflowSafeInt(LHS) + RHS;
+    return Sum ? *Sum : std::numeric_limits<uint64_t>::max();
+  }
 };
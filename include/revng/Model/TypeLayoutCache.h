@@ -0,0 +1,60 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+
+#include "revng/Model/ABI.h"
+#include "revng/Model/VerifyHelper.h"
+
+namespace model {
+
+class TypeDefinition;
+
+/// For the duration of its lifetime, memoizes the sizes and the alignments of
+/// the type definitions computed on the current thread by the methods that do
+/// not take an explicit cache, such as `size()`, `trySize()` and
+/// `abi::Definition::alignment`. Scopes can be nested, only the innermost one
+/// is used.
+///
+/// \note results are keyed by the address of the type definitions: the model
+///       must not be modified while a scope is alive. Use it where the model is
+///       known to be read-only, e.g., the one from `getReadOnlyModel()`.
+class TypeLayoutCache {
+public:
+  struct AlignmentInfo {
+    uint64_t Value;
+    bool IsNatural;
+  };
+  using AlignmentCache = std::unordered_map<const model::TypeDefinition *,
+                                            AlignmentInfo>;
+
+private:
+  VerifyHelper Sizes;
+  std::map<model::ABI::Values, AlignmentCache> Alignments;
+  TypeLayoutCache *Previous = nullptr;
+
+public:
+  TypeLayoutCache();
+  ~TypeLayoutCache();
+
+  TypeLayoutCache(const TypeLayoutCache &) = delete;
+  TypeLayoutCache &operator=(const TypeLayoutCache &) = delete;
+
+public:
+  /// \return the innermost cache of the current thread, if any
+  static TypeLayoutCache *current();
+
+public:
+  VerifyHelper &sizes() { return Sizes; }
+
+  AlignmentCache &alignments(model::ABI::Values ABI) {
+    return Alignments[ABI];
+  }
+};
+
+} // namespace model
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
 #include "llvm/ADT/SmallPtrSet.h"
 
 #include "revng/Model/Segment.h"
@@ -55,7 +57,11 @@ private:
 public:
   /// Generate a graph representation of a given type. Nodes in this graph are
   /// model types, and edges connect fields to their respective TypeDefinitions.
-  void print(const model::TypeDefinition &T);
+  ///
+  /// If \p MaxDepth is specified, only the types at most \p MaxDepth edges
+  /// away from \p T are emitted.
+  void print(const model::TypeDefinition &T,
+             std::optional<unsigned> MaxDepth = std::nullopt);
 
   /// Generate a graph of the types for the given function (Prototype,
   /// StackFrame, ...).
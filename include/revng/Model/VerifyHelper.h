@@ -4,11 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <set>
+#include <string>
 #include <type_traits>
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -69,12 +73,23 @@ private:
 
   friend class VerifyHelper;
 
+public:
+  /// Produces the path of the object defining a global symbol. It's invoked
+  /// only to report a clash, since building paths is expensive.
+  using SymbolPathGetter = std::function<std::string()>;
+
+private:
+  using GlobalSymbolsMap = llvm::StringMap<SymbolPathGetter>;
+
 private:
   std::set<const model::TypeDefinition *> VerifiedCache;
   std::map<const model::TypeDefinition *, uint64_t> SizeCache;
   std::set<const model::TypeDefinition *> InProgress;
   bool AssertOnFail = false;
-  std::map<model::Identifier, std::string> GlobalSymbols;
+  bool LogFailures = true;
+  /// Allocated upon the first registration and shared with the forked
+  /// VerifyHelpers, which only query it
+  std::shared_ptr<GlobalSymbolsMap> GlobalSymbols;
   bool HasPushedTracking = false;
 
   // TODO: This is a hack for now, but the methods, when the Model does not
@@ -100,6 +115,31 @@ public:
     return TrackingSuspender<T>(*this, Trackable);
   }
 
+public:
+  /// Prepare this (fresh) VerifyHelper to verify, on another thread, part of
+  /// what \p Parent is verifying.
+  ///
+  /// The global namespace of \p Parent is inherited, so \p Parent must have
+  /// already registered it. Tracking is assumed to be already handled by
+  /// \p Parent. Failures never assert nor are logged: the caller is expected
+  /// to reproduce them on \p Parent.
+  void forkFrom(const VerifyHelper &Parent) {
+    revng_assert(VerifiedCache.empty() and InProgress.empty());
+    GlobalSymbols = Parent.GlobalSymbols;
+    AssertOnFail = false;
+    LogFailures = false;
+    HasPushedTracking = true;
+  }
+
+  /// Import all the type definitions verified by a VerifyHelper prepared with
+  /// forkFrom(*this)
+  void join(const VerifyHelper &Child) {
+    revng_assert(Child.InProgress.empty());
+    VerifiedCache.insert(Child.VerifiedCache.begin(),
+                         Child.VerifiedCache.end());
+    SizeCache.insert(Child.SizeCache.begin(), Child.SizeCache.end());
+  }
+
 public:
   void setVerified(const model::TypeDefinition &T) {
     revng_assert(not isVerified(T));
@@ -146,7 +186,7 @@ public:
 public:
   [[nodiscard]] bool isGlobalSymbol(const model::Identifier &Name) const;
   [[nodiscard]] bool registerGlobalSymbol(const model::Identifier &Name,
-                                          const std::string &Path);
+                                          SymbolPathGetter Path);
 
 public:
   bool maybeFail(bool Result) { return maybeFail(Result, {}); }
@@ -166,6 +206,12 @@ public:
     if (not Result) {
       InProgress.clear();
 
+      // The parent of a forked VerifyHelper reproduces its failures, don't
+      // bother describing them here (which might also touch the model through
+      // non-const methods)
+      if (not LogFailures)
+        return Result;
+
       {
         llvm::raw_string_ostream StringStream(ReasonBuffer);
         StringStream << Reason << "\n";
@@ -174,7 +220,7 @@ public:
 
       if (AssertOnFail) {
         revng_abort(ReasonBuffer.c_str());
-      } else {
+      } else if (LogFailures) {
         revng_log(ModelVerifyLogger, ReasonBuffer);
       }
     }
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+
 namespace ptml {
 
 namespace tags {
@@ -22,6 +24,14 @@ inline constexpr auto LocationReferences = "data-location-references";
 inline constexpr auto ActionContextLocation = "data-action-context-location";
 inline constexpr auto AllowedActions = "data-allowed-actions";
 
+/// All of the above, so that the tags using them don't need to copy their name
+inline constexpr std::array<const char *, 6> All = { Scope,
+                                                     Token,
+                                                     LocationDefinition,
+                                                     LocationReferences,
+                                                     ActionContextLocation,
+                                                     AllowedActions };
+
 } // namespace attributes
 
 namespace actions {
@@ -4,9 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <mutex>
 #include <string>
+#include <tuple>
 
 #include "revng/Model/Helpers.h"
+#include "revng/Model/TypeDefinition.h"
 #include "revng/PTML/Tag.h"
 
 namespace ptml {
@@ -30,6 +34,64 @@ std::string comment(const ::ptml::PTMLBuilder &Builder,
   return freeFormComment(Builder, V.Comment(), Indicator, Indent, WrapAt);
 }
 
+/// Memoizes the comments on the arguments and on the return values emitted by
+/// `functionComment`: they only depend on the prototype, and computing them
+/// requires its layout, while many functions share the same prototype.
+///
+/// The model must not change while the cache is in use. Lookups can be
+/// performed from multiple threads.
+///
+/// \note as for `abi::FunctionType::LayoutCache`, the prototype is only read
+///       the first time its comments are rendered: don't share a cache across
+///       tracking scopes (see `revng::Tracking`).
+class FunctionCommentCache {
+public:
+  struct PrototypeComments {
+    std::string Arguments;
+    std::string ReturnValues;
+  };
+
+private:
+  /// Prototype, comment indicator, indentation, wrapping width and whether
+  /// PTML tags are omitted
+  using Key = std::tuple<model::TypeDefinition::Key,
+                         std::string,
+                         size_t,
+                         size_t,
+                         bool>;
+
+private:
+  std::mutex Mutex;
+  std::map<Key, PrototypeComments> Comments;
+
+public:
+  FunctionCommentCache() = default;
+  FunctionCommentCache(const FunctionCommentCache &) = delete;
+  FunctionCommentCache &operator=(const FunctionCommentCache &) = delete;
+
+public:
+  template<typename F>
+  const PrototypeComments &get(const Key &TheKey, const F &Compute) {
+    {
+      std::lock_guard Lock(Mutex);
+      auto It = Comments.find(TheKey);
+      if (It != Comments.end())
+        return It->second;
+    }
+
+    // Render without holding the lock: if another thread got here first, the
+    // result is the same anyway. Elements of `std::map` are never moved.
+    PrototypeComments Result = Compute();
+    std::lock_guard Lock(Mutex);
+    return Comments.try_emplace(TheKey, std::move(Result)).first->second;
+  }
+
+  void clear() {
+    std::lock_guard Lock(Mutex);
+    Comments.clear();
+  }
+};
+
 /// Emits PTML containing a comment for a function constructed based on
 /// the model representation of both the function and its type.
 ///
@@ -47,6 +109,8 @@ std::string comment(const ::ptml::PTMLBuilder &Builder,
 /// \param WrapAt the expected width of a line within the emitted comment.
 /// \param Indentation the number of spaces appended **before** the comment as
 ///        an indentation token (see `ptml::tokens::Indentation`).
+/// \param Cache if not null, used to render the comments on the arguments and
+///        on the return values of each prototype only once.
 ///
 /// \returns a serialized PTML string containing the comment.
 std::string functionComment(const ::ptml::PTMLBuilder &B,
@@ -54,6 +118,7 @@ std::string functionComment(const ::ptml::PTMLBuilder &B,
                             const model::Binary &Binary,
                             llvm::StringRef CommentIndicator,
                             size_t Indentation,
-                            size_t WrapAt);
+                            size_t WrapAt,
+                            FunctionCommentCache *Cache = nullptr);
 
 } // namespace ptml
@@ -7,8 +7,13 @@
 #include <algorithm>
 #include <climits>
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/Concepts.h"
 #include "revng/PTML/Constants.h"
@@ -22,10 +27,24 @@ class PTMLBuilder;
 struct ScopeTag;
 
 class Tag {
+private:
+  struct Attribute {
+    /// One of `attributes::All`, if the name is among them, which spares us
+    /// from copying it into `OwnedName`
+    const char *KnownName = nullptr;
+    std::string OwnedName;
+    std::string Value;
+
+    llvm::StringRef name() const {
+      return KnownName != nullptr ? llvm::StringRef(KnownName) :
+                                    llvm::StringRef(OwnedName);
+    }
+  };
+
 private:
   std::string TheTag;
   std::string Content;
-  llvm::StringMap<std::string> Attributes;
+  llvm::SmallVector<Attribute, 2> Attributes;
 
   friend class PTMLBuilder;
 
@@ -47,7 +66,7 @@ public:
     if (TheTag.empty())
       return *this;
 
-    Attributes[Name] = Value.str();
+    attribute(Name).Value = Value.str();
     return *this;
   }
 
@@ -58,7 +77,7 @@ public:
 
     for (auto &Value : Values)
       revng_check(!llvm::StringRef(Value).contains(","));
-    Attributes[Name] = llvm::join(Values, ",");
+    attribute(Name).Value = llvm::join(Values, ",");
     return *this;
   }
 
@@ -72,25 +91,63 @@ public:
     return this->addListAttribute(Name, Values);
   }
 
-  std::string open() const {
+  /// Write the opening tag, with its attributes, to \p OS
+  void emitOpen(llvm::raw_ostream &OS) const {
     if (TheTag.empty())
-      return "";
-
-    llvm::SmallString<128> Out;
-    Out.append({ "<", TheTag });
-    for (auto &Pair : Attributes)
-      Out.append({ " ", Pair.first(), "=\"", Pair.second, "\"" });
-    Out.append({ '>' });
-    return Out.str().str();
+      return;
+
+    OS << '<' << TheTag;
+    for (const Attribute &A : Attributes)
+      OS << ' ' << A.name() << "=\"" << A.Value << '"';
+    OS << '>';
   }
 
-  std::string close() const {
+  /// Write the closing tag to \p OS
+  void emitClose(llvm::raw_ostream &OS) const {
+    if (not TheTag.empty())
+      OS << "</" << TheTag << '>';
+  }
+
+  /// Write the whole tag to \p OS, without building it in a string first
+  void emit(llvm::raw_ostream &OS) const {
+    emitOpen(OS);
+    OS << Content;
+    emitClose(OS);
+  }
+
+  /// \return the size of the serialized tag
+  size_t serializedSize() const {
     if (TheTag.empty())
-      return "";
-    return "</" + TheTag + ">";
+      return Content.size();
+
+    // <TheTag ...>Content</TheTag>
+    size_t Result = 2 * TheTag.size() + Content.size() + 5;
+    for (const Attribute &A : Attributes)
+      Result += A.name().size() + A.Value.size() + 4;
+    return Result;
+  }
+
+  std::string open() const {
+    std::string Result;
+    llvm::raw_string_ostream OS(Result);
+    emitOpen(OS);
+    return Result;
+  }
+
+  std::string close() const {
+    std::string Result;
+    llvm::raw_string_ostream OS(Result);
+    emitClose(OS);
+    return Result;
   }
 
-  std::string serialize() const { return open() + Content + close(); }
+  std::string serialize() const {
+    std::string Result;
+    Result.reserve(serializedSize());
+    llvm::raw_string_ostream OS(Result);
+    emit(OS);
+    return Result;
+  }
 
   void dump() const debug_function { dump(dbg); }
 
@@ -98,23 +155,52 @@ public:
   void dump(T &Output) const {
     Output << serialize();
   }
+
+private:
+  Attribute &attribute(llvm::StringRef Name) {
+    for (Attribute &A : Attributes)
+      if (A.name() == Name)
+        return A;
+
+    Attribute &Result = Attributes.emplace_back();
+    auto It = llvm::find_if(attributes::All, [Name](const char *Known) {
+      return Name == Known;
+    });
+    if (It != attributes::All.end())
+      Result.KnownName = *It;
+    else
+      Result.OwnedName = Name.str();
+    return Result;
+  }
 };
 
+inline llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, const Tag &TheTag) {
+  TheTag.emit(OS);
+  return OS;
+}
+
 inline std::string operator+(const Tag &LHS, const llvm::StringRef RHS) {
-  return LHS.serialize() + RHS.str();
+  std::string Result;
+  Result.reserve(LHS.serializedSize() + RHS.size());
+  llvm::raw_string_ostream OS(Result);
+  OS << LHS << RHS;
+  return Result;
 }
 
 inline std::string operator+(const llvm::StringRef LHS, const Tag &RHS) {
-  return LHS.str() + RHS.serialize();
+  std::string Result;
+  Result.reserve(LHS.size() + RHS.serializedSize());
+  llvm::raw_string_ostream OS(Result);
+  OS << LHS << RHS;
+  return Result;
 }
 
 inline std::string operator+(const Tag &LHS, const Tag &RHS) {
-  return LHS.serialize() + RHS.serialize();
-}
-
-inline llvm::raw_ostream &operator<<(llvm::raw_ostream &OS, const Tag &TheTag) {
-  OS << TheTag.serialize();
-  return OS;
+  std::string Result;
+  Result.reserve(LHS.serializedSize() + RHS.serializedSize());
+  llvm::raw_string_ostream OS(Result);
+  OS << LHS << RHS;
+  return Result;
 }
 
 /// Helper class that allows RAII-style handling of content-less tags, opening
@@ -137,7 +223,7 @@ private:
 private:
   ScopeTag(llvm::raw_ostream &OS, const Tag &TheTag, bool Newline) :
     OS(OS), TagClose(TheTag.close()) {
-    OS << TheTag.open();
+    TheTag.emitOpen(OS);
     if (Newline)
       OS << "\n";
   }
@@ -27,6 +27,7 @@ private:
   std::string Name;
   using Container = std::vector<AnalysisReference>;
   Container Analyses;
+  bool DeferInvalidation = false;
 
 public:
   using iterator = Container::iterator;
@@ -34,8 +35,11 @@ public:
 
 public:
   AnalysesList(llvm::StringRef Name,
-               llvm::ArrayRef<AnalysisReference> Analyses = {}) :
-    Name(Name.str()), Analyses(Analyses) {}
+               llvm::ArrayRef<AnalysisReference> Analyses = {},
+               bool DeferInvalidation = false) :
+    Name(Name.str()),
+    Analyses(Analyses),
+    DeferInvalidation(DeferInvalidation) {}
 
   iterator begin() { return Analyses.begin(); }
   iterator end() { return Analyses.end(); }
@@ -50,6 +54,17 @@ public:
   const AnalysisReference &at(size_t Index) const { return Analyses.at(Index); }
 
   llvm::StringRef getName() const { return Name; }
+
+  /// Whether the changes of all the analyses of the list are collected and
+  /// turned into invalidations once, after the last one has run, rather than
+  /// after each of them.
+  ///
+  /// \note the analyses of such a list do not see the invalidations due to the
+  ///       ones running before them: this is suitable only for lists whose
+  ///       analyses do not consume what the previous ones invalidate (e.g.,
+  ///       because they run on a new project, where nothing has been produced
+  ///       yet).
+  bool defersInvalidation() const { return DeferInvalidation; }
 };
 
 } // namespace pipeline
@@ -5,6 +5,7 @@
 //
 
 #include <memory>
+#include <optional>
 #include <system_error>
 #include <type_traits>
 #include <vector>
@@ -98,6 +99,12 @@ public:
   /// targets are currently available inside the current container.
   virtual TargetsList enumerate() const = 0;
 
+  /// \return true if enumerate() contains \p Target. Containers that can look
+  /// up a single target without enumerating all of them should override it.
+  virtual bool contains(const Target &Target) const {
+    return enumerate().contains(Target);
+  }
+
   /// The implementation must ensure that
   /// not after(this)->enumerate().contains(Targets);
   ///
@@ -123,6 +130,32 @@ public:
   /// loaded from the provided path.
   virtual llvm::Error load(const revng::FilePath &Path);
 
+  /// Like store, but used when the file is only going to be read back by
+  /// loadCached, such as when persisting the content of an execution
+  /// directory. Containers can override it to use a representation that is
+  /// faster to load than the one produced by serialize.
+  virtual llvm::Error storeCached(const revng::FilePath &Path) const {
+    return store(Path);
+  }
+
+  /// Loads a file produced by storeCached.
+  virtual llvm::Error loadCached(const revng::FilePath &Path) {
+    return load(Path);
+  }
+
+  /// Like loadCached, but only \p Targets are required to be loaded, which
+  /// allows containers to avoid reading the whole file when only a few of its
+  /// targets are needed. Loading more is fine.
+  virtual llvm::Error loadCachedFiltered(const revng::FilePath &Path,
+                                         const TargetsList &Targets) {
+    return loadCached(Path);
+  }
+
+  /// \return an estimate, in bytes, of the memory used by the content of this
+  /// container, or 0 if it's unknown. Containers reporting 0 are never evicted
+  /// from memory to respect a memory budget.
+  virtual size_t memoryUsage() const { return 0; }
+
   /// Checks that the content of the this container is valid.
   virtual llvm::Error verify() const { return enumerate().verify(*this); }
 
@@ -130,6 +163,13 @@ public:
   virtual llvm::Error extractOne(llvm::raw_ostream &OS,
                                  const Target &Target) const = 0;
 
+  /// Like extractOne, but returns the memory of the container holding the
+  /// serialized content of \p Target, which is valid until the container is
+  /// changed. \return std::nullopt if the container does not hold it as is.
+  virtual std::optional<llvm::StringRef> viewOne(const Target &Target) const {
+    return std::nullopt;
+  }
+
 public:
   void dump() const debug_function { cantFail(serialize(llvm::dbgs())); }
 
@@ -95,7 +95,7 @@ public:
   const Context &getContext() const { return *Ctx; }
   Context &getContext() { return *Ctx; }
 
-  bool contains(const Target &Target) const {
+  bool contains(const Target &Target) const override {
     return enumerate().contains(Target);
   }
 
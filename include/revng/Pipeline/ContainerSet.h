@@ -11,6 +11,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
@@ -34,20 +35,76 @@ namespace pipeline {
 /// step, as well as the containers containing the target extracted from each
 /// step to perform the computation.
 ///
+/// Containers found on disk by load are not deserialized right away: load only
+/// reads the list of targets stored alongside them, which is enough to answer
+/// enumeration queries. The content is deserialized the first time the
+/// container itself is accessed. Note that iterating over the set exposes the
+/// raw pointers, which are null for containers that have not been loaded yet:
+/// use contains() and enumerate(Name) to inspect them instead.
+///
+/// Containers can also be evicted: they are stored to disk and their content
+/// is dropped, leaving behind an empty container of the same type, until they
+/// are accessed again and get loaded back.
+///
+/// The set remembers where the current content of each container has been
+/// stored or loaded from, so that store can skip what's already there. Any
+/// non-const access to a container, mergeBack (unless nothing is merged) and
+/// remove are considered changes.
+///
 /// This class contains both the containers and a pointer to a factory that is
 /// used to create that container when it does not exists.
 class ContainerSet {
 private:
   using Map = llvm::StringMap<std::unique_ptr<ContainerBase>>;
 
+  /// A container that exists on disk but has not been deserialized yet
+  struct PendingLoad {
+    revng::FilePath Path;
+    TargetsList Targets;
+  };
+
+public:
+  /// What is left to do, once the containers have been serialized by
+  /// snapshot, to get the same result as store. It can be done later, possibly
+  /// from another thread, regardless of what happens to the set in the
+  /// meantime.
+  class Snapshot {
+  private:
+    friend class ContainerSet;
+
+    /// Files of a container that has not been loaded yet, to be copied over as
+    /// they are
+    struct PendingCopy {
+      const ContainerFactory *Factory = nullptr;
+      revng::FilePath Source;
+      revng::FilePath Destination;
+    };
+
+    std::vector<PendingCopy> Copies;
+    /// Files that have been written in the past but that the containers did
+    /// not write this time
+    std::vector<revng::FilePath> Removals;
+
+  public:
+    llvm::Error store() const;
+  };
+
 public:
   using const_iterator = Map::const_iterator;
   using iterator = Map::iterator;
   using value_type = Map::value_type;
 
 private:
-  Map Content;
+  // Both mutable since loading a pending container does not change the
+  // observable state of the set
+  mutable Map Content;
+  mutable llvm::StringMap<PendingLoad> Pending;
   llvm::StringMap<const ContainerFactory *> Factories;
+  /// When each container has been accessed for the last time, see
+  /// getLastAccess
+  mutable llvm::StringMap<uint64_t> LastAccess;
+  /// The file holding the current content of each container, if any
+  mutable llvm::StringMap<revng::FilePath> StoredAt;
 
 public:
   ContainerSet() = default;
@@ -80,11 +137,18 @@ public:
     for (auto &Entry : Other.Content) {
       revng_assert(containsOrCanCreate(Entry.first()));
 
-      auto &LContainer = Content.find(Entry.first())->second;
       auto &RContainer = Entry.second;
       if (RContainer == nullptr)
         continue;
 
+      materializeOrAbort(Entry.first());
+      auto &LContainer = Content.find(Entry.first())->second;
+
+      // Merging a container without targets does not change the content in
+      // any observable way
+      if (LContainer == nullptr or not RContainer->enumerate().empty())
+        markChanged(Entry.first());
+
       if (LContainer == nullptr)
         LContainer = std::move(RContainer);
       else
@@ -94,6 +158,8 @@ public:
 
   ContainerBase &operator[](llvm::StringRef Name) {
     revng_assert(containsOrCanCreate(Name));
+    materializeOrAbort(Name);
+    markChanged(Name);
     if (Content[Name] == nullptr)
       Content[Name] = (*Factories[Name])(Name);
     auto &Pointer = Content.find(Name)->second;
@@ -103,11 +169,14 @@ public:
 
   ContainerBase &at(llvm::StringRef Name) {
     revng_assert(contains(Name));
+    materializeOrAbort(Name);
+    markChanged(Name);
     return *Content.find(Name)->second;
   }
 
   const ContainerBase &at(llvm::StringRef Name) const {
     revng_assert(contains(Name));
+    materializeOrAbort(Name);
     return *Content.find(Name)->second;
   }
 
@@ -116,21 +185,79 @@ public:
   }
 
   bool contains(llvm::StringRef Name) const {
+    if (isPending(Name))
+      return true;
     auto Iterator = Content.find(Name);
     return Iterator != Content.end() and Iterator->second != nullptr;
   }
 
+  /// Returns true if the container has been found on disk by load but has not
+  /// been deserialized yet
+  bool isPending(llvm::StringRef Name) const {
+    return Pending.find(Name) != Pending.end();
+  }
+
+  /// Deserializes the container, if it is pending
+  llvm::Error materialize(llvm::StringRef Name) const;
+
+  /// \return a copy of the container holding only \p Targets. If it is
+  ///         pending, it stays so and only what's needed is read from disk
+  ///         (see ContainerBase::loadCachedFiltered).
+  llvm::Expected<std::unique_ptr<ContainerBase>>
+  cloneFiltered(llvm::StringRef Name, const TargetsList &Targets) const;
+
+  /// Lets the storage start fetching the files of the pending containers from
+  /// which \p Targets are going to be read (see StorageClient::prefetch)
+  void prefetch(const ContainerToTargetsMap &Targets) const;
+
+  /// Stores the container in \p Directory and drops its content from
+  /// memory. It will be loaded back from there the next time it's accessed.
+  llvm::Error evict(llvm::StringRef Name, const revng::DirectoryPath &Directory);
+
+  /// Makes sure the container is in memory, creating or loading it as needed.
+  /// Unlike operator[], the container is not considered changed.
+  void instantiate(llvm::StringRef Name);
+
+  /// Forget where the content of the container has been stored, so that the
+  /// next store writes it again. Must be called when a container is modified
+  /// without going through the non-const accessors of this class.
+  void markChanged(llvm::StringRef Name) { StoredAt.erase(Name); }
+
+  /// \return true if the content of the container is already stored in
+  ///         \p Path
+  bool isStoredAt(llvm::StringRef Name, const revng::FilePath &Path) const {
+    auto Iterator = StoredAt.find(Name);
+    return Iterator != StoredAt.end() and Iterator->second == Path;
+  }
+
+  /// \return the estimated memory usage of the container, 0 if it's
+  ///         pending or not known
+  size_t memoryUsage(llvm::StringRef Name) const;
+
+  /// \return the estimated memory usage of all the containers
+  size_t memoryUsage() const;
+
+  /// \return a value which is larger for containers that have been accessed
+  ///         more recently, across all the ContainerSets
+  uint64_t getLastAccess(llvm::StringRef Name) const {
+    auto Iterator = LastAccess.find(Name);
+    return Iterator == LastAccess.end() ? 0 : Iterator->second;
+  }
+
   bool containsOrCanCreate(llvm::StringRef Name) const {
     return Content.find(Name) != Content.end();
   }
 
   template<typename T>
   const T &get(llvm::StringRef Name) const {
+    materializeOrAbort(Name);
     return llvm::cast<T>(*Content.find(Name)->second);
   }
 
   template<typename T>
   T &get(llvm::StringRef Name) {
+    materializeOrAbort(Name);
+    markChanged(Name);
     return llvm::cast<T>(*Content.find(Name)->second);
   }
 
@@ -143,6 +270,9 @@ public:
 
   ContainerToTargetsMap enumerate() const;
 
+  /// Enumerates a single container, without loading it if it is pending
+  TargetsList enumerate(llvm::StringRef Name) const;
+
   llvm::Error verify() const;
 
 public:
@@ -153,12 +283,31 @@ public:
     Factories.try_emplace(Name, &Factory);
   }
 
+  /// \note targets are removed from pending containers without deserializing
+  ///       them: only the surviving targets are loaded, and not at all if
+  ///       none survives
   llvm::Error remove(const ContainerToTargetsMap &ToRemove);
   void intersect(ContainerToTargetsMap &ToIntersect) const;
 
 public:
   llvm::Error store(const revng::DirectoryPath &DirectoryPath) const;
-  llvm::Error load(const revng::DirectoryPath &DirectoryPath);
+
+  /// Writes in \p Staging what store would write in \p DirectoryPath, except
+  /// for the containers that have never been loaded, whose files are copied by
+  /// Snapshot::store. The containers are considered stored in \p DirectoryPath
+  /// from now on.
+  ///
+  /// \note Staging is expected to be cheap to write, e.g., in memory: the
+  ///       caller is in charge of moving its content in \p DirectoryPath.
+  llvm::Expected<Snapshot> snapshot(const revng::DirectoryPath &DirectoryPath,
+                                    const revng::DirectoryPath &Staging) const;
+
+  /// Forget where the containers have been stored, so that the next store
+  /// will write all of them
+  void forgetStored() const { StoredAt.clear(); }
+
+  llvm::Error load(const Context &Ctx,
+                   const revng::DirectoryPath &DirectoryPath);
 
   std::vector<revng::FilePath>
   getWrittenFiles(const revng::DirectoryPath &DirectoryPath) const;
@@ -169,12 +318,30 @@ public:
     for (const auto &Entry : Content) {
       indent(OS, Indentation);
       OS << Entry.first().str() << "\n";
-      if (Entry.second != nullptr)
-        Entry.second->enumerate().dump(OS, Indentation);
+      if (contains(Entry.first()))
+        enumerate(Entry.first()).dump(OS, Indentation);
     }
   }
 
   void dump() const debug_function { dump(dbg); }
+
+private:
+  llvm::Error storeContainer(const revng::DirectoryPath &Directory,
+                             llvm::StringRef ContainerName) const;
+
+  void touch(llvm::StringRef Name) const;
+
+  /// \return true if something has been removed
+  llvm::Expected<bool> removeFromPending(llvm::StringRef Name,
+                                         const TargetsList &ToRemove);
+
+  void materializeOrAbort(llvm::StringRef Name) const {
+    touch(Name);
+    if (auto Error = materialize(Name); Error) {
+      std::string Message = llvm::toString(std::move(Error));
+      revng_abort(Message.c_str());
+    }
+  }
 };
 
 } // namespace pipeline
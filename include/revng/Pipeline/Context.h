@@ -4,7 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <initializer_list>
+#include <string>
+#include <utility>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
@@ -26,9 +29,22 @@
 
 namespace pipeline {
 
+class AllTargetsMemo;
+
 extern Logger<> ExplanationLogger;
 extern Logger<> CommandLogger;
 
+/// How precisely the fields of the globals read by the pipes are recorded
+enum class ReadFieldsTracking {
+  /// Record every field read while producing a target, so that a change to a
+  /// global only invalidates the targets that actually read what changed
+  Precise,
+  /// Record nothing: the globals are never walked to start or collect the
+  /// tracking, and every target produced in this mode is invalidated by any
+  /// change to any global. Meant for batch runs that never invalidate.
+  Coarse
+};
+
 /// A class that contains every object that has a lifetime longer than a
 /// pipeline.
 ///
@@ -40,13 +56,21 @@ private:
   uint64_t CommitIndex = 0;
   llvm::StringMap<std::any> Contexts;
   KindsRegistry TheKindRegistry;
+  ReadFieldsTracking Tracking;
 
-  llvm::StringMap<const pipeline::ContainerSet::value_type *>
+  /// The container set owning each read only container, along with the name
+  /// of the container within it
+  llvm::StringMap<std::pair<const ContainerSet *, std::string>>
     ReadOnlyContainers;
 
+  /// Set by whoever wants to be able to interrupt the current run
+  const std::atomic<bool> *CancellationFlag = nullptr;
+
+  /// The innermost `AllTargetsMemo` alive, if any
+  mutable AllTargetsMemo *ActiveAllTargetsMemo = nullptr;
+
 private:
-  explicit Context(KindsRegistry Registry) :
-    TheKindRegistry(std::move(Registry)) {}
+  explicit Context(KindsRegistry Registry);
 
 public:
   Context();
@@ -103,13 +127,18 @@ public:
   GlobalsMap &getGlobals() { return Globals; }
 
   void addReadOnlyContainer(llvm::StringRef Name,
-                            const ContainerSet::value_type &Entry) {
-    ReadOnlyContainers[Name] = &Entry;
+                            const ContainerSet &Containers,
+                            llvm::StringRef ContainerName) {
+    ReadOnlyContainers[Name] = { &Containers, ContainerName.str() };
   }
 
   bool containsReadOnlyContainer(llvm::StringRef Name) const {
     auto It = ReadOnlyContainers.find(Name);
-    return It != ReadOnlyContainers.end() and It->second->second != nullptr;
+    if (It == ReadOnlyContainers.end())
+      return false;
+
+    const auto &[Containers, ContainerName] = It->second;
+    return Containers->contains(ContainerName);
   }
 
   bool hasRegisteredReadOnlyContainer(llvm::StringRef Name) const {
@@ -119,24 +148,74 @@ public:
   template<typename ContainerType>
   const ContainerType &getReadOnlyContainer(llvm::StringRef Name) const {
     revng_assert(containsReadOnlyContainer(Name));
-    auto *ToReturn = &*ReadOnlyContainers.find(Name)->second->second;
+    const auto &[Containers, ContainerName] = ReadOnlyContainers.find(Name)
+                                                ->second;
+    const ContainerBase &ToReturn = Containers->at(ContainerName);
     revng_assert(llvm::isa<ContainerType>(ToReturn));
-    return *llvm::cast<ContainerType>(ToReturn);
+    return llvm::cast<ContainerType>(ToReturn);
   }
 
+public:
+  /// While \p Flag is installed, setting it asks the pipeline to stop as soon
+  /// as possible: the runner checks it between steps and between pipes,
+  /// FunctionPass between functions. Pass nullptr to uninstall it.
+  void setCancellationFlag(const std::atomic<bool> *Flag) {
+    CancellationFlag = Flag;
+  }
+
+  bool isCancellationRequested() const {
+    return CancellationFlag != nullptr and CancellationFlag->load();
+  }
+
+  /// \return the memo installed by the innermost `AllTargetsMemo` alive, if
+  ///         any
+  AllTargetsMemo *getAllTargetsMemo() const { return ActiveAllTargetsMemo; }
+
+private:
+  friend class AllTargetsMemo;
+
 public:
   llvm::Error store(const revng::DirectoryPath &Path) const;
   llvm::Error load(const revng::DirectoryPath &Path);
 
 public:
+  /// Must not be changed while a pipe is running
+  void setReadFieldsTracking(ReadFieldsTracking NewTracking) {
+    Tracking = NewTracking;
+  }
+  ReadFieldsTracking getReadFieldsTracking() const { return Tracking; }
+  bool isTrackingReadFields() const {
+    return Tracking == ReadFieldsTracking::Precise;
+  }
+
   void collectReadFields(const TargetInContainer &Target,
                          llvm::StringMap<PathTargetBimap> &Out) const {
-    Globals.collectReadFields(Target, Out);
+    if (isTrackingReadFields())
+      Globals.collectReadFields(Target, Out);
   }
 
-  void clearAndResume() const { Globals.clearAndResume(); }
-  void pushReadFields() const { Globals.pushReadFields(); }
-  void popReadFields() const { Globals.popReadFields(); }
-  void stopTracking() const { Globals.stopTracking(); }
+  void collectReadFields(uint32_t Index,
+                         llvm::StringMap<PathTargetBimap::IndexedReads> &Out)
+    const {
+    if (isTrackingReadFields())
+      Globals.collectReadFields(Index, Out);
+  }
+
+  void clearAndResume() {
+    if (isTrackingReadFields())
+      Globals.clearAndResume();
+  }
+  void pushReadFields() const {
+    if (isTrackingReadFields())
+      Globals.pushReadFields();
+  }
+  void popReadFields() const {
+    if (isTrackingReadFields())
+      Globals.popReadFields();
+  }
+  void stopTracking() const {
+    if (isTrackingReadFields())
+      Globals.stopTracking();
+  }
 };
 } // namespace pipeline
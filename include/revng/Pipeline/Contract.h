@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -21,6 +22,47 @@ enum Values {
 };
 } // namespace InputPreservation
 
+/// Memoizes, for each kind, the targets produced by `Kind::appendAllTargets`.
+///
+/// Planning a run and deducing all the possible targets evaluate the contracts
+/// of every pipe over and over, and most contracts enumerate all the targets of
+/// their kinds, walking the globals each time. While an instance is alive,
+/// contracts evaluated on its context enumerate the targets of each kind only
+/// once.
+///
+/// \note the globals must not change and pipes must not run while an instance
+///       is alive: the memo would go stale, and fields read by pipes through it
+///       would not be tracked.
+class AllTargetsMemo {
+private:
+  const Context &Ctx;
+  AllTargetsMemo *Previous = nullptr;
+  /// References to the lists must survive insertions
+  std::map<const Kind *, TargetsList> Memo;
+
+public:
+  explicit AllTargetsMemo(const Context &Ctx) :
+    Ctx(Ctx), Previous(Ctx.ActiveAllTargetsMemo) {
+    Ctx.ActiveAllTargetsMemo = this;
+  }
+
+  ~AllTargetsMemo() {
+    revng_assert(Ctx.ActiveAllTargetsMemo == this);
+    Ctx.ActiveAllTargetsMemo = Previous;
+  }
+
+  AllTargetsMemo(const AllTargetsMemo &) = delete;
+  AllTargetsMemo &operator=(const AllTargetsMemo &) = delete;
+
+public:
+  const TargetsList &get(const Kind &K) {
+    auto [It, New] = Memo.try_emplace(&K);
+    if (New)
+      K.appendAllTargets(Ctx, It->second);
+    return It->second;
+  }
+};
+
 /// A contract establishes what operations a pipe can perform on both input
 /// and output containers referred by their index.
 ///
@@ -131,8 +173,9 @@ public:
                           llvm::ArrayRef<std::string> ContainerNames) const;
 
 private:
-  TargetsList forward(const Context &Ctx, TargetsList Input) const;
-  TargetsList backward(const Context &Ctx, TargetsList Output) const;
+  /// Transform, in place, the targets of a single kind as the pipe would
+  void forward(const Context &Ctx, TargetsList &Targets) const;
+  void backward(const Context &Ctx, TargetsList &Targets) const;
   bool forwardMatches(const Context &Ctx, const TargetsList &Input) const;
 
   bool backwardMatchesImpl(const Context &Ct, const TargetsList &List) const;
@@ -75,4 +75,16 @@ public:
   void log(llvm::raw_ostream &OS) const override;
 };
 
+/// Error returned when a run is interrupted through
+/// Context::setCancellationFlag. Nothing produced by the interrupted step is
+/// kept.
+class CancelledError : public llvm::ErrorInfo<CancelledError> {
+public:
+  static char ID;
+
+public:
+  std::error_code convertToErrorCode() const override;
+  void log(llvm::raw_ostream &OS) const override;
+};
+
 } // namespace pipeline
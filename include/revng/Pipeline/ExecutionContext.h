@@ -4,10 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/Function.h"
 #include "llvm/Pass.h"
 
+#include "revng/Pipeline/PathTargetBimap.h"
 #include "revng/Pipeline/Target.h"
 
 namespace pipeline {
@@ -34,6 +39,10 @@ struct PipeWrapper;
 // state of the global is reset, and from that moment forward each time a
 // variable is accessed it is marked as being accessed.
 //
+// When the Context is set to ReadFieldsTracking::Coarse none of this happens:
+// the globals are not walked at all, and the targets produced by the pipe are
+// invalidated by any change to any global.
+//
 // When commit with arguments Target and Container is inovked, the following
 // MUST be true:
 // * Target must be == to the last target that has been created in Container
@@ -62,6 +71,31 @@ struct PipeWrapper;
 //   }
 // }
 //
+// Pipes producing many targets can record each of them in a CommitBatch in
+// place of committing it, and then commit the whole batch at once: the rules
+// above apply to record in the same way, updating the invalidation metadata
+// in bulk is cheaper.
+
+/// Targets produced but not committed yet, along with the fields of the
+/// globals read to produce them
+///
+/// \see ExecutionContext::record and ExecutionContext::commitBatch
+class CommitBatch {
+private:
+  friend class ExecutionContext;
+
+private:
+  std::vector<TargetInContainer> Targets;
+
+  /// For each global, the paths read along with the index in Targets of the
+  /// target they have been read for
+  llvm::StringMap<PathTargetBimap::IndexedReads> Reads;
+
+public:
+  size_t size() const { return Targets.size(); }
+  bool empty() const { return Targets.empty(); }
+};
+
 class ExecutionContext {
 private:
   Context *TheContext = nullptr;
@@ -69,6 +103,8 @@ private:
   ContainerToTargetsMap Requested;
   // false when running on a analysis
   bool RunningOnPipe = true;
+  size_t CommitsCount = 0;
+  std::chrono::microseconds CommitsDuration{ 0 };
 
 public:
   ~ExecutionContext();
@@ -83,12 +119,29 @@ public:
   void commit(const Target &Target, const ContainerBase &Container);
   void commitUniqueTarget(const ContainerBase &Container);
 
+  /// Like commit, but \p Target is committed only by `commitBatch`
+  void
+  record(CommitBatch &Batch, const Target &Target, llvm::StringRef Container);
+
+  /// Commit all the targets recorded in \p Batch, leaving it empty
+  void commitBatch(CommitBatch &Batch);
+
   const ContainerToTargetsMap &getCurrentRequestedTargets() const {
     return Requested;
   }
 
   ContainerToTargetsMap &getCurrentRequestedTargets() { return Requested; }
 
+  size_t getCommitsCount() const { return CommitsCount; }
+
+  /// \see Context::setCancellationFlag
+  bool isCancellationRequested() const;
+
+  /// Time spent collecting the read fields in commit
+  std::chrono::microseconds getCommitsDuration() const {
+    return CommitsDuration;
+  }
+
 public:
   const Context &getContext() const { return *TheContext; }
   Context &getContext() { return *TheContext; }
@@ -109,6 +162,12 @@ public:
 
   bool doInitialization(llvm::Module &M) override { return false; }
 
+  /// Point the pass to a new run, when the pass manager owning it is reused
+  void reset(ExecutionContext *NewCtx, llvm::StringRef NewContainerName) {
+    Ctx = NewCtx;
+    ContainerName = NewContainerName;
+  }
+
 public:
   llvm::StringRef getContainerName() const { return ContainerName; }
   ExecutionContext *get() { return Ctx; }
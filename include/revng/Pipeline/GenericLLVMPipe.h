@@ -12,6 +12,7 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassManager.h"
 #include "llvm/PassRegistry.h"
 
 #include "revng/ADT/Concepts.h"
@@ -28,7 +29,12 @@ class LLVMContainer;
 class LLVMPassWrapperBase {
 public:
   virtual ~LLVMPassWrapperBase() = default;
+
+  /// \return true if the passes have to be registered in a new pass manager,
+  ///         false if they have to be registered in a legacy one
+  virtual bool usesNewPassManager() const = 0;
   virtual void registerPasses(llvm::legacy::PassManager &Manager) = 0;
+  virtual void registerPasses(llvm::ModulePassManager &Manager) = 0;
   virtual const std::vector<ContractGroup> &getContract() const = 0;
   virtual std::unique_ptr<LLVMPassWrapperBase> clone() const = 0;
   virtual llvm::StringRef getName() const = 0;
@@ -36,11 +42,24 @@ public:
 };
 
 template<typename T>
-concept LLVMPass = requires(T P) {
-  { T::Name } -> convertible_to<const char *>;
+concept LegacyLLVMPass = requires(T P) {
   { P.registerPasses(std::declval<llvm::legacy::PassManager &>()) };
 };
 
+/// A pass expressed with the new pass manager. Its function analyses are
+/// cached across the passes of the pipe, and are recomputed only when a pass
+/// does not preserve them.
+template<typename T>
+concept NewPMLLVMPass = requires(T P) {
+  { P.registerPasses(std::declval<llvm::ModulePassManager &>()) };
+};
+
+/// \note if a pass supports both pass managers, the new one is used
+template<typename T>
+concept LLVMPass = requires {
+  { T::Name } -> convertible_to<const char *>;
+} and (LegacyLLVMPass<T> or NewPMLLVMPass<T>);
+
 template<typename T>
 concept LLVMPrintablePass = requires(T P) {
   { P.print(llvm::outs()) };
@@ -71,7 +90,11 @@ public:
 
   ~PureLLVMPassWrapper() override = default;
 
+  bool usesNewPassManager() const override { return false; }
   void registerPasses(llvm::legacy::PassManager &Manager) override;
+  void registerPasses(llvm::ModulePassManager &Manager) override {
+    revng_abort();
+  }
 
   const std::vector<ContractGroup> &getContract() const override {
     static const std::vector<ContractGroup> Empty{};
@@ -113,8 +136,20 @@ public:
   llvm::StringRef getName() const override { return T ::Name; }
 
 public:
+  bool usesNewPassManager() const override { return NewPMLLVMPass<T>; }
+
   void registerPasses(llvm::legacy::PassManager &Manager) override {
-    PipePass.registerPasses(Manager);
+    if constexpr (NewPMLLVMPass<T>)
+      revng_abort();
+    else
+      PipePass.registerPasses(Manager);
+  }
+
+  void registerPasses(llvm::ModulePassManager &Manager) override {
+    if constexpr (NewPMLLVMPass<T>)
+      PipePass.registerPasses(Manager);
+    else
+      revng_abort();
   }
 
   const std::vector<ContractGroup> &getContract() const override {
@@ -135,10 +170,20 @@ public:
 
 /// Implementation of the LLVM pipes to be instantiated for a particular LLVM
 /// container
+///
+/// The pass managers are built the first time the pipe runs and are reused by
+/// the following runs (see `CachedPipeline`). Consecutive passes using the
+/// same kind of pass manager share a single one.
 class GenericLLVMPipe {
+private:
+  struct CachedPipeline;
+
 private:
   llvm::SmallVector<std::unique_ptr<LLVMPassWrapperBase>, 4> Passes;
 
+  /// Not copied, since it refers to the passes of this pipe
+  std::shared_ptr<CachedPipeline> Cache;
+
 public:
   static constexpr auto Name = "generic-llvm-pipe";
   template<typename... T>
@@ -156,6 +201,7 @@ public:
       NewPasses.push_back(P->clone());
 
     Passes = std::move(NewPasses);
+    Cache.reset();
     return *this;
   }
 
@@ -179,6 +225,7 @@ public:
   void run(ExecutionContext &, LLVMContainer &Container);
 
   void addPass(const PureLLVMPassWrapper &Pass) {
+    Cache.reset();
     Passes.emplace_back(Pass.clone());
   }
 
@@ -190,6 +237,7 @@ public:
   void addPass(T Pass) {
     using Type = LLVMPassWrapper<T>;
     auto Wrapper = std::make_unique<Type>(std::forward<T>(Pass));
+    Cache.reset();
     Passes.emplace_back(std::move(Wrapper));
   }
 
@@ -197,10 +245,12 @@ public:
   void emplacePass(ArgsT &&...Args) {
     using Type = LLVMPassWrapper<T>;
     auto Wrapper = std::make_unique<Type>(std::forward<ArgsT>(Args)...);
+    Cache.reset();
     Passes.emplace_back(std::move(Wrapper));
   }
 
   void addPass(std::unique_ptr<LLVMPassWrapperBase> Impl) {
+    Cache.reset();
     Passes.emplace_back(std::move(Impl));
   }
 
@@ -214,6 +264,40 @@ public:
   }
 
   void dump() const debug_function { dump(dbg); }
+
+private:
+  void buildPipeline();
+};
+
+/// Provides the `ExecutionContext` of the running pipe to the passes using the
+/// new pass manager, as `LoadExecutionContextPass` does for the legacy ones
+class ExecutionContextAnalysis
+  : public llvm::AnalysisInfoMixin<ExecutionContextAnalysis> {
+private:
+  friend llvm::AnalysisInfoMixin<ExecutionContextAnalysis>;
+  static llvm::AnalysisKey Key;
+
+private:
+  ExecutionContext *const *Current = nullptr;
+
+public:
+  struct Result {
+    ExecutionContext *Ctx = nullptr;
+
+    bool invalidate(llvm::Module &,
+                    const llvm::PreservedAnalyses &,
+                    llvm::ModuleAnalysisManager::Invalidator &) {
+      return false;
+    }
+  };
+
+public:
+  explicit ExecutionContextAnalysis(ExecutionContext *const *Current) :
+    Current(Current) {}
+
+  Result run(llvm::Module &, llvm::ModuleAnalysisManager &) {
+    return { *Current };
+  }
 };
 
 class O2Pipe {
@@ -221,7 +305,7 @@ public:
   static constexpr auto Name = "o2";
   std::vector<ContractGroup> getContract() const { return {}; }
 
-  void registerPasses(llvm::legacy::PassManager &Manager);
+  void registerPasses(llvm::ModulePassManager &Manager);
 };
 
 using LLVMPipe = GenericLLVMPipe;
@@ -5,22 +5,77 @@
 
 #include <any>
 #include <memory>
+#include <optional>
 #include <type_traits>
+#include <utility>
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/raw_sha1_ostream.h"
 
+#include "revng/ADT/UpcastablePointer.h"
 #include "revng/Pipeline/GlobalTupleTreeDiff.h"
 #include "revng/Pipeline/PathTargetBimap.h"
 #include "revng/Storage/Path.h"
 #include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/Binary.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
 
 namespace pipeline {
 
+/// \return true if the global named \p GlobalName has to be stored in the
+///         binary format of TupleTree/Binary.h (`-binary-globals`)
+bool isStoredAsBinary(llvm::StringRef GlobalName);
+
+/// \return the number of bytes \p Serialize writes, without storing them
+uint64_t
+serializedSize(llvm::function_ref<void(llvm::raw_ostream &)> Serialize);
+
+namespace detail {
+
+/// Computes the digest of the element a path leads to: the SHA1 of its binary
+/// serialization, which, unlike `tupletree::hash`, is the same in every
+/// process and can therefore be stored
+struct DigestByPathVisitor {
+  std::optional<std::string> Result;
+
+  template<typename T>
+  static std::string digestOf(const T &Element) {
+    llvm::raw_sha1_ostream OS;
+    // Elements of polymorphic containers are visited through their base type
+    if constexpr (Upcastable<T>) {
+      upcast(&Element, [&OS](const auto &Upcasted) {
+        tupletree::binary::serialize(OS, Upcasted);
+      });
+    } else {
+      tupletree::binary::serialize(OS, Element);
+    }
+    return llvm::toHex(OS.sha1(), true);
+  }
+
+  template<typename, size_t, typename T>
+  void visitTupleElement(const T &Element) {
+    Result = digestOf(Element);
+  }
+
+  template<typename, size_t, typename Kind, typename T>
+  void visitPolymorphicElement(Kind, const T &Element) {
+    Result = digestOf(Element);
+  }
+
+  template<typename, typename KeyT, typename T>
+  void visitContainerElement(KeyT, const T &Element) {
+    Result = digestOf(Element);
+  }
+};
+
+} // namespace detail
+
 class Global {
 private:
   const char *ID;
@@ -51,8 +106,19 @@ public:
   deserializeDiff(const llvm::MemoryBuffer &Diff) = 0;
 
   virtual bool verify() const = 0;
+
+  /// Verify this global after \p Applied has been applied to it, assuming it
+  /// was valid before, which might be cheaper than verifying it from scratch
+  virtual bool verify(const GlobalTupleTreeDiff &Applied) const {
+    return verify();
+  }
+
   virtual void clear() = 0;
 
+  /// \return an estimate, in bytes, of the memory used by this global, or 0
+  ///         if it's unknown
+  virtual size_t memoryUsage() const { return 0; }
+
   virtual llvm::Expected<std::unique_ptr<Global>>
   createNew(llvm::StringRef Name, const llvm::MemoryBuffer &Buffer) const = 0;
   virtual std::unique_ptr<Global> clone() const = 0;
@@ -67,7 +133,16 @@ public:
 
   virtual void collectReadFields(const TargetInContainer &Target,
                                  PathTargetBimap &Out) = 0;
-  virtual void clearAndResume() const = 0;
+  /// Like `collectReadFields`, reporting the paths to \p OnRead
+  virtual void collectReadPaths(revng::Tracking::PathCallback OnRead) = 0;
+  /// \return the digest of the subtree at \p Path, the whole global if
+  ///         \p Path is empty, or nothing if there's no such subtree. It is
+  ///         stable across processes.
+  virtual std::optional<std::string>
+  digest(const TupleTreePath &Path) const = 0;
+  /// Start tracking the reads from scratch. Not const since the state of the
+  /// tracking might need to be separated from copies of this global.
+  virtual void clearAndResume() = 0;
   virtual void pushReadFields() const = 0;
   virtual void popReadFields() const = 0;
   virtual void stopTracking() const = 0;
@@ -112,8 +187,17 @@ public:
   }
 
   void clear() override {
-    Value.evictCachedReferences();
-    *Value = Object();
+    // Replace the root instead of assigning it, which might copy it first
+    Value = TupleTree<Object>();
+  }
+
+  /// \note the estimate is the size of the binary serialization of the tree,
+  ///       which is proportional to, but smaller than, its size in memory.
+  ///       Computing it takes a visit of the whole tree.
+  size_t memoryUsage() const override {
+    return serializedSize([this](llvm::raw_ostream &OS) {
+      Value.serializeBinary(OS);
+    });
   }
 
   llvm::Error serialize(llvm::raw_ostream &OS) const override {
@@ -121,6 +205,20 @@ public:
     return llvm::Error::success();
   }
 
+  llvm::Error store(const revng::FilePath &Path) const override {
+    if (not isStoredAsBinary(getName()))
+      return Global::store(Path);
+
+    auto MaybeWritableFile = Path.getWritableFile();
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    auto &WritableFile = MaybeWritableFile.get();
+    Value.serializeBinary(WritableFile->os());
+    return WritableFile->commit();
+  }
+
+  /// \note both the YAML and the binary format are accepted
   llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) override {
     auto MaybeTupleTree = TupleTree<Object>::deserialize(Buffer.getBuffer());
     if (!MaybeTupleTree)
@@ -146,6 +244,21 @@ public:
 
   bool verify() const override { return Value->verify(); }
 
+  bool verify(const GlobalTupleTreeDiff &Applied) const override {
+    using DiffType = TupleTreeDiff<Object>;
+    const DiffType *Diff = Applied.getAs<Object>();
+    revng_assert(Diff != nullptr);
+
+    constexpr bool HasIncrementalVerify = requires(const Object &O,
+                                                   const DiffType &D) {
+      { O.verify(D) } -> std::same_as<bool>;
+    };
+    if constexpr (HasIncrementalVerify)
+      return Value->verify(*Diff);
+    else
+      return verify();
+  }
+
   GlobalTupleTreeDiff diff(const Global &Other) const override {
     const TupleTreeGlobal &Casted = llvm::cast<TupleTreeGlobal>(Other);
     auto Diff = ::diff(*Value, *Casted.Value);
@@ -190,15 +303,31 @@ public:
   void collectReadFields(const TargetInContainer &Target,
                          PathTargetBimap &Out) override {
     const TupleTree<Object> &AsConst = Value;
-    ReadFields Results = revng::Tracking::collect(*AsConst);
-    for (const TupleTreePath &Result : Results.Read)
-      Out.insert(Target, Result);
-    for (const TupleTreePath &Result : Results.ExactVectors)
-      Out.insert(Target, Result);
+    auto Insert = [&](const TupleTreePath &Path) { Out.insert(Target, Path); };
+    revng::Tracking::collect(*AsConst, Insert, Insert);
+  }
+
+  void collectReadPaths(revng::Tracking::PathCallback OnRead) override {
+    const TupleTree<Object> &AsConst = Value;
+    revng::Tracking::collect(*AsConst, OnRead, OnRead);
+  }
+
+  std::optional<std::string>
+  digest(const TupleTreePath &Path) const override {
+    const Object &Root = *Value;
+    if (Path.empty())
+      return detail::DigestByPathVisitor::digestOf(Root);
+
+    detail::DigestByPathVisitor Visitor;
+    if (not callByPath(Visitor, Path, Root))
+      return std::nullopt;
+    return Visitor.Result;
   }
 
-  void clearAndResume() const override {
-    revng::Tracking::clearAndResume(*Value);
+  void clearAndResume() override {
+    // Copies sharing the root would share the tracking state too
+    Value.detach();
+    revng::Tracking::clearAndResume(*std::as_const(Value));
   }
   void pushReadFields() const override { revng::Tracking::push(*Value); }
   void popReadFields() const override { revng::Tracking::pop(*Value); }
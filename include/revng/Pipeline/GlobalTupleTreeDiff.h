@@ -5,6 +5,9 @@
 
 #include <any>
 
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/Assert.h"
 #include "revng/Support/YAMLTraits.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
 
@@ -28,6 +31,9 @@ public:
 public:
   virtual std::unique_ptr<GlobalTupleTreeDiffBase> clone() const = 0;
 
+  /// Appends the changes of \p Other, which must be a diff of the same global
+  virtual void append(const GlobalTupleTreeDiffBase &Other) = 0;
+
 public:
   const char *getID() const { return ID; }
 
@@ -67,6 +73,12 @@ public:
     return std::unique_ptr<GlobalTupleTreeDiffBase>(Ptr);
   }
 
+  void append(const GlobalTupleTreeDiffBase &Other) override {
+    const auto &Casted = llvm::cast<GlobalTupleTreeDiffImpl>(Other);
+    revng_assert(Casted.getGlobalName() == getGlobalName());
+    llvm::append_range(Diff.Changes, Casted.Diff.Changes);
+  }
+
   bool isEmpty() const override { return Diff.Changes.size() == 0; }
 
   static bool classof(const GlobalTupleTreeDiffBase *Base) {
@@ -139,6 +151,10 @@ public:
     return Diff->getPaths();
   }
 
+  /// Appends the changes of \p Other, so that applying the result is the
+  /// same as applying this diff and then \p Other
+  void append(const GlobalTupleTreeDiff &Other) { Diff->append(*Other.Diff); }
+
   bool isEmpty() const { return Diff.get()->isEmpty(); }
 
   llvm::StringRef getGlobalName() const { return Diff->getGlobalName(); }
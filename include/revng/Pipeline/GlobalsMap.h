@@ -160,8 +160,21 @@ public:
     }
   }
 
-  void clearAndResume() const {
-    for (const auto &Global : Map)
+  /// Like the overload above, recording the paths read along with \p Index,
+  /// to insert them later on in bulk, see `PathTargetBimap::insert`
+  void collectReadFields(uint32_t Index,
+                         llvm::StringMap<PathTargetBimap::IndexedReads> &Out)
+    const {
+    for (const auto &Global : Map) {
+      PathTargetBimap::IndexedReads &Reads = Out[Global.first];
+      Global.second->collectReadPaths([&](const TupleTreePath &Path) {
+        Reads.emplace_back(Path, Index);
+      });
+    }
+  }
+
+  void clearAndResume() {
+    for (auto &Global : Map)
       Global.second->clearAndResume();
   }
   void pushReadFields() const {
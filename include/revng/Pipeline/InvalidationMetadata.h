@@ -0,0 +1,95 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Global.h"
+#include "revng/Pipeline/PathTargetBimap.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/TupleTree/TupleTreePath.h"
+
+// The serialized form of the invalidation metadata of the steps, i.e., the
+// paths of the globals read to produce each target, as stored in the
+// `<container>.cache` files of the step directories.
+
+namespace pipeline {
+
+class Context;
+
+class TargetInPipe {
+public:
+  std::string SerializedTarget;
+  std::string PipeName;
+
+  llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
+  deserialize(const Context &Ctx, llvm::StringRef ContainerName) const;
+
+  static TargetInPipe fromTargetInContainer(const TargetInContainer &Target,
+                                            llvm::StringRef PipeName);
+  bool operator<(const TargetInPipe &Other) const {
+    const auto &Tied = std::tie(SerializedTarget, PipeName);
+    return Tied < std::tie(Other.SerializedTarget, Other.PipeName);
+  }
+};
+
+class ContainerInvalidationMetadata {
+public:
+  using ValueType = std::pair<pipeline::TargetInPipe, std::vector<std::string>>;
+  using Vector = std::vector<ValueType>;
+  Vector Data;
+
+  void merge(ContainerInvalidationMetadata &&Other) {
+    for (ValueType &Entry : Other.Data)
+      Data.emplace_back(std::move(Entry));
+  }
+
+public:
+  /// \param ParsedPaths cache of the paths that have already been parsed,
+  ///        it can be shared among invocations on the same global.
+  llvm::Expected<PathTargetBimap>
+  deserialize(const Context &Ctx,
+              const Global &Primitives,
+              llvm::StringRef PipeName,
+              llvm::StringRef ContainerName,
+              llvm::StringMap<TupleTreePath> &ParsedPaths) const;
+
+  static ContainerInvalidationMetadata serialize(const PathTargetBimap &Map,
+                                                 const Global &Primitives,
+                                                 llvm::StringRef PipeName,
+                                                 llvm::StringRef ContainerName);
+};
+
+class NamedPathTargetBimapVector {
+public:
+  std::string GlobalName;
+  ContainerInvalidationMetadata Map;
+};
+
+using InvalidationMetadataVector = llvm::SmallVector<NamedPathTargetBimapVector,
+                                                     2>;
+
+/// Write \p ToStore in the versioned binary format
+void writeBinaryInvalidationMetadata(llvm::raw_ostream &OS,
+                                     const InvalidationMetadataVector &ToStore);
+
+/// Write \p ToStore as YAML, for debugging purposes
+void writeYAMLInvalidationMetadata(llvm::raw_ostream &OS,
+                                   const InvalidationMetadataVector &ToStore);
+
+/// Parse \p Buffer, in either of the formats
+llvm::Expected<InvalidationMetadataVector>
+parseInvalidationMetadata(llvm::StringRef Buffer);
+
+} // namespace pipeline
@@ -6,6 +6,7 @@
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 
 #include "revng/ADT/STLExtras.h"
@@ -16,24 +17,29 @@
 namespace pipeline {
 
 /// A KindsRegistry is a simple vector used to keep track of which kinds are
-/// available in a particular pipeline
+/// available in a particular pipeline, together with an index to look them up
+/// by name
 class KindsRegistry {
 public:
   using Container = llvm::SmallVector<Kind *, 4>;
 
 private:
   Container Kinds;
+  llvm::StringMap<Kind *> ByName;
 
 public:
   KindsRegistry(llvm::SmallVector<Kind *, 4> Kinds = {}) :
     Kinds(std::move(Kinds)) {
-    llvm::sort(Kinds, [](Kind *&LHS, Kind *&RHS) {
+    llvm::sort(this->Kinds, [](Kind *&LHS, Kind *&RHS) {
       return LHS->name() < RHS->name();
     });
+    for (Kind *K : this->Kinds)
+      ByName.try_emplace(K->name(), K);
   }
 
   void registerKind(Kind &K) {
-    revng_assert(not contains(K.name()));
+    bool Inserted = ByName.try_emplace(K.name(), &K).second;
+    revng_assert(Inserted);
     Kinds.push_back(&K);
     llvm::sort(Kinds, [](Kind *&LHS, Kind *&RHS) {
       return LHS->name() < RHS->name();
@@ -47,12 +53,10 @@ public:
   auto end() const { return revng::dereferenceIterator(Kinds.end()); }
 
   const Kind *find(llvm::StringRef Name) const {
-    auto Iter = llvm::find_if(Kinds, [Name](const auto *Kind) {
-      return Kind->name() == Name;
-    });
-    if (Iter == Kinds.end())
+    auto It = ByName.find(Name);
+    if (It == ByName.end())
       return nullptr;
-    return *Iter;
+    return It->second;
   }
 
   bool contains(llvm::StringRef Name) { return find(Name) != nullptr; }
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
 #include "revng/Pipeline/ContainerEnumerator.h"
 #include "revng/Pipeline/Pipe.h"
 #include "revng/Support/ModuleStatistics.h"
@@ -17,6 +19,13 @@ namespace pipeline {
 void makeGlobalObjectsArray(llvm::Module &Module,
                             llvm::StringRef GlobalArrayName);
 
+/// A container holding an llvm::Module.
+///
+/// When loaded from a file produced by storeCached, the module is read from
+/// bitcode lazily: function bodies are materialized only when needed.
+/// cloneFiltered and extractOne materialize only the functions they are
+/// copying, while getModule materializes the whole module, since its users
+/// expect a regular module.
 class LLVMContainer : public EnumerableContainer<LLVMContainer> {
 private:
   using LinkageRestoreMap = std::map<std::string,
@@ -31,6 +40,14 @@ private:
 private:
   std::unique_ptr<llvm::Module> Module;
 
+  /// Number of compile units in Module the last time they have been pruned
+  unsigned CompileUnitsAfterPrune = 0;
+
+  /// Statistics about Module, computed on demand and then kept up to date as
+  /// functions get materialized and other containers are merged in place.
+  /// Reset whenever Module might change in ways that are not tracked.
+  mutable std::optional<ModuleStatistics> Statistics;
+
 public:
   inline static const llvm::StringRef MIMEType = "text/x.llvm.ir";
   inline static const char *Name = "llvm-container";
@@ -55,8 +72,38 @@ public:
   }
 
 public:
-  const llvm::Module &getModule() const { return *Module; }
-  llvm::Module &getModule() { return *Module; }
+  const llvm::Module &getModule() const {
+    materializeAll();
+    return *Module;
+  }
+
+  llvm::Module &getModule() {
+    materializeAll();
+
+    // The caller might change the module
+    Statistics.reset();
+
+    return *Module;
+  }
+
+  /// Returns the module without materializing it: the bodies of some of the
+  /// functions might not be available yet, while their declarations and
+  /// metadata are.
+  const llvm::Module &getUnmaterializedModule() const { return *Module; }
+
+  /// Statistics about the module, as ModuleStatistics::analyze would produce.
+  ///
+  /// The module is analyzed as a whole only the first time, or after it has
+  /// been handed out for modification, so this is cheap to call repeatedly.
+  /// Functions that have not been materialized yet count as empty.
+  ///
+  /// \note in place merges do not update the types and the debug information
+  ///       measured here.
+  const ModuleStatistics &statistics() const {
+    if (not Statistics)
+      Statistics = ModuleStatistics::analyze(*Module);
+    return *Statistics;
+  }
 
 public:
   std::unique_ptr<ContainerBase>
@@ -70,13 +117,33 @@ public:
 
   llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) final;
 
+  llvm::Error storeCached(const revng::FilePath &Path) const final;
+
+  llvm::Error loadCached(const revng::FilePath &Path) final;
+
+  /// Estimated from the number of IR objects, ignoring metadata and constants.
+  /// Bodies of functions that have not been materialized yet are not counted.
+  /// Based on statistics(), hence cheap.
+  size_t memoryUsage() const final;
+
   void clear() final {
     Module = std::make_unique<llvm::Module>("revng.module",
                                             Module->getContext());
+    Statistics.reset();
   }
 
 private:
   void mergeBackImpl(ThisType &&OtherContainer) final;
+
+  using OptionalStatistics = std::optional<ModuleStatistics>;
+  void logMergeStatistics(const OptionalStatistics &Pre,
+                          const OptionalStatistics &ToMerge) const;
+
+  /// Materializes the body of a function of a lazily loaded module
+  void materialize(llvm::Function &F) const;
+
+  /// Materializes everything that has not been materialized yet
+  void materializeAll() const;
 };
 
 } // namespace pipeline
@@ -59,6 +59,9 @@ public:
   }
 
 public:
+  /// \note Symbol might belong to a lazily loaded module and not be
+  ///       materialized yet: only its declaration and its metadata are
+  ///       available.
   virtual std::optional<Target>
   symbolToTarget(const llvm::Function &Symbol) const = 0;
 
@@ -68,7 +71,7 @@ public:
                       const LLVMContainer &Container) const {
 
     llvm::DenseSet<const llvm::Function *> ToReturn;
-    for (auto &GL : Container.getModule().functions()) {
+    for (auto &GL : Container.getUnmaterializedModule().functions()) {
       auto MaybeTarget = symbolToTarget(GL);
       if (not MaybeTarget.has_value())
         continue;
@@ -116,7 +119,7 @@ public:
   TargetsList enumerate(const Context &Ctx,
                         const LLVMContainer &Container) const final {
     TargetsList::List L;
-    for (auto &GL : Container.getModule().functions()) {
+    for (auto &GL : Container.getUnmaterializedModule().functions()) {
       auto MaybeTarget = symbolToTarget(GL);
       if (not MaybeTarget.has_value())
         continue;
@@ -131,7 +134,7 @@ public:
   untrackedFunctions(const LLVMContainer &Container) {
     llvm::DenseSet<const llvm::Function *> ToReturn;
 
-    for (const auto &F : Container.getModule().functions())
+    for (const auto &F : Container.getUnmaterializedModule().functions())
       if (not hasOwner(F))
         ToReturn.insert(&F);
 
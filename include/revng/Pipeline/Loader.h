@@ -74,6 +74,7 @@ struct BranchDeclaration {
 struct AnalysesListDeclaration {
   std::string Name;
   std::vector<std::string> UsedAnalysesNames;
+  bool DeferInvalidation = false;
 };
 
 struct PipelineDeclaration {
@@ -239,12 +240,17 @@ struct llvm::yaml::MappingTraits<pipeline::ContainerDeclaration> {
   }
 };
 
-INTROSPECTION_NS(pipeline, AnalysesListDeclaration, Name, UsedAnalysesNames);
+INTROSPECTION_NS(pipeline,
+                 AnalysesListDeclaration,
+                 Name,
+                 UsedAnalysesNames,
+                 DeferInvalidation);
 template<>
 struct llvm::yaml::MappingTraits<pipeline::AnalysesListDeclaration> {
   static void mapping(IO &TheIO, pipeline::AnalysesListDeclaration &Info) {
     TheIO.mapRequired("Name", Info.Name);
     TheIO.mapOptional("Analyses", Info.UsedAnalysesNames);
+    TheIO.mapOptional("DeferInvalidation", Info.DeferInvalidation, false);
   }
 };
 
@@ -0,0 +1,128 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <compare>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+
+#include "llvm/ADT/DenseMapInfo.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Allocator.h"
+
+#include "revng/Pipeline/Location.h"
+
+namespace pipeline {
+
+/// The identifier of a serialized location interned by `LocationInterner`.
+///
+/// It's as cheap to copy, compare and hash as an integer, and it can be kept
+/// around in place of the string: the string itself is looked up only when
+/// needed, through `str`.
+///
+/// \note the ordering of interned locations is the order in which they have
+///       been interned, use `lessByString` to sort them as strings.
+class InternedLocation {
+private:
+  static constexpr uint32_t Invalid = UINT32_MAX;
+
+private:
+  uint32_t ID = Invalid;
+
+public:
+  InternedLocation() = default;
+  explicit InternedLocation(uint32_t ID) : ID(ID) {}
+
+public:
+  bool isValid() const { return ID != Invalid; }
+  uint32_t id() const { return ID; }
+
+  /// \note the result remains valid for the whole lifetime of the process
+  llvm::StringRef str() const;
+
+  std::strong_ordering operator<=>(const InternedLocation &) const = default;
+
+  static bool lessByString(InternedLocation LHS, InternedLocation RHS) {
+    return LHS == RHS ? false : LHS.str() < RHS.str();
+  }
+};
+
+/// A process-wide pool of serialized locations, each stored exactly once and
+/// identified by a stable, dense ID.
+///
+/// Code producing the same locations over and over (e.g., one for each
+/// reference in an artifact) can store and compare `InternedLocation`s
+/// instead of strings. The memory used is proportional to the number of
+/// distinct locations, not to the number of their uses.
+///
+/// Thread safe: lookups of existing locations take a shared lock only.
+class LocationInterner {
+private:
+  mutable std::shared_mutex Mutex;
+  llvm::StringMap<uint32_t, llvm::BumpPtrAllocator> IDs;
+
+  /// Indexed by ID, pointing to the keys of IDs, which never move
+  std::deque<llvm::StringRef> Strings;
+
+private:
+  LocationInterner() = default;
+
+public:
+  static LocationInterner &get();
+
+public:
+  InternedLocation intern(llvm::StringRef Serialized);
+
+  template<RankSpecialization Rank>
+  InternedLocation intern(const Location<Rank> &L) {
+    return intern(L.toString());
+  }
+
+  /// \return the location with the given serialization, if it has been
+  ///         interned already
+  InternedLocation find(llvm::StringRef Serialized) const;
+
+  llvm::StringRef str(InternedLocation Location) const;
+
+  size_t size() const;
+};
+
+inline llvm::StringRef InternedLocation::str() const {
+  return LocationInterner::get().str(*this);
+}
+
+/// Constructs a new location from arbitrary arguments and interns its
+/// serialized form, see `serializedLocation`
+template<RankSpecialization Rank, typename... Args>
+  requires std::is_convertible_v<std::tuple<Args...>, typename Rank::Tuple>
+inline InternedLocation internedLocation(const Rank &R, Args &&...As) {
+  auto Serialized = serializedLocation(R, std::forward<Args>(As)...);
+  return LocationInterner::get().intern(Serialized);
+}
+
+} // namespace pipeline
+
+template<>
+struct llvm::DenseMapInfo<pipeline::InternedLocation> {
+  using InternedLocation = pipeline::InternedLocation;
+
+  static InternedLocation getEmptyKey() {
+    return InternedLocation(DenseMapInfo<uint32_t>::getEmptyKey());
+  }
+
+  static InternedLocation getTombstoneKey() {
+    return InternedLocation(DenseMapInfo<uint32_t>::getTombstoneKey());
+  }
+
+  static unsigned getHashValue(InternedLocation Location) {
+    return DenseMapInfo<uint32_t>::getHashValue(Location.id());
+  }
+
+  static bool isEqual(InternedLocation LHS, InternedLocation RHS) {
+    return LHS == RHS;
+  }
+};
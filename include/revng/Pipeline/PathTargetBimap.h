@@ -4,9 +4,15 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <set>
 #include <string>
 #include <tuple>
+#include <utility>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/YAMLTraits.h"
 
@@ -51,6 +57,11 @@ public:
 /// target in that container, and from a tuple tree path you can know all the
 /// targets that have been created reading the field pointed by that path.
 class PathTargetBimap {
+public:
+  /// Paths read while producing a batch of targets, each one along with the
+  /// index of the target in the batch, see `insert`
+  using IndexedReads = std::vector<std::pair<TupleTreePath, uint32_t>>;
+
 private:
   using MapType = std::map<TupleTreePath, std::set<TargetInContainer>>;
   using ReverseMapType = std::map<TargetInContainer,
@@ -96,6 +107,29 @@ public:
     insert(Located, Path);
   }
 
+  /// Inserts all the paths in \p Reads, each one as read by the target in
+  /// \p Targets it refers to.
+  ///
+  /// Cheaper than inserting the pairs one by one: the maps are looked up once
+  /// for each distinct path and once for each target.
+  void insert(llvm::ArrayRef<TargetInContainer> Targets, IndexedReads Reads) {
+    llvm::sort(Reads);
+    Reads.erase(std::unique(Reads.begin(), Reads.end()), Reads.end());
+
+    std::vector<std::vector<TupleTreePath> *> ReversePaths(Targets.size());
+    std::set<TargetInContainer> *PathTargets = nullptr;
+    for (size_t I = 0; I < Reads.size(); ++I) {
+      const auto &[Path, Index] = Reads[I];
+      if (I == 0 or Reads[I - 1].first != Path)
+        PathTargets = &Map[Path];
+      PathTargets->insert(Targets[Index]);
+
+      if (ReversePaths[Index] == nullptr)
+        ReversePaths[Index] = &ReverseMap[Targets[Index]];
+      ReversePaths[Index]->push_back(Path);
+    }
+  }
+
   void remove(const TargetsList &List, llvm::StringRef ContainerName) {
     for (auto &Target : List) {
       TargetInContainer ToErase(Target, ContainerName.str());
@@ -104,13 +138,47 @@ public:
         continue;
 
       for (auto &Path : Iter->second) {
-        Map.at(Path).erase(ToErase);
+        auto PathIter = Map.find(Path);
+        if (PathIter == Map.end())
+          continue;
+
+        PathIter->second.erase(ToErase);
+
+        // Do not leave behind paths nothing depends on anymore, so that the
+        // map only grows with the paths actually in use
+        if (PathIter->second.empty())
+          Map.erase(PathIter);
       }
 
       ReverseMap.erase(Iter);
     }
   }
 
+  /// \return the part of this map about the targets in \p List of
+  ///         \p ContainerName
+  PathTargetBimap extract(const TargetsList &List,
+                          llvm::StringRef ContainerName) const {
+    PathTargetBimap Result;
+    for (const Target &Target : List) {
+      TargetInContainer Located(Target, ContainerName.str());
+      auto Iter = ReverseMap.find(Located);
+      if (Iter == ReverseMap.end())
+        continue;
+
+      for (const TupleTreePath &Path : Iter->second)
+        Result.insert(Located, Path);
+    }
+    return Result;
+  }
+
+  /// Append to \p Out the targets of \p ContainerName with some path recorded
+  void collectTargets(llvm::StringRef ContainerName,
+                      TargetsList::List &Out) const {
+    for (const auto &Entry : ReverseMap)
+      if (Entry.first.getContainerName() == ContainerName)
+        Out.push_back(Entry.first.getTarget());
+  }
+
 public:
   bool contains(const TargetInContainer &Target) const {
     return ReverseMap.find(Target) != ReverseMap.end();
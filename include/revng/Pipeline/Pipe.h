@@ -13,6 +13,7 @@
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/Support/Error.h"
@@ -35,10 +36,14 @@ class PipeExecutionEntry {
 public:
   ContainerToTargetsMap Output;
   ContainerToTargetsMap Input;
+  /// True if none of the containers the pipe writes to holds targets that are
+  /// requested at the end of this invocation, so that it can be skipped
+  bool Skippable;
 
   PipeExecutionEntry(ContainerToTargetsMap Output,
-                     ContainerToTargetsMap Input) :
-    Output(std::move(Output)), Input(std::move(Input)) {}
+                     ContainerToTargetsMap Input,
+                     bool Skippable = false) :
+    Output(std::move(Output)), Input(std::move(Input)), Skippable(Skippable) {}
 };
 
 namespace detail {
@@ -175,7 +180,21 @@ public:
     auto TargetsProducedByMe = Target;
     TargetsProducedByMe.erase(Requirements);
 
-    return PipeExecutionEntry(TargetsProducedByMe, Requirements);
+    // If no target is requested from the containers this pipe can write to,
+    // no one needs its work. Pipes without a contract (e.g., optimization
+    // pipelines) are never skipped, since we cannot tell what they produce.
+    bool Skippable = Contracts.size() != 0;
+    const auto &Names = Invokable.getRunningContainersNames();
+    for (size_t I = 0; I < Names.size() and Skippable; ++I) {
+      if (Invokable.isContainerArgumentConst(I))
+        continue;
+
+      auto It = Target.find(Names[I]);
+      if (It != Target.end() and not It->second.empty())
+        Skippable = false;
+    }
+
+    return PipeExecutionEntry(TargetsProducedByMe, Requirements, Skippable);
   }
 
   ContainerToTargetsMap
@@ -276,8 +295,14 @@ struct PipeWrapper {
           Log << DoLog;
         }
 
+        // Group by container and sort once, rather than inserting targets one
+        // by one into sorted lists
+        llvm::StringMap<TargetsList::List> ByContainer;
         for (const auto &Entry : It->second)
-          Out.add(Entry.getContainerName(), Entry.getTarget());
+          ByContainer[Entry.getContainerName()].push_back(Entry.getTarget());
+
+        for (auto &[ContainerName, Targets] : ByContainer)
+          Out[ContainerName].merge(TargetsList(std::move(Targets)));
       }
     }
 
@@ -4,9 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
@@ -20,6 +23,7 @@
 #include "revng/Pipeline/KindsRegistry.h"
 #include "revng/Pipeline/Step.h"
 #include "revng/Pipeline/Target.h"
+#include "revng/Storage/MemoryStorageClient.h"
 #include "revng/Storage/Path.h"
 #include "revng/Support/Debug.h"
 
@@ -43,6 +47,15 @@ private:
   Vector ReversePostOrderIndexes;
   llvm::StringMap<AnalysesList> AnalysesLists;
 
+private:
+  /// Produce \p Targets in the step of the analysis and run it, leaving the
+  /// invalidations to the caller
+  llvm::Error produceAndRunAnalysis(llvm::StringRef AnalysisName,
+                                    llvm::StringRef StepName,
+                                    const ContainerToTargetsMap &Targets,
+                                    const llvm::StringMap<std::string>
+                                      &Options);
+
 public:
   template<typename T>
   using DereferenceIteratorType = ::revng::DereferenceIteratorType<T>;
@@ -53,6 +66,25 @@ public:
   // TODO: rename
   using State = llvm::StringMap<ContainerToTargetsMap>;
 
+  /// Everything store would write, serialized in memory, to be written later,
+  /// possibly from another thread, regardless of what happens to the runner in
+  /// the meantime
+  class Snapshot {
+  private:
+    friend class Runner;
+
+    revng::DirectoryPath Directory;
+    std::unique_ptr<revng::MemoryStorageClient> Memory;
+    std::vector<ContainerSet::Snapshot> Steps;
+
+    explicit Snapshot(const revng::DirectoryPath &Directory) :
+      Directory(Directory),
+      Memory(std::make_unique<revng::MemoryStorageClient>()) {}
+
+  public:
+    llvm::Error store() const;
+  };
+
 public:
   explicit Runner(Context &C) : TheContext(&C) {}
 
@@ -74,6 +106,27 @@ public:
 
   llvm::Error apply(const GlobalTupleTreeDiff &Diff,
                     pipeline::TargetInStepSet &Map);
+
+  /// Like apply, for the diffs of all the globals at once, so that the
+  /// invalidations are propagated and performed only once
+  llvm::Error apply(const DiffMap &Diffs, pipeline::TargetInStepSet &Map);
+
+  /// Applies \p Diffs, in order, to the globals and invalidates what they
+  /// have changed.
+  ///
+  /// The diffs of each global are merged and the invalidations are computed
+  /// and performed only once for the whole batch, so that many small diffs
+  /// cost about as much as a large one.
+  ///
+  /// \return for each diff, whether it could be applied. A diff which cannot
+  ///         be applied leaves its global as it was, and does not prevent
+  ///         the others from being applied. If the globals resulting from the
+  ///         batch fail to verify, nothing is applied and an error is
+  ///         returned instead.
+  llvm::Expected<std::vector<llvm::Error>>
+  applyDiffs(llvm::ArrayRef<GlobalTupleTreeDiff> Diffs,
+             pipeline::TargetInStepSet &Map);
+
   void getDiffInvalidations(const GlobalTupleTreeDiff &Diff,
                             pipeline::TargetInStepSet &Out) const;
 
@@ -116,9 +169,13 @@ public:
   }
 
   void addAnalysesList(llvm::StringRef Name,
-                       llvm::ArrayRef<AnalysisReference> Analyses) {
+                       llvm::ArrayRef<AnalysisReference> Analyses,
+                       bool DeferInvalidation = false) {
     revng_assert(not hasAnalysesList(Name));
-    AnalysesLists.try_emplace(Name, pipeline::AnalysesList(Name, Analyses));
+    AnalysesLists.try_emplace(Name,
+                              pipeline::AnalysesList(Name,
+                                                     Analyses,
+                                                     DeferInvalidation));
   }
 
   pipeline::description::PipelineDescription description() const;
@@ -179,6 +236,12 @@ public:
               pipeline::TargetInStepSet &InvalidationsMap,
               const llvm::StringMap<std::string> &Options = {});
 
+  /// If a cancellation is requested after some analyses have run, stops before
+  /// the next one and returns the diff of those that did run.
+  ///
+  /// Invalidations are applied after each analysis, unless the list defers
+  /// them (see `AnalysesList::defersInvalidation`), in which case they are
+  /// computed and applied once, from the diff of the whole list.
   llvm::Expected<DiffMap>
   runAnalyses(const AnalysesList &List,
               pipeline::TargetInStepSet &InvalidationsMap,
@@ -215,6 +278,12 @@ public:
   }
   llvm::Error storeStepToDisk(llvm::StringRef StepName,
                               const revng::DirectoryPath &DirPath) const;
+
+  /// Serializes what store would write in \p DirPath. The containers are
+  /// considered stored from now on: if the snapshot does not get stored, call
+  /// forgetStored.
+  llvm::Expected<Snapshot> snapshot(const revng::DirectoryPath &DirPath) const;
+  void forgetStored() const;
   llvm::Error load(const revng::DirectoryPath &DirPath);
 
   std::vector<revng::FilePath>
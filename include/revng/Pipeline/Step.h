@@ -106,23 +106,39 @@ public:
                                   const TupleTreePath &Path,
                                   TargetInStepSet &Out,
                                   Logger<> &Log) const {
+    const TupleTreePath *Paths[] = { &Path };
+    registerTargetsDependingOn(GlobalName, Paths, Out, Log);
+  }
+
+  /// Like the single path version, but the targets found are intersected with
+  /// the content of the containers only once for all the paths: this is what
+  /// makes the cost depend on the size of the diff rather than on it times the
+  /// number of targets.
+  void registerTargetsDependingOn(llvm::StringRef GlobalName,
+                                  llvm::ArrayRef<const TupleTreePath *> Paths,
+                                  TargetInStepSet &Out,
+                                  Logger<> &Log) const {
     ContainerToTargetsMap OutMap;
 
-    for (const PipeWrapper &Pipe : Pipes) {
-      revng_log(Log, "Handling the " << Pipe.Pipe->getName() << " Pipe");
-      LoggerIndent<> Indent(Log);
-      Pipe.InvalidationMetadata.registerTargetsDependingOn(*Ctx,
-                                                           GlobalName,
-                                                           Path,
-                                                           OutMap,
-                                                           Log);
+    for (const TupleTreePath *Path : Paths) {
+      for (const PipeWrapper &Pipe : Pipes) {
+        revng_log(Log, "Handling the " << Pipe.Pipe->getName() << " Pipe");
+        LoggerIndent<> Indent(Log);
+        Pipe.InvalidationMetadata.registerTargetsDependingOn(*Ctx,
+                                                             GlobalName,
+                                                             *Path,
+                                                             OutMap,
+                                                             Log);
+      }
     }
 
     for (auto &Container : OutMap) {
-      if (Containers.contains(Container.first()))
-        Container.second = Container.second.intersect(Containers
-                                                        .at(Container.first())
-                                                        .enumerate());
+      if (Container.second.empty())
+        continue;
+
+      llvm::StringRef Name = Container.first();
+      if (Containers.contains(Name))
+        Container.second = Container.second.intersect(Containers.enumerate(Name));
     }
 
     Out[getName()].merge(OutMap);
@@ -137,9 +153,69 @@ public:
     return false;
   }
 
+  /// \return the targets of \p Existing, in \p ContainerName, for which no
+  ///         pipe has recorded the paths of \p GlobalName they have been
+  ///         produced from.
+  ///
+  /// Unlike one invalidationMetadataContains call per target, the metadata of
+  /// each pipe is visited only once.
+  TargetsList untrackedTargets(llvm::StringRef GlobalName,
+                               llvm::StringRef ContainerName,
+                               const TargetsList &Existing) const {
+    TargetsList::List Tracked;
+    for (const PipeWrapper &Pipe : Pipes) {
+      const auto &PathCache = Pipe.InvalidationMetadata.getPathCache();
+      if (auto It = PathCache.find(GlobalName); It != PathCache.end())
+        It->second.collectTargets(ContainerName, Tracked);
+    }
+
+    TargetsList Result = Existing;
+    Result.remove(TargetsList(std::move(Tracked)));
+    return Result;
+  }
+
+  /// Call \p OnRead on each path of \p GlobalName that the pipes of this step
+  /// read while producing the targets they currently hold
+  void forEachReadPath(llvm::StringRef GlobalName,
+                       revng::Tracking::PathCallback OnRead) const {
+    for (const PipeWrapper &Pipe : Pipes) {
+      const auto &PathCache = Pipe.InvalidationMetadata.getPathCache();
+      auto It = PathCache.find(GlobalName);
+      if (It == PathCache.end())
+        continue;
+
+      for (const auto &Entry : It->second)
+        OnRead(Entry.first);
+    }
+  }
+
 private:
-  llvm::Error loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
-                                           ContainerSet::value_type &Pair);
+  /// Forget every path recorded as read while producing \p Targets
+  void dropInvalidationMetadata(const ContainerToTargetsMap &Targets);
+
+public:
+  /// Store in \p File the paths the pipes read while producing \p Targets of
+  /// \p ContainerName, for replaceInvalidationMetadata to pick them up in
+  /// another process
+  llvm::Error storeInvalidationMetadata(const revng::FilePath &File,
+                                        llvm::StringRef ContainerName,
+                                        const TargetsList &Targets) const;
+
+  /// Replace what is known about the paths read while producing \p Targets of
+  /// \p ContainerName with what storeInvalidationMetadata stored in \p File
+  llvm::Error replaceInvalidationMetadata(const revng::FilePath &File,
+                                          llvm::StringRef ContainerName,
+                                          const TargetsList &Targets);
+
+private:
+  llvm::Error loadInvalidationMetadataImpl(const revng::FilePath &File,
+                                           llvm::StringRef ContainerName);
+
+  /// Store in \p File the invalidation metadata of \p ContainerName, only for
+  /// the targets in \p Only, if not null
+  llvm::Error storeInvalidationMetadataImpl(const revng::FilePath &File,
+                                            llvm::StringRef ContainerName,
+                                            const TargetsList *Only) const;
 
 private:
   llvm::Error loadInvalidationMetadata(const revng::DirectoryPath &Path);
@@ -233,7 +309,7 @@ public:
 
     const std::string &ContainerName = Artifacts.Container;
     if (Containers.isContainerRegistered(ContainerName)) {
-      Containers[ContainerName];
+      Containers.instantiate(ContainerName);
       return &*Containers.find(ContainerName);
     } else {
       return nullptr;
@@ -266,10 +342,13 @@ public:
                           const ContainerToTargetsMap &Targets,
                           const llvm::StringMap<std::string> &ExtraArgs = {});
 
-  /// Executes all the pipes of this step, merges the results in the final
-  /// containers and returns the containers filtered according to the request.
-  ContainerSet run(ContainerSet &&Targets,
-                   const std::vector<PipeExecutionEntry> &ExecutionInfos);
+  /// Executes all the pipes of this step and merges the results in the final
+  /// containers.
+  ///
+  /// If a cancellation is requested (see Context::setCancellationFlag) while
+  /// the pipes are running, nothing is merged and a CancelledError is returned.
+  llvm::Error run(ContainerSet &&Targets,
+                  const std::vector<PipeExecutionEntry> &ExecutionInfos);
 
   void pipeInvalidate(const GlobalTupleTreeDiff &Diff,
                       ContainerToTargetsMap &Map) const;
@@ -296,6 +375,12 @@ public:
 
 public:
   llvm::Error store(const revng::DirectoryPath &DirPath) const;
+
+  /// Writes in \p Staging what store would write in \p DirPath, see
+  /// ContainerSet::snapshot
+  llvm::Expected<ContainerSet::Snapshot>
+  snapshot(const revng::DirectoryPath &DirPath,
+           const revng::DirectoryPath &Staging) const;
   llvm::Error load(const revng::DirectoryPath &DirPath);
 
   std::vector<revng::FilePath>
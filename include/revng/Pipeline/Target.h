@@ -14,6 +14,7 @@
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringExtras.h"
@@ -45,22 +46,28 @@ private:
   using PathComponents = std::vector<std::string>;
   PathComponents Components;
   const Kind *K;
+  /// Hash of K and Components, so that telling apart two targets rarely
+  /// requires comparing strings. Not stable across processes.
+  size_t Hash = 0;
 
 public:
   Target(PathComponents Components, const Kind &K) :
     Components(std::move(Components)), K(&K) {
     revng_assert(this->Components.size() == getKind().depth());
+    updateHash();
   }
 
   Target(std::string PathComponent, const Kind &K) :
     Components({ std::move(PathComponent) }), K(&K) {
     revng_assert(this->Components.size() == getKind().depth());
+    updateHash();
   }
 
   Target(std::initializer_list<std::string> Names, const Kind &K) : K(&K) {
     for (auto Name : Names)
       Components.emplace_back(Name);
     revng_assert(this->Components.size() == getKind().depth());
+    updateHash();
   }
 
   Target(llvm::ArrayRef<llvm::StringRef> Names, const Kind &K) : K(&K) {
@@ -68,10 +75,12 @@ public:
       Components.emplace_back(Name.str());
     }
     revng_assert(this->Components.size() == getKind().depth());
+    updateHash();
   }
 
   Target(const Kind &K) : K(&K) {
     revng_assert(this->Components.size() == getKind().depth());
+    updateHash();
   }
 
 public:
@@ -87,14 +96,28 @@ public:
 
   int operator<=>(const Target &Other) const;
 
-  bool operator==(const Target &Other) const { return (*this <=> Other) == 0; }
+  bool operator==(const Target &Other) const {
+    return Hash == Other.Hash and (*this <=> Other) == 0;
+  }
 
 public:
   const Kind &getKind() const { return *K; }
   const PathComponents &getPathComponents() const { return Components; }
+  size_t hash() const { return Hash; }
 
 public:
-  void setKind(const Kind &NewKind) { K = &NewKind; }
+  void setKind(const Kind &NewKind) {
+    K = &NewKind;
+    updateHash();
+  }
+
+private:
+  void updateHash() {
+    using llvm::hash_combine_range;
+    Hash = llvm::hash_combine(K,
+                              hash_combine_range(Components.begin(),
+                                                 Components.end()));
+  }
 
 public:
   llvm::Error verify(const ContainerBase &Container) const {
@@ -140,7 +163,10 @@ llvm::Error parseTarget(const Context &Ctx,
                         const KindsRegistry &Dict,
                         TargetsList &Out);
 
-/// a sorted list of targets.
+/// A sorted list of targets, without duplicates.
+///
+/// Insertions and lookups rely on the list being sorted: elements must not be
+/// modified in a way that changes their relative order.
 class TargetsList {
 public:
   using List = llvm::SmallVector<Target, 4>;
@@ -156,7 +182,7 @@ private:
 
 public:
   TargetsList() = default;
-  TargetsList(List C) : Contained(std::move(C)) {}
+  TargetsList(List C) : Contained(std::move(C)) { normalize(); }
   static TargetsList allTargets(const Context &Ctx, const Kind &K) {
     TargetsList ToReturn;
     K.appendAllTargets(Ctx, ToReturn);
@@ -207,20 +233,17 @@ public:
 public:
   template<typename... Args>
   void emplace_back(Args &&...A) {
-    Contained.emplace_back(std::forward<Args>(A)...);
-    llvm::sort(Contained);
-    Contained.erase(unique(Contained.begin(), Contained.end()),
-                    Contained.end());
+    insert(Target(std::forward<Args>(A)...));
   }
 
   void merge(const TargetsList &Other);
+  void merge(TargetsList &&Other);
 
-  void push_back(const Target &Target) {
-    Contained.push_back(Target);
-    llvm::sort(Contained);
-    Contained.erase(unique(Contained.begin(), Contained.end()),
-                    Contained.end());
-  }
+  /// Adds all of \p Targets, in any order. Cheaper than adding them one at a
+  /// time, since the list is sorted only once.
+  void append(List &&Targets) { merge(TargetsList(std::move(Targets))); }
+
+  void push_back(const Target &Target) { insert(Target); }
 
   template<typename... Args>
   auto erase(Args &&...A) {
@@ -228,10 +251,15 @@ public:
   }
 
   void erase(const Target &Target) {
-    Contained.erase(std::remove(Contained.begin(), Contained.end(), Target),
-                    Contained.end());
+    auto [Begin, End] = std::equal_range(Contained.begin(),
+                                         Contained.end(),
+                                         Target);
+    Contained.erase(Begin, End);
   }
 
+  /// Removes all the targets in \p Other
+  void remove(const TargetsList &Other);
+
   TargetsList intersect(const TargetsList &Other) const {
     TargetsList ToReturn;
     std::set_intersection(begin(),
@@ -239,10 +267,31 @@ public:
                           Other.begin(),
                           Other.end(),
                           std::back_inserter(ToReturn.Contained));
-    llvm::sort(ToReturn.Contained);
     return ToReturn;
   }
 
+private:
+  void insert(Target &&NewTarget) {
+    // Targets are often added in order
+    if (Contained.empty() or Contained.back() < NewTarget) {
+      Contained.push_back(std::move(NewTarget));
+      return;
+    }
+
+    auto It = std::lower_bound(Contained.begin(), Contained.end(), NewTarget);
+    if (It == Contained.end() or *It != NewTarget)
+      Contained.insert(It, std::move(NewTarget));
+  }
+
+  void insert(const Target &NewTarget) { insert(Target(NewTarget)); }
+
+  void normalize() {
+    if (not std::is_sorted(Contained.begin(), Contained.end()))
+      llvm::sort(Contained);
+    Contained.erase(unique(Contained.begin(), Contained.end()),
+                    Contained.end());
+  }
+
 private:
   struct Comp {
     bool operator()(const Target &T, const Kind &K) const {
@@ -264,6 +313,11 @@ public:
     return llvm::make_range(b, e);
   }
 
+  /// \return true if any target has kind \p K, without enumerating the kinds
+  bool containsKind(const Kind &K) const {
+    return std::binary_search(begin(), end(), K, Comp());
+  }
+
   llvm::SmallVector<const Kind *, 4> getContainedKinds() const {
     llvm::SmallVector<const Kind *, 4> ToReturn;
 
@@ -368,8 +422,7 @@ public:
   }
 
   void add(llvm::StringRef Name, const TargetsList &Targets) {
-    for (const auto &Target : Targets)
-      Status[Name].emplace_back(Target);
+    Status[Name].merge(Targets);
   }
 
 public:
@@ -394,7 +447,7 @@ public:
 
   void dump() const debug_function { dump(dbg); }
 
-private:
+public:
   size_t targetsCount() const {
     size_t Size = 0;
     for (const auto &Container : Status)
@@ -410,6 +463,15 @@ llvm::Error parseTarget(const Context &Ctx,
                         llvm::StringRef AsString,
                         const KindsRegistry &Dict);
 
+/// \return the targets of \p Targets assigned to the shard \p Shard out of
+///         \p ShardCount.
+///
+/// Each target is assigned to exactly one shard, and to the same one in every
+/// process: independent processes can split a request among themselves
+/// without any coordination.
+TargetsList
+selectShard(const TargetsList &Targets, unsigned Shard, unsigned ShardCount);
+
 inline void merge(TargetInStepSet &Map, const TargetInStepSet &Other) {
   for (const auto &Entry : Other) {
     if (auto Iter = Map.find(Entry.first()); Iter != Map.end()) {
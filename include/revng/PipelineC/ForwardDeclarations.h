@@ -4,11 +4,38 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringRef.h"
+
 #include "revng/Pipeline/Target.h"
 #include "revng/Pipes/PipelineManager.h"
 
 // NOLINTBEGIN
 
+/// The content of an artifact. It either owns its data or, if it has been
+/// created by rp_container_extract_one_view, points into the memory of the
+/// container it has been extracted from.
+struct rp_buffer {
+private:
+  llvm::SmallVector<char, 0> Storage;
+  std::optional<llvm::StringRef> View;
+
+public:
+  rp_buffer() = default;
+  explicit rp_buffer(llvm::StringRef View) : View(View) {}
+
+public:
+  llvm::SmallVector<char, 0> &storage() {
+    revng_assert(not View);
+    return Storage;
+  }
+
+  const char *data() const { return View ? View->data() : Storage.data(); }
+  size_t size() const { return View ? View->size() : Storage.size(); }
+};
+
 struct rp_error_reason {
 public:
   std::string Message;
@@ -41,6 +68,29 @@ using rp_error = std::variant<std::monostate /* allows "no value" state */,
                               rp_simple_error,
                               rp_document_error>;
 
+/// A set of targets to produce, possibly in different steps and containers, and
+/// the containers produced for them by rp_manager_produce_batch
+struct rp_production_batch {
+public:
+  pipeline::Runner::State Requests;
+  revng::pipes::PipelineManager::ProducedTargets Results;
+};
+
+/// A production or an analyses list run started on another thread
+struct rp_async_request {
+public:
+  /// The outcome of a production, once completed
+  std::unique_ptr<rp_buffer> Buffer;
+  /// The outcome of an analyses list run, once completed
+  std::unique_ptr<pipeline::DiffMap> Diffs;
+  llvm::StringMap<std::string> Options;
+  pipeline::TargetInStepSet OwnedInvalidations;
+
+  /// Last, so that it waits for the request before the members above, which
+  /// the request writes, are destroyed
+  std::unique_ptr<revng::pipes::PipelineManager::AsyncRequest> Request;
+};
+
 typedef revng::pipes::PipelineManager rp_manager;
 typedef const pipeline::Kind rp_kind;
 typedef const pipeline::Rank rp_rank;
@@ -53,7 +103,6 @@ typedef const pipeline::Step::AnalysisValueType rp_analysis;
 typedef const pipeline::DiffMap rp_diff_map;
 typedef llvm::StringMap<std::string> rp_string_map;
 typedef pipeline::TargetInStepSet rp_invalidations;
-typedef llvm::SmallVector<char, 0> rp_buffer;
 typedef pipeline::ContainerToTargetsMap rp_container_targets_map;
 typedef const pipeline::AnalysesList rp_analyses_list;
 
@@ -24,5 +24,7 @@ typedef struct rp_invalidations rp_invalidations;
 typedef struct rp_buffer rp_buffer;
 typedef struct rp_container_targets_map rp_container_targets_map;
 typedef struct rp_analyses_list rp_analyses_list;
+typedef struct rp_production_batch rp_production_batch;
+typedef struct rp_async_request rp_async_request;
 
 // NOLINTEND
@@ -98,6 +98,14 @@ bool rp_shutdown();
  */
 void rp_string_destroy(char *string);
 
+/**
+ * \return the metrics of the process, in the OpenMetrics text format: the
+ * number of runs of each pipeline step, the targets they produced and their
+ * duration. If the REVNG_C_API_METRICS environment variable is set, the
+ * durations of the calls to each rp_* function are included too.
+ */
+char * /*owning*/ rp_get_metrics();
+
 /**
  * \defgroup rp_manager rp_manager methods
  * \{
@@ -154,6 +162,27 @@ rp_manager_get_container_identifier_from_name(const rp_manager *manager,
  */
 bool rp_manager_save(rp_manager *manager);
 
+/**
+ * Like rp_manager_save, but the pipeline is written to disk in the background.
+ * Changes made to the pipeline while the save is in progress are not saved.
+ * If a previous save is still in progress, waits for it first.
+ *
+ * \return false if the previous save or the serialization failed, true
+ *         otherwise
+ */
+bool rp_manager_save_async(rp_manager *manager);
+
+/**
+ * \return true if the save started by rp_manager_save_async is in progress
+ */
+bool rp_manager_is_saving(rp_manager *manager);
+
+/**
+ * Wait for the save started by rp_manager_save_async, if any, to complete.
+ * \return false if the save failed, true otherwise
+ */
+bool rp_manager_wait_save(rp_manager *manager);
+
 /**
  * \return the step with the provided name, or NULL if not such step existed.
  */
@@ -190,6 +219,33 @@ rp_manager_produce_targets(rp_manager *manager,
                            rp_error *error);
 LENGTH_HINT(rp_manager_produce_targets, 4, 3)
 
+/**
+ * Request the production of all the targets in \p batch, see
+ * \ref rp_production_batch. Each step is run at most once, no matter how many
+ * containers have been requested from it.
+ *
+ * \return false if an error was encountered, in which case no result is
+ *         available, true otherwise
+ */
+bool rp_manager_produce_batch(rp_manager *manager,
+                              rp_production_batch *batch,
+                              rp_error *error);
+
+/**
+ * Like rp_manager_produce_targets, but the production happens on another
+ * thread, see \ref rp_async_request. \p manager must not be used until the
+ * request completes.
+ *
+ * \return the owning handle of the request
+ */
+rp_async_request * /*owning*/
+rp_manager_produce_targets_async(rp_manager *manager,
+                                 const rp_step *step,
+                                 const rp_container *container,
+                                 uint64_t targets_count,
+                                 const rp_target *targets[]);
+LENGTH_HINT(rp_manager_produce_targets_async, 4, 3)
+
 /**
  * Request to run the required analysis
  *
@@ -229,6 +285,22 @@ rp_manager_run_analyses_list(rp_manager *manager,
                              rp_invalidations *invalidations,
                              rp_error *error);
 
+/**
+ * Like rp_manager_run_analyses_list, but the analyses run on another thread,
+ * see \ref rp_async_request. \p manager must not be used until the request
+ * completes, nor \p invalidations, if provided.
+ *
+ * A cancelled request that already run some of the analyses succeeds, with
+ * the diff of the analyses that did run.
+ *
+ * \return the owning handle of the request
+ */
+rp_async_request * /*owning*/
+rp_manager_run_analyses_list_async(rp_manager *manager,
+                                   const char *list_name,
+                                   const rp_string_map *options,
+                                   rp_invalidations *invalidations);
+
 /**
  * \return the container status associated to the provided \p container
  *         or NULL if no status is associated to the provided container.
@@ -254,6 +326,31 @@ bool rp_manager_set_storage_credentials(rp_manager *manager,
  */
 uint64_t rp_manager_get_context_commit_index(rp_manager *manager);
 
+/**
+ * Set how many bytes of memory the containers can use. When exceeded, the least
+ * recently used containers are stored in the execution directory and dropped
+ * from memory, until they are needed again. 0 means unlimited.
+ *
+ * \note a rp_container whose content has been dropped appears empty until it
+ *       is fetched again with rp_step_get_container.
+ */
+void rp_manager_set_memory_budget(rp_manager *manager, uint64_t bytes);
+
+/**
+ * \return the estimated number of bytes used by the containers of all the
+ *         steps
+ */
+uint64_t rp_manager_get_memory_usage(const rp_manager *manager);
+
+/**
+ * \return the estimated number of bytes used by the global \p global_name, 0
+ *         if unknown or if there is no such global
+ *
+ * \note computing the estimate requires a visit of the whole global
+ */
+uint64_t rp_manager_get_global_memory_usage(const rp_manager *manager,
+                                            const char *global_name);
+
 /** \} */
 
 /**
@@ -287,6 +384,11 @@ rp_targets_list_get_target(const rp_targets_list *targets_list, uint64_t index);
 rp_container *rp_step_get_container(rp_step *step,
                                     const rp_container_identifier *identifier);
 
+/**
+ * \return the estimated number of bytes used by the containers of \p step
+ */
+uint64_t rp_step_get_memory_usage(const rp_step *step);
+
 /** \} */
 
 /**
@@ -356,6 +458,11 @@ bool rp_target_is_ready(const rp_target *target, const rp_container *container);
  */
 const char *rp_container_get_mime(const rp_container *container);
 
+/**
+ * \return the estimated number of bytes used by \p container, 0 if unknown
+ */
+uint64_t rp_container_get_memory_usage(const rp_container *container);
+
 /**
  * Load the provided container given a buffer
  * \param step the step where the container resides
@@ -381,6 +488,45 @@ rp_buffer * /*owning*/
 rp_container_extract_one(const rp_container *container,
                          const rp_target *target);
 
+/**
+ * Like rp_container_extract_one, but, when the container holds the content of
+ * the target as is, the returned buffer points to it rather than to a copy.
+ * Such a buffer must be consumed before the container is changed in any way,
+ * including by producing targets or running analyses.
+ *
+ * \return the serialized content of the element associated to the provided
+ * target, or nullptr if the content hasn't been produced yet
+ */
+rp_buffer * /*owning*/
+rp_container_extract_one_view(const rp_container *container,
+                              const rp_target *target);
+
+/**
+ * Like rp_container_extract_one_view, but only returns the lines of the
+ * content from \p first_line (0-based) to \p first_line + \p line_count,
+ * excluded, so that clients showing very large artifacts can fetch only the
+ * part that is visible. Each line includes its terminating newline, if any,
+ * and is returned as is: for PTML, tags spanning multiple lines are not
+ * balanced. Lines past the end of the content are ignored.
+ *
+ * \return the requested lines of the serialized content of the element
+ * associated to the provided target, or nullptr if the content hasn't been
+ * produced yet
+ */
+rp_buffer * /*owning*/
+rp_container_extract_lines_view(const rp_container *container,
+                                const rp_target *target,
+                                uint64_t first_line,
+                                uint64_t line_count);
+
+/**
+ * \return the number of lines of the serialized content of the element
+ * associated to the provided target (the last one is counted even if not
+ * terminated by a newline), or 0 if the content hasn't been produced yet
+ */
+uint64_t rp_container_get_line_count(const rp_container *container,
+                                     const rp_target *target);
+
 /** \} */
 
 /**
@@ -569,6 +715,96 @@ void rp_buffer_destroy(rp_buffer *buffer);
 
 /** \} */
 
+/**
+ * \defgroup rp_production_batch rp_production_batch methods
+ * \{
+ */
+
+/**
+ * Create a new, empty, rp_production_batch
+ * \return owning pointer to the newly created object
+ */
+rp_production_batch * /*owning*/ rp_production_batch_create();
+
+/**
+ * Free a rp_production_batch
+ */
+void rp_production_batch_destroy(rp_production_batch *batch);
+
+/**
+ * Request the production of \p target in \p container of \p step. Adding the
+ * same target twice has no effect.
+ */
+void rp_production_batch_add(rp_production_batch *batch,
+                             const rp_step *step,
+                             const rp_container *container,
+                             const rp_target *target);
+
+/**
+ * \return the serialized container with the targets requested for it, NULL if
+ *         nothing has been requested (or produced) for \p container in
+ *         \p step
+ */
+rp_buffer * /*owning*/
+rp_production_batch_get_result(const rp_production_batch *batch,
+                               const rp_step *step,
+                               const rp_container *container);
+
+/** \} */
+
+/**
+ * \defgroup rp_async_request rp_async_request methods
+ * \{
+ */
+
+/**
+ * Ask the request to stop as soon as possible. A request that did not
+ * complete in the meantime then fails.
+ */
+void rp_async_request_cancel(rp_async_request *request);
+
+/**
+ * \return true if the request completed, its outcome can be retrieved without
+ *         blocking
+ */
+bool rp_async_request_is_completed(const rp_async_request *request);
+
+/**
+ * \return the tasks the request is currently going through, from the outermost
+ *         one, one per line
+ */
+char * /*owning*/
+rp_async_request_get_progress(const rp_async_request *request);
+
+/**
+ * Wait for the request to complete, can be invoked only once.
+ *
+ * \return false if the request failed or has been cancelled, true otherwise
+ */
+bool rp_async_request_wait(rp_async_request *request, rp_error *error);
+
+/**
+ * \return the serialized container produced by a successful
+ *         rp_manager_produce_targets_async, NULL otherwise or if it has already
+ *         been taken
+ */
+rp_buffer * /*owning*/ rp_async_request_take_buffer(rp_async_request *request);
+
+/**
+ * \return the diff map of a successful rp_manager_run_analyses_list_async,
+ *         NULL otherwise or if it has already been taken
+ */
+rp_diff_map * /*owning*/
+rp_async_request_take_diff_map(rp_async_request *request);
+
+/**
+ * Free a rp_async_request, cancelling it and waiting for it if it's still
+ * running
+ */
+void rp_async_request_destroy(rp_async_request *request);
+
+/** \} */
+
 /**
  * \defgroup rp_container_targets_map rp_container_targets_map methods
  * \{
@@ -0,0 +1,46 @@
+#pragma once
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+
+#include "llvm/ADT/StringRef.h"
+
+// The binary format of PipelineC traces.
+//
+// A binary trace starts with `Magic`, followed by `Version` as a 32 bit
+// integer, followed by a sequence of records. Each record starts with a `Tag`
+// byte. All integers are little endian.
+//
+// * `String`: u32 ID, u32 size, bytes. Defines an interned string.
+// * `Blob`: u32 ID, u64 size, bytes. Defines a buffer, each distinct content
+//   is stored only once.
+// * `Command`: u64 ID, u64 start time, u32 name (a string ID). Starts a
+//   command, all the following records up to `End` belong to it.
+// * `Scalar`: u32 string ID. An argument.
+// * `Buffer`: u32 blob ID. A buffer argument.
+// * `List`: u32 count, count u32 string IDs. A list argument.
+// * `Result`: u32 string ID.
+// * `End`: u64 end time, u64 wall time, u64 peak RSS delta. Ends a command.
+//
+// Strings and blobs are defined before the first command using them, not
+// necessarily right before it. A trace cut short by a crash ends with an
+// incomplete command.
+namespace revng::tracing::binary {
+
+inline constexpr llvm::StringLiteral Magic = "RVNGTRCB";
+inline constexpr uint32_t Version = 2;
+
+enum Tag : uint8_t {
+  String = 1,
+  Blob,
+  Command,
+  Scalar,
+  Buffer,
+  List,
+  Result,
+  End
+};
+
+} // namespace revng::tracing::binary
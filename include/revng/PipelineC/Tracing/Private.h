@@ -6,10 +6,18 @@
 #include "llvm/Support/raw_ostream.h"
 
 namespace revng::tracing {
+
+enum class TraceFormat {
+  YAML,
+  // Compact, see BinaryFormat.h
+  Binary
+};
+
 // Sets the tracing output to the specified stream, closing the previous one
 // if present.
 // This will write a new trace header to the stream and write any
 // subsequent commands.
 // Passing nullptr will disable tracing.
-void setTracing(llvm::raw_ostream *OS = nullptr);
+void setTracing(llvm::raw_ostream *OS = nullptr,
+                TraceFormat Format = TraceFormat::YAML);
 } // namespace revng::tracing
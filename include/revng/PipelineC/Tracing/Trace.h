@@ -3,13 +3,17 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
 #include <set>
 #include <string>
 #include <vector>
 
+#include "llvm/Support/Base64.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/YAMLTraits.h"
 
+#include "revng/PipelineC/Tracing/BinaryFormat.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
 
@@ -37,6 +41,10 @@ private:
   ArgumentState State = Invalid;
   std::string Scalar;
   std::vector<std::string> Sequence;
+  // The content of buffer arguments of binary traces, which is stored as is
+  // rather than in base64 in Scalar. Shared by all the arguments with the same
+  // content.
+  std::shared_ptr<const std::string> Blob;
 
 public:
   bool isValid() const { return State != ArgumentState::Invalid; }
@@ -85,6 +93,23 @@ public:
     return Sequence;
   }
 
+  void setBlob(std::shared_ptr<const std::string> NewBlob) {
+    setState(ArgumentState::Scalar);
+    Blob = std::move(NewBlob);
+  }
+
+  /// \return the content of a buffer argument
+  llvm::Expected<std::vector<char>> decodeBuffer() const {
+    revng_assert(isScalar());
+    if (Blob)
+      return std::vector<char>(Blob->begin(), Blob->end());
+
+    std::vector<char> Result;
+    if (llvm::Error Error = llvm::decodeBase64(Scalar, Result))
+      return std::move(Error);
+    return Result;
+  }
+
 private:
   void setState(const ArgumentState NewState) {
     revng_assert(State == Invalid || State == NewState);
@@ -94,14 +119,27 @@ private:
 
 struct Command {
 public:
-  uint64_t ID;
-  uint64_t StartTime;
+  uint64_t ID = 0;
+  uint64_t StartTime = 0;
   std::string Name;
   std::vector<Argument> Arguments;
   std::string Result;
-  uint64_t EndTime;
+  uint64_t EndTime = 0;
+  // Duration of the call in microseconds, 0 if not recorded
+  uint64_t WallTime = 0;
+  // How much the peak resident set size of the process has grown during the
+  // call, in kilobytes
+  uint64_t PeakRSSDeltaKB = 0;
 
 public:
+  /// \return the duration of the call in microseconds, estimated from the
+  ///         start and end times for traces not recording it, 0 if unknown
+  uint64_t wallTime() const {
+    if (WallTime != 0)
+      return WallTime;
+    return EndTime >= StartTime ? (EndTime - StartTime) * 1000 : 0;
+  }
+
   void dump(llvm::raw_ostream &Stream) const;
 
   void dump() const debug_function {
@@ -116,6 +154,14 @@ struct BufferLocation {
   size_t ArgumentNumber;
 };
 
+// The cost of a command measured while replaying it
+struct CommandMeasurement {
+  size_t CommandNumber = 0;
+  // In microseconds
+  uint64_t WallTime = 0;
+  uint64_t PeakRSSDeltaKB = 0;
+};
+
 struct RunTraceOptions {
 public:
   // If true some assertions will result in a warning rather than aborting
@@ -140,11 +186,21 @@ public:
   getBuffer(const BufferLocation &Location) const;
   llvm::Expected<std::vector<char>> getBuffer(size_t CommandNo,
                                               size_t ArgNo) const;
-  llvm::Error run(const RunTraceOptions Options = {}) const;
+  /// Replay the trace, measuring each command in \p Measurements, if provided
+  llvm::Error
+  run(const RunTraceOptions Options = {},
+      std::vector<CommandMeasurement> *Measurements = nullptr) const;
+
+  /// \return the indexes of the (at most) \p Count commands that took the
+  ///         longest when the trace was recorded, slowest first
+  std::vector<size_t> slowestCommands(size_t Count) const;
 
 public:
   static llvm::Expected<Trace> fromFile(const llvm::StringRef Path);
   static llvm::Expected<Trace> fromBuffer(const llvm::MemoryBuffer &Buffer);
+
+  /// Parse a trace in the format described in BinaryFormat.h
+  static llvm::Expected<Trace> fromBinaryBuffer(llvm::StringRef Buffer);
 };
 
 } // namespace revng::tracing
@@ -169,6 +225,8 @@ struct llvm::yaml::MappingTraits<revng::tracing::Command> {
     TheIO.mapRequired("Arguments", TraceCommand.Arguments);
     TheIO.mapOptional("Result", TraceCommand.Result);
     TheIO.mapOptional("EndTime", TraceCommand.EndTime);
+    TheIO.mapOptional("WallTime", TraceCommand.WallTime, 0);
+    TheIO.mapOptional("PeakRSSDeltaKB", TraceCommand.PeakRSSDeltaKB, 0);
   }
 };
 
@@ -210,6 +268,9 @@ inline llvm::Expected<Trace> Trace::fromFile(const llvm::StringRef Path) {
 
 inline llvm::Expected<Trace>
 Trace::fromBuffer(const llvm::MemoryBuffer &Buffer) {
+  if (Buffer.getBuffer().starts_with(binary::Magic))
+    return fromBinaryBuffer(Buffer.getBuffer());
+
   llvm::yaml::Input YAMLReader(Buffer);
   Trace Trace;
   YAMLReader >> Trace;
@@ -20,9 +20,11 @@ public:
     using namespace pipeline;
     const auto &Model = getModelFromContext(Ctx);
     DisableTracking Guard(*Model);
-    for (const auto &Function : Model->Functions()) {
-      Out.push_back(Target(Function.Entry().toString(), *this));
-    }
+    TargetsList::List Targets;
+    Targets.reserve(Model->Functions().size());
+    for (const auto &Function : Model->Functions())
+      Targets.emplace_back(Function.Entry().toString(), *this);
+    Out.append(std::move(Targets));
   }
 };
 } // namespace revng::kinds
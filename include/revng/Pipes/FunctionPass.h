@@ -5,6 +5,8 @@
 //
 
 #include <concepts>
+#include <memory>
+#include <vector>
 
 #include "llvm/Pass.h"
 
@@ -23,10 +25,29 @@ namespace pipeline {
 
 /// Extent this class to implement a transformation of the IR that needs to read
 /// the model and operates function wise.
+///
+/// A pass can opt-in into a parallel mode by overriding isFunctionLocal. In
+/// that case, before the sequential execution of runOnFunction,
+/// analyzeFunction is invoked on each requested function on a pool of worker
+/// threads (see `-function-pass-threads`). The analysis phase is the only one
+/// running concurrently: the LLVMContext and the model tracking machinery are
+/// not thread safe, therefore runOnFunction, commits to the ExecutionContext
+/// and progress reporting keep happening in the order of the requested
+/// targets.
 class FunctionPassImpl {
+public:
+  /// Base class for the per-function result of analyzeFunction
+  class FunctionAnalysisResult {
+  public:
+    virtual ~FunctionAnalysisResult() = default;
+  };
+
 protected:
   llvm::ModulePass *Pass;
 
+private:
+  FunctionAnalysisResult *CurrentAnalysisResult = nullptr;
+
 public:
   FunctionPassImpl(llvm::ModulePass &Pass) : Pass(&Pass) {}
 
@@ -40,6 +61,34 @@ public:
 
   virtual bool epilogue() { return false; }
 
+public:
+  /// Return true if analyzeFunction has to be invoked, possibly concurrently,
+  /// on all the functions before the sequential runOnFunction phase.
+  virtual bool isFunctionLocal() const { return false; }
+
+  /// Function-local analysis phase.
+  ///
+  /// This method can be invoked concurrently on distinct functions, therefore
+  /// it must not modify the IR, must not create constants, types or metadata
+  /// and must not access the model.
+  virtual std::unique_ptr<FunctionAnalysisResult>
+  analyzeFunction(const llvm::Function &Function) const {
+    return nullptr;
+  }
+
+protected:
+  /// Within runOnFunction, obtain the result of analyzeFunction on the
+  /// function being processed, if any
+  template<std::derived_from<FunctionAnalysisResult> T>
+  T *getAnalysisResult() const {
+    return static_cast<T *>(CurrentAnalysisResult);
+  }
+
+public:
+  void setCurrentAnalysisResult(FunctionAnalysisResult *Result) {
+    CurrentAnalysisResult = Result;
+  }
+
 public:
   template<typename T>
   T &getAnalysis() {
@@ -9,5 +9,17 @@
 #include "revng/Pipeline/Location.h"
 #include "revng/Pipes/Ranks.h"
 
+/// Attached, when debug info is lightweight (see AttachDebugInfo), to the
+/// instructions at which the location in the binary changes, holding the
+/// serialized location
+inline const char *LocationMDName = "revng.location";
+
+/// Attached to the functions whose debug info is lightweight
+inline const char *LightDebugInfoMDName = "revng.light-debug-info";
+
+/// \return the location in the binary of the instruction \p I has been lifted
+///         from, if known.
+///
+/// \note This works both on full and on lightweight debug info.
 std::optional<pipeline::Location<decltype(revng::ranks::Instruction)>>
 getLocation(const llvm::Instruction *I);
@@ -54,8 +54,18 @@ inline FunctionKind FunctionControlFlowGraphSVG(FunctionControlFlowGraphSVGName,
                                                 {},
                                                 {});
 
+inline auto FunctionControlFlowGraphLayoutName = "function-control-flow-graph-"
+                                                "layout";
+inline FunctionKind
+  FunctionControlFlowGraphLayout(FunctionControlFlowGraphLayoutName,
+                                 ranks::Function,
+                                 {},
+                                 {});
+
 inline pipeline::SingleElementKind
   BinaryCrossRelations("binary-cross-relations", ranks::Binary, {}, {});
+inline FunctionKind
+  CrossRelationsIndex("cross-relations-index", ranks::Function, {}, {});
 inline pipeline::SingleElementKind
   CallGraphSVG("call-graph-svg", ranks::Binary, {}, {});
 inline FunctionKind
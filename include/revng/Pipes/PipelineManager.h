@@ -4,9 +4,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "llvm/ADT/FunctionExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/raw_ostream.h"
@@ -16,6 +23,7 @@
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Storage/Path.h"
 #include "revng/Storage/StorageClient.h"
+#include "revng/Support/Progress.h"
 
 namespace revng::pipes {
 
@@ -25,6 +33,50 @@ namespace revng::pipes {
 /// It will care of all configurations including llvm ones and provide a runner
 /// in a usable state.
 class PipelineManager {
+public:
+  /// Step name, to container name, to the container holding the targets
+  /// produced for it
+  using ProducedTargets = llvm::StringMap<
+    llvm::StringMap<std::unique_ptr<pipeline::ContainerBase>>>;
+
+  /// A request running on another thread, see runAsync
+  class AsyncRequest {
+  private:
+    friend class PipelineManager;
+
+  private:
+    std::atomic<bool> Cancelled = false;
+    mutable std::mutex ProgressMutex;
+    std::string Progress;
+    std::future<llvm::Error> Result;
+
+  public:
+    AsyncRequest() = default;
+    /// Cancels the request, if it's still running, and waits for it
+    ~AsyncRequest();
+
+    AsyncRequest(const AsyncRequest &) = delete;
+    AsyncRequest &operator=(const AsyncRequest &) = delete;
+
+  public:
+    /// Asks the request to stop as soon as possible. Unless it completes in
+    /// the meantime, the request then fails with a pipeline::CancelledError.
+    void cancel() { Cancelled = true; }
+
+    bool isCompleted() const;
+
+    /// Waits for the request to complete and returns its outcome. Can be
+    /// invoked only once.
+    llvm::Error wait();
+
+    /// \return the `llvm::Task`s the request is going through, from the
+    ///         outermost one, one per line
+    std::string progress() const;
+
+  private:
+    void setProgress(const llvm::TaskStack &Stack);
+  };
+
 private:
   using Container = pipeline::ContainerSet::value_type;
   explicit PipelineManager(llvm::ArrayRef<std::string> EnablingFlags,
@@ -45,13 +97,24 @@ private:
            const pipeline::TargetsList *>
     ContainerToEnumeration;
   std::string Description;
+  /// Bytes of memory the containers can use before some of them are evicted,
+  /// 0 means unlimited
+  uint64_t MemoryBudget = 0;
+  /// The save started by storeAsync, if any
+  std::future<llvm::Error> PendingSave;
+  /// The digest of the content of the containers of the first step, which is
+  /// part of the keys of the artifact cache. Computed on demand, it's dropped
+  /// when the commit index of the context changes or containers are
+  /// overridden.
+  std::optional<std::string> InputsDigest;
+  uint64_t InputsDigestCommitIndex = 0;
 
 public:
   PipelineManager(PipelineManager &&Other) = default;
   PipelineManager &operator=(PipelineManager &&Other) = default;
   PipelineManager &operator=(const PipelineManager &Other) = delete;
   PipelineManager(const PipelineManager &Other) = delete;
-  ~PipelineManager() = default;
+  ~PipelineManager();
 
   const pipeline::Kind *getKind(llvm::StringRef Name) const {
     return Runner->getKindsRegistry().find(Name);
@@ -102,6 +165,21 @@ public:
   /// the Execution directory if omitted.
   llvm::Error storeStepToDisk(llvm::StringRef StepName);
 
+  /// Like store, but only the serialization happens before returning, while
+  /// the result is written to the execution directory on another thread.
+  /// Changes made in the meantime do not affect the save in flight.
+  ///
+  /// Waits for the previous save to complete, returning its error, if any.
+  /// Operations writing to the execution directory wait for the save too.
+  llvm::Error storeAsync();
+
+  /// \return true if the save started by storeAsync is still in progress
+  bool isSaving() const;
+
+  /// Waits for the save started by storeAsync, if any, to complete and
+  /// returns its outcome
+  llvm::Error waitForSave();
+
   const pipeline::Step::AnalysisValueType &
   getAnalysis(const pipeline::AnalysisReference &Reference) const;
 
@@ -145,6 +223,12 @@ public:
   invalidateFromDiff(const llvm::StringRef Name,
                      const pipeline::GlobalTupleTreeDiff &Diff);
 
+  /// Applies a batch of diffs to the globals, invalidating only once what the
+  /// whole batch has changed, see pipeline::Runner::applyDiffs
+  llvm::Expected<std::vector<llvm::Error>>
+  applyDiffs(llvm::ArrayRef<pipeline::GlobalTupleTreeDiff> Diffs,
+             pipeline::TargetInStepSet &Map);
+
   /// returns the cached list of targets that are known to be available to be
   /// produced in a container
   const pipeline::TargetsList *
@@ -164,11 +248,58 @@ public:
   llvm::Error materializeTargets(const llvm::StringRef StepName,
                                  const pipeline::ContainerToTargetsMap &Map);
 
+  /// Produces the requested targets and returns a copy of the container
+  /// holding only them.
+  ///
+  /// If `-artifact-cache` is enabled, the result is also stored in the
+  /// execution directory, under a key derived from the component hashes, the
+  /// pipeline description, the content of every global, the content of the
+  /// input containers and the requested targets. Later requests with a
+  /// matching key, even from a different process, are served from there.
   llvm::Expected<std::unique_ptr<pipeline::ContainerBase>>
   produceTargets(const llvm::StringRef StepName,
                  const Container &TheContainer,
                  const pipeline::TargetsList &List);
 
+  /// Produces the share of \p List assigned to the shard \p Shard out of
+  /// \p ShardCount (see pipeline::selectShard) and stores it in the execution
+  /// directory, for mergeShards to pick it up.
+  ///
+  /// Along with it, the paths read while producing it are stored, while the
+  /// index of the storage, if any, is left alone (see
+  /// StorageClient::commitSideIndex): this way many processes (possibly on
+  /// different machines) can work on the same execution directory at the same
+  /// time, each one on its own shard.
+  llvm::Error produceShard(const llvm::StringRef StepName,
+                           const Container &TheContainer,
+                           const pipeline::TargetsList &List,
+                           unsigned Shard,
+                           unsigned ShardCount);
+
+  /// Merges into \p ContainerName of \p StepName all the \p ShardCount shards
+  /// stored by produceShard, along with the paths they have been produced
+  /// from, then removes them. Missing shards are an error.
+  llvm::Error mergeShards(const llvm::StringRef StepName,
+                          llvm::StringRef ContainerName,
+                          unsigned ShardCount);
+
+  /// Runs \p Request on another thread. \p Request is interrupted, between
+  /// steps, pipes or functions, as soon as the returned request is cancelled.
+  /// \p OnProgress, if any, is invoked on that thread each time the
+  /// `llvm::Task`s of the request advance.
+  ///
+  /// Nothing but the returned object can be used until the request completes,
+  /// the manager included.
+  std::unique_ptr<AsyncRequest>
+  runAsync(llvm::unique_function<llvm::Error()> Request,
+           revng::ProgressCallbackScope::Callback OnProgress = nullptr);
+
+  /// Like the other overload, for the targets of many containers, possibly in
+  /// different steps. The requests are deduplicated and each step is run at
+  /// most once, rather than once per container.
+  llvm::Expected<ProducedTargets>
+  produceTargets(const pipeline::Runner::State &Requests);
+
   llvm::Expected<pipeline::DiffMap>
   runAnalyses(const pipeline::AnalysesList &List,
               pipeline::TargetInStepSet &Map,
@@ -200,8 +331,35 @@ public:
 
   llvm::Error setStorageCredentials(llvm::StringRef Credentials);
 
+  /// Sets how many bytes the containers of all the steps can use, as estimated
+  /// by ContainerBase::memoryUsage. When exceeded after producing targets or
+  /// running analyses, the least recently used containers are stored in the
+  /// execution directory and dropped from memory, until they are needed again.
+  /// 0 means unlimited. Has no effect if there's no execution directory.
+  void setMemoryBudget(uint64_t Bytes) { MemoryBudget = Bytes; }
+  uint64_t getMemoryBudget() const { return MemoryBudget; }
+
+  /// \return the estimated memory used by the containers of all the steps
+  uint64_t memoryUsage() const;
+
+  /// (global name, serialized path) of the subtrees of the globals that might
+  /// have been read to produce a set of targets. An empty path stands for the
+  /// whole global.
+  using ReadPaths = std::vector<std::pair<std::string, std::string>>;
+
 private:
+  llvm::Error enforceMemoryBudget();
   llvm::Error produceAllPossibleTargets(bool ExpandTargets);
-  llvm::Error computeDescription();
+  llvm::Error computeDescription(llvm::ArrayRef<std::string> PipelineContent,
+                                 llvm::ArrayRef<std::string> EnablingFlags);
+
+  llvm::Expected<std::string> computeInputsDigest();
+  llvm::Expected<std::string>
+  computeRequestKey(llvm::StringRef StepName,
+                    const Container &TheContainer,
+                    const pipeline::TargetsList &List);
+  ReadPaths collectReadPaths(llvm::StringRef StepName) const;
+  std::string computeArtifactKey(llvm::StringRef RequestKey,
+                                 const ReadPaths &Reads) const;
 };
 } // namespace revng::pipes
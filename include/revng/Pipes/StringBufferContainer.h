@@ -65,6 +65,8 @@ public:
 
   void clear() override { *this = StringBufferContainer(this->name()); }
 
+  size_t memoryUsage() const override { return Content.size(); }
+
   llvm::Error serialize(llvm::raw_ostream &OS) const override {
     OS << Content;
     OS.flush();
@@ -5,6 +5,8 @@
 //
 
 #include <map>
+#include <memory>
+#include <optional>
 #include <utility>
 
 #include "llvm/ADT/StringRef.h"
@@ -18,10 +20,12 @@
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Pipes/TypeKind.h"
+#include "revng/Support/GzipStream.h"
 #include "revng/Support/GzipTarFile.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/MetaAddress/YAMLTraits.h"
 #include "revng/Support/YAMLTraits.h"
+#include "revng/Support/ZstdStream.h"
 #include "revng/TupleTree/TupleTree.h"
 
 namespace detail {
@@ -89,7 +93,15 @@ private:
 public:
   using KeyType = RankType::Type;
   using ValueType = std::string;
-  using MapType = typename std::map<KeyType, ValueType>;
+
+private:
+  /// Values are shared by copies of the container, in particular by the clones
+  /// handed to pipes and by what they merge back. A shared value is never
+  /// modified: mutable accesses give out a private copy of it, see `detach`.
+  using SharedValue = std::shared_ptr<ValueType>;
+
+public:
+  using MapType = typename std::map<KeyType, SharedValue>;
   using Iterator = typename MapType::iterator;
   using ConstIterator = typename MapType::const_iterator;
 
@@ -120,6 +132,17 @@ public:
 public:
   void clear() override { Map.clear(); }
 
+  size_t memoryUsage() const override {
+    // Each entry is a node of the map holding the key and the pointer, the
+    // string itself is accounted for in equal parts by its owners
+    size_t Result = Map.size() * sizeof(typename MapType::value_type);
+    for (const auto &Entry : Map) {
+      const SharedValue &Value = Entry.second;
+      Result += (sizeof(ValueType) + Value->size()) / Value.use_count();
+    }
+    return Result;
+  }
+
   std::unique_ptr<pipeline::ContainerBase>
   cloneFiltered(const pipeline::TargetsList &Targets) const override {
     auto Clone = std::make_unique<GenericStringMap>(*this);
@@ -152,6 +175,25 @@ public:
     return llvm::Error::success();
   }
 
+  std::optional<llvm::StringRef>
+  viewOne(const pipeline::Target &Target) const override {
+    revng_check(&Target.getKind() == K);
+
+    std::string KeyString = Target.getPathComponents().back();
+
+    auto It = find(keyFromString(KeyString));
+    revng_check(It != end());
+
+    return llvm::StringRef(It->second);
+  }
+
+  bool contains(const pipeline::Target &Target) const override {
+    if (&Target.getKind() != K)
+      return false;
+
+    return Map.contains(keyFromString(Target.getPathComponents().back()));
+  }
+
   pipeline::TargetsList enumerate() const override {
     pipeline::TargetsList::List Result;
     for (const auto &[Key, Value] : Map)
@@ -186,15 +228,22 @@ public:
   llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) override {
     GzipTarReader Reader(Buffer);
     deserializeImpl(Reader);
-    return llvm::Error::success();
+    return Reader.takeError();
   }
 
   llvm::Error store(const revng::FilePath &Path) const override {
-    auto MaybeWritableFile = Path.getWritableFile(ContentEncoding::Gzip);
+    // Stored archives do not need to be '.tar.gz', they are only read back by
+    // GzipTarReader, which handles both compressions
+    revng::TarCompression Compression = StoredArchiveCompression;
+    ContentEncoding Encoding = Compression == revng::TarCompression::Zstd ?
+                                 ContentEncoding::Zstd :
+                                 ContentEncoding::Gzip;
+    auto MaybeWritableFile = Path.getWritableFile(Encoding);
     if (not MaybeWritableFile)
       return MaybeWritableFile.takeError();
 
-    OffsetMap Offsets = serializeWithOffsets(MaybeWritableFile.get()->os());
+    OffsetMap Offsets = serializeWithOffsets(MaybeWritableFile.get()->os(),
+                                             Compression);
 
     if (auto Error = MaybeWritableFile.get()->commit(); Error)
       return Error;
@@ -224,12 +273,71 @@ public:
       return llvm::Error::success();
     }
 
-    auto MaybeBuffer = Path.getReadableFile();
-    if (not MaybeBuffer)
-      return MaybeBuffer.takeError();
+    // Entries are deserialized while the rest of the archive is fetched
+    auto MaybeStream = Path.getReadableStream();
+    if (not MaybeStream)
+      return MaybeStream.takeError();
 
-    GzipTarReader Reader(MaybeBuffer.get()->buffer());
+    revng::ReadableStream &Stream = *MaybeStream.get();
+    GzipTarReader Reader([&Stream]() { return Stream.next(); });
     deserializeImpl(Reader);
+    return Reader.takeError();
+  }
+
+  /// Uses the index written by store to decompress only the requested entries
+  llvm::Error loadCachedFiltered(const revng::FilePath &Path,
+                                 const pipeline::TargetsList &Targets) override {
+    revng::FilePath IndexPath = Path.addExtension("idx");
+    auto MaybeIndexExists = IndexPath.exists();
+    if (not MaybeIndexExists)
+      return MaybeIndexExists.takeError();
+
+    // No index, e.g., it could not be written
+    if (not MaybeIndexExists.get())
+      return load(Path);
+
+    OffsetMap Offsets;
+    {
+      auto MaybeIndexFile = IndexPath.getReadableFile();
+      if (not MaybeIndexFile)
+        return MaybeIndexFile.takeError();
+
+      llvm::StringRef Index = MaybeIndexFile.get()->buffer().getBuffer();
+      llvm::yaml::Input IndexInput(Index);
+      IndexInput >> Offsets;
+      if (IndexInput.error())
+        return load(Path);
+    }
+
+    auto MaybeFile = Path.getReadableFile();
+    if (not MaybeFile)
+      return MaybeFile.takeError();
+    llvm::StringRef Archive = MaybeFile.get()->buffer().getBuffer();
+
+    clear();
+    for (const pipeline::Target &T : Targets) {
+      revng_assert(&T.getKind() == K);
+      KeyType Key = keyFromString(T.getPathComponents().back());
+      auto It = Offsets.find(Key);
+      if (It == Offsets.end())
+        continue;
+
+      const ::detail::DataOffset &Offset = It->second;
+      if (Offset.End < Offset.Start or Offset.End >= Archive.size())
+        return load(Path);
+
+      llvm::ArrayRef<char> Compressed(Archive.data() + Offset.Start,
+                                      Offset.End - Offset.Start + 1);
+      std::string &Data = (*this)[Key];
+      Data.reserve(Offset.UncompressedSize);
+      llvm::raw_string_ostream OS(Data);
+      if (not isZstd(Compressed))
+        gzipDecompress(OS, Compressed);
+      else if (auto Error = zstdDecompress(OS, Compressed))
+        return Error;
+      OS.flush();
+    }
+
     return llvm::Error::success();
   }
 
@@ -245,46 +353,61 @@ protected:
     // Stuff in Other should overwrite what's in this container.
     // We first merge this->Map into Other.Map (which keeps Other's version if
     // present), and then we replace this->Map with the newly merged version of
-    // Other.Map.
+    // Other.Map. Only the nodes are moved, the values are never copied.
     Other.Map.merge(std::move(this->Map));
     this->Map = std::move(Other.Map);
   }
 
 public:
   /// std::map-like methods
+  ///
+  /// \note mutable accesses to values (including dereferencing non-const
+  ///       iterators) copy them if they are shared with other containers,
+  ///       prefer const accesses to just read them.
+
+  std::string &operator[](KeyType M) {
+    SharedValue &Value = Map[M];
+    if (Value == nullptr)
+      Value = std::make_shared<ValueType>();
+    return detach(Value);
+  };
 
-  std::string &operator[](KeyType M) { return Map[M]; };
-
-  std::string &at(KeyType M) { return Map.at(M); };
-  const std::string &at(KeyType M) const { return Map.at(M); };
+  std::string &at(KeyType M) { return detach(Map.at(M)); };
+  const std::string &at(KeyType M) const { return *Map.at(M); };
 
 private:
+  /// Make \p Value the only owner of its string, copying it if needed
+  static ValueType &detach(SharedValue &Value) {
+    if (Value.use_count() > 1)
+      Value = std::make_shared<ValueType>(*Value);
+    return *Value;
+  }
+
   using IteratedValue = std::pair<const KeyType &, std::string &>;
   inline constexpr static auto mapIt = [](auto &Iterated) -> IteratedValue {
-    return { Iterated.first, Iterated.second };
+    return { Iterated.first, detach(Iterated.second) };
   };
 
   using IteratedCValue = std::pair<const KeyType &, const std::string &>;
   inline constexpr static auto mapCIt = [](auto &Iterated) -> IteratedCValue {
-    return { Iterated.first, Iterated.second };
+    return { Iterated.first, *Iterated.second };
   };
 
 public:
-  auto insert(const ValueType &V) {
-    auto [Iterator, Success] = Map.insert(V);
-    return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
-  };
-  auto insert(ValueType &&V) {
-    auto [Iterator, Success] = Map.insert(std::move(V));
+  auto insert(std::pair<KeyType, std::string> &&V) {
+    auto Shared = std::make_shared<ValueType>(std::move(V.second));
+    auto [Iterator, Success] = Map.insert({ V.first, std::move(Shared) });
     return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
   };
 
   auto insert_or_assign(KeyType Key, const std::string &Value) {
-    auto [Iterator, Success] = Map.insert_or_assign(Key, Value);
+    auto Shared = std::make_shared<ValueType>(Value);
+    auto [Iterator, Success] = Map.insert_or_assign(Key, std::move(Shared));
     return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
   };
   auto insert_or_assign(KeyType Key, std::string &&Value) {
-    auto [Iterator, Success] = Map.insert_or_assign(Key, std::move(Value));
+    auto Shared = std::make_shared<ValueType>(std::move(Value));
+    auto [Iterator, Success] = Map.insert_or_assign(Key, std::move(Shared));
     return std::pair{ revng::map_iterator(Iterator, mapIt), Success };
   };
 
@@ -310,21 +433,35 @@ private:
       llvm::StringRef Name = Entry.Filename;
       revng_assert(Name.consume_back(ArchiveSuffix));
       KeyType Key = keyFromString(Name);
-      std::string Data = std::string(Entry.Data.data(), Entry.Data.size());
-      Map[Key] = Data;
+      Map[Key] = std::make_shared<ValueType>(Entry.Data.data(),
+                                             Entry.Data.size());
     }
   }
 
-  OffsetMap serializeWithOffsets(llvm::raw_ostream &OS) const {
+  OffsetMap serializeWithOffsets(llvm::raw_ostream &OS,
+                                 revng::TarCompression Compression =
+                                   revng::TarCompression::Gzip) const {
     OffsetMap Result;
-    revng::GzipTarWriter Writer(OS);
-    for (auto &[Key, Data] : Map) {
-      std::string Name = keyToString(Key) + ArchiveSuffix;
-      OffsetDescriptor Offsets = Writer.append(Name,
-                                               { Data.data(), Data.size() });
-      Result[Key] = { .UncompressedSize = Data.size(),
-                      .Start = Offsets.DataStart,
-                      .End = Offsets.PaddingStart - 1 };
+    revng::GzipTarWriter Writer(OS, Compression);
+
+    std::vector<std::string> Names;
+    Names.reserve(Map.size());
+    for (auto &[Key, Data] : Map)
+      Names.push_back(keyToString(Key) + ArchiveSuffix);
+
+    std::vector<revng::GzipTarWriter::Input> Inputs;
+    Inputs.reserve(Map.size());
+    for (auto &&[Name, Entry] : llvm::zip(Names, Map)) {
+      const SharedValue &Value = Entry.second;
+      Inputs.push_back({ Name, { Value->data(), Value->size() } });
+    }
+
+    // Entries are compressed in parallel
+    std::vector<OffsetDescriptor> Offsets = Writer.append(Inputs);
+    for (auto &&[Entry, Offset] : llvm::zip(Map, Offsets)) {
+      Result[Entry.first] = { .UncompressedSize = Entry.second->size(),
+                              .Start = Offset.DataStart,
+                              .End = Offset.PaddingStart - 1 };
     }
     Writer.close();
 
@@ -19,9 +19,11 @@ public:
                         pipeline::TargetsList &Out) const override {
     using namespace pipeline;
     const auto &Model = getModelFromContext(Ctx);
-    for (const auto &Type : Model->TypeDefinitions()) {
-      Out.push_back(Target(serializeToString(Type->key()), *this));
-    }
+    TargetsList::List Targets;
+    Targets.reserve(Model->TypeDefinitions().size());
+    for (const auto &Type : Model->TypeDefinitions())
+      Targets.emplace_back(serializeToString(Type->key()), *this);
+    Out.append(std::move(Targets));
   }
 };
 
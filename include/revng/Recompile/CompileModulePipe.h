@@ -7,6 +7,9 @@
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Error.h"
 
 #include "revng/Pipeline/ContainerSet.h"
 #include "revng/Pipeline/Context.h"
@@ -28,9 +31,9 @@ public:
   std::array<pipeline::ContractGroup, 1> getContract() const {
     return { pipeline::ContractGroup(kinds::Root, 0, kinds::Object, 1) };
   }
-  void run(const pipeline::ExecutionContext &,
-           pipeline::LLVMContainer &ModuleContainer,
-           ObjectFileContainer &TargetBinary);
+  llvm::Error run(const pipeline::ExecutionContext &,
+                  pipeline::LLVMContainer &ModuleContainer,
+                  ObjectFileContainer &TargetBinary);
 
   llvm::Error checkPrecondition(const pipeline::Context &Ctx) const {
     return llvm::Error::success();
@@ -50,13 +53,20 @@ public:
     return { pipeline::ContractGroup({ RootPart, IsolatedPart }) };
   }
 
-  void run(const pipeline::ExecutionContext &,
-           pipeline::LLVMContainer &ModuleContainer,
-           ObjectFileContainer &TargetBinary);
+  llvm::Error run(const pipeline::ExecutionContext &,
+                  pipeline::LLVMContainer &ModuleContainer,
+                  ObjectFileContainer &TargetBinary);
 
   llvm::Error checkPrecondition(const pipeline::Context &Ctx) const {
     return llvm::Error::success();
   }
 };
 
+/// Compile \p M in the object file \p OutputPath. If \p PartitionsCount is
+/// greater than one, or `-compile-cache` is set, \p M is split in partitions
+/// which are compiled in parallel and then linked together.
+llvm::Error compileToObjectFile(llvm::Module &M,
+                                llvm::StringRef OutputPath,
+                                unsigned PartitionsCount);
+
 } // namespace revng::pipes
@@ -154,7 +154,7 @@ public:
 
 public:
   void simplify(const llvm::SmallPtrSetImpl<Function::Node *> &ToPreserve) {
-    llvm::erase_if(Nodes, [&ToPreserve](std::unique_ptr<Node> &Owning) -> bool {
+    llvm::erase_if(Nodes, [&ToPreserve](NodePointer &Owning) -> bool {
       auto *N = Owning.get();
 
       // Check preconditions
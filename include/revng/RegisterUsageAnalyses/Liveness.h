@@ -47,10 +47,15 @@ public:
   }
 
   bool isLessOrEqual(const Set &LHS, const Set &RHS) const {
-    // RHS must contain or be equal to LHS
-    Set Intersection = RHS;
-    Intersection &= LHS;
-    return Intersection == LHS;
+    // RHS must contain or be equal to LHS, i.e., LHS has no bits not in RHS
+    return not LHS.test(RHS);
+  }
+
+  bool combineInto(Set &Destination, const Set &Source) const {
+    bool Changed = Source.test(Destination);
+    if (Changed)
+      Destination |= Source;
+    return Changed;
   }
 
   RegisterSet applyTransferFunction(const BlockNode *Block,
@@ -81,5 +86,6 @@ public:
 };
 
 static_assert(MFP::MonotoneFrameworkInstance<Liveness>);
+static_assert(MFP::HasInPlaceCombine<Liveness>);
 
 } // namespace rua
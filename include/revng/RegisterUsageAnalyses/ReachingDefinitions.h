@@ -32,6 +32,11 @@ struct RegisterWriters {
     Read &= Other.Read;
     return *this;
   }
+
+  /// \return true if this has no bit that \p Other doesn't have
+  bool isSubsetOf(const RegisterWriters &Other) const {
+    return not Reaching.test(Other.Reaching) and not Read.test(Other.Read);
+  }
 };
 
 /// One entry per register
@@ -120,16 +125,25 @@ public:
   }
 
   bool isLessOrEqual(const WritersSet &LHS, const WritersSet &RHS) const {
-    for (const auto &[LHSEntry, RHSEntry] : zip(LHS, RHS)) {
-      auto Intersection = LHSEntry;
-      Intersection &= RHSEntry;
-      if (Intersection != LHSEntry)
+    for (const auto &[LHSEntry, RHSEntry] : zip(LHS, RHS))
+      if (not LHSEntry.isSubsetOf(RHSEntry))
         return false;
-    }
 
     return true;
   }
 
+  bool combineInto(WritersSet &Destination, const WritersSet &Source) const {
+    bool Changed = false;
+    for (auto &&[DestinationEntry, SourceEntry] : zip(Destination, Source)) {
+      if (not SourceEntry.isSubsetOf(DestinationEntry)) {
+        DestinationEntry |= SourceEntry;
+        Changed = true;
+      }
+    }
+
+    return Changed;
+  }
+
   WritersSet applyTransferFunction(const Block *Block,
                                    const WritersSet &InitialState) const {
     WritersSet Result = InitialState;
@@ -159,5 +173,6 @@ public:
 };
 
 static_assert(MFP::MonotoneFrameworkInstance<ReachingDefinitions>);
+static_assert(MFP::HasInPlaceCombine<ReachingDefinitions>);
 
 } // namespace rua
@@ -0,0 +1,55 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/ADT/StringMap.h"
+
+#include "revng/Storage/Path.h"
+#include "revng/Storage/StorageClient.h"
+
+namespace revng {
+
+/// StorageClient keeping the files in memory, useful to capture what something
+/// writes in order to move it to another storage later on
+class MemoryStorageClient : public StorageClient {
+private:
+  struct File {
+    std::string Content;
+    ContentEncoding Encoding = ContentEncoding::None;
+  };
+
+  llvm::StringMap<File> Files;
+
+public:
+  MemoryStorageClient() = default;
+  ~MemoryStorageClient() override = default;
+
+  llvm::Expected<PathType> type(llvm::StringRef Path) override;
+  llvm::Error createDirectory(llvm::StringRef Path) override;
+  llvm::Error remove(llvm::StringRef Path) override;
+  llvm::sys::path::Style getStyle() const override;
+
+  llvm::Error copy(llvm::StringRef Source,
+                   llvm::StringRef Destination) override;
+
+  llvm::Expected<std::unique_ptr<ReadableFile>>
+  getReadableFile(llvm::StringRef Path) override;
+
+  llvm::Expected<std::unique_ptr<WritableFile>>
+  getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) override;
+
+public:
+  DirectoryPath root() { return DirectoryPath(this, ""); }
+
+  /// Writes all the files in \p Destination, with the same relative paths
+  llvm::Error writeTo(const DirectoryPath &Destination) const;
+
+private:
+  std::string dumpString() const override { return "memory"; }
+};
+
+} // namespace revng
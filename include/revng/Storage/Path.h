@@ -33,6 +33,8 @@ public:
   }
 
   bool isValid() const { return Client != nullptr; }
+
+  bool operator==(const PathBase &Other) const = default;
 };
 
 class FilePath : public PathBase {
@@ -74,6 +76,16 @@ public:
     return Client->getReadableFile(SubPath);
   };
 
+  /// Like getReadableFile, but the content is produced in chunks as it is
+  /// fetched, see StorageClient::getReadableStream
+  llvm::Expected<std::unique_ptr<ReadableStream>> getReadableStream() const {
+    return Client->getReadableStream(SubPath);
+  };
+
+  /// Hints that \p Paths are going to be read soon, see
+  /// StorageClient::prefetch
+  static void prefetch(llvm::ArrayRef<FilePath> Paths);
+
   /// This function will allow the user of a FilePath to obtain a wrapped
   /// llvm::raw_ostream that can be used to write to the file (reminder to then
   /// call WritableFile::commit). The Encoding parameter is useful only on some
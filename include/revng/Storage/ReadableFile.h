@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <memory>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 
 namespace revng {
@@ -20,7 +24,72 @@ public:
   ReadableFile(ReadableFile &&Other) = delete;
   ReadableFile &operator=(ReadableFile &&Other) = delete;
 
+  /// \note the buffer might be backed by a memory mapping of the file and is
+  ///       not guaranteed to be null-terminated
   virtual llvm::MemoryBuffer &buffer() = 0;
 };
 
+/// Sequential access to the content of a file, a chunk at a time, so that it
+/// can be consumed while it is still being fetched
+class ReadableStream {
+protected:
+  ReadableStream() = default;
+
+public:
+  virtual ~ReadableStream() = default;
+
+  ReadableStream(const ReadableStream &Other) = delete;
+  ReadableStream &operator=(const ReadableStream &Other) = delete;
+  ReadableStream(ReadableStream &&Other) = delete;
+  ReadableStream &operator=(ReadableStream &&Other) = delete;
+
+  /// \return the next chunk of the file, which stays valid until the next
+  ///         call, or an empty chunk once the file is over
+  virtual llvm::Expected<llvm::ArrayRef<char>> next() = 0;
+};
+
+/// ReadableStream producing the whole content of a ReadableFile at once
+class WholeFileReadableStream : public ReadableStream {
+private:
+  std::unique_ptr<ReadableFile> File;
+  bool Consumed = false;
+
+public:
+  WholeFileReadableStream(std::unique_ptr<ReadableFile> &&File) :
+    File(std::move(File)) {}
+
+  llvm::Expected<llvm::ArrayRef<char>> next() override {
+    if (Consumed)
+      return llvm::ArrayRef<char>();
+
+    Consumed = true;
+    llvm::MemoryBuffer &Buffer = File->buffer();
+    return llvm::ArrayRef<char>(Buffer.getBufferStart(),
+                                Buffer.getBufferSize());
+  }
+};
+
+/// MemoryBuffer owning the ReadableFile whose content it exposes, for the APIs
+/// that want to take ownership of the buffer they read (e.g., lazy loading of
+/// LLVM bitcode), without copying the content
+class OwningReadableFileBuffer : public llvm::MemoryBuffer {
+private:
+  std::unique_ptr<ReadableFile> File;
+
+public:
+  OwningReadableFileBuffer(std::unique_ptr<ReadableFile> &&File) :
+    File(std::move(File)) {
+    llvm::MemoryBuffer &Buffer = this->File->buffer();
+    init(Buffer.getBufferStart(), Buffer.getBufferEnd(), false);
+  }
+
+  llvm::StringRef getBufferIdentifier() const override {
+    return File->buffer().getBufferIdentifier();
+  }
+
+  BufferKind getBufferKind() const override {
+    return File->buffer().getBufferKind();
+  }
+};
+
 } // namespace revng
@@ -5,7 +5,9 @@
 //
 
 #include <memory>
+#include <string>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
@@ -21,7 +23,8 @@ namespace revng {
 
 enum class ContentEncoding {
   None,
-  Gzip
+  Gzip,
+  Zstd
 };
 
 enum class PathType {
@@ -40,6 +43,9 @@ enum class PathType {
 /// guaranteed that the buffers/streams returned by ::getWritableFile or
 /// ::getReadableFile are actually backed by a file in the filesystem.
 ///
+/// Implementations must allow calls from different threads at the same time,
+/// as long as they operate on different paths.
+///
 /// Currently the following backends are supported:
 /// * Local filesystem via ordinary unix paths
 /// * S3 storage via the 's3://' and 's3s://` uris
@@ -100,11 +106,40 @@ public:
   virtual llvm::Expected<std::unique_ptr<ReadableFile>>
   getReadableFile(llvm::StringRef Path) = 0;
 
+  /// Like getReadableFile, but allows consuming the beginning of the file
+  /// while the rest is being fetched, on backends where that makes sense
+  virtual llvm::Expected<std::unique_ptr<ReadableStream>>
+  getReadableStream(llvm::StringRef Path) {
+    auto MaybeFile = getReadableFile(Path);
+    if (not MaybeFile)
+      return MaybeFile.takeError();
+    return std::make_unique<WholeFileReadableStream>(std::move(*MaybeFile));
+  }
+
   virtual llvm::Expected<std::unique_ptr<WritableFile>>
   getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) = 0;
 
+  /// Hints that the files at \p Paths are going to be read soon, so that
+  /// backends can start fetching them in the background. It never fails:
+  /// errors, if any, are reported by the actual read.
+  virtual void prefetch(llvm::ArrayRef<std::string> Paths) {}
+
   virtual llvm::Error commit() { return llvm::Error::success(); };
 
+  /// Like ::commit, but leaves alone whatever the backend shares among all its
+  /// clients (e.g. an index): the files written by this client are recorded
+  /// under the name \p Name instead, until ::mergeSideIndex picks them up.
+  /// This way, clients writing disjoint files can commit concurrently.
+  /// Removals are not recorded.
+  virtual llvm::Error commitSideIndex(llvm::StringRef Name) { return commit(); }
+
+  /// Makes visible to this client the files recorded by ::commitSideIndex
+  /// under the name \p Name. The next ::commit makes this persistent and
+  /// drops the record.
+  virtual llvm::Error mergeSideIndex(llvm::StringRef Name) {
+    return llvm::Error::success();
+  }
+
   virtual llvm::Error setCredentials(llvm::StringRef Credentials) {
     return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                    "Not Supported");
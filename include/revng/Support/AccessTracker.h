@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include "llvm/ADT/StringRef.h"
@@ -38,7 +40,12 @@ public:
     Counter &= ~0x1;
     IsTracking = true;
   }
-  void access() { Counter |= (0x1 & IsTracking); }
+  void access() {
+    // Don't write if not tracking, so that untracked objects can be safely
+    // read from multiple threads
+    if (IsTracking)
+      Counter |= 0x1;
+  }
   void push() {
     bool HasLeadingZeroes = llvm::countLeadingZeros(Counter) != 0;
     revng_assert(HasLeadingZeroes, "More than 8 pushes have been performed");
@@ -51,4 +58,44 @@ public:
   void stopTracking() { IsTracking = false; }
 };
 
+/// The AccessTrackers of the \p N fields of an object, packed together.
+///
+/// All the fields of an object start and stop being tracked together, so they
+/// share a single flag: N + 1 bytes instead of 2 * N.
+template<size_t N>
+class FieldAccessTracker {
+private:
+  std::array<std::uint8_t, N> Counters = {};
+  bool IsTracking = false;
+
+public:
+  bool operator==(const FieldAccessTracker &Other) const = default;
+
+public:
+  void clear() {
+    for (std::uint8_t &Counter : Counters)
+      Counter &= ~0x1;
+    IsTracking = true;
+  }
+  void access(size_t Index) {
+    // Don't write if not tracking, so that untracked objects can be safely
+    // read from multiple threads
+    if (IsTracking)
+      Counters[Index] |= 0x1;
+  }
+  void push() {
+    for (std::uint8_t &Counter : Counters) {
+      bool HasLeadingZeroes = llvm::countLeadingZeros(Counter) != 0;
+      revng_assert(HasLeadingZeroes, "More than 8 pushes have been performed");
+      Counter = Counter << 1;
+    }
+  }
+  void pop() {
+    for (std::uint8_t &Counter : Counters)
+      Counter = Counter >> 1;
+  }
+  bool isSet(size_t Index) const { return Counters[Index]; }
+  void stopTracking() { IsTracking = false; }
+};
+
 } // namespace revng
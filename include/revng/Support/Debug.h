@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <sstream>
 
 #include "llvm/ADT/StringRef.h"
@@ -31,6 +32,19 @@ struct LogTerminator {
 };
 #define DoLog (LogTerminator{ __FILE__, __LINE__ })
 
+namespace revng::detail {
+
+/// Set by -audit-disabled-loggers, see Logger::operator<<
+extern bool AuditDisabledLoggers;
+
+/// Record that the log line ending at \p Site streamed \p Values values into
+/// the disabled logger \p Name
+void recordDisabledLogSite(llvm::StringRef Name,
+                           const LogTerminator &Site,
+                           unsigned Values);
+
+} // namespace revng::detail
+
 /// Logger that self-registers itself, can be disabled, has a name and follows
 /// the global indentation level
 ///
@@ -66,9 +80,18 @@ public:
   /// MyLogger << DoLog;
   void flush(const LogTerminator &LineInfo = LogTerminator{ "", 0 });
 
+  /// \note for a disabled logger this does nothing, but the arguments have
+  ///       been evaluated already: unless they're trivial, check isEnabled
+  ///       first, or use revng_log. -audit-disabled-loggers reports the call
+  ///       sites who don't.
   template<typename T>
   inline Logger &operator<<(const T &Other) {
-    writeToLog(*this, Other, static_cast<int>(0));
+    if constexpr (StaticEnabled) {
+      if (Enabled) [[unlikely]]
+        writeToLog(*this, Other, static_cast<int>(0));
+      else if (revng::detail::AuditDisabledLoggers) [[unlikely]]
+        audit(Other);
+    }
     return *this;
   }
 
@@ -87,21 +110,56 @@ public:
 private:
   void init();
 
+  template<typename T>
+  void audit(const T &Other) {
+    // Loggers are shared by all threads, and the count is only a hint for the
+    // report: there's nothing to synchronize with
+    if constexpr (std::is_same_v<T, LogTerminator>) {
+      unsigned Writes = DisabledWrites.exchange(0, std::memory_order_relaxed);
+      if (Writes != 0)
+        revng::detail::recordDisabledLogSite(Name, Other, Writes);
+    } else {
+      DisabledWrites.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
 private:
   llvm::StringRef Name;
   std::stringstream Buffer;
   bool Enabled;
+  /// Values streamed while disabled since the last DoLog, for the audit
+  std::atomic<unsigned> DisabledWrites = 0;
 };
 
+/// A logger meant for debugging only, usually on hot paths.
+///
+/// When building with REVNG_RELEASE_LOGGERS defined, these loggers are
+/// statically disabled: they can't be enabled, and all the logging code
+/// guarded by isEnabled (e.g., revng_log) is compiled away.
+#if defined(REVNG_RELEASE_LOGGERS)
+using DebugLogger = Logger<false>;
+#else
+using DebugLogger = Logger<true>;
+#endif
+
 /// Indent all loggers within the scope of this object
 template<bool StaticEnabled = true>
 class LoggerIndent {
 public:
-  LoggerIndent(Logger<StaticEnabled> &L) : L(L) { L.indent(); }
-  ~LoggerIndent() { L.unindent(); }
+  LoggerIndent(Logger<StaticEnabled> &L) : L(&L) { L.indent(); }
+
+  /// Statically disabled loggers have nothing to indent
+  LoggerIndent(Logger<false> &)
+    requires StaticEnabled
+    : L(nullptr) {}
+
+  ~LoggerIndent() {
+    if (L != nullptr)
+      L->unindent();
+  }
 
 private:
-  Logger<StaticEnabled> &L;
+  Logger<StaticEnabled> *L;
 };
 
 /// Emit a message for the specified logger upon return
@@ -112,11 +170,20 @@ private:
 template<bool StaticEnabled = true>
 class LogOnReturn {
 public:
-  LogOnReturn(Logger<StaticEnabled> &L) : L(L) {}
-  ~LogOnReturn() { L.flush(); }
+  LogOnReturn(Logger<StaticEnabled> &L) : L(&L) {}
+
+  /// Statically disabled loggers have nothing to emit
+  LogOnReturn(Logger<false> &)
+    requires StaticEnabled
+    : L(nullptr) {}
+
+  ~LogOnReturn() {
+    if (L != nullptr)
+      L->flush();
+  }
 
 private:
-  Logger<StaticEnabled> &L;
+  Logger<StaticEnabled> *L;
 };
 
 /// The catch-all function for logging, it can log any type not already handled
@@ -134,7 +201,7 @@ private:
 ///
 /// For an example see the next specialization.
 template<bool X, typename T, typename LowPrio>
-inline void writeToLog(Logger<X> &This, const T Other, LowPrio) {
+inline void writeToLog(Logger<X> &This, const T &Other, LowPrio) {
   if (This.isEnabled())
     This.Buffer << Other;
 }
@@ -176,11 +243,12 @@ private:
   bool Enabled;
 };
 
-#define revng_log(Logger, Expr)  \
-  do {                           \
-    if (Logger.isEnabled()) {    \
-      (Logger) << Expr << DoLog; \
-    }                            \
+/// Log \p Expr, evaluating it only if \p Logger is enabled
+#define revng_log(Logger, Expr)            \
+  do {                                     \
+    if (Logger.isEnabled()) [[unlikely]] { \
+      (Logger) << Expr << DoLog;           \
+    }                                      \
   } while (0)
 
 extern Logger<> NRALog;
@@ -32,12 +32,16 @@ private:
 private:
   std::vector<DynamicHierarchy *> Children;
   DynamicHierarchy *Parent;
+  /// Parents are constructed before their children, so the depth is known
+  /// right away, and it's queried too often to walk up the tree each time
+  size_t Depth;
   entry_t Start;
   entry_t End;
   std::string Name;
 
 public:
-  DynamicHierarchy(llvm::StringRef Name) : Parent(nullptr), Name(Name.str()) {
+  DynamicHierarchy(llvm::StringRef Name) :
+    Parent(nullptr), Depth(0), Name(Name.str()) {
     getRoots().push_back(&self());
     getAll().push_back(&self());
 
@@ -48,7 +52,7 @@ public:
   }
 
   DynamicHierarchy(llvm::StringRef Name, DynamicHierarchy &Parent) :
-    Parent(&Parent), Name(Name.str()) {
+    Parent(&Parent), Depth(Parent.Depth + 1), Name(Name.str()) {
     getAll().push_back(&self());
 
     // NOTE: see constructor above
@@ -149,15 +153,7 @@ public:
     return &LastAncestor->self();
   }
 
-  size_t depth() const {
-    size_t ToReturn = 0;
-    auto Current = Parent;
-    while (Current != nullptr) {
-      ToReturn++;
-      Current = Current->Parent;
-    }
-    return ToReturn;
-  }
+  size_t depth() const { return Depth; }
 
 public:
   void dump() const debug_function { dump(dbg, 0); }
@@ -10,6 +10,7 @@
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/GlobalObject.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 
 #include "revng/Support/DynamicHierarchy.h"
@@ -54,6 +55,22 @@ public:
   }
   static TagsSet from(const llvm::MDNode *MD);
 
+  /// \return true if \p Predicate holds for any of the tags of \p V
+  ///
+  /// \note unlike `from(V)`, this does not build a set.
+  template<typename CallableType>
+  static bool any(const Taggable auto *V, const CallableType &Predicate) {
+    const llvm::MDNode *MD = V->getMetadata(TagsMetadataName);
+    if (MD == nullptr)
+      return false;
+
+    for (const llvm::MDOperand &Op : MD->operands())
+      if (Predicate(fromName(llvm::cast<llvm::MDString>(Op.get()))))
+        return true;
+
+    return false;
+  }
+
 public:
   auto begin() const { return Tags.begin(); }
   auto end() const { return Tags.end(); }
@@ -76,6 +93,9 @@ public:
 
 private:
   llvm::MDNode *getMetadata(llvm::LLVMContext &C) const;
+
+  /// \return the tag named \p Name, memoizing the lookup
+  static const Tag &fromName(const llvm::MDString *Name);
 };
 
 /// Represents a tag that can be attached to a
@@ -96,11 +116,22 @@ public:
 
 public:
   bool isTagOf(const Taggable auto *I) const {
-    return TagsSet::from(I).contains(*this);
+    return TagsSet::any(I, [this](const Tag &T) { return ancestorOf(T); });
   }
 
   bool isExactTagOf(const Taggable auto *I) const {
-    return TagsSet::from(I).containsExactly(*this);
+    // Same as TagsSet::containsExactly
+    bool Found = false;
+    auto IsDescendant = [this, &Found](const Tag &T) {
+      if (&T == this) {
+        Found = true;
+        return false;
+      }
+
+      return ancestorOf(T);
+    };
+
+    return not TagsSet::any(I, IsDescendant) and Found;
   }
 
   auto functions(llvm::Module *M) const {
@@ -5,8 +5,13 @@
 //
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/raw_ostream.h"
 
+extern llvm::cl::opt<unsigned> GzipThreads;
+
+/// Compresses \p Buffer in gzip. Large buffers are split in blocks compressed
+/// in parallel as separate gzip members.
 void gzipCompress(llvm::raw_ostream &OS,
                   llvm::ArrayRef<uint8_t> Buffer,
                   int CompressionLevel = 3);
@@ -17,6 +22,20 @@ inline void gzipCompress(llvm::raw_ostream &OS, llvm::ArrayRef<char> Buffer) {
                         Buffer.size() });
 }
 
+/// Compresses \p Buffer in gzip as a single member, on the calling thread.
+/// Meant for callers which are already compressing several buffers in
+/// parallel.
+void gzipCompressSerially(llvm::raw_ostream &OS,
+                          llvm::ArrayRef<uint8_t> Buffer,
+                          int CompressionLevel = 3);
+
+inline void gzipCompressSerially(llvm::raw_ostream &OS,
+                                 llvm::ArrayRef<char> Buffer) {
+  const auto *Data = reinterpret_cast<const uint8_t *>(Buffer.data());
+  return gzipCompressSerially(OS, { Data, Buffer.size() });
+}
+
+/// Decompresses \p Buffer, which can be made of multiple gzip members
 void gzipDecompress(llvm::raw_ostream &OS, llvm::ArrayRef<uint8_t> Buffer);
 
 inline void gzipDecompress(llvm::raw_ostream &OS, llvm::ArrayRef<char> Buffer) {
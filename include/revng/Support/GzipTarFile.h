@@ -4,7 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/FunctionExtras.h"
 #include "llvm/ADT/StringSet.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
@@ -18,6 +20,20 @@ struct archive;
 
 namespace revng {
 
+/// Compression of the streams of the archives written by GzipTarWriter
+enum class TarCompression {
+  Gzip,
+  Zstd
+};
+
+} // namespace revng
+
+/// Compression of the archives stored in the project directory (as opposed to
+/// the serialized artifacts, which are always '.tar.gz')
+extern llvm::cl::opt<revng::TarCompression> StoredArchiveCompression;
+
+namespace revng {
+
 struct OffsetDescriptor {
   size_t Start;
   size_t DataStart;
@@ -52,13 +68,20 @@ struct OffsetDescriptor {
 /// Additionally, since the gzip standard allows concatenating streams, the file
 /// produced is still a valid '.tar.gz' file that can be opened by any program
 /// that supports "ordinary" '.tar.gz' files.
+///
+/// With TarCompression::Zstd, each stream is a zstd frame instead, which gives
+/// a '.tar.zst' file with the same properties (zstd frames can be concatenated
+/// too), where the OffsetDescriptors play the role of the seek table.
 class GzipTarWriter {
 private:
   llvm::raw_ostream *OS = nullptr;
   llvm::StringSet<> Filenames;
+  TarCompression Compression = TarCompression::Gzip;
 
 public:
-  GzipTarWriter(llvm::raw_ostream &OS) : OS(&OS){};
+  GzipTarWriter(llvm::raw_ostream &OS,
+                TarCompression Compression = TarCompression::Gzip) :
+    OS(&OS), Compression(Compression){};
   ~GzipTarWriter() { revng_assert(OS == nullptr); }
 
   GzipTarWriter(const GzipTarWriter &Other) = delete;
@@ -68,6 +91,16 @@ public:
   GzipTarWriter &operator=(GzipTarWriter &&Other) = default;
 
   OffsetDescriptor append(llvm::StringRef Name, llvm::ArrayRef<char> Data);
+
+  struct Input {
+    llvm::StringRef Name;
+    llvm::ArrayRef<char> Data;
+  };
+
+  /// Appends all of \p Inputs, in order, compressing them in parallel
+  /// (`-gzip-threads` threads). Equivalent to appending each of them.
+  std::vector<OffsetDescriptor> append(llvm::ArrayRef<Input> Inputs);
+
   void close();
 };
 
@@ -76,14 +109,30 @@ struct ArchiveEntry {
   llvm::SmallVector<char> Data;
 };
 
+/// Reads archives produced by GzipTarWriter, with either compression.
+///
+/// The archive can either be provided as a whole or chunk by chunk, in which
+/// case entries are produced as soon as the chunks holding them are available.
 class GzipTarReader {
+public:
+  /// \return the next chunk of the archive, which must stay valid until the
+  ///         next invocation, or an empty chunk once the archive is over
+  using ChunkReader = llvm::unique_function<
+    llvm::Expected<llvm::ArrayRef<char>>()>;
+
 private:
+  struct ReaderState;
+
   archive *Archive = nullptr;
+  /// The chunk reader, if any, and the error stopping the reading. Heap
+  /// allocated since libarchive keeps a pointer to it.
+  std::unique_ptr<ReaderState> State;
 
 public:
   GzipTarReader(llvm::ArrayRef<char> Ref);
   GzipTarReader(const llvm::MemoryBuffer &Buffer) :
     GzipTarReader({ Buffer.getBufferStart(), Buffer.getBufferSize() }){};
+  GzipTarReader(ChunkReader Reader);
   ~GzipTarReader();
 
   GzipTarReader(const GzipTarReader &Other) = delete;
@@ -92,7 +141,12 @@ public:
   GzipTarReader(GzipTarReader &&Other) = default;
   GzipTarReader &operator=(GzipTarReader &&Other) = default;
 
+  /// \note failures (of the ChunkReader, of libarchive or due to a malformed
+  ///       archive) end the sequence early, check takeError afterwards
   cppcoro::generator<ArchiveEntry> entries();
+
+  /// \return the error that stopped entries() early, if any
+  llvm::Error takeError();
 };
 
 } // namespace revng
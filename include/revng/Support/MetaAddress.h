@@ -4,6 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <compare>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/DenseMapInfo.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Triple.h"
 
@@ -424,6 +428,7 @@ inline constexpr llvm::StringRef getLLVMCPUFeatures(Values Type) {
 class MetaAddress : private PlainMetaAddress {
 private:
   friend class ProgramCounterHandler;
+  friend struct llvm::DenseMapInfo<MetaAddress>;
 
 public:
   constexpr static llvm::StringRef Separator = ":";
@@ -580,28 +585,36 @@ public:
 public:
   /// @{
   constexpr bool operator==(const MetaAddress &Other) const {
-    return tie() == Other.tie();
+    return packed() == Other.packed();
   }
 
-  constexpr bool operator!=(const MetaAddress &Other) const {
-    return not(*this == Other);
-  }
-
-  constexpr bool operator<(const MetaAddress &Other) const {
-    return tie() < Other.tie();
-  }
-  constexpr bool operator<=(const MetaAddress &Other) const {
-    return tie() <= Other.tie();
-  }
-  constexpr bool operator>(const MetaAddress &Other) const {
-    return tie() > Other.tie();
-  }
-  constexpr bool operator>=(const MetaAddress &Other) const {
-    return tie() >= Other.tie();
+  constexpr std::strong_ordering operator<=>(const MetaAddress &Other) const {
+    return packed() <=> Other.packed();
   }
 
   /// @}
 
+  /// \return a 128-bit integer ordered as this MetaAddress: epoch, address
+  ///         space and type in the most significant half, followed by the
+  ///         address
+  constexpr unsigned __int128 packed() const {
+    uint64_t High = (static_cast<uint64_t>(Epoch) << 32)
+                    | (static_cast<uint64_t>(AddressSpace) << 16) | Type;
+    return (static_cast<unsigned __int128>(High) << 64) | Address;
+  }
+
+  /// \return a hash of all the components of this MetaAddress
+  constexpr uint64_t hash() const {
+    // The finalizer of splitmix64
+    auto Mix = [](uint64_t Value) {
+      Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebULL;
+      return Value ^ (Value >> 31);
+    };
+
+    return Mix(Address ^ Mix(static_cast<uint64_t>(packed() >> 64)));
+  }
+
   /// \name Address comparisons
   ///
   /// Comparison operators ignoring the MetaAddress type
@@ -940,15 +953,6 @@ public:
   ///        to deserialize it! So only use if you know what you're doing.
   std::string toString(std::optional<llvm::Triple::ArchType> Arch = {}) const;
   static MetaAddress fromString(llvm::StringRef Text);
-
-private:
-  using Tied = std::tuple<const uint32_t &,
-                          const uint16_t &,
-                          const uint16_t &,
-                          const uint64_t &>;
-  constexpr Tied tie() const {
-    return std::tie(Epoch, AddressSpace, Type, Address);
-  }
 };
 
 static_assert(sizeof(MetaAddress) <= 128 / 8,
@@ -973,10 +977,37 @@ template<>
 class hash<MetaAddress> {
 public:
   uint64_t operator()(const MetaAddress &Address) const {
-    return hash_combine(Address.arch(),
-                        Address.address(),
-                        Address.epoch(),
-                        Address.addressSpace());
+    return Address.hash();
   }
 };
 } // namespace std
+
+template<>
+struct llvm::DenseMapInfo<MetaAddress> {
+  // Types that no valid or invalid MetaAddress can have
+  static MetaAddress getEmptyKey() { return withType(0xFFFF); }
+  static MetaAddress getTombstoneKey() { return withType(0xFFFE); }
+
+  static unsigned getHashValue(const MetaAddress &Address) {
+    return Address.hash();
+  }
+
+  static bool isEqual(const MetaAddress &LHS, const MetaAddress &RHS) {
+    return LHS == RHS;
+  }
+
+private:
+  static MetaAddress withType(uint16_t Type) {
+    MetaAddress Result;
+    Result.Type = Type;
+    return Result;
+  }
+};
+
+/// An open addressing hash table keyed by MetaAddress
+///
+/// \note unlike `std::unordered_map`, inserting elements invalidates the
+///       references to the others. Prefer `std::map` where the order of
+///       iteration is observable.
+template<typename T>
+using MetaAddressMap = llvm::DenseMap<MetaAddress, T>;
@@ -0,0 +1,105 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Statistics.h"
+
+namespace revng {
+
+/// A set of metrics with the same name, one for each value of a label, which
+/// can be exported in the OpenMetrics text format.
+///
+/// Instances register themselves for `writeOpenMetrics` on construction, and
+/// are meant to be global variables. They can be updated from multiple
+/// threads: each thread updates its own shard, the shards are combined when
+/// the metrics are exported.
+class MetricFamily {
+protected:
+  std::string Name;
+  std::string Help;
+  std::string Label;
+
+public:
+  MetricFamily(llvm::StringRef Name,
+               llvm::StringRef Help,
+               llvm::StringRef Label);
+  virtual ~MetricFamily();
+  MetricFamily(const MetricFamily &) = delete;
+  MetricFamily &operator=(const MetricFamily &) = delete;
+
+public:
+  virtual void writeOpenMetrics(llvm::raw_ostream &OS) = 0;
+
+protected:
+  void writeHeader(llvm::raw_ostream &OS, llvm::StringRef Type) const;
+  void writeLabel(llvm::raw_ostream &OS, llvm::StringRef Value) const;
+};
+
+/// Monotonic counters, exported as `<Name>_total`
+class CounterFamily : public MetricFamily {
+private:
+  using Container = std::map<std::string, uint64_t, std::less<>>;
+  detail::ThreadShards<Container> Shards;
+
+public:
+  using MetricFamily::MetricFamily;
+
+public:
+  void increment(llvm::StringRef LabelValue, uint64_t Value = 1);
+
+  /// \return the counters of all the threads, added up
+  std::map<std::string, uint64_t> aggregate();
+
+  void writeOpenMetrics(llvm::raw_ostream &OS) override;
+};
+
+/// Histograms of durations, in seconds, with a fixed set of buckets ranging
+/// from one millisecond to one minute
+class LatencyHistogramFamily : public MetricFamily {
+public:
+  static constexpr std::array<double, 14> Bounds = {
+    0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1,
+    0.25,  0.5,    1,     2.5,  5,     10,   60
+  };
+
+  struct Histogram {
+    /// How many durations fall in each bucket, the last one being unbounded.
+    /// They are not cumulative, unlike the exported ones.
+    std::array<uint64_t, Bounds.size() + 1> Buckets = {};
+    uint64_t Count = 0;
+    double Sum = 0;
+
+    void merge(const Histogram &Other);
+  };
+
+private:
+  using Container = std::map<std::string, Histogram, std::less<>>;
+  detail::ThreadShards<Container> Shards;
+
+public:
+  using MetricFamily::MetricFamily;
+
+public:
+  void record(llvm::StringRef LabelValue, double Seconds);
+
+  /// \return the histograms of all the threads, merged
+  std::map<std::string, Histogram> aggregate();
+
+  void writeOpenMetrics(llvm::raw_ostream &OS) override;
+};
+
+/// Write all the metric families of the process in the OpenMetrics text
+/// format, which Prometheus can scrape too
+void writeOpenMetrics(llvm::raw_ostream &OS);
+
+} // namespace revng
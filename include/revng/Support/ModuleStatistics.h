@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <string>
@@ -64,6 +65,28 @@ public:
       OldS = NewS;
     }
   }
+
+  /// Undo the push of \p OldElement, which must have been pushed before
+  void pop(unsigned OldElement) {
+    revng_assert(ElementsCount > 0 and Sum >= OldElement);
+    --ElementsCount;
+    Sum -= OldElement;
+
+    if (ElementsCount == 0) {
+      OldM = NewM = 0.0;
+      OldS = NewS = 0.0;
+      return;
+    }
+
+    // Invert the update performed by push
+    double PreviousM = NewM - (OldElement - NewM) / ElementsCount;
+    NewS -= (OldElement - PreviousM) * (OldElement - NewM);
+    NewS = std::max(NewS, 0.0);
+    NewM = PreviousM;
+
+    OldM = NewM;
+    OldS = NewS;
+  }
 };
 
 class FunctionClass {
@@ -78,17 +101,35 @@ public:
       ++DeclarationsCount;
     } else {
       ++DefinitionsCount;
+      InstructionsStatistics.push(size(F));
+    }
+  }
 
-      unsigned Size = 0;
-      for (const llvm::BasicBlock &BB : F)
-        Size += BB.size();
-      InstructionsStatistics.push(Size);
+  /// Undo process(\p F), \p F must not have changed in the meantime
+  void remove(const llvm::Function &F) {
+    if (F.isDeclaration()) {
+      revng_assert(DeclarationsCount > 0);
+      --DeclarationsCount;
+    } else {
+      revng_assert(DefinitionsCount > 0);
+      --DefinitionsCount;
+      InstructionsStatistics.pop(size(F));
     }
   }
 
+  bool empty() const { return DeclarationsCount + DefinitionsCount == 0; }
+
   void dump(llvm::raw_ostream &Output,
             unsigned Indent,
             const FunctionClass *Old = nullptr) const;
+
+private:
+  static unsigned size(const llvm::Function &F) {
+    unsigned Size = 0;
+    for (const llvm::BasicBlock &BB : F)
+      Size += BB.size();
+    return Size;
+  }
 };
 
 class ModuleStatistics {
@@ -115,9 +156,46 @@ private:
   unsigned DebugGloblaVariablesCount = 0;
   unsigned DebugTypesCount = 0;
 
+  unsigned BasicBlocksCount = 0;
+  unsigned ArgumentsCount = 0;
+  unsigned OperandsCount = 0;
+
 public:
   static ModuleStatistics analyze(const llvm::Module &M);
 
+  /// Account for \p F, as if it had been part of the analyzed module.
+  ///
+  /// Together with removeFunction, this enables keeping the statistics of a
+  /// module up to date while its functions change, without analyzing it again
+  /// as a whole.
+  ///
+  /// \note globals, types and debug information are not updated, they are
+  ///       measured by analyze only.
+  void addFunction(const llvm::Function &F);
+
+  /// Undo addFunction(\p F), \p F must not have changed in the meantime
+  void removeFunction(const llvm::Function &F);
+
+public:
+  unsigned globalsCount() const {
+    return NamedGlobalsCount + AnonymousGlobalsCount;
+  }
+
+  unsigned functionsCount() const {
+    return AllFunctions.DeclarationsCount + AllFunctions.DefinitionsCount;
+  }
+
+  unsigned argumentsCount() const { return ArgumentsCount; }
+  unsigned basicBlocksCount() const { return BasicBlocksCount; }
+
+  unsigned instructionsCount() const {
+    return AllFunctions.InstructionsStatistics.sum();
+  }
+
+  unsigned operandsCount() const { return OperandsCount; }
+
+  unsigned namedMetadataCount() const { return NamedMetadataCount; }
+
   void dump() const debug_function {
     std::string Result;
     {
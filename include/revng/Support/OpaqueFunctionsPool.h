@@ -4,8 +4,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
 
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/IR/Attributes.h"
 #include "llvm/IR/DerivedTypes.h"
@@ -22,12 +27,44 @@ template<typename T>
 concept PointerToLLVMTypeOrDerived = std::derived_from<std::remove_pointer_t<T>,
                                                        llvm::Type>;
 
+namespace revng::detail {
+
+template<typename KeyT>
+struct OpaqueFunctionsPoolTraits {
+  using Map = llvm::DenseMap<KeyT, llvm::Function *>;
+  using LookupKey = KeyT;
+};
+
+/// Strings are looked up as StringRefs, the pool owns a copy of them
+template<typename KeyT>
+  requires std::is_same_v<KeyT, std::string>
+           or std::is_same_v<KeyT, llvm::StringRef>
+struct OpaqueFunctionsPoolTraits<KeyT> {
+  using Map = llvm::StringMap<llvm::Function *>;
+  using LookupKey = llvm::StringRef;
+};
+
+} // namespace revng::detail
+
+/// A set of opaque functions, uniqued by a key.
+///
+/// Keys are hashed: pointers (e.g., types) in a DenseMap, strings in a
+/// StringMap, which can be queried with a StringRef without building a
+/// std::string.
+///
+/// Lookups are thread-safe, and so is the creation of new functions, as long as
+/// nobody else is adding functions to the module at the same time.
 template<typename KeyT>
 class OpaqueFunctionsPool {
+private:
+  using Traits = revng::detail::OpaqueFunctionsPoolTraits<KeyT>;
+  using LookupKey = typename Traits::LookupKey;
+
 private:
   llvm::Module *M;
   const bool PurgeOnDestruction;
-  std::map<KeyT, llvm::Function *> Pool;
+  mutable std::shared_mutex Mutex;
+  typename Traits::Map Pool;
   llvm::AttributeList AttributeSets;
   llvm::MemoryEffects MemoryEffects = llvm::MemoryEffects::none();
   FunctionTags::TagsSet Tags;
@@ -38,7 +75,8 @@ public:
 
   ~OpaqueFunctionsPool() {
     if (PurgeOnDestruction) {
-      for (auto &[Key, F] : Pool) {
+      for (auto &Entry : Pool) {
+        llvm::Function *F = Entry.second;
         revng_assert(F->use_begin() == F->use_end());
         eraseFromParent(F);
       }
@@ -57,34 +95,46 @@ public:
 
   void setTags(const FunctionTags::TagsSet &Tags) { this->Tags = Tags; }
 
+  /// Make room for \p Size functions, to avoid growing the pool repeatedly
+  /// when many of them are about to be created.
+  ///
+  /// \note this is a hint, not all the maps support it
+  void reserve(size_t Size) {
+    std::unique_lock Lock(Mutex);
+    if constexpr (requires { Pool.reserve(Size); })
+      Pool.reserve(Size);
+  }
+
 public:
+  /// \note the order of the iteration is not deterministic
   auto begin() const { return Pool.begin(); }
   auto end() const { return Pool.end(); }
 
 public:
-  void record(KeyT Key, llvm::Function *F) {
-    auto It = Pool.find(Key);
-    if (It == Pool.end())
-      Pool[Key] = F;
-    else
-      revng_assert(It->second == F);
+  void record(LookupKey Key, llvm::Function *F) {
+    std::unique_lock Lock(Mutex);
+    recordImpl(Key, F);
   }
 
 public:
   llvm::Function *
-  get(KeyT Key, llvm::FunctionType *FT, const llvm::Twine &Name = {}) {
+  get(LookupKey Key, llvm::FunctionType *FT, const llvm::Twine &Name = {}) {
     using namespace llvm;
 
-    Function *F = nullptr;
-    auto It = Pool.find(Key);
-    if (It != Pool.end()) {
+    Function *F = find(Key);
+    if (F == nullptr) {
+      std::unique_lock Lock(Mutex);
+
+      // Somebody might have created it in the meantime
+      auto [It, New] = Pool.try_emplace(Key, nullptr);
+      if (New) {
+        auto Linkage = GlobalValue::ExternalLinkage;
+        It->second = Function::Create(FT, Linkage, Name, M);
+        It->second->setAttributes(AttributeSets);
+        It->second->setMemoryEffects(MemoryEffects);
+        Tags.set(It->second);
+      }
       F = It->second;
-    } else {
-      F = Function::Create(FT, GlobalValue::ExternalLinkage, Name, M);
-      F->setAttributes(AttributeSets);
-      F->setMemoryEffects(MemoryEffects);
-      Tags.set(F);
-      Pool.insert(It, { Key, F });
     }
 
     // Ensure the function we're returning is as expected
@@ -93,28 +143,58 @@ public:
     return F;
   }
 
-  llvm::Function *get(KeyT Key,
+  llvm::Function *get(LookupKey Key,
                       llvm::Type *ReturnType = nullptr,
                       llvm::ArrayRef<llvm::Type *> Arguments = {},
                       const llvm::Twine &Name = {}) {
     using namespace llvm;
+
+    // Avoid building the function type if the function exists already
+    if (Function *F = find(Key)) {
+      if (ReturnType == nullptr)
+        ReturnType = Type::getVoidTy(M->getContext());
+      revng_assert(F->getReturnType() == ReturnType
+                   and F->getFunctionType()->params() == Arguments
+                   and not F->isVarArg());
+      return F;
+    }
+
     if (ReturnType == nullptr)
       ReturnType = Type::getVoidTy(M->getContext());
 
     return get(Key, FunctionType::get(ReturnType, Arguments, false), Name);
   }
 
+  /// \return the function associated to \p Key, or nullptr if there's none
+  llvm::Function *find(LookupKey Key) const {
+    std::shared_lock Lock(Mutex);
+    auto It = Pool.find(Key);
+    return It == Pool.end() ? nullptr : It->second;
+  }
+
+  /// Initialize the pool with all the functions in M that match the tag
+  /// TheTag, using the key returned by \p KeyOf, if any
+  template<typename CallableType>
+  void initializeFrom(const FunctionTags::Tag &TheTag,
+                      const CallableType &KeyOf) {
+    std::unique_lock Lock(Mutex);
+    for (llvm::Function &F : TheTag.functions(M))
+      if (auto Key = KeyOf(F))
+        recordImpl(*Key, &F);
+  }
+
   /// Initialize the pool with all the functions in M that match the tag TheTag,
   /// using the return type as key.
   void initializeFromReturnType(const FunctionTags::Tag &TheTag)
     requires std::derived_from<std::remove_pointer_t<KeyT>, llvm::Type>
   {
     using TypeLike = std::remove_pointer_t<KeyT>;
-    for (llvm::Function &F : TheTag.functions(M)) {
+    initializeFrom(TheTag, [](llvm::Function &F) -> std::optional<KeyT> {
       auto *RetType = F.getFunctionType()->getReturnType();
       if (auto *KeyType = dyn_cast<TypeLike>(RetType))
-        record(KeyType, &F);
-    }
+        return KeyType;
+      return std::nullopt;
+    });
   }
 
   /// Initialize the pool with all the functions in M that match the tag TheTag,
@@ -123,19 +203,28 @@ public:
     requires std::derived_from<std::remove_pointer_t<KeyT>, llvm::Type>
   {
     using TypeLike = std::remove_pointer_t<KeyT>;
-    for (llvm::Function &F : TheTag.functions(M)) {
+    auto KeyOf = [ArgNo](llvm::Function &F) -> std::optional<KeyT> {
       auto ArgType = F.getFunctionType()->getParamType(ArgNo);
       if (auto *KeyType = dyn_cast<TypeLike>(ArgType))
-        record(KeyType, &F);
-    }
+        return KeyType;
+      return std::nullopt;
+    };
+    initializeFrom(TheTag, KeyOf);
   }
 
   /// Initialize the pool with all the functions in M that match the tag TheTag,
-  /// using the type of the ArgNo-th argument as key.
+  /// using their name as key.
   void initializeFromName(const FunctionTags::Tag &TheTag)
     requires std::is_same_v<KeyT, std::string>
   {
-    for (llvm::Function &F : TheTag.functions(M))
-      record(F.getName().str(), &F);
+    initializeFrom(TheTag, [](llvm::Function &F) {
+      return std::optional<llvm::StringRef>(F.getName());
+    });
+  }
+
+private:
+  void recordImpl(LookupKey Key, llvm::Function *F) {
+    auto [It, New] = Pool.try_emplace(Key, F);
+    revng_assert(New or It->second == F);
   }
 };
@@ -224,6 +224,16 @@ public:
                            const DispatcherTarget &NewTarget,
                            std::optional<BlockType::Values> SetBlockType) const;
 
+  /// Turn the dispatcher rooted in \p Root into one handling exactly \p
+  /// Targets, dropping the cases not in \p Targets and adding the missing ones.
+  ///
+  /// Unlike destroying and building again the dispatcher, the cost of this is
+  /// proportional to the number of cases in the dispatcher plus the number of
+  /// cases that change.
+  void updateDispatcher(llvm::SwitchInst *Root,
+                        const DispatcherTargets &Targets,
+                        std::optional<BlockType::Values> SetBlockType) const;
+
   void destroyDispatcher(llvm::SwitchInst *Root) const;
 
   void buildHotPath(llvm::IRBuilderBase &Builder,
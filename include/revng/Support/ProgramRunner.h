@@ -4,13 +4,65 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <deque>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/ADT/StringRef.h"
 
 class ProgramRunner {
+public:
+  /// The outcome of a program started with `start`
+  struct Result {
+    /// As in `llvm::sys::ExecuteAndWait`: -1 if the program could not be
+    /// started, -2 if it has been killed by a signal
+    int ExitCode = -1;
+    std::string StdOut;
+    std::string StdErr;
+  };
+
+  /// A program running in the background, see `start`.
+  ///
+  /// The standard output and the standard error of the program are collected
+  /// in memory. If nobody waits for the program, the destructor does.
+  class Process {
+  private:
+    friend class ProgramRunner;
+    friend class ProgramQueue;
+
+  private:
+    int PID = -1;
+    int StdOut = -1;
+    int StdErr = -1;
+    Result TheResult;
+
+  public:
+    Process() = default;
+    Process(Process &&Other) { *this = std::move(Other); }
+    Process &operator=(Process &&Other);
+    Process(const Process &) = delete;
+    Process &operator=(const Process &) = delete;
+    ~Process();
+
+  public:
+    /// \return true if nobody waited for the program yet
+    bool running() const { return PID != -1; }
+
+    /// Wait for the program to exit, collecting all of its output
+    Result wait();
+
+  private:
+    bool outputClosed() const { return StdOut == -1 and StdErr == -1; }
+    void reap();
+
+    /// Read what is available from the output of \p Processes, blocking
+    /// until at least one of them produced something
+    static void readOutput(llvm::ArrayRef<Process *> Processes);
+  };
+
 private:
   llvm::SmallVector<std::string, 64> Paths;
 
@@ -23,6 +75,49 @@ public:
   /// returns the exit code of the program.
   [[nodiscard]] int run(llvm::StringRef ProgramName,
                         llvm::ArrayRef<std::string> Args);
+
+  /// Start the program without waiting for it to exit
+  [[nodiscard]] Process start(llvm::StringRef ProgramName,
+                              llvm::ArrayRef<std::string> Args);
+
+private:
+  std::string findProgram(llvm::StringRef ProgramName) const;
 };
 
 extern ProgramRunner Runner;
+
+/// Runs programs in the background, at most MaxJobs at a time.
+///
+/// Programs are started in the order they have been enqueued, as soon as the
+/// previous ones exit. The output of all the running programs is read as it
+/// is produced, so that none of them is blocked on a full pipe.
+class ProgramQueue {
+private:
+  struct Job {
+    size_t Index = 0;
+    std::string ProgramName;
+    std::vector<std::string> Args;
+  };
+
+private:
+  ProgramRunner &TheRunner;
+  unsigned MaxJobs = 1;
+  std::deque<Job> Pending;
+  std::vector<std::pair<size_t, ProgramRunner::Process>> Running;
+  std::vector<ProgramRunner::Result> Results;
+
+public:
+  ProgramQueue(unsigned MaxJobs, ProgramRunner &TheRunner = ::Runner);
+  ~ProgramQueue() { waitAll(); }
+
+public:
+  /// \return the index of the result of the program in the vector returned by
+  ///         `waitAll`
+  size_t enqueue(llvm::StringRef ProgramName, llvm::ArrayRef<std::string> Args);
+
+  /// Run all the enqueued programs, and wait for them to exit
+  std::vector<ProgramRunner::Result> waitAll();
+
+private:
+  void startPending();
+};
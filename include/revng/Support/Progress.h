@@ -0,0 +1,76 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <functional>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+struct TaskStack;
+} // namespace llvm
+
+namespace revng {
+
+/// \return true if a trace of the `llvm::Task`s is being recorded (`-trace`)
+bool isTracingTasks();
+
+/// Attach a numeric argument to the span of the trace that will be closed next
+/// on this thread, that is the current step of the innermost `llvm::Task`, or
+/// the task itself if it has no steps.
+///
+/// Does nothing if no trace is being recorded.
+void addTraceArgument(llvm::StringRef Name, uint64_t Value);
+
+/// \return the peak resident set size of the process so far, in kilobytes
+uint64_t getPeakRSSKB();
+
+/// Attaches to the trace span enclosing its lifetime how much the peak resident
+/// set size of the process has grown in the meantime
+class TracePeakRSSDelta {
+private:
+  uint64_t Initial = 0;
+
+public:
+  TracePeakRSSDelta() {
+    if (isTracingTasks())
+      Initial = getPeakRSSKB();
+  }
+
+  ~TracePeakRSSDelta() {
+    if (isTracingTasks())
+      addTraceArgument("peak-rss-delta-kb", getPeakRSSKB() - Initial);
+  }
+
+  TracePeakRSSDelta(const TracePeakRSSDelta &) = delete;
+  TracePeakRSSDelta &operator=(const TracePeakRSSDelta &) = delete;
+};
+
+/// For the duration of its lifetime, invokes a callback with the stack of the
+/// `llvm::Task`s of the current thread each time a task is started, advanced
+/// or completed on this thread. Scopes can be nested, only the innermost one
+/// is notified.
+class ProgressCallbackScope {
+public:
+  using Callback = std::function<void(const llvm::TaskStack &)>;
+
+private:
+  Callback TheCallback;
+  ProgressCallbackScope *Previous = nullptr;
+
+public:
+  explicit ProgressCallbackScope(Callback TheCallback);
+  ~ProgressCallbackScope();
+
+  ProgressCallbackScope(const ProgressCallbackScope &) = delete;
+  ProgressCallbackScope &operator=(const ProgressCallbackScope &) = delete;
+
+public:
+  /// Notifies the innermost scope of the current thread, if any
+  static void notify(const llvm::TaskStack &Stack);
+};
+
+} // namespace revng
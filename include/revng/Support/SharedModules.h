@@ -0,0 +1,38 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+
+#include "llvm/ADT/StringRef.h"
+
+namespace llvm {
+class LLVMContext;
+class Module;
+class SMDiagnostic;
+} // namespace llvm
+
+namespace revng {
+
+/// Parse the IR file at \p Path, which is expected to be one of the modules
+/// revng ships and never changes (e.g., the helpers or the support module),
+/// in \p Context.
+///
+/// The file is read and parsed once per process, no matter how many projects
+/// the process serves. Modules can't be shared across LLVMContexts, so what's
+/// kept around is the module in bitcode form, which is then parsed in each
+/// requesting context, much faster than parsing textual IR again. The file is
+/// read again if its size or modification time change.
+///
+/// \return the module or, on failure, nullptr and the error in \p Error, like
+///         `llvm::parseIRFile`.
+std::unique_ptr<llvm::Module> parseSharedIRFile(llvm::StringRef Path,
+                                                llvm::SMDiagnostic &Error,
+                                                llvm::LLVMContext &Context);
+
+/// Drop all the modules parsed by `parseSharedIRFile`
+void clearSharedIRFiles();
+
+} // namespace revng
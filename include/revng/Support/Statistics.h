@@ -4,10 +4,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <deque>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/CommandLine.h"
 
 #include "revng/Support/Debug.h"
@@ -29,11 +35,82 @@ inline size_t digitsCount(T Value) {
   return Digits;
 }
 
+namespace revng::detail {
+
+/// A set of per-thread instances of ShardType, owned by a single object.
+///
+/// Each thread updates its own instance, so that updates from different
+/// threads never contend. Readers visit all the instances, which they are
+/// expected to aggregate.
+template<typename ShardType>
+class ThreadShards {
+private:
+  struct Shard {
+    /// Only ever contended by readers
+    std::mutex Mutex;
+    ShardType Value;
+  };
+
+private:
+  /// Unique across all the instances, so that a new object allocated at the
+  /// address of a destroyed one does not find its shards
+  uint64_t ID = NextID++;
+  std::mutex Mutex;
+  /// A deque, so that the shards never move
+  std::deque<Shard> Shards;
+  static inline std::atomic<uint64_t> NextID = 0;
+
+public:
+  ThreadShards() = default;
+  ThreadShards(const ThreadShards &) = delete;
+  ThreadShards &operator=(const ThreadShards &) = delete;
+
+public:
+  /// Invoke \p Update on the instance of the current thread
+  template<typename CallableType>
+  void update(const CallableType &Update) {
+    Shard &Local = local();
+    std::lock_guard Lock(Local.Mutex);
+    Update(Local.Value);
+  }
+
+  /// Invoke \p Visitor on the instance of each thread
+  template<typename CallableType>
+  void forEach(const CallableType &Visitor) {
+    std::lock_guard Lock(Mutex);
+    for (Shard &S : Shards) {
+      std::lock_guard ShardLock(S.Mutex);
+      Visitor(S.Value);
+    }
+  }
+
+private:
+  Shard &local() {
+    thread_local llvm::DenseMap<uint64_t, Shard *> Local;
+    Shard *&Result = Local[ID];
+    if (Result == nullptr) {
+      std::lock_guard Lock(Mutex);
+      Result = &Shards.emplace_back();
+    }
+    return *Result;
+  }
+};
+
+} // namespace revng::detail
+
+/// Count the occurrences of a set of events (or add up a value for each of
+/// them).
+///
+/// It is safe to push from multiple threads: each thread counts in its own
+/// shard, the shards are added up when the results are read. Keys can be
+/// pushed as anything comparable with K (e.g., string literals or
+/// `llvm::StringRef` when K is `std::string`): a new K is only built the first
+/// time a thread sees a key.
 template<typename K, typename T = uint64_t>
 class CounterMap {
 private:
-  using Container = std::map<K, T>;
-  Container Map;
+  using Container = std::map<K, T, std::less<>>;
+  revng::detail::ThreadShards<Container> Shards;
   std::string Name;
 
 public:
@@ -44,16 +121,46 @@ public:
     });
   }
 
-  void push(K Key) { Map[Key]++; }
-  void push(K Key, T Value) { Map[Key] += Value; }
-  void clear(K Key) { Map.erase(Key); }
-  void clear() { Map.clear(); }
+  template<typename KeyType>
+  void push(const KeyType &Key, T Value = T(1)) {
+    Shards.update([&Key, &Value](Container &Map) {
+      auto It = Map.find(Key);
+      if (It == Map.end())
+        Map.emplace(K(Key), Value);
+      else
+        It->second += Value;
+    });
+  }
+
+  template<typename KeyType>
+  void clear(const KeyType &Key) {
+    Shards.forEach([&Key](Container &Map) {
+      auto It = Map.find(Key);
+      if (It != Map.end())
+        Map.erase(It);
+    });
+  }
+
+  void clear() {
+    Shards.forEach([](Container &Map) { Map.clear(); });
+  }
+
+  /// \return the counters of all the threads, added up
+  std::map<K, T> aggregate() {
+    std::map<K, T> Result;
+    Shards.forEach([&Result](const Container &Map) {
+      for (const auto &[Key, Value] : Map)
+        Result[Key] += Value;
+    });
+    return Result;
+  }
 
   template<typename O>
   void dump(size_t Max, O &Output) {
     if (not Name.empty())
       Output << Name << ":\n";
 
+    std::map<K, T> Map = aggregate();
     using Pair = std::pair<K, T>;
     std::vector<Pair> Sorted;
     Sorted.reserve(Map.size());
@@ -91,17 +198,48 @@ public:
 /// you want to record, when you're done use the various methods to obtain mean
 /// and variance.
 ///
+/// It is safe to push from multiple threads: each thread records in its own
+/// shard, the shards are combined when the results are read.
+///
 /// If a name is provided, the results will be registered for printing at
 /// program termination.
 class RunningStatistics {
+private:
+  /// Count, mean, sum of the squared differences from the mean and sum of a
+  /// set of values
+  struct Moments {
+    uint64_t N = 0;
+    double Mean = 0.0;
+    double M2 = 0.0;
+    double Sum = 0.0;
+
+    // See Knuth TAOCP vol 2, 3rd edition, page 232
+    void push(double X) {
+      ++N;
+      Sum += X;
+      double Delta = X - Mean;
+      Mean += Delta / N;
+      M2 += Delta * (X - Mean);
+    }
+
+    // See Chan, Golub, LeVeque, "Updating formulae and a pairwise algorithm
+    // for computing sample variances"
+    void merge(const Moments &Other) {
+      if (Other.N == 0)
+        return;
+
+      uint64_t Total = N + Other.N;
+      double Delta = Other.Mean - Mean;
+      Mean += Delta * Other.N / Total;
+      M2 += Other.M2 + Delta * Delta * N * Other.N / Total;
+      Sum += Other.Sum;
+      N = Total;
+    }
+  };
+
 private:
   std::string Name;
-  int N = 0;
-  double OldM = 0.0;
-  double NewM = 0.0;
-  double OldS = 0.0;
-  double NewS = 0.0;
-  double Sum = 0.0;
+  mutable revng::detail::ThreadShards<Moments> Shards;
 
 public:
   RunningStatistics() = default;
@@ -113,47 +251,47 @@ public:
     });
   }
 
-  void clear() { N = 0; }
+  void clear() {
+    Shards.forEach([](Moments &M) { M = Moments(); });
+  }
 
   // TODO: make a template
   /// Record a new value
   void push(double X) {
-    N++;
-    Sum += X;
-
-    // See Knuth TAOCP vol 2, 3rd edition, page 232
-    if (N == 1) {
-      OldM = NewM = X;
-      OldS = 0.0;
-    } else {
-      NewM = OldM + (X - OldM) / N;
-      NewS = OldS + (X - OldM) * (X - NewM);
-
-      // Set up for next iteration
-      OldM = NewM;
-      OldS = NewS;
-    }
+    Shards.update([X](Moments &M) { M.push(X); });
   }
 
   /// \return the total number of recorded values.
-  int size() const { return N; }
+  int size() const { return aggregate().N; }
 
-  double mean() const { return (N > 0) ? NewM : 0.0; }
+  double mean() const { return aggregate().Mean; }
 
-  double variance() const { return ((N > 1) ? NewS / (N - 1) : 0.0); }
+  double variance() const {
+    Moments All = aggregate();
+    return ((All.N > 1) ? All.M2 / (All.N - 1) : 0.0);
+  }
 
   double standardDeviation() const { return sqrt(variance()); }
 
-  double sum() const { return Sum; }
+  double sum() const { return aggregate().Sum; }
 
   template<typename T>
   void dump(T &Output) {
+    Moments All = aggregate();
+    double Variance = (All.N > 1) ? All.M2 / (All.N - 1) : 0.0;
     Output << Name << ": "
-           << "{ s: " << sum() << " "
-           << "n: " << size() << " "
-           << "u: " << mean() << " "
-           << "o: " << variance() << " }\n";
+           << "{ s: " << All.Sum << " "
+           << "n: " << All.N << " "
+           << "u: " << All.Mean << " "
+           << "o: " << Variance << " }\n";
   }
 
   void dump() { dump(dbg); }
+
+private:
+  Moments aggregate() const {
+    Moments Result;
+    Shards.forEach([&Result](const Moments &M) { Result.merge(M); });
+    return Result;
+  }
 };
@@ -0,0 +1,55 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace llvm {
+class DataLayout;
+class IntegerType;
+class Type;
+} // namespace llvm
+
+/// \return the integer type containing the byte at \p Offset in an object of
+///         type \p VarType and the offset of the byte within it, or
+///         `{ nullptr, 0 }` if the byte is padding or part of a pointer
+std::pair<llvm::IntegerType *, unsigned>
+getTypeAtOffset(const llvm::DataLayout *TheLayout,
+                llvm::Type *VarType,
+                intptr_t Offset);
+
+/// Memoizes `getTypeAtOffset` for each byte of an object of a given type, so
+/// that repeated queries on the same offsets are an array access
+class TypeAtOffsetCache {
+private:
+  struct Entry {
+    llvm::IntegerType *Type = nullptr;
+    unsigned Remaining = 0;
+    bool Computed = false;
+  };
+
+private:
+  const llvm::DataLayout *Layout = nullptr;
+  llvm::Type *Root = nullptr;
+  std::vector<Entry> Entries;
+
+public:
+  TypeAtOffsetCache(const llvm::DataLayout *Layout, llvm::Type *Root);
+
+public:
+  size_t size() const { return Entries.size(); }
+
+  bool contains(intptr_t Offset) const {
+    return Offset >= 0 and static_cast<size_t>(Offset) < Entries.size();
+  }
+
+  /// The types at each offset depend on the layout: forget them
+  void setDataLayout(const llvm::DataLayout *NewLayout);
+
+  /// \return the same as `getTypeAtOffset(Layout, Root, Offset)`
+  std::pair<llvm::IntegerType *, unsigned> get(intptr_t Offset);
+};
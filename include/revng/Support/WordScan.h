@@ -0,0 +1,43 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+
+#include "llvm/Support/Endian.h"
+
+/// Read the words of type \p T in [\p Start, \p End) which are aligned in the
+/// address space, given that \p Start is at \p StartAddress, and call
+/// \p Callback with the offset from \p Start and the value of each of those
+/// within [\p Lowest, \p Highest].
+///
+/// The values outside of the range are discarded with a plain integer
+/// comparison: when looking for pointers to code, these are most of them.
+template<typename T, llvm::support::endianness Endianness, typename CallbackT>
+void forEachWordInRange(const unsigned char *Start,
+                        const unsigned char *End,
+                        uint64_t StartAddress,
+                        uint64_t Lowest,
+                        uint64_t Highest,
+                        CallbackT &&Callback) {
+  using llvm::support::endian::read;
+  constexpr auto Step = sizeof(T);
+
+  auto Cursor = Start;
+
+  // Align the starting address: we want to scan one step at a time starting
+  // from an aligned size
+  auto Misalignment = StartAddress % Step;
+  if (Misalignment != 0)
+    Cursor += Step - Misalignment;
+
+  for (; Cursor < End - Step; Cursor += Step) {
+    uint64_t RawValue = read<T, Endianness, 1>(Cursor);
+    if (RawValue < Lowest or RawValue > Highest)
+      continue;
+
+    Callback(static_cast<uint64_t>(Cursor - Start), RawValue);
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+
+namespace revng {
+
+/// A YAML document whose largest top-level sequences have been taken apart,
+/// so that the pieces can be parsed independently
+struct SplitYAMLDocument {
+  struct Sequence {
+    /// The key of the sequence in the top-level mapping
+    llvm::StringRef Key;
+
+    /// Consecutive runs of whole items of the sequence, each one a valid YAML
+    /// document holding a sequence. They refer to the original document.
+    std::vector<llvm::StringRef> Chunks;
+  };
+
+  /// The original document without the split sequences, nor their keys
+  std::string Rest;
+
+  std::vector<Sequence> Sequences;
+};
+
+/// Take apart the block sequences which are the values of \p Keys in the
+/// top-level mapping of the YAML document \p YAML, in chunks of about
+/// \p ChunkSize bytes.
+///
+/// This works on the text, relying on the indentation, and is meant for
+/// documents emitted by `llvm::yaml::Output`: the top-level keys are at the
+/// beginning of a line and each item of a block sequence starts on its own
+/// line with `- `.
+///
+/// \return the split document, or std::nullopt if none of \p Keys is a block
+///         sequence in \p YAML
+std::optional<SplitYAMLDocument>
+splitTopLevelSequences(llvm::StringRef YAML,
+                       llvm::ArrayRef<llvm::StringRef> Keys,
+                       size_t ChunkSize);
+
+} // namespace revng
@@ -0,0 +1,51 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+/// Compresses \p Buffer in a single zstd frame. Large buffers are compressed
+/// using `-zstd-threads` threads.
+void zstdCompress(llvm::raw_ostream &OS,
+                  llvm::ArrayRef<uint8_t> Buffer,
+                  int CompressionLevel = 3);
+
+inline void zstdCompress(llvm::raw_ostream &OS, llvm::ArrayRef<char> Buffer) {
+  return zstdCompress(OS,
+                      { reinterpret_cast<const uint8_t *>(Buffer.data()),
+                        Buffer.size() });
+}
+
+/// Compresses \p Buffer in a single zstd frame, on the calling thread.
+/// Meant for callers which are already compressing several buffers in
+/// parallel.
+void zstdCompressSerially(llvm::raw_ostream &OS,
+                          llvm::ArrayRef<uint8_t> Buffer,
+                          int CompressionLevel = 3);
+
+inline void zstdCompressSerially(llvm::raw_ostream &OS,
+                                 llvm::ArrayRef<char> Buffer) {
+  const auto *Data = reinterpret_cast<const uint8_t *>(Buffer.data());
+  return zstdCompressSerially(OS, { Data, Buffer.size() });
+}
+
+/// Decompresses \p Buffer, which can be made of multiple concatenated frames
+///
+/// \return an error if \p Buffer is not valid zstd data, in which case what
+///         could be decompressed has already been written to \p OS
+llvm::Error zstdDecompress(llvm::raw_ostream &OS,
+                           llvm::ArrayRef<uint8_t> Buffer);
+
+inline llvm::Error zstdDecompress(llvm::raw_ostream &OS,
+                                  llvm::ArrayRef<char> Buffer) {
+  return zstdDecompress(OS,
+                        { reinterpret_cast<const uint8_t *>(Buffer.data()),
+                          Buffer.size() });
+}
+
+/// \return true if \p Buffer starts with the magic number of a zstd frame
+bool isZstd(llvm::ArrayRef<char> Buffer);
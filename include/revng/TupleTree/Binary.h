@@ -0,0 +1,524 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/ADT/Concepts.h"
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/TupleLikeTraits.h"
+
+// Compact binary encoding of tuple trees, to be used in place of YAML where
+// the document is not meant to be read or edited by humans, such as in the
+// execution directory. YAML remains the interchange format.
+//
+// The encoding follows the structure of the YAML document: each value is a
+// tag byte followed by its payload.
+//
+//   Tag      | Payload
+//   ---------|-----------------------------------------------------------
+//   False    |
+//   True     |
+//   Unsigned | ULEB128
+//   Signed   | SLEB128
+//   String   | string
+//   Sequence | ULEB128 count, followed by count values
+//   Mapping  | ULEB128 count, followed by count (string key, value) pairs
+//   Kind     | string, the name of a concrete type, followed by its Mapping
+//
+// Strings are interned: a string is encoded as ULEB128 I, the I-th string
+// encountered so far (starting from 1), or as 0 followed by the ULEB128 length
+// and the bytes of a new string.
+//
+// Struct fields are mapping entries named after the field. Optional fields
+// holding their default value are omitted, as in YAML. Scalars other than
+// booleans, integers and strings are encoded as the string YAML would use.
+// Empty polymorphic pointers are empty mappings.
+//
+// A document is `Magic`, a version byte and the root value.
+
+namespace tupletree::binary {
+
+inline constexpr llvm::StringLiteral Magic = "RVNGTTB";
+inline constexpr uint8_t Version = 1;
+
+enum class Tag : uint8_t {
+  False,
+  True,
+  Unsigned,
+  Signed,
+  String,
+  Sequence,
+  Mapping,
+  Kind
+};
+
+/// \return true if \p Buffer holds a tuple tree in the binary format
+inline bool isBinary(llvm::StringRef Buffer) {
+  return Buffer.starts_with(Magic);
+}
+
+class Writer {
+private:
+  llvm::raw_ostream &OS;
+  llvm::StringMap<uint64_t> Strings;
+
+public:
+  explicit Writer(llvm::raw_ostream &OS) : OS(OS) {
+    OS << Magic << static_cast<char>(Version);
+  }
+
+public:
+  void writeTag(Tag Value) { OS << static_cast<char>(Value); }
+  void writeUnsigned(uint64_t Value) { llvm::encodeULEB128(Value, OS); }
+  void writeSigned(int64_t Value) { llvm::encodeSLEB128(Value, OS); }
+
+  void writeString(llvm::StringRef Value) {
+    auto [Iterator, New] = Strings.try_emplace(Value, Strings.size() + 1);
+    if (not New) {
+      writeUnsigned(Iterator->second);
+      return;
+    }
+
+    writeUnsigned(0);
+    writeUnsigned(Value.size());
+    OS << Value;
+  }
+};
+
+class Reader {
+private:
+  llvm::StringRef Buffer;
+  size_t Offset = 0;
+  /// The strings encountered so far, pointing into Buffer
+  std::vector<llvm::StringRef> Strings;
+
+public:
+  explicit Reader(llvm::StringRef Buffer) : Buffer(Buffer) {}
+
+public:
+  llvm::Error readHeader() {
+    if (not isBinary(Buffer) or Buffer.size() <= Magic.size())
+      return error("not a binary tuple tree");
+
+    Offset = Magic.size();
+    auto DocumentVersion = static_cast<uint8_t>(Buffer[Offset++]);
+    if (DocumentVersion != Version)
+      return error("unsupported version " + llvm::Twine(DocumentVersion));
+
+    return llvm::Error::success();
+  }
+
+  bool atEnd() const { return Offset == Buffer.size(); }
+
+  llvm::Error error(const llvm::Twine &Message) const {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Invalid binary tuple tree at offset "
+                                     + llvm::Twine(Offset) + ": " + Message);
+  }
+
+  llvm::Expected<Tag> readTag() {
+    if (atEnd())
+      return error("unexpected end of the document");
+
+    auto Result = static_cast<uint8_t>(Buffer[Offset++]);
+    if (Result > static_cast<uint8_t>(Tag::Kind))
+      return error("unknown tag " + llvm::Twine(Result));
+
+    return static_cast<Tag>(Result);
+  }
+
+  llvm::Error expectTag(Tag Expected) {
+    auto MaybeTag = readTag();
+    if (not MaybeTag)
+      return MaybeTag.takeError();
+
+    if (*MaybeTag != Expected)
+      return error("unexpected tag " + llvm::Twine(uint8_t(*MaybeTag)));
+
+    return llvm::Error::success();
+  }
+
+  llvm::Expected<uint64_t> readUnsigned() {
+    unsigned Length = 0;
+    const char *Message = nullptr;
+    uint64_t Result = llvm::decodeULEB128(bytes(), &Length, end(), &Message);
+    if (Message != nullptr)
+      return error(Message);
+
+    Offset += Length;
+    return Result;
+  }
+
+  llvm::Expected<int64_t> readSigned() {
+    unsigned Length = 0;
+    const char *Message = nullptr;
+    int64_t Result = llvm::decodeSLEB128(bytes(), &Length, end(), &Message);
+    if (Message != nullptr)
+      return error(Message);
+
+    Offset += Length;
+    return Result;
+  }
+
+  llvm::Expected<llvm::StringRef> readString() {
+    auto MaybeIndex = readUnsigned();
+    if (not MaybeIndex)
+      return MaybeIndex.takeError();
+
+    if (*MaybeIndex != 0) {
+      if (*MaybeIndex > Strings.size())
+        return error("unknown string " + llvm::Twine(*MaybeIndex));
+      return Strings[*MaybeIndex - 1];
+    }
+
+    auto MaybeSize = readUnsigned();
+    if (not MaybeSize)
+      return MaybeSize.takeError();
+
+    if (*MaybeSize > Buffer.size() - Offset)
+      return error("string past the end of the document");
+
+    llvm::StringRef Result = Buffer.substr(Offset, *MaybeSize);
+    Offset += *MaybeSize;
+    Strings.push_back(Result);
+    return Result;
+  }
+
+private:
+  const uint8_t *bytes() const {
+    return reinterpret_cast<const uint8_t *>(Buffer.data()) + Offset;
+  }
+
+  const uint8_t *end() const {
+    return reinterpret_cast<const uint8_t *>(Buffer.data()) + Buffer.size();
+  }
+};
+
+namespace detail {
+
+template<typename T>
+concept Sequence = KeyedObjectContainer<T>
+                   or StrictSpecializationOf<T, std::vector>;
+
+template<typename T>
+concept Polymorphic = StrictSpecializationOf<T, UpcastablePointer>;
+
+template<typename T>
+concept Integer = std::is_integral_v<T> and not std::is_same_v<T, bool>;
+
+template<TraitedTupleLike T, size_t I>
+constexpr bool isOptionalField() {
+  using Fields = typename TupleLikeTraits<T>::Fields;
+  using MT = llvm::yaml::MappingTraits<T>;
+  constexpr Fields Field = static_cast<Fields>(I);
+  if constexpr (requires { MT::template isOptional<Field>(); })
+    return MT::template isOptional<Field>();
+  else
+    return false;
+}
+
+template<TraitedTupleLike T, size_t I>
+bool isFieldOmitted(const T &Object) {
+  if constexpr (isOptionalField<T, I>())
+    return get<I>(Object) == std::tuple_element_t<I, T>{};
+  else
+    return false;
+}
+
+template<TraitedTupleLike T, size_t I = 0>
+uint64_t countFields(const T &Object) {
+  if constexpr (I < std::tuple_size_v<T>)
+    return (isFieldOmitted<T, I>(Object) ? 0 : 1)
+           + countFields<T, I + 1>(Object);
+  else
+    return 0;
+}
+
+template<typename T>
+void write(Writer &W, const T &Value);
+
+template<TraitedTupleLike T, size_t I = 0>
+void writeFields(Writer &W, const T &Object) {
+  if constexpr (I < std::tuple_size_v<T>) {
+    if (not isFieldOmitted<T, I>(Object)) {
+      W.writeString(TupleLikeTraits<T>::FieldNames[I]);
+      write(W, get<I>(Object));
+    }
+
+    writeFields<T, I + 1>(W, Object);
+  }
+}
+
+template<typename T>
+void write(Writer &W, const T &Value) {
+  if constexpr (Polymorphic<T>) {
+    if (Value.isEmpty()) {
+      W.writeTag(Tag::Mapping);
+      W.writeUnsigned(0);
+      return;
+    }
+
+    Value.upcast([&W](const auto &Upcasted) {
+      using Concrete = std::decay_t<decltype(Upcasted)>;
+      W.writeTag(Tag::Kind);
+      W.writeString(TupleLikeTraits<Concrete>::Name);
+      write(W, Upcasted);
+    });
+  } else if constexpr (TraitedTupleLike<T>) {
+    W.writeTag(Tag::Mapping);
+    W.writeUnsigned(countFields(Value));
+    writeFields(W, Value);
+  } else if constexpr (Sequence<T>) {
+    W.writeTag(Tag::Sequence);
+    W.writeUnsigned(Value.size());
+    for (const auto &Element : Value)
+      write(W, Element);
+  } else if constexpr (std::is_same_v<T, bool>) {
+    W.writeTag(Value ? Tag::True : Tag::False);
+  } else if constexpr (Integer<T> and std::is_signed_v<T>) {
+    W.writeTag(Tag::Signed);
+    W.writeSigned(Value);
+  } else if constexpr (Integer<T>) {
+    W.writeTag(Tag::Unsigned);
+    W.writeUnsigned(Value);
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    W.writeTag(Tag::String);
+    W.writeString(Value);
+  } else {
+    static_assert(HasScalarOrEnumTraits<T>);
+    W.writeTag(Tag::String);
+    W.writeString(getNameFromYAMLScalar(Value));
+  }
+}
+
+template<typename T>
+llvm::Error read(Reader &R, T &Value);
+
+template<TraitedTupleLike T, size_t I = 0>
+llvm::Error readField(Reader &R, llvm::StringRef Name, T &Object) {
+  if constexpr (I < std::tuple_size_v<T>) {
+    if (TupleLikeTraits<T>::FieldNames[I] == Name)
+      return read(R, get<I>(Object));
+
+    return readField<T, I + 1>(R, Name, Object);
+  } else {
+    return R.error("unknown field " + Name + " in "
+                   + TupleLikeTraits<T>::Name);
+  }
+}
+
+/// Creates in \p Pointer the concrete type named \p Kind
+template<Polymorphic T, size_t I = 0>
+bool initializePointer(llvm::StringRef Kind, T &Pointer) {
+  using concrete_types = concrete_types_traits_t<typename T::element_type>;
+
+  if constexpr (I < std::tuple_size_v<concrete_types>) {
+    using Concrete = std::tuple_element_t<I, concrete_types>;
+    if (llvm::StringRef(TupleLikeTraits<Concrete>::Name) != Kind)
+      return initializePointer<T, I + 1>(Kind, Pointer);
+
+    Pointer.reset(new Concrete);
+    return true;
+  } else {
+    return false;
+  }
+}
+
+/// Creates a placeholder for an element of a KeyedObjectContainer, to be
+/// overwritten when reading it
+template<typename T>
+T makeElement() {
+  if constexpr (std::is_default_constructible_v<T>) {
+    return T();
+  } else {
+    using KOT = KeyedObjectTraits<T>;
+    using key_type = std::decay_t<decltype(KOT::key(std::declval<T>()))>;
+    return KOT::fromKey(key_type());
+  }
+}
+
+template<typename T>
+llvm::Error read(Reader &R, T &Value) {
+  if constexpr (Polymorphic<T>) {
+    auto MaybeTag = R.readTag();
+    if (not MaybeTag)
+      return MaybeTag.takeError();
+
+    if (*MaybeTag == Tag::Mapping) {
+      auto MaybeCount = R.readUnsigned();
+      if (not MaybeCount)
+        return MaybeCount.takeError();
+      if (*MaybeCount != 0)
+        return R.error("polymorphic object without a kind");
+
+      Value.reset();
+      return llvm::Error::success();
+    }
+
+    if (*MaybeTag != Tag::Kind)
+      return R.error("expected a polymorphic object");
+
+    auto MaybeKind = R.readString();
+    if (not MaybeKind)
+      return MaybeKind.takeError();
+
+    if (not initializePointer(*MaybeKind, Value))
+      return R.error("unknown kind " + *MaybeKind);
+
+    auto ReadConcrete = [&R](auto &Upcasted) { return read(R, Upcasted); };
+    if (auto Error = ::upcast(Value, ReadConcrete, llvm::Error::success()))
+      return Error;
+
+    // Same as in YAML: a default-initialized kind means no object
+    if (size_t(Value->Kind()) == 0)
+      Value.reset();
+
+    return llvm::Error::success();
+  } else if constexpr (TraitedTupleLike<T>) {
+    if (auto Error = R.expectTag(Tag::Mapping))
+      return Error;
+
+    auto MaybeCount = R.readUnsigned();
+    if (not MaybeCount)
+      return MaybeCount.takeError();
+
+    for (uint64_t I = 0; I < *MaybeCount; ++I) {
+      auto MaybeName = R.readString();
+      if (not MaybeName)
+        return MaybeName.takeError();
+
+      if (auto Error = readField(R, *MaybeName, Value))
+        return Error;
+    }
+
+    return llvm::Error::success();
+  } else if constexpr (Sequence<T>) {
+    if (auto Error = R.expectTag(Tag::Sequence))
+      return Error;
+
+    auto MaybeCount = R.readUnsigned();
+    if (not MaybeCount)
+      return MaybeCount.takeError();
+
+    if constexpr (KeyedObjectContainer<T>) {
+      using value_type = typename T::value_type;
+
+      auto Inserter = Value.batch_insert();
+      for (uint64_t I = 0; I < *MaybeCount; ++I) {
+        value_type Element = makeElement<value_type>();
+        if (auto Error = read(R, Element))
+          return Error;
+
+        if constexpr (requires { Inserter.emplace(std::move(Element)); })
+          Inserter.emplace(std::move(Element));
+        else
+          Inserter.insert(Element);
+      }
+    } else {
+      Value.clear();
+      for (uint64_t I = 0; I < *MaybeCount; ++I)
+        if (auto Error = read(R, Value.emplace_back()))
+          return Error;
+    }
+
+    return llvm::Error::success();
+  } else if constexpr (std::is_same_v<T, bool>) {
+    auto MaybeTag = R.readTag();
+    if (not MaybeTag)
+      return MaybeTag.takeError();
+
+    if (*MaybeTag != Tag::False and *MaybeTag != Tag::True)
+      return R.error("expected a boolean");
+
+    Value = *MaybeTag == Tag::True;
+    return llvm::Error::success();
+  } else if constexpr (Integer<T> and std::is_signed_v<T>) {
+    if (auto Error = R.expectTag(Tag::Signed))
+      return Error;
+
+    auto MaybeValue = R.readSigned();
+    if (not MaybeValue)
+      return MaybeValue.takeError();
+
+    if (*MaybeValue < std::numeric_limits<T>::min()
+        or *MaybeValue > std::numeric_limits<T>::max())
+      return R.error("integer out of range");
+
+    Value = *MaybeValue;
+    return llvm::Error::success();
+  } else if constexpr (Integer<T>) {
+    if (auto Error = R.expectTag(Tag::Unsigned))
+      return Error;
+
+    auto MaybeValue = R.readUnsigned();
+    if (not MaybeValue)
+      return MaybeValue.takeError();
+
+    if (*MaybeValue > std::numeric_limits<T>::max())
+      return R.error("integer out of range");
+
+    Value = *MaybeValue;
+    return llvm::Error::success();
+  } else {
+    if (auto Error = R.expectTag(Tag::String))
+      return Error;
+
+    auto MaybeString = R.readString();
+    if (not MaybeString)
+      return MaybeString.takeError();
+
+    if constexpr (std::is_same_v<T, std::string>) {
+      Value = MaybeString->str();
+    } else {
+      static_assert(HasScalarOrEnumTraits<T>);
+      Value = getValueFromYAMLScalar<T>(*MaybeString);
+    }
+
+    return llvm::Error::success();
+  }
+}
+
+} // namespace detail
+
+/// Writes \p Root to \p OS in the binary format
+template<typename T>
+void serialize(llvm::raw_ostream &OS, const T &Root) {
+  Writer W(OS);
+  detail::write(W, Root);
+}
+
+/// Reads a document in the binary format from \p Buffer
+template<typename T>
+llvm::Expected<T> deserialize(llvm::StringRef Buffer) {
+  Reader R(Buffer);
+  if (auto Error = R.readHeader())
+    return std::move(Error);
+
+  T Result;
+  if (auto Error = detail::read(R, Result))
+    return std::move(Error);
+
+  if (not R.atEnd())
+    return R.error("trailing data after the document");
+
+  return Result;
+}
+
+} // namespace tupletree::binary
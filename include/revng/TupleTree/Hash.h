@@ -0,0 +1,107 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/ADT/Concepts.h"
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/ADT/UpcastablePointer.h"
+#include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/TupleLikeTraits.h"
+
+// Merkle-style hashes of tuple trees.
+//
+// The hash of an object combines the hashes of its fields, the hash of a
+// container combines the hashes of its elements. Two subtrees with the same
+// hash are considered identical, which lets `diff` skip them entirely.
+//
+// Objects generated by tuple_tree_generator cache their hash (`cachedHash()`).
+// Each non-const accessor resets the cache of the object it belongs to and,
+// since objects are reached from the root only through non-const accessors,
+// of all the objects on the path from the root. Therefore, only the subtrees
+// that have been modified since the last time a hash was computed are visited
+// again.
+//
+// \note mutating an object through a reference obtained *before* computing the
+//       hash of one of its ancestors leaves the hash of the ancestors stale.
+//       Don't keep mutable references around across a `diff`.
+//
+// \note hashes are not stable across processes, do not store them.
+
+namespace tupletree {
+
+template<typename T>
+concept HasCachedHash = requires(const T &Object) {
+  { Object.cachedHash() } -> std::same_as<uint64_t &>;
+};
+
+template<typename T>
+uint64_t hash(const T &Value);
+
+namespace detail {
+
+template<TraitedTupleLike T, size_t I = 0>
+llvm::hash_code hashFields(const T &Object) {
+  if constexpr (I < std::tuple_size_v<T>)
+    return llvm::hash_combine(hash(get<I>(Object)),
+                              hashFields<T, I + 1>(Object));
+  else
+    return llvm::hash_value(TupleLikeTraits<T>::Name);
+}
+
+template<typename T>
+uint64_t computeHash(const T &Value) {
+  if constexpr (StrictSpecializationOf<T, UpcastablePointer>) {
+    if (Value.isEmpty())
+      return 0;
+
+    uint64_t Result = 0;
+    Value.upcast([&Result](const auto &Upcasted) { Result = hash(Upcasted); });
+    return Result;
+  } else if constexpr (TraitedTupleLike<T>) {
+    return hashFields(Value);
+  } else if constexpr (KeyedObjectContainer<T>
+                       or StrictSpecializationOf<T, std::vector>
+                       or StrictSpecializationOf<T, std::set>) {
+    llvm::hash_code Result = llvm::hash_value(Value.size());
+    for (const auto &Element : Value)
+      Result = llvm::hash_combine(Result, hash(Element));
+    return Result;
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return llvm::hash_value(llvm::StringRef(Value));
+  } else if constexpr (std::is_integral_v<T> or std::is_enum_v<T>) {
+    return llvm::hash_value(static_cast<uint64_t>(Value));
+  } else {
+    static_assert(HasScalarOrEnumTraits<T>);
+    return llvm::hash_value(getNameFromYAMLScalar(Value));
+  }
+}
+
+} // namespace detail
+
+/// \return the hash of the subtree rooted in \p Value, reusing the hashes
+///         cached in unmodified objects
+template<typename T>
+uint64_t hash(const T &Value) {
+  if constexpr (HasCachedHash<T>) {
+    uint64_t &Cached = Value.cachedHash();
+    // 0 means "not computed", an actual 0 hash is just never cached
+    if (Cached == 0)
+      Cached = detail::computeHash(Value);
+    return Cached;
+  } else {
+    return detail::computeHash(Value);
+  }
+}
+
+} // namespace tupletree
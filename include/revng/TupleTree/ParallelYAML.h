@@ -0,0 +1,148 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLTraits.h"
+
+#include "revng/ADT/KeyedObjectContainer.h"
+#include "revng/Support/YAMLSplitting.h"
+#include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/TupleLikeTraits.h"
+
+namespace tupletree::detail {
+
+/// Documents smaller than this are not worth splitting
+inline constexpr size_t ParallelYAMLThreshold = 8 * 1024 * 1024;
+
+/// The size of the pieces of the top-level sequences parsed by each task
+inline constexpr size_t ParallelYAMLChunkSize = 1024 * 1024;
+
+inline void ignoreDiagnostic(const llvm::SMDiagnostic &, void *) {
+}
+
+/// Parse \p YAML in \p Result without printing any diagnostic: on failure the
+/// whole document is parsed again, sequentially, to report the errors
+template<typename T>
+bool parseQuietly(llvm::StringRef YAML, T &Result) {
+  llvm::yaml::Input YAMLInput(YAML, nullptr, ignoreDiagnostic);
+  YAMLInput >> Result;
+  return not YAMLInput.error();
+}
+
+using ParseTask = std::function<bool()>;
+using MergeTask = std::function<void()>;
+
+/// If the I-th field of \p Result is one of the sequences in \p Document,
+/// schedule the parsing of each of its chunks and the merging of the results
+template<TraitedTupleLike T, size_t I>
+void scheduleField(T &Result,
+                   const revng::SplitYAMLDocument &Document,
+                   std::vector<ParseTask> &Tasks,
+                   std::vector<MergeTask> &Merges) {
+  using Field = std::tuple_element_t<I, T>;
+  if constexpr (KeyedObjectContainer<Field>) {
+    llvm::StringRef Name = TupleLikeTraits<T>::FieldNames[I];
+    for (const revng::SplitYAMLDocument::Sequence &Sequence :
+         Document.Sequences) {
+      if (Sequence.Key != Name)
+        continue;
+
+      size_t Count = Sequence.Chunks.size();
+      auto Parsed = std::make_shared<std::vector<Field>>(Count);
+      for (size_t Index = 0; Index < Count; ++Index) {
+        llvm::StringRef Chunk = Sequence.Chunks[Index];
+        Tasks.push_back([Parsed, Index, Chunk]() {
+          return parseQuietly(Chunk, (*Parsed)[Index]);
+        });
+      }
+
+      Merges.push_back([&Result, Parsed]() {
+        auto Inserter = get<I>(Result).batch_insert();
+        for (Field &Chunk : *Parsed)
+          for (auto &Element : Chunk)
+            Inserter.emplace(std::move(Element));
+      });
+    }
+  }
+}
+
+template<TraitedTupleLike T, size_t... Indices>
+void scheduleFields(T &Result,
+                    const revng::SplitYAMLDocument &Document,
+                    std::vector<ParseTask> &Tasks,
+                    std::vector<MergeTask> &Merges,
+                    std::index_sequence<Indices...>) {
+  (scheduleField<T, Indices>(Result, Document, Tasks, Merges), ...);
+}
+
+/// Deserialize a tuple tree root from \p YAMLString, parsing the chunks of its
+/// large top-level collections (e.g., `Functions` or `TypeDefinitions`) in
+/// parallel and merging them in the result afterwards.
+///
+/// This produces the same result as `revng::detail::deserializeImpl`, which is
+/// used directly for small documents and for the ones which cannot be split.
+template<typename T>
+llvm::Expected<T>
+deserializeYAML(llvm::StringRef YAMLString,
+                size_t Threshold = ParallelYAMLThreshold,
+                size_t ChunkSize = ParallelYAMLChunkSize) {
+  if constexpr (not TraitedTupleLike<T>) {
+    return revng::detail::deserializeImpl<T>(YAMLString);
+  } else {
+    if (YAMLString.size() < Threshold)
+      return revng::detail::deserializeImpl<T>(YAMLString);
+
+    constexpr size_t FieldsCount = std::tuple_size_v<T>;
+    std::vector<llvm::StringRef> Keys;
+    [&]<size_t... Indices>(std::index_sequence<Indices...>) {
+      ((KeyedObjectContainer<std::tuple_element_t<Indices, T>> ?
+          Keys.push_back(TupleLikeTraits<T>::FieldNames[Indices]) :
+          void()),
+       ...);
+    }(std::make_index_sequence<FieldsCount>());
+
+    auto MaybeDocument = revng::splitTopLevelSequences(YAMLString,
+                                                       Keys,
+                                                       ChunkSize);
+    if (not MaybeDocument)
+      return revng::detail::deserializeImpl<T>(YAMLString);
+
+    T Result;
+    std::vector<ParseTask> Tasks;
+    std::vector<MergeTask> Merges;
+    Tasks.push_back([&Result, &MaybeDocument]() {
+      return parseQuietly(llvm::StringRef(MaybeDocument->Rest), Result);
+    });
+    scheduleFields(Result,
+                   *MaybeDocument,
+                   Tasks,
+                   Merges,
+                   std::make_index_sequence<FieldsCount>());
+
+    // std::vector<bool> cannot be written concurrently
+    std::vector<char> Succeeded(Tasks.size(), false);
+    llvm::parallelFor(0, Tasks.size(), [&](size_t Index) {
+      Succeeded[Index] = Tasks[Index]();
+    });
+
+    // Let the sequential parser report the errors as usual
+    if (llvm::is_contained(Succeeded, false))
+      return revng::detail::deserializeImpl<T>(YAMLString);
+
+    for (MergeTask &Merge : Merges)
+      Merge();
+
+    return Result;
+  }
+}
+
+} // namespace tupletree::detail
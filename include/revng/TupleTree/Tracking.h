@@ -6,6 +6,8 @@
 
 #include <set>
 
+#include "llvm/ADT/STLExtras.h"
+
 #include "revng/TupleTree/TupleTreePath.h"
 
 /// Struct returned by Tracking::collect.
@@ -24,6 +26,17 @@ struct ReadFields {
 namespace revng {
 
 struct Tracking {
+  using PathCallback = llvm::function_ref<void(const TupleTreePath &)>;
+
+  /// Reports the path of each field that has been read to \p OnRead and the
+  /// path of each container that has been inspected as a whole to \p OnExact,
+  /// then clears the tracking state, like `clearAndResume`.
+  ///
+  /// Paths are built on the fly: prefer this over the overload below when
+  /// the paths are going to be moved elsewhere anyway.
+  template<typename M>
+  static void collect(const M &LHS, PathCallback OnRead, PathCallback OnExact);
+
   template<typename M>
   static ReadFields collect(const M &LHS);
 
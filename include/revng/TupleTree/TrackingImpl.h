@@ -13,15 +13,17 @@
 namespace revng {
 
 struct TrackingImpl {
+  using PathCallback = Tracking::PathCallback;
+
   struct PopVisitor {
     template<revng::SetOrKOC Type>
     static void visitKeyedObjectContainer(const Type &CurrentItem) {
       CurrentItem.trackingPop();
     }
 
-    template<typename Type, size_t FieldIndex>
-    static void visitTupleElement(const Type &CurrentItem) {
-      CurrentItem.template getTracker<FieldIndex>().pop();
+    template<typename TrackerType>
+    static void visitFields(TrackerType &Tracker) {
+      Tracker.pop();
     }
   };
 
@@ -31,9 +33,9 @@ struct TrackingImpl {
       CurrentItem.trackingPush();
     }
 
-    template<typename Type, size_t FieldIndex>
-    static void visitTupleElement(const Type &CurrentItem) {
-      CurrentItem.template getTracker<FieldIndex>().push();
+    template<typename TrackerType>
+    static void visitFields(TrackerType &Tracker) {
+      Tracker.push();
     }
   };
 
@@ -43,9 +45,9 @@ struct TrackingImpl {
       CurrentItem.clearTracking();
     }
 
-    template<typename Type, size_t FieldIndex>
-    static void visitTupleElement(const Type &CurrentItem) {
-      CurrentItem.template getTracker<FieldIndex>().clear();
+    template<typename TrackerType>
+    static void visitFields(TrackerType &Tracker) {
+      Tracker.clear();
     }
   };
 
@@ -55,58 +57,67 @@ struct TrackingImpl {
       CurrentItem.stopTracking();
     }
 
-    template<typename Type, size_t FieldIndex>
-    static void visitTupleElement(const Type &CurrentItem) {
-      CurrentItem.template getTracker<FieldIndex>().stopTracking();
+    template<typename TrackerType>
+    static void visitFields(TrackerType &Tracker) {
+      Tracker.stopTracking();
     }
   };
 
   template<typename M, size_t I = 0, typename T>
-  static void
-  collectTuple(const T &LHS, TupleTreePath &Stack, ReadFields &Info) {
+  static void collectTuple(const T &LHS,
+                           TupleTreePath &Stack,
+                           PathCallback OnRead,
+                           PathCallback OnExact) {
     if constexpr (I < std::tuple_size_v<T>) {
 
       Stack.push_back(size_t(I));
-      if (LHS.template getTracker<I>().isSet()) {
-        Info.Read.insert(Stack);
-      }
-      collectImpl<M>(LHS.template untrackedGet<I>(), Stack, Info);
+      if (LHS.template isFieldRead<I>())
+        OnRead(Stack);
+      collectImpl<M>(LHS.template untrackedGet<I>(), Stack, OnRead, OnExact);
       Stack.pop_back();
 
       // Recur
-      collectTuple<M, I + 1>(LHS, Stack, Info);
+      collectTuple<M, I + 1>(LHS, Stack, OnRead, OnExact);
     }
   }
 
   template<typename M, StrictSpecializationOf<UpcastablePointer> T>
-  static void collectImpl(const T &UP, TupleTreePath &Stack, ReadFields &Info) {
+  static void collectImpl(const T &UP,
+                          TupleTreePath &Stack,
+                          PathCallback OnRead,
+                          PathCallback OnExact) {
     if (!UP.isEmpty()) {
       UP.upcast([&](auto &Upcasted) {
         // Don't forget to add the kind of the polymorphic object to the stack.
         Stack.push_back(Upcasted.Kind());
-        collectImpl<M>(Upcasted, Stack, Info);
+        collectImpl<M>(Upcasted, Stack, OnRead, OnExact);
         Stack.pop_back();
       });
     }
   }
 
   template<typename M, TupleSizeCompatible T>
-  static void
-  collectImpl(const T &LHS, TupleTreePath &Stack, ReadFields &Info) {
-    collectTuple<M>(LHS, Stack, Info);
+  static void collectImpl(const T &LHS,
+                          TupleTreePath &Stack,
+                          PathCallback OnRead,
+                          PathCallback OnExact) {
+    collectTuple<M>(LHS, Stack, OnRead, OnExact);
+    LHS.visitTrackers([](auto &Tracker) { Tracker.clear(); });
   }
 
   template<typename M, revng::SetOrKOC T>
-  static void
-  collectImpl(const T &LHS, TupleTreePath &Stack, ReadFields &Info) {
+  static void collectImpl(const T &LHS,
+                          TupleTreePath &Stack,
+                          PathCallback OnRead,
+                          PathCallback OnExact) {
     typename T::TrackingResult TrackingResult = LHS.getTrackingResult();
     if (TrackingResult.Exact)
-      Info.ExactVectors.insert(Stack);
+      OnExact(Stack);
 
     using KeyType = std::remove_cv_t<typename T::key_type>;
     for (KeyType Key : TrackingResult.InspectedKeys) {
       Stack.push_back(Key);
-      Info.Read.insert(Stack);
+      OnRead(Stack);
       Stack.pop_back();
     }
     for (auto &LHSElement : LHS.Content) {
@@ -114,24 +125,27 @@ struct TrackingImpl {
 
       Stack.push_back(KeyedObjectTraits<value_type>::key(LHSElement));
 
-      collectImpl<M>(LHSElement, Stack, Info);
+      collectImpl<M>(LHSElement, Stack, OnRead, OnExact);
       Stack.pop_back();
     }
+    LHS.clearTracking();
   }
 
   template<typename M, NotTupleTreeCompatible T>
-  static void
-  collectImpl(const T &LHS, TupleTreePath &Stack, ReadFields &Info) {}
+  static void collectImpl(const T &LHS,
+                          TupleTreePath &Stack,
+                          PathCallback OnRead,
+                          PathCallback OnExact) {}
 
   template<typename M, typename Visitor, size_t I = 0, typename T>
   static void visitTuple(const T &LHS) {
     if constexpr (I < std::tuple_size_v<T>) {
-
       visitImpl<M, Visitor>(LHS.template untrackedGet<I>());
-      Visitor::template visitTupleElement<T, I>(LHS);
 
       // Recur
       visitTuple<M, Visitor, I + 1, T>(LHS);
+    } else {
+      LHS.visitTrackers([](auto &Tracker) { Visitor::visitFields(Tracker); });
     }
   }
 
@@ -161,12 +175,27 @@ struct TrackingImpl {
 };
 
 template<typename M>
-ReadFields Tracking::collect(const M &LHS) {
+void Tracking::collect(const M &LHS,
+                       PathCallback OnRead,
+                       PathCallback OnExact) {
+  // Stop tracking, so that the visit itself (e.g., inspecting the kind of
+  // polymorphic objects) is not recorded. Each object is then cleared and
+  // resumed right after its inspection, in the same visit.
   stop(LHS);
   TupleTreePath Stack;
+  TrackingImpl::collectImpl<M>(LHS, Stack, OnRead, OnExact);
+}
+
+template<typename M>
+ReadFields Tracking::collect(const M &LHS) {
   ReadFields Info;
-  TrackingImpl::collectImpl<M>(LHS, Stack, Info);
-  clearAndResume(LHS);
+  auto InsertRead = [&Info](const TupleTreePath &Path) {
+    Info.Read.insert(Path);
+  };
+  auto InsertExact = [&Info](const TupleTreePath &Path) {
+    Info.ExactVectors.insert(Path);
+  };
+  collect(LHS, InsertRead, InsertExact);
   return Info;
 }
 
@@ -5,10 +5,13 @@
 //
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <set>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -25,6 +28,8 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/YAMLTraits.h"
+#include "revng/TupleTree/Binary.h"
+#include "revng/TupleTree/ParallelYAML.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/TupleTreeCompatible.h"
 #include "revng/TupleTree/TupleTreePath.h"
@@ -75,30 +80,74 @@ private:
   }
 };
 
+/// Owner of a tree of TupleTreeCompatible objects
+///
+/// Copies are copy-on-write: they share the same root until one of them is
+/// accessed in a way that allows to modify it (non-const get(), operator* and
+/// operator->, non-const visits...), at which point that copy performs a deep
+/// copy for itself. Therefore, taking a snapshot of a tree costs nothing if
+/// either the snapshot or the original are only read.
+///
+/// Caching the references doesn't copy the root: the cached targets belong to
+/// the shared root, and remain valid as long as none of the copies modifies it.
+/// Tracking the reads does, see detach.
+///
+/// \note pointers and references to the content obtained through a non-const
+///       access *before* copying allow to modify the shared content. Don't
+///       keep them around across a copy.
 template<TupleTreeCompatible T>
 class TupleTree {
 private:
-  std::unique_ptr<T> Root;
+  using StructuralGeneration = revng::StructuralGeneration;
+
+  /// State of a root, shared along with it
+  struct RootState {
+    StructuralGeneration Generation;
+
+    /// The references of the root currently cache their target, on behalf of
+    /// at least one of the trees sharing it
+    bool ReferencesAreCached = false;
+  };
+
+private:
+  // It's declared first, since the containers of Root might be attached to the
+  // generation
+  std::shared_ptr<RootState> State;
+  std::shared_ptr<T> Root;
+
+  /// This tree has cached the references, and therefore cannot be modified
   bool AllReferencesAreCached = false;
 
+  static inline std::atomic<uint64_t> DeepCopies = 0;
+
 public:
-  TupleTree() : Root(new T), AllReferencesAreCached(false) {}
+  TupleTree() :
+    State(std::make_shared<RootState>()),
+    Root(std::make_shared<T>()),
+    AllReferencesAreCached(false) {}
 
-  // Allow expensive copy
-  TupleTree(const TupleTree &Other) : Root(std::make_unique<T>()) {
-    *this = Other;
-  }
+  // Copies are cheap, see detach
+  TupleTree(const TupleTree &Other) { *this = Other; }
   TupleTree &operator=(const TupleTree &Other) {
     if (Other.get() == nullptr) {
       Root = nullptr;
+      State = nullptr;
       AllReferencesAreCached = false;
       return *this;
     }
 
     if (this != &Other) {
-      *Root = *Other.Root;
+      State = Other.State;
+      Root = Other.Root;
+
+      // The copy starts uncached, even if the targets cached by Other are
+      // still there: they are evicted before the copy is modified
       AllReferencesAreCached = false;
-      initializeUncachedReferences();
+
+      // The reads of a tree are tracked in the tree itself: don't let the
+      // copy affect them
+      if (isBeingTracked())
+        detach();
     }
     return *this;
   }
@@ -108,9 +157,11 @@ public:
   TupleTree &operator=(TupleTree &&Other) {
     if (Other.get() == nullptr) {
       Root = nullptr;
+      State = nullptr;
       AllReferencesAreCached = false;
 
       Other.Root.reset();
+      Other.State.reset();
       Other.AllReferencesAreCached = false;
 
       return *this;
@@ -118,9 +169,11 @@ public:
 
     if (this != &Other) {
       Root = std::move(Other.Root);
+      State = std::move(Other.State);
       AllReferencesAreCached = Other.AllReferencesAreCached;
 
       Other.Root.reset();
+      Other.State.reset();
       Other.AllReferencesAreCached = false;
     }
     return *this;
@@ -149,10 +202,18 @@ public:
   }
 
 public:
+  /// \note documents in the binary format are accepted too
   static llvm::ErrorOr<TupleTree> deserialize(llvm::StringRef YAMLString) {
+    if (tupletree::binary::isBinary(YAMLString)) {
+      auto MaybeResult = deserializeBinary(YAMLString);
+      if (not MaybeResult)
+        return llvm::errorToErrorCode(MaybeResult.takeError());
+      return std::move(*MaybeResult);
+    }
+
     TupleTree Result{};
 
-    auto MaybeRoot = revng::detail::deserializeImpl<T>(YAMLString);
+    auto MaybeRoot = tupletree::detail::deserializeYAML<T>(YAMLString);
     if (not MaybeRoot)
       return llvm::errorToErrorCode(MaybeRoot.takeError());
 
@@ -184,6 +245,30 @@ public:
     return ::serializeToFile(*Root, Path);
   }
 
+  static llvm::Expected<TupleTree> deserializeBinary(llvm::StringRef Buffer) {
+    auto MaybeRoot = tupletree::binary::deserialize<T>(Buffer);
+    if (not MaybeRoot)
+      return MaybeRoot.takeError();
+
+    TupleTree Result{};
+    *Result.Root = std::move(*MaybeRoot);
+    Result.initializeReferences();
+    return Result;
+  }
+
+  llvm::Error toBinaryFile(const llvm::StringRef &Path) const {
+    std::error_code ErrorCode;
+    llvm::raw_fd_ostream OutFile(Path, ErrorCode, llvm::sys::fs::OF_None);
+    if (ErrorCode) {
+      return llvm::make_error<llvm::StringError>("Could not open file "
+                                                   + Path.str(),
+                                                 ErrorCode);
+    }
+
+    serializeBinary(OutFile);
+    return llvm::Error::success();
+  }
+
 public:
   template<typename S>
   void serialize(S &Stream) const {
@@ -197,57 +282,133 @@ public:
     serialize(Stream);
   }
 
+  /// Serializes the tree in the compact format of TupleTree/Binary.h
+  void serializeBinary(llvm::raw_ostream &Stream) const {
+    revng_assert(Root);
+
+    DisableTracking Guard(*Root);
+    tupletree::binary::serialize(Stream, *Root);
+  }
+
 public:
   const T *get() const noexcept { return Root.get(); }
   T *get() noexcept {
     revng_assert(not AllReferencesAreCached);
+    prepareForModification();
     return Root.get();
   }
 
   const T &operator*() const { return *Root; }
   T &operator*() {
     revng_assert(not AllReferencesAreCached);
+    prepareForModification();
     return *Root;
   }
 
   const T *operator->() const noexcept { return Root.operator->(); }
   T *operator->() noexcept {
     revng_assert(not AllReferencesAreCached);
+    prepareForModification();
     return Root.operator->();
   }
 
+  /// \return true if the root is shared with a copy of this tree
+  bool isShared() const { return Root.use_count() > 1; }
+
+  /// \return the number of roots copied so far by the trees of this type
+  static uint64_t getDeepCopiesCount() {
+    return DeepCopies.load(std::memory_order_relaxed);
+  }
+
+  /// Ensure the root is not shared with any copy, keeping the references
+  /// cached if they are.
+  ///
+  /// The reads of a tree are tracked in the tree itself: this must be invoked
+  /// before starting to track them, so that copies do not affect each other.
+  void detach() {
+    if (not isShared())
+      return;
+
+    State = std::make_shared<RootState>();
+    Root = std::make_shared<T>(std::as_const(*Root));
+    DeepCopies.fetch_add(1, std::memory_order_relaxed);
+
+    // The copied references still point to the shared root
+    initializeReferencesImpl();
+    if (AllReferencesAreCached)
+      cacheTargets();
+  }
+
 public:
   bool verify() const debug_function { return verifyReferences(false); }
   void assertValid() const { verifyReferences(true); }
 
 private:
-  void initializeUncachedReferences() {
+  /// Ensure the root can be modified: it must not be shared with any copy
+  /// and no reference can cache its target on behalf of another tree
+  void prepareForModification() {
+    detach();
+    if (State->ReferencesAreCached and not AllReferencesAreCached)
+      evictTargets();
+  }
+
+  bool isBeingTracked() const {
+    if constexpr (requires(const T &Value) { Value.isBeingTracked(); })
+      return Root->isBeingTracked();
+    else
+      return false;
+  }
+
+  void initializeReferencesImpl() {
     DisableTracking Guard(*Root);
-    visitReferences([this](auto &Element) {
-      Element.setRoot(Root.get());
-      Element.evictCachedTarget();
-    });
-    AllReferencesAreCached = false;
+
+    T *RootPointer = Root.get();
+    StructuralGeneration *TreeGeneration = &State->Generation;
+    auto Visitor = [RootPointer, TreeGeneration](auto &Element) {
+      using type = std::remove_cvref_t<decltype(Element)>;
+      if constexpr (StrictSpecializationOf<type, TupleTreeReference>)
+        Element.setRoot(RootPointer, TreeGeneration);
+      else if constexpr (KeyedObjectContainer<type>)
+        Element.attachGeneration(TreeGeneration);
+    };
+    visitInPlace(Visitor, [](auto &) {});
+    State->ReferencesAreCached = false;
+  }
+
+  void cacheTargets() {
+    DisableTracking Guard(*Root);
+    visitReferencesInPlace([](auto &Element) { Element.cacheTarget(); });
+    State->ReferencesAreCached = true;
+  }
+
+  void evictTargets() {
+    DisableTracking Guard(*Root);
+    visitReferencesInPlace([](auto &E) { E.evictCachedTarget(); });
+    State->ReferencesAreCached = false;
   }
 
 public:
+  /// Make the references point to the root and attach the containers to the
+  /// generation of this tree, see revng::StructuralGeneration
   void initializeReferences() {
-    DisableTracking Guard(*Root);
     revng_assert(not AllReferencesAreCached);
-    visitReferences([this](auto &Element) { Element.setRoot(Root.get()); });
+    prepareForModification();
+    initializeReferencesImpl();
   }
 
   void cacheReferences() {
-    DisableTracking Guard(*Root);
-    if (not AllReferencesAreCached)
-      visitReferencesInternal([](auto &Element) { Element.cacheTarget(); });
+    // The root is not copied: it's modified only after a copy evicts the
+    // targets, or copies it, see prepareForModification
+    if (not AllReferencesAreCached and not State->ReferencesAreCached)
+      cacheTargets();
     AllReferencesAreCached = true;
   }
 
   void evictCachedReferences() {
-    DisableTracking Guard(*Root);
-    if (AllReferencesAreCached)
-      visitReferencesInternal([](auto &E) { E.evictCachedTarget(); });
+    // Other trees might still rely on the targets cached in a shared root,
+    // modifying this tree is going to copy it anyway
+    if (AllReferencesAreCached and not isShared())
+      evictTargets();
     AllReferencesAreCached = false;
   }
 
@@ -263,6 +424,17 @@ public:
 
   template<typename Pre, typename Post>
   void visit(Pre PreCallable, Post PostCallable) {
+    if (AllReferencesAreCached)
+      detach();
+    else
+      prepareForModification();
+    visitInPlace(PreCallable, PostCallable);
+  }
+
+private:
+  /// Like visit, but never copies the root
+  template<typename Pre, typename Post>
+  void visitInPlace(Pre PreCallable, Post PostCallable) {
     using PreVisitor = typename TupleTreeVisitor<T>::template Visitor<Pre>;
     PreVisitor PreInstance(PreCallable);
     using PostVisitor = typename TupleTreeVisitor<T>::template Visitor<Post>;
@@ -270,7 +442,6 @@ public:
     visitImpl(PreInstance, PostInstance);
   }
 
-private:
   void visitImpl(typename TupleTreeVisitor<T>::ConstVisitorBase &Pre,
                  typename TupleTreeVisitor<T>::ConstVisitorBase &Post) const;
 
@@ -278,21 +449,22 @@ private:
                  typename TupleTreeVisitor<T>::VisitorBase &Post);
 
   template<typename L>
-  void visitReferencesInternal(L &&InnerVisitor) {
+  void visitReferencesInPlace(L &&InnerVisitor) {
     auto Visitor = [&InnerVisitor](auto &Element) {
       using type = std::remove_cvref_t<decltype(Element)>;
       if constexpr (StrictSpecializationOf<type, TupleTreeReference>)
         std::invoke(std::forward<L>(InnerVisitor), Element);
     };
 
-    visit(Visitor, [](auto &) {});
+    visitInPlace(Visitor, [](auto &) {});
   }
 
 public:
   template<typename L>
   void visitReferences(L &&InnerVisitor) {
     revng_assert(not AllReferencesAreCached);
-    visitReferencesInternal(std::forward<L>(InnerVisitor));
+    prepareForModification();
+    visitReferencesInPlace(std::forward<L>(InnerVisitor));
   }
 
   template<typename L>
@@ -21,6 +21,7 @@
 #include "revng/ADT/ZipMapIterator.h"
 #include "revng/Support/Assert.h"
 #include "revng/TupleTree/DiffError.h"
+#include "revng/TupleTree/Hash.h"
 #include "revng/TupleTree/TupleLikeTraits.h"
 #include "revng/TupleTree/TupleTree.h"
 #include "revng/TupleTree/TupleTreePath.h"
@@ -366,6 +367,11 @@ private:
 
   template<TupleSizeCompatible T>
   void diffImpl(const T &LHS, const T &RHS) {
+    // Skip identical subtrees, as long as their hash is cheap to obtain
+    if constexpr (tupletree::HasCachedHash<T>)
+      if (tupletree::hash(LHS) == tupletree::hash(RHS))
+        return;
+
     diffTuple(LHS, RHS);
   }
 
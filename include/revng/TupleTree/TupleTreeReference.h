@@ -4,7 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
 #include <compare>
+#include <cstdint>
 #include <optional>
 #include <type_traits>
 #include <variant>
@@ -12,6 +14,7 @@
 #include "llvm/ADT/StringRef.h"
 
 #include "revng/ADT/Concepts.h"
+#include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/YAMLTraits.h"
 #include "revng/TupleTree/TupleTreePath.h"
@@ -24,10 +27,59 @@ public:
   using RootVariant = std::variant<RootT *, const RootT *>;
   using TargetVariant = std::variant<T *, const T *>;
 
+private:
+  /// Target resolved by the last lookup of Path, valid as long as no keyed
+  /// object container of the tree has been structurally modified in the
+  /// meantime (see revng::getStructuralGeneration).
+  ///
+  /// Unlike CachedTarget, it's managed automatically. The fields are atomic
+  /// since it's updated by const lookups, which might run concurrently.
+  class ResolutionCache {
+  private:
+    std::atomic<const T *> Target = nullptr;
+    std::atomic<uint64_t> Generation = 0;
+
+  public:
+    ResolutionCache() = default;
+    ResolutionCache(const ResolutionCache &Other) { *this = Other; }
+    ResolutionCache &operator=(const ResolutionCache &Other) {
+      // The target is stored before its generation, load them the other way
+      // around
+      auto OtherGeneration = Other.Generation.load(std::memory_order_acquire);
+      Target.store(Other.Target.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+      Generation.store(OtherGeneration, std::memory_order_release);
+      return *this;
+    }
+
+  public:
+    /// \return true and set \p Result if a valid target has been recorded
+    bool lookup(const T *&Result,
+                const revng::StructuralGeneration *Owner) const {
+      auto Current = revng::getStructuralGeneration(Owner);
+      if (Generation.load(std::memory_order_acquire) != Current)
+        return false;
+
+      Result = Target.load(std::memory_order_relaxed);
+      return true;
+    }
+
+    void record(const T *NewTarget, uint64_t GenerationAtLookup) {
+      Target.store(NewTarget, std::memory_order_relaxed);
+      Generation.store(GenerationAtLookup, std::memory_order_release);
+    }
+
+    void clear() { Generation.store(0, std::memory_order_relaxed); }
+  };
+
 private:
   RootVariant Root = static_cast<RootT *>(nullptr);
   TupleTreePath Path;
   TargetVariant CachedTarget = static_cast<T *>(nullptr);
+  mutable ResolutionCache Resolved;
+
+  /// The generation of the tree Root belongs to, if known
+  const revng::StructuralGeneration *Owner = nullptr;
 
 public:
   TupleTreeReference() = default;
@@ -48,9 +100,11 @@ public:
     return std::visit(GetPtrToConstRoot, Root);
   }
 
-  void setRoot(ConstOrNot<RootT> auto *NewRoot) {
+  void setRoot(ConstOrNot<RootT> auto *NewRoot,
+               const revng::StructuralGeneration *NewOwner = nullptr) {
     evictCachedTarget();
     Root = NewRoot;
+    Owner = NewOwner;
   }
 
 private:
@@ -91,7 +145,50 @@ private:
     return isCached();
   }
 
-  void evictCachedTarget() { CachedTarget = static_cast<T *>(nullptr); }
+  void evictCachedTarget() {
+    CachedTarget = static_cast<T *>(nullptr);
+    Resolved.clear();
+  }
+
+  /// Resolve Path, going through Resolved
+  template<typename RootPointerType>
+  auto *resolve(RootPointerType RootPointer) const {
+    using Pointee = std::remove_pointer_t<RootPointerType>;
+    using ResultType = std::conditional_t<std::is_const_v<Pointee>,
+                                          const T *,
+                                          T *>;
+
+    // Only getByPath records the read of the path: don't skip it while the
+    // reads are being tracked
+    if (isBeingTracked(*RootPointer))
+      return getByPath<T>(Path, *RootPointer);
+
+    const T *Result = nullptr;
+    if (Resolved.lookup(Result, Owner))
+      return const_cast<ResultType>(Result);
+
+    // Get the generation before looking up, in case someone modifies a
+    // container in the meantime
+    uint64_t Generation = revng::getStructuralGeneration(Owner);
+    ResultType Looked = getByPath<T>(Path, *RootPointer);
+
+    // Inserting elements doesn't invalidate the cache, so failures can't be
+    // cached
+    if (Looked != nullptr)
+      Resolved.record(Looked, Generation);
+
+    return Looked;
+  }
+
+  /// \return false only if reads of \p TheRoot are certainly not tracked
+  static bool isBeingTracked(const RootT &TheRoot) {
+    if constexpr (requires { TheRoot.isBeingTracked(); })
+      return TheRoot.isBeingTracked();
+    else if constexpr (requires { RootT::HasTracking; })
+      return RootT::HasTracking;
+    else
+      return false;
+  }
 
 public:
   static TupleTreeReference
@@ -146,8 +243,8 @@ public:
     if (Path.size() == 0)
       return nullptr;
 
-    const auto GetByPathVisitor = [&Path = Path](const auto &RootPointer) {
-      return static_cast<const T *>(getByPath<T>(Path, *RootPointer));
+    const auto GetByPathVisitor = [this](const auto &RootPointer) {
+      return static_cast<const T *>(resolve(RootPointer));
     };
 
     return std::visit(GetByPathVisitor, Root);
@@ -163,7 +260,7 @@ public:
       return nullptr;
 
     if (std::holds_alternative<RootT *>(Root)) {
-      return getByPath<T>(Path, *std::get<RootT *>(Root));
+      return resolve(std::get<RootT *>(Root));
     } else if (std::holds_alternative<const RootT *>(Root)) {
       revng_abort("Called get() with const root, use getConst!");
     } else {
@@ -181,9 +278,9 @@ public:
       return nullptr;
 
     if (std::holds_alternative<const RootT *>(Root)) {
-      return getByPath<T>(Path, *std::get<const RootT *>(Root));
+      return resolve(std::get<const RootT *>(Root));
     } else if (std::holds_alternative<RootT *>(Root)) {
-      return getByPath<T>(Path, *std::get<RootT *>(Root));
+      return resolve(std::get<RootT *>(Root));
     } else {
       revng_abort("Invalid root variant!");
     }
@@ -4,8 +4,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
 #include <cstdint>
 #include <tuple>
+#include <utility>
 
 #include "revng/ADT/KeyedObjectContainer.h"
 #include "revng/ADT/UpcastablePointer.h"
@@ -94,33 +96,55 @@ bool callOnPathSteps(Visitor &, llvm::ArrayRef<TupleTreeKeyWrapper> Path) {
 
 namespace tupletree::detail {
 
-template<TupleSizeCompatible RootT,
-         size_t I = 0,
-         typename KindT,
-         typename Visitor>
+/// \return a table mapping the index of each field of \p T to what
+///         `Make.template operator()<Index>()` returns, typically a function
+///         pointer specialized for that field.
+///
+/// Path steps are then dispatched by looking up the table, rather than by
+/// comparing the step with the fields one by one.
+template<TupleSizeCompatible T, typename EntryType, typename MakerType>
+constexpr auto makeFieldTable(MakerType Make) {
+  constexpr size_t Size = std::tuple_size_v<std::remove_const_t<T>>;
+  return [&]<size_t... Is>(std::index_sequence<Is...>) {
+    return std::array<EntryType, Size>{ Make.template operator()<Is>()... };
+  }(std::make_index_sequence<Size>());
+}
+
+template<TupleSizeCompatible RootT, size_t I, typename KindT, typename Visitor>
+bool tupleElementStep(Visitor &V,
+                      llvm::ArrayRef<TupleTreeKeyWrapper> Path,
+                      KindT Kind) {
+  if constexpr (std::is_same_v<KindT, size_t>)
+    V.template visitTupleElement<RootT, I>();
+  else
+    V.template visitPolymorphicElement<RootT, I>(Kind);
+
+  using next_type = typename std::tuple_element<I, RootT>::type;
+  return callOnPathSteps<next_type>(V, Path.slice(1));
+}
+
+template<TupleSizeCompatible RootT, typename KindT, typename Visitor>
 bool polymorphicTupleImpl(Visitor &V,
                           llvm::ArrayRef<TupleTreeKeyWrapper> Path,
                           KindT Kind) {
-  if constexpr (I < std::tuple_size_v<RootT>) {
-    if (Path[0].get<size_t>() == I) {
-      if constexpr (std::is_same_v<KindT, size_t>)
-        V.template visitTupleElement<RootT, I>();
-      else
-        V.template visitPolymorphicElement<RootT, I>(Kind);
-
-      using next_type = typename std::tuple_element<I, RootT>::type;
-      return callOnPathSteps<next_type>(V, Path.slice(1));
-    } else {
-      return polymorphicTupleImpl<RootT, I + 1>(V, Path, Kind);
-    }
-  }
+  using StepType = bool (*)(Visitor &,
+                            llvm::ArrayRef<TupleTreeKeyWrapper>,
+                            KindT);
+  constexpr auto Make = []<size_t I>() -> StepType {
+    return &tupleElementStep<RootT, I, KindT, Visitor>;
+  };
+  static constexpr auto Table = makeFieldTable<RootT, StepType>(Make);
 
-  return false;
+  auto Index = Path[0].get<size_t>();
+  if (Index >= Table.size())
+    return false;
+
+  return Table[Index](V, Path, Kind);
 }
 
 template<TupleSizeCompatible RootT, typename Visitor>
 bool tupleImpl(Visitor &V, llvm::ArrayRef<TupleTreeKeyWrapper> Path) {
-  return polymorphicTupleImpl<RootT, 0, size_t>(V, Path, 0);
+  return polymorphicTupleImpl<RootT, size_t>(V, Path, 0);
 }
 
 } // namespace tupletree::detail
@@ -189,35 +213,45 @@ bool callOnPathSteps(Visitor &,
 
 namespace tupletree::detail {
 
-template<TupleSizeCompatible RootT,
-         size_t I = 0,
-         typename KindT,
-         typename Visitor>
+template<TupleSizeCompatible RootT, size_t I, typename KindT, typename Visitor>
+bool tupleElementStep(Visitor &V,
+                      llvm::ArrayRef<TupleTreeKeyWrapper> Path,
+                      RootT &M,
+                      KindT Kind) {
+  auto &Element = get<I>(M);
+  if constexpr (std::is_same_v<KindT, size_t>)
+    V.template visitTupleElement<RootT, I>(Element);
+  else
+    V.template visitPolymorphicElement<RootT, I>(Kind, Element);
+
+  using next_type = typename std::tuple_element<I, RootT>::type;
+  return callOnPathSteps<next_type>(V, Path.slice(1), Element);
+}
+
+template<TupleSizeCompatible RootT, typename KindT, typename Visitor>
 bool polymorphicTupleImpl(Visitor &V,
                           llvm::ArrayRef<TupleTreeKeyWrapper> Path,
                           RootT &M,
                           KindT Kind) {
-  if constexpr (I < std::tuple_size_v<RootT>) {
-    if (Path[0].get<size_t>() == I) {
-      auto &Element = get<I>(M);
-      if constexpr (std::is_same_v<KindT, size_t>)
-        V.template visitTupleElement<RootT, I>(Element);
-      else
-        V.template visitPolymorphicElement<RootT, I>(Kind, Element);
-
-      using next_type = typename std::tuple_element<I, RootT>::type;
-      return callOnPathSteps<next_type>(V, Path.slice(1), Element);
-    } else {
-      return polymorphicTupleImpl<RootT, I + 1>(V, Path, M, Kind);
-    }
-  }
+  using StepType = bool (*)(Visitor &,
+                            llvm::ArrayRef<TupleTreeKeyWrapper>,
+                            RootT &,
+                            KindT);
+  constexpr auto Make = []<size_t I>() -> StepType {
+    return &tupleElementStep<RootT, I, KindT, Visitor>;
+  };
+  static constexpr auto Table = makeFieldTable<RootT, StepType>(Make);
 
-  return false;
+  auto Index = Path[0].get<size_t>();
+  if (Index >= Table.size())
+    return false;
+
+  return Table[Index](V, Path, M, Kind);
 }
 
 template<TupleSizeCompatible RootT, typename Visitor>
 bool tupleImpl(Visitor &V, llvm::ArrayRef<TupleTreeKeyWrapper> Path, RootT &M) {
-  return polymorphicTupleImpl<RootT, 0, size_t>(V, Path, M, 0);
+  return polymorphicTupleImpl<RootT, size_t>(V, Path, M, 0);
 }
 
 } // namespace tupletree::detail
@@ -523,7 +557,7 @@ private:
   }
 
 private:
-  template<TraitedTupleLike T, size_t I = 0>
+  template<TraitedTupleLike T>
   static bool visitTuple(llvm::StringRef Current,
                          llvm::StringRef Rest,
                          PathMatcher &Result);
@@ -652,22 +686,28 @@ bool PathMatcher::visitTupleTreeNode(llvm::StringRef Path,
   return Path.empty();
 }
 
-template<TraitedTupleLike T, size_t I>
+template<TraitedTupleLike T>
 bool PathMatcher::visitTuple(llvm::StringRef Current,
                              llvm::StringRef Rest,
                              PathMatcher &Result) {
-  if constexpr (I < std::tuple_size_v<T>) {
-    if (TupleLikeTraits<T>::FieldNames[I] == Current) {
-      Result.Path.push_back(size_t(I));
-      using element = typename std::tuple_element_t<I, T>;
-      return PathMatcher::visitTupleTreeNode<element>(Rest, Result);
-    } else {
-      return visitTuple<T, I + 1>(Current, Rest, Result);
-    }
-  } else {
+  const auto &Names = TupleLikeTraits<T>::FieldNames;
+  auto It = llvm::find(Names, Current);
+  if (It == std::end(Names)) {
     // Not found
     return false;
   }
+
+  using StepType = bool (*)(llvm::StringRef, PathMatcher &);
+  constexpr auto Make = []<size_t I>() -> StepType {
+    using element = typename std::tuple_element_t<I, T>;
+    return &PathMatcher::visitTupleTreeNode<element>;
+  };
+  using tupletree::detail::makeFieldTable;
+  static constexpr auto Table = makeFieldTable<T, StepType>(Make);
+
+  size_t Index = std::distance(std::begin(Names), It);
+  Result.Path.push_back(Index);
+  return Table[Index](Rest, Result);
 }
 
 template<typename T>
@@ -4,6 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+
+#include "llvm/ADT/StringMap.h"
+
 #include "revng/TupleTree/Visits.h"
 
 //
@@ -60,15 +66,66 @@ getByPath(const TupleTreePath &Path, RootT &M) {
 //
 // stringAsPath
 //
+namespace tupletree::detail {
+
+/// The paths most recently parsed by `stringAsPath<T>`.
+///
+/// The same few paths tend to be parsed over and over (e.g., while
+/// deserializing diffs or invalidation metadata), and parsing a path,
+/// keys included, costs much more than copying it.
+///
+/// Thread safe: lookups take a shared lock only.
+template<typename T>
+class ParsedPathsCache {
+private:
+  static constexpr size_t MaxSize = 1 << 16;
+
+private:
+  std::shared_mutex Mutex;
+  llvm::StringMap<TupleTreePath> Paths;
+
+public:
+  static ParsedPathsCache &get() {
+    static ParsedPathsCache Instance;
+    return Instance;
+  }
+
+public:
+  std::optional<TupleTreePath> lookup(llvm::StringRef Path) {
+    std::shared_lock Lock(Mutex);
+    auto It = Paths.find(Path);
+    if (It == Paths.end())
+      return std::nullopt;
+    return It->second;
+  }
+
+  void insert(llvm::StringRef Path, const TupleTreePath &Parsed) {
+    std::unique_lock Lock(Mutex);
+
+    // Start over rather than tracking which entries are still in use
+    if (Paths.size() >= MaxSize)
+      Paths.clear();
+
+    Paths.try_emplace(Path, Parsed);
+  }
+};
+
+} // namespace tupletree::detail
+
 template<typename T>
 std::optional<TupleTreePath> stringAsPath(llvm::StringRef Path) {
   if (Path.empty())
     return std::nullopt;
 
+  auto &Cache = tupletree::detail::ParsedPathsCache<T>::get();
+  if (auto Cached = Cache.lookup(Path))
+    return Cached;
+
   auto Result = PathMatcher::create<T>(Path);
   if (not Result.has_value())
     return std::nullopt;
 
+  Cache.insert(Path, Result->path());
   return Result->path();
 }
 
@@ -6,6 +6,7 @@
 
 #include <optional>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/Support/DOTGraphTraits.h"
 
@@ -109,7 +110,8 @@ public:
   };
 
 private:
-  using NodeValuesMap = std::map<Node *, std::optional<MaterializedValues>>;
+  using NodeValuesMap = llvm::DenseMap<Node *,
+                                       std::optional<MaterializedValues>>;
 
 private:
   llvm::DenseMap<llvm::Value *, Node *> NodeMap;
@@ -117,6 +119,8 @@ private:
 public:
   static DataFlowGraph fromValue(llvm::Value *Root, Limits Limits) {
     DataFlowGraph Result;
+    // One data-flow graph is built for each materialized value
+    Result.allocateNodesInArena();
     Result.setEntryNode(Result.processValue(Root, Limits));
     return Result;
   }
@@ -126,8 +130,7 @@ public:
   // a list of values and a list of read memory areas
   std::optional<MaterializedValues> materialize(Node *N,
                                                 MemoryOracle &MO) const {
-    using Map = std::map<Node *, std::optional<MaterializedValues>>;
-    Map Results;
+    NodeValuesMap Results;
     return materializeImpl(N, MO, Results);
   }
 
@@ -135,8 +138,7 @@ public:
   materializeOne(Node *N,
                  MemoryOracle &MO,
                  const llvm::APInt &InputValue) const {
-    using Map = std::map<Node *, std::optional<MaterializedValues>>;
-    Map Results;
+    NodeValuesMap Results;
 
     // Remember the current oracle range for the node.
     std::optional<ConstantRangeSet> CurrentRange = N->OracleRange;
@@ -168,6 +170,10 @@ private:
   RecursiveCoroutine<std::optional<MaterializedValues>>
   materializeImpl(Node *N, MemoryOracle &MO, NodeValuesMap &Results) const;
 
+  /// Like materializeImpl, but ignoring the results already in \p Results
+  RecursiveCoroutine<std::optional<MaterializedValues>>
+  materializeNode(Node *N, MemoryOracle &MO, NodeValuesMap &Results) const;
+
   /// \param Limits best effort limits for the creation of the data-flow graph.
   ///        In order to reliably enforce these limits, invoke enforceLimits at
   ///        the end.
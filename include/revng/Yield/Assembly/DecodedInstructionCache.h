@@ -0,0 +1,104 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <tuple>
+#include <vector>
+
+#include "llvm/ADT/ArrayRef.h"
+
+#include "revng/Model/DisassemblyConfiguration.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/Yield/Assembly/LLVMDisassemblerInterface.h"
+
+/// Memoizes the instructions decoded (and printed) by
+/// `LLVMDisassemblerInterface`, so that they can be shared across
+/// `DissassemblyHelper`s, including the ones of different runs.
+///
+/// Decoding an instruction only depends on its address, on its bytes and on
+/// the options of the disassembler, not on the rest of the model: an entry is
+/// reused only if all of them still match, therefore there is no need to clear
+/// the cache when the model (or even the binary) changes.
+///
+/// Lookups can be performed from multiple threads.
+class DecodedInstructionCache {
+public:
+  using Disassembled = LLVMDisassemblerInterface::Disassembled;
+
+private:
+  using ImmediateStyle = model::DisassemblyConfigurationImmediateStyle::Values;
+  using Key = std::tuple<MetaAddress, bool, ImmediateStyle>;
+
+  struct Entry {
+    std::vector<uint8_t> Bytes;
+    Disassembled Instruction;
+  };
+
+private:
+  mutable std::shared_mutex Mutex;
+  std::map<Key, Entry> Entries;
+
+public:
+  DecodedInstructionCache() = default;
+  DecodedInstructionCache(const DecodedInstructionCache &) = delete;
+  DecodedInstructionCache &operator=(const DecodedInstructionCache &) = delete;
+
+public:
+  /// \return the instruction decoded at \p Address, if it was decoded from a
+  ///         prefix of \p RawBytes with the same \p Configuration
+  std::optional<Disassembled>
+  find(const MetaAddress &Address,
+       llvm::ArrayRef<uint8_t> RawBytes,
+       const model::DisassemblyConfiguration &Configuration) const {
+    std::shared_lock Lock(Mutex);
+    auto It = Entries.find(makeKey(Address, Configuration));
+    if (It == Entries.end())
+      return std::nullopt;
+
+    llvm::ArrayRef<uint8_t> Bytes = It->second.Bytes;
+    if (RawBytes.size() < Bytes.size())
+      return std::nullopt;
+    if (RawBytes.take_front(Bytes.size()) != Bytes)
+      return std::nullopt;
+
+    return It->second.Instruction;
+  }
+
+  /// Record that decoding \p RawBytes at \p Address produced \p Instruction
+  ///
+  /// \note instructions that failed to decode are not recorded: how many bytes
+  ///       they span depends on how many were available.
+  void insert(const MetaAddress &Address,
+              llvm::ArrayRef<uint8_t> RawBytes,
+              const model::DisassemblyConfiguration &Configuration,
+              const Disassembled &Instruction) {
+    if (not Instruction.Error.empty())
+      return;
+
+    revng_assert(RawBytes.size() >= Instruction.Size);
+    Entry New{ RawBytes.take_front(Instruction.Size).vec(), Instruction };
+
+    std::unique_lock Lock(Mutex);
+    Entries.insert_or_assign(makeKey(Address, Configuration), std::move(New));
+  }
+
+  void clear() {
+    std::unique_lock Lock(Mutex);
+    Entries.clear();
+  }
+
+private:
+  static Key makeKey(const MetaAddress &Address,
+                     const model::DisassemblyConfiguration &Configuration) {
+    return { Address,
+             Configuration.UseATTSyntax(),
+             Configuration.ImmediateStyle() };
+  }
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "revng/Model/DisassemblyConfiguration.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/Yield/Assembly/LLVMDisassemblerInterface.h"
+
+/// Keeps the `LLVMDisassemblerInterface`s which are not in use, so that
+/// setting up the LLVM MC layer is paid once per process (and per thread
+/// disassembling concurrently) instead of once per `DissassemblyHelper`.
+///
+/// An instance is only ever used by the thread which checked it out, hence
+/// the instances themselves need not be thread-safe, while the pool is.
+class DisassemblerPool {
+private:
+  using ImmediateStyle = model::DisassemblyConfigurationImmediateStyle::Values;
+  using Key = std::tuple<MetaAddressType::Values, bool, ImmediateStyle>;
+  using Instance = std::unique_ptr<LLVMDisassemblerInterface>;
+
+public:
+  /// An instance checked out from the pool, returned to it on destruction
+  class Handle {
+  private:
+    DisassemblerPool *Pool = nullptr;
+    Key TheKey;
+    Instance Disassembler;
+
+  public:
+    Handle(DisassemblerPool &Pool, Key TheKey, Instance Disassembler) :
+      Pool(&Pool), TheKey(TheKey), Disassembler(std::move(Disassembler)) {}
+    Handle(const Handle &) = delete;
+    Handle &operator=(const Handle &) = delete;
+    Handle(Handle &&Other) = default;
+    Handle &operator=(Handle &&Other) = delete;
+
+    ~Handle() {
+      if (Disassembler != nullptr)
+        Pool->checkIn(TheKey, std::move(Disassembler));
+    }
+
+  public:
+    LLVMDisassemblerInterface &operator*() const { return *Disassembler; }
+    LLVMDisassemblerInterface *operator->() const {
+      return Disassembler.get();
+    }
+  };
+
+private:
+  std::mutex Mutex;
+  std::map<Key, std::vector<Instance>> Available;
+
+public:
+  static DisassemblerPool &get();
+
+public:
+  /// \return an instance disassembling code of \p AddressType according to
+  ///         \p Configuration, creating it if none is available
+  Handle checkOut(MetaAddressType::Values AddressType,
+                  const model::DisassemblyConfiguration &Configuration);
+
+  /// Drop all the instances which are not in use
+  void clear();
+
+private:
+  void checkIn(const Key &TheKey, Instance Disassembler);
+
+  /// \note only the options affecting the construction of the instance matter
+  static Key makeKey(MetaAddressType::Values AddressType,
+                     const model::DisassemblyConfiguration &Configuration) {
+    return { AddressType,
+             Configuration.UseATTSyntax(),
+             Configuration.ImmediateStyle() };
+  }
+};
@@ -18,6 +18,7 @@ class Function;
 namespace efa {
 class ControlFlowGraph;
 }
+class DecodedInstructionCache;
 class LLVMDisassemblerInterface;
 class RawBinaryView;
 
@@ -25,8 +26,11 @@ class DissassemblyHelper {
 private:
   std::unique_ptr<detail::DissassemblyHelperImpl> Internal;
 
+  /// If not null, consulted before decoding each instruction
+  DecodedInstructionCache *Decoded = nullptr;
+
 public:
-  explicit DissassemblyHelper();
+  explicit DissassemblyHelper(DecodedInstructionCache *Decoded = nullptr);
   ~DissassemblyHelper();
 
   yield::Function disassemble(const model::Function &Function,
@@ -4,11 +4,36 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <string_view>
+#include <unordered_map>
+
 #include "revng/Pipeline/Location.h"
 #include "revng/Yield/CallGraphs/Graph.h"
 
 namespace yield::calls {
 
+/// A call graph indexed by the location of its nodes, so that it can be built
+/// once and then sliced at any node without visiting all of it.
+class IndexedCallGraph {
+private:
+  PreLayoutGraph Graph;
+  std::unordered_map<std::string_view, const PreLayoutNode *> Nodes;
+
+public:
+  explicit IndexedCallGraph(PreLayoutGraph &&Graph);
+  IndexedCallGraph(const IndexedCallGraph &) = delete;
+  IndexedCallGraph &operator=(const IndexedCallGraph &) = delete;
+
+public:
+  const PreLayoutGraph &graph() const { return Graph; }
+
+  /// \return the node at \p Location, or nullptr if there is none
+  const PreLayoutNode *find(std::string_view Location) const {
+    auto Iterator = Nodes.find(Location);
+    return Iterator != Nodes.end() ? Iterator->second : nullptr;
+  }
+};
+
 /// Produces a forwards facing slice of the graph starting from a single node.
 ///
 /// Such a slice guarantees that:
@@ -38,6 +63,9 @@ namespace yield::calls {
 PreLayoutGraph makeCalleeTree(const PreLayoutGraph &Input,
                               std::string_view SlicePointLocation = "");
 
+/// \note: only the nodes reachable from \p SlicePoint are visited.
+PreLayoutGraph makeCalleeTree(const PreLayoutNode &SlicePoint);
+
 /// Produces a backwards facing slice of the graph starting from a single node.
 ///
 /// It is exactly the same as \see makeCalleeTree except it works in
@@ -45,4 +73,7 @@ PreLayoutGraph makeCalleeTree(const PreLayoutGraph &Input,
 PreLayoutGraph makeCallerTree(const PreLayoutGraph &Input,
                               std::string_view SlicePointLocation = "");
 
+/// \note: only the nodes \p SlicePoint is reachable from are visited.
+PreLayoutGraph makeCallerTree(const PreLayoutNode &SlicePoint);
+
 } // namespace yield::calls
@@ -47,6 +47,8 @@ public:
 
     return MaybeResult->at(revng::ranks::BasicBlock);
   }
+
+  const std::string &getLocationString() const { return Location; }
 };
 
 enum class EdgeType {
@@ -17,6 +17,10 @@ namespace yield::cfg {
 
 struct Configuration;
 
+/// Measure the text of all the instructions of \p Function once and for all,
+/// see `yield::Instruction::CachedTextSize`
+void precomputeTextSizes(yield::Function &Function);
+
 void calculateNodeSizes(PreLayoutGraph &Graph,
                         const yield::Function &Function,
                         const model::Binary &Binary,
@@ -0,0 +1,156 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Sequence.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/iterator_range.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Yield/CrossRelations/CrossRelations.h"
+
+namespace yield::crossrelations {
+
+/// A compact, read-only encoding of `CrossRelations` that can be queried in
+/// place, without being parsed, directly from the buffer holding it (possibly
+/// a memory mapped file).
+///
+/// Nodes are the locations of the functions and of the dynamic functions,
+/// sorted, so that they can be looked up by binary search. Edges are call
+/// sites and are stored in compressed sparse row form in both directions:
+/// the callers and the callees of a node are contiguous ranges of edges.
+///
+/// All the integers are 32-bit little endian:
+///
+///     Magic          CrossRelationsIndex::Magic
+///     Version        CrossRelationsIndex::Version
+///     NodeCount
+///     EdgeCount
+///     StringsSize
+///     Nodes          NodeCount offsets in Strings
+///     CallerRanges   NodeCount + 1 offsets in Callers
+///     Callers        EdgeCount (CallSite, Caller) pairs
+///     CalleeRanges   NodeCount + 1 offsets in Callees
+///     Callees        EdgeCount (CallSite, Callee) pairs
+///     Strings        StringsSize bytes of (Size, Size bytes) pairs
+///     Available      NodeCount bytes, 1 for nodes exposed as targets
+///
+/// Call sites are offsets in Strings, callers and callees indexes of nodes.
+class CrossRelationsIndex {
+public:
+  static constexpr llvm::StringLiteral Magic = "RVNGXRI\0";
+  static constexpr uint32_t Version = 1;
+
+  struct Edge {
+    std::string_view CallSite;
+    uint32_t Node = 0;
+  };
+
+private:
+  static constexpr size_t HeaderSize = 8 + 4 * sizeof(uint32_t);
+
+private:
+  llvm::StringRef Buffer;
+  uint32_t NodeCount = 0;
+  uint32_t EdgeCount = 0;
+  uint32_t StringsSize = 0;
+
+public:
+  CrossRelationsIndex() = default;
+
+  /// \note \p Buffer is not copied, it must outlive the index
+  static llvm::Expected<CrossRelationsIndex> fromBuffer(llvm::StringRef Buffer);
+
+  /// Encode \p Relations, exposing all the functions as available
+  static void write(const CrossRelations &Relations, llvm::raw_ostream &OS);
+
+public:
+  bool empty() const { return Buffer.empty(); }
+  llvm::StringRef buffer() const { return Buffer; }
+
+  uint32_t size() const { return NodeCount; }
+
+  std::optional<uint32_t> find(std::string_view Location) const;
+
+  std::string_view location(uint32_t Node) const {
+    return string(at(nodesOffset(), Node));
+  }
+
+  bool isAvailable(uint32_t Node) const {
+    revng_assert(Node < NodeCount);
+    return Buffer[availableOffset() + Node] != 0;
+  }
+
+  /// Write the index with the availability of each node replaced by the
+  /// result of \p IsAvailable
+  template<typename CallableType>
+  void write(llvm::raw_ostream &OS, const CallableType &IsAvailable) const {
+    OS << Buffer.take_front(availableOffset());
+    for (uint32_t Node = 0; Node < NodeCount; ++Node)
+      OS << static_cast<char>(IsAvailable(Node) ? 1 : 0);
+  }
+
+private:
+  size_t nodesOffset() const { return HeaderSize; }
+  size_t callerRangesOffset() const { return nodesOffset() + 4 * NodeCount; }
+  size_t callersOffset() const {
+    return callerRangesOffset() + 4 * (NodeCount + 1);
+  }
+  size_t calleeRangesOffset() const { return callersOffset() + 8 * EdgeCount; }
+  size_t calleesOffset() const {
+    return calleeRangesOffset() + 4 * (NodeCount + 1);
+  }
+  size_t stringsOffset() const { return calleesOffset() + 8 * EdgeCount; }
+  size_t availableOffset() const { return stringsOffset() + StringsSize; }
+  size_t totalSize() const { return availableOffset() + NodeCount; }
+
+  uint32_t at(size_t Offset, uint32_t Index) const {
+    using namespace llvm::support;
+    return endian::read32le(Buffer.data() + Offset + 4 * Index);
+  }
+
+  std::string_view string(uint32_t Offset) const {
+    size_t Start = stringsOffset() + Offset;
+    uint32_t Size = at(Start, 0);
+    return std::string_view(Buffer.data() + Start + 4, Size);
+  }
+
+  auto edges(size_t RangesOffset, size_t EdgesOffset, uint32_t Node) const {
+    revng_assert(Node < NodeCount);
+    auto ToEdge = [this, EdgesOffset](uint32_t Index) {
+      return Edge{ string(at(EdgesOffset, 2 * Index)),
+                   at(EdgesOffset, 2 * Index + 1) };
+    };
+    auto Indexes = llvm::seq(at(RangesOffset, Node),
+                             at(RangesOffset, Node + 1));
+    return llvm::map_range(Indexes, ToEdge);
+  }
+
+  llvm::Error verify() const;
+
+public:
+  auto callers(uint32_t Node) const {
+    return edges(callerRangesOffset(), callersOffset(), Node);
+  }
+
+  auto callees(uint32_t Node) const {
+    return edges(calleeRangesOffset(), calleesOffset(), Node);
+  }
+
+  /// \return the subset of the relations involving \p Node: the node itself
+  ///         with all its callers, and its callees with the call sites in
+  ///         \p Node
+  CrossRelations relationsOf(uint32_t Node) const;
+};
+
+} // namespace yield::crossrelations
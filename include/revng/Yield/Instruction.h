@@ -5,6 +5,7 @@
 //
 
 #include <limits>
+#include <optional>
 #include <string>
 
 #include "revng/ADT/SortedVector.h"
@@ -87,6 +88,27 @@ public:
                          const yield::Function &Function,
                          const model::Binary &Binary);
 
+public:
+  /// The size, in characters, of the text of the parts of an instruction, as
+  /// they are rendered in the nodes of a control-flow graph.
+  struct TextSize {
+    struct Box {
+      size_t Width = 0;
+      size_t Lines = 0;
+    };
+
+    Box Body;
+    Box Comment;
+    size_t CommentFirstLine = 0;
+    Box Error;
+    Box Address;
+  };
+
+  /// Not serialized: it's filled in by `yield::cfg::precomputeTextSizes`
+  /// before the instruction is shared, so that measuring it is not repeated
+  /// each time a control-flow graph is laid out.
+  std::optional<TextSize> CachedTextSize;
+
 public:
   bool verify(model::VerifyHelper &VH) const;
 
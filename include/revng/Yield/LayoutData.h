@@ -0,0 +1,79 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+#include <string_view>
+
+namespace model {
+class Binary;
+}
+
+namespace yield {
+
+class Function;
+
+namespace calls {
+
+class IndexedCallGraph;
+
+} // namespace calls
+
+namespace crossrelations {
+
+class CrossRelations;
+
+} // namespace crossrelations
+
+/// Emit the same graphs as `yield::svg` as bare layouts: instead of the markup
+/// drawing them, only the geometry and a reference to the contents of each
+/// node are emitted, in JSON, for the client to draw on its own.
+///
+/// The result looks like this:
+///
+/// ```json
+///   {
+///     "Version": 1,
+///     "Orientation": "TopToBottom",
+///     "OrthogonalBends": true,
+///     "ViewBox": [-50, -50, 400, 300],
+///     "Nodes": [
+///       { "X": 0, "Y": 0, "W": 200, "H": 100, "Location": "/basic-block/..." }
+///     ],
+///     "Edges": [
+///       { "From": 0, "To": 1, "Type": "taken", "Path": [100, 100, 100, 150] }
+///     ]
+///   }
+/// ```
+///
+/// Coordinates are the same as in the SVG version of the graph: `X` and `Y`
+/// are the top left corner of a node and `Path` is the list of the
+/// coordinates of the points of an edge, to be joined by straight lines if
+/// `OrthogonalBends` is set, or by cubic curves otherwise.
+///
+/// `Location` is the location (see `pipeline::Location`) of what the node
+/// represents, a basic block or a function, and it's empty for artificial
+/// nodes. The contents of the node are what the other artifacts mark with the
+/// same location. Nodes of call graphs also have `"Shallow": true` when they
+/// only refer to a function which is represented by some other node.
+namespace layoutdata {
+
+namespace detail {
+
+using CrossRelations = yield::crossrelations::CrossRelations;
+
+} // namespace detail
+
+std::string controlFlowGraph(const yield::Function &InternalFunction,
+                             const model::Binary &Binary);
+std::string callGraph(const detail::CrossRelations &CrossRelationTree,
+                      const model::Binary &Binary);
+std::string callGraphSlice(std::string_view SlicePoint,
+                           const calls::IndexedCallGraph &CallGraph,
+                           const model::Binary &Binary);
+
+} // namespace layoutdata
+
+} // namespace yield
@@ -0,0 +1,119 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <optional>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Container.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Yield/CrossRelations/CrossRelationsIndex.h"
+
+namespace revng::pipes {
+
+inline constexpr char CrossRelationsIndexMIMEType[] = "application/"
+                                                      "x.cross-relations-index";
+inline constexpr char CrossRelationsIndexName[] = "cross-relations-index";
+
+/// Holds a `CrossRelationsIndex`, exposing one target for each function.
+///
+/// The index is never parsed: when loaded from a file, it's queried directly
+/// from its (memory mapped) content. Extracting a target produces, as YAML,
+/// the subset of the cross relations involving that function (see
+/// `CrossRelationsIndex::relationsOf`), so that answering "who calls X" does
+/// not require loading the relations of the whole binary.
+class CrossRelationsIndexContainer
+  : public pipeline::Container<CrossRelationsIndexContainer> {
+private:
+  using CrossRelationsIndex = yield::crossrelations::CrossRelationsIndex;
+
+private:
+  /// Shared across copies, the index is immutable
+  std::shared_ptr<const llvm::MemoryBuffer> Storage;
+  CrossRelationsIndex Index;
+
+  /// The nodes of the index exposed as targets by this container
+  llvm::BitVector Available;
+
+public:
+  inline static const char ID = 0;
+  inline static const llvm::StringRef MIMEType = CrossRelationsIndexMIMEType;
+  inline static const char *Name = CrossRelationsIndexName;
+
+public:
+  CrossRelationsIndexContainer(llvm::StringRef Name) :
+    pipeline::Container<CrossRelationsIndexContainer>(Name) {}
+
+  CrossRelationsIndexContainer(const CrossRelationsIndexContainer &) = default;
+  CrossRelationsIndexContainer &
+  operator=(const CrossRelationsIndexContainer &) = default;
+
+  CrossRelationsIndexContainer(CrossRelationsIndexContainer &&) = default;
+  CrossRelationsIndexContainer &
+  operator=(CrossRelationsIndexContainer &&) = default;
+
+  ~CrossRelationsIndexContainer() override = default;
+
+public:
+  bool empty() const { return Index.empty(); }
+
+  const CrossRelationsIndex &index() const {
+    revng_assert(not empty());
+    return Index;
+  }
+
+  /// Replace the content of the container with the index of \p Relations
+  void emplace(const yield::crossrelations::CrossRelations &Relations);
+
+public:
+  std::unique_ptr<pipeline::ContainerBase>
+  cloneFiltered(const pipeline::TargetsList &Targets) const override;
+
+  pipeline::TargetsList enumerate() const override;
+
+  bool contains(const pipeline::Target &Target) const override {
+    if (&Target.getKind() != &kinds::CrossRelationsIndex)
+      return false;
+
+    return findNode(Target).has_value();
+  }
+
+  bool remove(const pipeline::TargetsList &Targets) override;
+
+  void clear() override;
+
+  llvm::Error serialize(llvm::raw_ostream &OS) const override;
+
+  llvm::Error deserialize(const llvm::MemoryBuffer &Buffer) override;
+
+  llvm::Error load(const revng::FilePath &Path) override;
+
+  llvm::Error extractOne(llvm::raw_ostream &OS,
+                         const pipeline::Target &Target) const override;
+
+  size_t memoryUsage() const override {
+    return empty() ? 0 : Index.buffer().size();
+  }
+
+  static std::vector<pipeline::Kind *> possibleKinds() {
+    return { &kinds::CrossRelationsIndex };
+  }
+
+protected:
+  void mergeBackImpl(CrossRelationsIndexContainer &&Other) override;
+
+private:
+  llvm::Error setStorage(std::shared_ptr<const llvm::MemoryBuffer> Buffer);
+  std::optional<uint32_t> findNode(const pipeline::Target &Target) const;
+};
+
+} // namespace revng::pipes
@@ -5,6 +5,7 @@
 //
 
 #include <array>
+#include <memory>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -17,12 +18,22 @@
 #include "revng/Pipes/StringMap.h"
 #include "revng/Yield/Pipes/YieldControlFlow.h"
 
+class DecodedInstructionCache;
+
 namespace revng::pipes {
 
 class ProcessAssembly {
 public:
   static constexpr const auto Name = "process-assembly";
 
+private:
+  /// Instructions decoded by the previous runs, shared by the copies of this
+  /// pipe
+  std::shared_ptr<DecodedInstructionCache> Decoded;
+
+public:
+  ProcessAssembly();
+
 public:
   inline std::array<pipeline::ContractGroup, 1> getContract() const {
     using namespace pipeline;
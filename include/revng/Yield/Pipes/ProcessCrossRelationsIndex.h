@@ -0,0 +1,48 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <array>
+
+#include "llvm/Support/Error.h"
+
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Yield/Pipes/CrossRelationsIndexContainer.h"
+#include "revng/Yield/Pipes/ProcessCallGraph.h"
+
+namespace revng::pipes {
+
+class ProcessCrossRelationsIndex {
+public:
+  static constexpr const auto Name = "process-cross-relations-index";
+
+public:
+  inline std::array<pipeline::ContractGroup, 1> getContract() const {
+    using namespace pipeline;
+    return { ContractGroup{ Contract(kinds::BinaryCrossRelations,
+                                     1,
+                                     kinds::CrossRelationsIndex,
+                                     2,
+                                     InputPreservation::Preserve),
+                            Contract(kinds::CFG,
+                                     0,
+                                     kinds::CrossRelationsIndex,
+                                     2,
+                                     InputPreservation::Preserve) } };
+  }
+
+public:
+  void run(pipeline::ExecutionContext &Context,
+           const CFGMap &CFGMap,
+           const CrossRelationsFileContainer &InputFile,
+           CrossRelationsIndexContainer &Output);
+
+  llvm::Error checkPrecondition(const pipeline::Context &Ctx) const {
+    return llvm::Error::success();
+  }
+};
+
+} // namespace revng::pipes
@@ -0,0 +1,64 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+
+#include "revng/Support/MetaAddress.h"
+#include "revng/Yield/Function.h"
+
+namespace revng::pipes {
+
+/// Keeps the `yield::Function`s produced by `ProcessAssembly`, so that the
+/// pipes consuming them in the same process can skip parsing them back from
+/// YAML.
+///
+/// A function is returned only if the YAML it's looked up with is the same it
+/// was recorded with, therefore changes to the container made in any other way
+/// (e.g., loading it from disk) simply result in a miss. The YAML is kept and
+/// compared in full, its hash only speeds up the mismatches.
+///
+/// Only the most recently recorded functions are kept.
+///
+/// All the methods can be called concurrently.
+class ProcessedAssemblyCache {
+private:
+  struct CachedFunction {
+    uint64_t Hash = 0;
+    std::string Serialized;
+    std::shared_ptr<const yield::Function> Function;
+  };
+
+private:
+  static constexpr size_t MaximumSize = 4096;
+
+  std::mutex Mutex;
+  std::map<MetaAddress, CachedFunction> Entries;
+  std::deque<MetaAddress> InsertionOrder;
+
+public:
+  static ProcessedAssemblyCache &get();
+
+public:
+  /// Record that \p Function serializes to \p Serialized
+  void record(std::shared_ptr<const yield::Function> Function,
+              llvm::StringRef Serialized);
+
+  /// \return the function at \p Entry, either recorded with \p Serialized or
+  ///         deserialized from it
+  std::shared_ptr<const yield::Function> load(const MetaAddress &Entry,
+                                              llvm::StringRef Serialized);
+
+  void clear();
+};
+
+} // namespace revng::pipes
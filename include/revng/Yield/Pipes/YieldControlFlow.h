@@ -46,6 +46,17 @@ using FunctionControlFlowStringMap = FunctionStringMap<
   FunctionControlFlowMIMEType,
   FunctionControlFlowExtension>;
 
+inline constexpr char FunctionControlFlowLayoutMIMEType[] = "text/x.json";
+#define NAME "function-control-flow-graph-layout"
+inline constexpr char FunctionControlFlowLayoutName[] = NAME;
+#undef NAME
+inline constexpr char FunctionControlFlowLayoutExtension[] = ".json";
+using FunctionControlFlowLayoutStringMap = FunctionStringMap<
+  &kinds::FunctionControlFlowGraphLayout,
+  FunctionControlFlowLayoutName,
+  FunctionControlFlowLayoutMIMEType,
+  FunctionControlFlowLayoutExtension>;
+
 class YieldControlFlow {
 public:
   static constexpr const auto Name = "yield-cfg";
@@ -69,4 +80,29 @@ public:
   }
 };
 
+/// Like YieldControlFlow, emitting the bare layout of the graphs rather than
+/// SVG, see `yield::layoutdata`
+class YieldControlFlowLayout {
+public:
+  static constexpr const auto Name = "yield-cfg-layout";
+
+public:
+  inline std::array<pipeline::ContractGroup, 1> getContract() const {
+    return { pipeline::ContractGroup(kinds::FunctionAssemblyInternal,
+                                     0,
+                                     kinds::FunctionControlFlowGraphLayout,
+                                     1,
+                                     pipeline::InputPreservation::Preserve) };
+  }
+
+public:
+  void run(pipeline::ExecutionContext &Context,
+           const FunctionAssemblyStringMap &Input,
+           FunctionControlFlowLayoutStringMap &Output);
+
+  llvm::Error checkPrecondition(const pipeline::Context &Ctx) const {
+    return llvm::Error::success();
+  }
+};
+
 } // namespace revng::pipes
@@ -21,6 +21,12 @@ namespace yield {
 
 class Function;
 
+namespace calls {
+
+class IndexedCallGraph;
+
+} // namespace calls
+
 namespace crossrelations {
 
 class CrossRelations;
@@ -46,6 +52,13 @@ std::string callGraphSlice(const ::ptml::PTMLBuilder &B,
                            const detail::CrossRelations &CrossRelationTree,
                            const model::Binary &Binary);
 
+/// \note prefer this when rendering multiple slices of the same call graph,
+///       since the graph is only built once
+std::string callGraphSlice(const ::ptml::PTMLBuilder &B,
+                           std::string_view SlicePoint,
+                           const calls::IndexedCallGraph &CallGraph,
+                           const model::Binary &Binary);
+
 } // namespace svg
 
 } // namespace yield
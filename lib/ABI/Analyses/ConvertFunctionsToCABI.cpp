@@ -239,6 +239,7 @@ public:
     using abi::FunctionType::filterTypes;
     using RawFD = model::RawFunctionDefinition;
     auto ToConvert = filterTypes<RawFD>(Model->TypeDefinitions());
+    abi::FunctionType::TypeReplacements Replacements;
     for (model::RawFunctionDefinition *Old : ToConvert) {
       auto &DT = llvm::cast<model::DefinedType>(*Model->makeType(Old->key()));
       if (!checkVectorRegisterSupport(VectorVH, *Old)) {
@@ -266,7 +267,11 @@ public:
       }
 
       namespace FT = abi::FunctionType;
-      if (auto New = FT::tryConvertToCABI(*Old, Model, ABI, SoftDeductions)) {
+      if (auto New = FT::tryConvertToCABI(*Old,
+                                          Model,
+                                          Replacements,
+                                          ABI,
+                                          SoftDeductions)) {
         // If the conversion succeeds, make sure the returned type is valid,
         revng_assert(!New->isEmpty());
 
@@ -285,6 +290,10 @@ public:
       }
     }
 
+    // Replace all the converted prototypes at once: doing it one by one
+    // visits the whole model for each of them.
+    abi::FunctionType::applyTypeReplacements(Replacements, Model);
+
     // Don't forget to clean up any possible remainders of removed types.
     purgeUnnamedAndUnreachableTypes(Model);
   }
@@ -28,12 +28,18 @@ public:
     using abi::FunctionType::filterTypes;
     using CABIFD = model::CABIFunctionDefinition;
     auto ToConvert = filterTypes<CABIFD>(Model->TypeDefinitions());
+    abi::FunctionType::TypeReplacements Replacements;
     for (model::CABIFunctionDefinition *Old : ToConvert) {
-      model::UpcastableType New = abi::FunctionType::convertToRaw(*Old, Model);
+      using abi::FunctionType::convertToRaw;
+      model::UpcastableType New = convertToRaw(*Old, Model, Replacements);
       revng_assert(!New.isEmpty());
       revng_assert(New->verify(VH));
     }
 
+    // Replace all the converted prototypes at once: doing it one by one
+    // visits the whole model for each of them.
+    abi::FunctionType::applyTypeReplacements(Replacements, Model);
+
     // Don't forget to clean up any possible remainders of removed types.
     purgeUnnamedAndUnreachableTypes(Model);
   }
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <mutex>
 #include <span>
 #include <unordered_map>
 
@@ -103,57 +104,53 @@ bool Definition::verify() const {
   return true;
 }
 
+void Definition::buildLookupTables() {
+  LookupTables Result;
+
+  for (model::Register::Values Register : GeneralPurposeArgumentRegisters())
+    Result.ArgumentRegisters.set(Register);
+  for (model::Register::Values Register : VectorArgumentRegisters())
+    Result.ArgumentRegisters.set(Register);
+
+  for (model::Register::Values Register : GeneralPurposeReturnValueRegisters())
+    Result.ReturnValueRegisters.set(Register);
+  for (model::Register::Values Register : VectorReturnValueRegisters())
+    Result.ReturnValueRegisters.set(Register);
+
+  for (model::Register::Values Register : CalleeSavedRegisters())
+    Result.CalleeSavedRegisters.set(Register);
+
+  for (const abi::ScalarType &Scalar : ScalarTypes())
+    if (Scalar.Size() <= MaximumTabulatedScalarSize)
+      Result.ScalarAlignments[Scalar.Size()] = Scalar.alignedAt();
+
+  for (const abi::ScalarType &Scalar : FloatingPointScalarTypes())
+    if (Scalar.Size() <= MaximumTabulatedScalarSize)
+      Result.FloatingPointScalarAlignments[Scalar.Size()] = Scalar.alignedAt();
+
+  Tables = Result;
+}
+
 using RFT = model::RawFunctionDefinition;
 bool Definition::isPreliminarilyCompatibleWith(const RFT &Function) const {
   revng_assert(verify());
   const auto Architecture = model::ABI::getRegisterArchitecture(ABI());
 
-  SortedVector<model::Register::Values> Arguments;
-  for (auto I = Arguments.batch_insert(); auto R : Function.Arguments()) {
-    if (!model::Register::isUsedInArchitecture(R.Location(), Architecture))
+  for (const model::NamedTypedRegister &Argument : Function.Arguments()) {
+    if (!model::Register::isUsedInArchitecture(Argument.Location(),
+                                               Architecture))
       return false;
 
-    I.emplace(R.Location());
-  }
-
-  SortedVector<model::Register::Values> AllowedArguments;
-  {
-    auto I = AllowedArguments.batch_insert_or_assign();
-    for (model::Register::Values R : GeneralPurposeArgumentRegisters())
-      I.emplace_or_assign(R);
-    for (model::Register::Values R : VectorArgumentRegisters())
-      I.emplace_or_assign(R);
-  }
-
-  if (!std::includes(AllowedArguments.begin(),
-                     AllowedArguments.end(),
-                     Arguments.begin(),
-                     Arguments.end())) {
-    return false;
-  }
-
-  SortedVector<model::Register::Values> ReturnValues;
-  for (auto I = ReturnValues.batch_insert(); auto R : Function.ReturnValues()) {
-    if (!model::Register::isUsedInArchitecture(R.Location(), Architecture))
+    if (!isArgumentRegister(Argument.Location()))
       return false;
-
-    I.emplace(R.Location());
   }
 
-  SortedVector<model::Register::Values> AllowedReturnValues;
-  {
-    auto I = AllowedReturnValues.batch_insert_or_assign();
-    for (model::Register::Values R : GeneralPurposeReturnValueRegisters())
-      I.emplace_or_assign(R);
-    for (model::Register::Values R : VectorReturnValueRegisters())
-      I.emplace_or_assign(R);
-  }
+  for (const model::NamedTypedRegister &Value : Function.ReturnValues()) {
+    if (!model::Register::isUsedInArchitecture(Value.Location(), Architecture))
+      return false;
 
-  if (!std::includes(AllowedReturnValues.begin(),
-                     AllowedReturnValues.end(),
-                     ReturnValues.begin(),
-                     ReturnValues.end())) {
-    return false;
+    if (!isReturnValueRegister(Value.Location()))
+      return false;
   }
 
   for (model::Register::Values Register : Function.PreservedRegisters())
@@ -167,10 +164,14 @@ static std::string translateABIName(model::ABI::Values ABI) {
   return "share/revng/abi/" + model::ABI::getName(ABI).str() + ".yml";
 }
 
+// Shared by all the projects in the process: the entries are never modified
+// once inserted and, the map being node-based, references to them stay valid.
+static std::mutex DefinitionCacheLock;
 static std::unordered_map<model::ABI::Values, Definition> DefinitionCache;
 const Definition &Definition::get(model::ABI::Values ABI) {
   revng_assert(ABI != model::ABI::Invalid);
 
+  std::lock_guard Guard(DefinitionCacheLock);
   auto CacheIterator = DefinitionCache.find(ABI);
   if (CacheIterator != DefinitionCache.end()) {
     // This ABI was already loaded, grab it from the cache.
@@ -199,6 +200,7 @@ const Definition &Definition::get(model::ABI::Values ABI) {
 
   auto [It, Success] = DefinitionCache.try_emplace(ABI, std::move(**Parsed));
   revng_assert(Success);
+  It->second.buildLookupTables();
   return It->second;
 }
 
@@ -323,8 +325,9 @@ naturalAlignment(const abi::Definition &ABI,
 
   } else if (const auto *P = llvm::dyn_cast<model::PointerType>(&Type)) {
     // Doesn't matter what the type is, use alignment of the pointer.
-    rc_return AlignmentInfo{ ABI.ScalarTypes().at(P->PointerSize()).alignedAt(),
-                             true };
+    auto Alignment = ABI.scalarAlignment(P->PointerSize());
+    revng_assert(Alignment.has_value());
+    rc_return AlignmentInfo{ *Alignment, true };
 
   } else if (const auto *P = llvm::dyn_cast<model::PrimitiveType>(&Type)) {
     // The alignment of primitives is easy to figure out based on the abi.
@@ -334,17 +337,17 @@ naturalAlignment(const abi::Definition &ABI,
 
       rc_return AlignmentInfo{ 0, false };
     } else if (P->PrimitiveKind() == model::PrimitiveKind::Float) {
-      auto Iterator = ABI.FloatingPointScalarTypes().find(P->Size());
-      if (Iterator == ABI.FloatingPointScalarTypes().end())
+      auto Alignment = ABI.floatingPointScalarAlignment(P->Size());
+      if (not Alignment.has_value())
         rc_return std::nullopt;
 
-      rc_return AlignmentInfo{ Iterator->alignedAt(), true };
+      rc_return AlignmentInfo{ *Alignment, true };
     } else {
-      auto Iterator = ABI.ScalarTypes().find(P->Size());
-      if (Iterator == ABI.ScalarTypes().end())
+      auto Alignment = ABI.scalarAlignment(P->Size());
+      if (not Alignment.has_value())
         rc_return std::nullopt;
 
-      rc_return AlignmentInfo{ Iterator->alignedAt(), true };
+      rc_return AlignmentInfo{ *Alignment, true };
     }
   } else {
     revng_abort("Unsupported type.");
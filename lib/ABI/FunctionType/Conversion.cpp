@@ -139,6 +139,7 @@ private:
 std::optional<model::UpcastableType>
 tryConvertToCABI(const model::RawFunctionDefinition &FunctionType,
                  TupleTree<model::Binary> &Binary,
+                 TypeReplacements &Replacements,
                  std::optional<model::ABI::Values> MaybeABI,
                  bool UseSoftRegisterStateDeductions) {
   if (!MaybeABI.has_value())
@@ -196,16 +197,34 @@ tryConvertToCABI(const model::RawFunctionDefinition &FunctionType,
     }
   }
 
-  // To finish up the conversion, remove all the references to the old type by
-  // carefully replacing them with references to the new one.
-  replaceTypeDefinition(FunctionType.key(), *Type, Binary);
-
-  // And don't forget to remove the old type.
-  Binary->TypeDefinitions().erase(FunctionType.key());
+  // Record that all the references to the old type have to be replaced with
+  // references to the new one.
+  const auto &NewDefinition = llvm::cast<model::DefinedType>(*Type);
+  Replacements.emplace(FunctionType.key(), NewDefinition.Definition());
 
   return std::move(Type);
 }
 
+std::optional<model::UpcastableType>
+tryConvertToCABI(const model::RawFunctionDefinition &FunctionType,
+                 TupleTree<model::Binary> &Binary,
+                 std::optional<model::ABI::Values> MaybeABI,
+                 bool UseSoftRegisterStateDeductions) {
+  TypeReplacements Replacements;
+  auto Result = tryConvertToCABI(FunctionType,
+                                 Binary,
+                                 Replacements,
+                                 MaybeABI,
+                                 UseSoftRegisterStateDeductions);
+
+  // To finish up the conversion, remove all the references to the old type by
+  // carefully replacing them with references to the new one, and remove the
+  // old type.
+  applyTypeReplacements(Replacements, Binary);
+
+  return Result;
+}
+
 using TCC = ToCABIConverter;
 std::optional<llvm::SmallVector<model::Argument, 8>>
 TCC::tryConvertingRegisterArguments(RFTArguments Registers) {
@@ -615,7 +634,7 @@ TCC::tryConvertingReturnValue(RFTReturnValues Registers) {
       //       into preserving it at least partially.
       uint64_t PointerSize = model::ABI::getPointerSize(ABI.ABI());
       uint64_t PrimitiveSize = Ordered.size() * PointerSize;
-      if (llvm::is_contained(ABI.ScalarTypes(), PrimitiveSize)) {
+      if (ABI.scalarAlignment(PrimitiveSize).has_value()) {
         return model::PrimitiveType::makeGeneric(PrimitiveSize);
       } else {
         revng_log(Log,
@@ -38,9 +38,12 @@ public:
 
 public:
   /// Entry point for the `toRaw` conversion.
+  ///
+  /// The replacement of \p FunctionType is recorded into \p Replacements.
   model::UpcastableType
   convert(const model::CABIFunctionDefinition &FunctionType,
-          TupleTree<model::Binary> &Binary) const;
+          TupleTree<model::Binary> &Binary,
+          TypeReplacements &Replacements) const;
 
   /// Helper used for deciding how an arbitrary return type should be
   /// distributed across registers and the stack accordingly to the \ref ABI.
@@ -74,7 +77,8 @@ public:
 
 model::UpcastableType
 ToRawConverter::convert(const model::CABIFunctionDefinition &FunctionType,
-                        TupleTree<model::Binary> &Binary) const {
+                        TupleTree<model::Binary> &Binary,
+                        TypeReplacements &Replacements) const {
   revng_log(Log,
             "Converting a `CABIFunctionDefinition` to "
             "`RawFunctionDefinition`.");
@@ -301,12 +305,10 @@ ToRawConverter::convert(const model::CABIFunctionDefinition &FunctionType,
 
   revng_log(Log, "Conversion successful:\n" << serializeToString(NewPrototype));
 
-  // To finish up the conversion, remove all the references to the old type
-  // by carefully replacing them with references to the new one.
-  replaceTypeDefinition(FunctionType.key(), *NewType, Binary);
-
-  // And don't forget to remove the old type.
-  Binary->TypeDefinitions().erase(FunctionType.key());
+  // Record that all the references to the old type have to be replaced with
+  // references to the new one.
+  const auto &NewDefinition = llvm::cast<model::DefinedType>(*NewType);
+  Replacements.emplace(FunctionType.key(), NewDefinition.Definition());
 
   return std::move(NewType);
 }
@@ -364,9 +366,24 @@ ToRawConverter::distributeArguments(CFTArguments Arguments,
 
 model::UpcastableType
 convertToRaw(const model::CABIFunctionDefinition &FunctionType,
-             TupleTree<model::Binary> &Binary) {
+             TupleTree<model::Binary> &Binary,
+             TypeReplacements &Replacements) {
   ToRawConverter ToRaw(abi::Definition::get(FunctionType.ABI()));
-  return ToRaw.convert(FunctionType, Binary);
+  return ToRaw.convert(FunctionType, Binary, Replacements);
+}
+
+model::UpcastableType
+convertToRaw(const model::CABIFunctionDefinition &FunctionType,
+             TupleTree<model::Binary> &Binary) {
+  TypeReplacements Replacements;
+  auto Result = convertToRaw(FunctionType, Binary, Replacements);
+
+  // To finish up the conversion, remove all the references to the old type by
+  // carefully replacing them with references to the new one, and remove the
+  // old type.
+  applyTypeReplacements(Replacements, Binary);
+
+  return Result;
 }
 
 Layout::Layout(const model::CABIFunctionDefinition &Function) {
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <concepts>
 #include <span>
 
 #include "llvm/ADT/ArrayRef.h"
@@ -36,7 +37,7 @@ struct DeductionImpl {
     ABI(ABI), ABIName(model::ABI::getName(ABI.ABI())) {}
 
   std::optional<Def::RegisterSet> arguments(Def::RegisterSet Arguments) {
-    if (!ensureRegistersAreAllowed(Arguments, allowedArgumentRegisters()))
+    if (!ensureRegistersAreAllowed(Arguments, isAllowedArgument()))
       return std::nullopt;
 
     if (ABI.ArgumentsArePositionBased()) {
@@ -52,7 +53,7 @@ struct DeductionImpl {
   }
 
   std::optional<Def::RegisterSet> returnValues(Def::RegisterSet ReturnValues) {
-    if (!ensureRegistersAreAllowed(ReturnValues, allowedReturnValueRegisters()))
+    if (!ensureRegistersAreAllowed(ReturnValues, isAllowedReturnValue()))
       return std::nullopt;
 
     if (deduceReturnValues(ReturnValues))
@@ -63,22 +64,24 @@ struct DeductionImpl {
 
 private:
   using CRegister = const model::Register::Values;
-  auto allowedArgumentRegisters() const {
-    return llvm::concat<CRegister>(ABI.GeneralPurposeArgumentRegisters(),
-                                   ABI.VectorArgumentRegisters());
+  auto isAllowedArgument() const {
+    return [this](model::Register::Values Register) {
+      return ABI.isArgumentRegister(Register);
+    };
   }
-  auto allowedReturnValueRegisters() const {
-    return llvm::concat<CRegister>(ABI.GeneralPurposeReturnValueRegisters(),
-                                   ABI.VectorReturnValueRegisters());
+  auto isAllowedReturnValue() const {
+    return [this](model::Register::Values Register) {
+      return ABI.isReturnValueRegister(Register);
+    };
   }
 
-  template<range_with_value_type<CRegister> Registers>
+  template<std::predicate<model::Register::Values> Predicate>
   bool ensureRegistersAreAllowed(Def::RegisterSet &UsedSet,
-                                 Registers &&AllowedRegisters) const {
+                                 const Predicate &IsAllowed) const {
     if constexpr (EnforceABIConformance == true) {
       size_t CountBefore = UsedSet.size();
       std::erase_if(UsedSet, [&](model::Register::Values Register) {
-        return !llvm::is_contained(AllowedRegisters, Register);
+        return !IsAllowed(Register);
       });
       if (size_t RemovedCount = UsedSet.size() != CountBefore)
         revng_log(Log,
@@ -88,7 +91,7 @@ private:
 
     } else {
       for (model::Register::Values Register : UsedSet) {
-        if (!llvm::is_contained(AllowedRegisters, Register)) {
+        if (!IsAllowed(Register)) {
           revng_log(Log,
                     "Aborting, `model::Register::"
                       << model::Register::getName(Register).data()
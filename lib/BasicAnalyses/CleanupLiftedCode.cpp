@@ -0,0 +1,140 @@
+/// \file CleanupLiftedCode.cpp
+/// Perform several cleanups of the lifted code in a single walk over the
+/// instructions of a function.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Metadata.h"
+
+#include "revng/BasicAnalyses/CleanupLiftedCode.h"
+#include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/Support/OpaqueFunctionsPool.h"
+
+class OpaqueRegisterUser {
+private:
+  llvm::Module *M;
+  OpaqueFunctionsPool<std::string> Clobberers;
+
+public:
+  OpaqueRegisterUser(llvm::Module *M) : M(M), Clobberers(M, false) {
+    using namespace llvm;
+    Clobberers.setMemoryEffects(MemoryEffects::readOnly());
+    Clobberers.addFnAttribute(Attribute::NoUnwind);
+    Clobberers.addFnAttribute(Attribute::WillReturn);
+    Clobberers.setTags({ &FunctionTags::ClobbererFunction });
+    Clobberers.initializeFromName(FunctionTags::ClobbererFunction);
+  }
+
+public:
+  llvm::StoreInst *clobber(llvm::IRBuilder<> &Builder,
+                           llvm::GlobalVariable *CSV) {
+    auto *CSVTy = CSV->getValueType();
+    std::string Name = "clobber_" + CSV->getName().str();
+    llvm::Function *Clobberer = Clobberers.get(Name, CSVTy, {}, Name);
+    return Builder.CreateStore(Builder.CreateCall(Clobberer), CSV);
+  }
+
+  llvm::StoreInst *clobber(llvm::IRBuilder<> &Builder,
+                           model::Register::Values Value) {
+    return clobber(Builder,
+                   M->getGlobalVariable(model::Register::getCSVName(Value)));
+  }
+};
+
+static void replaceHelperCalls(llvm::Function &F,
+                               llvm::ArrayRef<llvm::Instruction *> ToReplace,
+                               GeneratedCodeBasicInfo &GCBI) {
+  using namespace llvm;
+
+  OpaqueRegisterUser Clobberer(F.getParent());
+  OpaqueFunctionsPool<Type *> OFPOriginalHelper(F.getParent(), false);
+  OFPOriginalHelper.setMemoryEffects(MemoryEffects::readOnly());
+  OFPOriginalHelper.addFnAttribute(Attribute::NoUnwind);
+  OFPOriginalHelper.addFnAttribute(Attribute::WillReturn);
+  OFPOriginalHelper.setTags({ &FunctionTags::UniquedByPrototype });
+
+  IRBuilder<> Builder(F.getContext());
+  for (auto *I : ToReplace) {
+    Builder.SetInsertPoint(I);
+
+    // Assumption: helpers do not leave the stack altered, thus we can save the
+    // stack pointer and restore it back later.
+    auto *SP = createLoad(Builder, GCBI.spReg());
+
+    auto *RetTy = cast<CallInst>(I)->getFunctionType()->getReturnType();
+    auto *OriginalHelperMarker = OFPOriginalHelper.get(RetTy,
+                                                       RetTy,
+                                                       {},
+                                                       "original_helper");
+
+    // Create opaque helper for the original helper and taint the registers
+    // originally clobbered.
+    CallInst *NewHelper = Builder.CreateCall(OriginalHelperMarker);
+
+    for (auto *CSV : getCSVUsedByHelperCall(I).Written)
+      Clobberer.clobber(Builder, CSV);
+
+    // Restore stack pointer back.
+    Builder.CreateStore(SP, GCBI.spReg());
+
+    I->replaceAllUsesWith(NewHelper);
+    I->eraseFromParent();
+  }
+}
+
+bool cleanupLiftedCode(llvm::Function &F,
+                       const CleanupLiftedCodeOptions &Options,
+                       GeneratedCodeBasicInfo *GCBI) {
+  using namespace llvm;
+
+  bool Changed = false;
+  if (Options.RemoveDbgMetadata) {
+    F.setMetadata(LLVMContext::MD_dbg, nullptr);
+    Changed = true;
+  }
+
+  // Debug locations are dropped during the walk, before the replacements of
+  // the helper calls are created, so that they don't inherit them
+  SmallVector<Instruction *, 16> NewPCCalls;
+  SmallVector<Instruction *, 16> HelperCalls;
+  for (BasicBlock &BB : F) {
+    for (Instruction &I : BB) {
+      if (Options.RemoveDbgMetadata)
+        I.setMetadata(LLVMContext::MD_dbg, nullptr);
+
+      if (Options.RemoveNewPCCalls and isCallTo(&I, "newpc"))
+        NewPCCalls.push_back(&I);
+      else if (Options.RemoveHelperCalls and isCallToHelper(&I))
+        HelperCalls.push_back(&I);
+    }
+  }
+
+  for (Instruction *I : NewPCCalls)
+    I->eraseFromParent();
+
+  if (not HelperCalls.empty()) {
+    revng_assert(GCBI != nullptr);
+    replaceHelperCalls(F, HelperCalls, *GCBI);
+  }
+
+  return Changed or not NewPCCalls.empty() or not HelperCalls.empty();
+}
+
+llvm::PreservedAnalyses
+CleanupLiftedCodePass::run(llvm::Function &F,
+                           llvm::FunctionAnalysisManager &FAM) {
+  GeneratedCodeBasicInfo *GCBI = nullptr;
+  if (Options.RemoveHelperCalls)
+    GCBI = &FAM.getResult<GeneratedCodeBasicInfoAnalysis>(F);
+
+  if (not cleanupLiftedCode(F, Options, GCBI))
+    return llvm::PreservedAnalyses::all();
+
+  return llvm::PreservedAnalyses::none();
+}
@@ -28,6 +28,13 @@ char GeneratedCodeBasicInfoWrapperPass::ID = 0;
 using RegisterGCBI = RegisterPass<GeneratedCodeBasicInfoWrapperPass>;
 static RegisterGCBI X("gcbi", "Generated Code Basic Info", true, true);
 
+char GeneratedCodeBasicInfoCache::ID = 0;
+using RegisterGCBICache = RegisterPass<GeneratedCodeBasicInfoCache>;
+static RegisterGCBICache Y("gcbi-cache",
+                           "Generated Code Basic Info Cache",
+                           true,
+                           true);
+
 void GeneratedCodeBasicInfo::run(Module &M) {
   RootFunction = M.getFunction("root");
   NewPC = M.getFunction("newpc");
@@ -54,6 +61,17 @@ void GeneratedCodeBasicInfo::run(Module &M) {
   for (GlobalVariable &CSV : FunctionTags::CSV.globals(&M))
     CSVs.push_back(&CSV);
 
+  for (Value *V : { static_cast<Value *>(RootFunction),
+                    static_cast<Value *>(NewPC),
+                    static_cast<Value *>(PC),
+                    static_cast<Value *>(SP),
+                    static_cast<Value *>(RA) })
+    track(V);
+  for (GlobalVariable *CSV : ABIRegisters)
+    track(CSV);
+  for (GlobalVariable *CSV : CSVs)
+    track(CSV);
+
   revng_log(PassesLog, "Ending GeneratedCodeBasicInfo");
 }
 
@@ -104,6 +122,11 @@ void GeneratedCodeBasicInfo::parseRoot() {
       }
     }
   }
+
+  for (BasicBlock *BB : { Dispatcher, DispatcherFail, AnyPC, UnexpectedPC })
+    track(BB);
+  for (const auto &[Address, BB] : JumpTargets)
+    track(BB);
 }
 
 SmallVector<std::pair<BasicBlock *, bool>, 4>
@@ -172,13 +195,59 @@ GeneratedCodeBasicInfoAnalysis::run(Function &F, FunctionAnalysisManager &FAM) {
   return GCBI;
 }
 
+using GCBICache = GeneratedCodeBasicInfoCache;
+
+GCBICache::Key GCBICache::Key::compute(Module &M,
+                                        const model::Binary &Binary) {
+  using namespace model::Architecture;
+  auto PCName = getPCCSVName(Binary.Architecture());
+
+  Key Result;
+  Result.M = &M;
+  Result.Binary = &Binary;
+  Result.Root = M.getFunction("root");
+  Result.NewPC = M.getFunction("newpc");
+  Result.PC = M.getGlobalVariable(PCName, true);
+  for (GlobalVariable &CSV : FunctionTags::CSV.globals(&M)) {
+    (void) CSV;
+    ++Result.CSVsCount;
+  }
+  return Result;
+}
+
+bool GCBICache::Key::operator==(const Key &Other) const {
+  // Value handles are cleared when their value is deleted, so that a new value
+  // allocated at the same address does not compare equal
+  return M == Other.M and Binary == Other.Binary
+         and static_cast<Value *>(Root) == static_cast<Value *>(Other.Root)
+         and static_cast<Value *>(NewPC) == static_cast<Value *>(Other.NewPC)
+         and static_cast<Value *>(PC) == static_cast<Value *>(Other.PC)
+         and CSVsCount == Other.CSVsCount;
+}
+
+GeneratedCodeBasicInfo &GCBICache::get(Module &M,
+                                       const model::Binary &Binary) {
+  Key Current = Key::compute(M, Binary);
+  if (GCBI != nullptr and CachedKey == Current
+      and not GCBI->referencesChangedValues()) {
+    revng_log(PassesLog, "Reusing GeneratedCodeBasicInfo");
+    return *GCBI;
+  }
+
+  GCBI.reset(new GeneratedCodeBasicInfo(Binary));
+  GCBI->run(M);
+  CachedKey = std::move(Current);
+  return *GCBI;
+}
+
 bool GeneratedCodeBasicInfoWrapperPass::runOnModule(Module &M) {
   auto &LMA = getAnalysis<LoadModelWrapperPass>().get();
-  GCBI.reset(new GeneratedCodeBasicInfo(*LMA.getReadOnlyModel()));
-  GCBI->run(M);
+  Cache = &getAnalysis<GeneratedCodeBasicInfoCache>();
+  GCBI = &Cache->get(M, *LMA.getReadOnlyModel());
   return false;
 }
 
 void GeneratedCodeBasicInfoWrapperPass::releaseMemory() {
-  GCBI.reset();
+  // The cache outlives this pass, do not drop it
+  GCBI = nullptr;
 }
@@ -6,9 +6,8 @@
 //
 
 #include "llvm/IR/Function.h"
-#include "llvm/IR/Instructions.h"
-#include "llvm/IR/Metadata.h"
 
+#include "revng/BasicAnalyses/CleanupLiftedCode.h"
 #include "revng/BasicAnalyses/RemoveDbgMetadata.h"
 #include "revng/Support/FunctionTags.h"
 
@@ -23,10 +22,5 @@ bool RemoveDbgMetadata::runOnFunction(llvm::Function &F) {
   if (not FunctionTags::Isolated.isTagOf(&F))
     return false;
 
-  F.setMetadata(LLVMContext::MD_dbg, nullptr);
-  for (BasicBlock &BB : F)
-    for (Instruction &I : BB)
-      I.setMetadata(LLVMContext::MD_dbg, nullptr);
-
-  return true;
+  return cleanupLiftedCode(F, { .RemoveDbgMetadata = true }, nullptr);
 }
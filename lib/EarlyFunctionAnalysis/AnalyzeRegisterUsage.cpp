@@ -232,7 +232,8 @@ RUAResults analyzeRegisterUsage(Function *F,
                                 model::Architecture::Values Architecture,
                                 Function *PreCallSiteHook,
                                 Function *PostCallSiteHook,
-                                Function *RetHook) {
+                                Function *RetHook,
+                                size_t *MFPIterations) {
   RUAResults FinalResults;
 
   // TODO: can we avoid recreating this each time?
@@ -266,7 +267,8 @@ RUAResults analyzeRegisterUsage(Function *F,
                                                     &Function.Function,
                                                     Liveness.defaultValue(),
                                                     Liveness.defaultValue(),
-                                                    { Function.ReturnNode });
+                                                    { Function.ReturnNode },
+                                                    MFPIterations);
 
     // Collect registers alive at the entry
     revng_log(Log, "Registers alive at the entry of the function:");
@@ -308,7 +310,8 @@ RUAResults analyzeRegisterUsage(Function *F,
                                                     &Function.Function,
                                                     DefaultValue,
                                                     DefaultValue,
-                                                    { EntryNode });
+                                                    { EntryNode },
+                                                    MFPIterations);
 
     auto Compute = [&AnalysisResult, &Function](rua::Function::Node *Node,
                                                 bool Before) {
@@ -15,30 +15,62 @@
 /// strict debug info verification logic, which we currently do not handle.
 /// Specifically, if a function as debug information, then all the inlinable
 /// call sites targeting it need to have debug information too.
+///
+/// In lightweight mode (`-debug-info-mode=light`), only calls get a debug
+/// location. The location of the other instructions is recorded, as a string
+/// metadata, only where it changes (i.e., on calls to newpc and at the start of
+/// each basic block): `getLocation` looks for the closest one. The
+/// materialize-debug-info pass turns it into full debug info, when needed.
 
 //
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Instructions.h"
+#include "llvm/IR/IntrinsicInst.h"
 #include "llvm/IR/Metadata.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/EarlyFunctionAnalysis/ControlFlowGraphCache.h"
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Pipeline/Location.h"
 #include "revng/Pipeline/RegisterPipe.h"
+#include "revng/Pipes/IRHelpers.h"
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Pipes/Ranks.h"
 #include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
 
 using namespace llvm;
 
+enum class DebugInfoMode {
+  Full,
+  Light
+};
+
+static cl::opt<DebugInfoMode> Mode("debug-info-mode",
+                                   cl::desc("How attach-debug-info records "
+                                            "the location of instructions."),
+                                   cl::values(clEnumValN(DebugInfoMode::Full,
+                                                         "full",
+                                                         "A debug location "
+                                                         "on each "
+                                                         "instruction."),
+                                              clEnumValN(DebugInfoMode::Light,
+                                                         "light",
+                                                         "Debug locations on "
+                                                         "calls only, a "
+                                                         "compact form "
+                                                         "elsewhere.")),
+                                   cl::init(DebugInfoMode::Full));
+
 class AttachDebugInfo : public llvm::ModulePass {
 public:
   static char ID;
@@ -65,21 +97,99 @@ static bool isTrue(const llvm::Value *V) {
   return getLimitedValue(V) != 0;
 }
 
-static void handleFunction(DIBuilder &DIB,
+static DICompileUnit *getOrCreateCompileUnit(DIBuilder &DIB, Module &M) {
+  if (M.debug_compile_units_begin() != M.debug_compile_units_end())
+    return *M.debug_compile_units_begin();
+
+  // This will be used for attaching the !dbg to instructions.
+  // TODO: Document how are we going to abuse DILocation fields.
+  DIFile *File = DIB.createFile(M.getSourceFileName(), "./");
+  // Also add dummy CU.
+  return DIB.createCompileUnit(dwarf::DW_LANG_C,
+                               File,
+                               "revng", // Producer
+                               true, // isOptimized
+                               "", // Flags
+                               0 // RV
+  );
+}
+
+static DISubprogram *
+createSubprogram(DIBuilder &DIB, DIFile *File, StringRef Name) {
+  auto SPFlags = DISubprogram::toSPFlags(false, // isLocalToUnit
+                                         true, // isDefinition
+                                         false // isOptimized
+  );
+  auto SPType = DIB.createSubroutineType(DIB.getOrCreateTypeArray({}));
+
+  DISubprogram *Result = DIB.createFunction(File, // Scope
+                                            Name, // Name
+                                            StringRef(), // LinkageName
+                                            File, // File
+                                            1, // LineNo
+                                            SPType, // Ty (subroutine type)
+                                            1, // ScopeLine
+                                            DINode::FlagPrototyped, // Flags
+                                            SPFlags);
+  DIB.finalizeSubprogram(Result);
+  return Result;
+}
+
+/// Creates the debug locations pointing back to the binary within a function,
+/// once for each serialized location
+class DebugLocations {
+private:
+  DIBuilder &DIB;
+  DISubprogram *TheSubprogram = nullptr;
+  DILocation *InlineLocationForMetaAddress = nullptr;
+  StringMap<DILocation *> Cache;
+
+public:
+  DebugLocations(DIBuilder &DIB, DISubprogram *TheSubprogram) :
+    DIB(DIB), TheSubprogram(TheSubprogram) {
+    InlineLocationForMetaAddress = DILocation::get(TheSubprogram->getContext(),
+                                                   0,
+                                                   0,
+                                                   TheSubprogram,
+                                                   nullptr);
+  }
+
+public:
+  DILocation *get(StringRef SerializedLocation) {
+    DILocation *&Result = Cache[SerializedLocation];
+    if (Result != nullptr)
+      return Result;
+
+    auto *Subprogram = createSubprogram(DIB,
+                                        TheSubprogram->getFile(),
+                                        SerializedLocation);
+
+    // Represent debug info for all the isolated functions as if they were
+    // inlined in the root.
+    Result = DILocation::get(TheSubprogram->getContext(),
+                             0,
+                             0,
+                             Subprogram,
+                             InlineLocationForMetaAddress);
+    return Result;
+  }
+};
+
+static void handleFunction(DebugLocations &Locations,
                            llvm::Function &F,
-                           DISubprogram *TheSubprogram,
                            efa::ControlFlowGraph &FM,
                            GeneratedCodeBasicInfo &GCBI) {
   namespace ranks = revng::ranks;
 
-  LLVMContext &Context = F.getParent()->getContext();
-  DILocation *CurrentDebugLocation = nullptr;
+  std::string CurrentLocation;
   BasicBlockID LastJumpTarget;
   for (auto *BB : ReversePostOrderTraversal(&F)) {
     if (not GCBI.isTranslated(BB))
       continue;
 
+    bool AtBlockStart = true;
     for (auto &I : *BB) {
+      bool IsNewPC = false;
       if (auto *Call = getCallTo(&I, "newpc")) {
         BasicBlockID Address = blockIDFromNewPC(Call);
 
@@ -95,47 +205,40 @@ static void handleFunction(DIBuilder &DIB,
         revng_assert(LastJumpTarget.isValid());
         revng_assert(Address.inliningIndex() == LastJumpTarget.inliningIndex());
 
-        auto SPFlags = DISubprogram::toSPFlags(false, /* isLocalToUnit */
-                                               true, /* isDefinition*/
-                                               false /* isOptimized */);
-        auto Type = DIB.createSubroutineType(DIB.getOrCreateTypeArray({}));
-
         // Let's make the debug location that points back to the binary.
-        std::string NewDebugLocation = serializedLocation(ranks::Instruction,
-                                                          FM.Entry(),
-                                                          LastJumpTarget,
-                                                          Address.start());
-        auto Subprogram = DIB.createFunction(TheSubprogram->getFile(), // Scope
-                                             NewDebugLocation, // Name
-                                             StringRef(), // LinkageName
-                                             TheSubprogram->getFile(), // File
-                                             1, // LineNo
-                                             Type, // Ty (subroutine type)
-                                             1, // ScopeLine
-                                             DINode::FlagPrototyped, // Flags
-                                             SPFlags);
-        DIB.finalizeSubprogram(Subprogram);
-
-        auto InlineLocationForMetaAddress = DILocation::get(Context,
-                                                            0,
-                                                            0,
-                                                            TheSubprogram,
-                                                            nullptr);
-
-        // Represent debug info for all the isolated functions as if they were
-        // inlined in the root.
-        auto InlineLoc = DILocation::get(Context,
-                                         0,
-                                         0,
-                                         Subprogram,
-                                         InlineLocationForMetaAddress);
-
-        CurrentDebugLocation = InlineLoc;
+        CurrentLocation = serializedLocation(ranks::Instruction,
+                                             FM.Entry(),
+                                             LastJumpTarget,
+                                             Address.start());
+        IsNewPC = true;
       }
 
-      I.setDebugLoc(CurrentDebugLocation);
+      if (Mode == DebugInfoMode::Full) {
+        if (CurrentLocation.empty())
+          I.setDebugLoc(DebugLoc());
+        else
+          I.setDebugLoc(Locations.get(CurrentLocation));
+      } else {
+        // Call sites are looked up by their debug location (e.g., by
+        // EnforceABI), keep it
+        bool IsCall = isa<CallInst>(I) and not isa<IntrinsicInst>(I);
+        if (IsCall and not IsNewPC and not CurrentLocation.empty()) {
+          I.setDebugLoc(Locations.get(CurrentLocation));
+        } else {
+          I.setDebugLoc(DebugLoc());
+          if ((IsNewPC or AtBlockStart) and not CurrentLocation.empty())
+            setStringMetadata(&I, LocationMDName, CurrentLocation);
+        }
+      }
+
+      AtBlockStart = false;
     }
   }
+
+  if (Mode == DebugInfoMode::Light)
+    F.setMetadata(LightDebugInfoMDName, MDTuple::get(F.getContext(), {}));
+  else
+    F.setMetadata(LightDebugInfoMDName, nullptr);
 }
 
 bool AttachDebugInfo::runOnModule(llvm::Module &M) {
@@ -144,17 +247,7 @@ bool AttachDebugInfo::runOnModule(llvm::Module &M) {
                                     .get();
   auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
 
-  // This will be used for attaching the !dbg to instructions.
-  // TODO: Document how are we going to abuse DILocation fields.
-  DIFile *File = DIB.createFile(M.getSourceFileName(), "./");
-  // Also add dummy CU.
-  DICompileUnit *CU = DIB.createCompileUnit(dwarf::DW_LANG_C,
-                                            File,
-                                            "revng", // Producer
-                                            true, // isOptimized
-                                            "", // Flags
-                                            0 // RV
-  );
+  DICompileUnit *CU = getOrCreateCompileUnit(DIB, M);
 
   for (auto &F : M) {
     // Skip non-isolated functions (e.g. helpers from QEMU).
@@ -175,30 +268,85 @@ bool AttachDebugInfo::runOnModule(llvm::Module &M) {
                                        << FM.Entry().toString());
 
     // Create debug info for the function.
-    auto SPFlags = DISubprogram::toSPFlags(false, // isLocalToUnit
-                                           true, // isDefinition
-                                           false // isOptimized
-    );
-    auto SPType = DIB.createSubroutineType(DIB.getOrCreateTypeArray({}));
-
-    DISubprogram
-      *TheSubprogram = DIB.createFunction(CU->getFile(), // Scope
-                                          F.getName(), // Name
-                                          StringRef(), // LinkageName
-                                          CU->getFile(), // File
-                                          1, // LineNo
-                                          SPType, // Ty (subroutine type)
-                                          1, // ScopeLine
-                                          DINode::FlagPrototyped, // Flags
-                                          SPFlags);
-    DIB.finalizeSubprogram(TheSubprogram);
-
-    handleFunction(DIB, F, TheSubprogram, FM, GCBI);
+    DebugLocations Locations(DIB,
+                             createSubprogram(DIB,
+                                              CU->getFile(),
+                                              F.getName()));
+    handleFunction(Locations, F, FM, GCBI);
   }
 
   return true;
 }
 
+/// Turns the lightweight debug info produced by attach-debug-info into a debug
+/// location on each instruction
+class MaterializeDebugInfo : public llvm::ModulePass {
+public:
+  static char ID;
+
+public:
+  MaterializeDebugInfo() : llvm::ModulePass(ID) {}
+
+  void getAnalysisUsage(llvm::AnalysisUsage &AU) const override {
+    AU.setPreservesCFG();
+  }
+
+  bool runOnModule(llvm::Module &M) override;
+};
+
+char MaterializeDebugInfo::ID = 0;
+
+using RegisterMaterialize = RegisterPass<MaterializeDebugInfo>;
+static RegisterMaterialize Z("materialize-debug-info",
+                             "Turn lightweight debug info into full debug "
+                             "info.");
+
+bool MaterializeDebugInfo::runOnModule(llvm::Module &M) {
+  DIBuilder DIB(M);
+  DICompileUnit *CU = nullptr;
+  bool Changed = false;
+
+  for (auto &F : M) {
+    if (F.getMetadata(LightDebugInfoMDName) == nullptr)
+      continue;
+
+    if (CU == nullptr)
+      CU = getOrCreateCompileUnit(DIB, M);
+
+    DebugLocations Locations(DIB,
+                             createSubprogram(DIB,
+                                              CU->getFile(),
+                                              F.getName()));
+
+    // Same as getLocation: each instruction takes the location of the
+    // closest preceding one in its basic block
+    for (BasicBlock &BB : F) {
+      DILocation *CurrentDebugLocation = nullptr;
+      for (Instruction &I : BB) {
+        DILocation *Existing = I.getDebugLoc().get();
+        if (Existing != nullptr and Existing->getInlinedAt() != nullptr) {
+          CurrentDebugLocation = Existing;
+          continue;
+        }
+
+        if (I.getMetadata(LocationMDName) != nullptr) {
+          StringRef Serialized = fromStringMetadata(&I, LocationMDName);
+          CurrentDebugLocation = Locations.get(Serialized);
+          I.setMetadata(LocationMDName, nullptr);
+        }
+
+        if (CurrentDebugLocation != nullptr)
+          I.setDebugLoc(CurrentDebugLocation);
+      }
+    }
+
+    F.setMetadata(LightDebugInfoMDName, nullptr);
+    Changed = true;
+  }
+
+  return Changed;
+}
+
 // Note: unfortunately, due to the presence of kinds, we need two distinct pipes
 
 struct AttachDebugInfoToIsolatedPipe {
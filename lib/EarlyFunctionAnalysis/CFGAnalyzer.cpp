@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
 #include <fstream>
 
 #include "llvm/ADT/STLExtras.h"
@@ -24,8 +25,7 @@
 #include "llvm/Transforms/Scalar/SimplifyCFG.h"
 
 #include "revng/ADT/Queue.h"
-#include "revng/BasicAnalyses/RemoveHelperCalls.h"
-#include "revng/BasicAnalyses/RemoveNewPCCalls.h"
+#include "revng/BasicAnalyses/CleanupLiftedCode.h"
 #include "revng/EarlyFunctionAnalysis/AAWriterPass.h"
 #include "revng/EarlyFunctionAnalysis/BasicBlock.h"
 #include "revng/EarlyFunctionAnalysis/CFGAnalyzer.h"
@@ -39,6 +39,8 @@
 #include "revng/Support/BasicBlockID.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/Generator.h"
+#include "revng/Support/Progress.h"
+#include "revng/Support/Statistics.h"
 #include "revng/Support/TemporaryLLVMOption.h"
 
 using namespace llvm;
@@ -55,8 +57,29 @@ static opt<std::string> IndirectBranchInfoSummaryPath("indirect-branch-info-"
                                                            "of SA2 on disk."),
                                                       value_desc("filename"));
 
+static opt<unsigned> SizeBudget("efa-function-size-budget",
+                                 desc("Do not optimize outlined functions "
+                                      "with more instructions than this, "
+                                      "give them a conservative summary "
+                                      "instead (0 means no limit)."),
+                                 init(0));
+
+static opt<unsigned> TimeBudget("efa-function-time-budget",
+                                desc("Stop optimizing an outlined function "
+                                     "after this many milliseconds, and give "
+                                     "it a conservative summary instead (0 "
+                                     "means no limit)."),
+                                init(0));
+
 static Logger<> Log("cfg-analyzer");
 
+/// How many times the optimization pipeline has been run, skipped or cut short
+/// due to the budgets
+static CounterMap<std::string> PipelineRuns("cfg-analyzer-pipeline-runs");
+
+/// Time spent in each pass of the optimization pipeline, in microseconds
+static CounterMap<std::string> PipelinePassTime("cfg-analyzer-pipeline-us");
+
 static MetaAddress getFinalAddressOfBasicBlock(llvm::BasicBlock *BB) {
   auto [End, Size] = getPC(BB->getTerminator());
   return End + Size;
@@ -149,7 +172,15 @@ CFGAnalyzer::CFGAnalyzer(llvm::Module &M,
   *OutputIBI << "\n";
 }
 
+using Clock = std::chrono::steady_clock;
+
+static uint64_t microsecondsSince(Clock::time_point Start) {
+  using namespace std::chrono;
+  return duration_cast<microseconds>(Clock::now() - Start).count();
+}
+
 OutlinedFunction CFGAnalyzer::outline(const MetaAddress &Entry) {
+  auto Start = Clock::now();
   auto &CFG = Oracle.getLocalFunction(Entry).CFG;
   bool HasCFG = CFG.size() != 0;
   llvm::SmallSet<MetaAddress, 4> ReturnBlocks;
@@ -186,6 +217,8 @@ OutlinedFunction CFGAnalyzer::outline(const MetaAddress &Entry) {
     if (IsJumpTarget(Call) and not IsFirst(Call))
       Call->getParent()->splitBasicBlock(Call);
 
+  Costs[Entry].OutlineUs += microsecondsSince(Start);
+
   return Result;
 }
 
@@ -591,7 +624,7 @@ void CFGAnalyzer::materializePCValues(llvm::Function *F,
   }
 }
 
-void CFGAnalyzer::runOptimizationPipeline(llvm::Function *F) {
+bool CFGAnalyzer::runOptimizationPipeline(llvm::Function *F) {
   using namespace llvm;
 
   // Some LLVM passes used later in the pipeline scan for cut-offs, meaning that
@@ -613,8 +646,8 @@ void CFGAnalyzer::runOptimizationPipeline(llvm::Function *F) {
     // First stage: simplify the IR, promote the CSVs to local variables,
     // compute subexpressions elimination and resolve redundant expressions in
     // order to compute the stack height.
-    FPM.addPass(RemoveNewPCCallsPass());
-    FPM.addPass(RemoveHelperCallsPass());
+    FPM.addPass(CleanupLiftedCodePass({ .RemoveNewPCCalls = true,
+                                        .RemoveHelperCalls = true }));
     FPM.addPass(PromoteGlobalToLocalPass());
     FPM.addPass(SimplifyCFGPass());
     FPM.addPass(SROAPass(SROAOptions::ModifyCFG));
@@ -660,11 +693,39 @@ void CFGAnalyzer::runOptimizationPipeline(llvm::Function *F) {
     FAM.registerPass([&] { return GeneratedCodeBasicInfoAnalysis(); });
     FAM.registerPass([&] { return ModuleAnalysisManagerFunctionProxy(MAM); });
 
-    PassBuilder PB;
+    // When collecting statistics, time each pass
+    Clock::time_point PassStart;
+    PassInstrumentationCallbacks PIC;
+
+    // Past the deadline, skip all the remaining passes. This can't preempt a
+    // pass that is already running, but the pipeline is made up of many
+    // passes, none of which dominates.
+    bool OutOfTime = false;
+    if (TimeBudget != 0) {
+      auto Deadline = Clock::now() + std::chrono::milliseconds(TimeBudget);
+      PIC.registerShouldRunOptionalPassCallback([&, Deadline](StringRef, Any) {
+        OutOfTime = OutOfTime or Clock::now() >= Deadline;
+        return not OutOfTime;
+      });
+    }
+    if (Statistics) {
+      PIC.registerBeforeNonSkippedPassCallback([&](StringRef, Any) {
+        PassStart = Clock::now();
+      });
+      PIC.registerAfterPassCallback([&](StringRef Name,
+                                        Any,
+                                        const PreservedAnalyses &) {
+        PipelinePassTime.push(Name, microsecondsSince(PassStart));
+      });
+    }
+
+    PassBuilder PB(nullptr, PipelineTuningOptions(), std::nullopt, &PIC);
     PB.registerFunctionAnalyses(FAM);
     PB.registerModuleAnalyses(MAM);
 
     FPM.run(*F, FAM);
+
+    return not OutOfTime;
   }
 }
 
@@ -1096,12 +1157,55 @@ FunctionSummary CFGAnalyzer::analyze(const MetaAddress &Entry) {
   // constant-folded away by the optimization pipeline.
   materializePCValues(F, Builder);
 
-  // Execute the optimization pipeline over the outlined function
-  runOptimizationPipeline(F);
+  // Execute the optimization pipeline over the outlined function. milkInfo
+  // only inspects the calls to the indirect branch info marker: if there are
+  // none, there's nothing to optimize for, unless we've been asked to dump the
+  // optimized function.
+  FunctionCost &Cost = Costs[Entry];
+  auto &Marker = OutlinedFunction.IndirectBranchInfoMarker;
+  size_t IndirectBranches = Marker->getNumUses();
+  bool IsDumping = IndirectBranchInfoSummaryPath.getNumOccurrences() == 1
+                   or AAWriterPath.getNumOccurrences() == 1;
+  uint64_t OptimizationUs = 0;
+  bool OverBudget = false;
+  if (IndirectBranches == 0 and not IsDumping) {
+    PipelineRuns.push("skipped");
+  } else if (SizeBudget != 0 and F->getInstructionCount() > SizeBudget) {
+    PipelineRuns.push("over-size-budget");
+    OverBudget = true;
+  } else {
+    auto Start = Clock::now();
+    OverBudget = not runOptimizationPipeline(F);
+    OptimizationUs = microsecondsSince(Start);
+    PipelineRuns.push(OverBudget ? "over-time-budget" : "run");
+  }
 
   // Squeeze out the results obtained from the optimization passes
   auto FunctionInfo = milkInfo(&OutlinedFunction, std::move(CFG));
 
+  if (OverBudget) {
+    // The IR has not been (fully) optimized, and the results of milkInfo
+    // cannot be trusted, with the exception of the CFG, which is always
+    // sound. In particular, the function would look like noreturn.
+    // Assume what we would assume for a call to an unknown function.
+    revng_log(Log,
+              Entry.toString() << " exceeded its budget, falling back to the "
+                                  "default summary");
+    const FunctionSummary &Default = Oracle.getDefault();
+    FunctionInfo.Attributes = Default.Attributes;
+    FunctionInfo.ClobberedRegisters = Default.ClobberedRegisters;
+    FunctionInfo.ElectedFSO = Default.ElectedFSO;
+  }
+
+  ++Cost.Analyses;
+  Cost.OptimizationUs += OptimizationUs;
+  Cost.Blocks = FunctionInfo.CFG.size();
+  Cost.IndirectBranches = IndirectBranches;
+  Cost.OverBudget = OverBudget;
+  revng::addTraceArgument("optimization-us", OptimizationUs);
+  revng::addTraceArgument("blocks", Cost.Blocks);
+  revng::addTraceArgument("indirect-branches", IndirectBranches);
+
   return FunctionInfo;
 }
 
@@ -4,6 +4,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
 #include "revng/EarlyFunctionAnalysis/CFGAnalyzer.h"
 #include "revng/EarlyFunctionAnalysis/CFGStringMap.h"
@@ -21,6 +29,12 @@
 
 using namespace llvm;
 
+static cl::opt<unsigned>
+  CollectCFGThreads("collect-cfg-threads",
+                    cl::desc("Number of threads serializing the recovered "
+                             "CFGs (0 means all the available cores)"),
+                    cl::init(1));
+
 namespace revng::pipes {
 
 class CollectCFGPipe {
@@ -56,6 +70,12 @@ public:
     pipeline::TargetsList
       RequestedTargets = Context.getCurrentRequestedTargets()[CFGs.name()];
 
+    // The analysis works on M, so CFGs are recovered one at a time. Their
+    // serialization, on the other hand, only depends on the CFG itself and
+    // takes place at the end, possibly in parallel.
+    std::vector<MetaAddress> Entries;
+    std::vector<efa::ControlFlowGraph> Recovered;
+
     for (const pipeline::Target &Target : RequestedTargets) {
       if (&Target.getKind() != &revng::kinds::CFG)
         continue;
@@ -81,14 +101,34 @@ public:
 
       revng_assert(New.Blocks().contains(BasicBlockID(New.Entry())));
 
-      // TODO: we'd need a function-wise TupleTreeContainer
-      CFGs[EntryAddress] = serializeToString(New);
+      Entries.push_back(EntryAddress);
+      Recovered.push_back(std::move(New));
 
       // Commit the produced target
       Context.commit(Target, CFGs.name());
 
       Context.getContext().popReadFields();
     }
+
+    // TODO: we'd need a function-wise TupleTreeContainer
+    std::vector<std::string> Serialized(Recovered.size());
+    auto Serialize = [&Recovered, &Serialized](size_t Index) {
+      Serialized[Index] = serializeToString(Recovered[Index]);
+      Recovered[Index] = efa::ControlFlowGraph();
+    };
+
+    if (CollectCFGThreads == 1 or Recovered.size() <= 1) {
+      for (size_t Index = 0; Index < Recovered.size(); ++Index)
+        Serialize(Index);
+    } else {
+      ThreadPool Pool(hardware_concurrency(CollectCFGThreads));
+      for (size_t Index = 0; Index < Recovered.size(); ++Index)
+        Pool.async(Serialize, Index);
+      Pool.wait();
+    }
+
+    for (auto &&[Entry, Text] : llvm::zip(Entries, Serialized))
+      CFGs[Entry] = std::move(Text);
   }
 
   llvm::Error checkPrecondition(const pipeline::Context &Ctx) const {
@@ -5,9 +5,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <utility>
+#include <vector>
+
 #include "boost/icl/interval_set.hpp"
 #include "boost/icl/right_open_interval.hpp"
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/IR/Module.h"
 
 #include "revng/EarlyFunctionAnalysis/CollectFunctionsFromUnusedAddressesPass.h"
@@ -40,10 +44,9 @@ public:
 
 private:
   void loadAllCFGs(ControlFlowGraphCache &MDCache) {
+    using Range = std::pair<MetaAddress, MetaAddress>;
+    std::vector<Range> Ranges;
     for (auto &Function : Binary.Functions()) {
-      llvm::BasicBlock *Entry = GCBI.getBlockAt(Function.Entry());
-      llvm::Instruction *Term = Entry->getTerminator();
-
       const efa::ControlFlowGraph &FM = MDCache.getControlFlowGraph(Function
                                                                       .Entry());
       for (const efa::BasicBlock &Block : FM.Blocks()) {
@@ -52,15 +55,27 @@ private:
         revng_log(Log,
                   "Registering as used range [" << Start.toString() << ", "
                                                 << End.toString() << ")");
-        UsedRanges += interval::right_open(Start, End);
+        Ranges.emplace_back(Start, End);
       }
     }
+
+    // Insert the ranges in order, each one next to the previous one: this way
+    // every insertion only has to look at the last interval of the set,
+    // instead of looking up its position
+    llvm::sort(Ranges);
+    auto Hint = UsedRanges.end();
+    for (const auto &[Start, End] : Ranges)
+      Hint = UsedRanges.add(Hint, interval::right_open(Start, End));
   }
 
   void collectFunctionsFromUnusedAddresses() {
     using namespace llvm;
     Function &Root = *M.getFunction("root");
 
+    // Create the new functions only at the end: inserting them one by one
+    // would shift the functions sorted after them each time
+    std::vector<MetaAddress> NewEntries;
+
     for (BasicBlock &BB : Root) {
       if (getType(&BB) != BlockType::JumpTargetBlock)
         continue;
@@ -109,13 +124,17 @@ private:
                         << Entry.toString());
           }
 
-          Binary.Functions()[Entry];
+          NewEntries.push_back(Entry);
           revng_log(Log,
                     "Found function from unused addresses: "
                       << BB.getName().str());
         }
       }
     }
+
+    auto Inserter = Binary.Functions().batch_try_emplace();
+    for (const MetaAddress &Entry : NewEntries)
+      Inserter.try_emplace(Entry);
   }
 
 private:
@@ -4,6 +4,13 @@
 
 #include "revng/EarlyFunctionAnalysis/ControlFlowGraphCache.h"
 
+llvm::cl::opt<unsigned>
+  ControlFlowGraphCacheSize("cfg-cache-size",
+                            llvm::cl::desc("Maximum number of deserialized "
+                                           "CFGs to keep in memory (0 means "
+                                           "no limit)"),
+                            llvm::cl::init(0));
+
 char ControlFlowGraphCachePass::ID = '_';
 
 llvm::AnalysisKey ControlFlowGraphCacheAnalysis::Key;
@@ -4,9 +4,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
 #include <fstream>
 #include <iterator>
+#include <map>
 #include <memory>
+#include <set>
 
 #include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -17,6 +20,7 @@
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/GraphWriter.h"
+#include "llvm/Support/JSON.h"
 
 #include "revng/ABI/Definition.h"
 #include "revng/ABI/FunctionType/Layout.h"
@@ -44,6 +48,7 @@
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/OpaqueRegisterUser.h"
+#include "revng/Support/Progress.h"
 
 using namespace llvm;
 using namespace llvm::cl;
@@ -53,6 +58,12 @@ static opt<std::string> CallGraphOutputPath("cg-output",
                                                  "call graph."),
                                             value_desc("filename"));
 
+static opt<std::string> CostReportPath("efa-cost-report",
+                                       desc("Write to disk, as JSON, how much "
+                                            "analyzing each function cost, "
+                                            "most expensive first."),
+                                       value_desc("filename"));
+
 enum ABIEnforcementOption {
   NoABIEnforcement = 0,
   SoftABIEnforcement,
@@ -82,6 +93,13 @@ static opt<ABIOpt> ABIEnforcement("abi-enforcement-level",
                                                     "found.")),
                                   init(ABIOpt::FullABIEnforcement));
 
+static opt<bool> Incremental("detect-abi-incremental",
+                              desc("Treat the prototypes already in the model "
+                                   "as final: only analyze the ABI of the "
+                                   "functions without one and of their "
+                                   "callers."),
+                              init(false));
+
 static Logger<> Log("detect-abi");
 
 struct Changes {
@@ -134,8 +152,6 @@ static bool isWritingToMemory(llvm::Instruction &I) {
   return false;
 }
 
-using BasicBlockQueue = UniquedQueue<const BasicBlockNode *>;
-
 class DetectABI {
 private:
   using BasicBlockToNodeMap = llvm::DenseMap<llvm::BasicBlock *,
@@ -153,6 +169,15 @@ private:
   CallGraph ApproximateCallGraph;
   BasicBlockToNodeMap BasicBlockNodeMap;
 
+  /// Functions whose ABI has been analyzed by analyzeABI
+  std::set<MetaAddress> Analyzed;
+
+  /// The registers of the architecture that have a CSV, with their CSV
+  using RegisterCSV = std::pair<model::Register::Values,
+                                llvm::GlobalVariable *>;
+  llvm::SmallVector<RegisterCSV, 32> RegisterCSVs;
+  llvm::DenseMap<llvm::GlobalVariable *, model::Register::Values> CSVRegisters;
+
 public:
   DetectABI(llvm::Module &M,
             GeneratedCodeBasicInfo &GCBI,
@@ -166,7 +191,18 @@ public:
     FMC(FMC),
     Binary(Binary),
     Oracle(Oracle),
-    Analyzer(Analyzer) {}
+    Analyzer(Analyzer) {
+    // Translating between registers and CSVs goes through their names: do it
+    // once here rather than for each register of each function
+    auto Architecture = Binary->Architecture();
+    for (auto Register : model::Architecture::registers(Architecture)) {
+      llvm::StringRef Name = model::Register::getCSVName(Register);
+      if (llvm::GlobalVariable *CSV = M.getGlobalVariable(Name, true)) {
+        RegisterCSVs.emplace_back(Register, CSV);
+        CSVRegisters[CSV] = Register;
+      }
+    }
+  }
 
 public:
   void run() {
@@ -201,12 +237,21 @@ public:
     // Propagate prototypes
     Task.advance("propagatePrototypes");
     propagatePrototypes();
+
+    if (CostReportPath.getNumOccurrences() == 1)
+      writeCostReport();
   }
 
 private:
   void computeApproximateCallGraph();
   void preliminaryFunctionAnalysis();
   void analyzeABI();
+
+  /// \return the functions analyzeABI has to consider: all of them or, in
+  ///         incremental mode, only those without a prototype and their
+  ///         callers
+  std::set<MetaAddress> functionsToAnalyze() const;
+
   Changes analyzeFunctionABI(const model::Function &Function,
                              OutlinedFunction &OutlinedFunction,
                              OpaqueRegisterUser &Clobberer);
@@ -221,6 +266,8 @@ private:
   /// Propagate prototypes to callers
   void propagatePrototypesInFunction(model::Function &Function);
 
+  void writeCostReport() const;
+
 private:
   void recordRegisters(const efa::CSVSet &CSVs, auto Inserter);
 
@@ -239,6 +286,15 @@ private:
                                 const efa::BasicBlock &CallerBlock);
 
   bool getRegisterState(model::Register::Values, const CSVSet &);
+
+  model::Register::Values registerOf(llvm::GlobalVariable *CSV) const {
+    auto It = CSVRegisters.find(CSV);
+    if (It != CSVRegisters.end())
+      return It->second;
+
+    return model::Register::fromCSVName(CSV->getName(),
+                                        Binary->Architecture());
+  }
 };
 
 void DetectABI::computeApproximateCallGraph() {
@@ -324,7 +380,18 @@ void DetectABI::preliminaryFunctionAnalysis() {
   revng_log(Log, "Running the preliminary function analysis");
   LoggerIndent<> LodIndent(Log);
 
-  BasicBlockQueue EntrypointsQueue;
+  // The queue is keyed on the post-order index of each function in the call
+  // graph: callees are always analyzed before their callers. This way, a
+  // caller re-enqueued due to a change in one of its callees waits for the
+  // other callees still in the queue, instead of being analyzed once per
+  // changed callee.
+  std::map<unsigned, const BasicBlockNode *> EntrypointsQueue;
+  llvm::DenseMap<const BasicBlockNode *, unsigned> PostOrderIndex;
+  auto Enqueue = [&](const BasicBlockNode *Node) {
+    auto It = PostOrderIndex.find(Node);
+    revng_assert(It != PostOrderIndex.end());
+    EntrypointsQueue.emplace(It->second, Node);
+  };
 
   //
   // Populate queue of entry points
@@ -339,8 +406,10 @@ void DetectABI::preliminaryFunctionAnalysis() {
 
     // The intraprocedural analysis will be scheduled only for those functions
     // which have `Invalid` as type.
-    auto &Function = Binary->Functions().at(Node->Address);
-    EntrypointsQueue.insert(Node);
+    revng_assert(Binary->Functions().contains(Node->Address));
+    unsigned Index = PostOrderIndex.size();
+    PostOrderIndex[Node] = Index;
+    Enqueue(Node);
   }
 
   revng_assert(Binary->Functions().size() == EntrypointsQueue.size());
@@ -349,9 +418,14 @@ void DetectABI::preliminaryFunctionAnalysis() {
   // Process the queue
   //
 
+  llvm::Task AnalysisTask({}, "Preliminary analysis");
+  unsigned Analyses = 0;
   while (!EntrypointsQueue.empty()) {
-    const BasicBlockNode *EntryNode = EntrypointsQueue.pop();
+    const BasicBlockNode *EntryNode = EntrypointsQueue.begin()->second;
+    EntrypointsQueue.erase(EntrypointsQueue.begin());
     MetaAddress EntryPointAddress = EntryNode->Address;
+    ++Analyses;
+    AnalysisTask.advance(EntryPointAddress.toString());
     revng_log(Log, "Analyzing " << EntryPointAddress.toString());
     LoggerIndent<> Indent(Log);
 
@@ -415,13 +489,17 @@ void DetectABI::preliminaryFunctionAnalysis() {
 
           if (Binary->Functions().at(CallerPC).Prototype().isEmpty()) {
             revng_log(Log, CallerPC.toString());
-            EntrypointsQueue.insert(Caller);
+            Enqueue(Caller);
           }
         }
       }
     }
   }
 
+  revng_log(Log,
+            Analyses << " analyses for " << Binary->Functions().size()
+                     << " functions");
+
   // Register all indirect call sites in all functions, we'll need to fill in
   // their prototypes
   for (auto &Function : Binary->Functions()) {
@@ -454,12 +532,16 @@ void DetectABI::analyzeABI() {
   llvm::Task Task(2, "analyzeABI");
   std::map<MetaAddress, std::unique_ptr<OutlinedFunction>> Functions;
 
+  Analyzed = functionsToAnalyze();
+  revng_log(Log,
+            "Analyzing " << Analyzed.size() << " out of "
+                         << Binary->Functions().size() << " functions");
+
   // Create all temporary functions
   Task.advance("Create temporary functions");
-  for (model::Function &Function : Binary->Functions()) {
-    const MetaAddress &Entry = Function.Entry();
+  for (const MetaAddress &Entry : Analyzed) {
     auto NewFunction = make_unique<OutlinedFunction>(Analyzer.outline(Entry));
-    Functions[Function.Entry()] = std::move(NewFunction);
+    Functions[Entry] = std::move(NewFunction);
   }
 
   // Push this into analyzeFunction
@@ -469,8 +551,12 @@ void DetectABI::analyzeABI() {
   Task.advance("Run fixed-point analyses");
   llvm::Task FixedPointTask({}, "Fixed-point analysis");
   UniquedQueue<model::Function *> ToAnalyze;
-  for (model::Function &Function : Binary->Functions())
-    ToAnalyze.insert(&Function);
+  auto Enqueue = [&](const MetaAddress &Entry) {
+    if (Analyzed.contains(Entry))
+      ToAnalyze.insert(&Binary->Functions().at(Entry));
+  };
+  for (const MetaAddress &Entry : Analyzed)
+    Enqueue(Entry);
 
   // Change the oracle default prototype to have no arguments nor return values
   {
@@ -499,7 +585,7 @@ void DetectABI::analyzeABI() {
       for (auto &CallerNode : FunctionNode->predecessors()) {
         if (CallerNode->Address.isValid()) {
           revng_log(Log, CallerNode->Address.toString());
-          ToAnalyze.insert(&Binary->Functions().at(CallerNode->Address));
+          Enqueue(CallerNode->Address);
         }
       }
     }
@@ -509,11 +595,36 @@ void DetectABI::analyzeABI() {
     for (const MetaAddress &ToReanalyze : Changes.Callees) {
       revng_assert(ToReanalyze.isValid());
       revng_log(Log, "Re-enqueing callee " << ToReanalyze.toString());
-      ToAnalyze.insert(&Binary->Functions().at(ToReanalyze));
+      Enqueue(ToReanalyze);
     }
   }
 }
 
+std::set<MetaAddress> DetectABI::functionsToAnalyze() const {
+  std::set<MetaAddress> Result;
+  for (const model::Function &Function : Binary->Functions()) {
+    if (not Incremental or Function.Prototype().isEmpty())
+      Result.insert(Function.Entry());
+  }
+
+  if (not Incremental)
+    return Result;
+
+  // The functions with a prototype are not affected by the analysis, but their
+  // call sites provide information about the arguments and return values of
+  // the callees that still lack one
+  std::set<MetaAddress> Callers;
+  for (const MetaAddress &Entry : Result) {
+    const auto &Node = BasicBlockNodeMap.lookup(GCBI.getBlockAt(Entry));
+    for (const BasicBlockNode *Caller : Node->predecessors())
+      if (Caller->Address.isValid())
+        Callers.insert(Caller->Address);
+  }
+  Result.insert(Callers.begin(), Callers.end());
+
+  return Result;
+}
+
 Changes DetectABI::analyzeFunctionABI(const model::Function &Function,
                                       OutlinedFunction &OutlinedFunction,
                                       OpaqueRegisterUser &RegisterReader) {
@@ -588,22 +699,18 @@ void DetectABI::applyABIDeductions() {
   if (ABIEnforcement == NoABIEnforcement)
     return;
 
-  auto ABI = abi::Definition::get(Binary->DefaultABI());
+  const auto &ABI = abi::Definition::get(Binary->DefaultABI());
   for (const model::Function &Function : Binary->Functions()) {
     auto &Summary = Oracle.getLocalFunction(Function.Entry());
 
     abi::Definition::RegisterSet Arguments;
     abi::Definition::RegisterSet RValues;
-    model::Architecture::Values Architecture = Binary->Architecture();
-    for (const auto &Register : model::Architecture::registers(Architecture)) {
-      llvm::StringRef Name = model::Register::getCSVName(Register);
-      if (llvm::GlobalVariable *CSV = M.getGlobalVariable(Name, true)) {
-        if (Summary.ABIResults.ArgumentsRegisters.contains(CSV))
-          Arguments.emplace(Register);
+    for (const auto &[Register, CSV] : RegisterCSVs) {
+      if (Summary.ABIResults.ArgumentsRegisters.contains(CSV))
+        Arguments.emplace(Register);
 
-        if (Summary.ABIResults.ReturnValuesRegisters.contains(CSV))
-          RValues.emplace(Register);
-      }
+      if (Summary.ABIResults.ReturnValuesRegisters.contains(CSV))
+        RValues.emplace(Register);
     }
 
     if (ABIEnforcement == FullABIEnforcement) {
@@ -623,14 +730,11 @@ void DetectABI::applyABIDeductions() {
 
     efa::CSVSet ResultingArguments;
     efa::CSVSet ResultingReturnValues;
-    for (const auto &Register : model::Architecture::registers(Architecture)) {
-      llvm::StringRef Name = model::Register::getCSVName(Register);
-      if (llvm::GlobalVariable *CSV = M.getGlobalVariable(Name, true)) {
-        if (Arguments.contains(Register))
-          ResultingArguments.insert(CSV);
-        if (RValues.contains(Register))
-          ResultingReturnValues.insert(CSV);
-      }
+    for (const auto &[Register, CSV] : RegisterCSVs) {
+      if (Arguments.contains(Register))
+        ResultingArguments.insert(CSV);
+      if (RValues.contains(Register))
+        ResultingReturnValues.insert(CSV);
     }
 
     for (auto &Block : Summary.CFG) {
@@ -657,8 +761,7 @@ void DetectABI::applyABIDeductions() {
 
 void DetectABI::recordRegisters(const efa::CSVSet &CSVs, auto Inserter) {
   for (auto *CSV : CSVs) {
-    auto Reg = model::Register::fromCSVName(CSV->getName(),
-                                            Binary->Architecture());
+    auto Reg = registerOf(CSV);
     Inserter.emplace(Reg).Type() = model::PrimitiveType::makeGeneric(Reg);
   }
 }
@@ -746,10 +849,52 @@ void DetectABI::finalizeModel() {
 
 void DetectABI::propagatePrototypes() {
   for (model::Function &Function : Binary->Functions()) {
-    propagatePrototypesInFunction(Function);
+    // The written registers are known only for the analyzed functions
+    if (Analyzed.contains(Function.Entry()))
+      propagatePrototypesInFunction(Function);
   }
 }
 
+void DetectABI::writeCostReport() const {
+  using CostEntry = std::pair<const MetaAddress, FunctionCost>;
+  std::vector<const CostEntry *> Sorted;
+  for (const CostEntry &Entry : Analyzer.costs())
+    Sorted.push_back(&Entry);
+
+  auto MoreExpensive = [](const CostEntry *LHS, const CostEntry *RHS) {
+    return LHS->second.totalUs() > RHS->second.totalUs();
+  };
+  llvm::stable_sort(Sorted, MoreExpensive);
+
+  std::error_code EC;
+  raw_fd_ostream Output(CostReportPath, EC);
+  revng_assert(!EC);
+
+  llvm::json::OStream JSON(Output, 2);
+  JSON.object([&] {
+    JSON.attributeArray("functions", [&] {
+      for (const auto &[Entry, Cost] : llvm::make_pointee_range(Sorted)) {
+        JSON.object([&] {
+          JSON.attribute("entry", Entry.toString());
+          if (const auto *Function = Binary->Functions().tryGet(Entry))
+            JSON.attribute("name", Function->name().str().str());
+          JSON.attribute("total-us", Cost.totalUs());
+          JSON.attribute("outline-us", Cost.OutlineUs);
+          JSON.attribute("optimization-us", Cost.OptimizationUs);
+          JSON.attribute("abi-analyses-us", Cost.ABIAnalysesUs);
+          JSON.attribute("analyses", Cost.Analyses);
+          JSON.attribute("abi-analyses", Cost.ABIAnalyses);
+          JSON.attribute("blocks", Cost.Blocks);
+          JSON.attribute("indirect-branches", Cost.IndirectBranches);
+          JSON.attribute("mfp-iterations", Cost.MFPIterations);
+          JSON.attribute("over-budget", Cost.OverBudget);
+        });
+      }
+    });
+  });
+  Output << "\n";
+}
+
 // TODO: is this still necessary after the new EFA?
 void DetectABI::propagatePrototypesInFunction(model::Function &Function) {
   const MetaAddress &Entry = Function.Entry();
@@ -898,10 +1043,9 @@ static void combineCrossCallSites(auto &CallSite, auto &Callee) {
 bool DetectABI::getRegisterState(model::Register::Values RegisterValue,
                                  const CSVSet &ABIRegisterMap) {
 
-  llvm::StringRef Name = model::Register::getCSVName(RegisterValue);
-  if (llvm::GlobalVariable *CSV = M.getGlobalVariable(Name, true)) {
-    return ABIRegisterMap.contains(CSV);
-  }
+  for (const auto &[Register, CSV] : RegisterCSVs)
+    if (Register == RegisterValue)
+      return ABIRegisterMap.contains(CSV);
 
   return false;
 }
@@ -944,8 +1088,7 @@ DetectABI::computePreservedRegisters(const CSVSet &ClobberedRegisters) const {
 
   auto PreservedRegistersInserter = Result.batch_insert();
   for (auto *CSV : PreservedRegisters) {
-    auto RegisterID = model::Register::fromCSVName(CSV->getName(),
-                                                   Binary->Architecture());
+    auto RegisterID = registerOf(CSV);
     if (RegisterID == Register::Invalid)
       continue;
 
@@ -1002,12 +1145,26 @@ Changes DetectABI::runAnalyses(MetaAddress EntryAddress,
   auto WrittenRegisters = findWrittenRegisters(OutlinedFunction.Function.get());
 
   // Run ABI-independent data-flow analyses
+  using Clock = std::chrono::steady_clock;
+  auto Start = Clock::now();
+  size_t MFPIterations = 0;
   ABIResults = analyzeRegisterUsage(OutlinedFunction.Function.get(),
                                     GCBI,
                                     Binary->Architecture(),
                                     Analyzer.preCallHook(),
                                     Analyzer.postCallHook(),
-                                    Analyzer.retHook());
+                                    Analyzer.retHook(),
+                                    &MFPIterations);
+
+  {
+    using namespace std::chrono;
+    FunctionCost &Cost = Analyzer.cost(EntryAddress);
+    ++Cost.ABIAnalyses;
+    Cost.ABIAnalysesUs += duration_cast<microseconds>(Clock::now() - Start)
+                            .count();
+    Cost.MFPIterations += MFPIterations;
+    revng::addTraceArgument("mfp-iterations", MFPIterations);
+  }
 
   // We say that a register is callee-saved when, besides being preserved by
   // the callee, there is at least a write onto this register.
@@ -543,6 +543,7 @@ OutlinedFunction Outliner::outline(const MetaAddress &Entry,
 
   OutlinedFunction Result;
   OutlinedFunctionsMap FunctionsToInline(&M);
+  CallSiteInfoCache.clear();
 
   unsigned Attempts = 0;
   do {
@@ -613,6 +614,8 @@ OutlinedFunction Outliner::outline(const MetaAddress &Entry,
 
   createAnyPCHooks(Handler, &Result);
 
+  CallSiteInfoCache.clear();
+
   return Result;
 }
 
@@ -670,10 +673,20 @@ Outliner::getCallSiteInfo(MetaAddress CallerFunction,
     CalledSymbol = extractFromConstantStringPtr(JumpToSymbol->getArgOperand(0));
   }
 
-  return Oracle.getCallSite(CallerFunction,
-                            CallSiteAddress,
-                            Callee,
-                            CalledSymbol);
+  CallSiteInfoKey Key = { CallerFunction,
+                          CallSiteAddress,
+                          Callee,
+                          CalledSymbol };
+  auto It = CallSiteInfoCache.find(Key);
+  if (It != CallSiteInfoCache.end())
+    return It->second;
+
+  CallSiteInfo Result = Oracle->getCallSite(CallerFunction,
+                                            CallSiteAddress,
+                                            Callee,
+                                            CalledSymbol);
+  CallSiteInfoCache.emplace(Key, Result);
+  return Result;
 }
 
 } // namespace efa
@@ -22,6 +22,7 @@
 
 #include "revng/ABI/DefaultFunctionPrototype.h"
 #include "revng/ABI/FunctionType/Layout.h"
+#include "revng/ABI/FunctionType/LayoutCache.h"
 #include "revng/ADT/LazySmallBitVector.h"
 #include "revng/ADT/SmallMap.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
@@ -61,6 +62,14 @@ private:
   pipeline::LoadExecutionContextPass &LECP;
   GeneratedCodeBasicInfo &GCBI;
 
+  /// The registers used by the prototypes of the function being processed and
+  /// of its callees, each of which is usually called more than once
+  abi::FunctionType::LayoutCache Layouts;
+
+  /// The CSV of each register (nullptr if there is none), to avoid looking it
+  /// up by name for each argument and return value of every call
+  std::map<model::Register::Values, GlobalVariable *> CSVs;
+
 public:
   EnforceABI(llvm::ModulePass &Pass,
              const model::Binary &Binary,
@@ -102,6 +111,10 @@ private:
                          FunctionCallee Callee,
                          const efa::BasicBlock &CallSiteBlock,
                          const efa::CallEdge &CallSite);
+
+  GlobalVariable *tryGetCSV(model::Register::Values Register);
+  Value *loadCSVOrUndef(IRBuilder<> &Builder, model::Register::Values Register);
+  std::pair<Type *, Constant *> getCSVOrUndef(model::Register::Values Register);
 };
 
 template<>
@@ -134,7 +147,7 @@ bool EnforceABI::prologue() {
 
     const auto *ProtoT = Binary.prototypeOrDefault(FunctionModel.prototype());
     revng_assert(ProtoT != nullptr);
-    auto UsedRegisters = abi::FunctionType::usedRegisters(*ProtoT);
+    auto UsedRegisters = Layouts.usedRegisters(*ProtoT);
     Function *NewFunction = recreateFunction(*OldFunction, UsedRegisters);
 
     // EnforceABI currently does not support execution
@@ -153,12 +166,16 @@ bool EnforceABI::runOnFunction(const model::Function &FunctionModel,
                                llvm::Function &OldFunction) {
   revng_assert(not FunctionModel.name().empty());
   auto OldFunctionName = getLLVMFunctionName(FunctionModel);
+
+  // Each function is a separate read tracking scope: the reads of the model
+  // made while computing the cached results would not be attributed to it
+  Layouts.clear();
   OldFunctions.push_back(&OldFunction);
 
   // Recreate the function with the right prototype and the function prologue
   const auto *ProtoT = Binary.prototypeOrDefault(FunctionModel.prototype());
   revng_assert(ProtoT != nullptr);
-  auto UsedRegisters = abi::FunctionType::usedRegisters(*ProtoT);
+  auto UsedRegisters = Layouts.usedRegisters(*ProtoT);
   Function *NewFunction = getOrCreateNewFunction(OldFunction, UsedRegisters);
 
   // Collect function calls
@@ -265,31 +282,35 @@ Function *EnforceABI::recreateFunction(Function &OldFunction,
   return Result;
 }
 
-static GlobalVariable *tryGetCSV(Module *M, model::Register::Values Register) {
-  auto Name = model::Register::getCSVName(Register);
-  return M->getGlobalVariable(Name, true);
+GlobalVariable *EnforceABI::tryGetCSV(model::Register::Values Register) {
+  auto [It, New] = CSVs.try_emplace(Register, nullptr);
+  if (New) {
+    auto Name = model::Register::getCSVName(Register);
+    It->second = M.getGlobalVariable(Name, true);
+  }
+
+  return It->second;
 }
 
-static Value *loadCSVOrUndef(IRBuilder<> &Builder,
-                             Module *M,
-                             model::Register::Values Register) {
-  GlobalVariable *CSV = tryGetCSV(M, Register);
+Value *EnforceABI::loadCSVOrUndef(IRBuilder<> &Builder,
+                                  model::Register::Values Register) {
+  GlobalVariable *CSV = tryGetCSV(Register);
   if (CSV == nullptr) {
     auto Size = model::Register::getSize(Register);
-    auto *Type = IntegerType::get(M->getContext(), Size * 8);
+    auto *Type = IntegerType::get(M.getContext(), Size * 8);
     return UndefValue::get(Type);
   } else {
     return createLoad(Builder, CSV);
   }
 }
 
-static std::pair<Type *, Constant *>
-getCSVOrUndef(Module *M, model::Register::Values Register) {
-  GlobalVariable *CSV = tryGetCSV(M, Register);
+std::pair<Type *, Constant *>
+EnforceABI::getCSVOrUndef(model::Register::Values Register) {
+  GlobalVariable *CSV = tryGetCSV(Register);
   if (CSV == nullptr) {
     auto Size = model::Register::getSize(Register);
-    auto *Type = IntegerType::get(M->getContext(), Size * 8);
-    return { Type, UndefValue::get(PointerType::get(M->getContext(), 0)) };
+    auto *Type = IntegerType::get(M.getContext(), Size * 8);
+    return { Type, UndefValue::get(PointerType::get(M.getContext(), 0)) };
   } else {
     return { CSV->getValueType(), CSV };
   }
@@ -304,9 +325,9 @@ void EnforceABI::createPrologue(Function *NewFunction,
   // We sort arguments by their CSV name
   auto [ArgumentRegisters, ReturnValueRegisters] = UsedRegisters;
   for (model::Register::Values Register : ArgumentRegisters)
-    ArgumentCSVs.push_back(getCSVOrUndef(&M, Register).second);
+    ArgumentCSVs.push_back(getCSVOrUndef(Register).second);
   for (model::Register::Values Register : ReturnValueRegisters)
-    ReturnCSVs.push_back(getCSVOrUndef(&M, Register));
+    ReturnCSVs.push_back(getCSVOrUndef(Register));
 
   // Store arguments to CSVs
   BasicBlock &Entry = NewFunction->getEntryBlock();
@@ -366,7 +387,7 @@ void EnforceABI::handleRegularFunctionCall(const MetaAddress &CallerAddress,
     const model::Function &ModelFunc = Binary.Functions().at(CalleeAddress);
     const auto *Prototype = Binary.prototypeOrDefault(ModelFunc.prototype());
     revng_assert(Prototype != nullptr);
-    auto UsedRegisters = abi::FunctionType::usedRegisters(*Prototype);
+    auto UsedRegisters = Layouts.usedRegisters(*Prototype);
     Callee = getOrCreateNewFunction(*Callee, UsedRegisters);
   }
 
@@ -431,7 +452,7 @@ CallInst *EnforceABI::generateCall(IRBuilder<> &Builder,
 
   auto *Prototype = getPrototype(Binary, Entry, CallSiteBlock.ID(), CallSite);
   revng_assert(Prototype != nullptr);
-  auto Registers = abi::FunctionType::usedRegisters(*Prototype);
+  auto Registers = Layouts.usedRegisters(*Prototype);
 
   bool IsIndirect = (Callee.getCallee() == FunctionDispatcher);
   if (IsIndirect) {
@@ -452,10 +473,10 @@ CallInst *EnforceABI::generateCall(IRBuilder<> &Builder,
   // Collect arguments and returns
   //
   for (model::Register::Values Register : Registers.Arguments)
-    Arguments.push_back(loadCSVOrUndef(Builder, &M, Register));
+    Arguments.push_back(loadCSVOrUndef(Builder, Register));
 
   for (model::Register::Values Register : Registers.ReturnValues)
-    ReturnCSVs.push_back(getCSVOrUndef(&M, Register).second);
+    ReturnCSVs.push_back(getCSVOrUndef(Register).second);
 
   //
   // Produce the call
@@ -30,17 +30,34 @@ private:
   LLVMContext &C;
   SmallDenseSet<Function *, 8> Recursive;
 
+  /// Helpers in bottom-up call graph order: callees come before callers
+  SmallVector<Function *, 32> Helpers;
+
 public:
   InlineHelpers(Module &M) : C(M.getContext()) {
     using namespace llvm;
     llvm::CallGraph CG(M);
-    for (auto It = scc_begin(&CG), End = scc_end(&CG); It != End; ++It)
-      if (It.hasCycle())
-        for (auto &Node : *It)
-          if (Function *F = Node->getFunction())
-            Recursive.insert(F);
+    for (auto It = scc_begin(&CG), End = scc_end(&CG); It != End; ++It) {
+      for (auto &Node : *It) {
+        Function *F = Node->getFunction();
+        if (F == nullptr)
+          continue;
+
+        if (It.hasCycle())
+          Recursive.insert(F);
+        else if (shouldInline(F))
+          Helpers.push_back(F);
+      }
+    }
   }
 
+  /// Inline into each helper the helpers it calls, once for all.
+  ///
+  /// Since the helpers are visited bottom-up, each callee has already been
+  /// flattened when it's inlined: after this, a single round of inlining
+  /// is enough for any function calling the helpers.
+  void flattenHelpers();
+
   void run(Function *F);
 
 private:
@@ -51,7 +68,7 @@ private:
 };
 
 bool InlineHelpers::shouldInline(Function *F) const {
-  if (F == nullptr)
+  if (F == nullptr or F->isDeclaration())
     return false;
 
   if (Recursive.count(F) != 0)
@@ -104,6 +121,13 @@ static void dropDebugOrPseudoInst(Function *F) {
   }
 }
 
+void InlineHelpers::flattenHelpers() {
+  for (Function *Helper : Helpers) {
+    doInline(Helper);
+    dropDebugOrPseudoInst(Helper);
+  }
+}
+
 void InlineHelpers::run(Function *F) {
   // Fixed-point inlining
   while (doInline(F))
@@ -118,10 +142,14 @@ bool InlineHelpersPass::runOnModule(llvm::Module &M) {
     if (FunctionTags::Isolated.isTagOf(&F))
       Isolated.push_back(&F);
 
+  // Inlining into the isolated functions doesn't change which helpers are
+  // recursive: inspect the call graph only once
+  InlineHelpers IH(M);
+  IH.flattenHelpers();
+
   llvm::Task T(Isolated.size(), "Inline helpers");
   for (Function *F : Isolated) {
     T.advance(F->getName());
-    InlineHelpers IH(*F->getParent());
     IH.run(F);
   }
 
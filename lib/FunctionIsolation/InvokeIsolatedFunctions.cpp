@@ -9,7 +9,7 @@
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
-#include "revng/ABI/FunctionType/Layout.h"
+#include "revng/ABI/FunctionType/LayoutCache.h"
 #include "revng/FunctionIsolation/InvokeIsolatedFunctions.h"
 #include "revng/Model/IRHelpers.h"
 #include "revng/Pipeline/AllRegistries.h"
@@ -69,6 +69,10 @@ private:
   GeneratedCodeBasicInfo &GCBI;
   FunctionMap Map;
 
+  /// Most of the functions share a handful of prototypes
+  abi::FunctionType::LayoutCache Layouts;
+  std::map<model::Register::Values, GlobalVariable *> CSVs;
+
 public:
   InvokeIsolatedFunctions(const model::Binary &Binary,
                           Function *RootFunction,
@@ -97,6 +101,17 @@ public:
     }
   }
 
+  GlobalVariable *getCSV(model::Register::Values Register) {
+    GlobalVariable *&Result = CSVs[Register];
+    if (Result == nullptr) {
+      auto Name = model::Register::getCSVName(Register);
+      Result = M->getGlobalVariable(Name, true);
+      revng_assert(Result != nullptr);
+    }
+
+    return Result;
+  }
+
   /// Create the basic blocks that are hit on exit after an invoke instruction
   BasicBlock *createInvokeReturnBlock() {
     // Create the first block
@@ -183,15 +198,10 @@ public:
       SmallVector<Value *, 4> Arguments;
       if (F->getFunctionType()->getNumParams() > 0) {
         auto ThePrototype = Binary.prototypeOrDefault(ModelF->prototype());
-        auto Layout = abi::FunctionType::Layout::make(*ThePrototype);
-        for (const auto &ArgumentLayout : Layout.Arguments) {
-          for (model::Register::Values Register : ArgumentLayout.Registers) {
-            auto Name = model::Register::getCSVName(Register);
-            GlobalVariable *CSV = M->getGlobalVariable(Name, true);
-            revng_assert(CSV != nullptr);
-            Arguments.push_back(createLoad(Builder, CSV));
-          }
-        }
+        auto Registers = Layouts.usedRegisters(*ThePrototype);
+        for (model::Register::Values Register : Registers.Arguments)
+          Arguments.push_back(createLoad(Builder, getCSV(Register)));
+        revng_assert(Arguments.size() == F->getFunctionType()->getNumParams());
       }
 
       // Emit the invoke instruction, propagating debug info
@@ -214,11 +224,15 @@ bool InvokeIsolatedFunctionsPass::runOnModule(Module &M) {
   if (not M.getFunction("root") or M.getFunction("root")->isDeclaration())
     return false;
 
-  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  auto &GCBIPass = getAnalysis<GeneratedCodeBasicInfoWrapperPass>();
+  auto &GCBI = GCBIPass.getGCBI();
   const auto &ModelWrapper = getAnalysis<LoadModelWrapperPass>().get();
   const model::Binary &Binary = *ModelWrapper.getReadOnlyModel();
   InvokeIsolatedFunctions TheFunction(Binary, M.getFunction("root"), GCBI);
   TheFunction.run();
 
+  // root has been rewritten, the cached GCBI no longer describes it
+  GCBIPass.invalidateCache();
+
   return true;
 }
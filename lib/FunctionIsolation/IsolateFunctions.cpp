@@ -6,6 +6,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/ADT/STLExtras.h"
@@ -485,21 +487,35 @@ inline auto toVector(R &&Range) {
 
 using FSOracle = efa::FunctionSummaryOracle;
 
+/// Outlines functions from root, one at a time
+///
+/// Each function gets a fresh oracle: the oracle lazily imports from the model
+/// what it's asked about, and these reads have to be attributed to the function
+/// being outlined. The outliner, whose construction scans the whole root, is
+/// instead shared.
 class FunctionOutliner {
 private:
-  efa::FunctionSummaryOracle Oracle;
+  llvm::Module &M;
+  const model::Binary &Binary;
+  GeneratedCodeBasicInfo &GCBI;
+  std::optional<efa::FunctionSummaryOracle> Oracle;
   efa::Outliner Outliner;
 
 public:
   FunctionOutliner(llvm::Module &M,
                    const model::Binary &Binary,
                    GeneratedCodeBasicInfo &GCBI) :
+    M(M),
+    Binary(Binary),
+    GCBI(GCBI),
     Oracle(FSOracle::importWithoutPrototypes(M, GCBI, Binary)),
-    Outliner(M, GCBI, Oracle) {}
+    Outliner(M, GCBI, *Oracle) {}
 
 public:
   efa::OutlinedFunction outline(MetaAddress Entry,
                                 efa::CallHandler *TheCallHandler) {
+    Oracle.emplace(FSOracle::importWithoutPrototypes(M, GCBI, Binary));
+    Outliner.setOracle(*Oracle);
     return Outliner.outline(Entry, TheCallHandler);
   }
 };
@@ -576,6 +592,8 @@ void IsolateFunctionsImpl::run() {
                          .filter(revng::kinds::Isolated);
 
   Task IsolateTask(RequestedTargets.size(), "Isolating functions");
+  std::optional<FunctionOutliner> Outliner;
+  Outliner.emplace(*TheModule, Binary, GCBI);
   for (const pipeline::Target &Target : RequestedTargets) {
     IsolateTask.advance(Target.serialize(), true);
     Context.getContext().pushReadFields();
@@ -594,8 +612,7 @@ void IsolateFunctionsImpl::run() {
 
     // Outline the function (later on we'll steal its body and move it into F)
     CallIsolatedFunction CallHandler(*this, FM);
-    FunctionOutliner Outliner(*TheModule, Binary, GCBI);
-    OutlinedFunction Outlined = Outliner.outline(Entry, &CallHandler);
+    OutlinedFunction Outlined = Outliner->outline(Entry, &CallHandler);
 
     handleUnexpectedPCCloned(Outlined);
 
@@ -614,6 +631,9 @@ void IsolateFunctionsImpl::run() {
     Context.getContext().popReadFields();
   }
 
+  // Drop the temporary functions created by the outliner
+  Outliner.reset();
+
   T.advance("Verify module", true);
   revng::verify(TheModule);
 
@@ -721,7 +741,8 @@ bool IF::runOnModule(Module &TheModule) {
     return false;
 
   //  Retrieve analyses
-  auto &GCBI = getAnalysis<GeneratedCodeBasicInfoWrapperPass>().getGCBI();
+  auto &GCBIPass = getAnalysis<GeneratedCodeBasicInfoWrapperPass>();
+  auto &GCBI = GCBIPass.getGCBI();
   const auto &ModelWrapper = getAnalysis<LoadModelWrapperPass>().get();
   const model::Binary &Binary = *ModelWrapper.getReadOnlyModel();
 
@@ -733,6 +754,9 @@ bool IF::runOnModule(Module &TheModule) {
            getAnalysis<pipeline::LoadExecutionContextPass>());
   Impl.run();
 
+  // root has been pruned, the cached GCBI no longer describes it
+  GCBIPass.invalidateCache();
+
   return false;
 }
 
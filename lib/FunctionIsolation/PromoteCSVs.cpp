@@ -7,6 +7,7 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SetVector.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/InstIterator.h"
 
 #include "revng/ADT/GenericGraph.h"
 #include "revng/BasicAnalyses/GeneratedCodeBasicInfo.h"
@@ -59,6 +60,12 @@ public:
 };
 
 class PromoteCSVs final : public pipeline::FunctionPassImpl {
+private:
+  /// The calls to helpers of a function that need to be wrapped, in order
+  struct CallsToWrap : public FunctionAnalysisResult {
+    std::vector<CallInst *> Calls;
+  };
+
 private:
   StructInitializers Initializers;
   OpaqueFunctionsPool<StringRef> CSVInitializers;
@@ -66,6 +73,9 @@ private:
   SetVector<GlobalVariable *> CSVs;
   model::Architecture::Values Architecture;
 
+  /// The opaque initializer of each CSV representing an ABI register
+  std::map<GlobalVariable *, Function *> InitializerForCSV;
+
 public:
   PromoteCSVs(ModulePass &Pass, const model::Binary &Binary, Module &M);
 
@@ -77,6 +87,13 @@ public:
 
   bool epilogue() final { return false; }
 
+  /// Looking for the calls to wrap only involves the function itself and the
+  /// declarations of the callees
+  bool isFunctionLocal() const final { return true; }
+
+  std::unique_ptr<FunctionAnalysisResult>
+  analyzeFunction(const llvm::Function &F) const final;
+
   static void getAnalysisUsage(llvm::AnalysisUsage &AU) {
     AU.addRequired<GeneratedCodeBasicInfoWrapperPass>();
   }
@@ -92,7 +109,7 @@ private:
 
   CSVsUsageMap getUsedCSVs(ArrayRef<CallInst *> CallsRange);
 
-  void wrapCallsToHelpers(Function *F);
+  void wrapCallsToHelpers(ArrayRef<CallInst *> ToWrap);
 };
 
 PromoteCSVs::PromoteCSVs(ModulePass &Pass,
@@ -123,6 +140,29 @@ PromoteCSVs::PromoteCSVs(ModulePass &Pass,
       if (FunctionTags::OpaqueCSVValue.isTagOf(F))
         CSVInitializers.record(CSV->getName(), F);
   }
+
+  // Get/create initializers
+  QuickMetadata QMD(M.getContext());
+  for (GlobalVariable *CSV : CSVs) {
+    // Initialize all allocas with opaque, CSV-specific values
+    Type *CSVType = CSV->getValueType();
+    llvm::StringRef CSVName = CSV->getName();
+    using namespace model::Register;
+    Values Register = fromCSVName(CSVName, Architecture);
+    if (Register != Invalid) {
+      auto *Initializer = CSVInitializers.get(CSVName,
+                                              CSVType,
+                                              {},
+                                              Twine("_init_") + CSVName);
+
+      if (not Initializer->hasMetadata("revng.abi_register")) {
+        Initializer->setMetadata("revng.abi_register",
+                                 QMD.tuple(getName(Register)));
+      }
+
+      InitializerForCSV[CSV] = Initializer;
+    }
+  }
 }
 
 // TODO: assign alias information
@@ -285,32 +325,6 @@ void PromoteCSVs::promoteCSVs(Function *F) {
   // Create an alloca for each CSV and replace all uses of CSVs with the
   // corresponding allocas
   BasicBlock &Entry = F->getEntryBlock();
-  QuickMetadata QMD(F->getParent()->getContext());
-
-  // Get/create initializers
-  std::map<Function *, GlobalVariable *> CSVForInitializer;
-  std::map<GlobalVariable *, Function *> InitializerForCSV;
-  for (GlobalVariable *CSV : CSVs) {
-    // Initialize all allocas with opaque, CSV-specific values
-    Type *CSVType = CSV->getValueType();
-    llvm::StringRef CSVName = CSV->getName();
-    using namespace model::Register;
-    Values Register = fromCSVName(CSVName, Architecture);
-    if (Register != Invalid) {
-      auto *Initializer = CSVInitializers.get(CSVName,
-                                              CSVType,
-                                              {},
-                                              Twine("_init_") + CSVName);
-
-      if (not Initializer->hasMetadata("revng.abi_register")) {
-        Initializer->setMetadata("revng.abi_register",
-                                 QMD.tuple(getName(Register)));
-      }
-
-      CSVForInitializer[Initializer] = CSV;
-      InitializerForCSV[CSV] = Initializer;
-    }
-  }
 
   // Collect existing CSV allocas
 
@@ -325,34 +339,45 @@ void PromoteCSVs::promoteCSVs(Function *F) {
   // alloca and save it in CSVMaps.
   std::map<GlobalVariable *, AllocaInst *> CSVAllocas;
   for (GlobalVariable *CSV : CSVs) {
-    AllocaInst *Alloca = nullptr;
+    // Create the alloca
+    Type *CSVType = CSV->getValueType();
+    auto *Alloca = AllocaBuilder.CreateAlloca(CSVType, nullptr, CSV->getName());
+    CSVAllocas[CSV] = Alloca;
+
+    // Check if already have an initializer
+    Value *Initializer = nullptr;
+    auto It = InitializerForCSV.find(CSV);
+    if (It != InitializerForCSV.end())
+      Initializer = InitializersBuilder.CreateCall(It->second);
+    else
+      Initializer = CSV->getInitializer();
+
+    // Initialize the alloca
+    InitializersBuilder.CreateStore(Initializer, Alloca);
+  }
 
-    auto It = CSVAllocas.find(CSV);
-    if (It != CSVAllocas.end()) {
-      Alloca = It->second;
-    } else {
-      // Create the alloca
-      Type *CSVType = CSV->getValueType();
-      Alloca = AllocaBuilder.CreateAlloca(CSVType, nullptr, CSV->getName());
-
-      // Check if already have an initializer
-      Value *Initializer = nullptr;
-      auto It = InitializerForCSV.find(CSV);
-      if (It != InitializerForCSV.end()) {
-        Function *InitializerFunction = InitializerForCSV.at(CSV);
-        Initializer = InitializersBuilder.CreateCall(InitializerFunction);
-      } else {
-        Initializer = CSV->getInitializer();
+  // Replace users. The CSVs are used by all the functions in the module:
+  // visit the instructions of F once, rather than all the uses of each CSV.
+  // Uses through constant expressions are rare, leave them to
+  // replaceAllUsesInFunctionWith.
+  SmallPtrSet<GlobalVariable *, 4> UsedThroughConstantExpressions;
+  for (Instruction &I : instructions(F)) {
+    for (Use &U : I.operands()) {
+      if (auto *CSV = dyn_cast<GlobalVariable>(U.get())) {
+        auto It = CSVAllocas.find(CSV);
+        if (It != CSVAllocas.end())
+          U.set(It->second);
+      } else if (auto *CE = dyn_cast<ConstantExpr>(U.get())) {
+        auto *CSV = dyn_cast<GlobalVariable>(CE->getOperand(0));
+        if (CE->isCast() and CSV != nullptr and CSVAllocas.contains(CSV))
+          UsedThroughConstantExpressions.insert(CSV);
       }
-
-      // Initialize the alloca
-      InitializersBuilder.CreateStore(Initializer, Alloca);
     }
-
-    // Replace users
-    replaceAllUsesInFunctionWith(F, CSV, Alloca);
   }
 
+  for (GlobalVariable *CSV : UsedThroughConstantExpressions)
+    replaceAllUsesInFunctionWith(F, CSV, CSVAllocas.at(CSV));
+
   // Drop separators
   eraseFromParent(Separator);
 
@@ -398,7 +423,7 @@ static void addEdge(FunctionNode *Source, FunctionNode *Destination) {
   Source->addSuccessor(Destination);
 }
 
-static bool needsWrapper(Function *F) {
+static bool needsWrapper(const Function *F) {
   // Ignore lifted functions and functions that have already been wrapped
   {
     using namespace FunctionTags;
@@ -536,22 +561,28 @@ ArrayRef<T> oneElement(T &Element) {
   return ArrayRef(&Element, 1);
 }
 
-void PromoteCSVs::wrapCallsToHelpers(Function *F) {
-  std::vector<CallInst *> ToWrap;
-  for (BasicBlock &BB : *F) {
-    for (Instruction &I : BB) {
+std::unique_ptr<PromoteCSVs::FunctionAnalysisResult>
+PromoteCSVs::analyzeFunction(const Function &F) const {
+  auto Result = std::make_unique<CallsToWrap>();
+  for (const BasicBlock &BB : F) {
+    for (const Instruction &I : BB) {
       if (auto *Call = dyn_cast<CallInst>(&I)) {
-        Function *Callee = getCallee(Call);
+        const Function *Callee = getCallee(Call);
 
         // Ignore calls to isolated functions
         if (Callee == nullptr or not needsWrapper(Callee))
           continue;
 
-        ToWrap.emplace_back(Call);
+        // runOnFunction is going to modify the function anyway
+        Result->Calls.emplace_back(const_cast<CallInst *>(Call));
       }
     }
   }
 
+  return Result;
+}
+
+void PromoteCSVs::wrapCallsToHelpers(ArrayRef<CallInst *> ToWrap) {
   auto UsedCSVs = getUsedCSVs(ToWrap);
 
   for (CallInst *Call : ToWrap) {
@@ -571,7 +602,9 @@ bool PromoteCSVs::runOnFunction(const model::Function &ModelFunction,
 
   if (not Function.isDeclaration()) {
     // Wrap calls to wrappers
-    wrapCallsToHelpers(&Function);
+    auto *Analysis = getAnalysisResult<CallsToWrap>();
+    revng_assert(Analysis != nullptr);
+    wrapCallsToHelpers(Analysis->Calls);
 
     // (Re-)promote CSVs
     promoteCSVs(&Function);
@@ -4,13 +4,165 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <bit>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/STLExtras.h"
+
 #include "revng/GraphLayout/SugiyamaStyle/Compute.h"
 
 #include "InternalCompute.h"
 
 namespace sugiyama = yield::layout::sugiyama;
-bool sugiyama::detail::computeImpl(InternalGraph &Graph,
-                                   const Configuration &Configuration) {
+
+namespace {
+
+/// Everything the result of the layout depends on: the configuration, the
+/// sizes of the nodes and the edges between them.
+struct Shape {
+  sugiyama::Configuration Configuration;
+  std::vector<Size> Nodes;
+  std::vector<std::tuple<size_t, size_t, size_t>> Edges;
+
+  Shape(InternalGraph &Graph, const sugiyama::Configuration &C) :
+    Configuration(C) {
+    for (auto *Node : Graph.nodes()) {
+      revng_assert(!Node->IsVirtual);
+      revng_assert(Node->index() == Nodes.size());
+      Nodes.emplace_back(Node->Size);
+    }
+
+    for (auto *From : Graph.nodes())
+      for (auto [To, Label] : From->successor_edges())
+        Edges.emplace_back(From->index(), To->index(), Label->index());
+  }
+
+  bool operator==(const Shape &Other) const {
+    auto SameSize = [](const Size &LHS, const Size &RHS) {
+      return LHS.W == RHS.W && LHS.H == RHS.H;
+    };
+    return Configuration == Other.Configuration
+           && llvm::equal(Nodes, Other.Nodes, SameSize) && Edges == Other.Edges;
+  }
+
+  uint64_t hash() const {
+    // Floats have no `hash_value`, hash their representation instead
+    auto Bits = [](float Value) { return std::bit_cast<uint32_t>(Value); };
+
+    const auto &C = Configuration;
+    llvm::hash_code Result = llvm::hash_combine(C.Ranking,
+                                                C.Orientation,
+                                                C.UseOrthogonalBends,
+                                                C.PreserveLinearSegments,
+                                                C.UseSimpleTreeOptimization,
+                                                Bits(C.VirtualNodeWeight),
+                                                Bits(C.NodeMarginSize),
+                                                Bits(C.EdgeMarginSize));
+    for (const Size &NodeSize : Nodes)
+      Result = llvm::hash_combine(Result, Bits(NodeSize.W), Bits(NodeSize.H));
+    for (const auto &[From, To, Index] : Edges)
+      Result = llvm::hash_combine(Result, From, To, Index);
+    return Result;
+  }
+};
+
+/// The result of the layout of a graph: the centers of its nodes, by index,
+/// and the paths of its edges, by index.
+struct CachedLayout {
+  std::vector<Point> Centers;
+  std::vector<std::optional<yield::layout::Path>> Paths;
+
+  static CachedLayout extract(InternalGraph &Graph, size_t NodeCount) {
+    CachedLayout Result;
+    Result.Centers.resize(NodeCount);
+    for (auto *Node : Graph.nodes())
+      if (!Node->IsVirtual)
+        Result.Centers.at(Node->index()) = Node->Center;
+
+    for (auto *From : Graph.nodes()) {
+      for (auto [To, Label] : From->successor_edges()) {
+        if (Label->isVirtual())
+          continue;
+
+        revng_assert(Label->IsRouted);
+        if (Label->index() >= Result.Paths.size())
+          Result.Paths.resize(Label->index() + 1);
+        Result.Paths[Label->index()] = Label->getPath();
+      }
+    }
+
+    return Result;
+  }
+
+  void apply(InternalGraph &Graph) const {
+    for (auto *Node : Graph.nodes())
+      Node->Center = Centers.at(Node->index());
+
+    for (auto *From : Graph.nodes()) {
+      for (auto [To, Label] : From->successor_edges()) {
+        const auto &Path = Paths.at(Label->index());
+        revng_assert(Path.has_value());
+        Label->getPath() = *Path;
+        Label->IsRouted = true;
+      }
+    }
+  }
+};
+
+/// Remembers the most recent layouts, so that graphs that only changed in
+/// ways that don't affect the layout (e.g., a rename that doesn't change the
+/// size of any node) don't need to be laid out again.
+///
+/// All the methods can be called concurrently.
+class LayoutCache {
+private:
+  static constexpr size_t MaximumSize = 256;
+
+  std::mutex Mutex;
+  std::unordered_multimap<uint64_t, std::pair<Shape, CachedLayout>> Layouts;
+  std::deque<uint64_t> InsertionOrder;
+
+public:
+  static LayoutCache &get() {
+    static LayoutCache Instance;
+    return Instance;
+  }
+
+public:
+  std::optional<CachedLayout> find(const Shape &Key, uint64_t Hash) {
+    std::lock_guard Lock(Mutex);
+    auto [Begin, End] = Layouts.equal_range(Hash);
+    for (auto It = Begin; It != End; ++It)
+      if (It->second.first == Key)
+        return It->second.second;
+    return std::nullopt;
+  }
+
+  void insert(Shape &&Key, uint64_t Hash, CachedLayout &&Result) {
+    std::lock_guard Lock(Mutex);
+    if (InsertionOrder.size() == MaximumSize) {
+      // Drop the oldest entry
+      auto [Begin, End] = Layouts.equal_range(InsertionOrder.front());
+      revng_assert(Begin != End);
+      Layouts.erase(Begin);
+      InsertionOrder.pop_front();
+    }
+
+    Layouts.emplace(Hash, std::pair{ std::move(Key), std::move(Result) });
+    InsertionOrder.push_back(Hash);
+  }
+};
+
+} // namespace
+
+static bool computeUncached(InternalGraph &Graph,
+                            const sugiyama::Configuration &Configuration) {
   using RS = sugiyama::RankingStrategy;
 
   if (Configuration.Orientation == sugiyama::Orientation::LeftToRight
@@ -75,3 +227,20 @@ bool sugiyama::detail::computeImpl(InternalGraph &Graph,
 
   return Res;
 }
+
+bool sugiyama::detail::computeImpl(InternalGraph &Graph,
+                                   const Configuration &Configuration) {
+  Shape Key(Graph, Configuration);
+  uint64_t Hash = Key.hash();
+  if (auto Cached = LayoutCache::get().find(Key, Hash)) {
+    Cached->apply(Graph);
+    return true;
+  }
+
+  if (!computeUncached(Graph, Configuration))
+    return false;
+
+  auto Result = CachedLayout::extract(Graph, Key.Nodes.size());
+  LayoutCache::get().insert(std::move(Key), Hash, std::move(Result));
+  return true;
+}
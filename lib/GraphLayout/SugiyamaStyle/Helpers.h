@@ -5,8 +5,14 @@
 //
 
 #include <compare>
+#include <deque>
+#include <iterator>
 #include <map>
+#include <optional>
+#include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "revng/GraphLayout/SugiyamaStyle/Compute.h"
@@ -62,6 +68,151 @@ struct hash<::NodeView> {
 };
 } // namespace std
 
+/// A map from the nodes of an `InternalGraph` to `T`, stored in an array
+/// indexed by `InternalNode::index()` instead of a hash table: node indexes are
+/// dense, so lookups need neither hashing nor chasing a per-entry allocation.
+///
+/// As for `std::unordered_map`, insertions never invalidate references to the
+/// values. Unlike it, iteration follows node indexes, so it does not depend on
+/// where the nodes happen to be allocated.
+template<typename T>
+class NodeMap {
+public:
+  using value_type = std::pair<NodeView, T>;
+
+private:
+  std::deque<std::optional<value_type>> Slots;
+  size_t Count = 0;
+
+private:
+  template<bool IsConst>
+  class IteratorImpl {
+  private:
+    using MapType = std::conditional_t<IsConst, const NodeMap, NodeMap>;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference = std::conditional_t<IsConst,
+                                         const value_type &,
+                                         value_type &>;
+    using pointer = std::remove_reference_t<reference> *;
+
+  private:
+    MapType *Map = nullptr;
+    size_t Index = 0;
+
+  public:
+    IteratorImpl() = default;
+    IteratorImpl(MapType *Map, size_t Index) : Map(Map), Index(Index) {
+      skipEmpty();
+    }
+
+  public:
+    reference operator*() const { return *Map->Slots[Index]; }
+    pointer operator->() const { return &*Map->Slots[Index]; }
+
+    IteratorImpl &operator++() {
+      ++Index;
+      skipEmpty();
+      return *this;
+    }
+    IteratorImpl operator++(int) {
+      IteratorImpl Old = *this;
+      ++*this;
+      return Old;
+    }
+
+    /// Iterators past the last slot are all equal, even if the map has grown
+    /// since they have been created
+    bool operator==(const IteratorImpl &Other) const {
+      return Index == Other.Index or (isEnd() and Other.isEnd());
+    }
+
+  private:
+    bool isEnd() const { return Map == nullptr or Index >= Map->Slots.size(); }
+
+    void skipEmpty() {
+      while (not isEnd() and not Map->Slots[Index].has_value())
+        ++Index;
+    }
+  };
+
+public:
+  using iterator = IteratorImpl<false>;
+  using const_iterator = IteratorImpl<true>;
+
+public:
+  size_t size() const { return Count; }
+  bool empty() const { return Count == 0; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, Slots.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, Slots.size()); }
+
+  bool contains(NodeView Node) const {
+    size_t Index = Node->index();
+    return Index < Slots.size() and Slots[Index].has_value();
+  }
+
+  iterator find(NodeView Node) {
+    return contains(Node) ? iterator(this, Node->index()) : end();
+  }
+  const_iterator find(NodeView Node) const {
+    return contains(Node) ? const_iterator(this, Node->index()) : end();
+  }
+
+  T &at(NodeView Node) {
+    revng_assert(contains(Node));
+    return Slots[Node->index()]->second;
+  }
+  const T &at(NodeView Node) const {
+    revng_assert(contains(Node));
+    return Slots[Node->index()]->second;
+  }
+
+  template<typename... ArgumentTypes>
+  std::pair<iterator, bool> try_emplace(NodeView Node,
+                                        ArgumentTypes &&...Arguments) {
+    size_t Index = Node->index();
+    if (Index >= Slots.size())
+      Slots.resize(Index + 1);
+
+    bool IsNew = not Slots[Index].has_value();
+    if (IsNew) {
+      Slots[Index].emplace(std::piecewise_construct,
+                           std::forward_as_tuple(Node),
+                           std::forward_as_tuple(std::forward<ArgumentTypes>(
+                             Arguments)...));
+      ++Count;
+    }
+
+    return { iterator(this, Index), IsNew };
+  }
+
+  std::pair<iterator, bool> emplace(NodeView Node, T Value) {
+    return try_emplace(Node, std::move(Value));
+  }
+
+  T &operator[](NodeView Node) { return try_emplace(Node).first->second; }
+
+  size_t erase(NodeView Node) {
+    if (not contains(Node))
+      return 0;
+
+    Slots[Node->index()].reset();
+    --Count;
+    return 1;
+  }
+
+  void clear() {
+    Slots.clear();
+    Count = 0;
+  }
+};
+
 /// A view onto an edge as a extension of a known node.
 /// This is useful as a `second` value for a map where the `first` one
 /// is the `From` node.
@@ -112,7 +263,7 @@ public:
 };
 
 /// An internal data structure used to pass node ranks around.
-using RankContainer = std::unordered_map<NodeView, Rank>;
+using RankContainer = NodeMap<Rank>;
 
 /// An internal data structure used to pass around information about
 /// the layers specific nodes belong to.
@@ -120,7 +271,7 @@ using LayerContainer = std::vector<std::vector<NodeView>>;
 
 /// An internal data structure used to pass around information about the way
 /// graph is split onto segments.
-using SegmentContainer = std::unordered_map<NodeView, NodeView>;
+using SegmentContainer = NodeMap<NodeView>;
 
 /// It's used to describe the position of a single node within the layered grid.
 struct LogicalPosition {
@@ -130,7 +281,7 @@ struct LogicalPosition {
 
 /// It's used to describe the complete layout by storing the exact
 /// position of each node relative to all the others.
-using LayoutContainer = std::unordered_map<NodeView, LogicalPosition>;
+using LayoutContainer = NodeMap<LogicalPosition>;
 
 /// An internal data structure used to pass around information about the lanes
 /// used to route edges.
@@ -139,10 +290,10 @@ struct LaneContainer {
   std::vector<std::map<EdgeView, Rank>> Horizontal;
 
   /// Stores edges entering a node groped by the node they enter.
-  std::unordered_map<NodeView, std::map<EdgeDestinationView, Rank>> Entries;
+  NodeMap<std::map<EdgeDestinationView, Rank>> Entries;
 
   /// Stores edges leaving a node grouped by the node they leave.
-  std::unordered_map<NodeView, std::map<EdgeDestinationView, Rank>> Exits;
+  NodeMap<std::map<EdgeDestinationView, Rank>> Exits;
 };
 
 /// An internal data structure used to represent a corner. It stores three
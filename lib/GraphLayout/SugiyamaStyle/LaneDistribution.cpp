@@ -71,10 +71,10 @@ LaneContainer assignLanes(InternalGraph &Graph,
   std::vector<llvm::SmallVector<SortableEdge, 16>> Horizontal;
 
   // Stores edges entering a node grouped by the node they enter.
-  std::unordered_map<NodeView, llvm::SmallVector<EdgeDestination, 4>> Entries;
+  NodeMap<llvm::SmallVector<EdgeDestination, 4>> Entries;
 
   // Stores edges leaving a node grouped by the node they leave.
-  std::unordered_map<NodeView, llvm::SmallVector<EdgeDestination, 4>> Exits;
+  NodeMap<llvm::SmallVector<EdgeDestination, 4>> Exits;
 
   // Calculate the number of lanes needed for each layer
   for (auto *From : Graph.nodes()) {
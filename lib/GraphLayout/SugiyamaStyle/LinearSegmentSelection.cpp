@@ -78,7 +78,7 @@ SegmentContainer selectLinearSegments(InternalGraph &Graph,
 
   auto &ParentMap = Heads;
 
-  std::unordered_map<NodeView, size_t> OrderLookupTable;
+  NodeMap<size_t> OrderLookupTable;
   for (size_t Index = 0; Index < Order.size(); ++Index)
     OrderLookupTable[Order[Index]] = Index;
 
@@ -4,9 +4,17 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <map>
+#include <unordered_map>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
 
 #include "InternalCompute.h"
 
@@ -84,100 +92,123 @@ static size_t countNodes(const LayerContainer &Layers) {
   return Counter;
 }
 
-struct CrossingCalculator {
-public:
-  const LayerContainer &Layers; // A view onto the layered nodes.
-  const RankContainer &Ranks; // A view onto node rankings.
-  RankContainer &Permutation; // A view onto a current permutation.
-
-private:
-  /// Counts the number of edge crossings given two nodes and
-  /// a map that represents which nodes in an adjacent layer
-  /// are connected to one of the given nodes.
-  static Rank countImpl(NodeView KNode,
-                        NodeView LNode,
-                        const std::map<Rank, bool> &SortedLayer,
-                        const RankContainer &Permutation) {
-    Rank CrossingCount = 0;
-    if (SortedLayer.size() > 0) {
-      bool KSide = SortedLayer.begin()->second;
-      bool KLeft = Permutation.at(KNode) < Permutation.at(LNode);
-      int64_t PreviousSegmentSize = 0;
-      int64_t CurrentSegmentSize = 0;
-
-      for (auto &[Position, Side] : SortedLayer) {
-        if (Side == KSide) {
-          CurrentSegmentSize += 1;
-        } else {
-          if (KSide && KLeft)
-            CrossingCount += PreviousSegmentSize * CurrentSegmentSize;
-
-          PreviousSegmentSize = CurrentSegmentSize;
-          CurrentSegmentSize = 1;
-          KSide = Side;
-        }
+namespace {
+
+/// A dense view of a `LayerContainer`: nodes are referred to by their index in
+/// `Nodes`, so that everything the permutation selection needs to know about
+/// them is stored in contiguous arrays instead of node-keyed maps.
+struct DenseLayers {
+  std::vector<NodeView> Nodes;
+  std::vector<Rank> LayerOf;
+  std::vector<size_t> ClusterOf;
+  std::vector<llvm::SmallVector<size_t, 2>> Predecessors;
+  std::vector<llvm::SmallVector<size_t, 2>> Successors;
+
+  /// The nodes of each layer
+  std::vector<std::vector<size_t>> Layers;
+
+  template<typename ClusterType>
+  DenseLayers(const LayerContainer &Input, const ClusterType &Cluster) {
+    std::unordered_map<NodeView, size_t> Indices;
+    Layers.resize(Input.size());
+    for (Rank Layer = 0; Layer < Input.size(); ++Layer) {
+      for (NodeView Node : Input[Layer]) {
+        Indices[Node] = Nodes.size();
+        Layers[Layer].push_back(Nodes.size());
+        Nodes.push_back(Node);
+        LayerOf.push_back(Layer);
+        ClusterOf.push_back(Cluster(Node));
       }
-
-      if (KSide && KLeft)
-        CrossingCount += PreviousSegmentSize * CurrentSegmentSize;
     }
 
-    return CrossingCount;
+    Predecessors.resize(Nodes.size());
+    Successors.resize(Nodes.size());
+    for (size_t Node = 0; Node < Nodes.size(); ++Node) {
+      for (auto *Predecessor : Nodes[Node]->predecessors())
+        Predecessors[Node].push_back(Indices.at(Predecessor));
+      for (auto *Successor : Nodes[Node]->successors())
+        Successors[Node].push_back(Indices.at(Successor));
+    }
   }
 
-public:
-  // Counts the crossings.
-  Rank countCrossings(Rank CurrentRank, NodeView KNode, NodeView LNode) {
-    revng_assert(CurrentRank < Layers.size());
-
-    Rank CrossingCount = 0;
-
-    if (CurrentRank != 0) {
-      std::map<Rank, bool> SortedLayer;
-      for (auto *Predecessor : KNode->predecessors())
-        if (Ranks.at(Predecessor) == CurrentRank - 1)
-          SortedLayer[Permutation.at(Predecessor)] = true;
-
-      for (auto *Predecessor : LNode->predecessors())
-        if (Ranks.at(Predecessor) == CurrentRank - 1)
-          SortedLayer[Permutation.at(Predecessor)] = false;
-
-      CrossingCount += countImpl(KNode, LNode, SortedLayer, Permutation);
+  /// \return the layers as nodes, each of them sorted by \p Position
+  LayerContainer toLayers(const std::vector<size_t> &Position) const {
+    LayerContainer Result(Layers.size());
+    for (Rank Layer = 0; Layer < Layers.size(); ++Layer) {
+      std::vector<size_t> Sorted = Layers[Layer];
+      llvm::sort(Sorted, [&Position](size_t LHS, size_t RHS) {
+        return Position[LHS] < Position[RHS];
+      });
+      for (size_t Node : Sorted)
+        Result[Layer].push_back(Nodes[Node]);
     }
+    return Result;
+  }
+};
 
-    if (CurrentRank != Layers.size() - 1) {
-      std::map<Rank, bool> SortedLayer;
-      for (auto *Successor : KNode->successors())
-        if (Ranks.at(Successor) == CurrentRank + 1)
-          SortedLayer[Permutation.at(Successor)] = true;
-
-      for (auto *Successor : LNode->successors())
-        if (Ranks.at(Successor) == CurrentRank + 1)
-          SortedLayer[Permutation.at(Successor)] = false;
-
-      CrossingCount += countImpl(KNode, LNode, SortedLayer, Permutation);
+} // namespace
+
+/// Counts the edge crossings between each pair of adjacent layers, using the
+/// accumulator tree described in "Simple and Efficient Bilayer Cross Counting"
+/// by W. Barth, M. Juenger and P. Mutzel (2002), in O(E log V).
+///
+/// \note each layer in \p Graph is expected to be sorted by \p Position.
+static size_t countCrossings(const DenseLayers &Graph,
+                             const std::vector<size_t> &Position) {
+  size_t Result = 0;
+  std::vector<size_t> Ends;
+  std::vector<size_t> Tree;
+  for (Rank Layer = 0; Layer + 1 < Graph.Layers.size(); ++Layer) {
+    // Positions of the lower ends of the edges, sorted lexicographically by
+    // the positions of both ends
+    Ends.clear();
+    for (size_t Node : Graph.Layers[Layer]) {
+      size_t First = Ends.size();
+      for (size_t Successor : Graph.Successors[Node])
+        if (Graph.LayerOf[Successor] == Layer + 1)
+          Ends.push_back(Position[Successor]);
+      std::sort(Ends.begin() + First, Ends.end());
     }
 
-    return CrossingCount;
+    size_t FirstLeaf = 1;
+    while (FirstLeaf < Graph.Layers[Layer + 1].size())
+      FirstLeaf *= 2;
+    Tree.assign(2 * FirstLeaf - 1, 0);
+    FirstLeaf -= 1;
+
+    // Each edge crosses all the edges already in the tree ending to its right
+    for (size_t End : Ends) {
+      size_t Index = End + FirstLeaf;
+      ++Tree[Index];
+      while (Index > 0) {
+        if (Index % 2 == 1)
+          Result += Tree[Index + 1];
+        Index = (Index - 1) / 2;
+        ++Tree[Index];
+      }
+    }
   }
 
-  /// Computes the difference in the crossing count
-  /// based on the node positions (e.g. how much better/worse the crossing
-  /// count becomes if a permutation were to be applied).
-  RankDelta computeDelta(Rank CurrentRank, NodeView KNode, NodeView LNode) {
-    auto KIterator = Permutation.find(KNode);
-    auto LIterator = Permutation.find(LNode);
-    revng_assert(KIterator != Permutation.end());
-    revng_assert(LIterator != Permutation.end());
-
-    auto OriginalCrossingCount = countCrossings(CurrentRank, KNode, LNode);
-    std::swap(KIterator->second, LIterator->second);
-    auto NewCrossingCount = countCrossings(CurrentRank, KNode, LNode);
-    std::swap(KIterator->second, LIterator->second);
-
-    return RankDelta(NewCrossingCount) - RankDelta(OriginalCrossingCount);
+  return Result;
+}
+
+/// \return the number of pairs `(A, B)`, with `A` in \p Left and `B` in
+///         \p Right, such that `A > B`, i.e., the number of crossings between
+///         the edges of two nodes if the one connected to \p Left is on the
+///         left of the one connected to \p Right.
+///
+/// \note both \p Left and \p Right are expected to be sorted.
+static size_t countInversions(llvm::ArrayRef<size_t> Left,
+                              llvm::ArrayRef<size_t> Right) {
+  size_t Result = 0;
+  size_t Smaller = 0;
+  for (size_t A : Left) {
+    while (Smaller < Right.size() && Right[Smaller] < A)
+      ++Smaller;
+    Result += Smaller;
   }
-};
+  return Result;
+}
 
 /// Minimizes crossing count using a simple hill climbing algorithm.
 /// The function can be sped up by providing an initial permutation found
@@ -201,19 +232,17 @@ LayerContainer minimizeCrossingCount(const RankContainer &Ranks,
   // a hand-picked graph that's moderately fast to lay out.
   constexpr size_t ReferenceComplexity = 200000;
 
+  // Past this many iterations the improvements are negligible, and the swaps
+  // might as well be going around in circles.
+  constexpr size_t MaximumIterationCount = 64;
+
   // To compare the current graph to the reference, we need to calculate
   // the `IterationComplexity` for the current graph:
   //
   // IterationComplexity = \sum_{i=0}^{Layers.size()}Layers.at(i).size()^2
   size_t IterationComplexity = 0;
-
-  RankContainer Permutation;
-  for (auto &Layer : Layers) {
-    size_t LayerSize = Layer.size();
-    for (size_t I = 0; I < LayerSize; I++)
-      Permutation[Layer[I]] = I;
-    IterationComplexity += LayerSize * LayerSize;
-  }
+  for (auto &Layer : Layers)
+    IterationComplexity += Layer.size() * Layer.size();
 
   // The idea is that iterations get progressively more expensive as graph gets
   // wider. So it's hard for us to justify running any on a graph that's bigger
@@ -226,178 +255,202 @@ LayerContainer minimizeCrossingCount(const RankContainer &Ranks,
   // small, each iteration is cheap and we can afford to do many iterations.
   // On the other hand, if the graph is large, the ratio rapidly goes to zero
   // and the iteration count drop to just a single one.
-  //
-  // TODO: we likely want to put a hardcoded cap on the max number of iterations
-  size_t IterationCount = ReferenceComplexity / IterationComplexity;
-
-  auto Comparator = [&Cluster, &Permutation](NodeView A, NodeView B) {
-    if (Cluster(A) == Cluster(B))
-      return Permutation.at(A) < Permutation.at(B);
-    else
-      return Cluster(A) < Cluster(B);
+  if (IterationComplexity == 0)
+    return std::move(Layers);
+  size_t IterationCount = std::min(ReferenceComplexity / IterationComplexity,
+                                   MaximumIterationCount);
+  if (IterationCount == 0)
+    return std::move(Layers);
+
+  DenseLayers Graph(Layers, Cluster);
+  std::vector<size_t> Position(Graph.Nodes.size());
+  for (auto &Layer : Graph.Layers)
+    for (size_t I = 0; I < Layer.size(); I++)
+      Position[Layer[I]] = I;
+
+  auto SortLayer = [&Graph, &Position](std::vector<size_t> &Layer) {
+    llvm::sort(Layer, [&Graph, &Position](size_t A, size_t B) {
+      if (Graph.ClusterOf[A] == Graph.ClusterOf[B])
+        return Position[A] < Position[B];
+      else
+        return Graph.ClusterOf[A] < Graph.ClusterOf[B];
+    });
+    for (size_t I = 0; I < Layer.size(); I++)
+      Position[Layer[I]] = I;
   };
 
-  CrossingCalculator Calculator{ Layers, Ranks, Permutation };
+  // The sorted positions of the neighbors of each node of the current layer,
+  // in the previous and in the next layer
+  std::vector<std::vector<size_t>> Above;
+  std::vector<std::vector<size_t>> Below;
+
+  // `Crossings[K * Size + L]` is the number of crossings between the edges
+  // of the K-th and the L-th node of the current layer, if the K-th is to the
+  // left of the L-th. It only depends on the adjacent layers, which don't
+  // change while the current one is being optimized.
+  std::vector<size_t> Crossings;
+
+  // Swaps are chosen looking at a pair of nodes at a time, therefore an
+  // iteration is not guaranteed to improve on the previous one: keep the best
+  size_t BestCrossingCount = std::numeric_limits<size_t>::max();
+  std::vector<size_t> BestPosition;
+
   for (size_t Iteration = 0; Iteration < IterationCount; ++Iteration) {
     bool DidAnySwaps = false;
-    for (size_t Index = 0; Index < Layers.size(); ++Index) {
-      if (size_t CurrentLayerSize = Layers[Index].size(); CurrentLayerSize) {
-        std::sort(Layers[Index].begin(), Layers[Index].end(), Comparator);
-        for (size_t NodeIndex = 0; NodeIndex < CurrentLayerSize; ++NodeIndex)
-          Permutation[Layers[Index][NodeIndex]] = NodeIndex;
-
-        // Minimize WRT of the previous layer
-        // This can be expensive so we limit the number of times we repeat it.
-        for (size_t NodeIndex = 0; NodeIndex < CurrentLayerSize; ++NodeIndex) {
-          RankDelta ChoosenDelta = 0;
-          std::pair<Rank, Rank> ChoosenNodes;
-
-          for (size_t K = 0; K < CurrentLayerSize; ++K) {
-            for (size_t L = K + 1; L < CurrentLayerSize; ++L) {
-              auto KNode = Layers[Index][K];
-              auto LNode = Layers[Index][L];
-              auto Delta = Calculator.computeDelta(Index, KNode, LNode);
-              if (Delta < ChoosenDelta) {
-                ChoosenDelta = Delta;
-                ChoosenNodes = { K, L };
-              }
-            }
-          }
+    for (Rank Index = 0; Index < Graph.Layers.size(); ++Index) {
+      auto &Layer = Graph.Layers[Index];
+      size_t Size = Layer.size();
+      if (Size == 0)
+        continue;
+
+      SortLayer(Layer);
+
+      Above.assign(Size, {});
+      Below.assign(Size, {});
+      for (size_t K = 0; K < Size; ++K) {
+        for (size_t Predecessor : Graph.Predecessors[Layer[K]])
+          if (Graph.LayerOf[Predecessor] + 1 == Index)
+            Above[K].push_back(Position[Predecessor]);
+        for (size_t Successor : Graph.Successors[Layer[K]])
+          if (Graph.LayerOf[Successor] == Index + 1)
+            Below[K].push_back(Position[Successor]);
+        llvm::sort(Above[K]);
+        llvm::sort(Below[K]);
+      }
 
-          if (ChoosenDelta == 0)
-            break;
+      Crossings.assign(Size * Size, 0);
+      for (size_t K = 0; K < Size; ++K) {
+        for (size_t L = K + 1; L < Size; ++L) {
+          Crossings[K * Size + L] = countInversions(Above[K], Above[L])
+                                    + countInversions(Below[K], Below[L]);
+          Crossings[L * Size + K] = countInversions(Above[L], Above[K])
+                                    + countInversions(Below[L], Below[K]);
+        }
+      }
 
-          auto KNode = Layers[Index][ChoosenNodes.first];
-          auto LNode = Layers[Index][ChoosenNodes.second];
-          std::swap(Permutation.at(KNode), Permutation.at(LNode));
-          DidAnySwaps = true;
+      // Minimize WRT of the adjacent layers
+      // This can be expensive so we limit the number of times we repeat it.
+      for (size_t NodeIndex = 0; NodeIndex < Size; ++NodeIndex) {
+        RankDelta ChoosenDelta = 0;
+        std::pair<Rank, Rank> ChoosenNodes;
+
+        for (size_t K = 0; K < Size; ++K) {
+          for (size_t L = K + 1; L < Size; ++L) {
+            RankDelta KLeft = Crossings[K * Size + L];
+            RankDelta LLeft = Crossings[L * Size + K];
+            bool IsKLeft = Position[Layer[K]] < Position[Layer[L]];
+            auto Delta = IsKLeft ? LLeft - KLeft : KLeft - LLeft;
+            if (Delta < ChoosenDelta) {
+              ChoosenDelta = Delta;
+              ChoosenNodes = { K, L };
+            }
+          }
         }
 
-        std::sort(Layers[Index].begin(), Layers[Index].end(), Comparator);
-        for (size_t NodeIndex = 0; NodeIndex < CurrentLayerSize; ++NodeIndex)
-          Permutation[Layers[Index][NodeIndex]] = NodeIndex;
+        if (ChoosenDelta == 0)
+          break;
+
+        std::swap(Position[Layer[ChoosenNodes.first]],
+                  Position[Layer[ChoosenNodes.second]]);
+        DidAnySwaps = true;
       }
+
+      SortLayer(Layer);
+    }
+
+    if (size_t Count = countCrossings(Graph, Position);
+        Count < BestCrossingCount) {
+      BestCrossingCount = Count;
+      BestPosition = Position;
     }
 
     if (!DidAnySwaps)
       break;
   }
 
-  LayerContainer Result;
-  for (auto &[Node, Rank] : Ranks) {
-    if (Rank >= Result.size())
-      Result.resize(Rank + 1);
-    Result[Rank].emplace_back(Node);
-  }
-  for (auto &Layer : Result)
-    std::sort(Layer.begin(),
-              Layer.end(),
-              [&Permutation](const auto &LHS, const auto &RHS) {
-                return Permutation.at(LHS) < Permutation.at(RHS);
-              });
-  return Result;
+  return Graph.toLayers(BestPosition);
 }
 
-template<bool PreOrPost, typename ClusterType>
-class BarycentricComparator {
-public:
-  BarycentricComparator(const RankContainer &Ranks,
-                        const RankContainer &Positions,
-                        const LayerContainer &Layers,
-                        const ClusterType &Cluster) :
-    Ranks(Ranks), Positions(Positions), Layers(Layers), Cluster(Cluster) {}
-
-  bool operator()(NodeView LHS, NodeView RHS) {
-    if (int A = Cluster(LHS), B = Cluster(RHS); A == B) {
-      auto BarycenterA = get(LHS), BarycenterB = get(RHS);
-      if (std::isnan(BarycenterA) || std::isnan(BarycenterB))
-        return LHS->index() < RHS->index();
-      else
-        return BarycenterA < BarycenterB;
-    } else {
-      return A < B;
-    }
-  }
+/// Sorts the permutations using the barycentric sorting described in
+/// "A fast heuristic for hierarchical Manhattan layout" by G. Sander (2005)
+template<typename ClusterType>
+LayerContainer sortNodes(const RankContainer &Ranks,
+                         const size_t IterationCount,
+                         const ClusterType &Cluster,
+                         LayerContainer &&Layers) {
+  revng_assert(countNodes(Layers) == Ranks.size());
+  if (IterationCount == 0)
+    return std::move(Layers);
 
-protected:
-  double get(NodeView Node) {
-    auto Iterator = Barycenters.lower_bound(Node);
-    if (Iterator == Barycenters.end() || Node < Iterator->first)
-      Iterator = Barycenters.insert(Iterator, { Node, compute(Node) });
-    return Iterator->second;
-  }
+  DenseLayers Graph(Layers, Cluster);
+  size_t NodeCount = Graph.Nodes.size();
+
+  // Only the nodes in the layers visited so far have a position
+  std::vector<size_t> Position(NodeCount);
+  std::vector<bool> HasPosition(NodeCount, false);
+  std::vector<double> Barycenter(NodeCount);
 
-  double computeImpl(NodeView Node, auto NeighborContainerView) {
-    if (NeighborContainerView.empty())
-      return std::numeric_limits<double>::quiet_NaN();
+  auto ComputeBarycenter = [&](size_t Node, const auto &Neighbors) {
+    constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+    if (Neighbors.empty())
+      return NaN;
 
     double Accumulator = 0;
     size_t Counter = 0;
 
-    double CurrentLayerSize = Layers.at(Ranks.at(Node)).size();
-    for (auto *Neighbor : NeighborContainerView) {
-      if (auto It = Positions.find(Neighbor); It != Positions.end()) {
-        auto NeighborLayerSize = Layers.at(Ranks.at(Neighbor)).size();
-        Accumulator += (CurrentLayerSize / NeighborLayerSize) * It->second;
+    double CurrentLayerSize = Graph.Layers[Graph.LayerOf[Node]].size();
+    for (size_t Neighbor : Neighbors) {
+      if (HasPosition[Neighbor]) {
+        auto NeighborLayerSize = Graph.Layers[Graph.LayerOf[Neighbor]].size();
+        Accumulator += (CurrentLayerSize / NeighborLayerSize)
+                       * Position[Neighbor];
         ++Counter;
       }
     }
 
     if (Counter == 0)
-      return std::numeric_limits<double>::quiet_NaN();
+      return NaN;
     return Accumulator / Counter;
-  }
-
-  double compute(NodeView Node) {
-    if constexpr (PreOrPost)
-      return computeImpl(Node, Node->predecessors());
-    else
-      return computeImpl(Node, Node->successors());
-  }
-
-private:
-  std::map<NodeView, double> Barycenters;
-  const RankContainer &Ranks;
-  const RankContainer &Positions;
-  const LayerContainer &Layers;
-  const ClusterType &Cluster;
-};
-
-/// Sorts the permutations using the barycentric sorting described in
-/// "A fast heuristic for hierarchical Manhattan layout" by G. Sander (2005)
-template<typename ClusterType>
-LayerContainer sortNodes(const RankContainer &Ranks,
-                         const size_t IterationCount,
-                         const ClusterType &Cluster,
-                         LayerContainer &&Layers) {
-  revng_assert(countNodes(Layers) == Ranks.size());
+  };
 
-  RankContainer Positions;
-  for (size_t Iteration = 0; Iteration < IterationCount; Iteration++) {
-    for (size_t Index = 0; Index < Layers.size(); ++Index) {
-      for (size_t Counter = 0; auto Node : Layers[Index])
-        Positions[Node] = Counter++;
+  auto Comparator = [&Graph, &Barycenter](size_t LHS, size_t RHS) {
+    if (Graph.ClusterOf[LHS] == Graph.ClusterOf[RHS]) {
+      auto BarycenterA = Barycenter[LHS], BarycenterB = Barycenter[RHS];
+      if (std::isnan(BarycenterA) || std::isnan(BarycenterB))
+        return Graph.Nodes[LHS]->index() < Graph.Nodes[RHS]->index();
+      else
+        return BarycenterA < BarycenterB;
+    } else {
+      return Graph.ClusterOf[LHS] < Graph.ClusterOf[RHS];
+    }
+  };
 
-      using PBC = BarycentricComparator<true, decltype(Cluster)>;
-      PBC Comparator(Ranks, Positions, Layers, Cluster);
-      std::sort(Layers[Index].begin(), Layers[Index].end(), Comparator);
+  auto SortLayer = [&](std::vector<size_t> &Layer, bool PreOrPost) {
+    for (size_t Counter = 0; size_t Node : Layer) {
+      Position[Node] = Counter++;
+      HasPosition[Node] = true;
+    }
 
-      for (size_t Counter = 0; auto Node : Layers[Index])
-        Positions[Node] = Counter++;
+    for (size_t Node : Layer) {
+      if (PreOrPost)
+        Barycenter[Node] = ComputeBarycenter(Node, Graph.Predecessors[Node]);
+      else
+        Barycenter[Node] = ComputeBarycenter(Node, Graph.Successors[Node]);
     }
-    for (size_t Index = Layers.size() - 1; Index != size_t(-1); --Index) {
-      for (size_t Counter = 0; auto Node : Layers[Index])
-        Positions[Node] = Counter++;
+    std::sort(Layer.begin(), Layer.end(), Comparator);
 
-      using PBC = BarycentricComparator<false, decltype(Cluster)>;
-      PBC Comparator(Ranks, Positions, Layers, Cluster);
-      std::sort(Layers[Index].begin(), Layers[Index].end(), Comparator);
+    for (size_t Counter = 0; size_t Node : Layer)
+      Position[Node] = Counter++;
+  };
 
-      for (size_t Counter = 0; auto Node : Layers[Index])
-        Positions[Node] = Counter++;
-    }
+  for (size_t Iteration = 0; Iteration < IterationCount; Iteration++) {
+    for (size_t Index = 0; Index < Graph.Layers.size(); ++Index)
+      SortLayer(Graph.Layers[Index], true);
+    for (size_t Index = Graph.Layers.size() - 1; Index != size_t(-1); --Index)
+      SortLayer(Graph.Layers[Index], false);
   }
-  return std::move(Layers);
+
+  return Graph.toLayers(Position);
 }
 
 template<RankingStrategy Strategy>
@@ -411,10 +464,6 @@ LayerContainer selectPermutation(InternalGraph &Graph,
   // backwards edge routing. Update ranks accordingly.
   auto InitialLayers = optimizeLayers(Graph, Ranks);
 
-  auto MinimalCrossingLayers = minimizeCrossingCount(Ranks,
-                                                     *Classifier,
-                                                     std::move(InitialLayers));
-
   // Iteration counts are chosen arbitrarily. If the computation time was not
   // an issue, we could keep iterating until convergence, but since it's not
   // the case, we have to choose a stopping point.
@@ -422,6 +471,10 @@ LayerContainer selectPermutation(InternalGraph &Graph,
   // The iteration count logarithmically depends on the layer number.
   size_t Iterations = std::log2(InitialLayers.size());
 
+  auto MinimalCrossingLayers = minimizeCrossingCount(Ranks,
+                                                     *Classifier,
+                                                     std::move(InitialLayers));
+
   if constexpr (Strategy == RankingStrategy::BreadthFirstSearch) {
     // \todo: Since layers are wide, the inner loops inside both crossing
     // minimization and node sorting are more costly on average.
@@ -19,6 +19,7 @@
 #include "llvm/IR/Value.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/Progress.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Debug.h"
@@ -1480,7 +1481,7 @@ private:
   CallPtrSet CrossedCallSites;
   using WorkListVector = std::vector<WorkItem>;
   WorkListVector WorkList;
-  ConstValuePtrSet InExploration;
+  llvm::SmallPtrSet<const Value *, 16> InExploration;
 
   // Helper folders
   AddSubOffsetFolder AddSubFolder;
@@ -1537,7 +1538,7 @@ private:
     StoreCallSiteOffsets = {};
     CrossedCallSites = {};
     WorkList = {};
-    InExploration = {};
+    InExploration.clear();
   }
 
   /// Analyzes the access to env performed by \p I, saving results according to
@@ -1740,7 +1741,7 @@ private:
 
   void push(WorkItem &&Item) {
     InExploration.insert(Item.val());
-    WorkList.push_back(Item);
+    WorkList.push_back(std::move(Item));
     CSVAccessLog.indent(2);
   }
 
@@ -2247,13 +2248,12 @@ void CPUSAOA::computeAggregatedOffsets() {
   CallSiteOffsetMap &CallSiteOffsets = IsLoad ? CallSiteLoadOffsets :
                                                 CallSiteStoreOffsets;
   AccessOffsetMap &AccessOffsets = IsLoad ? LoadOffsets : StoreOffsets;
+  const DataLayout &DL = M.getDataLayout();
 
   for (std::pair<Value *const, CallSiteOffsetMap> &ACSO : AccessCSOffsets) {
     // This is the load/store that actually accesses the CPU State
     Value *I = ACSO.first;
 
-    auto DL = M.getDataLayout();
-
     bool IsInstr = isa<Instruction>(I);
     bool IsCorrectAccessType = IsLoad ? isa<LoadInst>(I) : isa<StoreInst>(I);
     bool IsCallToBuiltinMemcpy = callsBuiltinMemcpy(dyn_cast<Instruction>(I));
@@ -3172,8 +3172,12 @@ bool CPUStateAccessAnalysis::run() {
   Function *RootFunction = M.getFunction("root");
   revng_assert(RootFunction);
 
+  // One step per phase, to have their timings in the trace
+  Task T(5, "CPU state access analysis");
+
   // Preprocessing: detect all the functions that are directly reachable from
   // the RootFunction
+  T.advance("Reachable functions");
   auto ReachedFunctions = computeDirectlyReachableFunctions(RootFunction,
                                                             LoadMDKind,
                                                             StoreMDKind,
@@ -3187,6 +3191,7 @@ bool CPUStateAccessAnalysis::run() {
 
   // Start with a forward taint analysis, to detect all the tainted Values,
   // and all the tainted loads and stores.
+  T.advance("Taint analysis");
   CSVAccessLog << "Before Taint Analysis" << DoLog;
   const auto TaintResults = forwardTaintAnalysis(&M,
                                                  CPUStatePtr,
@@ -3222,6 +3227,7 @@ bool CPUStateAccessAnalysis::run() {
     revng_log(TaintLog, "=======================");
   }
 
+  T.advance("Offset analysis");
   CallSiteOffsetMap CallSiteLoadOffset;
   CallSiteOffsetMap CallSiteStoreOffset;
   auto AccessOffsetAnalysis = CPUSAOA(M,
@@ -3239,12 +3245,14 @@ bool CPUStateAccessAnalysis::run() {
                                       CallSiteStoreOffset);
   bool Found = AccessOffsetAnalysis.run();
 
+  T.advance("Attach metadata");
   if (Found) {
     QuickMetadata QMD(M.getContext());
     addAccessMetadata(CallSiteLoadOffset, Variables, QMD, LoadMDKind);
     addAccessMetadata(CallSiteStoreOffset, Variables, QMD, StoreMDKind);
   }
 
+  T.advance("Fix accesses");
   if (not Lazy) {
     CPUStateAccessFixer CSVAccessFixer(M,
                                        Variables,
@@ -17,7 +17,10 @@
 #include <vector>
 
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/IR/CFG.h"
 #include "llvm/IR/DiagnosticPrinter.h"
@@ -29,7 +32,11 @@
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
@@ -48,6 +55,10 @@
 #include "revng/Support/Debug.h"
 #include "revng/Support/FunctionTags.h"
 #include "revng/Support/ProgramCounterHandler.h"
+#include "revng/Support/Progress.h"
+#include "revng/Support/ResourceFinder.h"
+#include "revng/Support/SharedModules.h"
+#include "revng/Support/Statistics.h"
 
 #include "CodeGenerator.h"
 #include "ExternalJumpsHandler.h"
@@ -66,9 +77,20 @@ static cl::opt<bool> RecordPTC("record-ptc",
                                cl::desc("create metadata for PTC"),
                                cl::cat(MainCategory));
 
-static Logger<> PTCLog("ptc");
+static cl::opt<std::string> HelpersCache("helpers-cache",
+                                          cl::desc("directory where to cache "
+                                                   "the helpers module, once "
+                                                   "prepared for translation"),
+                                          cl::value_desc("directory"),
+                                          cl::cat(MainCategory));
+
+static DebugLogger PTCLog("ptc");
 static Logger<> Log("lift");
 
+/// How many times libtinycode has been asked to translate code at an address
+/// for the first time and how many times again, after a purge
+static CounterMap<std::string> PTCTranslations("ptc-translations");
+
 template<typename T, typename... ArgTypes>
 inline std::array<T, sizeof...(ArgTypes)> make_array(ArgTypes &&...Args) {
   return { { std::forward<ArgTypes>(Args)... } };
@@ -134,7 +156,7 @@ CodeGenerator::~CodeGenerator() = default;
 static std::unique_ptr<Module> parseIR(StringRef Path, LLVMContext &Context) {
   std::unique_ptr<Module> Result;
   SMDiagnostic Errors;
-  Result = parseIRFile(Path, Errors, Context);
+  Result = revng::parseSharedIRFile(Path, Errors, Context);
 
   if (Result.get() == nullptr) {
     Errors.print("revng", dbgs());
@@ -144,6 +166,58 @@ static std::unique_ptr<Module> parseIR(StringRef Path, LLVMContext &Context) {
   return Result;
 }
 
+/// \return the path where to cache the helpers module at \p Helpers, once
+///         prepared, or an empty string if caching is disabled
+static std::string getHelpersCachePath(StringRef Helpers) {
+  if (HelpersCache.empty())
+    return {};
+
+  auto MaybeBuffer = MemoryBuffer::getFile(Helpers);
+  if (not MaybeBuffer) {
+    revng_log(Log, "Cannot read " << Helpers << ", not caching the helpers");
+    return {};
+  }
+
+  // The preparation depends on the helpers, on the PTC library they come with,
+  // on the bitcode format and on the code preparing them, i.e., this build
+  SHA1 Hasher;
+  Hasher.update((*MaybeBuffer)->getBuffer());
+  Hasher.update(std::to_string(ptc.exception_index));
+  Hasher.update(LLVM_VERSION_STRING);
+  Hasher.update(revng::getComponentsHash());
+  std::string Hash = toHex(Hasher.final(), true);
+
+  SmallString<128> Result(HelpersCache);
+  llvm::sys::path::append(Result, "helpers-" + Hash + ".bc");
+  return Result.str().str();
+}
+
+/// Write \p Module to \p Path, atomically since other processes might be
+/// lifting at the same time
+static void writeHelpersCache(const Module &Module, StringRef Path) {
+  auto Fail = [&Path](std::error_code EC) {
+    revng_log(Log, "Could not write " << Path << ": " << EC.message());
+  };
+
+  if (auto EC = sys::fs::create_directories(sys::path::parent_path(Path)))
+    return Fail(EC);
+
+  int FD = -1;
+  SmallString<128> Temporary;
+  if (auto EC = sys::fs::createUniqueFile(Path + "-%%%%%%%%", FD, Temporary))
+    return Fail(EC);
+
+  {
+    raw_fd_ostream OS(FD, true);
+    WriteBitcodeToFile(Module, OS);
+  }
+
+  if (auto EC = sys::fs::rename(Temporary, Path)) {
+    sys::fs::remove(Temporary);
+    return Fail(EC);
+  }
+}
+
 CodeGenerator::CodeGenerator(const RawBinaryView &RawBinary,
                              llvm::Module *TheModule,
                              const TupleTree<model::Binary> &Model,
@@ -159,7 +233,14 @@ CodeGenerator::CodeGenerator(const RawBinaryView &RawBinary,
   OriginalInstrMDKind = Context.getMDKindID("oi");
   PTCInstrMDKind = Context.getMDKindID("pi");
 
-  HelpersModule = parseIR(Helpers, Context);
+  HelpersCachePath = getHelpersCachePath(Helpers);
+  if (not HelpersCachePath.empty() and sys::fs::exists(HelpersCachePath)) {
+    revng_log(Log, "Using the cached helpers module " << HelpersCachePath);
+    HelpersModule = parseIR(HelpersCachePath, Context);
+    HelpersArePrepared = true;
+  } else {
+    HelpersModule = parseIR(Helpers, Context);
+  }
 
   TheModule->setDataLayout(HelpersModule->getDataLayout());
 
@@ -583,39 +664,20 @@ bool CpuLoopExitPass::runOnModule(llvm::Module &M) {
   return true;
 }
 
-void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
-  using FT = FunctionType;
-
-  Task T(12, "Translation");
-
-  // Declare the abort function
-  auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
-  FunctionCallee AbortFunction = TheModule->getOrInsertFunction("abort",
-                                                                AbortTy);
-  {
-    auto *Abort = cast<Function>(skipCasts(AbortFunction.getCallee()));
-    FunctionTags::Exceptional.addTo(Abort);
-  }
+/// Prepare the helpers module for being linked in the lifted module
+static void prepareHelpers(Module &HelpersModule) {
+  LLVMContext &Context = HelpersModule.getContext();
 
   // Prepare the helper modules by transforming the cpu_loop function and
   // running SROA
-  T.advance("Prepare helpers module", true);
   legacy::PassManager CpuLoopPM;
   CpuLoopPM.add(new LoopInfoWrapperPass());
   CpuLoopPM.add(new CpuLoopFunctionPass(ptc.exception_index));
   CpuLoopPM.add(createSROAPass());
-  CpuLoopPM.run(*HelpersModule);
+  CpuLoopPM.run(HelpersModule);
 
   // Drop the main
-  eraseFromParent(HelpersModule->getFunction("main"));
-
-  // From syscall.c
-  new GlobalVariable(*TheModule,
-                     Type::getInt32Ty(Context),
-                     false,
-                     GlobalValue::CommonLinkage,
-                     ConstantInt::get(Type::getInt32Ty(Context), 0),
-                     StringRef("do_strace"));
+  eraseFromParent(HelpersModule.getFunction("main"));
 
   //
   // Handle some specific QEMU functions as no-ops or abort
@@ -638,7 +700,7 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
                                                     "qemu_thread_atexit_init",
                                                     "start_exclusive");
   for (auto Name : NoOpFunctionNames)
-    replaceFunctionWithRet(HelpersModule->getFunction(Name), 0);
+    replaceFunctionWithRet(HelpersModule.getFunction(Name), 0);
 
   // Transform in abort
 
@@ -657,18 +719,48 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
                                                      "do_arm_semihosting",
                                                      "EmulateAll");
   for (auto Name : AbortFunctionNames) {
-    Function *TheFunction = HelpersModule->getFunction(Name);
+    Function *TheFunction = HelpersModule.getFunction(Name);
     if (TheFunction != nullptr) {
-      revng_assert(HelpersModule->getFunction("abort") != nullptr);
+      revng_assert(HelpersModule.getFunction("abort") != nullptr);
       BasicBlock *NewBody = replaceFunction(TheFunction);
-      CallInst::Create(HelpersModule->getFunction("abort"), {}, NewBody);
+      CallInst::Create(HelpersModule.getFunction("abort"), {}, NewBody);
       new UnreachableInst(Context, NewBody);
     }
   }
 
-  replaceFunctionWithRet(HelpersModule->getFunction("page_check_range"), 1);
-  replaceFunctionWithRet(HelpersModule->getFunction("page_get_flags"),
+  replaceFunctionWithRet(HelpersModule.getFunction("page_check_range"), 1);
+  replaceFunctionWithRet(HelpersModule.getFunction("page_get_flags"),
                          0xffffffff);
+}
+
+void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
+  using FT = FunctionType;
+
+  Task T(12, "Translation");
+
+  // Declare the abort function
+  auto *AbortTy = FunctionType::get(Type::getVoidTy(Context), false);
+  FunctionCallee AbortFunction = TheModule->getOrInsertFunction("abort",
+                                                                AbortTy);
+  {
+    auto *Abort = cast<Function>(skipCasts(AbortFunction.getCallee()));
+    FunctionTags::Exceptional.addTo(Abort);
+  }
+
+  T.advance("Prepare helpers module", true);
+  if (not HelpersArePrepared) {
+    prepareHelpers(*HelpersModule);
+    if (not HelpersCachePath.empty())
+      writeHelpersCache(*HelpersModule, HelpersCachePath);
+  }
+
+  // From syscall.c
+  new GlobalVariable(*TheModule,
+                     Type::getInt32Ty(Context),
+                     false,
+                     GlobalValue::CommonLinkage,
+                     ConstantInt::get(Type::getInt32Ty(Context), 0),
+                     StringRef("do_strace"));
 
   //
   // Record globals for marking them as internal after linking
@@ -851,6 +943,8 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
 
   std::vector<BasicBlock *> Blocks;
 
+  std::set<MetaAddress> TranslatedAddresses;
+
   bool EndianessMismatch;
   {
     using namespace model::Architecture;
@@ -871,6 +965,12 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
 
   std::tie(VirtualAddress, Entry) = JumpTargets.peek();
 
+  // Totals reported in the trace, so that throughput can be measured against
+  // the duration of the lifting step
+  uint64_t TranslatedEntries = 0;
+  uint64_t TranslatedBytes = 0;
+  uint64_t TranslatedPTCInstructions = 0;
+
   while (Entry != nullptr) {
     LiftTask.advance(VirtualAddress.toString(), true);
 
@@ -901,9 +1001,15 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
       break;
     }
 
+    bool IsNew = TranslatedAddresses.insert(VirtualAddress).second;
+    PTCTranslations.push(IsNew ? "first" : "again");
+
     ConsumedSize = ptc.translate(VirtualAddress.address(),
                                  Type,
                                  InstructionList.get());
+    ++TranslatedEntries;
+    TranslatedBytes += ConsumedSize;
+    TranslatedPTCInstructions += InstructionList->instruction_count;
 
     if (ConsumedSize == 0) {
       Translator.emitNewPCCall(Builder, VirtualAddress, 1, nullptr);
@@ -1104,6 +1210,13 @@ void CodeGenerator::translate(optional<uint64_t> RawVirtualAddress) {
 
   LiftTask.complete();
 
+  // Attached to the "Lifting code" step
+  revng::addTraceArgument("translated-entries", TranslatedEntries);
+  revng::addTraceArgument("translated-bytes", TranslatedBytes);
+  revng::addTraceArgument("translated-ptc-instructions",
+                          TranslatedPTCInstructions);
+  revng::addTraceArgument("root-blocks", MainFunction->size());
+
   OI.drop();
 
   // Reorder basic blocks in RPOT
@@ -51,6 +51,11 @@ private:
   llvm::Module *TheModule;
   llvm::LLVMContext &Context;
   std::unique_ptr<llvm::Module> HelpersModule;
+  /// Where the prepared helpers module is cached, empty if caching is disabled
+  std::string HelpersCachePath;
+  /// True if HelpersModule has been loaded from the cache, i.e., it's ready to
+  /// be linked
+  bool HelpersArePrepared = false;
   std::unique_ptr<llvm::Module> EarlyLinkedModule;
   const TupleTree<model::Binary> &Model;
 
@@ -6,6 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <limits>
+
 #include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/Progress.h"
@@ -15,6 +18,7 @@
 #include "revng/Model/VerifyHelper.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/Statistics.h"
+#include "revng/Support/WordScan.h"
 
 #include "JumpTargetManager.h"
 #include "RootAnalyzer.h"
@@ -334,6 +338,49 @@ bool TDBP::runOnModule(Module &M) {
   return true;
 }
 
+void JumpTargetManager::indexRelocations() {
+  revng_assert(not RelocatedValuesReady);
+
+  auto Record = [this](MetaAddress Address,
+                       unsigned Size,
+                       MaterializedValue &&Value) {
+    auto It = RelocatedValues.try_emplace({ Address, Size }, Value, 0).first;
+    ++It->second.second;
+  };
+
+  // Dynamic functions-related relocations
+  for (const model::DynamicFunction &Function :
+       Model->ImportedDynamicFunctions()) {
+    // TODO: add this to model verify
+    revng_assert(not StringRef(Function.OriginalName()).contains('\0'));
+    for (const model::Relocation &Relocation : Function.Relocations()) {
+      auto Size = model::RelocationType::getSize(Relocation.Type());
+      APInt Addend(Size * 8, Relocation.Addend());
+      Record(Relocation.Address(),
+             Size,
+             MaterializedValue::fromSymbol(Function.OriginalName(), Addend));
+    }
+  }
+
+  // Segment-related relocations
+  for (const model::Segment &Segment : Model->Segments()) {
+    for (const model::Relocation &Relocation : Segment.Relocations()) {
+      MetaAddress Address = Segment.StartAddress() + Relocation.Addend();
+      if (Address.isValid()) {
+        auto Size = model::RelocationType::getSize(Relocation.Type());
+        APInt Value(Size * 8, Address.address());
+        Record(Relocation.Address(),
+               Size,
+               MaterializedValue::fromConstant(Value));
+      } else {
+        // TODO: log message
+      }
+    }
+  }
+
+  RelocatedValuesReady = true;
+}
+
 MaterializedValue JumpTargetManager::readFromPointer(MetaAddress LoadAddress,
                                                      unsigned LoadSize,
                                                      bool IsLittleEndian) {
@@ -351,48 +398,19 @@ MaterializedValue JumpTargetManager::readFromPointer(MetaAddress LoadAddress,
   //
   // Check relocations
   //
-  unsigned MatchCount = 0;
-  MaterializedValue Result;
-
-  // Check dynamic functions-related relocations
-  for (const model::DynamicFunction &Function :
-       Model->ImportedDynamicFunctions()) {
-    for (const model::Relocation &Relocation : Function.Relocations()) {
-      uint64_t Addend = Relocation.Addend();
-      auto RelocationSize = model::RelocationType::getSize(Relocation.Type());
-      if (LoadAddress == Relocation.Address() and LoadSize == RelocationSize) {
-        // TODO: add this to model verify
-        revng_assert(not StringRef(Function.OriginalName()).contains('\0'));
-        Result = MaterializedValue::fromSymbol(Function.OriginalName(),
-                                               NewAPInt(Addend));
-        ++MatchCount;
-      }
-    }
-  }
+  if (not RelocatedValuesReady)
+    indexRelocations();
 
-  // Check segment-related relocations
-  for (const model::Segment &Segment : Model->Segments()) {
-    for (const model::Relocation &Relocation : Segment.Relocations()) {
-      uint64_t Addend = Relocation.Addend();
-      auto RelocationSize = model::RelocationType::getSize(Relocation.Type());
-      if (LoadAddress == Relocation.Address() and LoadSize == RelocationSize) {
-        MetaAddress Address = Segment.StartAddress() + Addend;
-        if (Address.isValid()) {
-          Result = MaterializedValue::fromConstant(NewAPInt(Address.address()));
-          ++MatchCount;
-        } else {
-          // TODO: log message
-        }
-      }
+  auto It = RelocatedValues.find({ LoadAddress, LoadSize });
+  if (It != RelocatedValues.end()) {
+    auto &[Result, MatchCount] = It->second;
+    if (MatchCount == 1) {
+      return Result;
+    } else if (MatchCount > 1) {
+      // TODO: log message
     }
   }
 
-  if (MatchCount == 1) {
-    return Result;
-  } else if (MatchCount > 1) {
-    // TODO: log message
-  }
-
   // No labels found, fall back to read the raw value, if available
   auto MaybeValue = BinaryView.readInteger(LoadAddress,
                                            LoadSize,
@@ -503,30 +521,39 @@ void JumpTargetManager::findCodePointers(MetaAddress StartVirtualAddress,
                                          const unsigned char *Start,
                                          const unsigned char *End) {
   using support::endianness;
-  using support::endian::read;
-
-  constexpr auto Step = sizeof(value_type);
 
-  auto Cursor = Start;
+  // Most words are not pointers to code: discard those outside of the span of
+  // the executable ranges before building a MetaAddress out of them. The upper
+  // bound is inclusive, since it might be the end of a range with the Thumb
+  // bit set.
+  if (ExecutableRanges.begin() == ExecutableRanges.end())
+    return;
 
-  // Align the starting address: we want to scan one step at a time starting
-  // from an aligned size
-  auto Misalignment = StartVirtualAddress.address() % Step;
-  if (Misalignment != 0)
-    Cursor += Step - Misalignment;
+  uint64_t Lowest = std::numeric_limits<uint64_t>::max();
+  uint64_t Highest = 0;
+  for (const auto &[RangeStart, RangeEnd] : ExecutableRanges) {
+    Lowest = std::min(Lowest, RangeStart.address());
+    Highest = std::max(Highest, RangeEnd.address());
+  }
 
-  for (; Cursor < End - Step; Cursor += Step) {
-    auto Read = read<value_type, static_cast<endianness>(endian), 1>;
-    uint64_t RawValue = Read(Cursor);
+  auto Handle = [&](uint64_t Offset, uint64_t RawValue) {
     MetaAddress Value = fromPC(RawValue);
     if (Value.isInvalid())
-      continue;
+      return;
 
     BasicBlock *Result = registerJT(Value, JTReason::GlobalData);
 
     if (Result != nullptr)
-      UnusedCodePointers.insert(StartVirtualAddress + (Cursor - Start));
-  }
+      UnusedCodePointers.insert(StartVirtualAddress + Offset);
+  };
+
+  constexpr auto Endianness = static_cast<endianness>(endian);
+  forEachWordInRange<value_type, Endianness>(Start,
+                                             End,
+                                             StartVirtualAddress.address(),
+                                             Lowest,
+                                             Highest,
+                                             Handle);
 }
 
 /// Handle a new program counter. We might already have a basic block for that
@@ -600,58 +627,92 @@ void JumpTargetManager::registerInstruction(MetaAddress PC,
   revng_assert(Instruction->getParent() != nullptr);
 }
 
+Function *JumpTargetManager::newPCMarker() const {
+  // newpc is created during translation, look it up by name only until then
+  if (NewPCMarker == nullptr)
+    NewPCMarker = TheModule.getFunction("newpc");
+  return NewPCMarker;
+}
+
 // TODO: this is a candidate for BFSVisit
-std::pair<MetaAddress, uint64_t>
-JumpTargetManager::getPC(Instruction *TheInstruction) const {
+CallInst *JumpTargetManager::getEntryNewPC(BasicBlock *BB) const {
+  auto It = EntryNewPC.find(BB);
+  if (It != EntryNewPC.end())
+    return It->second;
+
+  Function *NewPC = newPCMarker();
+  revng_assert(NewPC != nullptr);
+
   CallInst *NewPCCall = nullptr;
   llvm::DenseSet<BasicBlock *> Visited;
-  std::queue<BasicBlock::reverse_iterator> WorkList;
-  if (TheInstruction->getIterator() == TheInstruction->getParent()->begin())
-    WorkList.push(--TheInstruction->getParent()->rend());
-  else
-    WorkList.push(++TheInstruction->getReverseIterator());
+  std::queue<BasicBlock *> WorkList;
+  auto EnqueuePredecessors = [&](BasicBlock *Successor) {
+    // Assert we didn't reach the almighty dispatcher
+    for (BasicBlock *Predecessor : predecessors(Successor))
+      revng_assert(not(isPartOfRootDispatcher(Predecessor)));
+
+    for (BasicBlock *Predecessor : predecessors(Successor)) {
+      // Ignore already visited or empty BBs
+      if (!Predecessor->empty() && !Visited.contains(Predecessor)) {
+        WorkList.push(Predecessor);
+        Visited.insert(Predecessor);
+      }
+    }
+  };
 
+  EnqueuePredecessors(BB);
   while (!WorkList.empty()) {
-    auto I = WorkList.front();
+    BasicBlock *Current = WorkList.front();
     WorkList.pop();
-    auto *BB = I->getParent();
-    auto End = BB->rend();
 
     // Go through the instructions looking for calls to newpc
-    for (; I != End; I++) {
-      if (auto Marker = dyn_cast<CallInst>(&*I)) {
-        // TODO: comparing strings is not very elegant
-        auto *Callee = getCalledFunction(Marker);
-        if (Callee != nullptr && Callee->getName() == "newpc") {
-
-          // We found two distinct newpc leading to the requested instruction
-          if (NewPCCall != nullptr)
-            return { MetaAddress::invalid(), 0 };
-
-          NewPCCall = Marker;
-          break;
-        }
-      }
+    CallInst *Found = nullptr;
+    for (Instruction &I : llvm::reverse(*Current)) {
+      if ((Found = getCallTo(&I, NewPC)) != nullptr)
+        break;
     }
 
-    // If we haven't find a newpc call yet, continue exploration backward
-    if (NewPCCall == nullptr) {
-      // If one of the predecessors is the dispatcher, don't explore any further
-      for (BasicBlock *Predecessor : predecessors(BB)) {
-        // Assert we didn't reach the almighty dispatcher
-        revng_assert(not(isPartOfRootDispatcher(Predecessor)));
+    if (Found != nullptr) {
+      // We found two distinct newpc leading to the requested block
+      if (NewPCCall != nullptr) {
+        NewPCCall = nullptr;
+        break;
       }
 
-      for (BasicBlock *Predecessor : predecessors(BB)) {
-        // Ignore already visited or empty BBs
-        if (!Predecessor->empty() && !Visited.contains(Predecessor)) {
-          WorkList.push(Predecessor->rbegin());
-          Visited.insert(Predecessor);
-        }
-      }
+      NewPCCall = Found;
+    } else if (NewPCCall == nullptr) {
+      // If we haven't find a newpc call yet, continue exploration backward
+      EnqueuePredecessors(Current);
     }
   }
 
+  EntryNewPC[BB] = NewPCCall;
+  return NewPCCall;
+}
+
+std::pair<MetaAddress, uint64_t>
+JumpTargetManager::getPC(Instruction *TheInstruction) const {
+  Function *NewPC = newPCMarker();
+  if (NewPC == nullptr)
+    return { MetaAddress::invalid(), 0 };
+
+  // Look for the closest newpc preceding the instruction in its own block,
+  // the first instruction of a block is considered too
+  BasicBlock *BB = TheInstruction->getParent();
+  auto Start = TheInstruction->getReverseIterator();
+  if (TheInstruction->getIterator() != BB->begin())
+    ++Start;
+
+  CallInst *NewPCCall = nullptr;
+  for (Instruction &I : llvm::make_range(Start, BB->rend()))
+    if ((NewPCCall = getCallTo(&I, NewPC)) != nullptr)
+      break;
+
+  // Otherwise, it's the one governing the whole block, which is looked up
+  // once for each block
+  if (NewPCCall == nullptr)
+    NewPCCall = getEntryNewPC(BB);
+
   // Couldn't find the current PC
   if (NewPCCall == nullptr)
     return { MetaAddress::invalid(), 0 };
@@ -741,6 +802,8 @@ void JumpTargetManager::fixPostHelperPC() {
 }
 
 void JumpTargetManager::translateIndirectJumps() {
+  invalidatePCIndex();
+
   if (ExitTB->use_empty())
     return;
 
@@ -775,6 +838,9 @@ void JumpTargetManager::translateIndirectJumps() {
 }
 
 JumpTargetManager::BlockWithAddress JumpTargetManager::peek() {
+  // The code translated since the last call might have changed the CFG
+  invalidatePCIndex();
+
   // If we just harvested new branches, keep exploring
   do {
     harvest();
@@ -812,6 +878,8 @@ inline bool hasRootDispatcherPredecessor(llvm::BasicBlock *BB) {
 }
 
 void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
+  invalidatePCIndex();
+
   OnceQueue<BasicBlock *> Queue;
   Queue.insert(Start);
 
@@ -838,7 +906,7 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
     while (!BB->empty()) {
       Instruction *I = &*(--BB->end());
 
-      if (CallInst *Call = getCallTo(I, "newpc")) {
+      if (CallInst *Call = getCallTo(I, newPCMarker())) {
         OriginalInstructionAddresses.erase(addressFromNewPC(Call));
       }
       eraseInstruction(I);
@@ -866,6 +934,7 @@ void JumpTargetManager::purgeTranslation(BasicBlock *Start) {
 BasicBlock *JumpTargetManager::registerJT(MetaAddress PC,
                                           JTReason::Values Reason) {
   revng_check(PC.isValid());
+  invalidatePCIndex();
 
   if (not isPC(PC))
     return nullptr;
@@ -913,9 +982,7 @@ BasicBlock *JumpTargetManager::registerJT(MetaAddress PC,
 
   Unexplored.push_back(BlockWithAddress(PC, NewBlock));
 
-  std::stringstream Name;
-  Name << "bb." << nameForAddress(PC);
-  NewBlock->setName(Name.str());
+  NewBlock->setName("bb." + nameForAddress(PC));
 
   // Create a case for the address associated to the new block, if the
   // dispatcher has already been emitted
@@ -1008,6 +1075,7 @@ void JumpTargetManager::setCFGForm(CFGForm::Values NewForm,
                                    MetaAddressSet *JumpTargetsWhitelist) {
   revng_assert(CurrentCFGForm != NewForm);
   revng_assert(NewForm != CFGForm::UnknownForm);
+  invalidatePCIndex();
 
   CFGForm::Values OldForm = CurrentCFGForm;
   CurrentCFGForm = NewForm;
@@ -1073,14 +1141,6 @@ void JumpTargetManager::setCFGForm(CFGForm::Values NewForm,
 }
 
 void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
-
-  if (DispatcherSwitch != nullptr) {
-    revng_assert(DispatcherSwitch->getParent() == Dispatcher);
-
-    // Purge the old dispatcher
-    PCH->destroyDispatcher(DispatcherSwitch);
-  }
-
   ProgramCounterHandler::DispatcherTargets Targets;
 
   // Add all the (whitelisted) jump targets if we're using the
@@ -1097,14 +1157,22 @@ void JumpTargetManager::rebuildDispatcher(MetaAddressSet *Whitelist) {
   }
 
   constexpr auto RDHB = BlockType::RootDispatcherHelperBlock;
-  const auto &DispatcherInfo = PCH->buildDispatcher(Targets,
-                                                    Dispatcher,
-                                                    DispatcherFail,
-                                                    RDHB);
-  DispatcherSwitch = DispatcherInfo.Switch;
+  if (DispatcherSwitch != nullptr) {
+    revng_assert(DispatcherSwitch->getParent() == Dispatcher);
 
-  // The switch is the terminator of the dispatcher basic block
-  setBlockType(DispatcherSwitch, BlockType::RootDispatcherBlock);
+    // Switching back and forth between CFG forms changes only a part of the
+    // cases, update the existing dispatcher instead of building it again
+    PCH->updateDispatcher(DispatcherSwitch, Targets, RDHB);
+  } else {
+    const auto &DispatcherInfo = PCH->buildDispatcher(Targets,
+                                                      Dispatcher,
+                                                      DispatcherFail,
+                                                      RDHB);
+    DispatcherSwitch = DispatcherInfo.Switch;
+
+    // The switch is the terminator of the dispatcher basic block
+    setBlockType(DispatcherSwitch, BlockType::RootDispatcherBlock);
+  }
 
   //
   // Make sure every generated basic block is reachable
@@ -1182,6 +1250,9 @@ void JumpTargetManager::harvest() {
     T.advance("Simple literals");
     HarvestingStats.push("harvest 1: SimpleLiterals");
     revng_log(JTCountLog, "Collecting simple literals");
+    llvm::sort(SimpleLiterals);
+    auto Duplicates = std::unique(SimpleLiterals.begin(), SimpleLiterals.end());
+    SimpleLiterals.erase(Duplicates, SimpleLiterals.end());
     for (MetaAddress PC : SimpleLiterals)
       registerJT(PC, JTReason::SimpleLiteral);
     SimpleLiterals.clear();
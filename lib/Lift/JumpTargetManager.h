@@ -6,6 +6,7 @@
 
 #include <cstdint>
 #include <map>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -414,8 +415,14 @@ public:
   void recordNewBranches(llvm::BasicBlock *Source, size_t Count) {
     ValueMaterializerPCWhiteList.insert(getPC(Source->getTerminator()).first);
     NewBranches += Count;
+    invalidatePCIndex();
   }
 
+  /// Forget what getPC learned about the CFG. Must be called whenever basic
+  /// blocks are split, erased or gain predecessors, or `newpc` calls are
+  /// erased.
+  void invalidatePCIndex() { EntryNewPC.clear(); }
+
   bool isInValueMaterializerPCWhitelist(MetaAddress Address) const {
     return ValueMaterializerPCWhiteList.contains(Address);
   }
@@ -512,6 +519,9 @@ public:
 
   void registerReadRange(MetaAddress StartAddress, MetaAddress EndAddress);
 
+  /// Populate RelocatedValues
+  void indexRelocations();
+
   const interval_set &readRange() const { return ReadIntervalSet; }
 
   std::string nameForAddress(MetaAddress Address, uint64_t Size = 1) const {
@@ -530,7 +540,7 @@ public:
   /// Simple literals are registered as possible jump targets before attempting
   /// more expensive techniques.
   void registerSimpleLiteral(MetaAddress Address) {
-    SimpleLiterals.insert(Address);
+    SimpleLiterals.push_back(Address);
   }
 
   ProgramCounterHandler *programCounterHandler() { return PCH; }
@@ -538,6 +548,12 @@ public:
   llvm::DenseSet<llvm::BasicBlock *> computeUnreachable() const;
 
 private:
+  llvm::Function *newPCMarker() const;
+
+  /// \return the `newpc` call governing the first instruction of \p BB, if
+  ///         it isn't one itself
+  llvm::CallInst *getEntryNewPC(llvm::BasicBlock *BB) const;
+
   void fixPostHelperPC();
 
   /// Translate the non-constant jumps into jumps to the dispatcher
@@ -546,6 +562,7 @@ private:
   /// Erase \p I, and deregister it in case it's a call to `newpc`
   void eraseInstruction(llvm::Instruction *I) {
     revng_assert(I->use_empty());
+    invalidatePCIndex();
 
     MetaAddress PC = getBasicBlockAddress(I->getParent());
     if (PC.isValid())
@@ -577,7 +594,8 @@ private:
   llvm::CallInst *getJumpTarget(llvm::BasicBlock *Target);
 
 private:
-  using InstructionMap = std::map<MetaAddress, llvm::Instruction *>;
+  /// Only ever queried by address, never visited in order
+  using InstructionMap = MetaAddressMap<llvm::Instruction *>;
 
   llvm::Module &TheModule;
   llvm::LLVMContext &Context;
@@ -585,6 +603,12 @@ private:
   /// Holds the association between a PC and the last generated instruction for
   /// the previous instruction.
   InstructionMap OriginalInstructionAddresses;
+  /// For each basic block queried by getPC since the last change to the CFG
+  /// (see invalidatePCIndex), the only `newpc` call leading to its first
+  /// instruction, or nullptr if there's none or more than one
+  mutable llvm::DenseMap<llvm::BasicBlock *, llvm::CallInst *> EntryNewPC;
+  /// The `newpc` function, once it exists
+  mutable llvm::Function *NewPCMarker = nullptr;
   /// Holds the association between a PC and a BasicBlock.
   BlockMap JumpTargets;
   /// Queue of program counters we still have to translate.
@@ -604,9 +628,17 @@ private:
   std::set<MetaAddress> UnusedCodePointers;
   interval_set ReadIntervalSet;
 
+  /// The value of the relocations in the model, indexed by address and size,
+  /// and how many relocations apply to each of them
+  std::map<std::pair<MetaAddress, unsigned>,
+           std::pair<MaterializedValue, unsigned>>
+    RelocatedValues;
+  bool RelocatedValuesReady = false;
+
   CFGForm::Values CurrentCFGForm;
   std::set<llvm::BasicBlock *> ToPurge;
-  std::set<MetaAddress> SimpleLiterals;
+  /// Might contain duplicates, sorted and uniqued only upon harvesting
+  std::vector<MetaAddress> SimpleLiterals;
   CSAAFactory CreateCSAA;
 
   ProgramCounterHandler *PCH;
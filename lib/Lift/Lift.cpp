@@ -6,6 +6,7 @@
 
 #include "revng/Lift/Lift.h"
 #include "revng/Support/CommandLine.h"
+#include "revng/Support/Progress.h"
 #include "revng/Support/ResourceFinder.h"
 
 #include "CodeGenerator.h"
@@ -141,7 +142,12 @@ bool LiftPass::runOnModule(llvm::Module &M) {
   if (EntryPointAddress.getNumOccurrences() != 0)
     EntryPointAddressOptional = EntryPointAddress;
   T.advance("Translate", true);
-  Generator.translate(EntryPointAddressOptional);
+  {
+    revng::TracePeakRSSDelta PeakRSS;
+    Generator.translate(EntryPointAddressOptional);
+    if (revng::isTracingTasks())
+      revng::addTraceArgument("module-instructions", M.getInstructionCount());
+  }
 
   return false;
 }
@@ -61,72 +61,85 @@ Lift::invalidate(const BinaryFileContainer &SourceBinary,
   InvalidateResult[&ModuleContainer].push_back(pipeline::Target({},
                                                                 kinds::Root));
 
+  // Inspect the diff looking for newly added or removed model::Functions
+  auto *ModelDiff = Diff.getAs<model::Binary>();
+  revng_assert(ModelDiff != nullptr);
+
+  using Fields = TupleLikeTraits<model::Binary>::Fields;
+  size_t FunctionsIndex = static_cast<size_t>(Fields::Functions);
+  struct FunctionChange {
+    bool IsAdded = false;
+    bool IsRemoved = false;
+  };
+  std::map<MetaAddress, FunctionChange> ChangedFunctions;
+  for (const auto &Change : ModelDiff->Changes) {
+    bool IsAddition = not Change.Old.has_value() and Change.New.has_value();
+    bool IsRemoval = Change.Old.has_value() and not Change.New.has_value();
+
+    // Look for additions to and removals from /Functions
+    auto &Path = Change.Path;
+    if (Path.size() == 1 and Path[0].get<size_t>() == FunctionsIndex) {
+      if (IsAddition) {
+        auto Entry = std::get<model::Function>(*Change.New).Entry();
+        ChangedFunctions[Entry].IsAdded = true;
+      } else if (IsRemoval) {
+        auto Entry = std::get<model::Function>(*Change.Old).Entry();
+        ChangedFunctions[Entry].IsRemoved = true;
+      }
+    }
+  }
+
+  // Most changes to the model do not affect lifting, don't bother looking at
+  // the module
+  if (ChangedFunctions.empty())
+    return {};
+
   Function *Root = ModuleContainer.getModule().getFunction("root");
   Function *NewPC = ModuleContainer.getModule().getFunction("newpc");
 
   if (Root == nullptr or NewPC == nullptr)
     return InvalidateResult;
 
-  // Collect all jump targets by inspecting calls to newpc and record whether it
-  // was found after adding entry addresses of functions
+  // Collect the jump targets at the entry of the changed functions by
+  // inspecting calls to newpc and record whether they have been found after
+  // adding entry addresses of functions
   std::map<MetaAddress, bool> JumpTargets;
   for (CallBase *Call : callers(NewPC)) {
     bool IsJumpTarget = getLimitedValue(Call->getArgOperand(2)) == 1;
-
-    if (IsJumpTarget) {
-      auto Address = MetaAddress::fromValue(Call->getArgOperand(0));
-
-      // Detect if this jump targets has been discovered *after* recording the
-      // entry addresses of functions
-
-      // Be conservative and assume it is, in absence of information
-      bool DependsOnModelFunction = true;
-      Instruction *Terminator = Call->getParent()->getTerminator();
-      if (Terminator->hasMetadata(JTReasonMDName)) {
-        uint32_t Reasons = GeneratedCodeBasicInfo::getJTReasons(Terminator);
-        DependsOnModelFunction = hasReason(Reasons,
-                                           JTReason::DependsOnModelFunction);
-      }
-
-      JumpTargets.emplace(Address, DependsOnModelFunction);
+    if (not IsJumpTarget)
+      continue;
+
+    auto Address = MetaAddress::fromValue(Call->getArgOperand(0));
+    if (not ChangedFunctions.contains(Address))
+      continue;
+
+    // Detect if this jump targets has been discovered *after* recording the
+    // entry addresses of functions
+
+    // Be conservative and assume it is, in absence of information
+    bool DependsOnModelFunction = true;
+    Instruction *Terminator = Call->getParent()->getTerminator();
+    if (Terminator->hasMetadata(JTReasonMDName)) {
+      uint32_t Reasons = GeneratedCodeBasicInfo::getJTReasons(Terminator);
+      DependsOnModelFunction = hasReason(Reasons,
+                                         JTReason::DependsOnModelFunction);
     }
-  }
-
-  // Inspect the diff looking for newly added model::Functions
-  auto *ModelDiff = Diff.getAs<model::Binary>();
-  revng_assert(ModelDiff != nullptr);
 
-  using Fields = TupleLikeTraits<model::Binary>::Fields;
-  size_t FunctionsIndex = static_cast<size_t>(Fields::Functions);
-  for (const auto &Change : ModelDiff->Changes) {
-    bool IsAddition = not Change.Old.has_value() and Change.New.has_value();
-    bool IsRemoval = Change.Old.has_value() and not Change.New.has_value();
+    JumpTargets.emplace(Address, DependsOnModelFunction);
+  }
 
-    // Look for additions to /Functions
-    auto &Path = Change.Path;
-    if (Path.size() == 1) {
-      if (Path[0].get<size_t>() == FunctionsIndex) {
-        // Check the Entry address of the newly added model::Function
-        MetaAddress ChangedAddress;
-        if (IsAddition)
-          ChangedAddress = std::get<model::Function>(*Change.New).Entry();
-        else
-          ChangedAddress = std::get<model::Function>(*Change.Old).Entry();
-
-        auto It = JumpTargets.find(ChangedAddress);
-        bool IsJumpTarget = It != JumpTargets.end();
-        bool DependsOnModelFunction = IsJumpTarget and It->second;
-
-        if (IsAddition and not IsJumpTarget) {
-          // We're adding a function that was not a jump target
-          return InvalidateResult;
-        } else if (IsRemoval and DependsOnModelFunction) {
-          // We're removing a function whose address was not discovered *before*
-          // starting to take into account the entry addresses of model
-          // functions
-          return InvalidateResult;
-        }
-      }
+  for (const auto &[Entry, Change] : ChangedFunctions) {
+    auto It = JumpTargets.find(Entry);
+    bool IsJumpTarget = It != JumpTargets.end();
+    bool DependsOnModelFunction = IsJumpTarget and It->second;
+
+    if (Change.IsAdded and not IsJumpTarget) {
+      // We're adding a function that was not a jump target
+      return InvalidateResult;
+    } else if (Change.IsRemoved and DependsOnModelFunction) {
+      // We're removing a function whose address was not discovered *before*
+      // starting to take into account the entry addresses of model functions
+      return InvalidateResult;
     }
   }
 
@@ -7,7 +7,6 @@
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
-#include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/SourceMgr.h"
@@ -21,6 +20,7 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/ResourceFinder.h"
+#include "revng/Support/SharedModules.h"
 
 using namespace llvm::cl;
 using namespace pipeline;
@@ -82,9 +82,9 @@ void revng::pipes::LinkSupport::run(const ExecutionContext &Ctx,
   std::string SupportPath = getSupportPath(Ctx.getContext());
 
   llvm::SMDiagnostic Err;
-  auto Module = llvm::parseIRFile(SupportPath,
-                                  Err,
-                                  TargetsList.getModule().getContext());
+  auto Module = revng::parseSharedIRFile(SupportPath,
+                                         Err,
+                                         TargetsList.getModule().getContext());
   revng_assert(Module != nullptr);
 
   auto Failed = llvm::Linker::linkModules(TargetsList.getModule(),
@@ -5,6 +5,7 @@
 //
 
 #include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/SmallSet.h"
 #include "llvm/Analysis/BasicAliasAnalysis.h"
 #include "llvm/Analysis/ScopedNoAliasAA.h"
 #include "llvm/CodeGen/UnreachableBlockElim.h"
@@ -25,6 +26,7 @@
 #include "revng/FunctionCallIdentification/FunctionCallIdentification.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/OpaqueRegisterUser.h"
+#include "revng/Support/Progress.h"
 #include "revng/Support/Statistics.h"
 #include "revng/TypeShrinking/BitLiveness.h"
 #include "revng/TypeShrinking/TypeShrinking.h"
@@ -42,6 +44,7 @@ RunningStatistics WrittenInPCStatistics("written-in-pc");
 RunningStatistics DetectedEdgesStatistics("detected-edges");
 RunningStatistics StoredInMemoryStatistics("stored-in-memory");
 RunningStatistics LoadAddressStatistics("load-address");
+RunningStatistics ClonedRootSize("cloned-root-size");
 
 Logger<> NewEdgesLog("new-edges");
 
@@ -805,6 +808,11 @@ void RootAnalyzer::cloneOptimizeAndHarvest(Function *TheFunction) {
   ValueToValueMapTy OldToNew;
   Function *OptimizedFunction = createTemporaryRoot(TheFunction, OldToNew);
 
+  // Track how much code each round goes through, it grows with the
+  // translated code
+  ClonedRootSize.push(OptimizedFunction->size());
+  revng::addTraceArgument("cloned-blocks", OptimizedFunction->size());
+
   MetaAddress::Features CommonFeatures = findCommonFeatures(OptimizedFunction);
 
   AnalysisRegistry AR(&TheModule);
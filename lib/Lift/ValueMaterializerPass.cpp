@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <tuple>
+
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/Analysis/ValueTracking.h"
 #include "llvm/Support/CommandLine.h"
@@ -11,6 +14,7 @@
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 
 #include "revng/Support/Debug.h"
+#include "revng/Support/Statistics.h"
 #include "revng/ValueMaterializer/ValueMaterializer.h"
 
 #include "JumpTargetManager.h"
@@ -21,6 +25,8 @@ using namespace llvm;
 cl::list<uint64_t> DumpValueMaterializerAt("dump-vm-at", cl::ZeroOrMore);
 cl::opt<bool> DumpValueMaterializer("dump-all-vm");
 
+static CounterMap<std::string> MaterializerQueries("vm-queries");
+
 using SDMO = StaticDataMemoryOracle;
 
 SDMO::StaticDataMemoryOracle(const DataLayout &DL,
@@ -35,8 +41,13 @@ SDMO::StaticDataMemoryOracle(const DataLayout &DL,
 
 MaterializedValue StaticDataMemoryOracle::load(uint64_t LoadAddress,
                                                unsigned LoadSize) {
-  auto Address = MetaAddress::fromGeneric(LoadAddress, Features);
-  return JTM.readFromPointer(Address, LoadSize, IsLittleEndian);
+  auto [It, IsNew] = Loaded.try_emplace({ LoadAddress, LoadSize });
+  if (IsNew) {
+    auto Address = MetaAddress::fromGeneric(LoadAddress, Features);
+    It->second = JTM.readFromPointer(Address, LoadSize, IsLittleEndian);
+  }
+
+  return It->second;
 }
 
 static void demoteOrToAdd(Function &F) {
@@ -93,6 +104,13 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
     return cast<ConstantInt>(Call->getArgOperand(Index))->getLimitedValue();
   };
 
+  // Two markers tracking the same value in the same basic block, with the
+  // same limits and oracle, get the same results, since the analyses work at
+  // the block level. Compute them only once. Since the function is not changed
+  // during this loop, there's nothing to invalidate.
+  using Query = std::tuple<Value *, BasicBlock *, uint64_t, uint64_t, unsigned>;
+  std::map<Query, MDTuple *> Cache;
+
   for (CallBase *Call : callersIn(Marker, &F)) {
     // Decode arguments
     revng_assert(Call->arg_size() >= 4);
@@ -108,6 +126,20 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
     revng_assert(Address.isValid());
     uint64_t CurrentAddress = Address.address();
 
+    bool Dump = DumpValueMaterializer
+                or count(DumpValueMaterializerAt, CurrentAddress) > 0;
+
+    Query Key = { ToTrack, Call->getParent(), MaxPhiLike, MaxLoad, Oracle };
+    if (not Dump) {
+      auto It = Cache.find(Key);
+      if (It != Cache.end()) {
+        MaterializerQueries.push("reused");
+        Call->setMetadata("revng.avi", It->second);
+        continue;
+      }
+    }
+    MaterializerQueries.push("computed");
+
     MaterializedValues Values;
     DataFlowGraph::Limits Limits(MaxPhiLike, MaxLoad);
     auto Results = ValueMaterializer::getValuesFor(Call,
@@ -120,8 +152,7 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
     if (Results.values())
       Values = std::move(*Results.values());
 
-    if (DumpValueMaterializer
-        or count(DumpValueMaterializerAt, CurrentAddress) > 0) {
+    if (Dump) {
       // User asked to dump information about this address
       dbg << "Values produced by ValueMaterializer for " << getName(ToTrack)
           << " at " << Address.toString() << ":\n";
@@ -153,7 +184,9 @@ PreservedAnalyses ValueMaterializerPass::run(Function &F,
       ValuesMD.push_back(QMD.tuple({ QMD.get(SymbolName), QMD.get(Offset) }));
     }
 
-    Call->setMetadata("revng.avi", QMD.tuple(ValuesMD));
+    MDTuple *ValuesTuple = QMD.tuple(ValuesMD);
+    Call->setMetadata("revng.avi", ValuesTuple);
+    Cache[Key] = ValuesTuple;
   }
 
   return PreservedAnalyses::all();
@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <utility>
+
 #include "llvm/IR/PassManager.h"
 
 #include "revng/BasicAnalyses/MaterializedValue.h"
@@ -22,6 +25,10 @@ private:
   const MetaAddress::Features &Features;
   bool IsLittleEndian = false;
 
+  /// Jump tables are read over and over, remember what we loaded. Reading
+  /// again the same location would have no further side effect on JTM.
+  std::map<std::pair<uint64_t, unsigned>, MaterializedValue> Loaded;
+
 public:
   StaticDataMemoryOracle(const llvm::DataLayout &DL,
                          JumpTargetManager &JTM,
@@ -80,83 +80,13 @@ private:
   std::vector<OffsetValuePair> Stack;
 };
 
-static std::pair<IntegerType *, unsigned>
-getTypeAtOffset(const DataLayout *TheLayout, Type *VarType, intptr_t Offset) {
-  static Logger<> Log("type-at-offset");
-
-  unsigned Depth = 0;
-  while (1) {
-    switch (VarType->getTypeID()) {
-    case llvm::Type::TypeID::PointerTyID:
-      // BEWARE: here we return { nullptr, 0 } as an intended workaround for
-      // a specific situation.
-      //
-      // We can't use assertions on pointers, as we do for all the other
-      // unhandled types, because they will be inevitably triggered during the
-      // execution. Indeed, all the other types are not present in QEMU
-      // CPUState and we can safely assert it. This is not true for pointers
-      // that are used in different places in QEMU CPUState.
-      //
-      // Given that we have ruled out assertions, we need to handle the
-      // pointer case so that it keeps working. This function is expected to
-      // return { nullptr, 0 } when the offset points to a memory location
-      // associated to padding space. In principle, pointers are not padding
-      // space, but the result of returning { nullptr, 0 } here is that load
-      // and store operations treat pointers like padding. This means that
-      // pointers cannot be read or written, and memcpy simply skips over them
-      // leaving them alone.
-      //
-      // This behavior is intended, because a pointer into the CPUState could
-      // be used to modify CPU registers indirectly, which is against all the
-      // assumption of the analysis necessary for the translation, and also
-      // against what really happens in a CPU, where CPU state cannot be
-      // addressed.
-      return { nullptr, 0 };
-
-    case llvm::Type::TypeID::IntegerTyID:
-      return { cast<IntegerType>(VarType), Offset };
-
-    case llvm::Type::TypeID::ArrayTyID:
-      VarType = VarType->getArrayElementType();
-      Offset %= TheLayout->getTypeAllocSize(VarType);
-      revng_log(Log,
-                std::string(Depth++ * 2, ' ')
-                  << " Is an Array. Offset in Element: " << Offset);
-      break;
-
-    case llvm::Type::TypeID::StructTyID: {
-      StructType *TheStruct = cast<StructType>(VarType);
-      const StructLayout *Layout = TheLayout->getStructLayout(TheStruct);
-      unsigned FieldIndex = Layout->getElementContainingOffset(Offset);
-      uint64_t FieldOffset = Layout->getElementOffset(FieldIndex);
-      VarType = TheStruct->getTypeAtIndex(FieldIndex);
-      intptr_t FieldEnd = FieldOffset + TheLayout->getTypeAllocSize(VarType);
-
-      revng_log(Log,
-                std::string(Depth++ * 2, ' ')
-                  << " Offset: " << Offset
-                  << " Struct Name: " << TheStruct->getName().str()
-                  << " Field Index: " << FieldIndex << " Field offset: "
-                  << FieldOffset << " Field end: " << FieldEnd);
-
-      if (Offset >= FieldEnd)
-        return { nullptr, 0 }; // It's padding
-
-      Offset -= FieldOffset;
-    } break;
-
-    default:
-      revng_abort("unexpected TypeID");
-    }
-  }
-}
-
 VariableManager::VariableManager(Module &M,
                                  bool TargetIsLittleEndian,
                                  StructType *CPUStruct,
                                  unsigned EnvOffset) :
   TheModule(M),
   AllocaBuilder(getContext(&M)),
+  CPUStateTypes(&M.getDataLayout(), CPUStruct),
   CPUStateType(CPUStruct),
   ModuleLayout(&TheModule.getDataLayout()),
   EnvOffset(EnvOffset),
@@ -168,6 +98,13 @@ VariableManager::VariableManager(Module &M,
   IntegerType *IntPtrTy = AllocaBuilder.getIntPtrTy(*ModuleLayout);
   Env = cast<GlobalVariable>(TheModule.getOrInsertGlobal("env", IntPtrTy));
   Env->setInitializer(ConstantInt::getNullValue(IntPtrTy));
+
+  CPUStateCSVs.resize(CPUStateTypes.size());
+}
+
+void VariableManager::setDataLayout(const DataLayout *NewLayout) {
+  ModuleLayout = NewLayout;
+  CPUStateTypes.setDataLayout(NewLayout);
 }
 
 std::optional<StoreInst *>
@@ -460,18 +397,31 @@ GlobalVariable *VariableManager::getByCPUStateOffset(intptr_t Offset,
   return Result;
 }
 
+GlobalVariable *VariableManager::getCSVAt(intptr_t Offset) const {
+  if (CPUStateTypes.contains(Offset))
+    return CPUStateCSVs[Offset];
+
+  auto It = CPUStateGlobals.find(Offset);
+  return It != CPUStateGlobals.end() ? It->second : nullptr;
+}
+
+void VariableManager::setCSVAt(intptr_t Offset, GlobalVariable *CSV) {
+  CPUStateGlobals[Offset] = CSV;
+  if (CPUStateTypes.contains(Offset))
+    CPUStateCSVs[Offset] = CSV;
+}
+
 std::pair<GlobalVariable *, unsigned>
 VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
                                              std::string Name) {
-  GlobalsMap::iterator It = CPUStateGlobals.find(Offset);
+  GlobalVariable *Existing = getCSVAt(Offset);
   static const char *UnknownCSVPref = "state_0x";
-  if (It == CPUStateGlobals.end()
+  if (Existing == nullptr
       || (Name.size() != 0
-          && It->second->getName().startswith(UnknownCSVPref))) {
+          && Existing->getName().startswith(UnknownCSVPref))) {
     Type *VariableType;
     unsigned Remaining;
-    std::tie(VariableType,
-             Remaining) = getTypeAtOffset(ModuleLayout, CPUStateType, Offset);
+    std::tie(VariableType, Remaining) = CPUStateTypes.get(Offset);
 
     // Unsupported type, let the caller handle the situation
     if (VariableType == nullptr)
@@ -479,9 +429,8 @@ VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
 
     // Check we're not trying to go inside an existing variable
     if (Remaining != 0) {
-      GlobalsMap::iterator It = CPUStateGlobals.find(Offset - Remaining);
-      if (It != CPUStateGlobals.end())
-        return { It->second, Remaining };
+      if (GlobalVariable *Containing = getCSVAt(Offset - Remaining))
+        return { Containing, Remaining };
     }
 
     if (Name.size() == 0) {
@@ -503,16 +452,16 @@ VariableManager::getByCPUStateOffsetInternal(intptr_t Offset,
     revng_assert(NewVariable != nullptr);
     FunctionTags::CSV.addTo(NewVariable);
 
-    if (It != CPUStateGlobals.end()) {
-      It->second->replaceAllUsesWith(NewVariable);
-      eraseFromParent(It->second);
+    if (Existing != nullptr) {
+      Existing->replaceAllUsesWith(NewVariable);
+      eraseFromParent(Existing);
     }
 
-    CPUStateGlobals[Offset] = NewVariable;
+    setCSVAt(Offset, NewVariable);
 
     return { NewVariable, Remaining };
   } else {
-    return { It->second, 0 };
+    return { Existing, 0 };
   }
 }
 
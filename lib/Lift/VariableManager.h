@@ -7,12 +7,14 @@
 #include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Pass.h"
 
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/IRHelpers.h"
+#include "revng/Support/TypeAtOffset.h"
 
 #include "CPUStateAccessAnalysisPass.h"
 #include "PTCDump.h"
@@ -111,9 +113,7 @@ public:
                                  llvm::Instruction *InsertBefore,
                                  unsigned Offset = 0);
 
-  void setDataLayout(const llvm::DataLayout *NewLayout) {
-    ModuleLayout = NewLayout;
-  }
+  void setDataLayout(const llvm::DataLayout *NewLayout);
 
   std::vector<llvm::AllocaInst *> locals() {
     std::vector<llvm::AllocaInst *> Locals;
@@ -174,12 +174,21 @@ private:
   std::pair<llvm::GlobalVariable *, unsigned>
   getByCPUStateOffsetInternal(intptr_t Offset, std::string Name = "");
 
+private:
+  llvm::GlobalVariable *getCSVAt(intptr_t Offset) const;
+  void setCSVAt(intptr_t Offset, llvm::GlobalVariable *CSV);
+
 private:
   llvm::Module &TheModule;
   llvm::IRBuilder<> AllocaBuilder;
   using TemporariesMap = std::map<unsigned int, llvm::AllocaInst *>;
   using GlobalsMap = std::map<intptr_t, llvm::GlobalVariable *>;
   GlobalsMap CPUStateGlobals;
+  /// The layout of the CPU state, one entry per byte
+  TypeAtOffsetCache CPUStateTypes;
+  /// The CSV starting at each byte of the CPU state, if any: it shadows
+  /// CPUStateGlobals, so that each lookup is an array access
+  std::vector<llvm::GlobalVariable *> CPUStateCSVs;
   GlobalsMap OtherGlobals;
   TemporariesMap Temporaries;
   TemporariesMap LocalTemporaries;
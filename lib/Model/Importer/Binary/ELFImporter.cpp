@@ -5,13 +5,19 @@
 //
 
 #include <cstdint>
+#include <future>
 #include <optional>
+#include <set>
+#include <vector>
 
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/Object/ELF.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/ABI/DefaultFunctionPrototype.h"
 #include "revng/Model/Binary.h"
@@ -28,6 +34,7 @@
 #include "DwarfReader.h"
 #include "ELFImporter.h"
 #include "Importers.h"
+#include "LibraryModelStore.h"
 #include "MIPSELFImporter.h"
 
 using namespace llvm;
@@ -35,6 +42,37 @@ using namespace llvm::object;
 
 Logger<> ELFImporterLog("elf-importer");
 
+static cl::opt<unsigned>
+  DependencyImportThreads("dependency-import-threads",
+                          cl::desc("Number of libraries imported concurrently "
+                                   "(0 means all the available cores)"),
+                          cl::init(1));
+
+/// The parts of the import of a binary which do not need its model, run on a
+/// thread pool while the binary itself is imported: fetching its detached
+/// debug info and importing the models of its dependencies.
+class BackgroundImports {
+private:
+  std::vector<std::string> Libraries;
+  std::vector<std::optional<TupleTree<model::Binary>>> Imported;
+  std::unique_ptr<LibraryModelStore> Store;
+  std::shared_future<void> DebugInfo;
+
+  // Last, so that the tasks are done before the rest is destroyed
+  ThreadPool Pool;
+
+public:
+  BackgroundImports(std::string FileName,
+                    model::Architecture::Values Architecture,
+                    const ImporterOptions &Options);
+
+public:
+  void waitForDebugInfo() { DebugInfo.wait(); }
+
+  /// Wait for the dependencies to be imported and take their models
+  ModelMap takeDependencies();
+};
+
 template<typename A, typename B>
 static bool hasFlag(A Flag, B Value) {
   return (Flag & Value) != 0;
@@ -186,13 +224,23 @@ Error ELFImporter<T, HasAddend>::import(const ImporterOptions &Options) {
     .BaseAddress = Options.BaseAddress,
     .DebugInfo = Options.DebugInfo,
     .EnableRemoteDebugInfo = Options.EnableRemoteDebugInfo,
-    .AdditionalDebugInfoPaths = Options.AdditionalDebugInfoPaths
+    .AdditionalDebugInfoPaths = Options.AdditionalDebugInfoPaths,
+    .LibraryModelStoreURL = Options.LibraryModelStoreURL
   };
 
   if (not(Type == ELF::ET_DYN or Type == ELF::ET_EXEC))
     return createError("Only ELF executables and ELF dynamic libraries are "
                        "supported");
 
+  // Fetching the debug info and importing the dependencies do not need the
+  // model of this binary: start them now, so that they overlap with the rest
+  // of the import
+  std::optional<BackgroundImports> Background;
+  if (AdjustedOptions.DebugInfo == DebugInfoLevel::Yes)
+    Background.emplace(TheBinary.getFileName().str(),
+                       Architecture,
+                       AdjustedOptions);
+
   // Look for static or dynamic symbols and relocations
   ConstElf_Shdr *SymtabShdr = nullptr;
   std::optional<MetaAddress> EHFrameAddress;
@@ -264,6 +312,7 @@ Error ELFImporter<T, HasAddend>::import(const ImporterOptions &Options) {
   // Parse segments
   Task.advance("Parse program headers", true);
   parseProgramHeaders(TheELF);
+  File.reindexSegments();
 
   std::optional<uint64_t> FDEsCount;
   if (EHFrameHdrAddress) {
@@ -397,13 +446,17 @@ Error ELFImporter<T, HasAddend>::import(const ImporterOptions &Options) {
   if (AdjustedOptions.DebugInfo != DebugInfoLevel::No) {
     Task.advance("Parse debug info", true);
 
-    // Import Dwarf
+    // Import Dwarf, once its detached part, if any, has been fetched
+    bool Prefetched = Background.has_value();
+    if (Background)
+      Background->waitForDebugInfo();
     DwarfImporter Importer(Model);
-    Importer.import(TheBinary.getFileName(), AdjustedOptions);
+    Importer.import(TheBinary.getFileName(), AdjustedOptions, not Prefetched);
 
     // Now we try to find missing types in the dependencies.
     Task.advance("Find missing types from debug info", true);
-    findMissingTypes(TheELF, AdjustedOptions);
+    if (Background)
+      findMissingTypes(TheELF, *Background);
   }
 
   Task.advance("Promote original name", true);
@@ -412,64 +465,143 @@ Error ELFImporter<T, HasAddend>::import(const ImporterOptions &Options) {
   return Error::success();
 }
 
-template<typename T, bool HasAddend>
-void ELFImporter<T, HasAddend>::findMissingTypes(object::ELFFile<T> &TheELF,
-                                                 const ImporterOptions &Opts) {
-  if (Opts.DebugInfo != DebugInfoLevel::Yes)
-    return;
+/// Import the model of the library at \p Path, ignoring its own dependencies.
+/// If \p Store is not null, the model is reused from there, if available, or
+/// added to it.
+static std::optional<TupleTree<model::Binary>>
+importDependency(const std::string &Path,
+                 model::Architecture::Values Architecture,
+                 const ImporterOptions &Options,
+                 LibraryModelStore *Store) {
+  revng_log(ELFImporterLog, " Importing Model for: " << Path);
+  auto BinaryOrErr = llvm::object::createBinary(Path);
+  if (auto Error = BinaryOrErr.takeError()) {
+    revng_log(ELFImporterLog,
+              "Can't create object for " << Path << " due to " << Error);
+    llvm::consumeError(std::move(Error));
+    return std::nullopt;
+  }
 
-  ModelMap ModelsOfLibraries;
-  TypeCopierMap TypeCopiers;
+  auto &Object = *cast<llvm::object::ObjectFile>(BinaryOrErr->getBinary());
+  auto *TheBinary = dyn_cast<ELFObjectFileBase>(&Object);
+  if (!TheBinary) {
+    revng_log(ELFImporterLog, "Can't parse the binary");
+    return std::nullopt;
+  }
+
+  std::string Key;
+  if (Store != nullptr) {
+    Key = LibraryModelStore::key(getBuildID(TheBinary), Architecture, Options);
+    if (not Key.empty())
+      if (auto Stored = Store->load(Key))
+        return Stored;
+  }
+
+  TupleTree<model::Binary> Result;
+  Result->Architecture() = Architecture;
+  if (auto E = importELF(Result, *TheBinary, Options)) {
+    revng_log(ELFImporterLog,
+              "Can't import model for " << Path << " due to " << E);
+    llvm::consumeError(std::move(E));
+    return std::nullopt;
+  }
+
+  if (not Key.empty()) {
+    // Failing to share the model does not affect the current import
+    if (auto Error = Store->store(Key, Result)) {
+      revng_log(ELFImporterLog,
+                "Can't store the model of " << Path << " due to " << Error);
+      llvm::consumeError(std::move(Error));
+    }
+  }
+
+  return Result;
+}
+
+BackgroundImports::BackgroundImports(std::string FileName,
+                                     model::Architecture::Values Architecture,
+                                     const ImporterOptions &Options) :
+  // One more thread for the debug info of the binary itself
+  Pool(hardware_concurrency(DependencyImportThreads == 0 ?
+                              0 :
+                              DependencyImportThreads + 1)) {
+  DebugInfo = Pool.async([FileName, Options] {
+    prefetchDebugInfo(FileName, Options);
+  });
 
   // TODO: disclose a way to modify this value with
   //       the `ImporterOptions::DebugInfo`, if the need ever arises.
   unsigned MaximumRecursionDepth = 1;
 
   LDDTree Dependencies;
-  lddtree(Dependencies, TheBinary.getFileName().str(), MaximumRecursionDepth);
+  lddtree(Dependencies, FileName, MaximumRecursionDepth);
+
+  // Collect the libraries to import, each one once
+  std::set<std::string> Seen;
   for (auto &Library : Dependencies) {
     revng_log(ELFImporterLog,
               "Importing Models for dependencies of " << Library.first << ":");
-    for (auto &DependencyLibrary : Library.second) {
-      if (ModelsOfLibraries.contains(DependencyLibrary))
-        continue;
-      revng_log(ELFImporterLog, " Importing Model for: " << DependencyLibrary);
-      auto BinaryOrErr = llvm::object::createBinary(DependencyLibrary);
-      if (auto Error = BinaryOrErr.takeError()) {
-        revng_log(ELFImporterLog,
-                  "Can't create object for " << DependencyLibrary << " due to "
-                                             << Error);
-        llvm::consumeError(std::move(Error));
-        continue;
-      }
+    for (auto &DependencyLibrary : Library.second)
+      if (Seen.insert(DependencyLibrary).second)
+        Libraries.push_back(DependencyLibrary);
+  }
 
-      auto &Object = *cast<llvm::object::ObjectFile>(BinaryOrErr->getBinary());
-      auto *TheBinary = dyn_cast<ELFObjectFileBase>(&Object);
-      if (!TheBinary) {
-        revng_log(ELFImporterLog, "Can't parse the binary");
-        continue;
-      }
+  // Import them, concurrently if requested: each import works on its own
+  // model and most of its time is spent waiting for the debug info to be
+  // fetched
+  ImporterOptions AdjustedOptions{
+    .BaseAddress = Options.BaseAddress,
+    .DebugInfo = DebugInfoLevel::IgnoreLibraries,
+    .EnableRemoteDebugInfo = Options.EnableRemoteDebugInfo,
+    .AdditionalDebugInfoPaths = Options.AdditionalDebugInfoPaths
+  };
 
-      revng_assert(!ModelsOfLibraries.contains(DependencyLibrary));
-      TupleTree<model::Binary> &DepModel = ModelsOfLibraries[DependencyLibrary];
-      DepModel->Architecture() = Model->Architecture();
-      ImporterOptions AdjustedOptions{
-        .BaseAddress = Opts.BaseAddress,
-        .DebugInfo = DebugInfoLevel::IgnoreLibraries,
-        .EnableRemoteDebugInfo = Opts.EnableRemoteDebugInfo,
-        .AdditionalDebugInfoPaths = Opts.AdditionalDebugInfoPaths
-      };
-      if (auto E = importELF(DepModel, *TheBinary, AdjustedOptions)) {
-        revng_log(ELFImporterLog,
-                  "Can't import model for " << DependencyLibrary << " due to "
-                                            << E);
-        llvm::consumeError(std::move(E));
-        ModelsOfLibraries.erase(DependencyLibrary);
-        continue;
-      }
+  auto MaybeStore = LibraryModelStore::open(Options.LibraryModelStoreURL);
+  if (not MaybeStore) {
+    auto Error = MaybeStore.takeError();
+    revng_log(ELFImporterLog,
+              "Can't open the library model store due to " << Error);
+    llvm::consumeError(std::move(Error));
+  } else {
+    Store = std::move(*MaybeStore);
+  }
+
+  // Each task writes in its own slot of Imported, no synchronization needed
+  Imported.resize(Libraries.size());
+  for (size_t I = 0; I < Libraries.size(); ++I) {
+    Pool.async([this, I, Architecture, AdjustedOptions] {
+      Imported[I] = importDependency(Libraries[I],
+                                     Architecture,
+                                     AdjustedOptions,
+                                     Store.get());
+    });
+  }
+}
+
+ModelMap BackgroundImports::takeDependencies() {
+  Pool.wait();
+
+  if (Store != nullptr) {
+    if (auto Error = Store->commit()) {
+      revng_log(ELFImporterLog,
+                "Can't commit the library model store due to " << Error);
+      llvm::consumeError(std::move(Error));
     }
   }
 
+  ModelMap Result;
+  for (size_t I = 0; I < Libraries.size(); ++I)
+    if (Imported[I])
+      Result[Libraries[I]] = std::move(*Imported[I]);
+  return Result;
+}
+
+template<typename T, bool HasAddend>
+void ELFImporter<T, HasAddend>::findMissingTypes(object::ELFFile<T> &TheELF,
+                                                 BackgroundImports &Imports) {
+  ModelMap ModelsOfLibraries = Imports.takeDependencies();
+  TypeCopierMap TypeCopiers;
+
   auto GetOrMakeACopier = [&](llvm::StringRef Name) -> TypeCopier & {
     if (auto It = TypeCopiers.find(Name.str()); It != TypeCopiers.end())
       return *It->second;
@@ -626,6 +758,9 @@ void ELFImporter<T, HasAddend>::parseSymbols(object::ELFFile<T> &TheELF,
     return;
   }
 
+  // Symbols are not sorted by address, create all the functions in a single
+  // batch. Existing functions, and the first symbol at each address, win.
+  auto NewFunctions = Model->Functions().batch_try_emplace();
   for (auto &Symbol : *ELFSymbols) {
     auto MaybeName = expectedToOptional(Symbol.getName(StrtabContent));
 
@@ -645,21 +780,16 @@ void ELFImporter<T, HasAddend>::parseSymbols(object::ELFFile<T> &TheELF,
 
     if (IsCode) {
       revng_assert(Address.isValid());
-      if (Model->Functions().tryGet(Address) == nullptr) {
-        model::Function &Function = Model->Functions()[Address];
-        if (MaybeName and MaybeName->size() > 0) {
-          Function.OriginalName() = *MaybeName;
-          // Insert Original name into exported ones, since it is by default
-          // true.
-          Function.ExportedNames().insert((*MaybeName).str());
-        }
+      model::Function &Function = NewFunctions.try_emplace(Address);
+      if (MaybeName and MaybeName->size() > 0) {
+        Function.OriginalName() = *MaybeName;
+        // Insert Original name into exported ones, since it is by default
+        // true.
+        Function.ExportedNames().insert((*MaybeName).str());
       }
     } else if (IsDataObject and Size > 0) {
-      auto IsSameAddress = [Address](const auto &E) {
-        return Address == E.Address;
-      };
-      if (llvm::count_if(DataSymbols, IsSameAddress) == 0)
-        DataSymbols.emplace_back(Address, Size, *MaybeName);
+      if (not DataSymbolAddresses.contains(Address))
+        recordDataSymbol(Address, Size, *MaybeName);
     }
   }
 }
@@ -814,10 +944,9 @@ void ELFImporter<T, HasAddend>::parseDynamicSymbol(Elf_Sym_Impl<T> &Symbol,
         Function->ExportedNames().insert(Name.str());
     } else {
       Address = relocate(fromGeneric(Symbol.st_value));
-      if (not llvm::is_contained(DataSymbols,
-                                 DataSymbol{ Address, Size, Name }))
+      if (not DataSymbolKeys.contains({ Address, Size, Name }))
         if (IsDataObject and Size > 0)
-          DataSymbols.emplace_back(Address, Size, Name);
+          recordDataSymbol(Address, Size, Name);
     }
   }
 }
@@ -1160,6 +1289,11 @@ void ELFImporter<T, HasAddend>::registerRelocations(Elf_Rel_Array Relocations,
   if (Dynsym.isAvailable())
     Symbols = Dynsym.extractAs<Elf_Sym>();
 
+  // Extract the string table once, it requires looking up its segment
+  StringRef DynstrContent;
+  if (Dynstr.isAvailable())
+    DynstrContent = Dynstr.extractString();
+
   for (Elf_Rel Relocation : Relocations) {
     auto Type = static_cast<unsigned char>(Relocation.getType(false));
     uint64_t Addend = RelocationHelper<T, HasAddend>::getAddend(Relocation);
@@ -1176,7 +1310,7 @@ void ELFImporter<T, HasAddend>::registerRelocations(Elf_Rel_Array Relocations,
                     << "Symbol count: " << Symbols.size());
       }
       const Elf_Sym &Symbol = Symbols[SymbolIndex];
-      auto MaybeName = Symbol.getName(Dynstr.extractString());
+      auto MaybeName = Symbol.getName(DynstrContent);
       if (MaybeName)
         SymbolName = *MaybeName;
       SymbolType = Symbol.getType();
@@ -4,6 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <tuple>
+
 #include "llvm/Object/ELFObjectFile.h"
 
 #include "revng/Model/Importer/Binary/BinaryImporterHelper.h"
@@ -16,6 +19,8 @@
 
 extern Logger<> ELFImporterLog;
 
+class BackgroundImports;
+
 namespace {
 
 class FilePortion {
@@ -71,6 +76,11 @@ private:
 private:
   llvm::SmallVector<DataSymbol, 32> DataSymbols;
 
+  /// The addresses and the keys of the elements of DataSymbols, to avoid
+  /// duplicates without scanning it
+  std::set<MetaAddress> DataSymbolAddresses;
+  std::set<std::tuple<MetaAddress, uint64_t, llvm::StringRef>> DataSymbolKeys;
+
 protected:
   std::optional<uint64_t> SymbolsCount;
   std::unique_ptr<FilePortion> DynstrPortion;
@@ -97,6 +107,14 @@ public:
   llvm::Error import(const ImporterOptions &Options) override;
 
 private:
+  void recordDataSymbol(MetaAddress Address,
+                        uint64_t Size,
+                        llvm::StringRef Name) {
+    DataSymbols.emplace_back(Address, Size, Name);
+    DataSymbolAddresses.insert(Address);
+    DataSymbolKeys.insert({ Address, Size, Name });
+  }
+
   MetaAddress getGenericPointer(Pointer Ptr) const {
     if (not Ptr.isIndirect())
       return Ptr.value();
@@ -149,7 +167,7 @@ private:
                           llvm::StringRef Dynstr);
 
   void findMissingTypes(llvm::object::ELFFile<T> &TheELF,
-                        const ImporterOptions &Options);
+                        BackgroundImports &Imports);
 
 protected:
   template<typename Q>
@@ -0,0 +1,93 @@
+/// \file LibraryModelStore.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Importer/Binary/Options.h"
+#include "revng/Support/Debug.h"
+
+#include "LibraryModelStore.h"
+
+using namespace llvm;
+
+static Logger<> Log("library-model-store");
+
+Expected<std::unique_ptr<LibraryModelStore>>
+LibraryModelStore::open(StringRef URL) {
+  if (URL.empty())
+    return nullptr;
+
+  auto MaybeClient = revng::StorageClient::fromPathOrURL(URL);
+  if (not MaybeClient)
+    return MaybeClient.takeError();
+
+  auto *Result = new LibraryModelStore(std::move(*MaybeClient));
+  return std::unique_ptr<LibraryModelStore>(Result);
+}
+
+std::string LibraryModelStore::key(StringRef BuildID,
+                                   model::Architecture::Values Architecture,
+                                   const ImporterOptions &Options) {
+  // Additional debug info files are specific to each project
+  if (BuildID.empty() or not Options.AdditionalDebugInfoPaths.empty())
+    return {};
+
+  std::string Result;
+  raw_string_ostream Stream(Result);
+  Stream << BuildID << "-" << model::Architecture::getName(Architecture) << "-"
+         << format_hex(Options.BaseAddress, 0) << "-debug-info-"
+         << static_cast<unsigned>(Options.DebugInfo);
+  if (Options.EnableRemoteDebugInfo)
+    Stream << "-remote";
+  Stream << ".model";
+  Stream.flush();
+
+  return Result;
+}
+
+std::optional<TupleTree<model::Binary>>
+LibraryModelStore::load(StringRef Key) {
+  auto MaybeType = Client->type(Key);
+  if (not MaybeType) {
+    auto Error = MaybeType.takeError();
+    revng_log(Log, "Cannot look up " << Key << " due to " << Error);
+    llvm::consumeError(std::move(Error));
+    return std::nullopt;
+  }
+
+  if (*MaybeType != revng::PathType::File)
+    return std::nullopt;
+
+  auto MaybeFile = Client->getReadableFile(Key);
+  if (not MaybeFile) {
+    auto Error = MaybeFile.takeError();
+    revng_log(Log, "Cannot read " << Key << " due to " << Error);
+    llvm::consumeError(std::move(Error));
+    return std::nullopt;
+  }
+
+  StringRef Buffer = (*MaybeFile)->buffer().getBuffer();
+  auto MaybeModel = TupleTree<model::Binary>::deserialize(Buffer);
+  if (not MaybeModel or not (*MaybeModel)->verify()) {
+    revng_log(Log, "Ignoring the invalid model in " << Key);
+    return std::nullopt;
+  }
+
+  revng_log(Log, "Reusing the model in " << Key);
+  return std::move(*MaybeModel);
+}
+
+Error LibraryModelStore::store(StringRef Key,
+                               const TupleTree<model::Binary> &Model) {
+  using revng::ContentEncoding;
+  auto MaybeFile = Client->getWritableFile(Key, ContentEncoding::None);
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+
+  Model.serializeBinary((*MaybeFile)->os());
+  return (*MaybeFile)->commit();
+}
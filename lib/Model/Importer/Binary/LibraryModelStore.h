@@ -0,0 +1,58 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Storage/StorageClient.h"
+#include "revng/TupleTree/TupleTree.h"
+
+struct ImporterOptions;
+
+/// A content addressed store of the models of libraries, meant to be shared
+/// among projects whose binaries link the same libraries.
+///
+/// Models are keyed by the build ID of the library and by the options they
+/// have been imported with: importing a library which is already in the store
+/// costs a single read. The store lives wherever a `revng::StorageClient` can
+/// reach, e.g., a local directory or an S3 bucket.
+///
+/// Like the underlying client, it can be used from different threads at the
+/// same time, as long as they operate on different keys.
+class LibraryModelStore {
+private:
+  std::unique_ptr<revng::StorageClient> Client;
+
+private:
+  LibraryModelStore(std::unique_ptr<revng::StorageClient> &&Client) :
+    Client(std::move(Client)) {}
+
+public:
+  /// \return the store at \p URL, or nullptr if \p URL is empty
+  static llvm::Expected<std::unique_ptr<LibraryModelStore>>
+  open(llvm::StringRef URL);
+
+public:
+  /// \return the key of the model of the library with build ID \p BuildID, or
+  ///         an empty string if such a model cannot be shared
+  static std::string key(llvm::StringRef BuildID,
+                         model::Architecture::Values Architecture,
+                         const ImporterOptions &Options);
+
+  /// \return the model stored with \p Key, if any
+  ///
+  /// \note a store which cannot be read is treated as empty
+  std::optional<TupleTree<model::Binary>> load(llvm::StringRef Key);
+
+  llvm::Error store(llvm::StringRef Key, const TupleTree<model::Binary> &Model);
+
+  llvm::Error commit() { return Client->commit(); }
+};
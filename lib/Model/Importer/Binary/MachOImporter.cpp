@@ -268,6 +268,8 @@ Error MachOImporter::import() {
     }
   }
 
+  File.reindexSegments();
+
   if (EntryPointOffset) {
     using namespace model::Architecture;
     auto LLVMArchitecture = toLLVMArchitecture(Model->Architecture());
@@ -57,9 +57,18 @@ cl::opt<bool> EnableRemoteDebugInfo("enable-remote-debug-info",
                                     cl::cat(MainCategory),
                                     cl::init(false));
 
+constexpr SR DescStore = "Path or URL of a store of the models of the "
+                         "libraries, shared among projects and keyed by "
+                         "build ID.";
+cl::opt<std::string> LibraryModelStoreURL("library-model-store",
+                                          cl::desc(DescStore),
+                                          cl::value_desc("path or url"),
+                                          cl::cat(MainCategory));
+
 const ImporterOptions importerOptions() {
   return ImporterOptions{ .BaseAddress = BaseAddress,
                           .DebugInfo = DebugInfo,
                           .EnableRemoteDebugInfo = EnableRemoteDebugInfo,
-                          .AdditionalDebugInfoPaths = ImportDebugInfo };
+                          .AdditionalDebugInfoPaths = ImportDebugInfo,
+                          .LibraryModelStoreURL = LibraryModelStoreURL };
 }
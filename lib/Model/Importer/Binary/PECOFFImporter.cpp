@@ -143,6 +143,8 @@ Error PECOFFImporter::parseSectionsHeaders() {
 }
 
 void PECOFFImporter::parseSymbols() {
+  // Existing functions, and the first symbol at each address, win
+  auto NewFunctions = Model->Functions().batch_try_emplace();
   for (auto Sym : TheBinary.symbols()) {
     COFFSymbolRef Symbol = TheBinary.getCOFFSymbol(Sym);
 
@@ -157,10 +159,7 @@ void PECOFFImporter::parseSymbols() {
 
     // Relocate the symbol.
     MetaAddress Address = ImageBase + Symbol.getValue();
-    if (Model->Functions().contains(Address))
-      continue;
-
-    model::Function &Function = Model->Functions()[Address];
+    model::Function &Function = NewFunctions.try_emplace(Address);
     Function.OriginalName() = *NameOrErr;
   }
 }
@@ -21,17 +21,21 @@ struct DataSymbol {
   bool operator==(const DataSymbol &) const = default;
 };
 
+/// \note the fields of \p Struct must not overlap each other, as it's the case
+///       for the structs populated by the helpers below
 inline bool checkForOverlap(const model::StructDefinition &Struct,
                             uint64_t Offset,
                             uint64_t Size) {
-  for (auto &Current : Struct.Fields()) {
-    uint64_t CurrentSize = *Current.Type()->size();
-    if ((Current.Offset() < Offset + Size))
-      if (Current.Offset() + CurrentSize > Offset)
-        return true;
-  }
-
-  return false;
+  // Fields are sorted by offset and don't overlap, so their ends are sorted
+  // too: only the last field starting before the end of the range can reach
+  // into it
+  auto It = Struct.Fields().lower_bound(Offset + Size);
+  if (It == Struct.Fields().begin())
+    return false;
+
+  const model::StructField &Previous = *std::prev(It);
+  uint64_t PreviousSize = *Previous.Type()->size();
+  return Previous.Offset() + PreviousSize > Offset;
 }
 
 inline void importSymbolsInto(model::Binary &Binary,
@@ -16,9 +16,12 @@
 #include "llvm/DebugInfo/DWARF/DWARFFormValue.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/Object/ELFObjectFile.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -41,6 +44,54 @@ using namespace llvm::dwarf;
 static Logger<> DILogger("dwarf-importer");
 static const std::string GlobalDebugDirectory = "/usr/lib/debug/";
 
+static cl::opt<unsigned> DwarfImportThreads("dwarf-import-threads",
+                                            cl::desc("Number of threads "
+                                                     "parsing the DIEs of "
+                                                     "the compile units (0 "
+                                                     "means all the "
+                                                     "available cores)"),
+                                            cl::init(1));
+
+/// \return true if the DIEs of \p Unit are in a split DWARF file
+static bool isSkeleton(DWARFUnit &Unit) {
+  DWARFDie UnitDie = Unit.getUnitDIE(/* ExtractUnitDIEOnly */ true);
+  return UnitDie and UnitDie.find({ DW_AT_dwo_name, DW_AT_GNU_dwo_name });
+}
+
+/// Parse the DIEs of all the \p Units in parallel, if requested, so that the
+/// (serial) import finds them ready
+static void extractDies(ArrayRef<DWARFUnit *> Units) {
+  if (DwarfImportThreads == 1 or Units.size() <= 1)
+    return;
+
+  // The context is not thread safe, only the state of each unit is written
+  // concurrently. Hence, what is cached in the context is populated upfront:
+  //
+  // * abbreviation sets, which are parsed lazily and cached in a map shared
+  //   by all the units;
+  // * split DWARF files, loaded on the first extraction of the DIEs of a
+  //   skeleton unit, which are extracted serially.
+  SmallVector<DWARFUnit *, 16> Independent;
+  for (DWARFUnit *Unit : Units) {
+    Unit->getAbbreviations();
+    if (isSkeleton(*Unit))
+      Unit->dies();
+    else
+      Independent.push_back(Unit);
+  }
+
+  if (Independent.size() <= 1) {
+    for (DWARFUnit *Unit : Independent)
+      Unit->dies();
+    return;
+  }
+
+  ThreadPool Pool(hardware_concurrency(DwarfImportThreads));
+  for (DWARFUnit *Unit : Independent)
+    Pool.async([Unit] { Unit->dies(); });
+  Pool.wait();
+}
+
 template<typename M>
 class ScopedSetElement {
 private:
@@ -372,6 +423,8 @@ private:
     for (const auto &CU : DICtx.compile_units())
       CompileUnits.push_back(CU.get());
 
+    extractDies(CompileUnits);
+
     Task T(CompileUnits.size(), "Compile units");
     for (llvm::DWARFUnit *CU : CompileUnits) {
       T.advance("", true);
@@ -949,7 +1002,7 @@ ArrayRef<uint8_t> getSectionsContents(StringRef Name, T &ELF) {
   return {};
 }
 
-static std::string getBuildID(const object::Binary *B) {
+std::string getBuildID(const object::Binary *B) {
   using namespace llvm::object;
 
   auto Handler = [&](auto *ELFObject) -> std::string {
@@ -1147,7 +1200,77 @@ findDebugInfoFileByName(StringRef FileName,
   return std::nullopt;
 }
 
-void DwarfImporter::import(StringRef FileName, const ImporterOptions &Options) {
+static bool hasDebugInfo(const object::ObjectFile *Object) {
+  using namespace llvm::object;
+  for (const SectionRef &Section : Object->sections()) {
+    StringRef SectionName;
+    if (Expected<StringRef> NameOrErr = Section.getName()) {
+      SectionName = *NameOrErr;
+    } else {
+      llvm::consumeError(NameOrErr.takeError());
+      continue;
+    }
+
+    // TODO: When adding support for Split dwarf, there will be
+    // .debug_info.dwo section, so we need to handle it.
+    if (SectionName == ".debug_info")
+      return true;
+  }
+  return false;
+}
+
+/// Look for the detached debug info of \p FileName on the device and, if it's
+/// not there and \p Fetch is set, find it on web by using the
+/// `fetch-debuginfo` tool.
+static std::optional<std::string>
+findDebugInfoFile(StringRef FileName,
+                  StringRef DebugFile,
+                  llvm::object::ObjectFile *ELF,
+                  bool Fetch) {
+  auto DebugFilePath = findDebugInfoFileByName(FileName, DebugFile, ELF);
+  if (DebugFilePath or not Fetch)
+    return DebugFilePath;
+
+  if (!::Runner.isProgramAvailable("revng")) {
+    revng_log(DILogger, "Can't find `revng` binary to run `fetch-debuginfo`.");
+    return std::nullopt;
+  }
+
+  int ExitCode = runFetchDebugInfoWithLevel(FileName);
+  if (ExitCode != 0) {
+    revng_log(DILogger,
+              "Failed to find debug info with `revng model "
+              "fetch-debuginfo`.");
+    return std::nullopt;
+  }
+
+  return findDebugInfoFileByName(FileName, DebugFile, ELF);
+}
+
+void prefetchDebugInfo(StringRef FileName, const ImporterOptions &Options) {
+  using namespace llvm::object;
+  if (Options.DebugInfo == DebugInfoLevel::No)
+    return;
+
+  Expected<OwningBinary<Binary>> BinOrErr = createBinary(FileName);
+  if (not BinOrErr) {
+    revng_log(DILogger, "Can't create binary for " << FileName);
+    llvm::consumeError(BinOrErr.takeError());
+    return;
+  }
+
+  auto *ELF = dyn_cast<ELFObjectFileBase>(BinOrErr->getBinary());
+  if (ELF == nullptr or hasDebugInfo(ELF))
+    return;
+
+  StringRef DebugFile = getDebugFileName(ELF);
+  if (not DebugFile.empty())
+    findDebugInfoFile(FileName, DebugFile, ELF, true);
+}
+
+void DwarfImporter::import(StringRef FileName,
+                           const ImporterOptions &Options,
+                           bool FetchDebugInfo) {
   Task T(3,
          "Importing DWARF information for "
            + llvm::sys::path::filename(FileName));
@@ -1162,29 +1285,6 @@ void DwarfImporter::import(StringRef FileName, const ImporterOptions &Options) {
   Expected<std::unique_ptr<Binary>> BinOrErr = object::createBinary(*Buffer);
   error(FileName, errorToErrorCode(BinOrErr.takeError()));
 
-  // Find Debugging Information.
-  // If the file has debug info sections within itself, no need for finding
-  // it on the device.
-  // TODO: When we add support for Split DWARF, this will need additional
-  // improvement.
-  auto HasDebugInfo = [](ObjectFile *Object) {
-    for (const SectionRef &Section : Object->sections()) {
-      StringRef SectionName;
-      if (Expected<StringRef> NameOrErr = Section.getName()) {
-        SectionName = *NameOrErr;
-      } else {
-        llvm::consumeError(NameOrErr.takeError());
-        continue;
-      }
-
-      // TODO: When adding support for Split dwarf, there will be
-      // .debug_info.dwo section, so we need to handle it.
-      if (SectionName == ".debug_info")
-        return true;
-    }
-    return false;
-  };
-
   auto PerformImport = [this, &T, &Options](StringRef FilePath,
                                             StringRef TheDebugFile) {
     auto ExpectedBinary = object::createBinary(FilePath);
@@ -1200,37 +1300,24 @@ void DwarfImporter::import(StringRef FileName, const ImporterOptions &Options) {
     }
   };
 
+  // Find Debugging Information.
+  // If the file has debug info sections within itself, no need for finding
+  // it on the device.
+  // TODO: When we add support for Split DWARF, this will need additional
+  // improvement.
   if (auto *ELF = dyn_cast<ObjectFile>(BinOrErr->get())) {
-    if (Options.DebugInfo != DebugInfoLevel::No && !HasDebugInfo(ELF)) {
-      // There are no .debug_* sections in the file itself, let's try to find it
-      // on the device, otherwise find it on web by using the `fetch-debuginfo`
-      // tool.
+    if (Options.DebugInfo != DebugInfoLevel::No && !hasDebugInfo(ELF)) {
       auto DebugFile = getDebugFileName(BinOrErr->get());
       if (!DebugFile.size()) {
         revng_log(DILogger, "Can't find file name of the debug file.");
         return;
       }
-      auto DebugFilePath = findDebugInfoFileByName(FileName, DebugFile, ELF);
-      if (!DebugFilePath) {
-        if (!::Runner.isProgramAvailable("revng")) {
-          revng_log(DILogger,
-                    "Can't find `revng` binary to run `fetch-debuginfo`.");
-          return;
-        }
 
-        int ExitCode = runFetchDebugInfoWithLevel(FileName);
-        if (ExitCode != 0) {
-          revng_log(DILogger,
-                    "Failed to find debug info with `revng model "
-                    "fetch-debuginfo`.");
-        } else {
-          DebugFilePath = findDebugInfoFileByName(FileName, DebugFile, ELF);
-          if (DebugFilePath)
-            PerformImport(*DebugFilePath, DebugFile);
-        }
-      } else {
+      if (auto DebugFilePath = findDebugInfoFile(FileName,
+                                                 DebugFile,
+                                                 ELF,
+                                                 FetchDebugInfo))
         PerformImport(*DebugFilePath, DebugFile);
-      }
     }
   }
 
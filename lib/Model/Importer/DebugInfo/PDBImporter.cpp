@@ -13,6 +13,7 @@
 #include "llvm/DebugInfo/CodeView/SymbolVisitorCallbacks.h"
 #include "llvm/DebugInfo/CodeView/TypeDumpVisitor.h"
 #include "llvm/DebugInfo/CodeView/TypeRecordHelpers.h"
+#include "llvm/DebugInfo/MSF/MappedBlockStream.h"
 #include "llvm/DebugInfo/PDB/Native/DbiStream.h"
 #include "llvm/DebugInfo/PDB/Native/GlobalsStream.h"
 #include "llvm/DebugInfo/PDB/Native/InfoStream.h"
@@ -20,12 +21,15 @@
 #include "llvm/DebugInfo/PDB/Native/ModuleDebugStream.h"
 #include "llvm/DebugInfo/PDB/Native/NativeSession.h"
 #include "llvm/DebugInfo/PDB/Native/PDBFile.h"
+#include "llvm/DebugInfo/PDB/Native/RawConstants.h"
 #include "llvm/DebugInfo/PDB/Native/SymbolStream.h"
 #include "llvm/DebugInfo/PDB/Native/TpiStream.h"
 #include "llvm/DebugInfo/PDB/PDB.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Program.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Model/Binary.h"
 #include "revng/Model/Importer/Binary/Options.h"
@@ -53,7 +57,31 @@ static llvm::cl::opt<std::string> UsePDB("use-pdb",
                                          llvm::cl::desc("Path to the PDB."),
                                          llvm::cl::cat(MainCategory));
 
+static cl::opt<unsigned> PDBImportThreads("pdb-import-threads",
+                                          cl::desc("Number of threads parsing "
+                                                   "the module symbol streams "
+                                                   "(0 means all the "
+                                                   "available cores)"),
+                                          cl::init(1),
+                                          cl::cat(MainCategory));
+
 namespace {
+
+/// A procedure found in the symbol stream of a module
+struct ProcedureSymbol {
+  std::string Name;
+  uint16_t Segment = 0;
+  uint32_t CodeOffset = 0;
+  TypeIndex FunctionType;
+};
+
+/// The procedures found in the symbol stream of a module, in order, and the
+/// error that interrupted its visit, if any
+struct ModuleProcedures {
+  std::vector<ProcedureSymbol> Procedures;
+  std::optional<std::string> Error;
+};
+
 class PDBImporterImpl {
 private:
   PDBImporter &Importer;
@@ -66,6 +94,8 @@ public:
 private:
   void populateTypes();
   void populateSymbolsWithTypes(NativeSession &Session);
+  void importProcedure(NativeSession &Session,
+                       const ProcedureSymbol &Procedure);
 };
 
 using ProcessedTypeMap = DenseMap<TypeIndex, model::UpcastableType>;
@@ -137,30 +167,24 @@ public:
   model::UpcastableType createPrimitiveType(TypeIndex SimpleType);
 };
 
-/// Visitor for CodeView symbol streams found in PDB files. It is being used for
-/// connecting functions from `Model` to their prototypes. We assume the PDB
-/// type stream was traversed before invoking this class.
-class PDBImporterSymbolVisitor : public SymbolVisitorCallbacks {
+/// Visitor for CodeView symbol streams found in PDB files. It collects the
+/// procedures, which are later used for connecting functions from `Model` to
+/// their prototypes.
+class PDBProcedureCollector : public SymbolVisitorCallbacks {
 private:
-  TupleTree<model::Binary> &Model;
-  ProcessedTypeMap &ProcessedTypes;
-
-  NativeSession &Session;
-  MetaAddress &ImageBase;
+  std::vector<ProcedureSymbol> &Procedures;
 
 public:
-  PDBImporterSymbolVisitor(TupleTree<model::Binary> &M,
-                           ProcessedTypeMap &ProcessedTypes,
-                           NativeSession &Session,
-                           MetaAddress &ImageBase) :
-    Model(M),
-    ProcessedTypes(ProcessedTypes),
-    Session(Session),
-    ImageBase(ImageBase) {}
-
-  Error visitSymbolBegin(CVSymbol &Record) override;
-  Error visitSymbolBegin(CVSymbol &Record, uint32_t Offset) override;
-  Error visitKnownRecord(CVSymbol &Record, ProcSym &Proc) override;
+  PDBProcedureCollector(std::vector<ProcedureSymbol> &Procedures) :
+    Procedures(Procedures) {}
+
+  Error visitKnownRecord(CVSymbol &Record, ProcSym &Proc) override {
+    Procedures.push_back({ .Name = Proc.Name.str(),
+                           .Segment = Proc.Segment,
+                           .CodeOffset = Proc.CodeOffset,
+                           .FunctionType = Proc.FunctionType });
+    return Error::success();
+  }
 };
 } // namespace
 
@@ -193,69 +217,85 @@ void PDBImporterImpl::populateTypes() {
   }
 }
 
-class PDBSymbolHandler {
-private:
-  PDBImporter &Importer;
-  ProcessedTypeMap &ProcessedTypes;
-  NativeSession &Session;
-  InputFile &Input;
-
-public:
-  PDBSymbolHandler(PDBImporter &Importer,
-                   ProcessedTypeMap &ProcessedTypes,
-                   NativeSession &Session,
-                   InputFile &Input) :
-    Importer(Importer),
-    ProcessedTypes(ProcessedTypes),
-    Session(Session),
-    Input(Input) {}
-
-  Error operator()(uint32_t Modi, const SymbolGroup &SG) {
-    auto ExpectedModS = getModuleDebugStream(*Importer.getPDBFile(), Modi);
-    if (ExpectedModS) {
-      ModuleDebugStreamRef &ModS = *ExpectedModS;
-
-      SymbolVisitorCallbackPipeline Pipeline;
-      SymbolDeserializer Deserializer(nullptr, CodeViewContainer::Pdb);
-      PDBImporterSymbolVisitor SymVisitor(Importer.getModel(),
-                                          ProcessedTypes,
-                                          Session,
-                                          Importer.getBaseAddress());
-
-      Pipeline.addCallbackToPipeline(Deserializer);
-      Pipeline.addCallbackToPipeline(SymVisitor);
-      CVSymbolVisitor Visitor(Pipeline);
-      auto SS = ModS.getSymbolsSubstream();
-      if (auto Err = Visitor.visitSymbolStream(ModS.getSymbolArray(),
-                                               SS.Offset))
-        return createStringError(errorToErrorCode(std::move(Err)),
-                                 Input.getFilePath());
-    } else {
-      // If the module stream does not exist, it is not an
-      // error condition.
-      consumeError(ExpectedModS.takeError());
-    }
+/// Collect the procedures in the symbol stream of the module \p Modi.
+///
+/// \note this can run concurrently on different modules of the same file.
+static void collectProcedures(PDBFile &File,
+                              const DbiModuleList &Modules,
+                              uint32_t Modi,
+                              ModuleProcedures &Result) {
+  DbiModuleDescriptor Descriptor = Modules.getModuleDescriptor(Modi);
+
+  // If the module stream does not exist, it is not an error condition.
+  uint16_t StreamIndex = Descriptor.getModuleStreamIndex();
+  if (StreamIndex == kInvalidStreamIndex)
+    return;
 
-    return Error::success();
+  // Don't use PDBFile::createIndexedStream: the streams it creates share the
+  // allocator of the file, which is not thread-safe.
+  BumpPtrAllocator Allocator;
+  using msf::MappedBlockStream;
+  auto Stream = MappedBlockStream::createIndexedStream(File.getMsfLayout(),
+                                                       File.getMsfBuffer(),
+                                                       StreamIndex,
+                                                       Allocator);
+  ModuleDebugStreamRef ModS(Descriptor, std::move(Stream));
+  if (auto Err = ModS.reload()) {
+    // An invalid module stream is ignored too
+    consumeError(std::move(Err));
+    return;
   }
-};
+
+  SymbolVisitorCallbackPipeline Pipeline;
+  SymbolDeserializer Deserializer(nullptr, CodeViewContainer::Pdb);
+  PDBProcedureCollector Collector(Result.Procedures);
+  Pipeline.addCallbackToPipeline(Deserializer);
+  Pipeline.addCallbackToPipeline(Collector);
+  CVSymbolVisitor Visitor(Pipeline);
+  auto SS = ModS.getSymbolsSubstream();
+  if (auto Err = Visitor.visitSymbolStream(ModS.getSymbolArray(), SS.Offset))
+    Result.Error = File.getFilePath().str() + ": " + toString(std::move(Err));
+}
 
 void PDBImporterImpl::populateSymbolsWithTypes(NativeSession &Session) {
-  auto InputFile = InputFile::open(Importer.getPDBFile()->getFilePath());
-  if (not InputFile) {
-    revng_log(DILogger, "Unable to open PDB file: " << InputFile.takeError());
-    consumeError(InputFile.takeError());
+  PDBFile &File = *Importer.getPDBFile();
+  auto DbiOrErr = File.getPDBDbiStream();
+  if (not DbiOrErr) {
+    revng_log(DILogger,
+              "Unable to find DBI in PDB file: " << DbiOrErr.takeError());
+    consumeError(DbiOrErr.takeError());
     return;
   }
 
-  FilterOptions Filters{};
-  LinePrinter Printer(/*Indent=*/2, false, nulls(), Filters);
-  const PrintScope HeaderScope(Printer, /*IndentLevel=*/2);
-  PDBSymbolHandler SymbolHandler(Importer, ProcessedTypes, Session, *InputFile);
-  if (auto Err = iterateSymbolGroups(*InputFile, HeaderScope, SymbolHandler)) {
-    revng_log(DILogger, "Unable to parse symbols: " << Err);
-    consumeError(std::move(Err));
-    return;
+  // Parse the module symbol streams, in parallel if requested
+  const DbiModuleList &Modules = DbiOrErr->modules();
+  uint32_t ModuleCount = Modules.getModuleCount();
+  std::vector<ModuleProcedures> Collected(ModuleCount);
+  auto Collect = [&File, &Modules, &Collected](uint32_t Modi) {
+    collectProcedures(File, Modules, Modi, Collected[Modi]);
+  };
+
+  if (PDBImportThreads == 1 or ModuleCount <= 1) {
+    for (uint32_t Modi = 0; Modi < ModuleCount; ++Modi)
+      Collect(Modi);
+  } else {
+    // Each task writes in its own slot of Collected, no synchronization needed
+    ThreadPool Pool(hardware_concurrency(PDBImportThreads));
+    for (uint32_t Modi = 0; Modi < ModuleCount; ++Modi)
+      Pool.async(Collect, Modi);
+    Pool.wait();
+  }
+
+  // Import the procedures in the original order: the first module that
+  // cannot be parsed interrupts the import
+  for (const ModuleProcedures &Module : Collected) {
+    for (const ProcedureSymbol &Procedure : Module.Procedures)
+      importProcedure(Session, Procedure);
+
+    if (Module.Error) {
+      revng_log(DILogger, "Unable to parse symbols: " << *Module.Error);
+      return;
+    }
   }
 }
 
@@ -1243,42 +1283,34 @@ PDBImporterTypeVisitor::makeModelTypeForIndex(TypeIndex Index) {
 
 // ==== Implementation of the Model Symbol-type connection. ==== //
 
-Error PDBImporterSymbolVisitor::visitSymbolBegin(CVSymbol &Record) {
-  return visitSymbolBegin(Record, 0);
-}
-
-Error PDBImporterSymbolVisitor::visitSymbolBegin(CVSymbol &Record,
-                                                 uint32_t Offset) {
-  return Error::success();
-}
+void PDBImporterImpl::importProcedure(NativeSession &Session,
+                                      const ProcedureSymbol &Procedure) {
+  revng_log(DILogger, "Importing " << Procedure.Name);
 
-Error PDBImporterSymbolVisitor::visitKnownRecord(CVSymbol &Record,
-                                                 ProcSym &Proc) {
-  revng_log(DILogger, "Importing " << Proc.Name);
+  TupleTree<model::Binary> &Model = Importer.getModel();
 
   // If it is not in the .idata already, we assume it is a static symbol.
-  if (not Model->ImportedDynamicFunctions().contains(Proc.Name.str())) {
-    uint64_t FunctionVirtualAddress = Session
-                                        .getRVAFromSectOffset(Proc.Segment,
-                                                              Proc.CodeOffset);
+  if (not Model->ImportedDynamicFunctions().contains(Procedure.Name)) {
+    uint64_t FunctionVirtualAddress;
+    FunctionVirtualAddress = Session.getRVAFromSectOffset(Procedure.Segment,
+                                                          Procedure.CodeOffset);
     // Relocate the symbol.
-    MetaAddress FunctionAddress = ImageBase + FunctionVirtualAddress;
+    MetaAddress FunctionAddress = Importer.getBaseAddress()
+                                  + FunctionVirtualAddress;
 
     if (not Model->Functions().contains(FunctionAddress)) {
       model::Function &Function = Model->Functions()[FunctionAddress];
-      Function.OriginalName() = Proc.Name;
-      TypeIndex FunctionTypeIndex = Proc.FunctionType;
+      Function.OriginalName() = Procedure.Name;
+      TypeIndex FunctionTypeIndex = Procedure.FunctionType;
       if (ProcessedTypes.find(FunctionTypeIndex) != ProcessedTypes.end())
         Function.Prototype() = ProcessedTypes[FunctionTypeIndex];
     } else {
       auto It = Model->Functions().find(FunctionAddress);
-      TypeIndex FunctionTypeIndex = Proc.FunctionType;
+      TypeIndex FunctionTypeIndex = Procedure.FunctionType;
       if (ProcessedTypes.find(FunctionTypeIndex) != ProcessedTypes.end())
         It->Prototype() = ProcessedTypes[FunctionTypeIndex];
     }
   }
 
   // TODO: Handle Imported functions.
-
-  return Error::success();
 }
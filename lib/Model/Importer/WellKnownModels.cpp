@@ -4,6 +4,14 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+#include <mutex>
+#include <optional>
+
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/YAMLParser.h"
+
 #include "revng/Model/Binary.h"
 #include "revng/Model/Importer/TypeCopier.h"
 #include "revng/Pipeline/RegisterAnalysis.h"
@@ -38,6 +46,74 @@ public:
     FromModel(FromModel), Copier(this->FromModel, DestinationModel) {}
 };
 
+struct ModelTarget {
+  model::Architecture::Values Architecture = model::Architecture::Invalid;
+  model::ABI::Values DefaultABI = model::ABI::Invalid;
+};
+
+/// Read the architecture and the default ABI of the model serialized in
+/// \p Path, without deserializing the rest of it
+static ModelTarget peekTarget(llvm::StringRef Path) {
+  ModelTarget Result;
+
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(Path);
+  if (not MaybeBuffer)
+    return Result;
+
+  llvm::SourceMgr SM;
+  llvm::yaml::Stream YAMLStream((*MaybeBuffer)->getBuffer(), SM);
+  auto Document = YAMLStream.begin();
+  if (Document == YAMLStream.end())
+    return Result;
+
+  llvm::yaml::Node *RootNode = Document->getRoot();
+  auto *Root = llvm::dyn_cast_or_null<llvm::yaml::MappingNode>(RootNode);
+  if (Root == nullptr)
+    return Result;
+
+  // Advancing the iterator skips the value of the previous entry: stop as
+  // soon as both the fields have been found
+  for (llvm::yaml::KeyValueNode &Entry : *Root) {
+    using llvm::yaml::ScalarNode;
+    auto *Key = llvm::dyn_cast_or_null<ScalarNode>(Entry.getKey());
+    auto *Value = llvm::dyn_cast_or_null<ScalarNode>(Entry.getValue());
+    if (Key == nullptr or Value == nullptr)
+      continue;
+
+    llvm::SmallString<16> KeyStorage;
+    llvm::SmallString<16> ValueStorage;
+    llvm::StringRef KeyName = Key->getValue(KeyStorage);
+    llvm::StringRef ValueName = Value->getValue(ValueStorage);
+    if (KeyName == "Architecture")
+      Result.Architecture = model::Architecture::fromName(ValueName);
+    else if (KeyName == "DefaultABI")
+      Result.DefaultABI = model::ABI::fromName(ValueName);
+
+    if (Result.Architecture != model::Architecture::Invalid
+        and Result.DefaultABI != model::ABI::Invalid)
+      break;
+  }
+
+  return Result;
+}
+
+/// \return the well-known model at \p Path, deserialized once per process:
+///         projects get cheap copies of it
+static TupleTree<model::Binary> loadWellKnownModel(const std::string &Path) {
+  static std::mutex Lock;
+  static std::map<std::string, TupleTree<model::Binary>> Cache;
+
+  std::lock_guard Guard(Lock);
+  auto It = Cache.find(Path);
+  if (It == Cache.end()) {
+    auto MaybeModel = TupleTree<model::Binary>::fromFile(Path);
+    revng_assert(MaybeModel);
+    It = Cache.emplace(Path, std::move(*MaybeModel)).first;
+  }
+
+  return It->second;
+}
+
 class ImportWellKnownModelsAnalysis {
 public:
   static constexpr auto Name = "import-well-known-models";
@@ -53,13 +129,21 @@ public:
       WellKnownFunctions;
     TupleTree<model::Binary> &Model = getWritableModelFromContext(Context);
 
-    // Load all well-known models
+    if (Model->ImportedDynamicFunctions().empty())
+      return llvm::Error::success();
+
+    // Load the well-known models matching the architecture and the ABI of the
+    // binary, the others can't contain any of the functions we look for
     for (const std::string &Path :
          revng::ResourceFinder.list("share/revng/well-known-models", ".yml")) {
-      auto MaybeModel = TupleTree<model::Binary>::fromFile(Path);
-      revng_assert(MaybeModel);
+      ModelTarget Target = peekTarget(Path);
+      if (Target.Architecture != Model->Architecture()
+          or Target.DefaultABI != Model->DefaultABI())
+        continue;
+
       using namespace std;
-      auto NewWKM = make_unique<WellKnownModel>(std::move(*MaybeModel), Model);
+      TupleTree<model::Binary> WellKnown = loadWellKnownModel(Path);
+      auto NewWKM = make_unique<WellKnownModel>(std::move(WellKnown), Model);
       WellKnownModels.push_back(std::move(NewWKM));
     }
 
@@ -5,6 +5,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <numeric>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/EquivalenceClasses.h"
 #include "llvm/ADT/PostOrderIterator.h"
@@ -26,18 +30,52 @@ static RegisterModelPass R("deduplicate-equivalent-types",
                            model::deduplicateEquivalentTypes);
 
 using Comparator = bool(model::TypeDefinition *, model::TypeDefinition *);
+using Bucketer = uint64_t(model::TypeDefinition *);
+
+/// Compare each element of \p ToTest with all those after it, dropping those
+/// that match. Only elements in the same bucket are compared.
+///
+/// \note \p Compare is expected to fail, with no side effects, on elements in
+///       different buckets: the comparisons that are performed and their order
+///       are then the same as comparing all the pairs, which is quadratic.
 static void compareAll(SmallVector<model::TypeDefinition *> &ToTest,
-                       std::function<Comparator> Compare) {
-  for (auto It = ToTest.begin(), End = ToTest.end(); It != End; ++It) {
-    model::TypeDefinition *Left = *It;
+                       function_ref<Bucketer> BucketOf,
+                       function_ref<Comparator> Compare) {
+  size_t Size = ToTest.size();
+  SmallVector<uint64_t> Buckets;
+  for (model::TypeDefinition *T : ToTest)
+    Buckets.push_back(BucketOf(T));
+
+  // Sort by bucket, preserving the order within the same bucket
+  SmallVector<size_t> Order(Size);
+  std::iota(Order.begin(), Order.end(), 0);
+  llvm::stable_sort(Order, [&Buckets](size_t Left, size_t Right) {
+    return Buckets[Left] < Buckets[Right];
+  });
+
+  SmallVector<size_t> Position(Size);
+  for (size_t I = 0; I < Size; ++I)
+    Position[Order[I]] = I;
+
+  BitVector Dropped(Size);
+  SmallVector<model::TypeDefinition *> Result;
+  for (size_t Left = 0; Left < Size; ++Left) {
+    if (Dropped[Left])
+      continue;
 
-    auto IsDuplicate = [Compare, Left](model::TypeDefinition *Right) {
-      return Compare(Left, Right);
-    };
+    Result.push_back(ToTest[Left]);
 
-    // Compare with all those after It and delete them if match
-    End = ToTest.erase(std::remove_if(It + 1, End, IsDuplicate), End);
+    // Compare with all those after Left in its bucket and drop them if match
+    for (size_t I = Position[Left] + 1;
+         I < Size and Buckets[Order[I]] == Buckets[Left];
+         ++I) {
+      size_t Right = Order[I];
+      if (not Dropped[Right] and Compare(ToTest[Left], ToTest[Right]))
+        Dropped.set(Right);
+    }
   }
+
+  ToTest = std::move(Result);
 }
 
 class TypeSystemDeduplicator {
@@ -53,13 +91,22 @@ private:
   EquivalenceClasses<model::TypeDefinition *> StrongEquivalence;
   EquivalenceClasses<model::TypeDefinition *> WeakEquivalence;
   Graph TypeGraph;
-  std::map<const model::TypeDefinition *, Node *> TypeToNode;
+  DenseMap<const model::TypeDefinition *, Node *> TypeToNode;
   std::vector<model::TypeDefinition *> VisitOrder;
 
+  /// Hash of what localCompare compares
+  DenseMap<const model::TypeDefinition *, uint64_t> LocalHash;
+
+  /// Types that might be strongly equivalent are in the same candidate class.
+  /// Conversely, types in different classes are never strongly equivalent.
+  DenseMap<const model::TypeDefinition *, uint64_t> CandidateClass;
+
 private:
   TypeSystemDeduplicator(TupleTree<model::Binary> &Model) {
-    for (auto &T : Model->TypeDefinitions())
+    for (auto &T : Model->TypeDefinitions()) {
       Types.push_back(&*T);
+      LocalHash[&*T] = T->localHash();
+    }
   }
 
 public:
@@ -69,6 +116,7 @@ public:
     Helper.computeWeakEquivalenceClasses();
     Helper.createTypeGraph();
     Helper.computeVisitOrder();
+    Helper.computeCandidateClasses();
     Helper.computeStrongEquivalenceClasses();
     return std::move(Helper.StrongEquivalence);
   }
@@ -137,7 +185,10 @@ private:
           }
         };
 
-        compareAll(ToTest, Compare);
+        auto BucketOf = [this](model::TypeDefinition *T) {
+          return LocalHash.at(T);
+        };
+        compareAll(ToTest, BucketOf, Compare);
 
         revng_log(Log,
                   GroupName << " has " << ToTest.size()
@@ -184,6 +235,58 @@ private:
     TypeGraph.removeNode(Entry);
   }
 
+  /// Compute the candidate classes through partition refinement: start by
+  /// grouping types that are locally equal, then split classes until all the
+  /// types in a class have their successors in the same classes.
+  ///
+  /// deepCompare only succeeds on types that would end up in the same class,
+  /// therefore candidate classes can be used to skip comparisons that are bound
+  /// to fail.
+  void computeCandidateClasses() {
+    revng_log(Log, "Computing candidate classes");
+    LoggerIndent Indent(Log);
+
+    using Kind = model::TypeDefinitionKind::Values;
+    using LocalKey = std::tuple<std::string, Kind, uint64_t>;
+    std::map<LocalKey, uint64_t> InitialClasses;
+    for (model::TypeDefinition *T : Types) {
+      LocalKey Key = { T->OriginalName(), T->Kind(), LocalHash.at(T) };
+      auto It = InitialClasses.try_emplace(Key, InitialClasses.size()).first;
+      CandidateClass[T] = It->second;
+    }
+
+    size_t ClassesCount = InitialClasses.size();
+    unsigned Iterations = 0;
+    while (true) {
+      ++Iterations;
+
+      // The new class of a type is identified by its current class and the
+      // classes of its successors
+      std::map<SmallVector<uint64_t, 4>, uint64_t> Signatures;
+      DenseMap<const model::TypeDefinition *, uint64_t> NewClass;
+      for (model::TypeDefinition *T : Types) {
+        SmallVector<uint64_t, 4> Signature = { CandidateClass.at(T) };
+        for (Node *Successor : TypeToNode.at(T)->successors())
+          Signature.push_back(CandidateClass.at(Successor->T));
+
+        auto It = Signatures.try_emplace(std::move(Signature),
+                                         Signatures.size());
+        NewClass[T] = It.first->second;
+      }
+
+      CandidateClass = std::move(NewClass);
+
+      // Classes are only ever split: if their number didn't change, we're done
+      if (Signatures.size() == ClassesCount)
+        break;
+      ClassesCount = Signatures.size();
+    }
+
+    revng_log(Log,
+              ClassesCount << " candidate classes for " << Types.size()
+                           << " types after " << Iterations << " iterations");
+  }
+
   void computeStrongEquivalenceClasses() {
     revng_log(Log, "Computing strong equivalence classes");
     LoggerIndent Indent(Log);
@@ -216,7 +319,10 @@ private:
         return Result;
       };
 
-      compareAll(ToTest, Compare);
+      auto BucketOf = [this](model::TypeDefinition *T) {
+        return CandidateClass.at(T);
+      };
+      compareAll(ToTest, BucketOf, Compare);
     }
   }
 
@@ -232,8 +338,8 @@ private:
     Node *Right = TypeToNode.at(RightType);
 
     // Create a bidirectional map associating left and right nodes
-    std::map<Node *, Node *> LeftToRight;
-    std::map<Node *, Node *> RightToLeft;
+    DenseMap<Node *, Node *> LeftToRight;
+    DenseMap<Node *, Node *> RightToLeft;
 
     // Initialize the map with the two considered nodes
     LeftToRight[Left] = Right;
@@ -276,8 +382,8 @@ private:
   }
 
   /// Support function for deepCompare
-  bool compareSuccessor(std::map<Node *, Node *> &LeftToRight,
-                        std::map<Node *, Node *> &RightToLeft,
+  bool compareSuccessor(DenseMap<Node *, Node *> &LeftToRight,
+                        DenseMap<Node *, Node *> &RightToLeft,
                         df_iterator_default_set<Node *> &Visited,
                         Node *Left,
                         Node *Right) {
@@ -6,6 +6,11 @@
 
 #include <set>
 #include <string>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Model/Pass/PromoteOriginalName.h"
 #include "revng/Model/Pass/RegisterModelPass.h"
@@ -13,6 +18,13 @@
 using namespace llvm;
 using namespace model;
 
+static cl::opt<unsigned>
+  PromoteNameThreads("promote-original-name-threads",
+                     cl::desc("Number of threads promoting the names of "
+                              "fields and arguments (0 means all the "
+                              "available cores)"),
+                     cl::init(1));
+
 static RegisterModelPass R("promote-original-name",
                            "Promote OriginalName fields to CustomName ensuring "
                            "the validity of the model is preserved",
@@ -52,16 +64,18 @@ public:
     promoteSymbolsImpl(Collection, Unwrap, GlobalSymbols, TakenLocalSymbols);
   }
 
-  void promoteLocalSymbols(auto &Collection, auto Unwrap) {
+  /// \note this doesn't alter the state of the promoter, therefore it can be
+  ///       invoked concurrently on distinct collections
+  void promoteLocalSymbols(auto &Collection, auto Unwrap) const {
     std::set<Identifier> LocalBucket;
     promoteSymbolsImpl(Collection, Unwrap, LocalBucket, GlobalSymbols);
   }
 
 private:
-  void promoteSymbolsImpl(auto &Collection,
-                          auto Unwrap,
-                          std::set<Identifier> &Namespace,
-                          const std::set<Identifier> &Taken) {
+  static void promoteSymbolsImpl(auto &Collection,
+                                 auto Unwrap,
+                                 std::set<Identifier> &Namespace,
+                                 const std::set<Identifier> &Taken) {
     // TODO: collapse uint8_t typedefs into the primitive type
     for (auto &Wrapped : Collection) {
       auto *Entry = Unwrap(Wrapped);
@@ -83,6 +97,20 @@ private:
   }
 };
 
+/// Promote the OriginalNames of the fields or arguments of \p Definition
+static void promoteLocalSymbols(const SymbolPromoter &Promoter,
+                                model::TypeDefinition &Definition) {
+  auto AddressOf = [](auto &Entry) { return &Entry; };
+  if (auto *Struct = dyn_cast<model::StructDefinition>(&Definition))
+    Promoter.promoteLocalSymbols(Struct->Fields(), AddressOf);
+  else if (auto *Union = dyn_cast<model::UnionDefinition>(&Definition))
+    Promoter.promoteLocalSymbols(Union->Fields(), AddressOf);
+  else if (auto *CFT = dyn_cast<model::CABIFunctionDefinition>(&Definition))
+    Promoter.promoteLocalSymbols(CFT->Arguments(), AddressOf);
+  else if (auto *RFT = dyn_cast<model::RawFunctionDefinition>(&Definition))
+    Promoter.promoteLocalSymbols(RFT->Arguments(), AddressOf);
+}
+
 /// Promote OriginalNames to CustomNames
 void model::promoteOriginalName(TupleTree<model::Binary> &Model) {
   auto AddressOf = [](auto &Entry) { return &Entry; };
@@ -94,15 +122,14 @@ void model::promoteOriginalName(TupleTree<model::Binary> &Model) {
   Promoter.recordGlobalSymbols(Model->Functions(), AddressOf);
   Promoter.recordGlobalSymbols(Model->ImportedDynamicFunctions(), AddressOf);
   Promoter.recordGlobalSymbols(Model->TypeDefinitions(), Unwrap);
-  for (auto &UP : Model->TypeDefinitions())
-    if (auto *Enum = dyn_cast<model::EnumDefinition>(UP.get()))
-      Promoter.recordGlobalSymbols(Enum->Entries(), AddressOf);
-
   Promoter.recordGlobalSymbols(Model->Segments(), AddressOf);
 
-  // Reserve symbols we can't use for global symbols
+  // Reserve the names of the enum entries, which are global, and the symbols
+  // we can't use for global symbols, in a single visit of the types
   for (auto &UP : Model->TypeDefinitions()) {
-    if (auto *Struct = dyn_cast<model::StructDefinition>(UP.get()))
+    if (auto *Enum = dyn_cast<model::EnumDefinition>(UP.get()))
+      Promoter.recordGlobalSymbols(Enum->Entries(), AddressOf);
+    else if (auto *Struct = dyn_cast<model::StructDefinition>(UP.get()))
       Promoter.recordLocalSymbols(Struct->Fields(), AddressOf);
     else if (auto *Union = dyn_cast<model::UnionDefinition>(UP.get()))
       Promoter.recordLocalSymbols(Union->Fields(), AddressOf);
@@ -112,7 +139,8 @@ void model::promoteOriginalName(TupleTree<model::Binary> &Model) {
       Promoter.recordLocalSymbols(RFT->Arguments(), AddressOf);
   }
 
-  // Promote global symbols
+  // Promote global symbols. The order matters: in case of a clash, the first
+  // symbol keeps the original name.
   Promoter.promoteGlobalSymbols(Model->Functions(), AddressOf);
   Promoter.promoteGlobalSymbols(Model->ImportedDynamicFunctions(), AddressOf);
   Promoter.promoteGlobalSymbols(Model->TypeDefinitions(), Unwrap);
@@ -122,15 +150,30 @@ void model::promoteOriginalName(TupleTree<model::Binary> &Model) {
 
   Promoter.promoteGlobalSymbols(Model->Segments(), AddressOf);
 
-  // Promote local symbols
-  for (auto &UP : Model->TypeDefinitions()) {
-    if (auto *Struct = dyn_cast<model::StructDefinition>(UP.get()))
-      Promoter.promoteLocalSymbols(Struct->Fields(), AddressOf);
-    else if (auto *Union = dyn_cast<model::UnionDefinition>(UP.get()))
-      Promoter.promoteLocalSymbols(Union->Fields(), AddressOf);
-    else if (auto *CFT = dyn_cast<model::CABIFunctionDefinition>(UP.get()))
-      Promoter.promoteLocalSymbols(CFT->Arguments(), AddressOf);
-    else if (auto *RFT = dyn_cast<model::RawFunctionDefinition>(UP.get()))
-      Promoter.promoteLocalSymbols(RFT->Arguments(), AddressOf);
+  // Promote local symbols. Each type is a namespace of its own and the global
+  // symbols are now fixed, so types can be handled independently.
+  std::vector<model::TypeDefinition *> Definitions;
+  Definitions.reserve(Model->TypeDefinitions().size());
+  for (auto &UP : Model->TypeDefinitions())
+    Definitions.push_back(UP.get());
+
+  if (PromoteNameThreads == 1 or Definitions.size() <= 1) {
+    for (model::TypeDefinition *Definition : Definitions)
+      promoteLocalSymbols(Promoter, *Definition);
+  } else {
+    ThreadPool Pool(hardware_concurrency(PromoteNameThreads));
+
+    // Hand out contiguous chunks, a task per type would cost more than the
+    // work itself
+    constexpr size_t ChunkSize = 1024;
+    for (size_t Start = 0; Start < Definitions.size(); Start += ChunkSize) {
+      ArrayRef<model::TypeDefinition *> Chunk(Definitions);
+      Chunk = Chunk.slice(Start, std::min(ChunkSize, Chunk.size() - Start));
+      Pool.async([&Promoter, Chunk] {
+        for (model::TypeDefinition *Definition : Chunk)
+          promoteLocalSymbols(Promoter, *Definition);
+      });
+    }
+    Pool.wait();
   }
 }
@@ -4,9 +4,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include "llvm/ADT/DepthFirstIterator.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/SmallVector.h"
 
-#include "revng/ADT/GenericGraph.h"
 #include "revng/Model/Filters.h"
 #include "revng/Model/Pass/PurgeUnnamedAndUnreachableTypes.h"
 #include "revng/Model/Pass/RegisterModelPass.h"
@@ -138,31 +138,22 @@ void model::purgeUnreachableTypes(TupleTree<model::Binary> &Model) {
 
 static void model::purgeTypesImpl(TupleTree<model::Binary> &Model,
                                   bool KeepTypesWithName) {
-  struct NodeData {
-    const model::TypeDefinition *T;
+  // Mark all the types reachable from the roots. Instead of building the
+  // whole type graph upfront, the edges of a type are inspected only once it
+  // has been reached, so that unreachable types cost nothing but a lookup in
+  // the final sweep.
+  llvm::DenseSet<const model::TypeDefinition *> Reached;
+  llvm::SmallVector<const model::TypeDefinition *, 16> Worklist;
+  auto Mark = [&Reached, &Worklist](const model::TypeDefinition *T) {
+    if (Reached.insert(T).second)
+      Worklist.push_back(T);
   };
-  using Node = ForwardNode<NodeData>;
-  using Graph = GenericGraph<Node>;
-
-  Graph TypeGraph;
-  std::map<const model::TypeDefinition *, Node *> TypeToNode;
-
-  llvm::SmallPtrSet<const model::TypeDefinition *, 16> ToKeep;
 
   // Remember those types we want to preserve.
-  for (const model::UpcastableTypeDefinition &T : Model->TypeDefinitions()) {
-    if (KeepTypesWithName)
+  if (KeepTypesWithName)
+    for (const model::UpcastableTypeDefinition &T : Model->TypeDefinitions())
       if (not T->CustomName().empty() or not T->OriginalName().empty())
-        ToKeep.insert(T.get());
-
-    TypeToNode[T.get()] = TypeGraph.addNode(NodeData{ T.get() });
-  }
-
-  // Create type system edges
-  for (const model::UpcastableTypeDefinition &D : Model->TypeDefinitions())
-    for (const model::Type *Edge : D->edges())
-      if (const model::TypeDefinition *Definition = Edge->skipToDefinition())
-        TypeToNode.at(D.get())->addSuccessor(TypeToNode.at(Definition));
+        Mark(T.get());
 
   // Record references to types *outside* of Model->Types
   auto VisitBinary = [&](auto &Field) {
@@ -170,21 +161,26 @@ static void model::purgeTypesImpl(TupleTree<model::Binary> &Model,
       using type = std::decay_t<decltype(Element)>;
       if constexpr (std::is_same_v<type, DefinitionReference>)
         if (Element.isValid())
-          ToKeep.insert(Element.get());
+          Mark(Element.get());
     };
     visitTupleTree(Field, Visitor, [](auto) {});
   };
   visitTupleExcept(VisitBinary, *Model, &Model->TypeDefinitions());
 
-  // Visit all the nodes reachable from ToKeep
-  df_iterator_default_set<Node *> Visited;
-  for (const model::TypeDefinition *T : ToKeep)
-    for (Node *N : depth_first_ext(TypeToNode.at(T), Visited))
-      ;
+  // Visit all the types reachable from the roots
+  while (not Worklist.empty()) {
+    const model::TypeDefinition *Current = Worklist.pop_back_val();
+    for (const model::Type *Edge : Current->edges())
+      if (const model::TypeDefinition *Definition = Edge->skipToDefinition())
+        Mark(Definition);
+  }
 
   // Purge the non-visited
+  if (Reached.size() == Model->TypeDefinitions().size())
+    return;
+
   llvm::erase_if(Model->TypeDefinitions(),
                  [&](const model::UpcastableTypeDefinition &P) {
-                   return not Visited.contains(TypeToNode.at(P.get()));
+                   return not Reached.contains(P.get());
                  });
 }
@@ -0,0 +1,23 @@
+/// \file TypeLayoutCache.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Model/TypeLayoutCache.h"
+#include "revng/Support/Assert.h"
+
+static thread_local model::TypeLayoutCache *CurrentCache = nullptr;
+
+model::TypeLayoutCache::TypeLayoutCache() : Previous(CurrentCache) {
+  CurrentCache = this;
+}
+
+model::TypeLayoutCache::~TypeLayoutCache() {
+  revng_assert(CurrentCache == this);
+  CurrentCache = Previous;
+}
+
+model::TypeLayoutCache *model::TypeLayoutCache::current() {
+  return CurrentCache;
+}
@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <vector>
+
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/Casting.h"
 
@@ -404,12 +406,19 @@ void TypeSystemPrinter::addFieldEdge(std::string &&Label,
   Out << "];\n";
 }
 
-void TypeSystemPrinter::print(const model::TypeDefinition &T) {
+void TypeSystemPrinter::print(const model::TypeDefinition &T,
+                              std::optional<unsigned> MaxDepth) {
   // Don't repeat nodes
   if (Visited.contains(&T))
     return;
 
-  llvm::SmallVector<const model::TypeDefinition *, 16> ToVisit = { &T };
+  // Visit breadth-first, so that each type is reached at its minimum depth
+  // and the depth limit cuts the graph consistently
+  struct Item {
+    const model::TypeDefinition *Type;
+    unsigned Depth;
+  };
+  std::vector<Item> ToVisit = { { &T, 0 } };
 
   auto EmitNode = [this](const model::TypeDefinition *TypeToEmit) {
     dumpTypeNode(TypeToEmit, NextID);
@@ -420,11 +429,15 @@ void TypeSystemPrinter::print(const model::TypeDefinition &T) {
   // Emit the root
   EmitNode(&T);
 
-  while (not ToVisit.empty()) {
-    const model::TypeDefinition *CurType = ToVisit.pop_back_val();
+  for (size_t Next = 0; Next < ToVisit.size(); ++Next) {
+    auto [CurType, Depth] = ToVisit[Next];
     if (Visited.contains(CurType))
       continue;
 
+    // The node has been emitted, but its successors are out of reach
+    if (MaxDepth.has_value() and Depth >= *MaxDepth)
+      continue;
+
     uint64_t CurID = NodesMap.at(CurType);
 
     // Collect all the successors
@@ -456,8 +469,8 @@ void TypeSystemPrinter::print(const model::TypeDefinition &T) {
       // destination of this edge have already been created.
       addFieldEdge(std::move(Label), IsPointer, CurID, Index, SuccID);
 
-      // Push the field's type to the visit stack
-      ToVisit.push_back(DefinitionPointer);
+      // Enqueue the field's type for the visit
+      ToVisit.push_back({ DefinitionPointer, Depth + 1 });
     }
 
     // Mark this Type as visited: the node has been emitted, as well as
@@ -4,12 +4,25 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <set>
+#include <variant>
+
 #include "llvm/ADT/SmallSet.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Model/Binary.h"
 
 using namespace llvm;
 
+static cl::opt<unsigned> VerifyThreads("model-verify-threads",
+                                       cl::desc("Number of threads verifying "
+                                                "the type definitions of the "
+                                                "model (0 means all the "
+                                                "available cores)"),
+                                       cl::init(1));
+
 namespace model {
 
 //
@@ -17,28 +30,32 @@ namespace model {
 //
 
 bool VerifyHelper::isGlobalSymbol(const model::Identifier &Name) const {
-  return GlobalSymbols.count(Name) > 0;
+  return GlobalSymbols and GlobalSymbols->contains(Name);
 }
 
 bool VerifyHelper::registerGlobalSymbol(const model::Identifier &Name,
-                                        const std::string &Path) {
+                                        SymbolPathGetter Path) {
   if (Name.empty())
     return true;
 
-  auto It = GlobalSymbols.find(Name);
-  if (It == GlobalSymbols.end()) {
-    GlobalSymbols.insert({ Name, Path });
+  // Don't alter the namespace shared with forked VerifyHelpers
+  if (not GlobalSymbols)
+    GlobalSymbols = std::make_shared<GlobalSymbolsMap>();
+  else if (GlobalSymbols.use_count() > 1)
+    GlobalSymbols = std::make_shared<GlobalSymbolsMap>(*GlobalSymbols);
+
+  auto [It, Inserted] = GlobalSymbols->try_emplace(Name, std::move(Path));
+  if (Inserted)
     return true;
-  } else {
-    std::string Message;
-    Message += "Duplicate global symbol \"";
-    Message += Name.str().str();
-    Message += "\":\n\n";
-
-    Message += "  " + It->second + "\n";
-    Message += "  " + Path + "\n";
-    return fail(Message);
-  }
+
+  std::string Message;
+  Message += "Duplicate global symbol \"";
+  Message += Name.str().str();
+  Message += "\":\n\n";
+
+  Message += "  " + It->second() + "\n";
+  Message += "  " + Path() + "\n";
+  return fail(Message);
 }
 
 template<typename T>
@@ -81,30 +98,35 @@ bool model::Binary::verifyGlobalNamespace(VerifyHelper &VH) const {
   // Verify needs to verify that each namespace has no internal clashes.
   // Also, the global namespace clashes with everything.
   for (const Function &F : Functions()) {
-    if (not VH.registerGlobalSymbol(F.CustomName(), path(F)))
+    if (not VH.registerGlobalSymbol(F.CustomName(), [&F] { return path(F); }))
       return VH.fail("Duplicate name", F);
   }
 
   // Verify DynamicFunctions
   for (const DynamicFunction &DF : ImportedDynamicFunctions()) {
-    if (not VH.registerGlobalSymbol(DF.CustomName(), path(DF)))
+    auto Path = [&DF] { return path(DF); };
+    if (not VH.registerGlobalSymbol(DF.CustomName(), Path))
       return VH.fail();
   }
 
   // Verify types and enum entries
   for (const model::UpcastableTypeDefinition &Def : TypeDefinitions()) {
-    if (not VH.registerGlobalSymbol(Def->CustomName(), path(*Def)))
+    auto Path = [&Def] { return path(*Def); };
+    if (not VH.registerGlobalSymbol(Def->CustomName(), Path))
       return VH.fail();
 
-    if (auto *Enum = dyn_cast<model::EnumDefinition>(Def.get()))
-      for (auto &Entry : Enum->Entries())
-        if (not VH.registerGlobalSymbol(Entry.CustomName(), path(*Enum, Entry)))
+    if (auto *Enum = dyn_cast<model::EnumDefinition>(Def.get())) {
+      for (auto &Entry : Enum->Entries()) {
+        auto Path = [Enum, &Entry] { return path(*Enum, Entry); };
+        if (not VH.registerGlobalSymbol(Entry.CustomName(), Path))
           return VH.fail();
+      }
+    }
   }
 
   // Verify Segments
   for (const Segment &S : Segments()) {
-    if (not VH.registerGlobalSymbol(S.CustomName(), path(S)))
+    if (not VH.registerGlobalSymbol(S.CustomName(), [&S] { return path(S); }))
       return VH.fail();
   }
 
@@ -749,6 +771,32 @@ RecursiveCoroutine<bool> TypeDefinition::verify(VerifyHelper &VH) const {
   rc_return VH.maybeFail(Result);
 }
 
+/// Checks on \p Definition that involve the other type definitions in the
+/// model, but not the ones it depends upon
+static bool verifyInBinary(VerifyHelper &VH,
+                           const Binary &Model,
+                           const model::TypeDefinition &Definition,
+                           std::set<Identifier> &Names) {
+  // Ensure the names are unique
+  auto Name = Definition.name();
+  if (not Names.insert(Name).second)
+    return VH.fail(Twine("Multiple types with the following name: ") + Name);
+
+  using CFT = model::CABIFunctionDefinition;
+  using RFT = model::RawFunctionDefinition;
+  if (const auto *T = llvm::dyn_cast<CFT>(&Definition)) {
+    if (getArchitecture(T->ABI()) != Model.Architecture())
+      return VH.fail("Function type architecture differs from the binary "
+                     "architecture");
+  } else if (const auto *T = llvm::dyn_cast<RFT>(&Definition)) {
+    if (T->Architecture() != Model.Architecture())
+      return VH.fail("Function type architecture differs from the binary "
+                     "architecture");
+  }
+
+  return true;
+}
+
 bool Binary::verifyTypeDefinitions(VerifyHelper &VH) const {
   auto Guard = VH.suspendTracking(*this);
 
@@ -758,21 +806,67 @@ bool Binary::verifyTypeDefinitions(VerifyHelper &VH) const {
     if (not Definition.get()->verify(VH))
       return VH.fail();
 
-    // Ensure the names are unique
-    auto Name = Definition->name();
-    if (not Names.insert(Name).second)
-      return VH.fail(Twine("Multiple types with the following name: ") + Name);
-
-    using CFT = model::CABIFunctionDefinition;
-    using RFT = model::RawFunctionDefinition;
-    if (const auto *T = llvm::dyn_cast<CFT>(Definition.get())) {
-      if (getArchitecture(T->ABI()) != Architecture())
-        return VH.fail("Function type architecture differs from the binary "
-                       "architecture");
-    } else if (const auto *T = llvm::dyn_cast<RFT>(Definition.get())) {
-      if (T->Architecture() != Architecture())
-        return VH.fail("Function type architecture differs from the binary "
-                       "architecture");
+    if (not verifyInBinary(VH, *this, *Definition, Names))
+      return VH.fail();
+  }
+
+  return true;
+}
+
+/// Verify all the type definitions using multiple threads, registering in \p VH
+/// the ones that verify.
+///
+/// Failures are not reported: they are reproduced, in the usual order, when
+/// \p VH goes on to verify the rest of the model, which is why all this can
+/// only affect performance and not the outcome of the verification.
+static void preverifyTypeDefinitions(const Binary &Model, VerifyHelper &VH) {
+  if (VerifyThreads == 1 or Model.isBeingTracked())
+    return;
+
+  std::vector<const model::TypeDefinition *> Definitions;
+  for (const model::UpcastableTypeDefinition &Definition :
+       Model.TypeDefinitions())
+    Definitions.push_back(Definition.get());
+
+  auto Strategy = hardware_concurrency(VerifyThreads);
+  size_t ChunksCount = std::min<size_t>(Strategy.compute_thread_count(),
+                                        Definitions.size());
+  if (ChunksCount <= 1)
+    return;
+
+  // Each chunk has its own VerifyHelper: definitions reachable from more than
+  // one chunk are verified more than once, but no synchronization is needed
+  std::vector<VerifyHelper> Helpers(ChunksCount);
+  size_t ChunkSize = (Definitions.size() + ChunksCount - 1) / ChunksCount;
+  ThreadPool Pool(Strategy);
+  for (size_t Chunk = 0; Chunk < ChunksCount; ++Chunk) {
+    Helpers[Chunk].forkFrom(VH);
+    Pool.async([&Definitions, &Helpers, Chunk, ChunkSize]() {
+      size_t End = std::min((Chunk + 1) * ChunkSize, Definitions.size());
+      for (size_t I = Chunk * ChunkSize; I < End; ++I) {
+        // Keep going on failure, the other definitions might still verify
+        Definitions[I]->verify(Helpers[Chunk]);
+      }
+    });
+  }
+  Pool.wait();
+
+  for (const VerifyHelper &Helper : Helpers)
+    VH.join(Helper);
+}
+
+static bool verifySegments(const Binary &Model, VerifyHelper &VH) {
+  for (const Segment &S : Model.Segments())
+    if (not S.verify(VH))
+      return VH.fail();
+
+  // Make sure no segments overlap
+  for (const auto &[LHS, RHS] : zip_pairs(Model.Segments())) {
+    revng_assert(LHS.StartAddress() <= RHS.StartAddress());
+    if (LHS.endAddress() > RHS.StartAddress()) {
+      std::string Error = "Overlapping segments:\n" + serializeToString(LHS)
+                          + "and\n" + serializeToString(RHS);
+      return VH.fail(Error);
     }
   }
 
@@ -791,6 +885,10 @@ bool Binary::verify(VerifyHelper &VH) const {
   if (not verifyGlobalNamespace(VH))
     return VH.fail();
 
+  // Verify the bulk of the type system upfront, possibly in parallel, so that
+  // what follows can mostly hit the cache
+  preverifyTypeDefinitions(*this, VH);
+
   // Verify individual functions
   for (const Function &F : Functions())
     if (not F.verify(VH))
@@ -802,19 +900,8 @@ bool Binary::verify(VerifyHelper &VH) const {
       return VH.fail();
 
   // Verify Segments
-  for (const Segment &S : Segments())
-    if (not S.verify(VH))
-      return VH.fail();
-
-  // Make sure no segments overlap
-  for (const auto &[LHS, RHS] : zip_pairs(Segments())) {
-    revng_assert(LHS.StartAddress() <= RHS.StartAddress());
-    if (LHS.endAddress() > RHS.StartAddress()) {
-      std::string Error = "Overlapping segments:\n" + serializeToString(LHS)
-                          + "and\n" + serializeToString(RHS);
-      return VH.fail(Error);
-    }
-  }
+  if (not verifySegments(*this, VH))
+    return VH.fail();
 
   //
   // Verify the type system
@@ -822,6 +909,172 @@ bool Binary::verify(VerifyHelper &VH) const {
   return verifyTypeDefinitions(VH);
 }
 
+/// \return the key of the element of the top-level \p ContainerType affected
+///         by \p Change
+template<typename ContainerType>
+static auto changedKey(const TupleTreeDiff<Binary>::Change &Change) {
+  using KeyType = std::remove_cv_t<typename ContainerType::key_type>;
+  using ValueType = typename ContainerType::value_type;
+  if (Change.Path.size() > 1)
+    return Change.Path[1].get<KeyType>();
+
+  const auto &Value = Change.New.has_value() ? *Change.New : *Change.Old;
+  return KeyType(KeyedObjectTraits<ValueType>::key(std::get<ValueType>(Value)));
+}
+
+/// Collect the global symbols introduced by the addition of \p Value
+static void collectGlobalNames(const AllowedTupleTreeTypes<Binary> &Value,
+                               std::set<Identifier> &Names) {
+  if (const auto *F = std::get_if<Function>(&Value)) {
+    Names.insert(F->CustomName());
+  } else if (const auto *DF = std::get_if<DynamicFunction>(&Value)) {
+    Names.insert(DF->CustomName());
+  } else if (const auto *S = std::get_if<Segment>(&Value)) {
+    Names.insert(S->CustomName());
+  } else if (const auto *D = std::get_if<UpcastableTypeDefinition>(&Value)) {
+    Names.insert((*D)->CustomName());
+    if (const auto *Enum = dyn_cast<model::EnumDefinition>(D->get()))
+      for (const model::EnumEntry &Entry : Enum->Entries())
+        Names.insert(Entry.CustomName());
+  }
+}
+
+/// \return true if a field or an argument of \p Definition is named after one
+///         of \p Names
+static bool hasLocalNameIn(const model::TypeDefinition &Definition,
+                           const std::set<Identifier> &Names) {
+  auto AnyIn = [&Names](const auto &Range) {
+    return llvm::any_of(Range, [&Names](const auto &Element) {
+      return Names.contains(Element.CustomName());
+    });
+  };
+
+  if (auto *S = llvm::dyn_cast<model::StructDefinition>(&Definition))
+    return AnyIn(S->Fields());
+  else if (auto *U = llvm::dyn_cast<model::UnionDefinition>(&Definition))
+    return AnyIn(U->Fields());
+  else if (auto *F = llvm::dyn_cast<model::CABIFunctionDefinition>(&Definition))
+    return AnyIn(F->Arguments());
+  else if (auto *F = llvm::dyn_cast<model::RawFunctionDefinition>(&Definition))
+    return AnyIn(F->Arguments());
+  else
+    return false;
+}
+
+/// \return true if \p Value only affects the names or the comments of the
+///         object it belongs to, which nothing else depends upon
+static bool isNameOrComment(const TupleTreeDiff<Binary>::Change::EntryType &E) {
+  return E.has_value()
+         and (std::holds_alternative<Identifier>(*E)
+              or std::holds_alternative<std::string>(*E));
+}
+
+bool Binary::verify(const TupleTreeDiff<Binary> &Diff,
+                    VerifyHelper &VH) const {
+  auto Guard = VH.suspendTracking(*this);
+
+  using Fields = TupleLikeTraits<Binary>::Fields;
+  using FunctionsType = std::decay_t<decltype(Functions())>;
+  using DynamicFunctionsType = std::decay_t<
+    decltype(ImportedDynamicFunctions())>;
+  using DefinitionsType = std::decay_t<decltype(TypeDefinitions())>;
+
+  std::set<std::remove_cv_t<FunctionsType::key_type>> ChangedFunctions;
+  std::set<std::remove_cv_t<DynamicFunctionsType::key_type>>
+    ChangedDynamicFunctions;
+  std::set<std::remove_cv_t<DefinitionsType::key_type>> ChangedDefinitions;
+  std::set<Identifier> NewNames;
+  bool SegmentsChanged = false;
+
+  // Find out what has to be verified again. Whenever something that other
+  // parts of the model might depend upon has changed, verify everything.
+  for (const auto &Change : Diff.Changes) {
+    const TupleTreePath &Path = Change.Path;
+    if (Path.empty())
+      return verify(VH);
+
+    // Names can collide with any other name in the global namespace
+    bool IsAddition = Path.size() == 1 and Change.New.has_value();
+    if (IsAddition)
+      collectGlobalNames(*Change.New, NewNames);
+    else if (Change.New.has_value())
+      if (const auto *Name = std::get_if<Identifier>(&*Change.New))
+        NewNames.insert(*Name);
+
+    bool IsRemoval = Path.size() == 1 and not Change.New.has_value();
+    switch (static_cast<Fields>(Path[0].get<size_t>())) {
+    case Fields::Functions:
+      if (not IsRemoval)
+        ChangedFunctions.insert(changedKey<FunctionsType>(Change));
+      break;
+
+    case Fields::ImportedDynamicFunctions:
+      if (not IsRemoval) {
+        auto Key = changedKey<DynamicFunctionsType>(Change);
+        ChangedDynamicFunctions.insert(std::move(Key));
+      }
+      break;
+
+    case Fields::Segments:
+      SegmentsChanged = true;
+      break;
+
+    case Fields::TypeDefinitions:
+      // Other objects might be referring to what has been changed: only type
+      // definitions that are brand new or whose changes are limited to names
+      // and comments can be verified on their own
+      if (IsRemoval
+          or (not IsAddition
+              and not (isNameOrComment(Change.Old)
+                       and isNameOrComment(Change.New))))
+        return verify(VH);
+
+      ChangedDefinitions.insert(changedKey<DefinitionsType>(Change));
+      break;
+
+    default:
+      return verify(VH);
+    }
+  }
+
+  // Local namespaces are verified against the global one, populate it first
+  if (not verifyGlobalNamespace(VH))
+    return VH.fail();
+
+  // Local names might now collide with a new global name
+  NewNames.erase(Identifier());
+  if (not NewNames.empty())
+    for (const model::UpcastableTypeDefinition &Definition : TypeDefinitions())
+      if (hasLocalNameIn(*Definition, NewNames))
+        ChangedDefinitions.insert(Definition->key());
+
+  for (const auto &Key : ChangedFunctions)
+    if (const Function *F = Functions().tryGet(Key))
+      if (not F->verify(VH))
+        return VH.fail();
+
+  for (const auto &Key : ChangedDynamicFunctions)
+    if (const DynamicFunction *DF = ImportedDynamicFunctions().tryGet(Key))
+      if (not DF->verify(VH))
+        return VH.fail();
+
+  if (SegmentsChanged and not verifySegments(*this, VH))
+    return VH.fail();
+
+  for (const auto &Key : ChangedDefinitions)
+    if (const auto *Definition = TypeDefinitions().tryGet(Key))
+      if (not Definition->get()->verify(VH))
+        return VH.fail();
+
+  // Type names must be unique across all the type definitions
+  std::set<Identifier> Names;
+  for (const model::UpcastableTypeDefinition &Definition : TypeDefinitions())
+    if (not verifyInBinary(VH, *this, *Definition, Names))
+      return VH.fail();
+
+  return true;
+}
+
 //
 // And the wrappers
 //
@@ -938,6 +1191,14 @@ bool Binary::verifyTypeDefinitions() const {
   return verifyTypeDefinitions(false);
 }
 
+bool Binary::verify(const TupleTreeDiff<Binary> &Diff, bool Assert) const {
+  VerifyHelper VH(Assert);
+  return verify(Diff, VH);
+}
+bool Binary::verify(const TupleTreeDiff<Binary> &Diff) const {
+  return verify(Diff, false);
+}
+
 bool Binary::verify(bool Assert) const {
   VerifyHelper VH(Assert);
   return verify(VH);
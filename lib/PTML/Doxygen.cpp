@@ -538,8 +538,13 @@ std::string ptml::functionComment(const ::ptml::PTMLBuilder &PTML,
                                   const model::Binary &Binary,
                                   llvm::StringRef CommentIndicator,
                                   size_t Indentation,
-                                  size_t WrapAt) {
-  llvm::SmallVector<DoxygenLine, 16> Result;
+                                  size_t WrapAt,
+                                  FunctionCommentCache *Cache) {
+  CommentBuilder Builder(PTML, CommentIndicator, Indentation, WrapAt);
+
+  // Lines are emitted independently of each other, so the blocks of the
+  // comment can be rendered separately and then concatenated
+  std::string Result;
   if (!Function.Comment().empty()) {
     DoxygenToken Tag{ .Type = DoxygenToken::Types::Untagged,
                       .Value = Function.Comment() };
@@ -548,27 +553,42 @@ std::string ptml::functionComment(const ::ptml::PTMLBuilder &PTML,
                                                         Function.key()));
     Tag.ExtraAttributes.emplace_back(ptml::attributes::AllowedActions,
                                      ptml::actions::Comment);
-    Result.emplace_back(DoxygenLine{ .Tags = { std::move(Tag) } });
+    Result = Builder.emit({ DoxygenLine{ .Tags = { std::move(Tag) },
+                                         .InternalIndentation = 0 } });
   }
 
-  auto ArgumentComments = gatherArgumentComments(Binary, Function);
-  if (!ArgumentComments.empty()) {
-    if (!Result.empty())
-      Result.emplace_back();
+  auto Render = [&Builder, &Binary, &Function]() {
+    using PrototypeComments = FunctionCommentCache::PrototypeComments;
+    return PrototypeComments{
+      .Arguments = Builder.emit(gatherArgumentComments(Binary, Function)),
+      .ReturnValues = Builder.emit(gatherReturnValueComments(Binary, Function))
+    };
+  };
 
-    Result.reserve(Result.size() + ArgumentComments.size());
-    std::ranges::move(ArgumentComments, std::back_inserter(Result));
+  FunctionCommentCache::PrototypeComments Uncached;
+  const FunctionCommentCache::PrototypeComments *Prototype = &Uncached;
+  const model::TypeDefinition *Definition = Function.prototype();
+  if (Cache != nullptr and Definition != nullptr) {
+    Prototype = &Cache->get({ Definition->key(),
+                              CommentIndicator.str(),
+                              Indentation,
+                              WrapAt,
+                              PTML.isGenerateTagLessPTML() },
+                            Render);
+  } else {
+    Uncached = Render();
   }
 
-  auto ReturnValueComments = gatherReturnValueComments(Binary, Function);
-  if (!ReturnValueComments.empty()) {
-    if (!Result.empty())
-      Result.emplace_back();
+  auto Append = [&Builder, &Result](const std::string &Block) {
+    if (Block.empty())
+      return;
 
-    Result.reserve(Result.size() + ReturnValueComments.size());
-    std::ranges::move(ReturnValueComments, std::back_inserter(Result));
-  }
+    if (!Result.empty())
+      Result += Builder.emit({ DoxygenLine{ .InternalIndentation = 0 } });
+    Result += Block;
+  };
+  Append(Prototype->Arguments);
+  Append(Prototype->ReturnValues);
 
-  CommentBuilder Builder(PTML, CommentIndicator, Indentation, WrapAt);
-  return Builder.emit(std::move(Result));
+  return Result;
 }
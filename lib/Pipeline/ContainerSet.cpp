@@ -5,17 +5,27 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+
 #include "llvm/Support/Error.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
 
 #include "revng/Pipeline/ContainerSet.h"
+#include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Errors.h"
 
 using namespace pipeline;
 using namespace llvm;
 using namespace std;
 
+/// Name of the file, stored next to each container, holding the list of
+/// targets it contains, one per line
+static revng::FilePath getTargetsFile(const revng::DirectoryPath &Directory,
+                                      llvm::StringRef ContainerName) {
+  return Directory.getFile(ContainerName.str() + ".targets");
+}
+
 ContainerSet ContainerSet::cloneFiltered(const ContainerToTargetsMap &Targets) {
   ContainerSet ToReturn;
   for (const auto &Pair : Content) {
@@ -26,6 +36,14 @@ ContainerSet ContainerSet::cloneFiltered(const ContainerToTargetsMap &Targets) {
                             Targets.at(ContainerName) :
                             TargetsList();
 
+    // Nothing is requested from a container that has not been loaded yet:
+    // leave it alone rather than deserializing it to extract nothing
+    if (isPending(ContainerName) and ExtractedNames.empty()) {
+      ToReturn.add(ContainerName, *Factories[ContainerName]);
+      continue;
+    }
+
+    materializeOrAbort(ContainerName);
     auto Cloned = Container != nullptr ?
                     Container->cloneFiltered(ExtractedNames) :
                     nullptr;
@@ -37,8 +55,8 @@ ContainerSet ContainerSet::cloneFiltered(const ContainerToTargetsMap &Targets) {
 }
 
 bool ContainerSet::contains(const Target &Target) const {
-  return llvm::any_of(Content, [&Target](const auto &Container) {
-    return Container.second->enumerate().contains(Target);
+  return llvm::any_of(Content, [this, &Target](const auto &Container) {
+    return enumerate(Container.first()).contains(Target);
   });
 }
 
@@ -50,12 +68,60 @@ Error ContainerSet::remove(const ContainerToTargetsMap &ToRemove) {
       continue;
     if (NamesToRemove.size() == 0)
       continue;
-    if (auto Ok = at(ContainerName).remove(NamesToRemove); not Ok)
+
+    bool Removed = false;
+    if (isPending(ContainerName)) {
+      auto MaybeRemoved = removeFromPending(ContainerName, NamesToRemove);
+      if (not MaybeRemoved)
+        return MaybeRemoved.takeError();
+      Removed = *MaybeRemoved;
+    } else {
+      Removed = at(ContainerName).remove(NamesToRemove);
+    }
+
+    if (not Removed)
       return make_error<UnknownTargetError>(NamesToRemove, ContainerName);
   }
   return Error::success();
 }
 
+Expected<bool> ContainerSet::removeFromPending(llvm::StringRef Name,
+                                               const TargetsList &ToRemove) {
+  auto Iterator = Pending.find(Name);
+  revng_assert(Iterator != Pending.end());
+
+  TargetsList::List Surviving;
+  bool Removed = false;
+  for (const Target &T : Iterator->second.Targets) {
+    if (ToRemove.contains(T))
+      Removed = true;
+    else
+      Surviving.push_back(T);
+  }
+
+  // Nothing to do, the container can stay on disk as it is
+  if (not Removed)
+    return false;
+
+  revng::FilePath Path = std::move(Iterator->second.Path);
+  Pending.erase(Iterator);
+  markChanged(Name);
+  touch(Name);
+
+  auto &Pointer = Content.find(Name)->second;
+  Pointer = (*Factories.find(Name)->second)(Name);
+  if (Surviving.empty())
+    return true;
+
+  // Containers are allowed to load more than requested
+  TargetsList ToLoad(std::move(Surviving));
+  if (auto Error = Pointer->loadCachedFiltered(Path, ToLoad))
+    return std::move(Error);
+  Pointer->remove(ToRemove);
+
+  return true;
+}
+
 void ContainerSet::intersect(ContainerToTargetsMap &ToIntersect) const {
   for (auto &ContainerStatus : ToIntersect) {
     const auto &ContainerName = ContainerStatus.first();
@@ -66,28 +132,252 @@ void ContainerSet::intersect(ContainerToTargetsMap &ToIntersect) const {
       continue;
     }
 
-    const auto &Container = at(ContainerName);
-    auto Enumerated = Container.enumerate();
+    auto Enumerated = enumerate(ContainerName);
     erase_if(Names, [&Enumerated](const Target &Target) {
       return not Enumerated.contains(Target);
     });
   }
 }
 
-llvm::Error ContainerSet::store(const revng::DirectoryPath &Directory) const {
+/// Copies the files written by the container stored in \p Source to
+/// \p Destination
+static llvm::Error copyContainerFiles(const ContainerFactory &Factory,
+                                      const revng::FilePath &Source,
+                                      const revng::FilePath &Destination) {
+  auto SourceFiles = Factory.getWrittenFiles(Source);
+  auto DestinationFiles = Factory.getWrittenFiles(Destination);
+  revng_assert(SourceFiles.size() == DestinationFiles.size());
+  for (const auto &[From, To] : llvm::zip(SourceFiles, DestinationFiles)) {
+    auto MaybeExists = From.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    if (not MaybeExists.get())
+      continue;
+
+    if (auto Error = From.copyTo(To); Error)
+      return Error;
+  }
+
+  return Error::success();
+}
+
+static llvm::Error writeTargets(const revng::DirectoryPath &Directory,
+                                llvm::StringRef ContainerName,
+                                const TargetsList &Targets) {
+  auto MaybeTargetsFile = getTargetsFile(Directory, ContainerName)
+                            .getWritableFile();
+  if (not MaybeTargetsFile)
+    return MaybeTargetsFile.takeError();
+
+  for (const Target &Target : Targets)
+    MaybeTargetsFile.get()->os() << Target.serialize() << "\n";
+
+  return MaybeTargetsFile.get()->commit();
+}
+
+llvm::Error
+ContainerSet::storeContainer(const revng::DirectoryPath &Directory,
+                             llvm::StringRef ContainerName) const {
+  revng::FilePath Filename = Directory.getFile(ContainerName);
+  const auto &Container = Content.find(ContainerName)->second;
+
+  // Nothing has changed since the container has been stored there, or loaded
+  // from there
+  if (isStoredAt(ContainerName, Filename))
+    return Error::success();
+
+  if (auto Iterator = Pending.find(ContainerName); Iterator != Pending.end()) {
+    // The container has not been touched since it has been loaded: just copy
+    // the files over
+    const PendingLoad &Load = Iterator->second;
+    const ContainerFactory &Factory = *Factories.find(ContainerName)->second;
+    if (auto Error = copyContainerFiles(Factory, Load.Path, Filename))
+      return Error;
+
+    if (auto Error = writeTargets(Directory, ContainerName, Load.Targets))
+      return Error;
+  } else if (Container == nullptr) {
+    return Error::success();
+  } else {
+    if (auto Error = Container->storeCached(Filename); !!Error)
+      return Error;
+
+    if (auto Error = writeTargets(Directory,
+                                  ContainerName,
+                                  Container->enumerate()))
+      return Error;
+  }
+
+  StoredAt.insert_or_assign(ContainerName, Filename);
+  return Error::success();
+}
+
+llvm::Expected<ContainerSet::Snapshot>
+ContainerSet::snapshot(const revng::DirectoryPath &Directory,
+                       const revng::DirectoryPath &Staging) const {
+  Snapshot Result;
+
   for (const auto &Pair : Content) {
-    revng::FilePath Filename = Directory.getFile(Pair.first());
+    llvm::StringRef ContainerName = Pair.first();
     const auto &Container = Pair.second;
-    if (Container == nullptr)
+    revng::FilePath Filename = Directory.getFile(ContainerName);
+    if (isStoredAt(ContainerName, Filename))
       continue;
 
-    if (auto Error = Container->store(Filename); !!Error)
-      return Error;
+    if (auto Iterator = Pending.find(ContainerName); Iterator != Pending.end()) {
+      // Nothing to serialize, Snapshot::store will copy the files over
+      const PendingLoad &Load = Iterator->second;
+      const ContainerFactory *Factory = Factories.find(ContainerName)->second;
+      Result.Copies.push_back({ Factory, Load.Path, Filename });
+
+      if (auto Error = writeTargets(Staging, ContainerName, Load.Targets))
+        return std::move(Error);
+    } else if (Container == nullptr) {
+      continue;
+    } else {
+      revng::FilePath Staged = Staging.getFile(ContainerName);
+      if (auto Error = Container->storeCached(Staged); !!Error)
+        return std::move(Error);
+
+      // Containers might decide to write nothing rather than an empty file,
+      // files from a previous store must not survive
+      const ContainerFactory &Factory = *Factories.find(ContainerName)->second;
+      auto Written = Factory.getWrittenFiles(Staged);
+      auto Destinations = Factory.getWrittenFiles(Filename);
+      revng_assert(Written.size() == Destinations.size());
+      for (const auto &[From, To] : llvm::zip(Written, Destinations)) {
+        auto MaybeExists = From.exists();
+        if (not MaybeExists)
+          return MaybeExists.takeError();
+
+        if (not MaybeExists.get())
+          Result.Removals.push_back(To);
+      }
+
+      if (auto Error = writeTargets(Staging,
+                                    ContainerName,
+                                    Container->enumerate()))
+        return std::move(Error);
+    }
+
+    // Assume the snapshot will be stored successfully, the caller is in charge
+    // of calling forgetStored if it's not
+    StoredAt.insert_or_assign(ContainerName, Filename);
+  }
+
+  return Result;
+}
+
+llvm::Error ContainerSet::Snapshot::store() const {
+  for (const revng::FilePath &Path : Removals) {
+    auto MaybeExists = Path.exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    if (MaybeExists.get())
+      if (auto Error = Path.remove())
+        return Error;
   }
+
+  for (const PendingCopy &Copy : Copies)
+    if (auto Error = copyContainerFiles(*Copy.Factory,
+                                        Copy.Source,
+                                        Copy.Destination))
+      return Error;
+
   return Error::success();
 }
 
-llvm::Error ContainerSet::load(const revng::DirectoryPath &Directory) {
+llvm::Error ContainerSet::store(const revng::DirectoryPath &Directory) const {
+  for (const auto &Pair : Content)
+    if (auto Error = storeContainer(Directory, Pair.first()); Error)
+      return Error;
+
+  return Error::success();
+}
+
+llvm::Error ContainerSet::evict(llvm::StringRef Name,
+                                const revng::DirectoryPath &Directory) {
+  auto Iterator = Content.find(Name);
+  revng_assert(Iterator != Content.end());
+
+  if (isPending(Name) or Iterator->second == nullptr)
+    return Error::success();
+
+  if (auto Error = storeContainer(Directory, Name); Error)
+    return Error;
+
+  TargetsList Targets = Iterator->second->enumerate();
+
+  // Leave an empty container behind rather than null, since the entries of
+  // the set can be retained by the users (e.g., PipelineC)
+  Iterator->second = (*Factories.find(Name)->second)(Name);
+  Pending.try_emplace(Name,
+                      PendingLoad{ Directory.getFile(Name),
+                                   std::move(Targets) });
+  return Error::success();
+}
+
+void ContainerSet::instantiate(llvm::StringRef Name) {
+  revng_assert(containsOrCanCreate(Name));
+  materializeOrAbort(Name);
+  auto &Pointer = Content.find(Name)->second;
+  if (Pointer == nullptr)
+    Pointer = (*Factories.find(Name)->second)(Name);
+}
+
+size_t ContainerSet::memoryUsage(llvm::StringRef Name) const {
+  auto Iterator = Content.find(Name);
+  if (isPending(Name) or Iterator == Content.end()
+      or Iterator->second == nullptr)
+    return 0;
+
+  return Iterator->second->memoryUsage();
+}
+
+size_t ContainerSet::memoryUsage() const {
+  size_t Result = 0;
+  for (const auto &Entry : Content)
+    Result += memoryUsage(Entry.first());
+  return Result;
+}
+
+void ContainerSet::touch(llvm::StringRef Name) const {
+  static std::atomic<uint64_t> AccessCounter = 0;
+  LastAccess[Name] = ++AccessCounter;
+}
+
+/// Parses the list of targets stored by ContainerSet::store
+static llvm::Expected<TargetsList>
+loadTargetsList(const Context &Ctx, const revng::FilePath &Path) {
+  auto MaybeFile = Path.getReadableFile();
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+
+  llvm::SmallVector<llvm::StringRef, 0> Lines;
+  MaybeFile.get()->buffer().getBuffer().split(Lines, '\n', -1, false);
+
+  // The list was produced by enumerate, hence it's already sorted and does
+  // not contain duplicates
+  TargetsList::List Targets;
+  Targets.reserve(Lines.size());
+  for (llvm::StringRef Line : Lines) {
+    TargetsList Parsed;
+    if (auto Error = parseTarget(Ctx, Line, Ctx.getKindsRegistry(), Parsed))
+      return std::move(Error);
+
+    for (const Target &Target : Parsed)
+      Targets.push_back(Target);
+  }
+
+  return TargetsList(std::move(Targets));
+}
+
+llvm::Error ContainerSet::load(const Context &Ctx,
+                               const revng::DirectoryPath &Directory) {
+  Pending.clear();
+  StoredAt.clear();
   for (auto &Pair : Content) {
     revng::FilePath Filename = Directory.getFile(Pair.first());
     auto MaybeExists = Filename.exists();
@@ -99,12 +389,79 @@ llvm::Error ContainerSet::load(const revng::DirectoryPath &Directory) {
       continue;
     }
 
-    if (auto Error = (*this)[Pair.first()].load(Filename); !!Error)
-      return Error;
+    revng::FilePath TargetsFile = getTargetsFile(Directory, Pair.first());
+    auto MaybeTargetsExist = TargetsFile.exists();
+    if (not MaybeTargetsExist)
+      return MaybeTargetsExist.takeError();
+
+    // Without the list of targets there is no way to enumerate the container
+    // without deserializing it
+    if (not MaybeTargetsExist.get()) {
+      if (auto Error = (*this)[Pair.first()].loadCached(Filename); !!Error)
+        return Error;
+      StoredAt.insert_or_assign(Pair.first(), Filename);
+      continue;
+    }
+
+    auto MaybeTargets = loadTargetsList(Ctx, TargetsFile);
+    if (not MaybeTargets)
+      return MaybeTargets.takeError();
+
+    Pair.second = nullptr;
+    StoredAt.insert_or_assign(Pair.first(), Filename);
+    Pending.try_emplace(Pair.first(),
+                        PendingLoad{ Filename, std::move(*MaybeTargets) });
   }
   return Error::success();
 }
 
+llvm::Error ContainerSet::materialize(llvm::StringRef Name) const {
+  auto Iterator = Pending.find(Name);
+  if (Iterator == Pending.end())
+    return llvm::Error::success();
+
+  revng::FilePath Path = std::move(Iterator->second.Path);
+  Pending.erase(Iterator);
+
+  // Evicted containers leave behind an empty container
+  auto &Pointer = Content.find(Name)->second;
+  if (Pointer == nullptr)
+    Pointer = (*Factories.find(Name)->second)(Name);
+  return Pointer->loadCached(Path);
+}
+
+llvm::Expected<std::unique_ptr<ContainerBase>>
+ContainerSet::cloneFiltered(llvm::StringRef Name,
+                            const TargetsList &Targets) const {
+  revng_assert(contains(Name));
+
+  auto Iterator = Pending.find(Name);
+  if (Iterator == Pending.end())
+    return at(Name).cloneFiltered(Targets);
+
+  // Load what's needed in a scratch container, the pending one is left as is
+  touch(Name);
+  auto Scratch = (*Factories.find(Name)->second)(Name);
+  if (auto Error = Scratch->loadCachedFiltered(Iterator->second.Path, Targets))
+    return std::move(Error);
+
+  return Scratch->cloneFiltered(Targets);
+}
+
+void ContainerSet::prefetch(const ContainerToTargetsMap &Targets) const {
+  std::vector<revng::FilePath> Files;
+  for (const auto &Pair : Pending) {
+    llvm::StringRef Name = Pair.first();
+    if (not Targets.contains(Name) or Targets.at(Name).empty())
+      continue;
+
+    const ContainerFactory &Factory = *Factories.find(Name)->second;
+    llvm::append_range(Files, Factory.getWrittenFiles(Pair.second.Path));
+  }
+
+  revng::FilePath::prefetch(Files);
+}
+
 std::vector<revng::FilePath>
 ContainerSet::getWrittenFiles(const revng::DirectoryPath &Directory) const {
   std::vector<revng::FilePath> Result;
@@ -112,6 +469,7 @@ ContainerSet::getWrittenFiles(const revng::DirectoryPath &Directory) const {
   for (const auto &Pair : Factories) {
     revng::FilePath Filename = Directory.getFile(Pair.first());
     append(Pair.second->getWrittenFiles(Filename), Result);
+    Result.push_back(getTargetsFile(Directory, Pair.first()));
   }
 
   return Result;
@@ -119,7 +477,9 @@ ContainerSet::getWrittenFiles(const revng::DirectoryPath &Directory) const {
 
 llvm::Error ContainerSet::verify() const {
   for (const auto &Pair : Content) {
-    if (Pair.second == nullptr)
+    // Do not deserialize pending containers just to verify them, their content
+    // has not changed since they have been stored
+    if (Pair.second == nullptr or isPending(Pair.first()))
       continue;
 
     if (auto Error = Pair.second->verify(); Error)
@@ -133,14 +493,23 @@ ContainerToTargetsMap ContainerSet::enumerate() const {
 
   for (const auto &Pair : *this) {
     const auto &Name = Pair.first();
-    const auto &MaybeCont = Pair.second;
-
-    if (MaybeCont != nullptr)
-      Status[Name] = MaybeCont->enumerate();
+    if (contains(Name))
+      Status[Name] = enumerate(Name);
   }
   return Status;
 }
 
+TargetsList ContainerSet::enumerate(llvm::StringRef Name) const {
+  if (auto Iterator = Pending.find(Name); Iterator != Pending.end())
+    return Iterator->second.Targets;
+
+  auto Iterator = Content.find(Name);
+  if (Iterator == Content.end() or Iterator->second == nullptr)
+    return {};
+
+  return Iterator->second->enumerate();
+}
+
 llvm::Error ContainerBase::store(const revng::FilePath &Path) const {
   auto MaybeWritableFile = Path.getWritableFile();
   if (not MaybeWritableFile) {
@@ -9,6 +9,7 @@
 #include <cstdlib>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/Pipeline/AllRegistries.h"
 #include "revng/Pipeline/Context.h"
@@ -18,7 +19,26 @@ using namespace pipeline;
 Logger<> pipeline::ExplanationLogger("pipeline");
 Logger<> pipeline::CommandLogger("commands");
 
-Context::Context() : TheKindRegistry(Registry::registerAllKinds()) {
+using ReadFieldsTrackingOpt = llvm::cl::opt<ReadFieldsTracking>;
+static ReadFieldsTrackingOpt
+  DefaultTracking("read-fields-tracking",
+                  llvm::cl::desc("how precisely the fields of the globals "
+                                 "read by each pipe are recorded"),
+                  llvm::cl::values(clEnumValN(ReadFieldsTracking::Precise,
+                                              "precise",
+                                              "record each field read"),
+                                   clEnumValN(ReadFieldsTracking::Coarse,
+                                              "coarse",
+                                              "record nothing, any change "
+                                              "invalidates every target")),
+                  llvm::cl::init(ReadFieldsTracking::Precise));
+
+Context::Context() :
+  TheKindRegistry(Registry::registerAllKinds()), Tracking(DefaultTracking) {
+}
+
+Context::Context(KindsRegistry Registry) :
+  TheKindRegistry(std::move(Registry)), Tracking(DefaultTracking) {
 }
 
 llvm::Error Context::store(const revng::DirectoryPath &Path) const {
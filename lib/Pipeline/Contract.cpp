@@ -25,7 +25,7 @@ void Contract::deduceResults(const Context &Ctx,
   TargetsList Tmp;
   deduceResults(Ctx, StepStatus, Tmp, Names);
 
-  copy(Tmp, back_inserter(OutputContainerTarget));
+  OutputContainerTarget.merge(std::move(Tmp));
 }
 
 void Contract::deduceResults(const Context &Ctx,
@@ -37,17 +37,40 @@ void Contract::deduceResults(const Context &Ctx,
   deduceResults(Ctx, StepStatus, OutputContainerTarget, Names);
 }
 
+/// Appends all the targets of \p K to \p Out, through the memo, if any
+static void
+appendAllTargets(const Context &Ctx, const Kind &K, TargetsList &Out) {
+  if (AllTargetsMemo *Memo = Ctx.getAllTargetsMemo())
+    Out.merge(Memo->get(K));
+  else
+    K.appendAllTargets(Ctx, Out);
+}
+
+static void
+assignAllTargets(const Context &Ctx, const Kind &K, TargetsList &Out) {
+  Out = TargetsList();
+  appendAllTargets(Ctx, K, Out);
+}
+
+static bool
+isAllTargets(const Context &Ctx, const Kind &K, const TargetsList &Targets) {
+  if (AllTargetsMemo *Memo = Ctx.getAllTargetsMemo())
+    return Memo->get(K) == Targets;
+
+  TargetsList All;
+  K.appendAllTargets(Ctx, All);
+  return All == Targets;
+}
+
 static TargetsList copyEntriesOfKind(const TargetsList &List, const Kind &K) {
   auto Range = List.filterByKind(K);
-  TargetsList ToReturn;
-  copy(Range.begin(), Range.end(), std::back_inserter(ToReturn));
-  return ToReturn;
+  return TargetsList(TargetsList::List(Range.begin(), Range.end()));
 }
 
 static TargetsList extracEntriesOfKind(TargetsList &List, const Kind &K) {
   auto Range = List.filterByKind(K);
-  TargetsList ToReturn;
-  copy(Range.begin(), Range.end(), std::back_inserter(ToReturn));
+  TargetsList ToReturn(TargetsList::List(std::make_move_iterator(Range.begin()),
+                                         std::make_move_iterator(Range.end())));
   List.erase(Range.begin(), Range.end());
   return ToReturn;
 }
@@ -57,7 +80,7 @@ void Contract::deduceResults(const Context &Ctx,
                              TargetsList &Results,
                              ArrayRef<string> Names) const {
   if (Source == nullptr) {
-    TargetKind->appendAllTargets(Ctx, Results);
+    appendAllTargets(Ctx, *TargetKind, Results);
     return;
   }
 
@@ -69,40 +92,33 @@ void Contract::deduceResults(const Context &Ctx,
     auto Targets = Preservation == pipeline::InputPreservation::Erase ?
                      extracEntriesOfKind(SourceContainerTargets, *Kind) :
                      copyEntriesOfKind(SourceContainerTargets, *Kind);
-    Targets = forward(Ctx, std::move(Targets));
-    copy(Targets, back_inserter(Results));
+    forward(Ctx, Targets);
+    Results.merge(std::move(Targets));
   }
 }
 
-TargetsList Contract::forward(const Context &Ctx, TargetsList Input) const {
-  if (Input.empty())
-    return {};
+void Contract::forward(const Context &Ctx, TargetsList &Targets) const {
+  if (Targets.empty())
+    return;
 
-  auto *Kind = &Input.front().getKind();
-  if (Kind != Source)
-    return Input;
+  if (&Targets.front().getKind() != Source)
+    return;
 
   if (Source->depth() == TargetKind->depth()) {
-    for (auto &Target : Input)
+    for (auto &Target : Targets)
       Target.setKind(*TargetKind);
-    return Input;
+    return;
   }
 
   if (Source->depth() > TargetKind->depth()) {
-    TargetsList All;
-    TargetKind->appendAllTargets(Ctx, All);
-    return All;
+    assignAllTargets(Ctx, *TargetKind, Targets);
+    return;
   }
 
-  TargetsList All;
-  Source->appendAllTargets(Ctx, All);
-  if (All != Input) {
-    return Input;
-  }
+  if (not isAllTargets(Ctx, *Source, Targets))
+    return;
 
-  TargetsList AllDestination;
-  TargetKind->appendAllTargets(Ctx, AllDestination);
-  return AllDestination;
+  assignAllTargets(Ctx, *TargetKind, Targets);
 }
 
 ContainerToTargetsMap
@@ -126,21 +142,16 @@ void Contract::deduceRequirements(const Context &Ctx,
     return;
   }
 
-  auto Kinds = Target.getContainedKinds();
-
-  for (auto &Kind : Kinds) {
-    if (Kind != TargetKind)
-      continue;
+  if (not Target.containsKind(*TargetKind))
+    return;
 
-    bool PreservedInput = Preservation == pipeline::InputPreservation::Preserve;
-    auto Targets = extracEntriesOfKind(Target, *Kind);
+  auto Targets = extracEntriesOfKind(Target, *TargetKind);
 
-    // Transform the forward inputs/backward outputs that match,
-    // they are transformed by the current Pipe
-    Targets = backward(Ctx, std::move(Targets));
+  // Transform the forward inputs/backward outputs that match,
+  // they are transformed by the current Pipe
+  backward(Ctx, Targets);
 
-    copy(Targets, back_inserter(Source));
-  }
+  Source.merge(std::move(Targets));
 }
 
 bool Contract::forwardMatches(const Context &Ctx, const TargetsList &In) const {
@@ -155,42 +166,28 @@ bool Contract::forwardMatches(const Context &Ctx, const TargetsList &In) const {
     return In.contains(All);
   }
 
-  auto Kinds = In.getContainedKinds();
-  auto Res = llvm::find(Kinds, Source) != Kinds.end();
-  return Res;
+  return In.containsKind(*Source);
 }
 
-TargetsList Contract::backward(const Context &Ctx, TargetsList Output) const {
-  if (Output.empty())
-    return {};
-
-  auto Kind = &Output.front().getKind();
+void Contract::backward(const Context &Ctx, TargetsList &Targets) const {
+  if (Targets.empty())
+    return;
 
   if (Source->depth() == TargetKind->depth()) {
-    for (auto &Target : Output)
+    for (auto &Target : Targets)
       Target.setKind(*Source);
-    return Output;
+    return;
   }
 
   if (Source->depth() < TargetKind->depth()) {
-    TargetsList All;
-    Source->appendAllTargets(Ctx, All);
-    return All;
+    assignAllTargets(Ctx, *Source, Targets);
+    return;
   }
 
-  if (Source->depth() > TargetKind->depth()) {
-    TargetsList All;
-    TargetKind->appendAllTargets(Ctx, All);
-    if (All != Output) {
-      return Output;
-    }
-
-    TargetsList AllDestination;
-    Source->appendAllTargets(Ctx, AllDestination);
-    return AllDestination;
-  }
+  if (not isAllTargets(Ctx, *TargetKind, Targets))
+    return;
 
-  return Output;
+  assignAllTargets(Ctx, *Source, Targets);
 }
 
 using BCS = ContainerToTargetsMap;
@@ -212,10 +209,8 @@ bool Contract::backwardMatchesImpl(const Context &Ctx,
   if (List.empty())
     return false;
 
-  if (Source->depth() == TargetKind->depth()) {
-    auto Kinds = List.getContainedKinds();
-    return find(Kinds, this->TargetKind) != Kinds.end();
-  }
+  if (Source->depth() == TargetKind->depth())
+    return List.containsKind(*TargetKind);
 
   return true;
 }
@@ -239,7 +234,7 @@ void Contract::insertDefaultInput(const Context &Ctx,
   if (Source == nullptr)
     return;
   auto &SourceContainerTargets = Status[Names[PipeArgumentSourceIndex]];
-  Source->appendAllTargets(Ctx, SourceContainerTargets);
+  appendAllTargets(Ctx, *Source, SourceContainerTargets);
 }
 
 bool ContractGroup::forwardMatches(const Context &Ctx,
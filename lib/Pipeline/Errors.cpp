@@ -56,3 +56,13 @@ void AnnotatedError::log(raw_ostream &OS) const {
 std::error_code AnnotatedError::convertToErrorCode() const {
   return inconvertibleErrorCode();
 }
+
+char CancelledError::ID;
+
+void CancelledError::log(raw_ostream &OS) const {
+  OS << "The request has been cancelled";
+}
+
+std::error_code CancelledError::convertToErrorCode() const {
+  return inconvertibleErrorCode();
+}
@@ -5,6 +5,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/ExecutionContext.h"
 #include "revng/Pipeline/Step.h"
 #include "revng/Pipeline/Target.h"
@@ -26,6 +27,10 @@ ExecutionContext::ExecutionContext(Context &Ctx,
     getContext().clearAndResume();
 }
 
+bool ExecutionContext::isCancellationRequested() const {
+  return TheContext->isCancellationRequested();
+}
+
 pipeline::ExecutionContext::~ExecutionContext() {
   if (RunningOnPipe)
     getContext().stopTracking();
@@ -34,9 +39,47 @@ pipeline::ExecutionContext::~ExecutionContext() {
 void ExecutionContext::commit(const Target &Target,
                               llvm::StringRef ContainerName) {
   revng_assert(Pipe != nullptr);
+  auto Start = std::chrono::steady_clock::now();
+
   TargetInContainer ToCollect(Target, ContainerName.str());
   getContext().collectReadFields(ToCollect,
                                  Pipe->InvalidationMetadata.getPathCache());
+
+  ++CommitsCount;
+  auto Duration = std::chrono::steady_clock::now() - Start;
+  using std::chrono::duration_cast;
+  CommitsDuration += duration_cast<std::chrono::microseconds>(Duration);
+}
+
+void ExecutionContext::record(CommitBatch &Batch,
+                              const Target &Target,
+                              llvm::StringRef ContainerName) {
+  revng_assert(Pipe != nullptr);
+  auto Start = std::chrono::steady_clock::now();
+
+  uint32_t Index = Batch.Targets.size();
+  Batch.Targets.emplace_back(Target, ContainerName.str());
+  getContext().collectReadFields(Index, Batch.Reads);
+
+  auto Duration = std::chrono::steady_clock::now() - Start;
+  using std::chrono::duration_cast;
+  CommitsDuration += duration_cast<std::chrono::microseconds>(Duration);
+}
+
+void ExecutionContext::commitBatch(CommitBatch &Batch) {
+  revng_assert(Pipe != nullptr);
+  auto Start = std::chrono::steady_clock::now();
+
+  auto &PathCache = Pipe->InvalidationMetadata.getPathCache();
+  for (auto &[GlobalName, Reads] : Batch.Reads)
+    PathCache[GlobalName].insert(Batch.Targets, std::move(Reads));
+
+  CommitsCount += Batch.Targets.size();
+  Batch = CommitBatch();
+
+  auto Duration = std::chrono::steady_clock::now() - Start;
+  using std::chrono::duration_cast;
+  CommitsDuration += duration_cast<std::chrono::microseconds>(Duration);
 }
 
 void ExecutionContext::commitUniqueTarget(const ContainerBase &Container) {
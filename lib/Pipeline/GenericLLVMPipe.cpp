@@ -5,8 +5,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/ScopeExit.h"
 #include "llvm/PassRegistry.h"
 #include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/CommandLine.h"
 
 #include "revng/Pipeline/GenericLLVMPipe.h"
 #include "revng/Pipeline/LLVMContainer.h"
@@ -17,12 +19,23 @@ using namespace llvm;
 using namespace pipeline;
 using namespace cl;
 
-void O2Pipe::registerPasses(llvm::legacy::PassManager &Manager) {
+static opt<bool> ReuseLegacyPassManagers("reuse-legacy-pass-managers",
+                                          desc("Build the legacy pass "
+                                               "managers of LLVM pipes once "
+                                               "and reuse them in the "
+                                               "following runs. Safe only if "
+                                               "no legacy pass keeps state "
+                                               "across runs."),
+                                          init(false));
+
+AnalysisKey ExecutionContextAnalysis::Key;
+
+void O2Pipe::registerPasses(llvm::ModulePassManager &Manager) {
   StringMap<llvm::cl::Option *> &Options(getRegisteredOptions());
   getOption<bool>(Options, "disable-machine-licm")->setInitialValue(true);
 
   PassBuilder Builder;
-  Builder.buildPerModuleDefaultPipeline(OptimizationLevel::O2);
+  Manager.addPass(Builder.buildPerModuleDefaultPipeline(OptimizationLevel::O2));
 }
 
 std::unique_ptr<LLVMPassWrapperBase> PureLLVMPassWrapper::clone() const {
@@ -34,20 +47,22 @@ public:
   static char ID;
 
   llvm::ArrayRef<ContractGroup> Contract;
-  ContainerToTargetsMap *Requested;
-  Context *Ctx;
-  llvm::ArrayRef<std::string> ContainersName;
+  ContainerToTargetsMap *Requested = nullptr;
+  const Context *Ctx = nullptr;
+  std::vector<std::string> ContainersName;
 
 public:
-  UpdateContract(llvm::ArrayRef<ContractGroup> Contract,
-                 ContainerToTargetsMap &Requested,
-                 llvm::ArrayRef<std::string> ContainersName) :
-    llvm::ModulePass(ID),
-    Contract(Contract),
-    Requested(&Requested),
-    ContainersName(ContainersName) {}
+  UpdateContract(llvm::ArrayRef<ContractGroup> Contract) :
+    llvm::ModulePass(ID), Contract(Contract) {}
 
 public:
+  /// Prepare the pass for a run of the pipe on \p ContainerName
+  void reset(ExecutionContext &ExecutionCtx, llvm::StringRef ContainerName) {
+    Ctx = &ExecutionCtx.getContext();
+    Requested = &ExecutionCtx.getCurrentRequestedTargets();
+    ContainersName = { ContainerName.str() };
+  }
+
   bool runOnModule(llvm::Module &Module) override {
     for (auto &Entry : Contract)
       Entry.deduceResults(*Ctx, *Requested, ContainersName);
@@ -55,6 +70,30 @@ public:
   }
 };
 
+/// The equivalent of UpdateContract for the new pass manager
+class UpdateContractPass : public PassInfoMixin<UpdateContractPass> {
+private:
+  llvm::ArrayRef<ContractGroup> Contract;
+  ExecutionContext *const *Current = nullptr;
+  const std::string *ContainerName = nullptr;
+
+public:
+  UpdateContractPass(llvm::ArrayRef<ContractGroup> Contract,
+                     ExecutionContext *const *Current,
+                     const std::string *ContainerName) :
+    Contract(Contract), Current(Current), ContainerName(ContainerName) {}
+
+public:
+  PreservedAnalyses run(llvm::Module &Module, ModuleAnalysisManager &) {
+    ExecutionContext &Ctx = **Current;
+    for (auto &Entry : Contract)
+      Entry.deduceResults(Ctx.getContext(),
+                          Ctx.getCurrentRequestedTargets(),
+                          llvm::ArrayRef(*ContainerName));
+    return PreservedAnalyses::all();
+  }
+};
+
 template<typename T>
 using RP = RegisterPass<T>;
 
@@ -63,17 +102,132 @@ char UpdateContract::ID = '_';
 static RP<UpdateContract>
   X("advance-contract", "Advances pipeline contracts", true, false);
 
+/// The pass managers of a GenericLLVMPipe, one for each maximal sequence of
+/// passes using the same kind of pass manager.
+///
+/// The new pass managers are always reused, since their passes are not
+/// supposed to keep state across runs. Their analyses are cached for the
+/// duration of a single run. The legacy pass managers are reused only if
+/// `-reuse-legacy-pass-managers` is set.
+struct GenericLLVMPipe::CachedPipeline {
+public:
+  struct Segment {
+    bool UsesNewPassManager = false;
+
+    /// The range of GenericLLVMPipe::Passes registered in this segment
+    size_t Begin = 0;
+    size_t End = 0;
+
+    llvm::ModulePassManager NewManager;
+
+    /// Built on demand, the passes are owned by the manager
+    std::unique_ptr<llvm::legacy::PassManager> LegacyManager;
+    LoadExecutionContextPass *LoadContext = nullptr;
+    llvm::SmallVector<UpdateContract *, 4> Updates;
+  };
+
+public:
+  /// The context and the container of the ongoing run
+  ExecutionContext *Current = nullptr;
+  std::string ContainerName;
+
+  std::vector<Segment> Segments;
+
+  // The order matters, the analysis managers refer to the previous ones
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+
+public:
+  void clearAnalyses() {
+    LAM.clear();
+    FAM.clear();
+    CGAM.clear();
+    MAM.clear();
+  }
+};
+
+void GenericLLVMPipe::buildPipeline() {
+  Cache = std::make_shared<CachedPipeline>();
+  CachedPipeline &C = *Cache;
+
+  PassBuilder Builder;
+  Builder.registerModuleAnalyses(C.MAM);
+  Builder.registerCGSCCAnalyses(C.CGAM);
+  Builder.registerFunctionAnalyses(C.FAM);
+  Builder.registerLoopAnalyses(C.LAM);
+  Builder.crossRegisterProxies(C.LAM, C.FAM, C.CGAM, C.MAM);
+  C.MAM.registerPass([&C] { return ExecutionContextAnalysis(&C.Current); });
+
+  for (size_t I = 0; I < Passes.size(); ++I) {
+    LLVMPassWrapperBase &Element = *Passes[I];
+    bool UsesNewPassManager = Element.usesNewPassManager();
+    if (C.Segments.empty()
+        or C.Segments.back().UsesNewPassManager != UsesNewPassManager) {
+      CachedPipeline::Segment &New = C.Segments.emplace_back();
+      New.UsesNewPassManager = UsesNewPassManager;
+      New.Begin = I;
+    }
+
+    CachedPipeline::Segment &Segment = C.Segments.back();
+    Segment.End = I + 1;
+    if (UsesNewPassManager) {
+      Element.registerPasses(Segment.NewManager);
+      Segment.NewManager.addPass(UpdateContractPass(Element.getContract(),
+                                                    &C.Current,
+                                                    &C.ContainerName));
+    }
+  }
+}
+
 void GenericLLVMPipe::run(ExecutionContext &Ctx, LLVMContainer &Container) {
-  llvm::legacy::PassManager Manager;
-  Manager.add(new LoadExecutionContextPass(&Ctx, Container.name()));
-  using ElementType = std::unique_ptr<LLVMPassWrapperBase>;
-  for (const ElementType &Element : Passes) {
-    Element->registerPasses(Manager);
-    Manager.add(new UpdateContract(Element->getContract(),
-                                   Ctx.getCurrentRequestedTargets(),
-                                   { Container.name() }));
+  if (not Cache)
+    buildPipeline();
+
+  Cache->Current = &Ctx;
+  Cache->ContainerName = Container.name().str();
+  auto OnExit = llvm::make_scope_exit([this] {
+    // The cached analyses refer to the module we ran on
+    Cache->clearAnalyses();
+    Cache->Current = nullptr;
+  });
+
+  llvm::Module &Module = Container.getModule();
+  for (CachedPipeline::Segment &Segment : Cache->Segments) {
+    if (Segment.UsesNewPassManager) {
+      Segment.NewManager.run(Module, Cache->MAM);
+      continue;
+    }
+
+    if (not Segment.LegacyManager) {
+      auto Manager = std::make_unique<llvm::legacy::PassManager>();
+      Segment.LoadContext = new LoadExecutionContextPass(nullptr, "");
+      Manager->add(Segment.LoadContext);
+      for (size_t I = Segment.Begin; I < Segment.End; ++I) {
+        Passes[I]->registerPasses(*Manager);
+        auto *Update = new UpdateContract(Passes[I]->getContract());
+        Segment.Updates.push_back(Update);
+        Manager->add(Update);
+      }
+      Segment.LegacyManager = std::move(Manager);
+    }
+
+    Segment.LoadContext->reset(&Ctx, Cache->ContainerName);
+    for (UpdateContract *Update : Segment.Updates)
+      Update->reset(Ctx, Cache->ContainerName);
+
+    Segment.LegacyManager->run(Module);
+
+    // The legacy passes do not tell the new analyses what they preserved
+    Cache->clearAnalyses();
+
+    if (not ReuseLegacyPassManagers) {
+      Segment.LegacyManager.reset();
+      Segment.LoadContext = nullptr;
+      Segment.Updates.clear();
+    }
   }
-  Manager.run(Container.getModule());
 }
 
 void PureLLVMPassWrapper::registerPasses(llvm::legacy::PassManager &Manager) {
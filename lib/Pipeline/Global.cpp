@@ -7,7 +7,9 @@
 
 #include <system_error>
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
 
@@ -17,6 +19,38 @@ using namespace std;
 using namespace pipeline;
 using namespace llvm;
 
+static cl::list<std::string> BinaryGlobals("binary-globals",
+                                           cl::desc("Store the listed "
+                                                    "globals in the compact "
+                                                    "binary format instead "
+                                                    "of YAML"),
+                                           cl::CommaSeparated);
+
+bool pipeline::isStoredAsBinary(llvm::StringRef GlobalName) {
+  return llvm::is_contained(BinaryGlobals, GlobalName);
+}
+
+namespace {
+
+/// A stream discarding its content, which only counts the bytes written to it
+class CountingOStream : public llvm::raw_ostream {
+private:
+  uint64_t Count = 0;
+
+private:
+  void write_impl(const char *, size_t Size) override { Count += Size; }
+  uint64_t current_pos() const override { return Count; }
+};
+
+} // namespace
+
+uint64_t
+pipeline::serializedSize(function_ref<void(raw_ostream &)> Serialize) {
+  CountingOStream OS;
+  Serialize(OS);
+  return OS.tell();
+}
+
 Error Global::store(const revng::FilePath &Path) const {
   auto MaybeWritableFile = Path.getWritableFile();
   if (not MaybeWritableFile)
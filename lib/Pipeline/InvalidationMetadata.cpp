@@ -0,0 +1,387 @@
+/// \file InvalidationMetadata.cpp
+/// The encodings of the invalidation metadata of the steps.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <map>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Support/Assert.h"
+#include "revng/Support/YAMLTraits.h"
+
+using namespace llvm;
+using namespace pipeline;
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(ContainerInvalidationMetadata::ValueType);
+
+namespace llvm {
+namespace yaml {
+
+// YAML traits for TargetInContainer
+template<>
+struct MappingTraits<pipeline::TargetInPipe> {
+  static void mapping(IO &IO, pipeline::TargetInPipe &TargetInContainer) {
+    IO.mapRequired("Target", TargetInContainer.SerializedTarget);
+    IO.mapRequired("PipeName", TargetInContainer.PipeName);
+  }
+};
+
+template<>
+struct MappingTraits<pipeline::ContainerInvalidationMetadata> {
+  static void mapping(IO &Io,
+                      pipeline::ContainerInvalidationMetadata &TargetMap) {
+    Io.mapRequired("Map", TargetMap.Data);
+  }
+};
+
+template<>
+struct MappingTraits<ContainerInvalidationMetadata::Vector::value_type> {
+  static void
+  mapping(IO &Io,
+          pipeline::ContainerInvalidationMetadata::Vector::value_type
+            &TargetMap) {
+    Io.mapRequired("Target", TargetMap.first.SerializedTarget);
+    Io.mapRequired("PipeName", TargetMap.first.PipeName);
+    Io.mapRequired("ReadPaths", TargetMap.second);
+  }
+};
+
+} // namespace yaml
+} // namespace llvm
+
+LLVM_YAML_IS_SEQUENCE_VECTOR(pipeline::NamedPathTargetBimapVector);
+
+namespace llvm {
+namespace yaml {
+template<>
+struct MappingTraits<pipeline::NamedPathTargetBimapVector> {
+  static void mapping(IO &Io, pipeline::NamedPathTargetBimapVector &TargetMap) {
+    Io.mapRequired("GlobalName", TargetMap.GlobalName);
+    Io.mapRequired("Map", TargetMap.Map.Data);
+  }
+};
+} // namespace yaml
+} // namespace llvm
+
+
+/// Binary encoding of the invalidation metadata of a container.
+///
+/// All the strings (names of the globals, serialized targets, names of the
+/// pipes and serialized paths) are interned in a table at the beginning of the
+/// file, which is then referred to by index. All the integers are 32-bit
+/// little endian:
+///
+///     Magic        BinaryMetadataMagic
+///     Version      BinaryMetadataVersion
+///     StringCount  followed by StringCount (Size, Size bytes) pairs
+///     GlobalCount  followed by GlobalCount global records
+///
+/// Each global record is:
+///
+///     GlobalName   index in the string table
+///     EntryCount   followed by EntryCount entry records
+///
+/// Each entry record is:
+///
+///     Target       index in the string table
+///     PipeName     index in the string table
+///     PathCount    followed by PathCount indexes in the string table
+///
+/// The loader distinguishes the binary format from YAML by the magic, the YAML
+/// encoding is still accepted and can be emitted with
+/// -yaml-invalidation-metadata.
+static constexpr llvm::StringLiteral BinaryMetadataMagic = "RVNGIMD\0";
+static constexpr uint32_t BinaryMetadataVersion = 1;
+
+class StringInterner {
+private:
+  llvm::StringMap<uint32_t> Indexes;
+  std::vector<llvm::StringRef> Strings;
+
+public:
+  uint32_t intern(llvm::StringRef String) {
+    auto [It, New] = Indexes.try_emplace(String, Strings.size());
+    if (New)
+      Strings.push_back(It->first());
+    return It->second;
+  }
+
+  const std::vector<llvm::StringRef> &strings() const { return Strings; }
+};
+
+void pipeline::writeBinaryInvalidationMetadata(llvm::raw_ostream &OS,
+                                               const InvalidationMetadataVector
+                                                 &ToStore) {
+  StringInterner Interner;
+  for (const NamedPathTargetBimapVector &Global : ToStore) {
+    Interner.intern(Global.GlobalName);
+    for (const auto &[Target, Paths] : Global.Map.Data) {
+      Interner.intern(Target.SerializedTarget);
+      Interner.intern(Target.PipeName);
+      for (const std::string &Path : Paths)
+        Interner.intern(Path);
+    }
+  }
+
+  support::endian::Writer Writer(OS, support::little);
+  OS << BinaryMetadataMagic;
+  Writer.write<uint32_t>(BinaryMetadataVersion);
+
+  Writer.write<uint32_t>(Interner.strings().size());
+  for (llvm::StringRef String : Interner.strings()) {
+    Writer.write<uint32_t>(String.size());
+    OS << String;
+  }
+
+  Writer.write<uint32_t>(ToStore.size());
+  for (const NamedPathTargetBimapVector &Global : ToStore) {
+    Writer.write<uint32_t>(Interner.intern(Global.GlobalName));
+    Writer.write<uint32_t>(Global.Map.Data.size());
+    for (const auto &[Target, Paths] : Global.Map.Data) {
+      Writer.write<uint32_t>(Interner.intern(Target.SerializedTarget));
+      Writer.write<uint32_t>(Interner.intern(Target.PipeName));
+      Writer.write<uint32_t>(Paths.size());
+      for (const std::string &Path : Paths)
+        Writer.write<uint32_t>(Interner.intern(Path));
+    }
+  }
+}
+
+class BinaryMetadataReader {
+private:
+  llvm::StringRef Buffer;
+  std::vector<llvm::StringRef> Strings;
+
+public:
+  explicit BinaryMetadataReader(llvm::StringRef Buffer) : Buffer(Buffer) {}
+
+public:
+  static bool isBinary(llvm::StringRef Buffer) {
+    return Buffer.startswith(BinaryMetadataMagic);
+  }
+
+  llvm::Expected<InvalidationMetadataVector> read() {
+    InvalidationMetadataVector Result;
+
+    Buffer = Buffer.drop_front(BinaryMetadataMagic.size());
+    uint32_t Version = 0;
+    if (not readInteger(Version))
+      return malformed();
+
+    if (Version != BinaryMetadataVersion) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Unsupported invalidation metadata "
+                                     "version %u",
+                                     Version);
+    }
+
+    // Each count is checked against what is left of the buffer before
+    // allocating anything for it, so that corrupted counts are caught
+    uint32_t StringCount = 0;
+    if (not readInteger(StringCount) or not fits(StringCount, StringSize))
+      return malformed();
+
+    Strings.reserve(StringCount);
+    for (uint32_t I = 0; I < StringCount; ++I) {
+      uint32_t Size = 0;
+      if (not readInteger(Size) or Buffer.size() < Size)
+        return malformed();
+      Strings.push_back(Buffer.take_front(Size));
+      Buffer = Buffer.drop_front(Size);
+    }
+
+    uint32_t GlobalCount = 0;
+    if (not readInteger(GlobalCount) or not fits(GlobalCount, GlobalSize))
+      return malformed();
+
+    for (uint32_t I = 0; I < GlobalCount; ++I) {
+      NamedPathTargetBimapVector &Global = Result.emplace_back();
+      uint32_t EntryCount = 0;
+      if (not readString(Global.GlobalName) or not readInteger(EntryCount)
+          or not fits(EntryCount, EntrySize))
+        return malformed();
+
+      auto &Data = Global.Map.Data;
+      Data.reserve(EntryCount);
+      for (uint32_t J = 0; J < EntryCount; ++J) {
+        auto &[Target, Paths] = Data.emplace_back();
+        uint32_t PathCount = 0;
+        if (not readString(Target.SerializedTarget)
+            or not readString(Target.PipeName) or not readInteger(PathCount)
+            or not fits(PathCount, PathSize))
+          return malformed();
+
+        Paths.resize(PathCount);
+        for (std::string &Path : Paths)
+          if (not readString(Path))
+            return malformed();
+      }
+    }
+
+    if (not Buffer.empty())
+      return malformed();
+
+    return Result;
+  }
+
+private:
+  /// The minimum size of each kind of record, i.e., with no strings or paths
+  static constexpr size_t StringSize = sizeof(uint32_t);
+  static constexpr size_t GlobalSize = 2 * sizeof(uint32_t);
+  static constexpr size_t EntrySize = 3 * sizeof(uint32_t);
+  static constexpr size_t PathSize = sizeof(uint32_t);
+
+  /// \return true if what is left of the buffer can hold \p Count records of
+  ///         at least \p RecordSize bytes each
+  bool fits(uint32_t Count, size_t RecordSize) const {
+    return Count <= Buffer.size() / RecordSize;
+  }
+
+  bool readInteger(uint32_t &Out) {
+    if (Buffer.size() < sizeof(uint32_t))
+      return false;
+    Out = support::endian::read32le(Buffer.data());
+    Buffer = Buffer.drop_front(sizeof(uint32_t));
+    return true;
+  }
+
+  bool readString(std::string &Out) {
+    uint32_t Index = 0;
+    if (not readInteger(Index) or Index >= Strings.size())
+      return false;
+    Out = Strings[Index].str();
+    return true;
+  }
+
+  static llvm::Error malformed() {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Malformed binary invalidation metadata");
+  }
+};
+
+void pipeline::writeYAMLInvalidationMetadata(llvm::raw_ostream &OS,
+                                             const InvalidationMetadataVector
+                                               &ToStore) {
+  ::serialize(OS, ToStore);
+}
+
+llvm::Expected<InvalidationMetadataVector>
+pipeline::parseInvalidationMetadata(llvm::StringRef Buffer) {
+  if (BinaryMetadataReader::isBinary(Buffer))
+    return BinaryMetadataReader(Buffer).read();
+
+  return ::deserialize<InvalidationMetadataVector>(Buffer);
+}
+
+llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
+TargetInPipe::deserialize(const Context &Ctx,
+                          llvm::StringRef ContainerName) const {
+  TargetsList Targets;
+  llvm::Error Error = parseTarget(Ctx,
+                                  SerializedTarget,
+                                  Ctx.getKindsRegistry(),
+                                  Targets);
+  if (Error)
+    return std::move(Error);
+
+  llvm::SmallVector<TargetInContainer, 2> Return;
+  for (const Target &Target : Targets) {
+    Return.emplace_back(std::move(Target), ContainerName.str());
+  }
+  return Return;
+}
+
+TargetInPipe
+TargetInPipe::fromTargetInContainer(const TargetInContainer &Target,
+                                    llvm::StringRef PipeName) {
+  TargetInPipe ToReturn;
+  ToReturn.PipeName = PipeName;
+  ToReturn.SerializedTarget = Target.getTarget().serialize();
+
+  return ToReturn;
+}
+
+ContainerInvalidationMetadata
+ContainerInvalidationMetadata::serialize(const PathTargetBimap &Map,
+                                         const Global &Global,
+                                         llvm::StringRef PipeName,
+                                         llvm::StringRef ContainerName) {
+  ContainerInvalidationMetadata ToSerialize;
+  std::map<pipeline::TargetInPipe, std::vector<std::string>> TemporaryMap;
+
+  for (const auto &Content : Map) {
+    for (const TargetInContainer &Entry : Content.second) {
+      if (Entry.getContainerName() != ContainerName)
+        continue;
+
+      std::optional<std::string> AsString = Global.serializePath(Content.first);
+      revng_check(AsString.has_value());
+      TemporaryMap[TargetInPipe::fromTargetInContainer(Entry, PipeName)]
+        .push_back(*AsString);
+    }
+  }
+
+  for (const auto &Content : TemporaryMap) {
+    std::pair ToEmplace{ Content.first, Content.second };
+    ToSerialize.Data.emplace_back(std::move(ToEmplace));
+  }
+
+  return ToSerialize;
+}
+
+llvm::Expected<PathTargetBimap>
+ContainerInvalidationMetadata::deserialize(const Context &Ctx,
+                                           const Global &Global,
+                                           llvm::StringRef PipeName,
+                                           llvm::StringRef ContainerName,
+                                           llvm::StringMap<TupleTreePath>
+                                             &ParsedPaths) const {
+
+  PathTargetBimap ToReturn;
+  for (const ValueType &Entry : Data) {
+    if (Entry.first.PipeName != PipeName) {
+      continue;
+    }
+
+    llvm::Expected<SmallVector<TargetInContainer>>
+      MaybeTarget = Entry.first.deserialize(Ctx, ContainerName);
+
+    if (not MaybeTarget) {
+      return MaybeTarget.takeError();
+    }
+
+    for (auto &SerializedPath : Entry.second) {
+      auto It = ParsedPaths.find(SerializedPath);
+      if (It == ParsedPaths.end()) {
+        std::optional<TupleTreePath>
+          MaybeParsedPath = Global.deserializePath(SerializedPath);
+
+        if (not MaybeParsedPath) {
+          return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                         "could not parse " + SerializedPath);
+        }
+
+        It = ParsedPaths
+               .try_emplace(SerializedPath, std::move(*MaybeParsedPath))
+               .first;
+      }
+
+      for (const TargetInContainer &Path : *MaybeTarget) {
+        ToReturn.insert(Path, It->second);
+      }
+    }
+  }
+
+  return ToReturn;
+}
+
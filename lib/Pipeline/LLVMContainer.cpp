@@ -10,16 +10,21 @@
 #include <memory>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/Constant.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DebugInfoMetadata.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/Linker/Linker.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
@@ -32,6 +37,23 @@
 const char pipeline::LLVMContainer::ID = '0';
 using namespace pipeline;
 
+/// Named metadata recording the metadata attachments of function definitions
+/// in bitcode produced by storeCached.
+///
+/// The bitcode reader loads the attachments of a definition only when its body
+/// is materialized, but enumerating the targets of a container requires them.
+/// Each operand is a tuple: the function followed by pairs of attachment kind
+/// name and attached node.
+static constexpr const char *AttachmentsIndexName = "revng.lazy.attachments";
+
+static llvm::cl::opt<bool> MergeInPlace("llvm-container-merge-in-place",
+                                        llvm::cl::desc("Merge LLVM containers "
+                                                       "by replacing function "
+                                                       "bodies in place when "
+                                                       "possible, rather than "
+                                                       "linking them"),
+                                        llvm::cl::init(true));
+
 void pipeline::makeGlobalObjectsArray(llvm::Module &Module,
                                       llvm::StringRef GlobalArrayName) {
   auto *IntegerTy = llvm::IntegerType::get(Module.getContext(),
@@ -73,9 +95,18 @@ LLVMContainer::cloneFiltered(const TargetsList &Targets) const {
     return ToClone.contains(F) or ToClonedNotOwned.contains(F);
   };
 
+  // Only the functions we're going to copy need their body, the others are
+  // going to be turned into declarations
+  for (const llvm::Function *F : ToClone)
+    materialize(*const_cast<llvm::Function *>(F));
+  for (const llvm::Function *F : ToClonedNotOwned)
+    materialize(*const_cast<llvm::Function *>(F));
+
   llvm::ValueToValueMapTy Map;
 
-  revng::verify(Module.get());
+  // The verifier cannot inspect functions that have not been materialized
+  if (Module->getMaterializer() == nullptr)
+    revng::verify(Module.get());
   auto Cloned = llvm::CloneModule(*Module, Map, Filter);
 
   for (auto &Function : Module->functions()) {
@@ -121,18 +152,214 @@ static void fixGlobals(llvm::Module &Module,
   }
 }
 
+/// Named metadata that mergeInPlace ignores: it's either dropped or rebuilt
+static bool isMergedSeparately(const llvm::NamedMDNode &MD) {
+  llvm::StringRef Name = MD.getName();
+  return Name == "llvm.dbg.cu" or Name == "llvm.ident"
+         or Name == "llvm.module.flags";
+}
+
+/// Checks whether mergeInPlace can merge \p Source into \p Destination, i.e.,
+/// every global object of Source already has a compatible counterpart in
+/// Destination, except for functions that do not need to be deduplicated,
+/// which can be created on demand. Global variables must also have the same
+/// initializer.
+static bool canMergeInPlace(llvm::Module &Destination, llvm::Module &Source) {
+  using namespace llvm;
+
+  if (not Source.alias_empty() or not Source.ifunc_empty())
+    return false;
+
+  if (Source.getDataLayout() != Destination.getDataLayout()
+      and not Source.getDataLayout().isDefault())
+    return false;
+
+  ValueToValueMapTy Map;
+  for (GlobalVariable &Variable : Source.globals()) {
+    auto *Counterpart = Destination.getGlobalVariable(Variable.getName(), true);
+    if (Counterpart == nullptr
+        or Counterpart->getValueType() != Variable.getValueType()
+        or Counterpart->hasInitializer() != Variable.hasInitializer())
+      return false;
+    Map[&Variable] = Counterpart;
+  }
+
+  for (Function &F : Source.functions()) {
+    Function *Counterpart = Destination.getFunction(F.getName());
+    if (Counterpart == nullptr) {
+      // New functions can be created, unless the linker would have to
+      // deduplicate them
+      if (FunctionTags::UniquedByPrototype.isTagOf(&F)
+          or FunctionTags::UniquedByMetadata.isTagOf(&F))
+        return false;
+      continue;
+    }
+
+    if (Counterpart->getFunctionType() != F.getFunctionType())
+      return false;
+    Map[&F] = Counterpart;
+  }
+
+  // Globals that are not in Map are mapped to themselves, hence initializers
+  // using them never match
+  for (GlobalVariable &Variable : Source.globals()) {
+    if (not Variable.hasInitializer())
+      continue;
+
+    auto *Counterpart = cast<GlobalVariable>(Map[&Variable]);
+    Constant *Mapped = MapValue(Variable.getInitializer(),
+                                Map,
+                                RF_NoModuleLevelChanges);
+    if (Mapped != Counterpart->getInitializer())
+      return false;
+  }
+
+  for (const NamedMDNode &MD : Source.named_metadata()) {
+    if (isMergedSeparately(MD))
+      continue;
+
+    const NamedMDNode *Counterpart = Destination.getNamedMetadata(MD.getName());
+    if (Counterpart == nullptr)
+      return false;
+
+    SmallPtrSet<const MDNode *, 8> Existing(Counterpart->op_begin(),
+                                            Counterpart->op_end());
+    for (const MDNode *Operand : MD.operands())
+      if (not Existing.contains(Operand))
+        return false;
+  }
+
+  return true;
+}
+
+/// Merges \p Source into \p Destination by copying the body of each function
+/// defined in Source over its counterpart in Destination.
+///
+/// The cost is proportional to the size of Source only, as opposed to linking
+/// the two modules, which processes Destination as a whole. Returns false,
+/// leaving both modules untouched, if the modules cannot be merged this way.
+///
+/// If \p Statistics is not null, it's updated for the functions of Destination
+/// that are created, replaced or erased.
+static bool mergeInPlace(llvm::Module &Destination,
+                         llvm::Module &Source,
+                         ModuleStatistics *Statistics) {
+  using namespace llvm;
+
+  if (not canMergeInPlace(Destination, Source))
+    return false;
+
+  // Map every global object of Source to its counterpart, creating the
+  // missing functions
+  ValueToValueMapTy Map;
+  for (GlobalVariable &Variable : Source.globals())
+    Map[&Variable] = Destination.getGlobalVariable(Variable.getName(), true);
+
+  for (Function &F : Source.functions()) {
+    Function *Counterpart = Destination.getFunction(F.getName());
+    if (Counterpart == nullptr) {
+      Counterpart = Function::Create(F.getFunctionType(),
+                                     F.getLinkage(),
+                                     F.getAddressSpace(),
+                                     F.getName(),
+                                     &Destination);
+      Counterpart->copyAttributesFrom(&F);
+
+      SmallVector<std::pair<unsigned, MDNode *>, 2> Attachments;
+      F.getAllMetadata(Attachments);
+      for (const auto &[Kind, Node] : Attachments)
+        if (F.isDeclaration() or not isa<DISubprogram>(Node))
+          Counterpart->addMetadata(Kind, *Node);
+
+      if (Statistics != nullptr)
+        Statistics->addFunction(*Counterpart);
+    }
+
+    Map[&F] = Counterpart;
+  }
+
+  // Functions that the replaced bodies were using, which might have become
+  // dead
+  SmallPtrSet<Function *, 16> MaybeDead;
+
+  for (Function &F : Source.functions()) {
+    if (F.isDeclaration())
+      continue;
+
+    auto *Counterpart = cast<Function>(Map[&F]);
+    for (Instruction &I : instructions(*Counterpart))
+      for (Value *Operand : I.operands())
+        if (auto *Callee = dyn_cast<Function>(Operand->stripPointerCasts()))
+          MaybeDead.insert(Callee);
+
+    if (Statistics != nullptr)
+      Statistics->removeFunction(*Counterpart);
+
+    Counterpart->deleteBody();
+    Counterpart->clearMetadata();
+
+    for (auto &&[From, To] : zip(F.args(), Counterpart->args())) {
+      To.setName(From.getName());
+      Map[&From] = &To;
+    }
+
+    SmallVector<ReturnInst *, 4> Returns;
+    CloneFunctionInto(Counterpart,
+                      &F,
+                      Map,
+                      CloneFunctionChangeType::DifferentModule,
+                      Returns);
+    Counterpart->setLinkage(F.getLinkage());
+
+    if (Statistics != nullptr)
+      Statistics->addFunction(*Counterpart);
+  }
+
+  // Purge the functions that are no longer used, like the linking path does
+  for (Function *F : MaybeDead) {
+    if (not FunctionTags::Isolated.isTagOf(F) and F->use_empty()) {
+      if (Statistics != nullptr)
+        Statistics->removeFunction(*F);
+      F->eraseFromParent();
+    }
+  }
+
+  return true;
+}
+
 void LLVMContainer::mergeBackImpl(ThisType &&OtherContainer) {
+  materializeAll();
   llvm::Module *ToMerge = &OtherContainer.getModule();
   revng::verify(ToMerge);
 
-  // Collect statistics about modules
-  ModuleStatistics PreMergeStatistics;
-  ModuleStatistics ToMergeStatistics;
+  // Only walk the (usually small) module being merged: the statistics of this
+  // container are either kept up to date or computed before merging them
+  std::optional<ModuleStatistics> PreMergeStatistics;
+  std::optional<ModuleStatistics> ToMergeStatistics;
   if (ModuleStatisticsLogger.isEnabled()) {
-    PreMergeStatistics = ModuleStatistics::analyze(*Module.get());
+    PreMergeStatistics = statistics();
     ToMergeStatistics = ModuleStatistics::analyze(*ToMerge);
   }
 
+  ModuleStatistics *Tracked = Statistics ? &*Statistics : nullptr;
+  if (MergeInPlace and mergeInPlace(*Module, *ToMerge, Tracked)) {
+    // CloneFunctionInto registers a new compile unit for each merged module,
+    // prune them once in a while so that they do not accumulate
+    if (auto *CUs = Module->getNamedMetadata("llvm.dbg.cu");
+        CUs != nullptr and CUs->getNumOperands() > 2 * CompileUnitsAfterPrune) {
+      pruneDICompileUnits(*Module);
+      CUs = Module->getNamedMetadata("llvm.dbg.cu");
+      CompileUnitsAfterPrune = CUs != nullptr ? CUs->getNumOperands() : 0;
+    }
+
+    revng::verify(Module.get());
+    logMergeStatistics(PreMergeStatistics, ToMergeStatistics);
+    return;
+  }
+
+  // Linking rebuilds the module as a whole
+  Statistics.reset();
+
   auto BeforeEnumeration = this->enumerate();
   auto ToMergeEnumeration = OtherContainer.enumerate();
 
@@ -269,24 +496,34 @@ void LLVMContainer::mergeBackImpl(ThisType &&OtherContainer) {
   //       to share debug metadata, which are not always immutable.
   auto *NamedMDNode = Module->getOrInsertNamedMetadata("llvm.dbg.cu");
   pruneDICompileUnits(*Module);
+  if (auto *CUs = Module->getNamedMetadata("llvm.dbg.cu"))
+    CompileUnitsAfterPrune = CUs->getNumOperands();
 
   revng::verify(ToMerge);
 
-  if (ModuleStatisticsLogger.isEnabled()) {
-    auto PostMergeStatistics = ModuleStatistics::analyze(*Module.get());
-    {
-      auto Stream = ModuleStatisticsLogger.getAsLLVMStream();
-      *Stream << "PreMergeStatistics:\n";
-      PreMergeStatistics.dump(*Stream, 1);
-      *Stream << "ToMergeStatistics:\n";
-      ToMergeStatistics.dump(*Stream, 1);
-      *Stream << "PostMergeStatistics (vs PreMergeStatistics):\n";
-      PreMergeStatistics.dump(*Stream, 1, &PreMergeStatistics);
-      *Stream << "PostMergeStatistics (vs ToMergeStatistics):\n";
-      PreMergeStatistics.dump(*Stream, 1, &ToMergeStatistics);
-    }
-    ModuleStatisticsLogger << DoLog;
+  logMergeStatistics(PreMergeStatistics, ToMergeStatistics);
+}
+
+void LLVMContainer::logMergeStatistics(const OptionalStatistics &Pre,
+                                       const OptionalStatistics &ToMerge)
+  const {
+  if (not ModuleStatisticsLogger.isEnabled())
+    return;
+
+  revng_assert(Pre and ToMerge);
+  const ModuleStatistics &Post = statistics();
+  {
+    auto Stream = ModuleStatisticsLogger.getAsLLVMStream();
+    *Stream << "PreMergeStatistics:\n";
+    Pre->dump(*Stream, 1);
+    *Stream << "ToMergeStatistics:\n";
+    ToMerge->dump(*Stream, 1);
+    *Stream << "PostMergeStatistics (vs PreMergeStatistics):\n";
+    Post.dump(*Stream, 1, &*Pre);
+    *Stream << "PostMergeStatistics (vs ToMergeStatistics):\n";
+    Post.dump(*Stream, 1, &*ToMerge);
   }
+  ModuleStatisticsLogger << DoLog;
 }
 
 llvm::Error LLVMContainer::extractOne(llvm::raw_ostream &OS,
@@ -302,9 +539,167 @@ llvm::Error LLVMContainer::serialize(llvm::raw_ostream &OS) const {
   return llvm::Error::success();
 }
 
+llvm::Error LLVMContainer::storeCached(const revng::FilePath &Path) const {
+  materializeAll();
+
+  auto MaybeWritableFile = Path.getWritableFile();
+  if (not MaybeWritableFile)
+    return MaybeWritableFile.takeError();
+
+  llvm::LLVMContext &Context = Module->getContext();
+  llvm::SmallVector<llvm::StringRef> KindNames;
+  Context.getMDKindNames(KindNames);
+
+  auto *Index = Module->getOrInsertNamedMetadata(AttachmentsIndexName);
+  for (llvm::Function &F : Module->functions()) {
+    if (F.isDeclaration() or not F.hasMetadata())
+      continue;
+
+    llvm::SmallVector<std::pair<unsigned, llvm::MDNode *>, 4> Attachments;
+    F.getAllMetadata(Attachments);
+
+    llvm::SmallVector<llvm::Metadata *, 8> Operands;
+    Operands.push_back(llvm::ValueAsMetadata::get(&F));
+    for (const auto &[KindID, Node] : Attachments) {
+      Operands.push_back(llvm::MDString::get(Context, KindNames[KindID]));
+      Operands.push_back(Node);
+    }
+
+    Index->addOperand(llvm::MDTuple::get(Context, Operands));
+  }
+
+  llvm::WriteBitcodeToFile(*Module, MaybeWritableFile.get()->os());
+  Index->eraseFromParent();
+
+  return MaybeWritableFile.get()->commit();
+}
+
+llvm::Error LLVMContainer::loadCached(const revng::FilePath &Path) {
+  auto MaybeExists = Path.exists();
+  if (not MaybeExists)
+    return MaybeExists.takeError();
+
+  if (not MaybeExists.get()) {
+    clear();
+    return llvm::Error::success();
+  }
+
+  auto MaybeReadableFile = Path.getReadableFile();
+  if (not MaybeReadableFile)
+    return MaybeReadableFile.takeError();
+
+  const llvm::MemoryBuffer &Buffer = MaybeReadableFile.get()->buffer();
+  const auto *Start = reinterpret_cast<const unsigned char *>(Buffer
+                                                                .getBufferStart());
+  const auto *End = reinterpret_cast<const unsigned char *>(Buffer
+                                                              .getBufferEnd());
+
+  // Textual IR, possibly coming from a previous version
+  if (not llvm::isBitcode(Start, End))
+    return deserialize(Buffer);
+
+  // The module keeps reading from the buffer as functions get materialized:
+  // hand it the (possibly memory-mapped) file itself rather than a copy
+  using revng::OwningReadableFileBuffer;
+  auto File = std::move(MaybeReadableFile.get());
+  auto Owning = std::make_unique<OwningReadableFileBuffer>(std::move(File));
+  auto MaybeModule = llvm::getOwningLazyBitcodeModule(std::move(Owning),
+                                                      Module->getContext());
+  if (not MaybeModule)
+    return MaybeModule.takeError();
+
+  llvm::Module &Loaded = **MaybeModule;
+  if (auto Error = Loaded.materializeMetadata(); Error)
+    return Error;
+
+  if (auto *Index = Loaded.getNamedMetadata(AttachmentsIndexName)) {
+    for (llvm::MDNode *Entry : Index->operands()) {
+      using llvm::mdconst::dyn_extract_or_null;
+      auto *F = dyn_extract_or_null<llvm::Function>(Entry->getOperand(0));
+
+      // The function might have been dropped
+      if (F == nullptr)
+        continue;
+
+      for (unsigned I = 1; I + 1 < Entry->getNumOperands(); I += 2) {
+        auto Kind = llvm::cast<llvm::MDString>(Entry->getOperand(I));
+        auto *Node = llvm::cast<llvm::MDNode>(Entry->getOperand(I + 1));
+        F->setMetadata(Kind->getString(), Node);
+      }
+    }
+
+    Index->eraseFromParent();
+  }
+
+  Module = std::move(*MaybeModule);
+  Statistics.reset();
+
+  return llvm::Error::success();
+}
+
+size_t LLVMContainer::memoryUsage() const {
+  const ModuleStatistics &Stats = statistics();
+  return sizeof(llvm::Module)
+         + Stats.globalsCount() * sizeof(llvm::GlobalVariable)
+         + Stats.functionsCount() * sizeof(llvm::Function)
+         + Stats.argumentsCount() * sizeof(llvm::Argument)
+         + Stats.basicBlocksCount() * sizeof(llvm::BasicBlock)
+         + Stats.instructionsCount() * sizeof(llvm::Instruction)
+         + Stats.operandsCount() * sizeof(llvm::Use);
+}
+
+void LLVMContainer::materialize(llvm::Function &F) const {
+  if (not F.isMaterializable())
+    return;
+
+  if (Statistics)
+    Statistics->removeFunction(F);
+
+  // Drop the attachments restored from the index, the bitcode reader is going
+  // to add them again
+  F.clearMetadata();
+
+  if (auto Error = F.materialize(); Error) {
+    std::string Message = llvm::toString(std::move(Error));
+    revng_abort(Message.c_str());
+  }
+
+  if (Statistics)
+    Statistics->addFunction(F);
+}
+
+void LLVMContainer::materializeAll() const {
+  if (Module->getMaterializer() == nullptr)
+    return;
+
+  for (llvm::Function &F : Module->functions())
+    materialize(F);
+
+  if (auto Error = Module->materializeAll(); Error) {
+    std::string Message = llvm::toString(std::move(Error));
+    revng_abort(Message.c_str());
+  }
+}
+
 llvm::Error LLVMContainer::deserialize(const llvm::MemoryBuffer &Buffer) {
+  const auto *Start = reinterpret_cast<const unsigned char *>(Buffer
+                                                                .getBufferStart());
+  const auto *End = reinterpret_cast<const unsigned char *>(Buffer
+                                                              .getBufferEnd());
+
+  // The textual IR parser expects a null-terminated buffer, which buffers
+  // mapped from files are not guaranteed to be
+  std::unique_ptr<llvm::MemoryBuffer> Terminated;
+  llvm::MemoryBufferRef Input = Buffer.getMemBufferRef();
+  if (not llvm::isBitcode(Start, End)) {
+    Terminated = llvm::MemoryBuffer::getMemBufferCopy(Buffer.getBuffer(),
+                                                      Buffer
+                                                        .getBufferIdentifier());
+    Input = Terminated->getMemBufferRef();
+  }
+
   llvm::SMDiagnostic Error;
-  auto M = llvm::parseIR(Buffer, Error, Module->getContext());
+  auto M = llvm::parseIR(Input, Error, Module->getContext());
   std::string ErrorMessage;
   llvm::raw_string_ostream Stream(ErrorMessage);
   if (not M) {
@@ -324,6 +719,7 @@ llvm::Error LLVMContainer::deserialize(const llvm::MemoryBuffer &Buffer) {
   }
 
   Module = std::move(M);
+  Statistics.reset();
 
   return llvm::Error::success();
 }
@@ -160,8 +160,9 @@ Loader::parseInvocation(Step &Step,
     }
 
     revng_assert(Step.containers().containsOrCanCreate(ContainerName));
-    const auto &Container = *Step.containers().find(ContainerName);
-    PipelineContext->addReadOnlyContainer(RoleName, Container);
+    PipelineContext->addReadOnlyContainer(RoleName,
+                                          Step.containers(),
+                                          ContainerName);
   }
 
   return PipeWrapper(Pipe, Invocation.UsedContainers);
@@ -356,7 +357,7 @@ Loader::load(llvm::ArrayRef<PipelineDeclaration> Pipelines) const {
         }
       }
 
-      ToReturn.addAnalysesList(List.Name, Analyses);
+      ToReturn.addAnalysesList(List.Name, Analyses, List.DeferInvalidation);
     }
 
   return ToReturn;
@@ -0,0 +1,47 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <mutex>
+
+#include "revng/Pipeline/LocationInterner.h"
+
+using namespace pipeline;
+
+LocationInterner &LocationInterner::get() {
+  static LocationInterner Instance;
+  return Instance;
+}
+
+InternedLocation LocationInterner::intern(llvm::StringRef Serialized) {
+  if (InternedLocation Existing = find(Serialized); Existing.isValid())
+    return Existing;
+
+  std::unique_lock Lock(Mutex);
+  auto [It, New] = IDs.try_emplace(Serialized, Strings.size());
+  if (New) {
+    revng_check(Strings.size() < UINT32_MAX - 1, "Too many locations");
+    Strings.push_back(It->first());
+  }
+
+  return InternedLocation(It->second);
+}
+
+InternedLocation LocationInterner::find(llvm::StringRef Serialized) const {
+  std::shared_lock Lock(Mutex);
+  auto It = IDs.find(Serialized);
+  if (It == IDs.end())
+    return InternedLocation();
+  return InternedLocation(It->second);
+}
+
+llvm::StringRef LocationInterner::str(InternedLocation Location) const {
+  revng_assert(Location.isValid());
+  std::shared_lock Lock(Mutex);
+  return Strings.at(Location.id());
+}
+
+size_t LocationInterner::size() const {
+  std::shared_lock Lock(Mutex);
+  return Strings.size();
+}
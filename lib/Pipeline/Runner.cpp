@@ -5,6 +5,10 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+#include <optional>
+#include <utility>
+
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
@@ -12,12 +16,15 @@
 #include "llvm/Support/Progress.h"
 
 #include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
 #include "revng/Pipeline/Errors.h"
 #include "revng/Pipeline/GlobalTupleTreeDiff.h"
 #include "revng/Pipeline/Kind.h"
 #include "revng/Pipeline/Runner.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/Metrics.h"
+#include "revng/Support/Progress.h"
 #include "revng/TupleTree/TupleTreeReference.h"
 
 using namespace std;
@@ -26,6 +33,17 @@ using namespace pipeline;
 
 static Logger<> Log("invalidation");
 
+static revng::CounterFamily StepRuns("revng_pipeline_step_runs",
+                                     "Times each step has run",
+                                     "step");
+static revng::CounterFamily StepTargets("revng_pipeline_step_targets",
+                                        "Targets produced by each step",
+                                        "step");
+static revng::LatencyHistogramFamily
+  StepDuration("revng_pipeline_step_duration_seconds",
+               "Duration of the runs of each step",
+               "step");
+
 class PipelineExecutionEntry {
 public:
   Step *ToExecute;
@@ -108,6 +126,7 @@ static void explainPipeline(const ContainerToTargetsMap &Targets,
 }
 
 Error Runner::getInvalidations(TargetInStepSet &Invalidated) const {
+  AllTargetsMemo Memo(getContext());
 
   for (const Step &NextS : *this) {
     if (not NextS.hasPredecessor())
@@ -139,10 +158,10 @@ llvm::Error Runner::getInvalidations(const Target &Target,
                                      TargetInStepSet &Invalidations) const {
   for (const Step &Step : *this)
     for (const auto &Container : Step.containers()) {
-      if (Container.second == nullptr)
+      if (not Step.containers().contains(Container.first()))
         continue;
 
-      if (Container.second->enumerate().contains(Target)) {
+      if (Step.containers().enumerate(Container.first()).contains(Target)) {
         Invalidations[Step.getName()].add(Container.first(), Target);
       }
     }
@@ -199,7 +218,10 @@ Error PipelineFileMapping::store(Runner &LoadInto) const {
                                    "No known container " + Container);
   }
 
-  return LoadInto[Step].containers()[Container].store(Path);
+  // Storing does not change the container
+  ContainerSet &Containers = LoadInto[Step].containers();
+  Containers.instantiate(Container);
+  return std::as_const(Containers).at(Container).store(Path);
 }
 
 Error Runner::store(const revng::DirectoryPath &DirPath) const {
@@ -237,6 +259,47 @@ Error Runner::storeStepToDisk(llvm::StringRef StepName,
   return Error::success();
 }
 
+llvm::Expected<Runner::Snapshot>
+Runner::snapshot(const revng::DirectoryPath &DirPath) const {
+  Snapshot Result(DirPath);
+  revng::DirectoryPath Staging = Result.Memory->root();
+
+  for (const auto &StepName : Steps.keys()) {
+    const Step &Step = Steps.find(StepName)->second;
+    auto MaybeSnapshot = Step.snapshot(DirPath.getDirectory(StepName),
+                                       Staging.getDirectory(StepName));
+    if (not MaybeSnapshot)
+      return MaybeSnapshot.takeError();
+
+    Result.Steps.push_back(std::move(*MaybeSnapshot));
+  }
+
+  revng::DirectoryPath ContextDir = Staging.getDirectory("context");
+  if (auto Error = TheContext->store(ContextDir); Error)
+    return std::move(Error);
+
+  return Result;
+}
+
+void Runner::forgetStored() const {
+  for (const Step &Step : *this)
+    Step.containers().forgetStored();
+}
+
+Error Runner::Snapshot::store() const {
+  if (auto Error = Directory.create(); Error)
+    return Error;
+
+  if (auto Error = Memory->writeTo(Directory); Error)
+    return Error;
+
+  for (const ContainerSet::Snapshot &Step : Steps)
+    if (auto Error = Step.store(); Error)
+      return Error;
+
+  return Error::success();
+}
+
 Error Runner::load(const revng::DirectoryPath &DirPath) {
   revng::DirectoryPath ContextDir = DirPath.getDirectory("context");
   if (auto Error = TheContext->load(ContextDir); !!Error)
@@ -269,15 +332,11 @@ Runner::getWrittenFiles(const revng::DirectoryPath &DirPath) const {
   return Result;
 }
 
-llvm::Expected<DiffMap>
-Runner::runAnalysis(llvm::StringRef AnalysisName,
-                    llvm::StringRef StepName,
-                    const ContainerToTargetsMap &Targets,
-                    TargetInStepSet &InvalidationsMap,
-                    const llvm::StringMap<std::string> &Options) {
-
-  GlobalsMap Before = getContext().getGlobals();
-
+llvm::Error
+Runner::produceAndRunAnalysis(llvm::StringRef AnalysisName,
+                              llvm::StringRef StepName,
+                              const ContainerToTargetsMap &Targets,
+                              const llvm::StringMap<std::string> &Options) {
   auto MaybeStep = Steps.find(StepName);
 
   if (MaybeStep == Steps.end()) {
@@ -286,25 +345,34 @@ Runner::runAnalysis(llvm::StringRef AnalysisName,
                              StepName.str().c_str());
   }
 
-  Task T(3, "Analysis execution");
+  Task T(2, "Analysis execution");
   T.advance("Produce step " + StepName, true);
   if (llvm::Error Error = run(StepName, Targets))
-    return std::move(Error);
+    return Error;
 
   T.advance("Run analysis", true);
-  if (llvm::Error Error = MaybeStep->second.runAnalysis(AnalysisName,
-                                                        Targets,
-                                                        Options);
-      Error) {
+  return MaybeStep->second.runAnalysis(AnalysisName, Targets, Options);
+}
+
+llvm::Expected<DiffMap>
+Runner::runAnalysis(llvm::StringRef AnalysisName,
+                    llvm::StringRef StepName,
+                    const ContainerToTargetsMap &Targets,
+                    TargetInStepSet &InvalidationsMap,
+                    const llvm::StringMap<std::string> &Options) {
+  GlobalsMap Before = getContext().getGlobals();
+
+  if (llvm::Error Error = produceAndRunAnalysis(AnalysisName,
+                                                StepName,
+                                                Targets,
+                                                Options))
     return std::move(Error);
-  }
 
+  Task T(1, "Apply diff produced by the analysis");
   T.advance("Apply diff produced by the analysis", true);
-  const GlobalsMap &After = getContext().getGlobals();
-  DiffMap Map = Before.diff(After);
-  for (const auto &GlobalNameDiffPair : Map)
-    if (llvm::Error Error = apply(GlobalNameDiffPair.second, InvalidationsMap))
-      return std::move(Error);
+  DiffMap Map = Before.diff(getContext().getGlobals());
+  if (llvm::Error Error = apply(Map, InvalidationsMap))
+    return std::move(Error);
 
   return std::move(Map);
 }
@@ -314,10 +382,24 @@ llvm::Expected<DiffMap>
 Runner::runAnalyses(const AnalysesList &List,
                     TargetInStepSet &InvalidationsMap,
                     const llvm::StringMap<std::string> &Options) {
+  // The globals before the list, which the diff of the whole list is computed
+  // against, and before the current analysis, if invalidating after each one.
+  // They are the same snapshot for the first analysis.
   GlobalsMap Before = getContext().getGlobals();
+  std::optional<GlobalsMap> BeforeAnalysis;
+  bool Deferred = List.defersInvalidation();
+
+  // Diff the whole list and invalidate what it changed, at once
+  auto ApplyDeferred = [&]() -> llvm::Expected<DiffMap> {
+    DiffMap Map = Before.diff(getContext().getGlobals());
+    if (llvm::Error Error = apply(Map, InvalidationsMap))
+      return std::move(Error);
+    return std::move(Map);
+  };
 
   Task T(List.size() + 1, "Analysis list " + List.getName());
-  for (const AnalysisReference &Ref : List) {
+  bool AnyAnalysisRan = false;
+  for (auto [Index, Ref] : llvm::enumerate(List)) {
     T.advance(Ref.getAnalysisName(), true);
     const Step &Step = getStep(Ref.getStepName());
     const AnalysisWrapper &Analysis = Step.getAnalysis(Ref.getAnalysisName());
@@ -330,28 +412,64 @@ Runner::runAnalyses(const AnalysesList &List,
       }
     }
 
+    if (llvm::Error Error = produceAndRunAnalysis(Ref.getAnalysisName(),
+                                                  Step.getName(),
+                                                  Map,
+                                                  Options)) {
+      // The analyses that already ran have changed the globals: stop here,
+      // but let the caller know about what changed
+      if (Error.isA<CancelledError>() and AnyAnalysisRan) {
+        llvm::consumeError(std::move(Error));
+        break;
+      }
+
+      // Do not leave the changes of the previous analyses unaccounted for
+      if (Deferred and AnyAnalysisRan) {
+        if (auto MaybeMap = ApplyDeferred(); not MaybeMap)
+          return llvm::joinErrors(std::move(Error), MaybeMap.takeError());
+      }
+
+      return std::move(Error);
+    }
+    AnyAnalysisRan = true;
+
+    if (Deferred)
+      continue;
+
     TargetInStepSet NewInvalidationsMap;
-    auto Result = runAnalysis(Ref.getAnalysisName(),
-                              Step.getName(),
-                              Map,
-                              NewInvalidationsMap,
-                              Options);
-    if (not Result)
-      return Result.takeError();
+    const GlobalsMap &From = BeforeAnalysis ? *BeforeAnalysis : Before;
+    DiffMap Diff = From.diff(getContext().getGlobals());
+    if (llvm::Error Error = apply(Diff, NewInvalidationsMap))
+      return std::move(Error);
+
     for (auto &NewEntry : NewInvalidationsMap)
       InvalidationsMap[NewEntry.first()].merge(NewEntry.second);
+
+    // Snapshot the globals for the next analysis, if any
+    if (Index + 1 < List.size())
+      BeforeAnalysis = getContext().getGlobals();
   }
 
   T.advance("Computing analysis list diff", true);
-  const GlobalsMap &After = getContext().getGlobals();
-  return Before.diff(After);
+  if (Deferred)
+    return ApplyDeferred();
+
+  return Before.diff(getContext().getGlobals());
 }
 
 Error Runner::run(const State &ToProduce) {
   Task T(ToProduce.size(), "Multi-step pipeline run");
-  for (const auto &Request : ToProduce) {
-    T.advance(Request.first(), true);
-    if (llvm::Error Error = run(Request.first(), Request.second))
+
+  // Start from the last steps: producing their targets also produces the
+  // targets they need from the previous steps, so that what is requested from
+  // the latter might be already available by the time we get to them
+  for (Step *Step : llvm::reverse(ReversePostOrderIndexes)) {
+    auto It = ToProduce.find(Step->getName());
+    if (It == ToProduce.end())
+      continue;
+
+    T.advance(It->first(), true);
+    if (llvm::Error Error = run(It->first(), It->second))
       return Error;
   }
 
@@ -364,9 +482,11 @@ Error Runner::run(llvm::StringRef EndingStepName,
   vector<PipelineExecutionEntry> ToExec;
   revng_log(ExplanationLogger, "Running until step " << EndingStepName);
 
-  if (llvm::Error Error = getObjectives(*this, EndingStepName, Targets, ToExec);
-      Error)
-    return Error;
+  {
+    AllTargetsMemo Memo(getContext());
+    if (auto Error = getObjectives(*this, EndingStepName, Targets, ToExec))
+      return Error;
+  }
 
   explainPipeline(Targets, ToExec);
 
@@ -381,20 +501,49 @@ Error Runner::run(llvm::StringRef EndingStepName,
                                                 + Step.getName() + ":");
   }
 
+  // Let the storage fetch what the steps are going to read while the previous
+  // ones run
+  for (PipelineExecutionEntry &StepGoalsPairs : llvm::drop_begin(ToExec)) {
+    const ::Step &Parent = StepGoalsPairs.ToExecute->getPredecessor();
+    Parent.containers().prefetch(StepGoalsPairs.Input);
+  }
+
   Task T(ToExec.size() - 1, "Produce steps required up to " + EndingStepName);
   for (PipelineExecutionEntry &StepGoalsPairs : llvm::drop_begin(ToExec)) {
     auto &[Step, PredictedOutput, Input, PipesInfo] = StepGoalsPairs;
     T.advance(Step->getName(), true);
 
+    // The steps that have already run are complete and can be kept
+    if (getContext().isCancellationRequested())
+      return llvm::make_error<CancelledError>();
+
     Task T2(3, "Run step");
     T2.advance("Clone and filter input containers", true);
 
     ::Step &Parent = Step->getPredecessor();
-    ContainerSet CurrentContainer = Parent.containers().cloneFiltered(Input);
+    ContainerSet CurrentContainer = [&]() {
+      revng::TracePeakRSSDelta RSSDelta;
+      ContainerSet Result = Parent.containers().cloneFiltered(Input);
+      revng::addTraceArgument("cloned-targets", Input.targetsCount());
+      return Result;
+    }();
 
     // Run the step
     T2.advance("Run the step", true);
-    Step->run(std::move(CurrentContainer), PipesInfo);
+    {
+      revng::TracePeakRSSDelta RSSDelta;
+      auto Start = std::chrono::steady_clock::now();
+      if (auto Error = Step->run(std::move(CurrentContainer), PipesInfo))
+        return Error;
+      revng::addTraceArgument("predicted-targets",
+                              PredictedOutput.targetsCount());
+
+      using namespace std::chrono;
+      duration<double> Duration = steady_clock::now() - Start;
+      StepRuns.increment(Step->getName());
+      StepTargets.increment(Step->getName(), PredictedOutput.targetsCount());
+      StepDuration.record(Step->getName(), Duration.count());
+    }
 
     T2.advance("Extract the requested targets", true);
     if (VerifyLog.isEnabled()) {
@@ -442,6 +591,7 @@ void Runner::getCurrentState(State &Out) const {
 }
 
 void Runner::deduceAllPossibleTargets(State &Out) const {
+  AllTargetsMemo Memo(getContext());
   getCurrentState(Out);
 
   for (const auto &NextStep : *this) {
@@ -459,6 +609,11 @@ const KindsRegistry &Runner::getKindsRegistry() const {
 
 void Runner::getDiffInvalidations(const GlobalTupleTreeDiff &Diff,
                                   TargetInStepSet &Map) const {
+  auto Paths = Diff.getPaths();
+  revng_log(Log, Paths.size() << " paths have changed");
+  if (Log.isEnabled())
+    for (const TupleTreePath *Path : Paths)
+      revng_log(Log, "Processing " << *Diff.pathAsString(*Path));
 
   // Iterate over each step, skipping the begin step
   for (const Step &Step : llvm::drop_begin(*this)) {
@@ -476,13 +631,16 @@ void Runner::getDiffInvalidations(const GlobalTupleTreeDiff &Diff,
     std::set<std::string> Mutablecontainers = Step.mutableContainers();
 
     for (const auto &Container : Step.containers()) {
+      // Nothing has changed, not even what the untracked targets might read
+      if (Paths.empty())
+        break;
 
-      if (not Container.second)
+      if (not Step.containers().contains(Container.first()))
         continue;
 
-      if (not Mutablecontainers.contains(Container.second->name())) {
+      if (not Mutablecontainers.contains(Container.first().str())) {
         revng_log(Log,
-                  Container.second->name()
+                  Container.first().str()
                     << " is not mutable in step " << Step.getName());
         continue;
       }
@@ -493,28 +651,22 @@ void Runner::getDiffInvalidations(const GlobalTupleTreeDiff &Diff,
 
       // Look for targets that are not recorded in the invalidation map and mark
       // them to be deleted
-      const TargetsList &ExistingTargets = Container.second->enumerate();
-      for (const Target &Target : ExistingTargets) {
-
-        TargetInContainer ToFind(Target, Container.first().str());
-        if (Step.invalidationMetadataContains(Diff.getGlobalName(), ToFind))
-          continue;
-
-        revng_log(Log, "Invalidating " << Target.serialize());
-        StepInvalidations[Container.first()].push_back(Target);
-      }
+      TargetsList ExistingTargets = Step.containers()
+                                      .enumerate(Container.first());
+      TargetsList Untracked = Step.untrackedTargets(Diff.getGlobalName(),
+                                                    Container.first(),
+                                                    ExistingTargets);
+      if (Log.isEnabled())
+        for (const Target &Target : Untracked)
+          revng_log(Log, "Invalidating " << Target.serialize());
+      StepInvalidations[Container.first()].merge(Untracked);
     }
 
     // Compute the set of things we need to invalidate by looking at all the
     // paths changed by Diff.
     // Also, this will invalidate all the targets depending on them and all the
     // targets depending on stuff that's already in Map.
-    revng_log(Log, Diff.getPaths().size() << " paths have changed");
-    for (const TupleTreePath *Path : Diff.getPaths()) {
-      revng_log(Log, "Processing " << *Diff.pathAsString(*Path));
-      LoggerIndent<> Indent(Log);
-      Step.registerTargetsDependingOn(Diff.getGlobalName(), *Path, Map, Log);
-    }
+    Step.registerTargetsDependingOn(Diff.getGlobalName(), Paths, Map, Log);
   }
 }
 
@@ -526,3 +678,82 @@ llvm::Error Runner::apply(const GlobalTupleTreeDiff &Diff,
 
   return invalidate(Map);
 }
+
+llvm::Error Runner::apply(const DiffMap &Diffs, TargetInStepSet &Map) {
+  for (const auto &GlobalNameDiffPair : Diffs)
+    getDiffInvalidations(GlobalNameDiffPair.second, Map);
+
+  if (auto Error = getInvalidations(Map); Error)
+    return Error;
+
+  return invalidate(Map);
+}
+
+llvm::Expected<std::vector<llvm::Error>>
+Runner::applyDiffs(llvm::ArrayRef<GlobalTupleTreeDiff> Diffs,
+                   TargetInStepSet &Map) {
+  GlobalsMap &Globals = TheContext->getGlobals();
+  std::vector<llvm::Error> Results;
+
+  // The copies of the globals the diffs are applied to, and the merge of the
+  // diffs that have been applied to each of them
+  llvm::StringMap<std::unique_ptr<Global>> Copies;
+  DiffMap Applied;
+
+  Task T(Diffs.size() + 1, "Apply diffs");
+  for (const GlobalTupleTreeDiff &Diff : Diffs) {
+    T.advance(Diff.getGlobalName(), false);
+    auto MaybeGlobal = Globals.get(Diff.getGlobalName());
+    if (not MaybeGlobal) {
+      Results.push_back(MaybeGlobal.takeError());
+      continue;
+    }
+
+    std::unique_ptr<Global> &Copy = Copies[Diff.getGlobalName()];
+    if (Copy == nullptr)
+      Copy = (*MaybeGlobal)->clone();
+
+    auto It = Applied.find(Diff.getGlobalName());
+    if (llvm::Error Error = Copy->applyDiff(Diff)) {
+      // A diff might have been applied in part: start over from the diffs
+      // that applied successfully
+      Copy = (*MaybeGlobal)->clone();
+      if (It != Applied.end())
+        llvm::cantFail(Copy->applyDiff(It->second));
+
+      Results.push_back(std::move(Error));
+      continue;
+    }
+
+    if (It != Applied.end())
+      It->second.append(Diff);
+    else
+      Applied.try_emplace(Diff.getGlobalName(), Diff);
+    Results.push_back(llvm::Error::success());
+  }
+
+  T.advance("Invalidate", true);
+  for (const auto &Entry : Applied) {
+    // The globals were valid, only what the diffs have touched needs to be
+    // verified again
+    if (not Copies[Entry.first()]->verify(Entry.second)) {
+      for (llvm::Error &Error : Results)
+        llvm::consumeError(std::move(Error));
+
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "could not verify %s",
+                                     Entry.first().str().c_str());
+    }
+  }
+
+  for (const auto &Entry : Applied)
+    *cantFail(Globals.get(Entry.first())) = *Copies[Entry.first()];
+
+  if (llvm::Error Error = apply(Applied, Map)) {
+    for (llvm::Error &Result : Results)
+      llvm::consumeError(std::move(Result));
+    return std::move(Error);
+  }
+
+  return std::move(Results);
+}
@@ -6,6 +6,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
@@ -15,208 +17,24 @@
 #include "revng/Pipeline/ContainerSet.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/Errors.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
 #include "revng/Pipeline/Step.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
+#include "revng/Support/Progress.h"
 
 using namespace llvm;
 using namespace std;
 using namespace pipeline;
 
-namespace pipeline {
-
-class TargetInPipe {
-public:
-  std::string SerializedTarget;
-  std::string PipeName;
-
-  llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
-  deserialize(const Context &Ctx, llvm::StringRef ContainerName) const;
-
-  static TargetInPipe fromTargetInContainer(const TargetInContainer &Target,
-                                            llvm::StringRef PipeName);
-  bool operator<(const TargetInPipe &Other) const {
-    const auto &Tied = std::tie(SerializedTarget, PipeName);
-    return Tied < std::tie(Other.SerializedTarget, Other.PipeName);
-  }
-};
-
-class ContainerInvalidationMetadata {
-public:
-  using ValueType = std::pair<pipeline::TargetInPipe, std::vector<std::string>>;
-  using Vector = std::vector<ValueType>;
-  Vector Data;
-
-  void merge(ContainerInvalidationMetadata &&Other) {
-    for (ValueType &Entry : Other.Data)
-      Data.emplace_back(std::move(Entry));
-  }
-
-public:
-  llvm::Expected<PathTargetBimap>
-  deserialize(const Context &Ctx,
-              const Global &Primitives,
-              llvm::StringRef PipeName,
-              llvm::StringRef ContainerName) const;
-
-  static ContainerInvalidationMetadata serialize(const PathTargetBimap &Map,
-                                                 const Global &Primitives,
-                                                 llvm::StringRef PipeName,
-                                                 llvm::StringRef ContainerName);
-};
-
-class NamedPathTargetBimapVector {
-public:
-  std::string GlobalName;
-  ContainerInvalidationMetadata Map;
-};
-} // namespace pipeline
-
-LLVM_YAML_IS_SEQUENCE_VECTOR(ContainerInvalidationMetadata::ValueType);
-
-namespace llvm {
-namespace yaml {
-
-// YAML traits for TargetInContainer
-template<>
-struct MappingTraits<pipeline::TargetInPipe> {
-  static void mapping(IO &IO, pipeline::TargetInPipe &TargetInContainer) {
-    IO.mapRequired("Target", TargetInContainer.SerializedTarget);
-    IO.mapRequired("PipeName", TargetInContainer.PipeName);
-  }
-};
-
-template<>
-struct MappingTraits<pipeline::ContainerInvalidationMetadata> {
-  static void mapping(IO &Io,
-                      pipeline::ContainerInvalidationMetadata &TargetMap) {
-    Io.mapRequired("Map", TargetMap.Data);
-  }
-};
-
-template<>
-struct MappingTraits<ContainerInvalidationMetadata::Vector::value_type> {
-  static void
-  mapping(IO &Io,
-          pipeline::ContainerInvalidationMetadata::Vector::value_type
-            &TargetMap) {
-    Io.mapRequired("Target", TargetMap.first.SerializedTarget);
-    Io.mapRequired("PipeName", TargetMap.first.PipeName);
-    Io.mapRequired("ReadPaths", TargetMap.second);
-  }
-};
-
-} // namespace yaml
-} // namespace llvm
-
-LLVM_YAML_IS_SEQUENCE_VECTOR(pipeline::NamedPathTargetBimapVector);
-
-namespace llvm {
-namespace yaml {
-template<>
-struct MappingTraits<pipeline::NamedPathTargetBimapVector> {
-  static void mapping(IO &Io, pipeline::NamedPathTargetBimapVector &TargetMap) {
-    Io.mapRequired("GlobalName", TargetMap.GlobalName);
-    Io.mapRequired("Map", TargetMap.Map.Data);
-  }
-};
-} // namespace yaml
-} // namespace llvm
-
-llvm::Expected<llvm::SmallVector<TargetInContainer, 2>>
-TargetInPipe::deserialize(const Context &Ctx,
-                          llvm::StringRef ContainerName) const {
-  TargetsList Targets;
-  llvm::Error Error = parseTarget(Ctx,
-                                  SerializedTarget,
-                                  Ctx.getKindsRegistry(),
-                                  Targets);
-  if (Error)
-    return std::move(Error);
-
-  llvm::SmallVector<TargetInContainer, 2> Return;
-  for (const Target &Target : Targets) {
-    Return.emplace_back(std::move(Target), ContainerName.str());
-  }
-  return Return;
-}
-
-TargetInPipe
-TargetInPipe::fromTargetInContainer(const TargetInContainer &Target,
-                                    llvm::StringRef PipeName) {
-  TargetInPipe ToReturn;
-  ToReturn.PipeName = PipeName;
-  ToReturn.SerializedTarget = Target.getTarget().serialize();
-
-  return ToReturn;
-}
-
-ContainerInvalidationMetadata
-ContainerInvalidationMetadata::serialize(const PathTargetBimap &Map,
-                                         const Global &Global,
-                                         llvm::StringRef PipeName,
-                                         llvm::StringRef ContainerName) {
-  ContainerInvalidationMetadata ToSerialize;
-  std::map<pipeline::TargetInPipe, std::vector<std::string>> TemporaryMap;
-
-  for (const auto &Content : Map) {
-    for (const TargetInContainer &Entry : Content.second) {
-      if (Entry.getContainerName() != ContainerName)
-        continue;
-
-      std::optional<std::string> AsString = Global.serializePath(Content.first);
-      revng_check(AsString.has_value());
-      TemporaryMap[TargetInPipe::fromTargetInContainer(Entry, PipeName)]
-        .push_back(*AsString);
-    }
-  }
-
-  for (const auto &Content : TemporaryMap) {
-    std::pair ToEmplace{ Content.first, Content.second };
-    ToSerialize.Data.emplace_back(std::move(ToEmplace));
-  }
-
-  return ToSerialize;
-}
-
-llvm::Expected<PathTargetBimap>
-ContainerInvalidationMetadata::deserialize(const Context &Ctx,
-                                           const Global &Global,
-                                           llvm::StringRef PipeName,
-                                           llvm::StringRef ContainerName)
-  const {
-
-  PathTargetBimap ToReturn;
-  for (const ValueType &Entry : Data) {
-    if (Entry.first.PipeName != PipeName) {
-      continue;
-    }
-
-    llvm::Expected<SmallVector<TargetInContainer>>
-      MaybeTarget = Entry.first.deserialize(Ctx, ContainerName);
-
-    if (not MaybeTarget) {
-      return MaybeTarget.takeError();
-    }
-
-    for (auto &SerializedPath : Entry.second) {
-      std::optional<TupleTreePath>
-        MaybeParsedPath = Global.deserializePath(SerializedPath);
-
-      if (not MaybeParsedPath) {
-        return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                       "could not parse " + SerializedPath);
-      }
-
-      for (const TargetInContainer &Path : *MaybeTarget) {
-        ToReturn.insert(std::move(Path), std::move(*MaybeParsedPath));
-      }
-    }
-  }
-
-  return ToReturn;
-}
+static cl::opt<bool> YAMLInvalidationMetadata("yaml-invalidation-metadata",
+                                              cl::desc("Store the invalidation "
+                                                       "metadata of steps in "
+                                                       "YAML instead of the "
+                                                       "binary format, for "
+                                                       "debugging purposes"),
+                                              cl::init(false));
 
 std::pair<ContainerToTargetsMap, std::vector<PipeExecutionEntry>>
 Step::analyzeGoals(const ContainerToTargetsMap &RequiredGoals) const {
@@ -276,29 +94,70 @@ void Step::explainExecutedPipe(const InvokableWrapperBase &Wrapper,
   ExplanationLogger << DoLog;
 }
 
-ContainerSet Step::run(ContainerSet &&Input,
-                       const std::vector<PipeExecutionEntry> &ExecutionInfos) {
+llvm::Error Step::run(ContainerSet &&Input,
+                      const std::vector<PipeExecutionEntry> &ExecutionInfos) {
   ContainerToTargetsMap InputEnumeration = Input.enumerate();
   explainStartStep(InputEnumeration);
 
   Task T(Pipes.size() + 1, "Step " + getName());
   for (const auto &[Pipe, Info] : llvm::zip(Pipes, ExecutionInfos)) {
     T.advance(Pipe.Pipe->getName(), false);
+
+    // Input is a copy, dropping it leaves the step as it was
+    if (Ctx->isCancellationRequested())
+      return llvm::make_error<CancelledError>();
+
+    // None of the pipes after this one in the step need its output
+    if (Info.Skippable) {
+      ExplanationLogger << "Skipping " << Pipe.Pipe->getName() << " in step "
+                        << getName() << ": no requested targets" << DoLog;
+      continue;
+    }
+
     explainExecutedPipe(*Pipe.Pipe);
+    revng::TracePeakRSSDelta RSSDelta;
     ExecutionContext Context(*Ctx, &Pipe, Info.Output);
 
     Pipe.Pipe->deduceResults(*Ctx, Context.getCurrentRequestedTargets());
 
     cantFail(Pipe.Pipe->run(Context, Input));
     llvm::cantFail(Input.verify());
+
+    if (revng::isTracingTasks()) {
+      const auto &Requested = Context.getCurrentRequestedTargets();
+      revng::addTraceArgument("requested-targets", Requested.targetsCount());
+      revng::addTraceArgument("commits", Context.getCommitsCount());
+      revng::addTraceArgument("commits-us",
+                              Context.getCommitsDuration().count());
+    }
+
+    // Nothing has been recorded about what the pipe has read: forget what a
+    // precise run recorded about the same targets, so that any change to a
+    // global invalidates them
+    if (not Ctx->isTrackingReadFields())
+      dropInvalidationMetadata(Context.getCurrentRequestedTargets());
   }
 
+  // The last pipe might have stopped halfway through
+  if (Ctx->isCancellationRequested())
+    return llvm::make_error<CancelledError>();
+
   T.advance("Merging back", true);
-  explainEndStep(Input.enumerate());
+  revng::TracePeakRSSDelta RSSDelta;
+  ContainerToTargetsMap OutputEnumeration = Input.enumerate();
+  explainEndStep(OutputEnumeration);
   Containers.mergeBack(std::move(Input));
-  InputEnumeration = deduceResults(InputEnumeration);
-  ContainerSet Cloned = Containers.cloneFiltered(InputEnumeration);
-  return Cloned;
+  revng::addTraceArgument("merged-targets", OutputEnumeration.targetsCount());
+  return llvm::Error::success();
+}
+
+void Step::dropInvalidationMetadata(const ContainerToTargetsMap &Targets) {
+  for (PipeWrapper &Pipe : Pipes) {
+    for (auto &Global : Pipe.InvalidationMetadata.getPathCache()) {
+      for (const auto &Pair : Targets)
+        Global.second.remove(Pair.second, Pair.first());
+    }
+  }
 }
 
 void Step::pipeInvalidate(const GlobalTupleTreeDiff &Diff,
@@ -331,16 +190,10 @@ llvm::Error Step::runAnalysis(llvm::StringRef AnalysisName,
 void Step::removeSatisfiedGoals(TargetsList &RequiredInputs,
                                 const ContainerBase &CachedSymbols,
                                 TargetsList &ToLoad) {
-  const TargetsList EnumeratedSymbols = CachedSymbols.enumerate();
-  const auto IsCached = [&ToLoad,
-                         &EnumeratedSymbols](const Target &Target) -> bool {
-    bool MustBeLoaded = EnumeratedSymbols.contains(Target);
-    if (MustBeLoaded)
-      ToLoad.emplace_back(Target);
-    return MustBeLoaded;
-  };
-
-  llvm::erase_if(RequiredInputs, IsCached);
+  // All the lists are sorted, so this is linear in their size
+  TargetsList Cached = RequiredInputs.intersect(CachedSymbols.enumerate());
+  RequiredInputs.remove(Cached);
+  ToLoad.merge(std::move(Cached));
 }
 
 void Step::removeSatisfiedGoals(ContainerToTargetsMap &Targets,
@@ -376,6 +229,19 @@ Error Step::store(const revng::DirectoryPath &DirPath) const {
   return storeInvalidationMetadata(DirPath);
 }
 
+llvm::Expected<ContainerSet::Snapshot>
+Step::snapshot(const revng::DirectoryPath &DirPath,
+               const revng::DirectoryPath &Staging) const {
+  auto MaybeSnapshot = Containers.snapshot(DirPath, Staging);
+  if (not MaybeSnapshot)
+    return MaybeSnapshot.takeError();
+
+  if (auto Error = storeInvalidationMetadata(Staging))
+    return std::move(Error);
+
+  return MaybeSnapshot;
+}
+
 Error Step::checkPrecondition() const {
   for (const PipeWrapper &Pipe : Pipes) {
     if (llvm::Error Error = Pipe.Pipe->checkPrecondition(*Ctx); Error) {
@@ -395,16 +261,15 @@ Error Step::load(const revng::DirectoryPath &DirPath) {
   if (not MaybeBool.get())
     return llvm::Error::success();
 
-  if (auto Error = Containers.load(DirPath))
+  if (auto Error = Containers.load(*Ctx, DirPath))
     return Error;
 
   return loadInvalidationMetadata(DirPath);
 }
 
 llvm::Error
-Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
-                                   ContainerSet::value_type &Container) {
-  auto FilePath = Path.getFile(Container.first().str() + ".cache");
+Step::loadInvalidationMetadataImpl(const revng::FilePath &FilePath,
+                                   llvm::StringRef ContainerName) {
   auto MaybeBool = FilePath.exists();
   if (not MaybeBool)
     return MaybeBool.takeError();
@@ -416,18 +281,21 @@ Step::loadInvalidationMetadataImpl(const revng::DirectoryPath &Path,
   if (not File)
     return File.takeError();
 
-  using Type = llvm::SmallVector<NamedPathTargetBimapVector, 2>;
-  auto Parsed = ::deserialize<Type>(File.get()->buffer().getBuffer());
+  auto Parsed = parseInvalidationMetadata(File.get()->buffer().getBuffer());
   if (not Parsed)
     return Parsed.takeError();
 
+  // Paths are shared by many targets and pipes, parse each of them only once
+  std::vector<llvm::StringMap<TupleTreePath>> ParsedPaths(Parsed->size());
+
   for (PipeWrapper &Pipe : Pipes) {
-    for (NamedPathTargetBimapVector &Entry : *Parsed) {
+    for (auto &&[Entry, Cache] : llvm::zip(*Parsed, ParsedPaths)) {
       Global *Global = llvm::cantFail(Ctx->getGlobals().get(Entry.GlobalName));
       auto Parsed(Entry.Map.deserialize(*Ctx,
                                         *Global,
                                         Pipe.Pipe->getName(),
-                                        Container.first()));
+                                        ContainerName,
+                                        Cache));
       if (not Parsed)
         return Parsed.takeError();
       Pipe.InvalidationMetadata.getPathCache(Global->getName())
@@ -443,7 +311,8 @@ llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path) {
     Pipe.InvalidationMetadata = {};
   }
   for (auto &Container : Containers) {
-    if (llvm::Error Error = loadInvalidationMetadataImpl(Path, Container))
+    auto File = Path.getFile(Container.first().str() + ".cache");
+    if (auto Error = loadInvalidationMetadataImpl(File, Container.first()))
       return Error;
   }
 
@@ -453,45 +322,77 @@ llvm::Error Step::loadInvalidationMetadata(const revng::DirectoryPath &Path) {
 llvm::Error
 Step::storeInvalidationMetadata(const revng::DirectoryPath &Path) const {
   for (auto &Container : Containers) {
-    if (Container.second == nullptr)
+    if (not Containers.contains(Container.first()))
       continue;
 
-    using Type = llvm::SmallVector<NamedPathTargetBimapVector, 2>;
-    Type ToStore = {};
-
-    for (const Global *Global : Ctx->getGlobals()) {
-      NamedPathTargetBimapVector Entry;
-      Entry.GlobalName = Global->getName();
-
-      for (const PipeWrapper &Pipe : Pipes) {
-        auto &PathCache = Pipe.InvalidationMetadata.getPathCache();
-        if (PathCache.count(Entry.GlobalName) == 0)
-          continue;
-
-        using MetadataType = ContainerInvalidationMetadata;
-        auto Serialize = MetadataType::serialize;
-        MetadataType Serialized = Serialize(Pipe.InvalidationMetadata
-                                              .getPathCache(Entry.GlobalName),
-                                            *Global,
-                                            Pipe.Pipe->getName(),
-                                            Container.first());
-        Entry.Map.merge(std::move(Serialized));
-      }
-      ToStore.emplace_back(std::move(Entry));
-    }
-
-    auto File = Path.getFile(Container.first().str() + ".cache")
-                  .getWritableFile();
-    if (not File)
-      return File.takeError();
-    ::serialize(File->get()->os(), ToStore);
-    if (auto Error = File->get()->commit())
+    auto File = Path.getFile(Container.first().str() + ".cache");
+    if (auto Error = storeInvalidationMetadataImpl(File,
+                                                   Container.first(),
+                                                   nullptr))
       return Error;
   }
 
   return llvm::Error::success();
 }
 
+llvm::Error Step::storeInvalidationMetadata(const revng::FilePath &File,
+                                            llvm::StringRef ContainerName,
+                                            const TargetsList &Targets) const {
+  return storeInvalidationMetadataImpl(File, ContainerName, &Targets);
+}
+
+llvm::Error Step::replaceInvalidationMetadata(const revng::FilePath &File,
+                                              llvm::StringRef ContainerName,
+                                              const TargetsList &Targets) {
+  ContainerToTargetsMap ToDrop;
+  ToDrop[ContainerName] = Targets;
+  dropInvalidationMetadata(ToDrop);
+  return loadInvalidationMetadataImpl(File, ContainerName);
+}
+
+llvm::Error
+Step::storeInvalidationMetadataImpl(const revng::FilePath &File,
+                                    llvm::StringRef ContainerName,
+                                    const TargetsList *Only) const {
+  InvalidationMetadataVector ToStore = {};
+
+  for (const Global *Global : Ctx->getGlobals()) {
+    NamedPathTargetBimapVector Entry;
+    Entry.GlobalName = Global->getName();
+
+    for (const PipeWrapper &Pipe : Pipes) {
+      auto &PathCache = Pipe.InvalidationMetadata.getPathCache();
+      auto It = PathCache.find(Entry.GlobalName);
+      if (It == PathCache.end())
+        continue;
+
+      using MetadataType = ContainerInvalidationMetadata;
+      auto Serialize = [&](const PathTargetBimap &Map) {
+        return MetadataType::serialize(Map,
+                                       *Global,
+                                       Pipe.Pipe->getName(),
+                                       ContainerName);
+      };
+
+      if (Only != nullptr)
+        Entry.Map.merge(Serialize(It->second.extract(*Only, ContainerName)));
+      else
+        Entry.Map.merge(Serialize(It->second));
+    }
+    ToStore.emplace_back(std::move(Entry));
+  }
+
+  auto MaybeFile = File.getWritableFile();
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+  if (YAMLInvalidationMetadata)
+    writeYAMLInvalidationMetadata(MaybeFile->get()->os(), ToStore);
+  else
+    writeBinaryInvalidationMetadata(MaybeFile->get()->os(), ToStore);
+
+  return MaybeFile->get()->commit();
+}
+
 std::vector<revng::FilePath>
 Step::getWrittenFiles(const revng::DirectoryPath &DirPath) const {
   std::vector<revng::FilePath> Result = Containers.getWrittenFiles(DirPath);
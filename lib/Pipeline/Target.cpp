@@ -8,6 +8,7 @@
 
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/xxhash.h"
 
 #include "revng/Pipeline/Container.h"
 #include "revng/Pipeline/Context.h"
@@ -21,13 +22,50 @@ using namespace std;
 using namespace llvm;
 
 bool TargetsList::contains(const Target &Target) const {
-  return find(*this, Target) != end();
+  return std::binary_search(begin(), end(), Target);
 }
 
 void TargetsList::merge(const TargetsList &Source) {
-  copy(Source, back_inserter(Contained));
-  llvm::sort(Contained);
-  Contained.erase(unique(Contained.begin(), Contained.end()), Contained.end());
+  if (Source.empty())
+    return;
+
+  if (Contained.empty()) {
+    Contained = Source.Contained;
+    return;
+  }
+
+  // Both lists are sorted and without duplicates
+  List Merged;
+  Merged.reserve(Contained.size() + Source.size());
+  std::set_union(Contained.begin(),
+                 Contained.end(),
+                 Source.begin(),
+                 Source.end(),
+                 back_inserter(Merged));
+  Contained = std::move(Merged);
+}
+
+void TargetsList::merge(TargetsList &&Source) {
+  if (Contained.empty()) {
+    Contained = std::move(Source.Contained);
+    return;
+  }
+
+  merge(Source);
+}
+
+void TargetsList::remove(const TargetsList &Other) {
+  if (Other.empty() or Contained.empty())
+    return;
+
+  List Remaining;
+  Remaining.reserve(Contained.size());
+  std::set_difference(Contained.begin(),
+                      Contained.end(),
+                      Other.begin(),
+                      Other.end(),
+                      back_inserter(Remaining));
+  Contained = std::move(Remaining);
 }
 
 void ContainerToTargetsMap::erase(const ContainerToTargetsMap &Other) {
@@ -36,10 +74,7 @@ void ContainerToTargetsMap::erase(const ContainerToTargetsMap &Other) {
     const auto &ContainerSymbols = Container.second;
     if (Status.find(ContainerName) == Status.end())
       continue;
-    auto &ToRemoveFrom = Status[ContainerName];
-
-    for (auto &Symbol : ContainerSymbols)
-      ToRemoveFrom.erase(Symbol);
+    Status[ContainerName].remove(ContainerSymbols);
   }
 }
 
@@ -169,3 +204,17 @@ llvm::Error pipeline::parseTarget(const Context &Ctx,
 
   return parseTarget(Ctx, Parts[1], Dict, CurrentStatus[Parts[0]]);
 }
+
+TargetsList pipeline::selectShard(const TargetsList &Targets,
+                                  unsigned Shard,
+                                  unsigned ShardCount) {
+  revng_assert(Shard < ShardCount);
+
+  // Target::hash is not stable across processes, hash the serialized form
+  TargetsList Result;
+  for (const Target &Target : Targets)
+    if (xxHash64(Target.serialize()) % ShardCount == Shard)
+      Result.push_back(Target);
+
+  return Result;
+}
@@ -30,6 +30,7 @@
 #include "revng/Pipes/PipelineManager.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/InitRevng.h"
+#include "revng/Support/Metrics.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
 
 #include "Tracing/Wrapper.h"
@@ -98,8 +99,8 @@ static void llvmErrorToRpError(llvm::Error Error, rp_error *Out) {
                         OtherErrorHandler);
 }
 
-void revng::tracing::setTracing(llvm::raw_ostream *OS) {
-  Tracing.swap(OS);
+void revng::tracing::setTracing(llvm::raw_ostream *OS, TraceFormat Format) {
+  Tracing.swap(OS, Format);
 }
 
 /// Used when we want to return a stack allocated string. Copies the string onto
@@ -241,6 +242,33 @@ static bool _rp_manager_save(rp_manager *manager) {
   return false;
 }
 
+static bool _rp_manager_save_async(rp_manager *manager) {
+  revng_check(manager != nullptr);
+
+  auto Error = manager->storeAsync();
+  if (not Error)
+    return true;
+
+  llvm::consumeError(std::move(Error));
+  return false;
+}
+
+static bool _rp_manager_is_saving(rp_manager *manager) {
+  revng_check(manager != nullptr);
+  return manager->isSaving();
+}
+
+static bool _rp_manager_wait_save(rp_manager *manager) {
+  revng_check(manager != nullptr);
+
+  auto Error = manager->waitForSave();
+  if (not Error)
+    return true;
+
+  llvm::consumeError(std::move(Error));
+  return false;
+}
+
 static void _rp_manager_destroy(rp_manager *manager) {
   revng_check(manager != nullptr);
   delete manager;
@@ -259,13 +287,18 @@ _rp_step_get_container(rp_step *step, rp_container_identifier *container) {
   revng_check(container != nullptr);
 
   if (step->containers().isContainerRegistered(container->first())) {
-    step->containers()[container->first()];
+    step->containers().instantiate(container->first());
     return &*step->containers().find(container->first());
   } else {
     return nullptr;
   }
 }
 
+static uint64_t _rp_step_get_memory_usage(const rp_step *step) {
+  revng_check(step != nullptr);
+  return step->containers().memoryUsage();
+}
+
 static uint64_t
 _rp_targets_list_targets_count(const rp_targets_list *targets_list) {
   revng_check(targets_list != nullptr);
@@ -357,12 +390,68 @@ static rp_buffer *_rp_manager_produce_targets(rp_manager *manager,
 
   auto &Cloned = ErrorOrCloned.get();
   rp_buffer *Out = new rp_buffer();
-  llvm::raw_svector_ostream Serialized(*Out);
+  llvm::raw_svector_ostream Serialized(Out->storage());
   llvm::cantFail(Cloned->serialize(Serialized));
 
   return Out;
 }
 
+static rp_async_request *
+_rp_manager_produce_targets_async(rp_manager *manager,
+                                  const rp_step *step,
+                                  const rp_container *container,
+                                  uint64_t targets_count,
+                                  rp_target *targets[]) {
+  revng_check(manager != nullptr);
+  revng_check(step != nullptr);
+  revng_check(container != nullptr);
+  revng_check(targets_count != 0);
+  revng_check(targets != nullptr);
+
+  TargetsList List;
+  for (size_t I = 0; I < targets_count; I++)
+    List.push_back(*targets[I]);
+
+  auto *Result = new rp_async_request();
+  auto Produce = [manager,
+                  step,
+                  container,
+                  List = std::move(List),
+                  Result]() -> llvm::Error {
+    auto MaybeCloned = manager->produceTargets(step->getName(),
+                                               *container,
+                                               List);
+    if (not MaybeCloned)
+      return MaybeCloned.takeError();
+
+    auto Out = std::make_unique<rp_buffer>();
+    llvm::raw_svector_ostream Serialized(Out->storage());
+    llvm::cantFail((*MaybeCloned)->serialize(Serialized));
+    Result->Buffer = std::move(Out);
+    return llvm::Error::success();
+  };
+  Result->Request = manager->runAsync(std::move(Produce));
+
+  return Result;
+}
+
+static bool _rp_manager_produce_batch(rp_manager *manager,
+                                      rp_production_batch *batch,
+                                      rp_error *error) {
+  revng_check(manager != nullptr);
+  revng_check(batch != nullptr);
+
+  batch->Results.clear();
+  auto MaybeResults = manager->produceTargets(batch->Requests);
+  if (!MaybeResults) {
+    llvmErrorToRpError(MaybeResults.takeError(), error);
+    return false;
+  }
+
+  batch->Results = std::move(*MaybeResults);
+  return true;
+}
+
 static rp_target *_rp_target_create(const rp_kind *kind,
                                     uint64_t path_components_count,
                                     const char *path_components[]) {
@@ -452,6 +541,14 @@ static void _rp_string_destroy(char *string) {
   free(string);
 }
 
+static char *_rp_get_metrics() {
+  std::string Out;
+  llvm::raw_string_ostream Stream(Out);
+  revng::writeOpenMetrics(Stream);
+  Stream.flush();
+  return copyString(Out);
+}
+
 static const rp_container_identifier *
 _rp_manager_get_container_identifier_from_name(const rp_manager *manager,
                                                const char *name) {
@@ -471,7 +568,7 @@ static bool _rp_target_is_ready(const rp_target *target,
                                 const rp_container *container) {
   revng_assert(target);
   revng_assert(container);
-  return container->second->enumerate().contains(*target);
+  return container->second->contains(*target);
 }
 
 /// TODO Remove the redundant copy by writing a custom string stream that writes
@@ -497,22 +594,119 @@ static const char *_rp_container_get_mime(const rp_container *container) {
   return container->getValue()->mimeType().data();
 }
 
+static uint64_t
+_rp_container_get_memory_usage(const rp_container *container) {
+  revng_check(container != nullptr);
+  return container->second->memoryUsage();
+}
+
 static rp_buffer *_rp_container_extract_one(const rp_container *container,
                                             const rp_target *target) {
   revng_check(container != nullptr);
   revng_check(target != nullptr);
 
-  if (!container->second->enumerate().contains(*target)) {
+  if (!container->second->contains(*target)) {
     return nullptr;
   }
 
   rp_buffer *Out = new rp_buffer();
-  llvm::raw_svector_ostream Serialized(*Out);
+  llvm::raw_svector_ostream Serialized(Out->storage());
   llvm::cantFail(container->second->extractOne(Serialized, *target));
 
   return Out;
 }
 
+static rp_buffer *
+_rp_container_extract_one_view(const rp_container *container,
+                               const rp_target *target) {
+  revng_check(container != nullptr);
+  revng_check(target != nullptr);
+
+  if (!container->second->contains(*target)) {
+    return nullptr;
+  }
+
+  if (auto View = container->second->viewOne(*target))
+    return new rp_buffer(*View);
+
+  return _rp_container_extract_one(container, target);
+}
+
+/// Calls \p Callback with the content of \p Target, pointing into the
+/// container if possible
+template<typename CallableType>
+static auto withContent(const rp_container *Container,
+                        const rp_target *Target,
+                        const CallableType &Callback) {
+  if (auto View = Container->second->viewOne(*Target))
+    return Callback(*View, false);
+
+  llvm::SmallVector<char, 0> Copy;
+  llvm::raw_svector_ostream Serialized(Copy);
+  llvm::cantFail(Container->second->extractOne(Serialized, *Target));
+  return Callback(llvm::StringRef(Copy.data(), Copy.size()), true);
+}
+
+/// \return the offset of the start of line \p Line of \p Content, or its
+/// size if there are fewer lines
+static size_t lineOffset(llvm::StringRef Content, uint64_t Line) {
+  size_t Offset = 0;
+  for (; Line != 0 and Offset < Content.size(); --Line) {
+    const void *End = memchr(Content.data() + Offset,
+                             '\n',
+                             Content.size() - Offset);
+    if (End == nullptr)
+      return Content.size();
+    Offset = static_cast<const char *>(End) - Content.data() + 1;
+  }
+
+  return Offset;
+}
+
+static rp_buffer *
+_rp_container_extract_lines_view(const rp_container *container,
+                                 const rp_target *target,
+                                 uint64_t first_line,
+                                 uint64_t line_count) {
+  revng_check(container != nullptr);
+  revng_check(target != nullptr);
+
+  if (!container->second->contains(*target)) {
+    return nullptr;
+  }
+
+  auto Slice = [first_line, line_count](llvm::StringRef Content,
+                                        bool IsCopy) -> rp_buffer * {
+    size_t Start = lineOffset(Content, first_line);
+    Content = Content.drop_front(Start);
+    Content = Content.take_front(lineOffset(Content, line_count));
+    if (not IsCopy)
+      return new rp_buffer(Content);
+
+    rp_buffer *Out = new rp_buffer();
+    Out->storage().append(Content.begin(), Content.end());
+    return Out;
+  };
+  return withContent(container, target, Slice);
+}
+
+static uint64_t _rp_container_get_line_count(const rp_container *container,
+                                             const rp_target *target) {
+  revng_check(container != nullptr);
+  revng_check(target != nullptr);
+
+  if (!container->second->contains(*target)) {
+    return 0;
+  }
+
+  auto Count = [](llvm::StringRef Content, bool) -> uint64_t {
+    if (Content.empty())
+      return 0;
+    return Content.count('\n') + (Content.ends_with("\n") ? 0 : 1);
+  };
+  return withContent(container, target, Count);
+}
+
 static rp_diff_map *
 _rp_manager_run_analyses_list(rp_manager *manager,
                               const char *list_name,
@@ -535,6 +729,77 @@ _rp_manager_run_analyses_list(rp_manager *manager,
   return new rp_diff_map(std::move(*MaybeDiffs));
 }
 
+static rp_async_request *
+_rp_manager_run_analyses_list_async(rp_manager *manager,
+                                    const char *list_name,
+                                    const rp_string_map *options,
+                                    rp_invalidations *invalidations) {
+  revng_check(manager != nullptr);
+  revng_check(list_name != nullptr);
+
+  auto *Result = new rp_async_request();
+  if (options != nullptr)
+    Result->Options = *options;
+  rp_invalidations *Invalidations = invalidations != nullptr ?
+                                      invalidations :
+                                      &Result->OwnedInvalidations;
+
+  const AnalysesList &AL = manager->getRunner().getAnalysesList(list_name);
+  auto Run = [manager, &AL, Invalidations, Result]() -> llvm::Error {
+    auto MaybeDiffs = manager->runAnalyses(AL,
+                                           *Invalidations,
+                                           Result->Options);
+    if (not MaybeDiffs)
+      return MaybeDiffs.takeError();
+
+    Result->Diffs = std::make_unique<DiffMap>(std::move(*MaybeDiffs));
+    return llvm::Error::success();
+  };
+  Result->Request = manager->runAsync(std::move(Run));
+
+  return Result;
+}
+
+static void _rp_async_request_cancel(rp_async_request *request) {
+  revng_check(request != nullptr);
+  request->Request->cancel();
+}
+
+static bool _rp_async_request_is_completed(const rp_async_request *request) {
+  revng_check(request != nullptr);
+  return request->Request->isCompleted();
+}
+
+static char *_rp_async_request_get_progress(const rp_async_request *request) {
+  revng_check(request != nullptr);
+  return copyString(request->Request->progress());
+}
+
+static bool _rp_async_request_wait(rp_async_request *request, rp_error *error) {
+  revng_check(request != nullptr);
+  if (auto Error = request->Request->wait(); Error) {
+    llvmErrorToRpError(std::move(Error), error);
+    return false;
+  }
+
+  return true;
+}
+
+static rp_buffer *_rp_async_request_take_buffer(rp_async_request *request) {
+  revng_check(request != nullptr);
+  return request->Buffer.release();
+}
+
+static rp_diff_map *_rp_async_request_take_diff_map(rp_async_request *request) {
+  revng_check(request != nullptr);
+  return request->Diffs.release();
+}
+
+static void _rp_async_request_destroy(rp_async_request *request) {
+  revng_check(request != nullptr);
+  delete request;
+}
+
 static bool _rp_diff_map_is_empty(rp_diff_map *map) {
   revng_check(map != nullptr);
   for (auto &Entry : *map) {
@@ -685,6 +950,52 @@ static void _rp_buffer_destroy(rp_buffer *buffer) {
   delete buffer;
 }
 
+static rp_production_batch *_rp_production_batch_create() {
+  return new rp_production_batch();
+}
+
+static void _rp_production_batch_destroy(rp_production_batch *batch) {
+  revng_check(batch != nullptr);
+  delete batch;
+}
+
+static void _rp_production_batch_add(rp_production_batch *batch,
+                                     const rp_step *step,
+                                     const rp_container *container,
+                                     const rp_target *target) {
+  revng_check(batch != nullptr);
+  revng_check(step != nullptr);
+  revng_check(container != nullptr);
+  revng_check(target != nullptr);
+
+  auto &Targets = batch->Requests[step->getName()][container->first()];
+  if (not Targets.contains(*target))
+    Targets.push_back(*target);
+}
+
+static rp_buffer *
+_rp_production_batch_get_result(const rp_production_batch *batch,
+                                const rp_step *step,
+                                const rp_container *container) {
+  revng_check(batch != nullptr);
+  revng_check(step != nullptr);
+  revng_check(container != nullptr);
+
+  auto StepIt = batch->Results.find(step->getName());
+  if (StepIt == batch->Results.end())
+    return nullptr;
+
+  auto ContainerIt = StepIt->second.find(container->first());
+  if (ContainerIt == StepIt->second.end())
+    return nullptr;
+
+  rp_buffer *Out = new rp_buffer();
+  llvm::raw_svector_ostream Serialized(Out->storage());
+  llvm::cantFail(ContainerIt->second->serialize(Serialized));
+
+  return Out;
+}
+
 static rp_container_targets_map *_rp_container_targets_map_create() {
   return new ContainerToTargetsMap();
 }
@@ -723,6 +1034,31 @@ static uint64_t _rp_manager_get_context_commit_index(rp_manager *manager) {
   return manager->context().getCommitIndex();
 }
 
+static void _rp_manager_set_memory_budget(rp_manager *manager, uint64_t bytes) {
+  revng_check(manager != nullptr);
+  manager->setMemoryBudget(bytes);
+}
+
+static uint64_t _rp_manager_get_memory_usage(const rp_manager *manager) {
+  revng_check(manager != nullptr);
+  return manager->memoryUsage();
+}
+
+static uint64_t
+_rp_manager_get_global_memory_usage(const rp_manager *manager,
+                                    const char *global_name) {
+  revng_check(manager != nullptr);
+  revng_check(global_name != nullptr);
+
+  auto MaybeGlobal = manager->context().getGlobals().get(global_name);
+  if (not MaybeGlobal) {
+    llvm::consumeError(MaybeGlobal.takeError());
+    return 0;
+  }
+
+  return MaybeGlobal.get()->memoryUsage();
+}
+
 // NOLINTEND
 
 // Import the autogenerated wrappers, these will contains calls to the
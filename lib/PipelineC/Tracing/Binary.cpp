@@ -0,0 +1,209 @@
+/// \file Binary.cpp
+/// Implements the parsing of binary traces.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <optional>
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Endian.h"
+
+#include "revng/PipelineC/Tracing/BinaryFormat.h"
+#include "revng/PipelineC/Tracing/Trace.h"
+
+namespace binary = revng::tracing::binary;
+
+static llvm::Error malformed(const char *Reason) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "Malformed binary trace: %s",
+                                 Reason);
+}
+
+namespace {
+
+/// Reads integers and bytes off a buffer, failing at its end
+class BufferReader {
+private:
+  llvm::StringRef Buffer;
+
+public:
+  BufferReader(llvm::StringRef Buffer) : Buffer(Buffer) {}
+
+public:
+  bool atEnd() const { return Buffer.empty(); }
+
+  template<typename T>
+  std::optional<T> read() {
+    if (Buffer.size() < sizeof(T))
+      return std::nullopt;
+
+    using namespace llvm::support;
+    T Result = endian::read<T, little, unaligned>(Buffer.data());
+    Buffer = Buffer.drop_front(sizeof(T));
+    return Result;
+  }
+
+  std::optional<llvm::StringRef> bytes(uint64_t Size) {
+    if (Buffer.size() < Size)
+      return std::nullopt;
+
+    llvm::StringRef Result = Buffer.take_front(Size);
+    Buffer = Buffer.drop_front(Size);
+    return Result;
+  }
+};
+
+} // namespace
+
+namespace revng::tracing {
+
+llvm::Expected<Trace> Trace::fromBinaryBuffer(llvm::StringRef Buffer) {
+  if (not Buffer.consume_front(binary::Magic))
+    return malformed("wrong magic");
+
+  BufferReader Reader(Buffer);
+  auto Version = Reader.read<uint32_t>();
+  if (not Version or *Version != binary::Version) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Unexpected trace version");
+  }
+
+  Trace Result;
+  Result.Version = *Version;
+
+  llvm::DenseMap<uint32_t, std::string> Strings;
+  llvm::DenseMap<uint32_t, std::shared_ptr<const std::string>> Blobs;
+  auto GetString = [&Strings](std::optional<uint32_t> ID) {
+    const std::string *Found = nullptr;
+    if (ID) {
+      auto It = Strings.find(*ID);
+      if (It != Strings.end())
+        Found = &It->second;
+    }
+    return Found;
+  };
+
+  // A trace ends without errors when reading the next record fails, since
+  // the trace might have been cut short by a crash
+  Command *Current = nullptr;
+  while (auto Tag = Reader.read<uint8_t>()) {
+    // Records other than definitions can appear only within a command
+    bool IsDefinition = *Tag == binary::String or *Tag == binary::Blob;
+    if (*Tag != binary::Command and not IsDefinition and Current == nullptr)
+      return malformed("record outside of a command");
+
+    switch (*Tag) {
+    case binary::String: {
+      auto ID = Reader.read<uint32_t>();
+      auto Size = Reader.read<uint32_t>();
+      if (not ID or not Size)
+        return Result;
+
+      auto Bytes = Reader.bytes(*Size);
+      if (not Bytes)
+        return Result;
+      Strings[*ID] = Bytes->str();
+    } break;
+
+    case binary::Blob: {
+      auto ID = Reader.read<uint32_t>();
+      auto Size = Reader.read<uint64_t>();
+      if (not ID or not Size)
+        return Result;
+
+      auto Bytes = Reader.bytes(*Size);
+      if (not Bytes)
+        return Result;
+      Blobs[*ID] = std::make_shared<const std::string>(Bytes->str());
+    } break;
+
+    case binary::Command: {
+      if (Current != nullptr)
+        return malformed("command started before the previous one ended");
+
+      auto ID = Reader.read<uint64_t>();
+      auto StartTime = Reader.read<uint64_t>();
+      auto Name = Reader.read<uint32_t>();
+      if (not ID or not StartTime or not Name)
+        return Result;
+
+      const std::string *NameString = GetString(Name);
+      if (NameString == nullptr)
+        return malformed("undefined string");
+
+      Current = &Result.Commands.emplace_back();
+      Current->ID = *ID;
+      Current->StartTime = *StartTime;
+      Current->Name = *NameString;
+    } break;
+
+    case binary::Scalar:
+    case binary::Result: {
+      auto ID = Reader.read<uint32_t>();
+      if (not ID)
+        return Result;
+
+      const std::string *Value = GetString(ID);
+      if (Value == nullptr)
+        return malformed("undefined string");
+
+      if (*Tag == binary::Scalar)
+        Current->Arguments.emplace_back().getScalar() = *Value;
+      else
+        Current->Result = *Value;
+    } break;
+
+    case binary::Buffer: {
+      auto ID = Reader.read<uint32_t>();
+      if (not ID)
+        return Result;
+
+      auto It = Blobs.find(*ID);
+      if (It == Blobs.end())
+        return malformed("undefined blob");
+      Current->Arguments.emplace_back().setBlob(It->second);
+    } break;
+
+    case binary::List: {
+      auto Count = Reader.read<uint32_t>();
+      if (not Count)
+        return Result;
+
+      std::vector<std::string> &Sequence = Current->Arguments.emplace_back()
+                                             .getSequence();
+      for (uint32_t I = 0; I < *Count; ++I) {
+        auto ID = Reader.read<uint32_t>();
+        if (not ID)
+          return Result;
+
+        const std::string *Value = GetString(ID);
+        if (Value == nullptr)
+          return malformed("undefined string");
+        Sequence.push_back(*Value);
+      }
+    } break;
+
+    case binary::End: {
+      auto EndTime = Reader.read<uint64_t>();
+      auto WallTime = Reader.read<uint64_t>();
+      auto PeakRSSDeltaKB = Reader.read<uint64_t>();
+      if (not EndTime or not WallTime or not PeakRSSDeltaKB)
+        return Result;
+
+      Current->EndTime = *EndTime;
+      Current->WallTime = *WallTime;
+      Current->PeakRSSDeltaKB = *PeakRSSDeltaKB;
+      Current = nullptr;
+    } break;
+
+    default:
+      return malformed("unknown record");
+    }
+  }
+
+  return Result;
+}
+
+} // namespace revng::tracing
@@ -6,7 +6,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include "llvm/Support/Base64.h"
+#include <algorithm>
+#include <numeric>
 
 #include "revng/ADT/ConstexprString.h"
 #include "revng/PipelineC/PipelineC.h"
@@ -61,14 +62,7 @@ private:
 
 inline llvm::Expected<std::vector<char>>
 extractBuffer(const revng::tracing::Argument &Arg) {
-  revng_assert(Arg.isScalar());
-  std::vector<char> Result;
-  llvm::Error Err = llvm::decodeBase64(Arg.getScalar(), Result);
-  if (Err)
-    return std::move(Err);
-
-  llvm::consumeError(std::move(Err));
-  return Result;
+  return Arg.decodeBuffer();
 }
 
 namespace revng::tracing {
@@ -106,4 +100,21 @@ llvm::Expected<std::vector<char>> Trace::getBuffer(size_t CommandNo,
 
   return extractBuffer(Command.Arguments[ArgNo]);
 }
+
+std::vector<size_t> Trace::slowestCommands(size_t Count) const {
+  std::vector<size_t> Result(this->Commands.size());
+  std::iota(Result.begin(), Result.end(), 0);
+
+  Count = std::min(Count, Result.size());
+  auto IsSlower = [this](size_t LHS, size_t RHS) {
+    return Commands[LHS].wallTime() > Commands[RHS].wallTime();
+  };
+  std::partial_sort(Result.begin(),
+                    Result.begin() + Count,
+                    Result.end(),
+                    IsSlower);
+  Result.resize(Count);
+
+  return Result;
+}
 } // namespace revng::tracing
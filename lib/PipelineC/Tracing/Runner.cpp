@@ -6,9 +6,9 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
 #include <csignal>
 
-#include "llvm/Support/Base64.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/raw_ostream.h"
@@ -19,6 +19,7 @@
 #include "revng/PipelineC/Tracing/Trace.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/PathList.h"
+#include "revng/Support/Progress.h"
 
 #include "Types.h"
 #include "sanitizer/asan_interface.h"
@@ -189,8 +190,9 @@ private:
     constexpr int LH = LengthHint<Name, I>;
     std::vector<char> Result;
     if constexpr (LH > 0) {
-      llvm::Error Err = llvm::decodeBase64(Argument.getScalar(), Result);
-      revng_check(!Err);
+      auto MaybeBuffer = Argument.decodeBuffer();
+      revng_check(static_cast<bool>(MaybeBuffer));
+      Result = std::move(*MaybeBuffer);
     } else {
       Result.assign(Argument.getScalar().begin(), Argument.getScalar().end());
     }
@@ -446,7 +448,8 @@ argumentTransformer(RunnerContext &Context,
 }
 
 namespace revng::tracing {
-llvm::Error Trace::run(const revng::tracing::RunTraceOptions Options) const {
+llvm::Error Trace::run(const revng::tracing::RunTraceOptions Options,
+                       std::vector<CommandMeasurement> *Measurements) const {
   using namespace revng;
 
   RunnerContext Context(Options);
@@ -469,7 +472,22 @@ llvm::Error Trace::run(const revng::tracing::RunTraceOptions Options) const {
     if (Options.BreakAt.contains(CommandI))
       raise(SIGTRAP);
 
+    if (Measurements == nullptr) {
+      CommandHandler[Command.Name](Context, Arguments, Command.Result);
+      continue;
+    }
+
+    namespace sc = std::chrono;
+    uint64_t InitialPeakRSS = getPeakRSSKB();
+    auto Start = sc::steady_clock::now();
     CommandHandler[Command.Name](Context, Arguments, Command.Result);
+    auto Duration = sc::steady_clock::now() - Start;
+    Measurements->push_back({
+      .CommandNumber = CommandI,
+      .WallTime = static_cast<uint64_t>(
+        sc::duration_cast<sc::microseconds>(Duration).count()),
+      .PeakRSSDeltaKB = getPeakRSSKB() - InitialPeakRSS,
+    });
   }
 
   return llvm::Error::success();
@@ -3,54 +3,66 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <map>
 #include <mutex>
 #include <optional>
-#include <thread>
+#include <string>
+#include <unistd.h>
 
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/Base64.h"
+#include "llvm/Support/EndianStream.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/Signals.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/ConstexprString.h"
 #include "revng/PipelineC/PipelineC.h"
+#include "revng/PipelineC/Tracing/BinaryFormat.h"
 #include "revng/PipelineC/Tracing/Common.h"
+#include "revng/PipelineC/Tracing/Private.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/Metrics.h"
+#include "revng/Support/Progress.h"
 
 #include "Types.h"
 
 inline constexpr auto TracingEnv = "REVNG_C_API_TRACE_PATH";
+// Either "yaml" (the default) or "binary"
+inline constexpr auto TracingFormatEnv = "REVNG_C_API_TRACE_FORMAT";
 inline auto PointerStyle = llvm::HexPrintStyle::PrefixLower;
+// If set, the duration of each call is recorded, see rp_get_metrics
+inline constexpr auto MetricsEnv = "REVNG_C_API_METRICS";
 
-// The opposite of a std::recursive_mutex, if locked by the same thread it will
-// assert (this is to avoid a deadlock/malformed output when tracing)
-class OncePerThreadMutex {
-private:
-  std::optional<std::thread::id> ThreadId;
-  std::mutex Mutex;
+// The buffer the current thread serializes its traced commands in. It's reused
+// across calls, so that it's already large enough most of the time.
+inline thread_local std::string CommandBuffer;
 
-public:
-  OncePerThreadMutex() {}
+// While the current thread is executing a traced call, the size of its
+// prelude and arguments at the start of CommandBuffer, zero otherwise
+inline thread_local std::atomic<size_t> InFlightSize = 0;
 
-  void lock() {
-    if (ThreadId.has_value())
-      revng_assert(std::this_thread::get_id() != *ThreadId,
-                   "NonRecursiveMutex entered twice by the same thread!");
-    Mutex.lock();
-    ThreadId = std::this_thread::get_id();
-  }
-
-  void unlock() {
-    revng_assert(std::this_thread::get_id() == *ThreadId);
-    Mutex.unlock();
-    ThreadId.reset();
-  }
-};
+// Whether the current thread is writing to the trace
+inline thread_local bool WritingTrace = false;
 
-inline OncePerThreadMutex TraceMutex;
+// Returns the number of milliseconds since epoch
+inline uint64_t getUnixMillis() {
+  namespace sc = std::chrono;
+  auto Now = sc::system_clock::now().time_since_epoch();
+  return sc::duration_cast<std::chrono::milliseconds>(Now).count();
+}
 
 // Helper class for tracing, this will be used by the the argument/return
 // handlers defined below to properly print the value of the arguments onto the
-// YAML tracing file
+// YAML tracing file.
+// Each traced call has its own writer, printing onto a private buffer which is
+// appended to the trace as a whole once the call returns (see
+// `TracingRuntime::commit`).
 class TraceWriter {
 private:
   llvm::raw_ostream &OS;
@@ -61,18 +73,15 @@ private:
   // value
   bool OutputtingArguments = false;
 
-  // Integer used to compute the ID of the command
+  // The ID of the command, in order of start
   uint64_t ID = 0;
 
 public:
-  TraceWriter(llvm::raw_ostream &OS) : OS(OS) {
-    OS.SetUnbuffered();
-    printHeader();
-  }
+  TraceWriter(llvm::raw_ostream &OS, uint64_t ID) : OS(OS), ID(ID) {}
 
 public:
   void functionPrelude(const llvm::StringRef Name) {
-    OS << "- ID: " << ID++ << "\n";
+    OS << "- ID: " << ID << "\n";
     OS << "  StartTime: " << getUnixMillis() << "\n";
     OS << "  Name: " << Name << "\n";
     OS << "  Arguments:\n";
@@ -191,66 +200,351 @@ public:
     OS.flush();
   }
 
-private:
-  void printHeader() {
-    OS << "Version: 1\n";
-    OS << "Commands:\n";
+  void printMeasurements(uint64_t WallTime, uint64_t PeakRSSDeltaKB) {
+    OS << "  WallTime: " << WallTime << "\n";
+    OS << "  PeakRSSDeltaKB: " << PeakRSSDeltaKB << "\n";
     OS.flush();
   }
 
+private:
   std::string reprString(const char *String) {
     return '"' + llvm::yaml::escape(String) + '"';
   }
-
-  // Returns the number of milliseconds since epoch
-  static uint64_t getUnixMillis() {
-    namespace sc = std::chrono;
-    auto Now = sc::system_clock::now().time_since_epoch();
-    return sc::duration_cast<std::chrono::milliseconds>(Now).count();
-  }
 };
 
+// Appends the traced commands to the trace. Commands are appended in order of
+// completion, which is consistent with the order in which their results are
+// used. Concurrent calls only contend for the time it takes to append one.
 class TracingRuntime {
 private:
-  std::optional<TraceWriter> Writer;
-  std::optional<llvm::raw_fd_ostream> OS;
+  using TraceFormat = revng::tracing::TraceFormat;
+  using SHA1Hash = std::array<uint8_t, 20>;
+
+private:
+  std::optional<llvm::raw_fd_ostream> OwnedOS;
+  std::atomic<llvm::raw_ostream *> OS = nullptr;
+  std::atomic<TraceFormat> Format = TraceFormat::YAML;
+
+  // Protects OS and the interned strings and blobs
+  std::mutex OutputMutex;
+
+  // The file descriptor of OS, if it's a file, for writeInFlightCommand
+  std::atomic<int> FD = -1;
+
+  // Whether OutputMutex is held, writeInFlightCommand can't lock it
+  std::atomic<bool> OutputBusy = false;
+
+  // The strings and the blobs already defined in a binary trace
+  llvm::StringMap<uint32_t> Strings;
+  std::map<SHA1Hash, uint32_t> Blobs;
+
+  std::atomic<uint64_t> NextID = 0;
+  std::once_flag SignalHandlerRegistration;
+
+  // Locks OutputMutex, keeping track of it for writeInFlightCommand
+  class OutputGuard {
+  private:
+    std::lock_guard<std::mutex> Guard;
+    std::atomic<bool> &Busy;
+
+  public:
+    OutputGuard(TracingRuntime &Runtime) :
+      Guard(Runtime.OutputMutex), Busy(Runtime.OutputBusy) {
+      WritingTrace = true;
+      Busy = true;
+    }
+
+    ~OutputGuard() {
+      Busy = false;
+      WritingTrace = false;
+    }
+  };
 
 public:
   TracingRuntime() {
     if (auto Path = llvm::sys::Process::GetEnv(TracingEnv)) {
       std::error_code EC;
-      OS.emplace(*Path, EC);
+      OwnedOS.emplace(*Path, EC);
       revng_assert(!EC);
-      Writer.emplace(*OS);
+
+      TraceFormat NewFormat = TraceFormat::YAML;
+      if (auto Format = llvm::sys::Process::GetEnv(TracingFormatEnv)) {
+        if (*Format == "binary")
+          NewFormat = TraceFormat::Binary;
+        else
+          revng_assert(*Format == "yaml", "Unknown trace format");
+      }
+
+      start(&*OwnedOS, NewFormat);
+    }
+  }
+
+  void swap(llvm::raw_ostream *NewOS = nullptr,
+            TraceFormat NewFormat = TraceFormat::YAML) {
+    OutputGuard Guard(*this);
+    OS = nullptr;
+    FD = -1;
+    OwnedOS.reset();
+    if (NewOS != nullptr)
+      start(NewOS, NewFormat);
+  }
+
+  bool isEnabled() const { return OS != nullptr; }
+  bool isBinary() const { return Format == TraceFormat::Binary; }
+
+  uint64_t nextID() { return NextID++; }
+
+  // Append \p Command, completed by the current thread, to the trace
+  void commit(llvm::StringRef Command) {
+    {
+      OutputGuard Guard(*this);
+      if (llvm::raw_ostream *Output = OS) {
+        *Output << Command;
+        Output->flush();
+      }
+    }
+
+    // Registering it during the first call would be too early, rp_initialize
+    // has yet to install the signal handlers
+    std::call_once(SignalHandlerRegistration, [this] {
+      llvm::sys::AddSignalHandler(writeInFlightCommand, this);
+    });
+  }
+
+  // Binary traces only: \return the ID of \p String, defining it in the trace
+  // if it's the first time it's used
+  uint32_t internString(llvm::StringRef String) {
+    OutputGuard Guard(*this);
+    auto [It, New] = Strings.try_emplace(String, Strings.size());
+    if (New) {
+      if (llvm::raw_ostream *Output = OS) {
+        using namespace llvm::support;
+        *Output << static_cast<char>(revng::tracing::binary::String);
+        endian::write<uint32_t>(*Output, It->second, little);
+        endian::write<uint32_t>(*Output, String.size(), little);
+        *Output << String;
+        // The in-flight command might refer to it, see writeInFlightCommand
+        Output->flush();
+      }
     }
+    return It->second;
   }
 
-  void swap(llvm::raw_ostream *NewOS = nullptr) {
-    Writer.reset();
-    OS.reset();
-    if (NewOS != nullptr) {
-      Writer.emplace(*NewOS);
+  // Binary traces only: \return the ID of the blob with the content of
+  // \p Buffer, defining it in the trace if there's none already
+  uint32_t internBlob(llvm::StringRef Buffer) {
+    SHA1Hash Hash = llvm::SHA1::hash(llvm::arrayRefFromStringRef(Buffer));
+
+    OutputGuard Guard(*this);
+    auto [It, New] = Blobs.try_emplace(Hash, Blobs.size());
+    if (New) {
+      if (llvm::raw_ostream *Output = OS) {
+        using namespace llvm::support;
+        *Output << static_cast<char>(revng::tracing::binary::Blob);
+        endian::write<uint32_t>(*Output, It->second, little);
+        endian::write<uint64_t>(*Output, Buffer.size(), little);
+        *Output << Buffer;
+        Output->flush();
+      }
     }
+    return It->second;
   }
 
-  bool isEnabled() const { return Writer.has_value(); }
+private:
+  void start(llvm::raw_ostream *NewOS, TraceFormat NewFormat) {
+    NextID = 0;
+    Format = NewFormat;
+    Strings.clear();
+    Blobs.clear();
+
+    if (isBinary()) {
+      *NewOS << revng::tracing::binary::Magic;
+      llvm::support::endian::write<uint32_t>(*NewOS,
+                                             revng::tracing::binary::Version,
+                                             llvm::support::little);
+    } else {
+      *NewOS << "Version: 1\n";
+      *NewOS << "Commands:\n";
+    }
+    NewOS->flush();
+    OS = NewOS;
 
-  TraceWriter &operator*() {
-    revng_assert(Writer.has_value());
-    return *Writer;
+    using Kind = llvm::raw_ostream::OStreamKind;
+    if (NewOS->get_kind() == Kind::OK_FDStream)
+      FD = static_cast<llvm::raw_fd_ostream *>(NewOS)->get_fd();
   }
 
-  TraceWriter *operator->() {
-    revng_assert(Writer.has_value());
-    return &*Writer;
+  // When crashing, append the command being executed without its result, so
+  // that the trace shows which call crashed. This runs in a signal handler:
+  // the command has been serialized before the call, and is written as is to
+  // the trace file with write(2), bypassing OS.
+  static void writeInFlightCommand(void *Cookie) {
+    size_t Size = InFlightSize;
+    if (Size == 0 or WritingTrace)
+      return;
+
+    // Another thread might be writing, give up rather than interleaving
+    auto *Runtime = static_cast<TracingRuntime *>(Cookie);
+    int Output = Runtime->FD;
+    if (Output < 0 or Runtime->OutputBusy)
+      return;
+
+    int SavedErrno = errno;
+    const char *Data = CommandBuffer.data();
+    while (Size > 0) {
+      ssize_t Written = ::write(Output, Data, Size);
+      if (Written < 0) {
+        if (errno == EINTR)
+          continue;
+        break;
+      }
+
+      Data += Written;
+      Size -= Written;
+    }
+    errno = SavedErrno;
   }
 };
 
 inline TracingRuntime Tracing;
 
-template<ConstexprString Name, int I, int N, typename... T>
-inline void handleArgument(std::tuple<T...> Args) {
-  Tracing->newArgument();
+// The binary counterpart of TraceWriter, see BinaryFormat.h
+class BinaryTraceWriter {
+private:
+  llvm::raw_ostream &OS;
+  bool OutputtingArguments = false;
+  uint64_t ID = 0;
+  uint64_t WallTime = 0;
+  uint64_t PeakRSSDeltaKB = 0;
+
+public:
+  BinaryTraceWriter(llvm::raw_ostream &OS, uint64_t ID) : OS(OS), ID(ID) {}
+
+public:
+  void functionPrelude(const llvm::StringRef Name) {
+    OS << static_cast<char>(revng::tracing::binary::Command);
+    write<uint64_t>(ID);
+    write<uint64_t>(getUnixMillis());
+    write<uint32_t>(Tracing.internString(Name));
+    OutputtingArguments = true;
+  }
+
+  void newArgument() {}
+
+  template<IntegerType T>
+  void printValue(const T &Int) {
+    std::string Value;
+    llvm::raw_string_ostream(Value) << Int;
+    printScalar(Value);
+  }
+
+  template<typename T>
+    requires std::is_same_v<T, bool>
+  void printValue(const T &Bool) {
+    printScalar(Bool ? "true" : "false");
+  }
+
+  template<typename T>
+    requires std::is_same_v<T, char>
+  void printValue(const T *String) {
+    if (OutputtingArguments)
+      printScalar(String);
+    else
+      printPointer(String);
+  }
+
+  template<RPType T>
+  void printValue(const T *Ptr) {
+    printPointer(Ptr);
+  }
+
+  template<typename T>
+  void printPointer(const T *Ptr) {
+    printScalar(pointerName(Ptr));
+  }
+
+  void printBuffer(const llvm::StringRef Input) {
+    OS << static_cast<char>(revng::tracing::binary::Buffer);
+    write<uint32_t>(Tracing.internBlob(Input));
+  }
+
+  template<IntegerType T>
+  void printList(const T IntList[], uint64_t Length) {
+    printListOf(Length, [IntList](uint64_t I) {
+      std::string Value;
+      llvm::raw_string_ostream(Value) << static_cast<max_int<T>>(IntList[I]);
+      return Value;
+    });
+  }
+
+  template<typename T>
+    requires std::is_same_v<T, char>
+  void printList(const T *StringList[], uint64_t Length) {
+    printListOf(Length, [StringList](uint64_t I) {
+      return std::string(StringList[I]);
+    });
+  }
+
+  template<RPType T>
+  void printList(const T *PtrList[], uint64_t Length) {
+    printListOf(Length,
+                [PtrList](uint64_t I) { return pointerName(PtrList[I]); });
+  }
+
+  template<typename... T>
+    requires(sizeof...(T) < 2)
+  void printReturn(T... ReturnValue) {
+    OutputtingArguments = false;
+    if constexpr (sizeof...(T) != 0)
+      printValue(ReturnValue...);
+
+    OS << static_cast<char>(revng::tracing::binary::End);
+    write<uint64_t>(getUnixMillis());
+    write<uint64_t>(WallTime);
+    write<uint64_t>(PeakRSSDeltaKB);
+  }
+
+  // Recorded by printReturn
+  void printMeasurements(uint64_t NewWallTime, uint64_t NewPeakRSSDeltaKB) {
+    WallTime = NewWallTime;
+    PeakRSSDeltaKB = NewPeakRSSDeltaKB;
+  }
+
+private:
+  template<typename T>
+  void write(T Value) {
+    llvm::support::endian::write<T>(OS, Value, llvm::support::little);
+  }
+
+  // Either an argument or a result, depending on OutputtingArguments
+  void printScalar(llvm::StringRef Value) {
+    using namespace revng::tracing;
+    OS << static_cast<char>(OutputtingArguments ? binary::Scalar :
+                                                  binary::Result);
+    write<uint32_t>(Tracing.internString(Value));
+  }
+
+  template<typename CallableT>
+  void printListOf(uint64_t Length, CallableT &&ElementToString) {
+    OS << static_cast<char>(revng::tracing::binary::List);
+    write<uint32_t>(Length);
+    for (uint64_t I = 0; I < Length; I++)
+      write<uint32_t>(Tracing.internString(ElementToString(I)));
+  }
+
+  template<typename T>
+  static std::string pointerName(const T *Ptr) {
+    std::string Result;
+    llvm::raw_string_ostream Stream(Result);
+    Stream << PointerPrefix;
+    llvm::write_hex(Stream, reinterpret_cast<uintptr_t>(Ptr), PointerStyle);
+    return Result;
+  }
+};
+
+template<ConstexprString Name, int I, int N, typename WriterT, typename... T>
+inline void handleArgument(WriterT &Writer, std::tuple<T...> Args) {
+  Writer.newArgument();
   using ArgT = decltype(std::get<I>(Args));
   using RArgT = std::remove_reference_t<ArgT>;
   ArgT Argument = std::get<I>(Args);
@@ -262,53 +556,130 @@ inline void handleArgument(std::tuple<T...> Args) {
     // Handle arguments with length hints
     if constexpr (std::is_same_v<RArgT, const char *>) {
       // Buffer
-      Tracing->printBuffer({ Argument, LengthArgument });
+      Writer.printBuffer({ Argument, LengthArgument });
     } else {
       // Array-like
-      Tracing->printList(Argument, LengthArgument);
+      Writer.printList(Argument, LengthArgument);
     }
   } else {
     if constexpr (isDestroy<Name>()) {
       // _destroy methods always take 1 argument and it's always a pointer
       static_assert(N == 1);
-      Tracing->printPointer(Argument);
+      Writer.printPointer(Argument);
     } else {
-      Tracing->printValue(Argument);
+      Writer.printValue(Argument);
     }
   }
 
   if constexpr (I + 1 < N)
-    handleArgument<Name, I + 1, N>(Args);
+    handleArgument<Name, I + 1, N>(Writer, Args);
 }
 
-template<ConstexprString Name, typename... T>
-inline void handleArguments(T &&...Args) {
+template<ConstexprString Name, typename WriterT, typename... T>
+inline void handleArguments(WriterT &Writer, T &&...Args) {
   if constexpr (sizeof...(T) > 0)
-    handleArgument<Name, 0, sizeof...(T)>(std::make_tuple(Args...));
+    handleArgument<Name, 0, sizeof...(T)>(Writer, std::make_tuple(Args...));
 }
 
-// This function will be used in each PipelineC function we need to wrap
-// For example:
-// rp_initialize(...) { return wrap<"rp_initialize">(_rp_initialize, ...); }
-template<ConstexprString Name, typename CalleeT, typename... ArgsT>
-inline decltype(auto) wrap(CalleeT Callee, ArgsT... Args) {
+// Trace a call to \p Callee with \p Writer, a TraceWriter or a
+// BinaryTraceWriter
+template<ConstexprString Name,
+         typename WriterT,
+         typename CalleeT,
+         typename... ArgsT>
+inline decltype(auto) traceCall(CalleeT Callee, ArgsT... Args) {
   using ReturnT = typename decltype(std::function{ Callee })::result_type;
+
+  // No lock is held during the call, concurrent calls remain concurrent
+  std::string &Command = CommandBuffer;
+  Command.clear();
+  llvm::raw_string_ostream OS(Command);
+  WriterT Writer(OS, Tracing.nextID());
+
+  Writer.functionPrelude(std::string_view(Name));
+  handleArguments<Name>(Writer, Args...);
+
+  // Nothing is appended to Command until the callee returns, so the signal
+  // handler can write it as is
+  OS.flush();
+  InFlightSize = Command.size();
+
+  namespace sc = std::chrono;
+  uint64_t InitialPeakRSS = revng::getPeakRSSKB();
+  auto Start = sc::steady_clock::now();
+  auto PrintMeasurements = [&Writer, &Start, InitialPeakRSS]() {
+    auto Duration = sc::steady_clock::now() - Start;
+    auto WallTime = sc::duration_cast<sc::microseconds>(Duration).count();
+    Writer.printMeasurements(WallTime, revng::getPeakRSSKB() - InitialPeakRSS);
+  };
+
+  if constexpr (std::is_same_v<ReturnT, void>) {
+    Callee(std::forward<ArgsT>(Args)...);
+    InFlightSize = 0;
+    PrintMeasurements();
+    Writer.printReturn();
+    Tracing.commit(Command);
+  } else {
+    ReturnT Return = Callee(std::forward<ArgsT>(Args)...);
+    InFlightSize = 0;
+    PrintMeasurements();
+    Writer.printReturn(Return);
+    Tracing.commit(Command);
+    return Return;
+  }
+}
+
+// Call \p Callee, tracing the call if tracing is enabled
+template<ConstexprString Name, typename CalleeT, typename... ArgsT>
+inline decltype(auto) traceOrCall(CalleeT Callee, ArgsT... Args) {
   if (Tracing.isEnabled()) {
-    // Special lock to avoid trace output being broken by multithreading or by
-    // calling a PipelineC function within PipelineC
-    std::lock_guard Guard(TraceMutex);
-
-    Tracing->functionPrelude(std::string_view(Name));
-    handleArguments<Name>(Args...);
-    if constexpr (std::is_same_v<ReturnT, void>) {
-      Callee(std::forward<ArgsT>(Args)...);
-      Tracing->printReturn();
-    } else {
-      ReturnT Return = Callee(std::forward<ArgsT>(Args)...);
-      Tracing->printReturn(Return);
-      return Return;
-    }
+    // Calling a PipelineC function within PipelineC would break the trace
+    revng_assert(InFlightSize == 0,
+                 "PipelineC function called within PipelineC while tracing");
+
+    if (Tracing.isBinary())
+      return traceCall<Name, BinaryTraceWriter>(Callee, Args...);
+    else
+      return traceCall<Name, TraceWriter>(Callee, Args...);
   } else {
     return Callee(std::forward<ArgsT>(Args)...);
   }
 }
+
+inline const bool MetricsEnabled = llvm::sys::Process::GetEnv(MetricsEnv)
+                                     .has_value();
+
+// The durations of the calls, by function. Each thread records in its own
+// shard, so that concurrent calls do not contend.
+inline revng::LatencyHistogramFamily
+  CallDuration("revng_c_api_call_duration_seconds",
+               "Duration of the calls to each PipelineC function",
+               "function");
+
+// Records the duration of a call on destruction
+class CallTimer {
+private:
+  using Clock = std::chrono::steady_clock;
+  llvm::StringRef Name;
+  Clock::time_point Start = Clock::now();
+
+public:
+  CallTimer(llvm::StringRef Name) : Name(Name) {}
+
+  ~CallTimer() {
+    std::chrono::duration<double> Duration = Clock::now() - Start;
+    CallDuration.record(Name, Duration.count());
+  }
+};
+
+// This function will be used in each PipelineC function we need to wrap
+// For example:
+// rp_initialize(...) { return wrap<"rp_initialize">(_rp_initialize, ...); }
+template<ConstexprString Name, typename CalleeT, typename... ArgsT>
+inline decltype(auto) wrap(CalleeT Callee, ArgsT... Args) {
+  if (not MetricsEnabled)
+    return traceOrCall<Name>(Callee, Args...);
+
+  CallTimer Timer(std::string_view(Name));
+  return traceOrCall<Name>(Callee, Args...);
+}
@@ -6,9 +6,16 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Progress.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
+#include "revng/Model/IRHelpers.h"
 #include "revng/Model/LoadModelPass.h"
+#include "revng/Model/TypeLayoutCache.h"
 #include "revng/Pipeline/Context.h"
 #include "revng/Pipeline/ExecutionContext.h"
 #include "revng/Pipeline/LLVMKind.h"
@@ -16,6 +23,68 @@
 #include "revng/Pipes/TaggedFunctionKind.h"
 #include "revng/Support/FunctionTags.h"
 
+using namespace llvm;
+
+static cl::opt<unsigned> FunctionPassThreads("function-pass-threads",
+                                             cl::desc("Number of threads "
+                                                      "running the analysis "
+                                                      "phase of function "
+                                                      "local FunctionPasses "
+                                                      "(0 means all the "
+                                                      "available cores)"),
+                                             cl::init(1));
+
+using AnalysisResultPointer = std::unique_ptr<
+  pipeline::FunctionPassImpl::FunctionAnalysisResult>;
+
+/// Run FunctionPassImpl::analyzeFunction on all the requested functions, in
+/// parallel if requested. Results are returned in the same order of the
+/// requested targets.
+static std::vector<AnalysisResultPointer>
+analyzeFunctions(pipeline::ExecutionContext &Ctx,
+                 llvm::Module &Module,
+                 llvm::StringRef ContainerName,
+                 const pipeline::FunctionPassImpl &Pipe) {
+  std::map<MetaAddress, llvm::Function *> AddressToFunction;
+  for (llvm::Function &Function : Module.functions())
+    if (FunctionTags::Isolated.isTagOf(&Function))
+      AddressToFunction.emplace(getMetaAddressOfIsolatedFunction(Function),
+                                &Function);
+
+  // Note: we do not access the model here, the tracking of read fields is not
+  //       affected
+  std::vector<const llvm::Function *> Functions;
+  for (const pipeline::Target &Target :
+       Ctx.getCurrentRequestedTargets()[ContainerName]) {
+    auto Address = MetaAddress::fromString(Target.getPathComponents()[0]);
+    auto It = AddressToFunction.find(Address);
+    Functions.push_back(It == AddressToFunction.end() ? nullptr : It->second);
+  }
+
+  std::vector<AnalysisResultPointer> Results(Functions.size());
+  auto Analyze = [&Ctx, &Functions, &Results, &Pipe](size_t Index) {
+    // The whole run is going to be discarded, skip the remaining functions
+    if (Ctx.isCancellationRequested())
+      return;
+
+    if (Functions[Index] != nullptr)
+      Results[Index] = Pipe.analyzeFunction(*Functions[Index]);
+  };
+
+  if (FunctionPassThreads == 1 or Functions.size() <= 1) {
+    for (size_t I = 0; I < Functions.size(); ++I)
+      Analyze(I);
+  } else {
+    // Each task writes in its own slot of Results, no synchronization needed
+    ThreadPool Pool(hardware_concurrency(FunctionPassThreads));
+    for (size_t I = 0; I < Functions.size(); ++I)
+      Pool.async(Analyze, I);
+    Pool.wait();
+  }
+
+  return Results;
+}
+
 bool pipeline::detail::runOnModule(llvm::Module &Module,
                                    FunctionPassImpl &Pipe) {
   auto &Analysis = Pipe.getAnalysis<pipeline::LoadExecutionContextPass>();
@@ -24,19 +93,42 @@ bool pipeline::detail::runOnModule(llvm::Module &Module,
   ExecutionContext *Ctx = Analysis.get();
   revng_assert(Ctx != nullptr);
 
+  // Function passes only get a read-only model: memoize the layout of types
+  // across all the functions
+  model::TypeLayoutCache LayoutCache;
+
   // Run the prologue
   auto &ModelWrapper = Pipe.getAnalysis<LoadModelWrapperPass>().get();
   bool Result = Pipe.prologue();
 
+  auto ContainerName = Analysis.getContainerName();
+
+  // Run the function-local analysis phase, if any
+  std::vector<AnalysisResultPointer> AnalysisResults;
+  if (Pipe.isFunctionLocal())
+    AnalysisResults = analyzeFunctions(*Ctx, Module, ContainerName, Pipe);
+
   // Run on individual functions
   using Type = revng::kinds::TaggedFunctionKind;
-  auto ContainerName = Analysis.getContainerName();
   auto ToIterOn = Type::getFunctionsAndCommit(*Ctx, Module, ContainerName);
   llvm::Task T(Ctx->getCurrentRequestedTargets()[ContainerName].size(),
                "Running FunctionPass");
+  size_t Index = 0;
   for (const auto &[ModelFunction, LLVMFunction] : ToIterOn) {
+    // The step will notice the cancellation and discard the module, there's
+    // no need to complete the work on it
+    if (Ctx->isCancellationRequested())
+      return Result;
+
     T.advance(ModelFunction->Entry().toString(), true);
+
+    if (not AnalysisResults.empty())
+      Pipe.setCurrentAnalysisResult(AnalysisResults[Index].get());
+
     Result = Pipe.runOnFunction(*ModelFunction, *LLVMFunction) or Result;
+
+    Pipe.setCurrentAnalysisResult(nullptr);
+    ++Index;
   }
 
   Result = Pipe.epilogue() or Result;
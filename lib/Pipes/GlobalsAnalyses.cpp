@@ -41,7 +41,8 @@ static llvm::Error applyDiffImpl(pipeline::ExecutionContext &Ctx,
   if (auto ApplyError = GlobalClone->applyDiff(Diff); ApplyError)
     return ApplyError;
 
-  if (not GlobalClone->verify()) {
+  // Global is valid, only what Diff has touched needs to be verified again
+  if (not GlobalClone->verify(Diff)) {
     return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                    "could not verify %s",
                                    DiffGlobalName.c_str());
@@ -5,19 +5,46 @@
 //
 
 #include "llvm/IR/DebugInfoMetadata.h"
+#include "llvm/IR/Function.h"
 #include "llvm/IR/Instruction.h"
 
 #include "revng/Pipes/IRHelpers.h"
+#include "revng/Support/IRHelpers.h"
 
-std::optional<pipeline::Location<decltype(revng::ranks::Instruction)>>
-getLocation(const llvm::Instruction *I) {
-  auto MaybeDebugLoc = I->getDebugLoc();
+using Location = pipeline::Location<decltype(revng::ranks::Instruction)>;
+
+static std::optional<Location> fromDebugLoc(const llvm::Instruction &I) {
+  auto MaybeDebugLoc = I.getDebugLoc();
   if (not MaybeDebugLoc or MaybeDebugLoc.getInlinedAt() == nullptr)
     return std::nullopt;
 
-  using Location = pipeline::Location<decltype(revng::ranks::Instruction)>;
   auto Result = Location::fromString(MaybeDebugLoc->getScope()->getName());
   revng_assert(Result);
 
   return Result;
 }
+
+std::optional<Location> getLocation(const llvm::Instruction *I) {
+  if (auto Result = fromDebugLoc(*I))
+    return Result;
+
+  if (I->getFunction()->getMetadata(LightDebugInfoMDName) == nullptr)
+    return std::nullopt;
+
+  // Lightweight debug info: the location is the one of the closest preceding
+  // instruction carrying one
+  for (const llvm::Instruction *Current = I; Current != nullptr;
+       Current = Current->getPrevNode()) {
+    if (auto Result = fromDebugLoc(*Current))
+      return Result;
+
+    if (Current->getMetadata(LocationMDName) != nullptr) {
+      auto Serialized = fromStringMetadata(Current, LocationMDName);
+      auto Result = Location::fromString(Serialized);
+      revng_assert(Result);
+      return Result;
+    }
+  }
+
+  return std::nullopt;
+}
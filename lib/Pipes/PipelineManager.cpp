@@ -7,14 +7,24 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <chrono>
+#include <future>
 #include <list>
 #include <memory>
+#include <optional>
+#include <set>
 #include <string>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Progress.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Support/raw_ostream.h"
@@ -26,6 +36,7 @@
 #include "revng/Pipeline/Runner.h"
 #include "revng/Pipeline/Target.h"
 #include "revng/Pipes/PipelineManager.h"
+#include "revng/Support/Debug.h"
 #include "revng/Support/ResourceFinder.h"
 
 using namespace pipeline;
@@ -38,6 +49,39 @@ static cl::opt<bool> CheckComponentsVersion("check-components-version",
                                                      "don't match"),
                                             cl::init(false));
 
+static cl::opt<bool> UseArtifactCache("artifact-cache",
+                                      cl::desc("Store produced artifacts in a "
+                                               "content-addressed cache in the "
+                                               "execution directory and reuse "
+                                               "them when the inputs match"),
+                                      cl::init(false));
+
+static cl::opt<uint64_t> ContainerMemoryBudget("container-memory-budget",
+                                               cl::desc("Bytes of memory the "
+                                                        "containers can use "
+                                                        "before the least "
+                                                        "recently used ones "
+                                                        "are evicted to the "
+                                                        "execution directory, "
+                                                        "0 means unlimited"),
+                                               cl::init(0));
+
+static cl::opt<std::string> PipelineCache("pipeline-cache",
+                                          cl::desc("Directory where to cache "
+                                                   "the description of the "
+                                                   "loaded pipeline, reused "
+                                                   "by later runs with the "
+                                                   "same components, "
+                                                   "pipelines and enabling "
+                                                   "flags"),
+                                          cl::init(""));
+
+static Logger<> ArtifactCacheLog("artifact-cache");
+static Logger<> PipelineCacheLog("pipeline-cache");
+static Logger<> EvictionLog("container-eviction");
+static Logger<> ShardLog("shards");
+static Logger<> BackgroundSaveLog("background-save");
+
 class LoadModelPipePass {
 private:
   ModelWrapper Wrapper;
@@ -97,7 +141,7 @@ PipelineManager::overrideContainer(llvm::StringRef PipelineFileMapping) {
   auto MaybeMapping = PipelineFileMapping::parse(PipelineFileMapping);
   if (not MaybeMapping)
     return MaybeMapping.takeError();
-  return MaybeMapping->load(*Runner);
+  return overrideContainer(std::move(*MaybeMapping));
 }
 
 static llvm::Error
@@ -209,7 +253,8 @@ PipelineManager::PipelineManager(llvm::ArrayRef<std::string> EnablingFlags,
                                  std::unique_ptr<revng::StorageClient>
                                    &&Client) :
   StorageClient(std::move(Client)),
-  ExecutionDirectory(StorageClient.get(), "") {
+  ExecutionDirectory(StorageClient.get(), ""),
+  MemoryBudget(ContainerMemoryBudget) {
   Context = std::make_unique<llvm::LLVMContext>();
   auto Ctx = setUpContext(*Context);
   PipelineContext = make_unique<pipeline::Context>(std::move(Ctx));
@@ -250,7 +295,8 @@ PipelineManager::createFromMemory(llvm::ArrayRef<std::string> PipelineContent,
 
   Manager.recalculateAllPossibleTargets();
 
-  if (auto Error = Manager.computeDescription(); Error)
+  if (auto Error = Manager.computeDescription(PipelineContent, EnablingFlags);
+      Error)
     return Error;
 
   if (Manager.ExecutionDirectory.isValid()) {
@@ -329,11 +375,22 @@ void PipelineManager::writeAllPossibleTargets(llvm::raw_ostream &OS) const {
   }
 }
 
+PipelineManager::~PipelineManager() {
+  // Nobody is left to handle the error, report it and move on
+  if (auto Error = waitForSave(); Error) {
+    std::string Message = llvm::toString(std::move(Error));
+    revng_log(BackgroundSaveLog, "Background save failed: " << Message);
+  }
+}
+
 llvm::Error PipelineManager::store() {
   // If we are in ephemeral mode (resume was "") then we don't store anything
   if (StorageClient == nullptr)
     return llvm::Error::success();
 
+  if (auto Error = waitForSave(); Error)
+    return Error;
+
   // Run store on the runner, this will serialize all step/containers
   // inside the resume directory
   if (auto Error = Runner->store(ExecutionDirectory); Error)
@@ -343,10 +400,63 @@ llvm::Error PipelineManager::store() {
   return StorageClient->commit();
 }
 
+llvm::Error PipelineManager::storeAsync() {
+  if (StorageClient == nullptr)
+    return llvm::Error::success();
+
+  if (auto Error = waitForSave(); Error)
+    return Error;
+
+  auto MaybeSnapshot = Runner->snapshot(ExecutionDirectory);
+  if (not MaybeSnapshot) {
+    Runner->forgetStored();
+    return MaybeSnapshot.takeError();
+  }
+
+  // Capture nothing that belongs to the manager except the client, which is
+  // owned through a unique_ptr and hence survives moves of the manager
+  auto *Client = StorageClient.get();
+  auto Save = [Client,
+               Snapshot = std::move(*MaybeSnapshot)]() -> llvm::Error {
+    if (auto Error = Snapshot.store(); Error)
+      return Error;
+
+    return Client->commit();
+  };
+  PendingSave = std::async(std::launch::async, std::move(Save));
+
+  return llvm::Error::success();
+}
+
+bool PipelineManager::isSaving() const {
+  if (not PendingSave.valid())
+    return false;
+
+  using namespace std::chrono_literals;
+  return PendingSave.wait_for(0s) != std::future_status::ready;
+}
+
+llvm::Error PipelineManager::waitForSave() {
+  if (not PendingSave.valid())
+    return llvm::Error::success();
+
+  llvm::Error Error = PendingSave.get();
+
+  // The containers have been marked as stored when the save started: make
+  // sure the next store writes them again
+  if (Error)
+    Runner->forgetStored();
+
+  return Error;
+}
+
 llvm::Error PipelineManager::storeStepToDisk(llvm::StringRef StepName) {
   if (StorageClient == nullptr)
     return llvm::Error::success();
 
+  if (auto Error = waitForSave(); Error)
+    return Error;
+
   auto &Step = Runner->getStep(StepName);
   if (auto Error = Runner->storeStepToDisk(StepName, ExecutionDirectory); Error)
     return Error;
@@ -383,6 +493,7 @@ llvm::Error PipelineManager::store(const PipelineFileMapping &Mapping) {
 }
 
 llvm::Error PipelineManager::overrideContainer(PipelineFileMapping Mapping) {
+  InputsDigest.reset();
   return Mapping.load(*Runner);
 }
 
@@ -420,7 +531,7 @@ PipelineManager::invalidateAllPossibleTargets() {
         if (not Containers.contains(Container.first()))
           continue;
 
-        if (not Containers[Container.first()].enumerate().contains(Target))
+        if (not Containers[Container.first()].contains(Target))
           continue;
 
         *Stream << "Invalidating: ";
@@ -494,6 +605,9 @@ PipelineManager::runAnalyses(const pipeline::AnalysesList &List,
 
   recalculateAllPossibleTargets();
 
+  if (auto Error = enforceMemoryBudget(); Error)
+    return std::move(Error);
+
   PipelineContext->bumpCommitIndex();
   return Result;
 }
@@ -515,6 +629,9 @@ PipelineManager::runAnalysis(llvm::StringRef AnalysisName,
 
   recalculateAllPossibleTargets();
 
+  if (auto Error = enforceMemoryBudget(); Error)
+    return std::move(Error);
+
   PipelineContext->bumpCommitIndex();
   return Result;
 }
@@ -530,6 +647,25 @@ PipelineManager::invalidateFromDiff(const llvm::StringRef Name,
   return invalidateAllPossibleTargets();
 }
 
+llvm::Expected<std::vector<llvm::Error>>
+PipelineManager::applyDiffs(llvm::ArrayRef<pipeline::GlobalTupleTreeDiff> Diffs,
+                            TargetInStepSet &Map) {
+  auto Results = Runner->applyDiffs(Diffs, Map);
+  if (not Results)
+    return Results.takeError();
+
+  recalculateAllPossibleTargets();
+
+  if (auto Error = enforceMemoryBudget(); Error) {
+    for (llvm::Error &Result : *Results)
+      llvm::consumeError(std::move(Result));
+    return std::move(Error);
+  }
+
+  PipelineContext->bumpCommitIndex();
+  return Results;
+}
+
 llvm::Error
 PipelineManager::materializeTargets(const llvm::StringRef StepName,
                                     const ContainerToTargetsMap &Map) {
@@ -557,7 +693,47 @@ PipelineManager::materializeTargets(const llvm::StringRef StepName,
   if (auto Error = getRunner().run(StepName, Map); Error)
     return Error;
 
-  return Error::success();
+  return enforceMemoryBudget();
+}
+
+/// Read the list of reads stored by storeReadPaths
+///
+/// \return the list, or nothing if \p Path does not exist
+static llvm::Expected<std::optional<PipelineManager::ReadPaths>>
+loadReadPaths(const revng::FilePath &Path) {
+  auto MaybeExists = Path.exists();
+  if (not MaybeExists)
+    return MaybeExists.takeError();
+  if (not *MaybeExists)
+    return std::nullopt;
+
+  auto MaybeReadableFile = Path.getReadableFile();
+  if (not MaybeReadableFile)
+    return MaybeReadableFile.takeError();
+
+  PipelineManager::ReadPaths Result;
+  llvm::SmallVector<llvm::StringRef, 16> Lines;
+  llvm::StringRef Content = MaybeReadableFile.get()->buffer().getBuffer();
+  Content.split(Lines, '\n', -1, false);
+  for (llvm::StringRef Line : Lines) {
+    auto [GlobalName, SerializedPath] = Line.split('\t');
+    Result.emplace_back(GlobalName.str(), SerializedPath.str());
+  }
+
+  return Result;
+}
+
+/// Store \p Reads in \p Path, one `<global>\t<path>` entry per line
+static llvm::Error storeReadPaths(const revng::FilePath &Path,
+                                  const PipelineManager::ReadPaths &Reads) {
+  auto MaybeWritableFile = Path.getWritableFile();
+  if (not MaybeWritableFile)
+    return MaybeWritableFile.takeError();
+
+  llvm::raw_ostream &OS = MaybeWritableFile.get()->os();
+  for (const auto &[GlobalName, SerializedPath] : Reads)
+    OS << GlobalName << "\t" << SerializedPath << "\n";
+  return MaybeWritableFile.get()->commit();
 }
 
 llvm::Expected<std::unique_ptr<pipeline::ContainerBase>>
@@ -568,21 +744,710 @@ PipelineManager::produceTargets(const llvm::StringRef StepName,
   for (const pipeline::Target &Target : List)
     Targets[TheContainer.second->name()].push_back(Target);
 
+  // The cache is looked up in two steps: the request (which targets, what
+  // inputs) leads to the list of the subtrees of the globals which have been
+  // read the last time it has been served, the request and what is currently
+  // in those subtrees lead to the artifact
+  std::optional<std::string> RequestKey;
+  std::optional<revng::DirectoryPath> CacheDirectory;
+  if (UseArtifactCache and StorageClient != nullptr) {
+    auto MaybeRequestKey = computeRequestKey(StepName, TheContainer, List);
+    if (not MaybeRequestKey)
+      return MaybeRequestKey.takeError();
+    RequestKey = std::move(*MaybeRequestKey);
+
+    CacheDirectory = ExecutionDirectory.getDirectory("artifact-cache");
+    revng::FilePath ReadsPath = CacheDirectory->getFile(*RequestKey
+                                                        + ".reads");
+    auto MaybeReads = loadReadPaths(ReadsPath);
+    if (not MaybeReads)
+      return MaybeReads.takeError();
+
+    if (MaybeReads->has_value()) {
+      std::string Key = computeArtifactKey(*RequestKey, **MaybeReads);
+      revng::FilePath CachePath = CacheDirectory->getFile(Key);
+      auto MaybeExists = CachePath.exists();
+      if (not MaybeExists)
+        return MaybeExists.takeError();
+
+      if (*MaybeExists) {
+        revng_log(ArtifactCacheLog,
+                  "Cache hit for " << TheContainer.second->name()
+                                   << " in step " << StepName.str() << ": "
+                                   << Key);
+        auto Result = TheContainer.second->cloneFiltered({});
+        if (auto Error = Result->loadCached(CachePath); Error)
+          return std::move(Error);
+        return Result;
+      }
+    }
+
+    revng_log(ArtifactCacheLog,
+              "Cache miss for " << TheContainer.second->name() << " in step "
+                                << StepName.str() << ": " << *RequestKey);
+
+    if (auto Error = CacheDirectory->create(); Error)
+      return std::move(Error);
+  }
+
   if (auto Error = materializeTargets(StepName, Targets); Error)
     return Error;
 
+  // The container might have been evicted, or never loaded: in that case only
+  // the requested targets are read
+  const ContainerSet &Containers = Runner->getStep(StepName).containers();
   const auto &ToFilter = Targets.at(TheContainer.second->name());
-  return TheContainer.second->cloneFiltered(ToFilter);
+  auto MaybeResult = Containers.cloneFiltered(TheContainer.first(), ToFilter);
+  if (not MaybeResult)
+    return MaybeResult.takeError();
+  auto Result = std::move(*MaybeResult);
+
+  if (CacheDirectory.has_value()) {
+    // Store the artifact first: the list of reads must never lead to a key
+    // that has not been stored yet
+    ReadPaths Reads = collectReadPaths(StepName);
+    std::string Key = computeArtifactKey(*RequestKey, Reads);
+    if (auto Error = Result->storeCached(CacheDirectory->getFile(Key)); Error)
+      return std::move(Error);
+
+    revng::FilePath ReadsPath = CacheDirectory->getFile(*RequestKey
+                                                        + ".reads");
+    if (auto Error = storeReadPaths(ReadsPath, Reads); Error)
+      return std::move(Error);
+  }
+
+  return Result;
+}
+
+/// \return the name of the side index where produceShard records the files
+///         written for the shard \p Shard of \p ContainerName of \p StepName
+static std::string shardName(llvm::StringRef StepName,
+                             llvm::StringRef ContainerName,
+                             unsigned Shard,
+                             unsigned ShardCount) {
+  return (StepName + "/" + ContainerName + "." + llvm::Twine(Shard) + "-of-"
+          + llvm::Twine(ShardCount))
+    .str();
 }
 
-llvm::Error PipelineManager::computeDescription() {
-  using pipeline::description::PipelineDescription;
-  PipelineDescription Description = getRunner().description();
+/// \return the file where produceShard stores the shard \p Shard of
+///         \p ContainerName in \p Directory
+static revng::FilePath shardFile(const revng::DirectoryPath &Directory,
+                                 llvm::StringRef ContainerName,
+                                 unsigned Shard,
+                                 unsigned ShardCount) {
+  return Directory.getFile((ContainerName + "." + llvm::Twine(Shard) + "-of-"
+                            + llvm::Twine(ShardCount))
+                             .str());
+}
+
+llvm::Error PipelineManager::produceShard(const llvm::StringRef StepName,
+                                          const Container &TheContainer,
+                                          const pipeline::TargetsList &List,
+                                          unsigned Shard,
+                                          unsigned ShardCount) {
+  if (StorageClient == nullptr)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Producing shards requires an execution "
+                                   "directory");
+
+  if (Shard >= ShardCount)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Invalid shard %u of %u",
+                                   Shard,
+                                   ShardCount);
+
+  auto ShardTargets = pipeline::selectShard(List, Shard, ShardCount);
+  revng_log(ShardLog,
+            "Shard " << Shard << " of " << ShardCount << " of "
+                     << TheContainer.second->name() << " has "
+                     << ShardTargets.size() << " targets out of "
+                     << List.size());
+
+  // The artifact cache is not used: on a hit, there would be no record of
+  // what the targets have been produced from to hand over to the coordinator
+  llvm::StringRef ContainerName = TheContainer.second->name();
+  ContainerToTargetsMap Targets;
+  Targets[ContainerName] = ShardTargets;
+  if (auto Error = materializeTargets(StepName, Targets); Error)
+    return Error;
+
+  // An empty shard is stored all the same, so that the coordinator can tell it
+  // apart from a shard which is still missing
+  const Step &Step = Runner->getStep(StepName);
+  auto MaybeResult = Step.containers().cloneFiltered(TheContainer.first(),
+                                                     ShardTargets);
+  if (not MaybeResult)
+    return MaybeResult.takeError();
+
+  revng::DirectoryPath ShardsDirectory = ExecutionDirectory
+                                           .getDirectory("shards");
+  if (auto Error = ShardsDirectory.create(); Error)
+    return Error;
+
+  revng::DirectoryPath StepDirectory = ShardsDirectory.getDirectory(StepName);
+  if (auto Error = StepDirectory.create(); Error)
+    return Error;
+
+  auto Path = shardFile(StepDirectory, ContainerName, Shard, ShardCount);
+  if (auto Error = (*MaybeResult)->storeCached(Path); Error)
+    return Error;
+
+  if (auto Error = Step.storeInvalidationMetadata(Path.addExtension("cache"),
+                                                  ContainerName,
+                                                  (*MaybeResult)->enumerate());
+      Error)
+    return Error;
+
+  // Workers run concurrently: rewriting the index shared with them would drop
+  // what they have committed in the meantime
+  return StorageClient->commitSideIndex(shardName(StepName,
+                                                  ContainerName,
+                                                  Shard,
+                                                  ShardCount));
+}
+
+llvm::Error PipelineManager::mergeShards(const llvm::StringRef StepName,
+                                         llvm::StringRef ContainerName,
+                                         unsigned ShardCount) {
+  if (StorageClient == nullptr)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Merging shards requires an execution "
+                                   "directory");
+
+  if (not Runner->containsStep(StepName))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "No step named %s",
+                                   StepName.str().c_str());
+
+  Step &Step = Runner->getStep(StepName);
+  ContainerSet &Containers = Step.containers();
+  if (not Containers.containsOrCanCreate(ContainerName))
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Step %s has no container named %s",
+                                   StepName.str().c_str(),
+                                   ContainerName.str().c_str());
+
+  revng::DirectoryPath StepDirectory = ExecutionDirectory
+                                         .getDirectory("shards")
+                                         .getDirectory(StepName);
+
+  // Check all the shards are there before touching the container
+  std::vector<revng::FilePath> Paths;
+  for (unsigned Shard = 0; Shard < ShardCount; ++Shard) {
+    auto SideIndex = shardName(StepName, ContainerName, Shard, ShardCount);
+    if (auto Error = StorageClient->mergeSideIndex(SideIndex); Error)
+      return Error;
+
+    Paths.push_back(shardFile(StepDirectory, ContainerName, Shard, ShardCount));
+
+    auto MaybeExists = Paths.back().exists();
+    if (not MaybeExists)
+      return MaybeExists.takeError();
+
+    if (not *MaybeExists)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Shard %u of %u of %s in step %s is "
+                                     "missing",
+                                     Shard,
+                                     ShardCount,
+                                     ContainerName.str().c_str(),
+                                     StepName.str().c_str());
+  }
+
+  for (const revng::FilePath &Path : Paths) {
+    auto MaybePartial = Containers.cloneFiltered(ContainerName, {});
+    if (not MaybePartial)
+      return MaybePartial.takeError();
+
+    if (auto Error = (*MaybePartial)->loadCached(Path); Error)
+      return Error;
+
+    revng::FilePath MetadataPath = Path.addExtension("cache");
+    if (auto Error = Step.replaceInvalidationMetadata(MetadataPath,
+                                                      ContainerName,
+                                                      (*MaybePartial)
+                                                        ->enumerate());
+        Error)
+      return Error;
+
+    Containers[ContainerName].mergeBack(std::move(**MaybePartial));
+  }
+
+  for (const revng::FilePath &Path : Paths) {
+    if (auto Error = Path.remove(); Error)
+      return Error;
+    if (auto Error = Path.addExtension("cache").remove(); Error)
+      return Error;
+  }
+
+  recalculateCurrentState();
+
+  return enforceMemoryBudget();
+}
+
+PipelineManager::AsyncRequest::~AsyncRequest() {
+  if (not Result.valid())
+    return;
+
+  // Nobody is interested in the outcome anymore
+  cancel();
+  llvm::consumeError(wait());
+}
+
+bool PipelineManager::AsyncRequest::isCompleted() const {
+  using namespace std::chrono_literals;
+  return Result.wait_for(0s) == std::future_status::ready;
+}
+
+llvm::Error PipelineManager::AsyncRequest::wait() {
+  revng_assert(Result.valid());
+  return Result.get();
+}
+
+std::string PipelineManager::AsyncRequest::progress() const {
+  std::lock_guard Lock(ProgressMutex);
+  return Progress;
+}
+
+void PipelineManager::AsyncRequest::setProgress(const llvm::TaskStack &Stack) {
+  std::string Buffer;
+  llvm::raw_string_ostream Stream(Buffer);
+  for (const llvm::Task *T : Stack.Tasks) {
+    Stream << T->name();
+    if (auto MaybeStepsCount = T->totalSteps()) {
+      int64_t StepIndex = std::max<int64_t>(0, T->stepIndex());
+      Stream << " (" << StepIndex << "/" << *MaybeStepsCount << ")";
+    }
+
+    if (not T->stepName().empty())
+      Stream << ": " << T->stepName();
+    Stream << "\n";
+  }
+  Stream.flush();
+
+  std::lock_guard Lock(ProgressMutex);
+  Progress = std::move(Buffer);
+}
+
+std::unique_ptr<PipelineManager::AsyncRequest>
+PipelineManager::runAsync(llvm::unique_function<llvm::Error()> Request,
+                          revng::ProgressCallbackScope::Callback OnProgress) {
+  auto Result = std::make_unique<AsyncRequest>();
+
+  // The request is destroyed only after the thread has completed
+  AsyncRequest *Handle = Result.get();
+  pipeline::Context *Ctx = PipelineContext.get();
+  auto Run = [Handle,
+              Ctx,
+              Request = std::move(Request),
+              OnProgress = std::move(OnProgress)]() mutable -> llvm::Error {
+    auto Notify = [Handle, &OnProgress](const llvm::TaskStack &Stack) {
+      Handle->setProgress(Stack);
+      if (OnProgress)
+        OnProgress(Stack);
+    };
+    revng::ProgressCallbackScope Scope(Notify);
+
+    Ctx->setCancellationFlag(&Handle->Cancelled);
+    llvm::Error Error = Request();
+    Ctx->setCancellationFlag(nullptr);
+    return Error;
+  };
+  Handle->Result = std::async(std::launch::async, std::move(Run));
+
+  return Result;
+}
+
+llvm::Expected<PipelineManager::ProducedTargets>
+PipelineManager::produceTargets(const pipeline::Runner::State &Requests) {
+  ProducedTargets Result;
+
+  // Drop the duplicates
+  Runner::State ToProduce;
+  for (const auto &[StepName, Containers] : Requests) {
+    for (const auto &[ContainerName, Targets] : Containers) {
+      TargetsList &Unique = ToProduce[StepName][ContainerName];
+      for (const pipeline::Target &Target : Targets)
+        if (not Unique.contains(Target))
+          Unique.push_back(Target);
+    }
+  }
+
+  // Each artifact has its own entry in the cache: go through the cache one
+  // container at the time
+  if (UseArtifactCache and StorageClient != nullptr) {
+    for (const auto &[StepName, Containers] : ToProduce) {
+      ContainerSet &Set = Runner->getStep(StepName).containers();
+      for (const auto &[ContainerName, Targets] : Containers) {
+        auto It = Set.find(ContainerName);
+        if (It == Set.end())
+          return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                         "Container %s does not exist",
+                                         ContainerName.str().c_str());
+
+        if (auto Error = Set.materialize(ContainerName); Error)
+          return std::move(Error);
+
+        auto MaybeProduced = produceTargets(StepName, *It, Targets);
+        if (not MaybeProduced)
+          return MaybeProduced.takeError();
+
+        Result[StepName][ContainerName] = std::move(*MaybeProduced);
+      }
+    }
+
+    return Result;
+  }
+
+  // Check everything upfront, so that nothing runs if any request is invalid
+  for (const auto &[StepName, Containers] : ToProduce) {
+    if (CurrentState.count(StepName) == 0)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Step %s does not have any targets",
+                                     StepName.str().c_str());
+
+    const auto &StepCurrentState = CurrentState[StepName];
+    for (const auto &[ContainerName, Targets] : Containers) {
+      if (!StepCurrentState.contains(ContainerName))
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       "Container %s does not have any "
+                                       "targets",
+                                       ContainerName.str().c_str());
+
+      const auto &CurrentContainerState = StepCurrentState.at(ContainerName);
+      for (const pipeline::Target &Target : Targets)
+        if (!CurrentContainerState.contains(Target))
+          return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                         "Target %s cannot be produced",
+                                         Target.serialize().c_str());
+    }
+  }
+
+  if (auto Error = getRunner().run(ToProduce); Error)
+    return std::move(Error);
+
+  if (auto Error = enforceMemoryBudget(); Error)
+    return std::move(Error);
+
+  for (const auto &[StepName, Containers] : ToProduce) {
+    const ContainerSet &Set = Runner->getStep(StepName).containers();
+    for (const auto &[ContainerName, Targets] : Containers) {
+      // The container might have been evicted, or never loaded: in that case
+      // only the requested targets are read
+      auto MaybeProduced = Set.cloneFiltered(ContainerName, Targets);
+      if (not MaybeProduced)
+        return MaybeProduced.takeError();
+
+      Result[StepName][ContainerName] = std::move(*MaybeProduced);
+    }
+  }
+
+  return Result;
+}
+
+/// Feed \p Data to \p Hasher prefixed by its size, so that concatenations of
+/// different fields cannot collide
+static void updateField(llvm::SHA1 &Hasher, llvm::StringRef Data) {
+  uint64_t Size = Data.size();
+  Hasher.update(llvm::StringRef(reinterpret_cast<const char *>(&Size),
+                                sizeof(Size)));
+  Hasher.update(Data);
+}
+
+llvm::Expected<std::string> PipelineManager::computeInputsDigest() {
+  uint64_t CommitIndex = PipelineContext->getCommitIndex();
+  if (InputsDigest.has_value() and InputsDigestCommitIndex == CommitIndex)
+    return *InputsDigest;
+
+  // The containers of the first step are the only ones that are not produced
+  // by the pipeline itself
+  const ContainerSet &Inputs = Runner->begin()->containers();
+  std::vector<llvm::StringRef> InputNames;
+  for (const auto &Entry : Inputs)
+    if (Inputs.contains(Entry.first()))
+      InputNames.push_back(Entry.first());
+  llvm::sort(InputNames);
+
+  llvm::SHA1 Hasher;
+  for (llvm::StringRef Name : InputNames) {
+    std::string Serialized;
+    llvm::raw_string_ostream OS(Serialized);
+    if (auto Error = Inputs.at(Name).serialize(OS); Error)
+      return std::move(Error);
+    OS.flush();
+    updateField(Hasher, Name);
+    updateField(Hasher, Serialized);
+  }
+
+  InputsDigest = llvm::toHex(Hasher.final(), true);
+  InputsDigestCommitIndex = CommitIndex;
+  return *InputsDigest;
+}
+
+llvm::Expected<std::string>
+PipelineManager::computeRequestKey(llvm::StringRef StepName,
+                                   const Container &TheContainer,
+                                   const pipeline::TargetsList &List) {
+  auto MaybeInputsDigest = computeInputsDigest();
+  if (not MaybeInputsDigest)
+    return MaybeInputsDigest.takeError();
+
+  llvm::SHA1 Hasher;
+  updateField(Hasher, revng::getComponentsHash());
+  updateField(Hasher, Description);
+  updateField(Hasher, *MaybeInputsDigest);
+
+  // What is being requested
+  updateField(Hasher, StepName);
+  updateField(Hasher, TheContainer.second->name());
+  std::vector<std::string> SerializedTargets;
+  for (const pipeline::Target &Target : List)
+    SerializedTargets.push_back(Target.serialize());
+  llvm::sort(SerializedTargets);
+  for (const std::string &Target : SerializedTargets)
+    updateField(Hasher, Target);
+
+  return llvm::toHex(Hasher.final(), true);
+}
+
+PipelineManager::ReadPaths
+PipelineManager::collectReadPaths(llvm::StringRef StepName) const {
+  ReadPaths Result;
+  for (const pipeline::Global *Global : PipelineContext->getGlobals()) {
+    std::string Name = Global->getName().str();
+
+    // Nothing is recorded in coarse mode: all of the global might matter
+    if (not PipelineContext->isTrackingReadFields()) {
+      Result.emplace_back(Name, "");
+      continue;
+    }
+
+    // What the pipes recorded for all the targets they hold, not only the
+    // requested ones and their dependencies: more than needed, but never less
+    std::set<TupleTreePath> Paths;
+    for (const pipeline::Step &Step : *Runner) {
+      Step.forEachReadPath(Name, [&Paths](const TupleTreePath &Path) {
+        Paths.insert(Path);
+      });
+      if (Step.getName() == StepName)
+        break;
+    }
+
+    // A path sorts right before the ones it's a prefix of, and the hash of
+    // its subtree covers theirs
+    ReadPaths ForGlobal;
+    const TupleTreePath *Last = nullptr;
+    for (const TupleTreePath &Path : Paths) {
+      if (Last != nullptr and Last->isPrefixOf(Path))
+        continue;
+      Last = &Path;
+
+      auto MaybeSerialized = Global->serializePath(Path);
+      if (not MaybeSerialized.has_value()) {
+        ForGlobal = { { Name, "" } };
+        break;
+      }
+      ForGlobal.emplace_back(Name, std::move(*MaybeSerialized));
+    }
+
+    llvm::append_range(Result, ForGlobal);
+  }
+
+  return Result;
+}
+
+std::string PipelineManager::computeArtifactKey(llvm::StringRef RequestKey,
+                                                const ReadPaths &Reads) const {
+  llvm::SHA1 Hasher;
+  updateField(Hasher, RequestKey);
+
+  for (const auto &[GlobalName, SerializedPath] : Reads) {
+    updateField(Hasher, GlobalName);
+    updateField(Hasher, SerializedPath);
+
+    // Subtrees that do not exist are hashed as an empty field, the globals
+    // that do not exist, or no longer do, too
+    std::optional<std::string> Digest;
+    auto MaybeGlobal = PipelineContext->getGlobals().get(GlobalName);
+    if (not MaybeGlobal) {
+      llvm::consumeError(MaybeGlobal.takeError());
+    } else if (SerializedPath.empty()) {
+      Digest = (*MaybeGlobal)->digest(TupleTreePath());
+    } else if (auto Path = (*MaybeGlobal)->deserializePath(SerializedPath)) {
+      Digest = (*MaybeGlobal)->digest(*Path);
+    }
+
+    updateField(Hasher, Digest.value_or(""));
+  }
+
+  return llvm::toHex(Hasher.final(), true);
+}
+
+uint64_t PipelineManager::memoryUsage() const {
+  uint64_t Result = 0;
+  for (const pipeline::Step &Step : *Runner)
+    for (const auto &Entry : Step.containers())
+      Result += Step.containers().memoryUsage(Entry.first());
+  return Result;
+}
+
+llvm::Error PipelineManager::enforceMemoryBudget() {
+  // Evicted containers are stored in the execution directory
+  if (MemoryBudget == 0 or StorageClient == nullptr)
+    return llvm::Error::success();
+
+  // The background save might be copying the files of evicted containers
+  if (auto Error = waitForSave(); Error)
+    return Error;
+
+  struct EvictionCandidate {
+    pipeline::Step *Step;
+    llvm::StringRef ContainerName;
+    uint64_t Size;
+    uint64_t LastAccess;
+  };
+
+  uint64_t Total = 0;
+  std::vector<EvictionCandidate> Candidates;
+  for (pipeline::Step &Step : *Runner) {
+    for (const auto &Entry : Step.containers()) {
+      uint64_t Size = Step.containers().memoryUsage(Entry.first());
+      if (Size == 0)
+        continue;
+
+      Total += Size;
+      Candidates.push_back({ &Step,
+                             Entry.first(),
+                             Size,
+                             Step.containers().getLastAccess(Entry.first()) });
+    }
+  }
+
+  if (Total <= MemoryBudget)
+    return llvm::Error::success();
+
+  revng_log(EvictionLog,
+            "Containers use " << Total << " bytes, the budget is "
+                              << MemoryBudget);
+  LoggerIndent<> Indent(EvictionLog);
+
+  llvm::sort(Candidates, [](const auto &LHS, const auto &RHS) {
+    return LHS.LastAccess < RHS.LastAccess;
+  });
+
+  revng::DirectoryPath EvictedDirectory = ExecutionDirectory
+                                            .getDirectory("evicted");
+  for (const EvictionCandidate &Candidate : Candidates) {
+    if (Total <= MemoryBudget)
+      break;
+
+    revng_log(EvictionLog,
+              "Evicting " << Candidate.ContainerName.str() << " of step "
+                          << Candidate.Step->getName().str() << " ("
+                          << Candidate.Size << " bytes)");
+
+    revng::DirectoryPath StepDirectory = EvictedDirectory.getDirectory(
+      Candidate.Step->getName());
+    if (auto Error = StepDirectory.create(); Error)
+      return Error;
+
+    ContainerSet &Containers = Candidate.Step->containers();
+    if (auto Error = Containers.evict(Candidate.ContainerName, StepDirectory))
+      return Error;
+
+    Total -= Candidate.Size;
+  }
+
+  return llvm::Error::success();
+}
+
+/// \return the name of the file, in the `-pipeline-cache` directory, holding
+///         the description of the pipeline loaded from \p PipelineContent
+static std::string
+getDescriptionCacheFile(llvm::ArrayRef<std::string> PipelineContent,
+                        llvm::ArrayRef<std::string> EnablingFlags) {
+  llvm::SHA1 Hasher;
+  auto Update = [&Hasher](llvm::StringRef Data) {
+    uint64_t Size = Data.size();
+    Hasher.update(llvm::StringRef(reinterpret_cast<const char *>(&Size),
+                                  sizeof(Size)));
+    Hasher.update(Data);
+  };
+
+  // The components determine which pipes, kinds and containers are available
+  Update(revng::getComponentsHash());
+
+  Update(std::to_string(PipelineContent.size()));
+  for (const std::string &Pipeline : PipelineContent)
+    Update(Pipeline);
+
+  Update(std::to_string(EnablingFlags.size()));
+  for (const std::string &Flag : EnablingFlags)
+    Update(Flag);
+
+  llvm::SmallString<128> Path(PipelineCache);
+  llvm::sys::path::append(Path, llvm::toHex(Hasher.final(), true) + ".yml");
+  return Path.str().str();
+}
+
+/// Atomically writes \p Description in \p Path, failures are not fatal
+static void writeDescriptionCacheFile(llvm::StringRef Path,
+                                      llvm::StringRef Description) {
+  auto Fail = [Path](std::error_code EC) {
+    revng_log(PipelineCacheLog,
+              "Could not write " << Path << ": " << EC.message());
+  };
+
+  if (auto EC = llvm::sys::fs::create_directories(PipelineCache); EC)
+    return Fail(EC);
+
+  // Other processes might be reading the file or writing it at the same time
+  int FD = -1;
+  llvm::SmallString<128> Temporary;
+  auto EC = llvm::sys::fs::createUniqueFile(Path + "-%%%%%%%%", FD, Temporary);
+  if (EC)
+    return Fail(EC);
 
   {
-    llvm::raw_string_ostream OS(this->Description);
-    yaml::Output YAMLOutput(OS);
-    YAMLOutput << Description;
+    llvm::raw_fd_ostream OS(FD, true);
+    OS << Description;
+  }
+
+  if (auto EC = llvm::sys::fs::rename(Temporary, Path); EC) {
+    llvm::sys::fs::remove(Temporary);
+    return Fail(EC);
+  }
+}
+
+llvm::Error
+PipelineManager::computeDescription(llvm::ArrayRef<std::string> PipelineContent,
+                                    llvm::ArrayRef<std::string> EnablingFlags) {
+  std::string CacheFile;
+  if (not PipelineCache.empty())
+    CacheFile = getDescriptionCacheFile(PipelineContent, EnablingFlags);
+
+  std::unique_ptr<llvm::MemoryBuffer> Cached;
+  if (not CacheFile.empty())
+    if (auto MaybeCached = llvm::MemoryBuffer::getFile(CacheFile))
+      Cached = std::move(*MaybeCached);
+
+  if (Cached) {
+    revng_log(PipelineCacheLog, "Using the description in " << CacheFile);
+    this->Description = Cached->getBuffer().str();
+  } else {
+    using pipeline::description::PipelineDescription;
+    PipelineDescription Description = getRunner().description();
+
+    this->Description.clear();
+    {
+      llvm::raw_string_ostream OS(this->Description);
+      yaml::Output YAMLOutput(OS);
+      YAMLOutput << Description;
+    }
+
+    if (not CacheFile.empty())
+      writeDescriptionCacheFile(CacheFile, this->Description);
   }
 
   if (StorageClient == nullptr)
@@ -593,6 +1458,21 @@ llvm::Error PipelineManager::computeDescription() {
 
   constexpr auto DescriptionName = "pipeline-description.yml";
   revng::FilePath DescriptionPath = ExecutionDirectory.getFile(DescriptionName);
+
+  // Avoid rewriting, and possibly uploading, the same description every time
+  auto MaybeExists = DescriptionPath.exists();
+  if (not MaybeExists)
+    return MaybeExists.takeError();
+
+  if (MaybeExists.get()) {
+    auto MaybeReadableFile = DescriptionPath.getReadableFile();
+    if (not MaybeReadableFile)
+      return MaybeReadableFile.takeError();
+
+    if (MaybeReadableFile.get()->buffer().getBuffer() == this->Description)
+      return llvm::Error::success();
+  }
+
   auto MaybeWritableFile = DescriptionPath.getWritableFile();
   if (!MaybeWritableFile)
     return MaybeWritableFile.takeError();
@@ -609,5 +1489,8 @@ PipelineManager::setStorageCredentials(llvm::StringRef Credentials) {
                                    "Client missing");
   }
 
+  if (auto Error = waitForSave(); Error)
+    return Error;
+
   return StorageClient->setCredentials(Credentials);
 }
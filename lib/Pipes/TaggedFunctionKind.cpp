@@ -9,6 +9,7 @@
 #include <string>
 
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/ScopeExit.h"
 
 #include "revng/Model/Binary.h"
 #include "revng/Model/IRHelpers.h"
@@ -42,9 +43,11 @@ TaggedFunctionKind::symbolToTarget(const llvm::Function &Symbol) const {
 void TaggedFunctionKind::appendAllTargets(const pipeline::Context &Ctx,
                                           pipeline::TargetsList &Out) const {
   const auto &Model = getModelFromContext(Ctx);
-  for (const auto &Function : Model->Functions()) {
-    Out.push_back(Target(Function.Entry().toString(), *this));
-  }
+  pipeline::TargetsList::List Targets;
+  Targets.reserve(Model->Functions().size());
+  for (const auto &Function : Model->Functions())
+    Targets.emplace_back(Function.Entry().toString(), *this);
+  Out.append(std::move(Targets));
 }
 
 cppcoro::generator<std::pair<const model::Function *, llvm::Function *>>
@@ -63,6 +66,12 @@ TaggedFunctionKind::getFunctionsAndCommit(pipeline::ExecutionContext &Context,
   }
   auto &Binary = getModelFromContext(Context);
 
+  // Commit what has been produced even if the caller stops early
+  CommitBatch Batch;
+  auto CommitOnExit = llvm::make_scope_exit([&] {
+    Context.commitBatch(Batch);
+  });
+
   for (const Target &Target :
        Context.getCurrentRequestedTargets()[ContainerName]) {
     auto MetaAddress = MetaAddress::fromString(Target.getPathComponents()[0]);
@@ -77,7 +86,7 @@ TaggedFunctionKind::getFunctionsAndCommit(pipeline::ExecutionContext &Context,
     else
       co_yield std::pair<const model::Function *,
                          llvm::Function *>(&ModelFunction, Iter->second);
-    Context.commit(Target, ContainerName);
+    Context.record(Batch, Target, ContainerName);
 
     Context.getContext().popReadFields();
   }
@@ -88,6 +97,13 @@ TaggedFunctionKind::getFunctionsAndCommit(pipeline::ExecutionContext &Context,
                                           const pipeline::ContainerBase
                                             &Container) {
   auto &Binary = getModelFromContext(Context);
+
+  // Commit what has been produced even if the caller stops early
+  CommitBatch Batch;
+  auto CommitOnExit = llvm::make_scope_exit([&] {
+    Context.commitBatch(Batch);
+  });
+
   for (const Target &Target :
        Context.getCurrentRequestedTargets()[Container.name()]) {
 
@@ -96,7 +112,7 @@ TaggedFunctionKind::getFunctionsAndCommit(pipeline::ExecutionContext &Context,
     auto MetaAddress = MetaAddress::fromString(Target.getPathComponents()[0]);
     co_yield &Binary->Functions().at(MetaAddress);
 
-    Context.commit(Target, Container);
+    Context.record(Batch, Target, Container.name());
 
     Context.getContext().popReadFields();
   }
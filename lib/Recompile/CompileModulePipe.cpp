@@ -6,17 +6,29 @@
 //
 
 #include <memory>
+#include <string>
+#include <vector>
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/CodeGen/CommandFlags.h"
 #include "llvm/CodeGen/MachineModuleInfo.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/MC/TargetRegistry.h"
 #include "llvm/Option/OptTable.h"
 #include "llvm/Support/CodeGen.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/SplitModule.h"
 
 #include "revng/Pipeline/AllRegistries.h"
 #include "revng/Pipeline/LLVMContainer.h"
@@ -24,9 +36,12 @@
 #include "revng/Pipes/Kinds.h"
 #include "revng/Recompile/CompileModulePipe.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
 #include "revng/Support/IRAnnotators.h"
 #include "revng/Support/IRHelpers.h"
 #include "revng/Support/OriginalAssemblyAnnotationWriter.h"
+#include "revng/Support/ProgramRunner.h"
+#include "revng/Support/TemporaryFile.h"
 
 using namespace llvm;
 using namespace llvm::codegen;
@@ -44,115 +59,266 @@ static cl::opt<char> OptLevel("compile-opt-level",
                               cl::ZeroOrMore,
                               cl::init(' '));
 
-static void compileModuleRunImpl(const Context &Ctx,
-                                 LLVMContainer &Module,
-                                 ObjectFileContainer &TargetBinary) {
-  using namespace revng;
-
-  auto Enumeration = Module.enumerate();
-  if (not Enumeration.contains(pipeline::Target(kinds::Root))
-      and not Enumeration.contains(pipeline::Target(kinds::IsolatedRoot)))
-    return;
-
-  if (Enumeration.contains(pipeline::Target(kinds::IsolatedRoot))
-      and not Enumeration.contains(kinds::Isolated.allTargets(Ctx)))
-    return;
-
-  StringMap<llvm::cl::Option *> &RegOptions(getRegisteredOptions());
-  getOption<bool>(RegOptions, "disable-machine-licm")->setInitialValue(true);
+static cl::opt<unsigned> Partitions("compile-partitions",
+                                    cl::desc("Number of partitions to split "
+                                             "the module into, to compile "
+                                             "them in parallel and cache "
+                                             "them separately"),
+                                    cl::init(1));
 
-  llvm::Module *M = &Module.getModule();
+static cl::opt<std::string> CompileCache("compile-cache",
+                                          cl::desc("directory where to cache "
+                                                   "the object files of the "
+                                                   "compiled partitions"),
+                                          cl::value_desc("directory"));
 
-  OriginalAssemblyAnnotationWriter OAAW(M->getContext());
-  createSelfReferencingDebugInfo(M, Module.name(), &OAAW);
+static Logger<> Log("compile-module");
 
-  // Get the target specific parser.
-  std::string Error;
-  Triple TheTriple(M->getTargetTriple());
-  const auto *TheTarget = TargetRegistry::lookupTarget("", TheTriple, Error);
-  revng_assert(TheTarget);
-
-  TargetOptions Options = InitTargetOptionsFromCodeGenFlags(TheTriple);
-
-  CodeGenOpt::Level OLvl = CodeGenOpt::Default;
+static CodeGenOpt::Level getOptLevel() {
   switch (OptLevel) {
   case ' ':
-    break;
+    return CodeGenOpt::Default;
   case '0':
-    OLvl = CodeGenOpt::None;
-    break;
+    return CodeGenOpt::None;
   case '1':
-    OLvl = CodeGenOpt::Less;
-    break;
+    return CodeGenOpt::Less;
   case '2':
-    OLvl = CodeGenOpt::Default;
-    break;
+    return CodeGenOpt::Default;
   case '3':
-    OLvl = CodeGenOpt::Aggressive;
-    break;
+    return CodeGenOpt::Aggressive;
   default:
     revng_abort("Wrong Optimization Level");
-    return;
   }
+}
+
+static unique_ptr<TargetMachine> createTargetMachine(const Module &M) {
+  // Get the target specific parser.
+  std::string Error;
+  Triple TheTriple(M.getTargetTriple());
+  const auto *TheTarget = TargetRegistry::lookupTarget("", TheTriple, Error);
+  revng_assert(TheTarget);
+
+  TargetOptions Options = InitTargetOptionsFromCodeGenFlags(TheTriple);
 
   auto Ptr = TheTarget->createTargetMachine(TheTriple.getTriple(),
                                             "",
                                             "",
                                             Options,
                                             getRelocModel(),
-                                            M->getCodeModel(),
-                                            OLvl);
-  unique_ptr<TargetMachine> Target(Ptr);
-
-  // Add the target data from the target machine, if it exists, or the module.
-  M->setDataLayout(Target->createDataLayout());
-
-  // This needs to be done after setting datalayout since it calls verifier
-  // to check debug info whereas verifier relies on correct datalayout.
-  UpgradeDebugInfo(*M);
+                                            M.getCodeModel(),
+                                            getOptLevel());
+  return unique_ptr<TargetMachine>(Ptr);
+}
 
-  LLVMTargetMachine &LLVMTM = static_cast<LLVMTargetMachine &>(*Target);
+/// Emit the object file for \p M in \p OutputPath
+static void emitObjectFile(TargetMachine &Target,
+                           Module &M,
+                           StringRef OutputPath) {
+  LLVMTargetMachine &LLVMTM = static_cast<LLVMTargetMachine &>(Target);
   auto *MMIWP = new MachineModuleInfoWrapperPass(&LLVMTM);
 
   std::error_code EC;
-  raw_fd_ostream OutputStream(TargetBinary.getOrCreatePath(), EC);
+  raw_fd_ostream OutputStream(OutputPath, EC);
   revng_assert(!EC);
 
   // Create pass manager
   legacy::PassManager PM;
 
   // Add an appropriate TargetLibraryInfo pass for the module's triple.
-  TargetLibraryInfoImpl TLII(Triple(M->getTargetTriple()));
+  TargetLibraryInfoImpl TLII(Triple(M.getTargetTriple()));
   PM.add(new TargetLibraryInfoWrapperPass(TLII));
 
-  bool Err = Target->addPassesToEmitFile(PM,
-                                         OutputStream,
-                                         nullptr,
-                                         CGFT_ObjectFile,
-                                         true,
-                                         MMIWP);
+  bool Err = Target.addPassesToEmitFile(PM,
+                                        OutputStream,
+                                        nullptr,
+                                        CGFT_ObjectFile,
+                                        true,
+                                        MMIWP);
   revng_assert(not Err);
-  revng::verify(M);
-  PM.run(*M);
-  revng::verify(M);
+  revng::verify(&M);
+  PM.run(M);
+  revng::verify(&M);
+}
+
+/// \return the path where the object file for the module serialized in \p
+///         Bitcode is cached, or an empty string if caching is disabled
+static std::string getCachedObjectPath(StringRef Bitcode) {
+  if (CompileCache.empty())
+    return {};
+
+  // The bitcode includes the triple, the rest depends on the options and on
+  // the compiler itself
+  SHA1 Hasher;
+  Hasher.update(Bitcode);
+  Hasher.update(std::to_string(getOptLevel()));
+  if (auto RelocModel = getRelocModel())
+    Hasher.update(std::to_string(*RelocModel));
+  Hasher.update(LLVM_VERSION_STRING);
+  std::string Hash = toHex(Hasher.final(), true);
+
+  SmallString<128> Result(CompileCache);
+  path::append(Result, "object-" + Hash + ".o");
+  return Result.str().str();
+}
+
+/// Copy \p Object in the cache in \p CachePath, atomically since other
+/// processes might be compiling at the same time
+static void writeCachedObject(StringRef Object, StringRef CachePath) {
+  auto Fail = [&CachePath](std::error_code EC) {
+    revng_log(Log, "Could not write " << CachePath << ": " << EC.message());
+  };
+
+  if (auto EC = fs::create_directories(path::parent_path(CachePath)))
+    return Fail(EC);
+
+  SmallString<128> Temporary;
+  if (auto EC = fs::createUniqueFile(CachePath + "-%%%%%%%%", Temporary))
+    return Fail(EC);
+
+  if (auto EC = fs::copy_file(Object, Temporary)) {
+    fs::remove(Temporary);
+    return Fail(EC);
+  }
+
+  if (auto EC = fs::rename(Temporary, CachePath)) {
+    fs::remove(Temporary);
+    return Fail(EC);
+  }
+}
+
+/// Split \p M in \p PartitionsCount modules, compile them in parallel and
+/// merge the resulting object files in \p OutputPath with a relocatable link
+static llvm::Error emitPartitionedObjectFile(Module &M,
+                                             StringRef OutputPath,
+                                             unsigned PartitionsCount) {
+  // Partitions are moved to a new LLVMContext each, since an LLVMContext
+  // cannot be used from multiple threads. Do it through bitcode, as LLVM's
+  // own parallel code generation does.
+  std::vector<SmallString<0>> Bitcodes;
+  auto SerializePartition = [&Bitcodes](unique_ptr<Module> Partition) {
+    raw_svector_ostream OS(Bitcodes.emplace_back());
+    WriteBitcodeToFile(*Partition, OS);
+  };
+  SplitModule(M, PartitionsCount, SerializePartition);
+
+  std::vector<TemporaryFile> Objects;
+  Objects.reserve(Bitcodes.size());
+  for (size_t I = 0; I < Bitcodes.size(); ++I)
+    Objects.emplace_back("revng-compile-partition-" + Twine(I), "o");
+
+  auto CompilePartition = [&Bitcodes, &Objects](size_t Index) {
+    StringRef Bitcode(Bitcodes[Index].data(), Bitcodes[Index].size());
+    StringRef ObjectPath = Objects[Index].path();
+
+    // Partitions that have not changed since the last time they have been
+    // compiled are taken from the cache
+    std::string CachePath = getCachedObjectPath(Bitcode);
+    if (not CachePath.empty() and fs::exists(CachePath)) {
+      if (not fs::copy_file(CachePath, ObjectPath)) {
+        revng_log(Log, "Using the cached object file " << CachePath);
+        return;
+      }
+    }
+
+    LLVMContext PartitionContext;
+    MemoryBufferRef Buffer(Bitcode, "partition");
+    auto Partition = cantFail(parseBitcodeFile(Buffer, PartitionContext));
+    unique_ptr<TargetMachine> Target = createTargetMachine(*Partition);
+    emitObjectFile(*Target, *Partition, ObjectPath);
+
+    if (not CachePath.empty())
+      writeCachedObject(ObjectPath, CachePath);
+  };
+
+  {
+    ThreadPool Pool(hardware_concurrency(PartitionsCount));
+    for (size_t I = 0; I < Bitcodes.size(); ++I)
+      Pool.async(CompilePartition, I);
+    Pool.wait();
+  }
+
+  std::vector<std::string> Arguments = { "-r", "-o", OutputPath.str() };
+  for (const TemporaryFile &Object : Objects)
+    Arguments.push_back(Object.path().str());
+  if (int ExitCode = ::Runner.run("ld.bfd", Arguments); ExitCode != 0) {
+    return createStringError(inconvertibleErrorCode(),
+                             "Could not link the compiled partitions: ld.bfd "
+                             "exited with code %d",
+                             ExitCode);
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::Error revng::pipes::compileToObjectFile(Module &M,
+                                              StringRef OutputPath,
+                                              unsigned PartitionsCount) {
+  unique_ptr<TargetMachine> Target = createTargetMachine(M);
+
+  // Add the target data from the target machine, if it exists, or the module.
+  M.setDataLayout(Target->createDataLayout());
+
+  // This needs to be done after setting datalayout since it calls verifier
+  // to check debug info whereas verifier relies on correct datalayout.
+  UpgradeDebugInfo(M);
+
+  // Caching works at the granularity of partitions
+  if (PartitionsCount > 1 or not CompileCache.empty()) {
+    // Each partition is compiled by a TargetMachine of its own
+    Target.reset();
+    revng::verify(&M);
+    return emitPartitionedObjectFile(M, OutputPath, PartitionsCount);
+  }
+
+  emitObjectFile(*Target, M, OutputPath);
+  return llvm::Error::success();
+}
+
+static llvm::Error compileModuleRunImpl(const Context &Ctx,
+                                        LLVMContainer &Module,
+                                        ObjectFileContainer &TargetBinary) {
+  using namespace revng;
+
+  auto Enumeration = Module.enumerate();
+  if (not Enumeration.contains(pipeline::Target(kinds::Root))
+      and not Enumeration.contains(pipeline::Target(kinds::IsolatedRoot)))
+    return llvm::Error::success();
+
+  if (Enumeration.contains(pipeline::Target(kinds::IsolatedRoot))
+      and not Enumeration.contains(kinds::Isolated.allTargets(Ctx)))
+    return llvm::Error::success();
+
+  StringMap<llvm::cl::Option *> &RegOptions(getRegisteredOptions());
+  getOption<bool>(RegOptions, "disable-machine-licm")->setInitialValue(true);
+
+  llvm::Module *M = &Module.getModule();
+
+  OriginalAssemblyAnnotationWriter OAAW(M->getContext());
+  createSelfReferencingDebugInfo(M, Module.name(), &OAAW);
+
+  if (auto Error = compileToObjectFile(*M,
+                                       TargetBinary.getOrCreatePath(),
+                                       Partitions))
+    return Error;
 
   auto Path = TargetBinary.path();
 
   auto Permissions = cantFail(errorOrToExpected(fs::getPermissions(*Path)));
   Permissions = Permissions | fs::owner_exe;
   fs::setPermissions(*TargetBinary.path(), Permissions);
+  return llvm::Error::success();
 }
 
-void CompileModule::run(const ExecutionContext &Ctx,
-                        LLVMContainer &Module,
-                        ObjectFileContainer &TargetBinary) {
-  compileModuleRunImpl(Ctx.getContext(), Module, TargetBinary);
+llvm::Error CompileModule::run(const ExecutionContext &Ctx,
+                               LLVMContainer &Module,
+                               ObjectFileContainer &TargetBinary) {
+  return compileModuleRunImpl(Ctx.getContext(), Module, TargetBinary);
 }
 
-void CompileIsolatedModule::run(const ExecutionContext &Ctx,
-                                LLVMContainer &Module,
-                                ObjectFileContainer &TargetBinary) {
-  compileModuleRunImpl(Ctx.getContext(), Module, TargetBinary);
+llvm::Error CompileIsolatedModule::run(const ExecutionContext &Ctx,
+                                       LLVMContainer &Module,
+                                       ObjectFileContainer &TargetBinary) {
+  return compileModuleRunImpl(Ctx.getContext(), Module, TargetBinary);
 }
 
 static RegisterPipe<CompileModule> E2;
@@ -8,30 +8,52 @@
 #include <vector>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallString.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/Regex.h"
 #include "llvm/Support/StringSaver.h"
+#include "llvm/Support/Threading.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/raw_sha1_ostream.h"
 
 #include "revng/Model/Importer/Binary/Options.h"
 #include "revng/Model/LoadModelPass.h"
 #include "revng/Model/RawBinaryView.h"
 #include "revng/Recompile/LinkForTranslation.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
 #include "revng/Support/PathList.h"
 #include "revng/Support/ProgramRunner.h"
 #include "revng/Support/ResourceFinder.h"
 #include "revng/Support/TemporaryFile.h"
+#include "revng/TupleTree/Binary.h"
 
 using namespace llvm;
 using namespace llvm::sys;
 
+static cl::opt<std::string> LinkerName("translate-linker",
+                                       cl::desc("linker used to produce the "
+                                                "translated binary, ld.lld "
+                                                "runs with --threads"),
+                                       cl::init("ld.bfd"));
+
+static cl::opt<std::string> LinkCache("link-cache",
+                                      cl::desc("directory where to cache the "
+                                               "translated binaries"),
+                                      cl::value_desc("directory"));
+
+static Logger<> Log("link-for-translation");
+
 static std::string linkFunctionArgument(llvm::StringRef Lib) {
   auto LastSlash = Lib.rfind('/');
   if (LastSlash != llvm::StringRef::npos)
@@ -164,7 +186,12 @@ static CommandList linkingArgs(const model::Binary &Model,
   llvm::MemoryBuffer &Buffer = **MaybeBuffer;
   RawBinaryView BinaryView(Model, Buffer.getBuffer());
 
-  Command Linker("ld.bfd");
+  Command Linker(LinkerName);
+
+  if (StringRef(LinkerName).endswith("lld")) {
+    auto Threads = llvm::hardware_concurrency().compute_thread_count();
+    Linker.Arguments.push_back("--threads=" + std::to_string(Threads));
+  }
 
   // Parse options from environment variable.
   if (auto EnvValue = sys::Process::GetEnv("REVNG_TRANSLATE_LDFLAGS")) {
@@ -314,15 +341,88 @@ static CommandList linkingArgs(const model::Binary &Model,
   return Result;
 }
 
+/// \return the path where the result of linking \p ObjectFile for \p
+///         InputBinary is cached, or an empty string if caching is disabled
+static std::string getCachedLinkPath(const model::Binary &Model,
+                                     llvm::StringRef InputBinary,
+                                     llvm::StringRef ObjectFile) {
+  if (LinkCache.empty())
+    return {};
+
+  raw_sha1_ostream Hasher;
+  for (StringRef Input : { InputBinary, ObjectFile }) {
+    auto MaybeBuffer = MemoryBuffer::getFile(Input);
+    if (not MaybeBuffer) {
+      revng_log(Log, "Cannot read " << Input << ", not caching the link");
+      return {};
+    }
+    StringRef Contents = (*MaybeBuffer)->getBuffer();
+    Hasher << Contents.size() << '\0' << Contents;
+  }
+
+  // Everything else affecting the commands
+  tupletree::binary::serialize(Hasher, Model);
+  Hasher << StringRef(LinkerName) << '\0';
+  if (auto EnvValue = sys::Process::GetEnv("REVNG_TRANSLATE_LDFLAGS"))
+    Hasher << *EnvValue;
+  Hasher << '\0';
+  if (BaseAddress.getNumOccurrences() > 0)
+    Hasher << BaseAddress.getValue();
+
+  std::string Hash = toHex(Hasher.sha1(), true);
+  SmallString<128> Result(LinkCache);
+  sys::path::append(Result, "translated-" + Hash);
+  return Result.str().str();
+}
+
+/// Copy \p Binary in the cache in \p CachePath, atomically since other
+/// processes might be linking at the same time
+static void writeCachedLink(StringRef Binary, StringRef CachePath) {
+  auto Fail = [&CachePath](std::error_code EC) {
+    revng_log(Log, "Could not write " << CachePath << ": " << EC.message());
+  };
+
+  if (auto EC = sys::fs::create_directories(sys::path::parent_path(CachePath)))
+    return Fail(EC);
+
+  SmallString<128> Temporary;
+  if (auto EC = sys::fs::createUniqueFile(CachePath + "-%%%%%%%%", Temporary))
+    return Fail(EC);
+
+  if (auto EC = sys::fs::copy_file(Binary, Temporary)) {
+    sys::fs::remove(Temporary);
+    return Fail(EC);
+  }
+
+  if (auto EC = sys::fs::rename(Temporary, CachePath)) {
+    sys::fs::remove(Temporary);
+    return Fail(EC);
+  }
+}
+
 void linkForTranslation(const model::Binary &Model,
                         llvm::StringRef InputBinary,
                         llvm::StringRef ObjectFile,
                         llvm::StringRef OutputBinary) {
+  // Skip linking altogether if we already linked the same inputs
+  std::string CachePath = getCachedLinkPath(Model, InputBinary, ObjectFile);
+  if (not CachePath.empty() and sys::fs::exists(CachePath)
+      and not sys::fs::copy_file(CachePath, OutputBinary)) {
+    revng_log(Log, "Using the cached translated binary " << CachePath);
+    auto Permissions = sys::fs::getPermissions(OutputBinary);
+    revng_check(Permissions);
+    sys::fs::setPermissions(OutputBinary, *Permissions | sys::fs::all_exe);
+    return;
+  }
+
   CommandList Commands = linkingArgs(Model,
                                      InputBinary,
                                      ObjectFile,
                                      OutputBinary);
   Commands.run();
+
+  if (not CachePath.empty())
+    writeCachedLink(OutputBinary, CachePath);
 }
 
 void printLinkForTranslationCommands(llvm::raw_ostream &OS,
@@ -5,6 +5,12 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/Process.h"
+
 #include "revng/Support/PathList.h"
 
 #include "LocalFile.h"
@@ -13,6 +19,156 @@
 
 namespace revng {
 
+namespace fs = llvm::sys::fs;
+
+static Logger<> Log("local-storage-journal");
+
+/// The generations in use by this process. Locks do not tell them apart, since
+/// they are held by the process as a whole.
+static std::mutex GenerationsMutex;
+static llvm::StringSet<> GenerationsInUse;
+
+static constexpr auto JournalName = "journal";
+static constexpr auto LockName = "lock";
+
+/// Makes sure what has been written to \p OS survives a crash of the system
+static void syncFile(llvm::raw_fd_ostream &OS) {
+  OS.flush();
+  ::fsync(OS.get_fd());
+}
+
+/// Makes sure the entries of the directory \p Path survive a crash of the
+/// system
+static void syncDirectory(llvm::StringRef Path) {
+  auto MaybeFD = fs::openNativeFileForRead(Path);
+  if (not MaybeFD) {
+    llvm::consumeError(MaybeFD.takeError());
+    return;
+  }
+
+  ::fsync(*MaybeFD);
+  fs::closeFile(*MaybeFD);
+}
+
+/// Writes a file in the current generation, see LocalStorageClient::stage
+class LocalStagedWritableFile : public WritableFile {
+private:
+  LocalStorageClient &Client;
+  std::string StagedPath;
+  std::string Path;
+  std::unique_ptr<llvm::raw_fd_ostream> OS;
+  bool Committed = false;
+
+public:
+  LocalStagedWritableFile(LocalStorageClient &Client,
+                          llvm::StringRef StagedPath,
+                          llvm::StringRef Path,
+                          std::unique_ptr<llvm::raw_fd_ostream> &&OS) :
+    Client(Client),
+    StagedPath(StagedPath.str()),
+    Path(Path.str()),
+    OS(std::move(OS)) {}
+
+  ~LocalStagedWritableFile() override {
+    if (not Committed) {
+      OS.reset();
+      fs::remove(StagedPath);
+    }
+  }
+
+  llvm::raw_pwrite_stream &os() override { return *OS; }
+
+  llvm::Error commit() override {
+    revng_assert(not Committed);
+    Committed = true;
+
+    syncFile(*OS);
+    OS->close();
+    if (OS->has_error()) {
+      std::error_code EC = OS->error();
+      OS->clear_error();
+      fs::remove(StagedPath);
+      return llvm::createStringError(EC,
+                                     "Could not write file %s",
+                                     Path.c_str());
+    }
+
+    Client.stage(Path, StagedPath);
+    return llvm::Error::success();
+  }
+};
+
+/// Writes a file among the blobs, see LocalStorageClient::storeBlob
+class LocalBlobWritableFile : public WritableFile {
+private:
+  LocalStorageClient &Client;
+  std::string TemporaryPath;
+  std::string Destination;
+  std::unique_ptr<llvm::raw_fd_ostream> OS;
+  bool Committed = false;
+
+public:
+  LocalBlobWritableFile(LocalStorageClient &Client,
+                        llvm::StringRef TemporaryPath,
+                        llvm::StringRef Destination,
+                        std::unique_ptr<llvm::raw_fd_ostream> &&OS) :
+    Client(Client),
+    TemporaryPath(TemporaryPath.str()),
+    Destination(Destination.str()),
+    OS(std::move(OS)) {}
+
+  ~LocalBlobWritableFile() override {
+    if (not Committed) {
+      OS.reset();
+      fs::remove(TemporaryPath);
+    }
+  }
+
+  llvm::raw_pwrite_stream &os() override { return *OS; }
+
+  llvm::Error commit() override {
+    revng_assert(not Committed);
+    Committed = true;
+
+    if (Client.Journal)
+      syncFile(*OS);
+    OS->close();
+    if (OS->has_error()) {
+      std::error_code EC = OS->error();
+      OS->clear_error();
+      fs::remove(TemporaryPath);
+      return llvm::createStringError(EC,
+                                     "Could not write file %s",
+                                     Destination.c_str());
+    }
+
+    return Client.storeBlob(TemporaryPath, Destination);
+  }
+};
+
+/// Makes \p Destination a hard link to \p Source, atomically replacing it if
+/// it exists. Falls back to copying if the two are on different filesystems.
+static llvm::Error replaceWithLink(llvm::StringRef Source,
+                                   llvm::StringRef Destination) {
+  unsigned Random = llvm::sys::Process::GetRandomNumber();
+  std::string Temporary = Destination.str() + ".link-" + std::to_string(Random);
+  std::error_code EC = fs::create_hard_link(Source, Temporary);
+  if (EC)
+    EC = fs::copy_file(Source, Temporary);
+  if (not EC)
+    EC = fs::rename(Temporary, Destination);
+
+  if (EC) {
+    fs::remove(Temporary);
+    return llvm::createStringError(EC,
+                                   "Could not link %s to %s",
+                                   Destination.str().c_str(),
+                                   Source.str().c_str());
+  }
+
+  return llvm::Error::success();
+}
+
 std::string LocalStorageClient::resolvePath(llvm::StringRef Path) {
   if (Path.empty()) {
     return Root;
@@ -22,17 +178,52 @@ std::string LocalStorageClient::resolvePath(llvm::StringRef Path) {
   }
 }
 
-LocalStorageClient::LocalStorageClient(llvm::StringRef Root) :
-  Root(Root.str()) {
+std::string LocalStorageClient::resolvePathForReading(llvm::StringRef Path) {
+  if (Journal) {
+    std::lock_guard Lock(StagingMutex);
+    if (auto It = Staged.find(Path); It != Staged.end())
+      return It->second;
+  }
+
+  return resolvePath(Path);
+}
+
+LocalStorageClient::LocalStorageClient(llvm::StringRef Root,
+                                       bool Deduplicate,
+                                       bool Journal) :
+  Root(Root.str()), Deduplicate(Deduplicate), Journal(Journal) {
   revng_assert(not Root.empty());
+  if (Journal)
+    recover();
 };
 
+LocalStorageClient::~LocalStorageClient() {
+  if (not Generation.has_value())
+    return;
+
+  // Whatever has not been committed is lost. If a commit failed halfway, its
+  // journal is left behind for the next client to replay.
+  if (not fs::exists(joinPath(getStyle(), *Generation, JournalName)))
+    fs::remove_directories(*Generation);
+
+  {
+    std::lock_guard Lock(GenerationsMutex);
+    GenerationsInUse.erase(*Generation);
+  }
+
+  fs::unlockFile(GenerationLock);
+  fs::closeFile(GenerationLock);
+}
+
 std::string LocalStorageClient::dumpString() const {
   return Root;
 }
 
 llvm::Expected<PathType> LocalStorageClient::type(llvm::StringRef Path) {
-  std::string ResolvedPath = resolvePath(Path);
+  std::string ResolvedPath = resolvePathForReading(Path);
+  if (ResolvedPath.empty())
+    return PathType::Missing;
+
   if (llvm::sys::fs::exists(ResolvedPath)) {
     if (llvm::sys::fs::is_directory(ResolvedPath))
       return PathType::Directory;
@@ -57,6 +248,11 @@ llvm::Error LocalStorageClient::createDirectory(llvm::StringRef Path) {
 
 llvm::Error LocalStorageClient::remove(llvm::StringRef Path) {
   std::string ResolvedPath = resolvePath(Path);
+  if (Journal and not fs::is_directory(ResolvedPath)) {
+    stage(Path, "");
+    return llvm::Error::success();
+  }
+
   std::error_code EC = llvm::sys::fs::remove(ResolvedPath);
   if (EC) {
     return llvm::createStringError(EC,
@@ -73,24 +269,64 @@ llvm::sys::path::Style LocalStorageClient::getStyle() const {
 
 llvm::Error LocalStorageClient::copy(llvm::StringRef Source,
                                      llvm::StringRef Destination) {
-  std::string ResolvedSource = resolvePath(Source);
-  std::string ResolvedDestination = resolvePath(Destination);
-  std::error_code EC = llvm::sys::fs::copy_file(ResolvedSource.c_str(),
-                                                ResolvedDestination.c_str());
-  if (EC) {
+  std::string ResolvedSource = resolvePathForReading(Source);
+  if (ResolvedSource.empty()) {
+    auto EC = std::make_error_code(std::errc::no_such_file_or_directory);
     return llvm::createStringError(EC,
                                    "Could not copy file %s to %s",
-                                   ResolvedSource.c_str(),
-                                   ResolvedDestination.c_str());
+                                   Source.str().c_str(),
+                                   Destination.str().c_str());
   }
 
-  return llvm::Error::success();
+  std::string ResolvedDestination;
+  if (Journal) {
+    auto MaybeStagedPath = createStagedPath();
+    if (not MaybeStagedPath)
+      return MaybeStagedPath.takeError();
+    ResolvedDestination = *MaybeStagedPath;
+  } else {
+    ResolvedDestination = resolvePath(Destination);
+  }
+
+  llvm::Error Result = llvm::Error::success();
+  if (Deduplicate) {
+    Result = replaceWithLink(ResolvedSource, ResolvedDestination);
+  } else if (std::error_code EC = llvm::sys::fs::copy_file(ResolvedSource,
+                                                           ResolvedDestination);
+             EC) {
+    Result = llvm::createStringError(EC,
+                                     "Could not copy file %s to %s",
+                                     ResolvedSource.c_str(),
+                                     ResolvedDestination.c_str());
+  }
+
+  if (Journal) {
+    if (Result)
+      fs::remove(ResolvedDestination);
+    else
+      stage(Destination, ResolvedDestination);
+  }
+
+  return Result;
 }
 
 llvm::Expected<std::unique_ptr<ReadableFile>>
 LocalStorageClient::getReadableFile(llvm::StringRef Path) {
-  std::string ResolvedPath = resolvePath(Path);
-  auto MaybeBuffer = llvm::MemoryBuffer::getFile(ResolvedPath);
+  std::string ResolvedPath = resolvePathForReading(Path);
+  if (ResolvedPath.empty()) {
+    auto EC = std::make_error_code(std::errc::no_such_file_or_directory);
+    return llvm::createStringError(EC,
+                                   "Could not open file %s for reading",
+                                   Path.str().c_str());
+  }
+
+  // Do not require a null terminator, otherwise files whose size is a multiple
+  // of the page size would be read instead of mapped
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(ResolvedPath,
+                                                 /* IsText */ false,
+                                                 /* RequiresNullTerminator */
+                                                 false,
+                                                 /* IsVolatile */ false);
   if (not MaybeBuffer) {
     return llvm::createStringError(MaybeBuffer.getError(),
                                    "Could not open file %s for reading",
@@ -104,6 +340,58 @@ llvm::Expected<std::unique_ptr<WritableFile>>
 LocalStorageClient::getWritableFile(llvm::StringRef Path,
                                     ContentEncoding Encoding) {
   std::string ResolvedPath = resolvePath(Path);
+  if (Deduplicate) {
+    std::string Blobs = resolvePath(BlobsDirectory);
+    if (std::error_code EC = fs::create_directories(Blobs)) {
+      return llvm::createStringError(EC,
+                                     "Could not create directory %s",
+                                     Blobs.c_str());
+    }
+
+    int FD = -1;
+    llvm::SmallString<128> TemporaryPath;
+    std::string Model = joinPath(getStyle(), Blobs, "tmp-%%%%%%%%%%%%");
+    if (std::error_code EC = fs::createUniqueFile(Model, FD, TemporaryPath)) {
+      return llvm::createStringError(EC,
+                                     "Could not open file %s for writing",
+                                     ResolvedPath.c_str());
+    }
+
+    auto OS = std::make_unique<llvm::raw_fd_ostream>(FD,
+                                                     /* shouldClose */ true);
+    return std::make_unique<LocalBlobWritableFile>(*this,
+                                                   TemporaryPath,
+                                                   Path,
+                                                   std::move(OS));
+  }
+
+  if (Journal) {
+    auto MaybeStagedPath = createStagedPath();
+    if (not MaybeStagedPath)
+      return MaybeStagedPath.takeError();
+
+    std::error_code EC;
+    auto OS = std::make_unique<llvm::raw_fd_ostream>(*MaybeStagedPath,
+                                                     EC,
+                                                     llvm::sys::fs::OF_None);
+    if (EC) {
+      fs::remove(*MaybeStagedPath);
+      return llvm::createStringError(EC,
+                                     "Could not open file %s for writing",
+                                     ResolvedPath.c_str());
+    }
+
+    return std::make_unique<LocalStagedWritableFile>(*this,
+                                                     *MaybeStagedPath,
+                                                     Path,
+                                                     std::move(OS));
+  }
+
+  // Writing in place through a hard link would change the other paths too
+  fs::file_status Status;
+  if (not fs::status(ResolvedPath, Status) and Status.getLinkCount() > 1)
+    fs::remove(ResolvedPath);
+
   std::error_code EC;
   auto OS = std::make_unique<llvm::raw_fd_ostream>(ResolvedPath,
                                                    EC,
@@ -117,4 +405,309 @@ LocalStorageClient::getWritableFile(llvm::StringRef Path,
   return std::make_unique<LocalWritableFile>(std::move(OS));
 }
 
+llvm::Error LocalStorageClient::storeBlob(llvm::StringRef TemporaryPath,
+                                          llvm::StringRef Path) {
+  auto MaybeHash = hashFile(TemporaryPath);
+  if (not MaybeHash) {
+    fs::remove(TemporaryPath);
+    return MaybeHash.takeError();
+  }
+
+  std::string Destination;
+  if (Journal) {
+    auto MaybeStagedPath = createStagedPath();
+    if (not MaybeStagedPath) {
+      fs::remove(TemporaryPath);
+      return MaybeStagedPath.takeError();
+    }
+    Destination = *MaybeStagedPath;
+  } else {
+    Destination = resolvePath(Path);
+  }
+
+  std::string BlobPath = joinPath(getStyle(),
+                                  resolvePath(BlobsDirectory),
+                                  *MaybeHash);
+
+  {
+    std::lock_guard Lock(BlobsMutex);
+    llvm::Error Result = llvm::Error::success();
+    if (fs::exists(BlobPath)) {
+      fs::remove(TemporaryPath);
+    } else if (std::error_code EC = fs::rename(TemporaryPath, BlobPath)) {
+      fs::remove(TemporaryPath);
+      Result = llvm::createStringError(EC,
+                                       "Could not write file %s",
+                                       Path.str().c_str());
+    }
+
+    if (not Result)
+      Result = replaceWithLink(BlobPath, Destination);
+
+    if (Result) {
+      if (Journal)
+        fs::remove(Destination);
+      return Result;
+    }
+  }
+
+  if (Journal)
+    stage(Path, Destination);
+
+  return llvm::Error::success();
+}
+
+llvm::Error LocalStorageClient::openGeneration() {
+  if (Generation.has_value())
+    return llvm::Error::success();
+
+  std::string Staging = resolvePath(StagingDirectory);
+  if (std::error_code EC = fs::create_directories(Staging)) {
+    return llvm::createStringError(EC,
+                                   "Could not create directory %s",
+                                   Staging.c_str());
+  }
+
+  llvm::SmallString<128> Directory;
+  std::string Prefix = joinPath(getStyle(), Staging, "generation");
+  if (std::error_code EC = fs::createUniqueDirectory(Prefix, Directory)) {
+    return llvm::createStringError(EC,
+                                   "Could not create directory in %s",
+                                   Staging.c_str());
+  }
+
+  // Tell the other clients the generation is in use, see recover
+  {
+    std::lock_guard Lock(GenerationsMutex);
+    GenerationsInUse.insert(Directory);
+  }
+
+  std::string LockPath = joinPath(getStyle(), Directory.str(), LockName);
+  int FD = -1;
+  std::error_code EC = fs::openFileForWrite(LockPath, FD);
+  if (not EC)
+    EC = fs::tryLockFile(FD);
+
+  if (EC) {
+    if (FD != -1)
+      fs::closeFile(FD);
+    fs::remove_directories(Directory);
+    std::lock_guard Lock(GenerationsMutex);
+    GenerationsInUse.erase(Directory);
+    return llvm::createStringError(EC,
+                                   "Could not lock %s",
+                                   LockPath.c_str());
+  }
+
+  GenerationLock = FD;
+  Generation = Directory.str().str();
+  return llvm::Error::success();
+}
+
+llvm::Expected<std::string> LocalStorageClient::createStagedPath() {
+  std::lock_guard Lock(StagingMutex);
+  if (auto Error = openGeneration())
+    return std::move(Error);
+
+  int FD = -1;
+  llvm::SmallString<128> Result;
+  std::string Model = joinPath(getStyle(), *Generation, "staged-%%%%%%%%%%%%");
+  if (std::error_code EC = fs::createUniqueFile(Model, FD, Result)) {
+    return llvm::createStringError(EC,
+                                   "Could not create a file in %s",
+                                   Generation->c_str());
+  }
+
+  fs::closeFile(FD);
+  return Result.str().str();
+}
+
+void LocalStorageClient::stage(llvm::StringRef Path,
+                               llvm::StringRef StagedPath) {
+  std::lock_guard Lock(StagingMutex);
+  std::string &Entry = Staged[Path];
+  if (not Entry.empty())
+    fs::remove(Entry);
+  Entry = StagedPath.str();
+}
+
+llvm::Error LocalStorageClient::replay(llvm::StringRef JournalPath) {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(JournalPath);
+  if (not MaybeBuffer) {
+    return llvm::createStringError(MaybeBuffer.getError(),
+                                   "Could not read %s",
+                                   JournalPath.str().c_str());
+  }
+
+  // A sequence of path, staged file (empty for removals) pairs, each one
+  // terminated by a null character
+  llvm::SmallVector<llvm::StringRef, 16> Fields;
+  (*MaybeBuffer)->getBuffer().split(Fields, '\0');
+  if (Fields.size() % 2 != 1 or not Fields.back().empty()) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Malformed journal %s",
+                                   JournalPath.str().c_str());
+  }
+  for (size_t I = 0; I + 1 < Fields.size(); I += 2) {
+    std::string Destination = resolvePath(Fields[I]);
+    llvm::StringRef StagedPath = Fields[I + 1];
+    std::error_code EC;
+    if (StagedPath.empty())
+      EC = fs::remove(Destination);
+    else if (fs::exists(StagedPath))
+      EC = fs::rename(StagedPath, Destination);
+    // Otherwise it has been moved in place before the crash
+
+    if (EC) {
+      return llvm::createStringError(EC,
+                                     "Could not update %s",
+                                     Destination.c_str());
+    }
+  }
+
+  fs::remove(JournalPath);
+  return llvm::Error::success();
+}
+
+llvm::Error LocalStorageClient::commitJournal() {
+  std::lock_guard Lock(StagingMutex);
+  if (Staged.empty())
+    return llvm::Error::success();
+
+  if (auto Error = openGeneration())
+    return Error;
+
+  std::string JournalPath = joinPath(getStyle(), *Generation, JournalName);
+  std::string Temporary = JournalPath + ".tmp";
+  {
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(Temporary, EC, fs::OF_None);
+    if (EC) {
+      return llvm::createStringError(EC,
+                                     "Could not open file %s for writing",
+                                     Temporary.c_str());
+    }
+
+    for (const auto &Entry : Staged)
+      OS << Entry.first() << '\0' << Entry.second << '\0';
+
+    syncFile(OS);
+    OS.close();
+    if (OS.has_error()) {
+      EC = OS.error();
+      OS.clear_error();
+      fs::remove(Temporary);
+      return llvm::createStringError(EC,
+                                     "Could not write file %s",
+                                     Temporary.c_str());
+    }
+  }
+
+  // Once the journal is in place, the commit will be completed even if this
+  // process crashes: the next client replays it
+  if (std::error_code EC = fs::rename(Temporary, JournalPath)) {
+    fs::remove(Temporary);
+    return llvm::createStringError(EC,
+                                   "Could not write file %s",
+                                   JournalPath.c_str());
+  }
+  syncDirectory(*Generation);
+
+  revng_log(Log,
+            "Committing " << Staged.size() << " changes in " << *Generation);
+  auto Result = replay(JournalPath);
+  Staged.clear();
+  return Result;
+}
+
+void LocalStorageClient::recover() {
+  std::error_code EC;
+  std::string Staging = resolvePath(StagingDirectory);
+  for (fs::directory_iterator It(Staging, EC), End; It != End and not EC;
+       It.increment(EC)) {
+    const std::string &Directory = It->path();
+
+    {
+      std::lock_guard Lock(GenerationsMutex);
+      if (GenerationsInUse.contains(Directory))
+        continue;
+    }
+
+    // Still in use by another process, or being created
+    int FD = -1;
+    std::string LockPath = joinPath(getStyle(), Directory, LockName);
+    if (fs::openFileForWrite(LockPath, FD, fs::CD_OpenExisting))
+      continue;
+
+    if (fs::tryLockFile(FD)) {
+      fs::closeFile(FD);
+      continue;
+    }
+
+    std::string JournalPath = joinPath(getStyle(), Directory, JournalName);
+    bool Drop = true;
+    if (fs::exists(JournalPath)) {
+      revng_log(Log, "Replaying " << JournalPath);
+      if (auto Error = replay(JournalPath)) {
+        revng_log(Log, "Could not replay " << JournalPath << ": " << Error);
+        llvm::consumeError(std::move(Error));
+        Drop = false;
+      }
+    } else {
+      revng_log(Log, "Dropping the uncommitted changes in " << Directory);
+    }
+
+    if (Drop)
+      fs::remove_directories(Directory);
+
+    fs::unlockFile(FD);
+    fs::closeFile(FD);
+  }
+}
+
+llvm::Error LocalStorageClient::commit() {
+  if (Journal)
+    if (auto Error = commitJournal())
+      return Error;
+
+  if (not Deduplicate)
+    return llvm::Error::success();
+
+  std::lock_guard Lock(BlobsMutex);
+  std::error_code EC;
+  std::string Blobs = resolvePath(BlobsDirectory);
+  for (fs::directory_iterator It(Blobs, EC), End; It != End and not EC;
+       It.increment(EC)) {
+    // Still being written
+    if (llvm::sys::path::filename(It->path()).starts_with("tmp-"))
+      continue;
+
+    // Nothing links to it anymore
+    fs::file_status Status;
+    if (not fs::status(It->path(), Status) and Status.getLinkCount() == 1)
+      fs::remove(It->path());
+  }
+
+  return llvm::Error::success();
+}
+
+void LocalStorageClient::prefetch(llvm::ArrayRef<std::string> Paths) {
+  // Have the kernel read the files into the page cache in the background, so
+  // that accessing them once mapped does not wait for the disk
+  for (const std::string &Path : Paths) {
+    std::string ResolvedPath = resolvePathForReading(Path);
+    if (ResolvedPath.empty())
+      continue;
+
+    auto MaybeFD = llvm::sys::fs::openNativeFileForRead(ResolvedPath);
+    if (not MaybeFD) {
+      llvm::consumeError(MaybeFD.takeError());
+      continue;
+    }
+
+    posix_fadvise(*MaybeFD, 0, 0, POSIX_FADV_WILLNEED);
+    llvm::sys::fs::closeFile(*MaybeFD);
+  }
+}
+
 } // namespace revng
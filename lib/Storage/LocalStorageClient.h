@@ -4,18 +4,61 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <mutex>
+#include <optional>
+
+#include "llvm/ADT/StringMap.h"
+
 #include "revng/Storage/StorageClient.h"
 #include "revng/Support/Debug.h"
 
 namespace revng {
 
+class LocalBlobWritableFile;
+class LocalStagedWritableFile;
+
+/// StorageClient for a directory of the local filesystem.
+///
+/// If \p Deduplicate is set, files are written, once per distinct content, in
+/// the `.blobs` subdirectory, named after their hash. The actual paths are
+/// hard links to them, so that copying a file is a metadata operation and
+/// identical files take up space only once. Files are never modified in place,
+/// writing one replaces it with a new link.
+///
+/// If \p Journal is set, changes become visible to other clients only at the
+/// next commit, all at once, even if the process crashes halfway through it.
+/// Written, copied and removed files are staged in a "generation", a private
+/// subdirectory of `.staging`, and this client alone sees them until commit
+/// writes the list of the changes (the journal), atomically renames it in
+/// place and then moves each staged file to its final path. A journal left
+/// behind by a crash is replayed, and the staged files of a generation that
+/// was never committed are dropped, by the next client opening the same
+/// directory.
 class LocalStorageClient : public StorageClient {
 private:
   std::string Root;
+  bool Deduplicate = false;
+  /// Serializes adding and removing blobs
+  std::mutex BlobsMutex;
+  static constexpr auto BlobsDirectory = ".blobs";
+
+  bool Journal = false;
+  static constexpr auto StagingDirectory = ".staging";
+  /// Serializes the accesses to the fields below
+  std::mutex StagingMutex;
+  /// Subdirectory of StagingDirectory holding the staged files, created the
+  /// first time something is staged
+  std::optional<std::string> Generation;
+  /// Kept locked while the generation is in use, see recover
+  int GenerationLock = -1;
+  /// The staged file for each changed path, empty if it has been removed
+  llvm::StringMap<std::string> Staged;
 
 public:
-  LocalStorageClient(llvm::StringRef Root);
-  ~LocalStorageClient() override = default;
+  LocalStorageClient(llvm::StringRef Root,
+                     bool Deduplicate = false,
+                     bool Journal = false);
+  ~LocalStorageClient() override;
 
   llvm::Expected<PathType> type(llvm::StringRef Path) override;
   llvm::Error createDirectory(llvm::StringRef Path) override;
@@ -31,9 +74,46 @@ public:
   llvm::Expected<std::unique_ptr<WritableFile>>
   getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) override;
 
+  void prefetch(llvm::ArrayRef<std::string> Paths) override;
+
+  /// Publishes the staged changes, if journaling, and removes the blobs no
+  /// path refers to anymore
+  llvm::Error commit() override;
+
 private:
   std::string dumpString() const override;
   std::string resolvePath(llvm::StringRef Path);
+
+  /// Like resolvePath, but takes into account the staged changes. Returns an
+  /// empty string for removed files.
+  std::string resolvePathForReading(llvm::StringRef Path);
+
+  /// \return a new, unique, path in the current generation
+  llvm::Expected<std::string> createStagedPath();
+
+  /// Makes \p StagedPath the new content of \p Path, as of the next commit
+  void stage(llvm::StringRef Path, llvm::StringRef StagedPath);
+
+  /// Creates the current generation, if needed. StagingMutex must be held.
+  llvm::Error openGeneration();
+
+  /// Moves in place the changes listed in the journal at \p JournalPath, then
+  /// removes it. Can be repeated if it fails or is interrupted.
+  llvm::Error replay(llvm::StringRef JournalPath);
+
+  /// Publishes the staged changes, see commit
+  llvm::Error commitJournal();
+
+  /// Replays the journals left behind by crashed clients and drops the
+  /// generations nobody is using anymore
+  void recover();
+
+  /// Moves the file at \p TemporaryPath among the blobs, unless an identical
+  /// one is there already, and links \p Path to it
+  llvm::Error storeBlob(llvm::StringRef TemporaryPath, llvm::StringRef Path);
+
+  friend class LocalBlobWritableFile;
+class LocalStagedWritableFile;
 };
 
 } // namespace revng
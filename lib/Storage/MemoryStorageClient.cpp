@@ -0,0 +1,151 @@
+/// \file MemoryStorageClient.cpp
+/// \brief Implementation of StorageClient operations on in-memory files
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/SmallVector.h"
+
+#include "revng/Storage/MemoryStorageClient.h"
+
+#include "LocalFile.h"
+#include "Utils.h"
+
+namespace revng {
+
+namespace {
+
+class MemoryWritableFile : public WritableFile {
+private:
+  std::string &Destination;
+  llvm::SmallVector<char, 0> Buffer;
+  llvm::raw_svector_ostream OS;
+
+public:
+  MemoryWritableFile(std::string &Destination) :
+    Destination(Destination), OS(Buffer) {}
+  ~MemoryWritableFile() override = default;
+
+  llvm::raw_pwrite_stream &os() override { return OS; }
+
+  llvm::Error commit() override {
+    Destination.assign(Buffer.data(), Buffer.size());
+    return llvm::Error::success();
+  }
+};
+
+} // namespace
+
+llvm::Expected<PathType> MemoryStorageClient::type(llvm::StringRef Path) {
+  if (Files.contains(Path))
+    return PathType::File;
+
+  if (Path.empty())
+    return PathType::Directory;
+
+  llvm::StringRef Separator = llvm::sys::path::get_separator(getStyle());
+  std::string Prefix = Path.str();
+  if (not Path.ends_with(Separator))
+    Prefix += Separator;
+
+  for (const auto &Entry : Files)
+    if (Entry.first().starts_with(Prefix))
+      return PathType::Directory;
+
+  return PathType::Missing;
+}
+
+llvm::Error MemoryStorageClient::createDirectory(llvm::StringRef Path) {
+  // Directories are implicit
+  return llvm::Error::success();
+}
+
+llvm::Error MemoryStorageClient::remove(llvm::StringRef Path) {
+  if (not Files.erase(Path)) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Could not remove file %s",
+                                   Path.str().c_str());
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::sys::path::Style MemoryStorageClient::getStyle() const {
+  return llvm::sys::path::Style::posix;
+}
+
+llvm::Error MemoryStorageClient::copy(llvm::StringRef Source,
+                                      llvm::StringRef Destination) {
+  auto It = Files.find(Source);
+  if (It == Files.end()) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Could not copy file %s to %s",
+                                   Source.str().c_str(),
+                                   Destination.str().c_str());
+  }
+
+  // Copy first, the insertion might invalidate It
+  File Copy = It->second;
+  Files[Destination] = std::move(Copy);
+  return llvm::Error::success();
+}
+
+llvm::Expected<std::unique_ptr<ReadableFile>>
+MemoryStorageClient::getReadableFile(llvm::StringRef Path) {
+  auto It = Files.find(Path);
+  if (It == Files.end()) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Could not open file %s for reading",
+                                   Path.str().c_str());
+  }
+
+  auto Buffer = llvm::MemoryBuffer::getMemBuffer(It->second.Content,
+                                                 Path,
+                                                 false);
+  return std::make_unique<LocalReadableFile>(std::move(Buffer));
+}
+
+llvm::Expected<std::unique_ptr<WritableFile>>
+MemoryStorageClient::getWritableFile(llvm::StringRef Path,
+                                     ContentEncoding Encoding) {
+  revng_assert(checkPath(Path, getStyle()));
+  File &Entry = Files[Path];
+  Entry.Content.clear();
+  Entry.Encoding = Encoding;
+  return std::make_unique<MemoryWritableFile>(Entry.Content);
+}
+
+llvm::Error MemoryStorageClient::writeTo(const DirectoryPath &Destination) const {
+  for (const auto &Entry : Files) {
+    llvm::StringRef Path = Entry.first();
+    const File &Content = Entry.second;
+
+    // Create the intermediate directories
+    llvm::StringRef Parent = llvm::sys::path::parent_path(Path, getStyle());
+    if (not Parent.empty()) {
+      DirectoryPath Directory = Destination;
+      llvm::SmallVector<llvm::StringRef, 4> Components;
+      Parent.split(Components, llvm::sys::path::get_separator(getStyle()));
+      for (llvm::StringRef Component : Components) {
+        Directory = Directory.getDirectory(Component);
+        if (auto Error = Directory.create())
+          return Error;
+      }
+    }
+
+    FilePath Target = Destination.getFile(Path);
+    auto MaybeWritableFile = Target.getWritableFile(Content.Encoding);
+    if (not MaybeWritableFile)
+      return MaybeWritableFile.takeError();
+
+    auto &WritableFile = MaybeWritableFile.get();
+    WritableFile->os() << Content.Content;
+    if (auto Error = WritableFile->commit())
+      return Error;
+  }
+
+  return llvm::Error::success();
+}
+
+} // namespace revng
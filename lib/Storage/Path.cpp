@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
 #include "revng/Storage/Path.h"
 #include "revng/Storage/StorageClient.h"
 
@@ -46,4 +48,14 @@ FilePath FilePath::fromLocalStorage(llvm::StringRef Path) {
   return revng::FilePath{ &LocalClient, normalizeLocalPath(Path) };
 }
 
+void FilePath::prefetch(llvm::ArrayRef<FilePath> Paths) {
+  // Group the paths by client, so that each one can schedule them all at once
+  std::map<StorageClient *, std::vector<std::string>> ByClient;
+  for (const FilePath &Path : Paths)
+    ByClient[Path.Client].push_back(Path.SubPath);
+
+  for (auto &[Client, SubPaths] : ByClient)
+    Client->prefetch(SubPaths);
+}
+
 } // namespace revng
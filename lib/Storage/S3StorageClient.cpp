@@ -5,28 +5,47 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <sstream>
+#include <thread>
 
 #include "aws/core/Aws.h"
 #include "aws/core/auth/AWSCredentials.h"
 #include "aws/core/auth/AWSCredentialsProvider.h"
 #include "aws/core/utils/logging/FormattedLogSystem.h"
 #include "aws/s3/S3Client.h"
+#include "aws/s3/model/AbortMultipartUploadRequest.h"
+#include "aws/s3/model/CompleteMultipartUploadRequest.h"
+#include "aws/s3/model/CompletedMultipartUpload.h"
+#include "aws/s3/model/CompletedPart.h"
 #include "aws/s3/model/CopyObjectRequest.h"
+#include "aws/s3/model/CreateMultipartUploadRequest.h"
 #include "aws/s3/model/DeleteObjectRequest.h"
 #include "aws/s3/model/GetObjectRequest.h"
 #include "aws/s3/model/HeadObjectRequest.h"
 #include "aws/s3/model/PutObjectRequest.h"
+#include "aws/s3/model/UploadPartRequest.h"
 
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
 #include "llvm/Support/YAMLTraits.h"
 
 #include "revng/Storage/Path.h"
 #include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/OnQuit.h"
 #include "revng/Support/PathList.h"
 #include "revng/Support/TemporaryFile.h"
 
+#include "LocalFile.h"
 #include "S3StorageClient.h"
 #include "Utils.h"
 
@@ -52,6 +71,44 @@ using Aws::Utils::Logging::LogLevel;
 
 Logger<> Logger("s3-storage");
 
+using namespace llvm::cl;
+
+opt<unsigned> PartSizeMiB("s3-part-size",
+                          desc("Size, in MiB, of the parts in which objects "
+                               "larger than it are uploaded and downloaded "
+                               "from S3. Cannot be less than 5."),
+                          cat(MainCategory),
+                          init(16));
+
+opt<unsigned> Concurrency("s3-concurrency",
+                          desc("Number of parts of an object transferred "
+                               "concurrently from/to S3"),
+                          cat(MainCategory),
+                          init(4));
+
+opt<std::string> CacheDirectory("s3-cache-directory",
+                                desc("Directory where the objects read from "
+                                     "S3 are cached across runs. Disabled if "
+                                     "empty."),
+                                cat(MainCategory));
+
+opt<unsigned> CacheSizeMiB("s3-cache-size",
+                           desc("Size, in MiB, above which the least "
+                                "recently used objects are evicted from "
+                                "-s3-cache-directory"),
+                           cat(MainCategory),
+                           init(10 * 1024));
+
+opt<unsigned> PackThresholdKiB("s3-pack-threshold",
+                                desc("Files up to this size, in KiB, are not "
+                                     "uploaded to S3 one by one, but packed "
+                                     "together in a single object on commit. "
+                                     "0 disables packing."),
+                                cat(MainCategory),
+                                init(256));
+
+Logger<> CacheLogger("s3-cache");
+
 class LoggerSystem : public FormattedLogSystem {
 private:
   std::mutex Mutex;
@@ -106,6 +163,74 @@ toError(const Aws::Utils::Outcome<T, Aws::S3::S3Error> &Request) {
                                  Request.GetError().GetMessage());
 }
 
+/// S3 refuses parts smaller than 5 MiB, except for the last one
+static uint64_t getPartSize() {
+  constexpr uint64_t MiB = 1024 * 1024;
+  return std::max<uint64_t>(PartSizeMiB, 5) * MiB;
+}
+
+/// Invokes \p Function on every index in [0, \p Count), from at most
+/// `-s3-concurrency` threads at a time
+static llvm::Error
+forEachPart(size_t Count, llvm::function_ref<llvm::Error(size_t)> Function) {
+  std::atomic<size_t> Next = 0;
+  std::mutex ErrorMutex;
+  llvm::Error Result = llvm::Error::success();
+
+  auto Worker = [&]() {
+    for (size_t I = Next++; I < Count; I = Next++) {
+      if (llvm::Error Error = Function(I)) {
+        std::lock_guard Guard(ErrorMutex);
+        Result = llvm::joinErrors(std::move(Result), std::move(Error));
+        // Do not start any other part
+        Next = Count;
+      }
+    }
+  };
+
+  size_t ThreadCount = std::min<size_t>(std::max(Concurrency.getValue(), 1U),
+                                        Count);
+  std::vector<std::thread> Threads;
+  for (size_t I = 1; I < ThreadCount; I++)
+    Threads.emplace_back(Worker);
+  Worker();
+
+  for (std::thread &Thread : Threads)
+    Thread.join();
+
+  return Result;
+}
+
+/// \return the value of the Range header for the bytes in [\p Start, \p End)
+static std::string makeRange(uint64_t Start, uint64_t End) {
+  return "bytes=" + std::to_string(Start) + "-" + std::to_string(End - 1);
+}
+
+/// Copies the whole \p Body to \p OS
+static void copyStream(std::istream &Body, std::ostream &OS) {
+  constexpr size_t BufSize = 4096;
+  llvm::SmallVector<char> Buffer;
+  Buffer.resize_for_overwrite(BufSize);
+
+  while (!Body.eof()) {
+    Body.read(Buffer.data(), BufSize);
+    OS.write(Buffer.data(), Body.gcount());
+  }
+}
+
+/// Parses the total size out of a `Content-Range: bytes <a>-<b>/<total>`
+static std::optional<uint64_t> parseTotalSize(llvm::StringRef ContentRange) {
+  if (ContentRange.empty())
+    return std::nullopt;
+
+  llvm::StringRef Total = ContentRange.rsplit('/').second;
+  uint64_t Result = 0;
+  if (Total.getAsInteger(10, Result))
+    return std::nullopt;
+
+  return Result;
+}
+
 std::string S3StorageClient::resolvePath(llvm::StringRef Path) {
   if (Path.empty()) {
     return SubPath;
@@ -138,6 +263,32 @@ static std::string generateNewFilename(llvm::StringRef Path) {
   }
 }
 
+/// \return the value of the Content-Encoding header for \p Encoding
+static llvm::StringRef getEncodingName(ContentEncoding Encoding) {
+  switch (Encoding) {
+  case ContentEncoding::None:
+    return "";
+  case ContentEncoding::Gzip:
+    return "gzip";
+  case ContentEncoding::Zstd:
+    return "zstd";
+  }
+
+  revng_abort();
+}
+
+/// Objects written through S3WritableFile are named after their content, so
+/// that identical files, e.g. the same container in different steps, are
+/// uploaded once and share the same object
+static constexpr llvm::StringRef BlobsDirectory = ".blobs/";
+
+static std::string getBlobName(llvm::StringRef Hash, ContentEncoding Encoding) {
+  std::string Result = BlobsDirectory.str() + Hash.str();
+  if (llvm::StringRef Name = getEncodingName(Encoding); not Name.empty())
+    Result += "-" + Name.str();
+  return Result;
+}
+
 static Aws::Auth::AWSCredentials readCredentials(llvm::StringRef Credentials) {
   llvm::StringRef Username = consumeSplit(Credentials, ':');
   llvm::StringRef Password = Credentials;
@@ -157,6 +308,140 @@ public:
   llvm::MemoryBuffer &buffer() override { return *Buffer; };
 };
 
+/// Fetches the object one part at a time, in sequence, on a separate thread,
+/// keeping up to `-s3-concurrency` parts ready to be consumed
+class S3ReadableStream : public ReadableStream {
+private:
+  S3StorageClient &Client;
+  std::string Key;
+
+  std::mutex Mutex;
+  std::condition_variable Changed;
+  std::deque<std::string> Parts;
+  /// Set by the downloader once all the parts are in Parts, or on failure
+  bool Done = false;
+  std::optional<std::string> ErrorMessage;
+  /// Set when the consumer goes away before the end of the object
+  bool Stopped = false;
+
+  /// The part returned by the last invocation of next
+  std::string Current;
+  std::thread Downloader;
+
+public:
+  S3ReadableStream(S3StorageClient &Client, llvm::StringRef Key) :
+    Client(Client), Key(Key.str()) {
+    Downloader = std::thread([this]() { download(); });
+  }
+
+  ~S3ReadableStream() override {
+    {
+      std::lock_guard Guard(Mutex);
+      Stopped = true;
+    }
+    Changed.notify_all();
+    Downloader.join();
+  }
+
+  llvm::Expected<llvm::ArrayRef<char>> next() override {
+    std::unique_lock Lock(Mutex);
+    Changed.wait(Lock, [this]() { return not Parts.empty() or Done; });
+
+    if (Parts.empty()) {
+      if (ErrorMessage.has_value())
+        return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                       *ErrorMessage);
+      return llvm::ArrayRef<char>();
+    }
+
+    Current = std::move(Parts.front());
+    Parts.pop_front();
+    Lock.unlock();
+    Changed.notify_all();
+
+    return llvm::ArrayRef<char>(Current.data(), Current.size());
+  }
+
+private:
+  /// \return false if the consumer went away
+  bool push(std::string &&Part) {
+    std::unique_lock Lock(Mutex);
+    size_t MaxParts = std::max(Concurrency.getValue(), 1U);
+    Changed.wait(Lock, [&]() { return Parts.size() < MaxParts or Stopped; });
+    if (Stopped)
+      return false;
+
+    Parts.push_back(std::move(Part));
+    Lock.unlock();
+    Changed.notify_all();
+    return true;
+  }
+
+  void finish(std::optional<std::string> Error) {
+    {
+      std::lock_guard Guard(Mutex);
+      Done = true;
+      ErrorMessage = std::move(Error);
+    }
+    Changed.notify_all();
+  }
+
+  void download() {
+    using Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE;
+    uint64_t PartSize = getPartSize();
+
+    std::optional<uint64_t> Size;
+    for (uint64_t Offset = 0; not Size.has_value() or Offset < *Size;
+         Offset += PartSize) {
+      uint64_t End = Offset + PartSize;
+      if (Size.has_value())
+        End = std::min(End, *Size);
+
+      Aws::S3::Model::GetObjectRequest Request;
+      Request.SetBucket(Client.Bucket);
+      Request.SetKey(Key);
+      Request.SetRange(makeRange(Offset, End));
+
+      auto Result = Client.Client.GetObject(Request);
+      if (not Result.IsSuccess()
+          and Result.GetError().GetResponseCode()
+                == REQUESTED_RANGE_NOT_SATISFIABLE
+          and Offset == 0) {
+        // Empty objects cannot satisfy any range
+        Aws::S3::Model::GetObjectRequest WholeRequest;
+        WholeRequest.SetBucket(Client.Bucket);
+        WholeRequest.SetKey(Key);
+        Result = Client.Client.GetObject(WholeRequest);
+      }
+
+      if (not Result.IsSuccess())
+        return finish(Result.GetError().GetMessage());
+
+      std::ostringstream Body;
+      copyStream(Result.GetResult().GetBody(), Body);
+      std::string Part = Body.str();
+
+      // No Content-Range means that the whole object has been returned
+      bool Whole = false;
+      if (not Size.has_value()) {
+        Size = parseTotalSize(Result.GetResult().GetContentRange());
+        if (not Size.has_value()) {
+          Whole = true;
+          Size = Part.size();
+        }
+      }
+
+      if (not Part.empty() and not push(std::move(Part)))
+        return;
+
+      if (Whole)
+        break;
+    }
+
+    finish(std::nullopt);
+  }
+};
+
 class S3WritableFile : public WritableFile {
 private:
   TemporaryFile TempFile;
@@ -181,29 +466,44 @@ public:
   llvm::Error commit() override {
     OS->flush();
 
-    Aws::S3::Model::PutObjectRequest Request;
-    Request.SetBucket(Client.Bucket);
-
-    if (Encoding == ContentEncoding::Gzip)
-      Request.SetContentEncoding("gzip");
-
-    std::string NewFilename = generateNewFilename(Path);
-    Request.SetKey(Client.resolvePath(NewFilename));
-
-    auto File = std::make_shared<Aws::FStream>(TempFile.path().str(),
-                                               std::ios_base::in
-                                                 | std::ios_base::binary);
-    if (File->fail()) {
-      return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                     "Could not open temporary file");
+    auto MaybeHash = hashFile(TempFile.path());
+    if (not MaybeHash)
+      return MaybeHash.takeError();
+    std::string NewFilename = getBlobName(*MaybeHash, Encoding);
+
+    uint64_t Size = 0;
+    if (std::error_code EC = llvm::sys::fs::file_size(TempFile.path(), Size))
+      return llvm::createStringError(EC, "Could not stat temporary file");
+
+    if (Client.isReferenced(NewFilename)) {
+      // Already there
+    } else if (PackThresholdKiB != 0
+               and Size <= uint64_t(PackThresholdKiB) * 1024) {
+      // Keep it in memory, it will be uploaded by S3StorageClient::commit
+      auto MaybeBuffer = llvm::MemoryBuffer::getFile(TempFile.path());
+      if (not MaybeBuffer) {
+        return llvm::createStringError(MaybeBuffer.getError(),
+                                       "Could not read temporary file");
+      }
+
+      // Record the path while holding PackMutex too, otherwise commitPack
+      // could pack the file before it's in FilenameMap
+      std::lock_guard Guard(Client.PackMutex);
+      Client.Unpacked[NewFilename] = MaybeBuffer.get()->getBuffer().str();
+
+      std::lock_guard MapGuard(Client.FilenameMapMutex);
+      Client.setFilename(Path, NewFilename);
+      Client.Written.insert(Path);
+      return llvm::Error::success();
+    } else if (auto Error = Client.putObject(Client.resolvePath(NewFilename),
+                                             TempFile.path(),
+                                             Encoding)) {
+      return Error;
     }
 
-    Request.SetBody(File);
-    Aws::S3::Model::PutObjectOutcome Result = Client.Client.PutObject(Request);
-    if (not Result.IsSuccess())
-      return toError(Result);
-
-    Client.FilenameMap[Path] = NewFilename;
+    std::lock_guard Guard(Client.FilenameMapMutex);
+    Client.setFilename(Path, NewFilename);
+    Client.Written.insert(Path);
     return llvm::Error::success();
   }
 };
@@ -219,7 +519,9 @@ public:
   Aws::Auth::AWSCredentials GetAWSCredentials() override { return Credentials; }
 };
 
-S3StorageClient::S3StorageClient(llvm::StringRef RawURL) {
+S3StorageClient::S3StorageClient(llvm::StringRef RawURL) :
+  PrefetchPool(llvm::hardware_concurrency(std::max(Concurrency.getValue(),
+                                                   1U))) {
   // Url format is:
   // s3://<username>:<password>@<region>+<host:port>/<bucket name>/<path>
   revng_assert(isS3URL(RawURL));
@@ -263,23 +565,40 @@ S3StorageClient::S3StorageClient(llvm::StringRef RawURL) {
   RedactedURL += Bucket + '/' + SubPath;
 }
 
+S3StorageClient::~S3StorageClient() {
+  // Nobody is going to read what has not been downloaded yet
+  StopPrefetching = true;
+  PrefetchPool.wait();
+}
+
 llvm::Expected<std::unique_ptr<S3StorageClient>>
 S3StorageClient::fromURL(llvm::StringRef URL) {
   if (not SDKIsInitialized)
     initializeSDK();
 
   auto Instance = std::make_unique<S3StorageClient>(URL);
-  std::string IndexPath = Instance->resolvePath(IndexName);
+  auto MaybeFound = Instance->loadIndex(IndexName, Instance->FilenameMap);
+  if (not MaybeFound)
+    return MaybeFound.takeError();
+
+  for (const auto &Entry : Instance->FilenameMap)
+    Instance->addReference(Entry.second);
+
+  return Instance;
+}
 
+llvm::Expected<bool>
+S3StorageClient::loadIndex(llvm::StringRef Name,
+                           llvm::StringMap<std::string> &Map) {
   Aws::S3::Model::GetObjectRequest Request;
-  Request.SetBucket(Instance->Bucket);
-  Request.SetKey(IndexPath);
+  Request.SetBucket(Bucket);
+  Request.SetKey(resolvePath(Name));
 
-  Aws::S3::Model::GetObjectOutcome Result = Instance->Client.GetObject(Request);
+  Aws::S3::Model::GetObjectOutcome Result = Client.GetObject(Request);
   if (not Result.IsSuccess()) {
     using Aws::Http::HttpResponseCode::NOT_FOUND;
     if (Result.GetError().GetResponseCode() == NOT_FOUND)
-      return Instance;
+      return false;
     else
       return toError(Result);
   }
@@ -297,20 +616,62 @@ S3StorageClient::fromURL(llvm::StringRef URL) {
   }
 
   llvm::yaml::Input YAMLInput(SerializedIndex);
-  YAMLInput >> Instance->FilenameMap;
+  YAMLInput >> Map;
+  if (YAMLInput.error()) {
+    return llvm::createStringError(YAMLInput.error(),
+                                   "Could not parse index %s",
+                                   Name.str().c_str());
+  }
 
-  return Instance;
+  return true;
+}
+
+llvm::Error S3StorageClient::storeIndex(llvm::StringRef Name,
+                                        llvm::StringMap<std::string> &Map) {
+  std::string SerializedIndex;
+  {
+    llvm::raw_string_ostream OS(SerializedIndex);
+    llvm::yaml::Output YAMLOutput(OS);
+    YAMLOutput << Map;
+  }
+
+  Aws::S3::Model::PutObjectRequest Request;
+  Request.SetBucket(Bucket);
+  Request.SetKey(resolvePath(Name));
+
+  auto Stream = std::make_shared<std::stringstream>(SerializedIndex,
+                                                    std::ios_base::in
+                                                      | std::ios_base::binary);
+
+  Request.SetBody(Stream);
+  Aws::S3::Model::PutObjectOutcome Result = Client.PutObject(Request);
+  if (not Result.IsSuccess())
+    return toError(Result);
+
+  return llvm::Error::success();
 }
 
 std::string S3StorageClient::dumpString() const {
   return RedactedURL;
 }
 
+std::optional<std::string> S3StorageClient::lookup(llvm::StringRef Path) {
+  std::lock_guard Guard(FilenameMapMutex);
+  auto Iterator = FilenameMap.find(Path);
+  if (Iterator == FilenameMap.end())
+    return std::nullopt;
+  return Iterator->second;
+}
+
 llvm::Expected<PathType> S3StorageClient::type(llvm::StringRef Path) {
-  if (FilenameMap.count(Path) > 0) {
+  if (std::optional<std::string> Filename = lookup(Path)) {
+    // The index is the only source of truth for packed files
+    if (isPacked(*Filename))
+      return PathType::File;
+
     Aws::S3::Model::HeadObjectRequest Request;
     Request.SetBucket(Bucket);
-    Request.SetKey(resolvePath(FilenameMap[Path]));
+    Request.SetKey(resolvePath(*Filename));
 
     Aws::S3::Model::HeadObjectOutcome Result = Client.HeadObject(Request);
     if (not Result.IsSuccess()) {
@@ -324,6 +685,7 @@ llvm::Expected<PathType> S3StorageClient::type(llvm::StringRef Path) {
     return PathType::File;
   } else {
     std::string Prefix = Path.endswith("/") ? Path.str() : (Path.str() + "/");
+    std::lock_guard Guard(FilenameMapMutex);
     for (auto &[MapPath, _] : FilenameMap) {
       if (MapPath.startswith(Prefix))
         return PathType::Directory;
@@ -337,8 +699,9 @@ llvm::Error S3StorageClient::createDirectory(llvm::StringRef Path) {
 }
 
 llvm::Error S3StorageClient::remove(llvm::StringRef Path) {
-  revng_assert(FilenameMap.count(Path) != 0);
-  FilenameMap.erase(Path);
+  std::lock_guard Guard(FilenameMapMutex);
+  eraseFilename(Path);
+  Written.erase(Path);
   return llvm::Error::success();
 }
 
@@ -348,68 +711,103 @@ llvm::sys::path::Style S3StorageClient::getStyle() const {
 
 llvm::Error S3StorageClient::copy(llvm::StringRef Source,
                                   llvm::StringRef Destination) {
+  std::lock_guard Guard(FilenameMapMutex);
   if (FilenameMap.count(Source) == 0) {
     return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                    "Source file %s does not exist",
                                    Source.str().c_str());
   }
 
-  FilenameMap[Destination] = FilenameMap[Source];
+  setFilename(Destination, FilenameMap.lookup(Source));
+  Written.insert(Destination);
   return llvm::Error::success();
 }
 
 llvm::Expected<std::unique_ptr<ReadableFile>>
 S3StorageClient::getReadableFile(llvm::StringRef Path) {
   using llvm::MemoryBuffer;
-  if (FilenameMap.count(Path) == 0) {
+  std::optional<std::string> Filename;
+  auto MaybePacked = readPacked(Path, Filename);
+  if (not MaybePacked)
+    return MaybePacked.takeError();
+
+  if (not Filename.has_value()) {
     return llvm::createStringError(llvm::inconvertibleErrorCode(),
                                    "File %s does not exist",
                                    Path.str().c_str());
   }
 
-  Aws::S3::Model::GetObjectRequest Request;
-  Request.SetBucket(Bucket);
-  Request.SetKey(resolvePath(FilenameMap[Path]));
+  if (MaybePacked->has_value()) {
+    auto Buffer = MemoryBuffer::getMemBufferCopy(**MaybePacked, Path);
+    return std::make_unique<LocalReadableFile>(std::move(Buffer));
+  }
 
-  Aws::S3::Model::GetObjectOutcome Result = Client.GetObject(Request);
-  if (not Result.IsSuccess())
-    return toError(Result);
+  // Wait for the download started by prefetch, if any
+  std::optional<TemporaryFile> Downloaded = takePrefetched(*Filename);
+
+  if (not CacheDirectory.empty()) {
+    auto MaybeCached = getCachedObject(resolvePath(*Filename));
+    if (not MaybeCached)
+      return MaybeCached.takeError();
+
+    auto MaybeBuffer = MemoryBuffer::getFile(*MaybeCached,
+                                             /* IsText */ false,
+                                             /* RequiresNullTerminator */
+                                             false,
+                                             /* IsVolatile */ false);
+    if (not MaybeBuffer) {
+      return llvm::createStringError(MaybeBuffer.getError(),
+                                     "Failed to open the file for reading");
+    }
 
-  auto MaybeTemporary = TemporaryFile::make("revng-s3-storage");
-  if (!MaybeTemporary) {
-    return llvm::createStringError(MaybeTemporary.getError(),
-                                   "Could not create temporary file");
+    return std::make_unique<LocalReadableFile>(std::move(MaybeBuffer.get()));
   }
 
-  std::ofstream OS(MaybeTemporary->path().str(), std::ios::binary);
-  if (OS.fail()) {
-    return llvm::createStringError(llvm::inconvertibleErrorCode(),
-                                   "Could not open temporary file");
-  }
+  if (not Downloaded.has_value()) {
+    auto MaybeTemporary = TemporaryFile::make("revng-s3-storage");
+    if (!MaybeTemporary) {
+      return llvm::createStringError(MaybeTemporary.getError(),
+                                     "Could not create temporary file");
+    }
 
-  constexpr size_t BufSize = 4096;
-  llvm::SmallVector<char> Buffer;
-  Buffer.resize_for_overwrite(BufSize);
-  auto &Body = Result.GetResult().GetBody();
+    if (auto Error = getObject(resolvePath(*Filename), MaybeTemporary->path()))
+      return Error;
 
-  while (!Body.eof()) {
-    Body.read(Buffer.data(), BufSize);
-    OS.write(Buffer.data(), Body.gcount());
+    Downloaded = std::move(MaybeTemporary.get());
   }
 
-  OS.flush();
-  OS.close();
-
-  auto MaybeReadableStream = MemoryBuffer::getFile(MaybeTemporary->path());
+  auto MaybeReadableStream = MemoryBuffer::getFile(Downloaded->path(),
+                                                   /* IsText */ false,
+                                                   /* RequiresNullTerminator */
+                                                   false,
+                                                   /* IsVolatile */ false);
   if (not MaybeReadableStream) {
     return llvm::createStringError(MaybeReadableStream.getError(),
                                    "Failed to open the file for reading");
   }
 
-  return std::make_unique<S3ReadableFile>(std::move(MaybeTemporary.get()),
+  return std::make_unique<S3ReadableFile>(std::move(*Downloaded),
                                           std::move(MaybeReadableStream.get()));
 }
 
+llvm::Expected<std::unique_ptr<ReadableStream>>
+S3StorageClient::getReadableStream(llvm::StringRef Path) {
+  std::optional<std::string> Filename = lookup(Path);
+  if (not Filename.has_value()) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "File %s does not exist",
+                                   Path.str().c_str());
+  }
+
+  // The object needs to be in the cache as a whole anyway, packed files are
+  // small and prefetched ones are on their way already
+  if (not CacheDirectory.empty() or isPacked(*Filename)
+      or isPrefetching(*Filename))
+    return StorageClient::getReadableStream(Path);
+
+  return std::make_unique<S3ReadableStream>(*this, resolvePath(*Filename));
+}
+
 llvm::Expected<std::unique_ptr<WritableFile>>
 S3StorageClient::getWritableFile(llvm::StringRef Path,
                                  ContentEncoding Encoding) {
@@ -431,28 +829,669 @@ S3StorageClient::getWritableFile(llvm::StringRef Path,
                                           *this);
 }
 
-llvm::Error S3StorageClient::commit() {
-  std::string SerializedIndex;
+llvm::Error S3StorageClient::putObject(llvm::StringRef Key,
+                                       llvm::StringRef FilePath,
+                                       ContentEncoding Encoding) {
+  uint64_t Size = 0;
+  if (std::error_code EC = llvm::sys::fs::file_size(FilePath, Size))
+    return llvm::createStringError(EC, "Could not stat temporary file");
 
-  {
-    llvm::raw_string_ostream OS(SerializedIndex);
-    llvm::yaml::Output YAMLOutput(OS);
-    YAMLOutput << FilenameMap;
+  uint64_t PartSize = getPartSize();
+  if (Size <= PartSize) {
+    // Small enough for a single request
+    Aws::S3::Model::PutObjectRequest Request;
+    Request.SetBucket(Bucket);
+    Request.SetKey(Key.str());
+
+    if (auto Name = getEncodingName(Encoding); not Name.empty())
+      Request.SetContentEncoding(Name.str());
+
+    auto File = std::make_shared<Aws::FStream>(FilePath.str(),
+                                               std::ios_base::in
+                                                 | std::ios_base::binary);
+    if (File->fail()) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Could not open temporary file");
+    }
+
+    Request.SetBody(File);
+    Aws::S3::Model::PutObjectOutcome Result = Client.PutObject(Request);
+    if (not Result.IsSuccess())
+      return toError(Result);
+
+    return llvm::Error::success();
   }
 
-  Aws::S3::Model::PutObjectRequest Request;
+  Aws::S3::Model::CreateMultipartUploadRequest CreateRequest;
+  CreateRequest.SetBucket(Bucket);
+  CreateRequest.SetKey(Key.str());
+  if (auto Name = getEncodingName(Encoding); not Name.empty())
+    CreateRequest.SetContentEncoding(Name.str());
+
+  auto CreateResult = Client.CreateMultipartUpload(CreateRequest);
+  if (not CreateResult.IsSuccess())
+    return toError(CreateResult);
+  const Aws::String &UploadID = CreateResult.GetResult().GetUploadId();
+
+  size_t PartCount = (Size + PartSize - 1) / PartSize;
+  std::vector<Aws::S3::Model::CompletedPart> Parts(PartCount);
+  auto UploadPart = [&](size_t Index) -> llvm::Error {
+    uint64_t Offset = Index * PartSize;
+    uint64_t Length = std::min(PartSize, Size - Offset);
+
+    std::ifstream File(FilePath.str(), std::ios::binary);
+    if (File.fail()) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Could not open temporary file");
+    }
+
+    std::string Data;
+    Data.resize(Length);
+    File.seekg(Offset);
+    File.read(Data.data(), Length);
+    if (static_cast<uint64_t>(File.gcount()) != Length) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Could not read temporary file");
+    }
+
+    Aws::S3::Model::UploadPartRequest Request;
+    Request.SetBucket(Bucket);
+    Request.SetKey(Key.str());
+    Request.SetUploadId(UploadID);
+    // Part numbers start from 1
+    Request.SetPartNumber(Index + 1);
+    Request.SetContentLength(Length);
+    Request.SetBody(std::make_shared<std::stringstream>(std::move(Data),
+                                                        std::ios_base::in
+                                                          | std::ios_base::
+                                                            binary));
+
+    auto Result = Client.UploadPart(Request);
+    if (not Result.IsSuccess())
+      return toError(Result);
+
+    Parts[Index].SetPartNumber(Index + 1);
+    Parts[Index].SetETag(Result.GetResult().GetETag());
+    return llvm::Error::success();
+  };
+
+  llvm::Error Error = forEachPart(PartCount, UploadPart);
+  if (not Error) {
+    Aws::S3::Model::CompletedMultipartUpload Upload;
+    Upload.SetParts(Aws::Vector<Aws::S3::Model::CompletedPart>(Parts.begin(),
+                                                               Parts.end()));
+
+    Aws::S3::Model::CompleteMultipartUploadRequest Request;
+    Request.SetBucket(Bucket);
+    Request.SetKey(Key.str());
+    Request.SetUploadId(UploadID);
+    Request.SetMultipartUpload(std::move(Upload));
+
+    auto Result = Client.CompleteMultipartUpload(Request);
+    if (Result.IsSuccess())
+      return llvm::Error::success();
+
+    Error = toError(Result);
+  }
+
+  // Do not leave the uploaded parts around, they would be billed
+  Aws::S3::Model::AbortMultipartUploadRequest AbortRequest;
+  AbortRequest.SetBucket(Bucket);
+  AbortRequest.SetKey(Key.str());
+  AbortRequest.SetUploadId(UploadID);
+  auto AbortResult = Client.AbortMultipartUpload(AbortRequest);
+  if (not AbortResult.IsSuccess())
+    return llvm::joinErrors(std::move(Error), toError(AbortResult));
+
+  return Error;
+}
+
+llvm::Error S3StorageClient::getObject(llvm::StringRef Key,
+                                       llvm::StringRef FilePath) {
+  using Aws::Http::HttpResponseCode::REQUESTED_RANGE_NOT_SATISFIABLE;
+  uint64_t PartSize = getPartSize();
+
+  // Fetch the first part, its Content-Range tells us the size of the object
+  Aws::S3::Model::GetObjectRequest Request;
   Request.SetBucket(Bucket);
-  Request.SetKey(resolvePath(IndexName));
+  Request.SetKey(Key.str());
+  Request.SetRange(makeRange(0, PartSize));
 
-  auto Stream = std::make_shared<std::stringstream>(SerializedIndex,
-                                                    std::ios_base::in
-                                                      | std::ios_base::binary);
+  Aws::S3::Model::GetObjectOutcome Result = Client.GetObject(Request);
+  if (not Result.IsSuccess()
+      and Result.GetError().GetResponseCode()
+            == REQUESTED_RANGE_NOT_SATISFIABLE) {
+    // Empty objects cannot satisfy any range
+    Aws::S3::Model::GetObjectRequest WholeRequest;
+    WholeRequest.SetBucket(Bucket);
+    WholeRequest.SetKey(Key.str());
+    Result = Client.GetObject(WholeRequest);
+  }
 
-  Request.SetBody(Stream);
-  Aws::S3::Model::PutObjectOutcome Result = Client.PutObject(Request);
   if (not Result.IsSuccess())
     return toError(Result);
 
+  {
+    std::ofstream OS(FilePath.str(), std::ios::binary);
+    if (OS.fail()) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Could not open temporary file");
+    }
+
+    copyStream(Result.GetResult().GetBody(), OS);
+  }
+
+  // No Content-Range means that the whole object has been returned
+  std::optional<uint64_t>
+    MaybeSize = parseTotalSize(Result.GetResult().GetContentRange());
+  if (not MaybeSize.has_value() or *MaybeSize <= PartSize)
+    return llvm::Error::success();
+
+  uint64_t Size = *MaybeSize;
+  size_t PartCount = (Size + PartSize - 1) / PartSize;
+  auto DownloadPart = [&](size_t Index) -> llvm::Error {
+    // The first part has already been downloaded
+    uint64_t Offset = (Index + 1) * PartSize;
+    uint64_t End = std::min(Offset + PartSize, Size);
+
+    Aws::S3::Model::GetObjectRequest Request;
+    Request.SetBucket(Bucket);
+    Request.SetKey(Key.str());
+    Request.SetRange(makeRange(Offset, End));
+
+    Aws::S3::Model::GetObjectOutcome Result = Client.GetObject(Request);
+    if (not Result.IsSuccess())
+      return toError(Result);
+
+    std::fstream OS(FilePath.str(),
+                    std::ios::in | std::ios::out | std::ios::binary);
+    if (OS.fail()) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Could not open temporary file");
+    }
+
+    OS.seekp(Offset);
+    copyStream(Result.GetResult().GetBody(), OS);
+    OS.flush();
+    if (OS.fail()) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Could not write temporary file");
+    }
+
+    return llvm::Error::success();
+  };
+
+  return forEachPart(PartCount - 1, DownloadPart);
+}
+
+llvm::Expected<std::string>
+S3StorageClient::getCachedObject(llvm::StringRef Key) {
+  using Aws::Http::HttpResponseCode::NOT_MODIFIED;
+  namespace fs = llvm::sys::fs;
+
+  if (std::error_code EC = fs::create_directories(CacheDirectory.getValue()))
+    return llvm::createStringError(EC, "Could not create the S3 cache");
+
+  // Keys are unique across the buckets reachable from the same endpoint
+  std::string FullKey = Bucket + "/" + Key.str();
+  auto Hash = llvm::SHA1::hash(llvm::arrayRefFromStringRef(FullKey));
+  std::string Name = llvm::toHex(Hash, true);
+  std::string DataPath = joinPath(CacheDirectory.getValue(), Name);
+  std::string ETagPath = DataPath + ".etag";
+
+  std::string CachedETag;
+  if (fs::exists(DataPath)) {
+    if (auto MaybeETag = llvm::MemoryBuffer::getFile(ETagPath))
+      CachedETag = MaybeETag.get()->getBuffer().str();
+  }
+
+  Aws::S3::Model::HeadObjectRequest Request;
+  Request.SetBucket(Bucket);
+  Request.SetKey(Key.str());
+  if (not CachedETag.empty())
+    Request.SetIfNoneMatch(CachedETag);
+
+  Aws::S3::Model::HeadObjectOutcome Result = Client.HeadObject(Request);
+  if (not Result.IsSuccess()) {
+    if (not CachedETag.empty()
+        and Result.GetError().GetResponseCode() == NOT_MODIFIED) {
+      revng_log(CacheLogger, "Hit for " << Key.str());
+      // Mark it as recently used
+      if (auto MaybeFD = fs::openNativeFileForReadWrite(DataPath,
+                                                         fs::CD_OpenExisting,
+                                                         fs::OF_None)) {
+        fs::setLastAccessAndModificationTime(*MaybeFD,
+                                             std::chrono::system_clock::now());
+        fs::closeFile(*MaybeFD);
+      } else {
+        llvm::consumeError(MaybeFD.takeError());
+      }
+      return DataPath;
+    }
+
+    return toError(Result);
+  }
+
+  revng_log(CacheLogger, "Miss for " << Key.str());
+
+  // Download next to the final location and then rename, so that other
+  // processes sharing the cache never see partial objects
+  unsigned Random = llvm::sys::Process::GetRandomNumber();
+  std::string Suffix = ".tmp-" + std::to_string(Random);
+  std::string TemporaryPath = DataPath + Suffix;
+  if (auto Error = getObject(Key, TemporaryPath)) {
+    fs::remove(TemporaryPath);
+    return std::move(Error);
+  }
+
+  // Drop the old ETag first: until the new one is written, the object is
+  // considered not cached
+  fs::remove(ETagPath);
+  if (std::error_code EC = fs::rename(TemporaryPath, DataPath)) {
+    fs::remove(TemporaryPath);
+    return llvm::createStringError(EC, "Could not populate the S3 cache");
+  }
+
+  {
+    std::string TemporaryETagPath = ETagPath + Suffix;
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(TemporaryETagPath, EC);
+    if (not EC) {
+      OS << Result.GetResult().GetETag();
+      OS.close();
+      EC = fs::rename(TemporaryETagPath, ETagPath);
+    }
+
+    // Not being able to cache is not an error
+    if (EC)
+      revng_log(CacheLogger, "Could not write " << ETagPath << ": "
+                                                << EC.message());
+  }
+
+  evictFromCache(DataPath);
+  return DataPath;
+}
+
+void S3StorageClient::evictFromCache(llvm::StringRef InUse) {
+  namespace fs = llvm::sys::fs;
+
+  struct Entry {
+    std::string Path;
+    uint64_t Size;
+    llvm::sys::TimePoint<> LastUsed;
+  };
+  std::vector<Entry> Entries;
+  uint64_t Total = 0;
+
+  std::error_code EC;
+  for (fs::directory_iterator It(CacheDirectory.getValue(), EC), End;
+       It != End and not EC;
+       It.increment(EC)) {
+    llvm::StringRef Path = It->path();
+    if (Path.ends_with(".etag") or Path.contains(".tmp-"))
+      continue;
+
+    fs::file_status Status;
+    if (fs::status(Path, Status))
+      continue;
+
+    if (Status.type() != fs::file_type::regular_file)
+      continue;
+
+    // It takes space, but the caller is about to return it: never evict it,
+    // even if it's larger than the whole cache
+    if (fs::equivalent(Path, InUse)) {
+      Total += Status.getSize();
+      continue;
+    }
+
+    Entries.push_back({ Path.str(),
+                        Status.getSize(),
+                        Status.getLastModificationTime() });
+    Total += Status.getSize();
+  }
+
+  uint64_t Limit = uint64_t(CacheSizeMiB) * 1024 * 1024;
+  if (Total <= Limit)
+    return;
+
+  llvm::sort(Entries, [](const Entry &LHS, const Entry &RHS) {
+    return LHS.LastUsed < RHS.LastUsed;
+  });
+
+  for (const Entry &E : Entries) {
+    if (Total <= Limit)
+      break;
+
+    revng_log(CacheLogger, "Evicting " << E.Path);
+    fs::remove(E.Path + ".etag");
+    fs::remove(E.Path);
+    Total -= E.Size;
+  }
+}
+
+/// Packed files are recorded in the index as `<pack object>#<offset>,<size>`,
+/// with pack objects in a reserved directory
+static constexpr llvm::StringRef PacksDirectory = ".packs/";
+
+struct PackedLocation {
+  llvm::StringRef Pack;
+  uint64_t Offset = 0;
+  uint64_t Size = 0;
+};
+
+static std::optional<PackedLocation> parsePacked(llvm::StringRef Filename) {
+  if (not Filename.starts_with(PacksDirectory))
+    return std::nullopt;
+
+  auto [Pack, Range] = Filename.rsplit('#');
+  auto [Offset, Size] = Range.split(',');
+  PackedLocation Result{ .Pack = Pack };
+  if (Offset.getAsInteger(10, Result.Offset))
+    return std::nullopt;
+
+  if (Size.getAsInteger(10, Result.Size))
+    return std::nullopt;
+
+  return Result;
+}
+
+bool S3StorageClient::isReferenced(llvm::StringRef Filename) {
+  {
+    std::lock_guard Guard(FilenameMapMutex);
+    if (References.contains(Filename))
+      return true;
+  }
+
+  std::lock_guard Guard(PackMutex);
+  return Unpacked.contains(Filename);
+}
+
+void S3StorageClient::setFilename(llvm::StringRef Path, std::string Filename) {
+  auto [Iterator, Inserted] = FilenameMap.try_emplace(Path);
+  if (not Inserted)
+    dropReference(Iterator->second);
+  addReference(Filename);
+  Iterator->second = std::move(Filename);
+}
+
+void S3StorageClient::eraseFilename(llvm::StringRef Path) {
+  auto Iterator = FilenameMap.find(Path);
+  revng_assert(Iterator != FilenameMap.end());
+  dropReference(Iterator->second);
+  FilenameMap.erase(Iterator);
+}
+
+void S3StorageClient::addReference(llvm::StringRef Filename) {
+  ++References[Filename];
+}
+
+void S3StorageClient::dropReference(llvm::StringRef Filename) {
+  auto Iterator = References.find(Filename);
+  revng_assert(Iterator != References.end() and Iterator->second != 0);
+  if (--Iterator->second == 0)
+    References.erase(Iterator);
+}
+
+bool S3StorageClient::isPacked(llvm::StringRef Filename) {
+  if (parsePacked(Filename).has_value())
+    return true;
+
+  std::lock_guard Guard(PackMutex);
+  return Unpacked.count(Filename) != 0;
+}
+
+llvm::Expected<std::optional<std::string>>
+S3StorageClient::readPacked(llvm::StringRef Path,
+                            std::optional<std::string> &Filename) {
+  std::unique_lock Lock(PackMutex);
+  Filename = lookup(Path);
+  if (not Filename.has_value())
+    return std::nullopt;
+
+  if (auto It = Unpacked.find(*Filename); It != Unpacked.end())
+    return It->second;
+
+  std::optional<PackedLocation> Location = parsePacked(*Filename);
+  if (not Location.has_value())
+    return std::nullopt;
+
+  auto It = Packs.find(Location->Pack);
+  if (It == Packs.end()) {
+    // Download the whole pack, the files it holds are likely to be read too
+    Lock.unlock();
+    auto MaybeTemporary = TemporaryFile::make("revng-s3-storage");
+    if (!MaybeTemporary) {
+      return llvm::createStringError(MaybeTemporary.getError(),
+                                     "Could not create temporary file");
+    }
+
+    if (auto Error = getObject(resolvePath(Location->Pack),
+                               MaybeTemporary->path()))
+      return std::move(Error);
+
+    Lock.lock();
+    It = Packs.try_emplace(Location->Pack, std::move(MaybeTemporary.get()))
+           .first;
+  }
+
+  llvm::StringRef PackPath = It->second.path();
+  uint64_t PackSize = 0;
+  if (std::error_code EC = llvm::sys::fs::file_size(PackPath, PackSize))
+    return llvm::createStringError(EC, "Could not stat the pack");
+
+  if (Location->Offset + Location->Size > PackSize) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Pack %s is truncated",
+                                   Location->Pack.str().c_str());
+  }
+
+  auto MaybeBuffer = llvm::MemoryBuffer::getFileSlice(PackPath,
+                                                      Location->Size,
+                                                      Location->Offset);
+  if (not MaybeBuffer) {
+    return llvm::createStringError(MaybeBuffer.getError(),
+                                   "Could not read the pack");
+  }
+
+  return MaybeBuffer.get()->getBuffer().str();
+}
+
+llvm::Error S3StorageClient::commitPack() {
+  std::lock_guard Guard(PackMutex);
+  if (Unpacked.empty())
+    return llvm::Error::success();
+
+  std::string PackName = generateNewFilename(PacksDirectory.str() + "pack");
+
+  std::string Content;
+  llvm::StringMap<std::string> Locations;
+  for (auto &[Name, Data] : Unpacked) {
+    Locations[Name] = PackName + "#" + std::to_string(Content.size()) + ","
+                      + std::to_string(Data.size());
+    Content += Data;
+  }
+
+  auto MaybeTemporary = TemporaryFile::make("revng-s3-storage");
+  if (!MaybeTemporary) {
+    return llvm::createStringError(MaybeTemporary.getError(),
+                                   "Could not create temporary file");
+  }
+
+  {
+    std::error_code EC;
+    llvm::raw_fd_ostream OS(MaybeTemporary->path(), EC);
+    if (EC)
+      return llvm::createStringError(EC, "Could not open temporary file");
+    OS << Content;
+  }
+
+  if (auto Error = putObject(resolvePath(PackName),
+                             MaybeTemporary->path(),
+                             ContentEncoding::None))
+    return Error;
+
+  {
+    std::lock_guard Guard(FilenameMapMutex);
+    for (auto &Entry : FilenameMap) {
+      auto It = Locations.find(Entry.second);
+      if (It != Locations.end()) {
+        dropReference(Entry.second);
+        Entry.second = It->second;
+        addReference(Entry.second);
+      }
+    }
+  }
+
+  Packs.try_emplace(PackName, std::move(MaybeTemporary.get()));
+  Unpacked.clear();
+  return llvm::Error::success();
+}
+
+void S3StorageClient::prefetch(llvm::ArrayRef<std::string> Paths) {
+  for (const std::string &Path : Paths) {
+    // Packs are downloaded as a whole on first access anyway
+    std::optional<std::string> Filename = lookup(Path);
+    if (not Filename.has_value() or isPacked(*Filename))
+      continue;
+
+    std::lock_guard Lock(PrefetchMutex);
+    if (Prefetching.contains(*Filename))
+      continue;
+
+    auto Download = [this, Name = *Filename, Key = resolvePath(*Filename)]() {
+      if (StopPrefetching)
+        return;
+
+      if (not CacheDirectory.empty()) {
+        // getReadableFile will find it there
+        if (auto MaybeCached = getCachedObject(Key); not MaybeCached) {
+          revng_log(Logger,
+                    "Could not prefetch " << Key << ": "
+                                          << toString(MaybeCached.takeError()));
+        }
+        return;
+      }
+
+      auto MaybeTemporary = TemporaryFile::make("revng-s3-storage");
+      if (!MaybeTemporary) {
+        revng_log(Logger,
+                  "Could not prefetch " << Key << ": "
+                                        << MaybeTemporary.getError().message());
+        return;
+      }
+
+      if (auto Error = getObject(Key, MaybeTemporary->path())) {
+        revng_log(Logger,
+                  "Could not prefetch " << Key << ": "
+                                        << toString(std::move(Error)));
+        return;
+      }
+
+      std::lock_guard Lock(PrefetchMutex);
+      Prefetched.try_emplace(Name, std::move(MaybeTemporary.get()));
+    };
+
+    revng_log(Logger, "Prefetching " << Path);
+    Prefetching.try_emplace(*Filename, PrefetchPool.async(std::move(Download)));
+  }
+}
+
+bool S3StorageClient::isPrefetching(llvm::StringRef Filename) {
+  std::lock_guard Lock(PrefetchMutex);
+  return Prefetching.contains(Filename);
+}
+
+std::optional<TemporaryFile>
+S3StorageClient::takePrefetched(llvm::StringRef Filename) {
+  std::shared_future<void> Download;
+  {
+    std::lock_guard Lock(PrefetchMutex);
+    auto Iterator = Prefetching.find(Filename);
+    if (Iterator == Prefetching.end())
+      return std::nullopt;
+
+    Download = Iterator->second;
+    Prefetching.erase(Iterator);
+  }
+
+  Download.wait();
+
+  std::lock_guard Lock(PrefetchMutex);
+  auto Iterator = Prefetched.find(Filename);
+  if (Iterator == Prefetched.end())
+    return std::nullopt;
+
+  TemporaryFile Result = std::move(Iterator->second);
+  Prefetched.erase(Iterator);
+  return Result;
+}
+
+static std::string sideIndexName(llvm::StringRef Name) {
+  return (".side-indexes/" + Name + ".yml").str();
+}
+
+llvm::Error S3StorageClient::commit() {
+  // The index must refer to the final location of the packed files
+  if (auto Error = commitPack())
+    return Error;
+
+  llvm::StringMap<std::string> Index;
+  std::vector<std::string> ToDrop;
+  {
+    std::lock_guard Guard(FilenameMapMutex);
+    Index = FilenameMap;
+    ToDrop = std::move(MergedSideIndexes);
+    MergedSideIndexes.clear();
+  }
+
+  if (auto Error = storeIndex(IndexName, Index))
+    return Error;
+
+  // Only now the side indexes are no longer needed to find the files they
+  // hold
+  for (const std::string &Name : ToDrop) {
+    Aws::S3::Model::DeleteObjectRequest Request;
+    Request.SetBucket(Bucket);
+    Request.SetKey(resolvePath(sideIndexName(Name)));
+    Aws::S3::Model::DeleteObjectOutcome Result = Client.DeleteObject(Request);
+    if (not Result.IsSuccess())
+      return toError(Result);
+  }
+
+  return llvm::Error::success();
+}
+
+llvm::Error S3StorageClient::commitSideIndex(llvm::StringRef Name) {
+  if (auto Error = commitPack())
+    return Error;
+
+  llvm::StringMap<std::string> Index;
+  {
+    std::lock_guard Guard(FilenameMapMutex);
+    for (const auto &Entry : Written)
+      Index[Entry.first()] = FilenameMap.lookup(Entry.first());
+  }
+
+  return storeIndex(sideIndexName(Name), Index);
+}
+
+llvm::Error S3StorageClient::mergeSideIndex(llvm::StringRef Name) {
+  llvm::StringMap<std::string> Index;
+  auto MaybeFound = loadIndex(sideIndexName(Name), Index);
+  if (not MaybeFound)
+    return MaybeFound.takeError();
+
+  if (not *MaybeFound) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Side index %s does not exist",
+                                   Name.str().c_str());
+  }
+
+  std::lock_guard Guard(FilenameMapMutex);
+  for (auto &Entry : Index)
+    setFilename(Entry.first(), std::move(Entry.second));
+  MergedSideIndexes.push_back(Name.str());
   return llvm::Error::success();
 }
 
@@ -4,16 +4,27 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include "aws/core/auth/AWSCredentials.h"
 #include "aws/s3/S3Client.h"
 
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/ThreadPool.h"
 
 #include "revng/Storage/StorageClient.h"
+#include "revng/Support/TemporaryFile.h"
 
 namespace revng {
 
+class S3ReadableStream;
 class S3WritableFile;
 
 class S3StorageClient : public StorageClient {
@@ -23,12 +34,44 @@ private:
   std::string Bucket;
   std::string SubPath;
   std::string RedactedURL;
+  /// Protects FilenameMap, References, Written and MergedSideIndexes, since
+  /// files can be read and written from different threads
+  std::mutex FilenameMapMutex;
+  /// Only modify through ::setFilename and ::eraseFilename, which keep
+  /// References up to date
   llvm::StringMap<std::string> FilenameMap;
+  /// How many paths of FilenameMap each object holds, so that ::isReferenced
+  /// does not have to go through all of them
+  llvm::StringMap<size_t> References;
+  /// Paths written by this client, for ::commitSideIndex
+  llvm::StringSet<> Written;
+  /// Side indexes merged since the last ::commit, which drops them
+  std::vector<std::string> MergedSideIndexes;
+  /// Protects Unpacked and Packs
+  std::mutex PackMutex;
+  /// Content of the small files committed since the last ::commit, by object
+  /// name, to be uploaded together as a single pack object
+  llvm::StringMap<std::string> Unpacked;
+  /// Local copies of the pack objects that have been uploaded or downloaded,
+  /// kept on disk since they are read a few files at a time
+  llvm::StringMap<TemporaryFile> Packs;
+  /// Protects Prefetching and Prefetched
+  std::mutex PrefetchMutex;
+  /// Downloads started by ::prefetch whose result has not been consumed yet,
+  /// by object name
+  llvm::StringMap<std::shared_future<void>> Prefetching;
+  /// Objects downloaded by ::prefetch, by object name
+  llvm::StringMap<TemporaryFile> Prefetched;
+  /// Set on destruction, so that the queued prefetches are dropped
+  std::atomic<bool> StopPrefetching = false;
+  /// Runs the downloads started by ::prefetch. Declared last so that it's
+  /// destroyed, waiting for them, before everything they use.
+  llvm::ThreadPool PrefetchPool;
   static constexpr auto IndexName = "index.yml";
 
 public:
   S3StorageClient(llvm::StringRef URL);
-  ~S3StorageClient() override = default;
+  ~S3StorageClient() override;
 
   static llvm::Expected<std::unique_ptr<S3StorageClient>>
   fromURL(llvm::StringRef URL);
@@ -48,10 +91,22 @@ public:
   llvm::Expected<std::unique_ptr<ReadableFile>>
   getReadableFile(llvm::StringRef Path) override;
 
+  llvm::Expected<std::unique_ptr<ReadableStream>>
+  getReadableStream(llvm::StringRef Path) override;
+
   llvm::Expected<std::unique_ptr<WritableFile>>
   getWritableFile(llvm::StringRef Path, ContentEncoding Encoding) override;
 
+  /// Downloads the objects in the background, into `-s3-cache-directory` if
+  /// set, otherwise into temporary files that the next ::getReadableFile of
+  /// each path will use
+  void prefetch(llvm::ArrayRef<std::string> Paths) override;
+
   llvm::Error commit() override;
+  /// Stores the paths written by this client in a side index object next to
+  /// the main index
+  llvm::Error commitSideIndex(llvm::StringRef Name) override;
+  llvm::Error mergeSideIndex(llvm::StringRef Name) override;
 
   // In S3StorageClient, the Credentials are in the format:
   // '<username>:<password>'
@@ -60,6 +115,61 @@ public:
 private:
   std::string dumpString() const override;
   std::string resolvePath(llvm::StringRef Path);
+  /// \return the name of the object holding \p Path, if any
+  std::optional<std::string> lookup(llvm::StringRef Path);
+
+  /// Downloads the index object \p Name into \p Map
+  /// \return false if there is no such object
+  llvm::Expected<bool> loadIndex(llvm::StringRef Name,
+                                 llvm::StringMap<std::string> &Map);
+  /// Uploads \p Map as the index object \p Name
+  llvm::Error storeIndex(llvm::StringRef Name,
+                         llvm::StringMap<std::string> &Map);
+
+  /// Uploads the file at \p FilePath as the object \p Key, in parallel parts
+  /// if it is larger than `-s3-part-size`
+  llvm::Error putObject(llvm::StringRef Key,
+                        llvm::StringRef FilePath,
+                        ContentEncoding Encoding);
+  /// Downloads the object \p Key into \p FilePath, fetching in parallel
+  /// ranges of `-s3-part-size` bytes
+  llvm::Error getObject(llvm::StringRef Key, llvm::StringRef FilePath);
+
+  /// \return the path of a copy of the object \p Key in `-s3-cache-directory`,
+  ///         downloading it unless the copy there has the same ETag
+  llvm::Expected<std::string> getCachedObject(llvm::StringRef Key);
+  /// \return true if the object \p Filename is already in use by some path,
+  ///         or is going to be uploaded in the next pack
+  bool isReferenced(llvm::StringRef Filename);
+  /// Makes \p Path point to the object \p Filename. FilenameMapMutex must be
+  /// held.
+  void setFilename(llvm::StringRef Path, std::string Filename);
+  /// Drops \p Path, which must exist. FilenameMapMutex must be held.
+  void eraseFilename(llvm::StringRef Path);
+  void addReference(llvm::StringRef Filename);
+  void dropReference(llvm::StringRef Filename);
+  /// \return true if \p Filename is stored in a pack, or will be
+  bool isPacked(llvm::StringRef Filename);
+  /// Look up \p Path, setting \p Filename to the object holding it, if any.
+  /// The lookup is done while holding PackMutex, so that ::commitPack can't
+  /// move the file in a pack in the meantime.
+  ///
+  /// \return the content of \p Path if it is stored in a pack, or will be
+  llvm::Expected<std::optional<std::string>>
+  readPacked(llvm::StringRef Path, std::optional<std::string> &Filename);
+  /// Uploads the files in Unpacked as a single object and updates the index
+  llvm::Error commitPack();
+  /// Removes the least recently used objects from `-s3-cache-directory`,
+  /// except for \p InUse, until it fits in `-s3-cache-size`
+  void evictFromCache(llvm::StringRef InUse);
+  /// \return true if a download of \p Filename has been started by ::prefetch
+  bool isPrefetching(llvm::StringRef Filename);
+  /// Waits for the download of \p Filename started by ::prefetch, if any.
+  /// \return the file it has been downloaded to, unless the download failed
+  ///         or went to the cache
+  std::optional<TemporaryFile> takePrefetched(llvm::StringRef Filename);
+
+  friend class S3ReadableStream;
   friend class S3WritableFile;
 };
 
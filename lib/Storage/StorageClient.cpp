@@ -16,6 +16,8 @@ revng::StorageClient::fromPathOrURL(llvm::StringRef URL) {
   if (S3StorageClient::isS3URL(URL)) {
     return S3StorageClient::fromURL(URL);
   } else {
-    return std::make_unique<revng::LocalStorageClient>(URL);
+    return std::make_unique<revng::LocalStorageClient>(URL,
+                                                       /* Deduplicate */ true,
+                                                       /* Journal */ true);
   }
 }
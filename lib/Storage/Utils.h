@@ -5,6 +5,10 @@
 //
 
 #include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SHA256.h"
 
 #include "revng/Support/PathList.h"
 
@@ -31,3 +35,22 @@ inline bool checkPath(llvm::StringRef InputPath, llvm::sys::path::Style Style) {
 
   return InputPath == Temp.substr(1);
 }
+
+/// \return the hex SHA-256 of the content of the file at \p Path, used to
+///         address files by their content
+inline llvm::Expected<std::string> hashFile(llvm::StringRef Path) {
+  auto MaybeBuffer = llvm::MemoryBuffer::getFile(Path,
+                                                 /* IsText */ false,
+                                                 /* RequiresNullTerminator */
+                                                 false,
+                                                 /* IsVolatile */ false);
+  if (not MaybeBuffer) {
+    return llvm::createStringError(MaybeBuffer.getError(),
+                                   "Could not read file %s",
+                                   Path.str().c_str());
+  }
+
+  llvm::StringRef Content = MaybeBuffer.get()->getBuffer();
+  auto Hash = llvm::SHA256::hash(llvm::arrayRefFromStringRef(Content));
+  return llvm::toHex(Hash, true);
+}
@@ -7,9 +7,13 @@
 
 #include <algorithm>
 #include <iostream>
+#include <map>
+#include <mutex>
 #include <string>
+#include <tuple>
 #include <vector>
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/IR/Value.h"
 #include "llvm/Support/ManagedStatic.h"
@@ -17,6 +21,7 @@
 #include "revng/Support/Assert.h"
 #include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
+#include "revng/Support/OnQuit.h"
 
 namespace cl = llvm::cl;
 using llvm::Twine;
@@ -31,6 +36,85 @@ static cl::opt<unsigned> MaxLocationLength("debug-location-max-length",
 
 size_t MaxLoggerNameLength = 0;
 
+bool revng::detail::AuditDisabledLoggers = false;
+
+/// The call sites found by -audit-disabled-loggers
+class DisabledLogSites {
+private:
+  struct Site {
+    std::string Logger;
+    uint64_t Lines = 0;
+    uint64_t Values = 0;
+  };
+
+private:
+  std::mutex Mutex;
+  std::map<std::pair<std::string, uint64_t>, Site> Sites;
+
+public:
+  DisabledLogSites() {
+    OnQuit->add([this] { dump(); });
+  }
+
+public:
+  void record(llvm::StringRef Name, const LogTerminator &Where, unsigned N) {
+    std::lock_guard Lock(Mutex);
+    Site &S = Sites[{ Where.File, Where.Line }];
+    S.Logger = Name.str();
+    ++S.Lines;
+    S.Values += N;
+  }
+
+  void dump() {
+    std::lock_guard Lock(Mutex);
+    if (Sites.empty())
+      return;
+
+    using Entry = std::pair<const std::pair<std::string, uint64_t>, Site>;
+    std::vector<const Entry *> Sorted;
+    for (const Entry &E : Sites)
+      Sorted.push_back(&E);
+    llvm::sort(Sorted, [](const Entry *LHS, const Entry *RHS) {
+      return LHS->second.Values > RHS->second.Values;
+    });
+
+    dbg << "Call sites streaming into disabled loggers:\n";
+    for (const Entry *E : Sorted) {
+      const auto &[Location, S] = *E;
+      dbg << "  " << Location.first << ":" << Location.second << " ("
+          << S.Logger << "): " << S.Values << " values in " << S.Lines
+          << " lines\n";
+    }
+  }
+};
+
+static DisabledLogSites &disabledLogSites() {
+  static DisabledLogSites Sites;
+  return Sites;
+}
+
+void revng::detail::recordDisabledLogSite(llvm::StringRef Name,
+                                          const LogTerminator &Site,
+                                          unsigned Values) {
+  disabledLogSites().record(Name, Site, Values);
+}
+
+// Register the report as soon as the option is parsed, not while it's printed
+static auto RegisterAudit = cl::callback([](const bool &Value) {
+  if (Value)
+    disabledLogSites();
+});
+
+static cl::opt<bool, true>
+  AuditDisabledLoggersOption("audit-disabled-loggers",
+                             cl::desc("upon exit, report the call sites that "
+                                      "streamed values into disabled "
+                                      "loggers without checking if they were "
+                                      "enabled first."),
+                             cl::location(revng::detail::AuditDisabledLoggers),
+                             RegisterAudit,
+                             cl::cat(MainCategory));
+
 /// A global registry for all the loggers
 ///
 /// Loggers are usually global static variables in translation units, the role
@@ -6,6 +6,7 @@
 
 #include <map>
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/InstrTypes.h"
@@ -32,18 +33,31 @@ llvm::MDNode *TagsSet::getMetadata(LLVMContext &C) const {
   return MDTuple::get(C, MDTags);
 }
 
+const Tag &TagsSet::fromName(const MDString *Name) {
+  // Looking up a tag by name is a linear scan over all the tags, and it's
+  // performed each time a function is checked for a tag. MDStrings are uniqued
+  // in their context, so the result can be memoized by address. Since the
+  // string might have been freed and its address reused by another one, the
+  // name is checked on each hit.
+  thread_local DenseMap<const MDString *, const Tag *> Cache;
+
+  const Tag *&Result = Cache[Name];
+  if (Result == nullptr or Result->name() != Name->getString()) {
+    Result = Tag::findByName(Name->getString());
+    revng_assert(Result != nullptr);
+  }
+
+  return *Result;
+}
+
 TagsSet TagsSet::from(const MDNode *MD) {
   TagsSet Result;
 
   if (MD == nullptr)
     return Result;
 
-  for (const MDOperand &Op : cast<MDTuple>(MD)->operands()) {
-    StringRef Name = cast<MDString>(Op.get())->getString();
-    Tag *T = Tag::findByName(Name);
-    revng_assert(T != nullptr);
-    Result.Tags.insert(T);
-  }
+  for (const MDOperand &Op : cast<MDTuple>(MD)->operands())
+    Result.Tags.insert(&fromName(cast<MDString>(Op.get())));
 
   return Result;
 }
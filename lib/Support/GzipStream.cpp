@@ -5,20 +5,36 @@
 //
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/GzipStream.h"
 
 #include "zlib.h"
 
+using namespace llvm::cl;
+
+opt<unsigned> GzipThreads("gzip-threads",
+                          desc("Number of threads compressing large buffers "
+                               "and archives in gzip (0 means the number of "
+                               "hardware threads)"),
+                          cat(MainCategory),
+                          init(0));
+
 constexpr size_t OutputBufferSize = 16 * 1024;
 static_assert(OutputBufferSize <= UINT_MAX);
 
 constexpr int WindowBits = 15 // 2**15 bytes (32k) of window
                            + 16; // Magic offset for gzip
 
-template<int (*Next)(z_stream *, int)>
+/// Size of the blocks that are compressed independently in parallel
+constexpr size_t ParallelBlockSize = 1024 * 1024;
+
+template<int (*Next)(z_stream *, int), int (*Reset)(z_stream *)>
 static void zlibCopyStream(z_stream &Stream,
                            llvm::raw_ostream &OutputOS,
                            llvm::ArrayRef<uint8_t> InputBuffer) {
@@ -47,6 +63,11 @@ static void zlibCopyStream(z_stream &Stream,
     // Compute bytes consumed
     RemainingInput -= InputSize - Stream.avail_in;
 
+    // The input is made of multiple concatenated gzip members, move on to the
+    // next one
+    if (RC == Z_STREAM_END and RemainingInput > 0)
+      revng_assert(Reset(&Stream) == Z_OK);
+
     if (Stream.avail_out == 0) {
       // Empty the buffer
       OutputOS.write(OutBufferPtr, OutBuffer.size());
@@ -79,10 +100,9 @@ static void zlibCopyStream(z_stream &Stream,
   OutputOS.flush();
 }
 
-void gzipCompress(llvm::raw_ostream &OutputOS,
-                  llvm::ArrayRef<uint8_t> InputBuffer,
-                  int CompressionLevel) {
-  revng_assert(CompressionLevel >= 1 and CompressionLevel <= 9);
+static void compressMember(llvm::raw_ostream &OutputOS,
+                           llvm::ArrayRef<uint8_t> InputBuffer,
+                           int CompressionLevel) {
   z_stream Stream = { .zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL };
 
   int Strategy = Z_DEFAULT_STRATEGY;
@@ -94,17 +114,59 @@ void gzipCompress(llvm::raw_ostream &OutputOS,
                         Strategy);
   revng_assert(RC == Z_OK);
 
-  zlibCopyStream<deflate>(Stream, OutputOS, InputBuffer);
+  zlibCopyStream<deflate, deflateReset>(Stream, OutputOS, InputBuffer);
 
   revng_assert(deflateEnd(&Stream) == Z_OK);
 }
 
+void gzipCompressSerially(llvm::raw_ostream &OutputOS,
+                          llvm::ArrayRef<uint8_t> InputBuffer,
+                          int CompressionLevel) {
+  revng_assert(CompressionLevel >= 1 and CompressionLevel <= 9);
+  compressMember(OutputOS, InputBuffer, CompressionLevel);
+}
+
+void gzipCompress(llvm::raw_ostream &OutputOS,
+                  llvm::ArrayRef<uint8_t> InputBuffer,
+                  int CompressionLevel) {
+  revng_assert(CompressionLevel >= 1 and CompressionLevel <= 9);
+
+  if (GzipThreads == 1 or InputBuffer.size() < 2 * ParallelBlockSize) {
+    compressMember(OutputOS, InputBuffer, CompressionLevel);
+    return;
+  }
+
+  // pigz-style: compress each block as a stand-alone gzip member, in parallel.
+  // A sequence of gzip members is still a valid gzip stream.
+  size_t BlockCount = (InputBuffer.size() + ParallelBlockSize - 1)
+                      / ParallelBlockSize;
+  std::vector<llvm::SmallVector<char, 0>> Compressed(BlockCount);
+  auto CompressBlock = [&](size_t Index) {
+    llvm::ArrayRef<uint8_t> Block = InputBuffer.slice(Index * ParallelBlockSize)
+                                      .take_front(ParallelBlockSize);
+    llvm::raw_svector_ostream OS(Compressed[Index]);
+    compressMember(OS, Block, CompressionLevel);
+  };
+
+  {
+    // Each task writes in its own slot of Compressed
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(GzipThreads));
+    for (size_t I = 0; I < BlockCount; ++I)
+      Pool.async(CompressBlock, I);
+    Pool.wait();
+  }
+
+  for (const llvm::SmallVector<char, 0> &Block : Compressed)
+    OutputOS.write(Block.data(), Block.size());
+  OutputOS.flush();
+}
+
 void gzipDecompress(llvm::raw_ostream &OutputOS,
                     llvm::ArrayRef<uint8_t> InputBuffer) {
   z_stream Stream = { .zalloc = Z_NULL, .zfree = Z_NULL, .opaque = Z_NULL };
   revng_assert(inflateInit2(&Stream, WindowBits) == Z_OK);
 
-  zlibCopyStream<inflate>(Stream, OutputOS, InputBuffer);
+  zlibCopyStream<inflate, inflateReset>(Stream, OutputOS, InputBuffer);
 
   revng_assert(inflateEnd(&Stream) == Z_OK);
 }
@@ -7,18 +7,37 @@
 
 // Some snippets of code were adapted from llvm/llvm/lib/Support/TarWriter.cpp
 
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 
+#include "revng/Support/CommandLine.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/GzipStream.h"
 #include "revng/Support/GzipTarFile.h"
+#include "revng/Support/ZstdStream.h"
 
 #include "archive.h"
 #include "archive_entry.h"
 
+using revng::TarCompression;
+
+llvm::cl::opt<TarCompression>
+  StoredArchiveCompression("stored-archive-compression",
+                           llvm::cl::desc("Compression of the archives stored "
+                                          "in the project directory"),
+                           llvm::cl::values(clEnumValN(TarCompression::Gzip,
+                                                       "gzip",
+                                                       "gzip"),
+                                            clEnumValN(TarCompression::Zstd,
+                                                       "zstd",
+                                                       "zstd")),
+                           llvm::cl::cat(MainCategory),
+                           llvm::cl::init(TarCompression::Zstd));
+
 // Each file in an archive must be aligned to this block size.
 static constexpr size_t BlockSize = 512;
 
@@ -129,15 +148,39 @@ static llvm::SmallString<BlockSize * 3> writePaxHeader(llvm::StringRef Path,
   return Result;
 }
 
-static void
-writeFileHeader(llvm::raw_ostream &OS, llvm::StringRef Path, size_t Size) {
+/// \param Serially whether to compress on the calling thread, since the caller
+///        is already compressing other files in parallel
+static void compress(llvm::raw_ostream &OS,
+                     TarCompression Compression,
+                     llvm::ArrayRef<char> Data,
+                     bool Serially = false) {
+  switch (Compression) {
+  case TarCompression::Gzip:
+    if (Serially)
+      return gzipCompressSerially(OS, Data);
+    return gzipCompress(OS, Data);
+  case TarCompression::Zstd:
+    if (Serially)
+      return zstdCompressSerially(OS, Data);
+    return zstdCompress(OS, Data);
+  }
+
+  revng_abort();
+}
+
+static void writeFileHeader(llvm::raw_ostream &OS,
+                            TarCompression Compression,
+                            llvm::StringRef Path,
+                            size_t Size) {
   llvm::SmallString<BlockSize * 3> FileHeader = writePaxHeader(Path, Size);
-  gzipCompress(OS, { FileHeader.data(), FileHeader.size() });
+  compress(OS, Compression, { FileHeader.data(), FileHeader.size() });
 }
 
-static void compressedPadding(llvm::raw_ostream &OS, size_t Size) {
+static void compressedPadding(llvm::raw_ostream &OS,
+                              TarCompression Compression,
+                              size_t Size) {
   llvm::SmallVector<char> Buffer(Size, '\0');
-  return gzipCompress(OS, { Buffer.data(), Buffer.size() });
+  return compress(OS, Compression, { Buffer.data(), Buffer.size() });
 }
 
 namespace revng {
@@ -149,63 +192,225 @@ OffsetDescriptor GzipTarWriter::append(llvm::StringRef Path,
   revng_assert(not Filenames.contains(Path));
 
   OffsetDescriptor Result = { .Start = OS->tell() };
-  writeFileHeader(*OS, Path, Data.size());
+  writeFileHeader(*OS, Compression, Path, Data.size());
 
   Result.DataStart = OS->tell();
-  gzipCompress(*OS, { Data.data(), Data.size() });
+  compress(*OS, Compression, Data);
 
   Result.PaddingStart = OS->tell();
   if (size_t Padding = computePadding(Data.size()); Padding % BlockSize != 0)
-    compressedPadding(*OS, Padding);
+    compressedPadding(*OS, Compression, Padding);
 
   Result.End = OS->tell();
   Filenames.insert(Path);
   return Result;
 }
 
+std::vector<OffsetDescriptor>
+GzipTarWriter::append(llvm::ArrayRef<Input> Inputs) {
+  revng_assert(OS != nullptr);
+
+  // Compress everything first, each file in its own slot
+  struct CompressedFile {
+    llvm::SmallVector<char, 0> Header;
+    llvm::SmallVector<char, 0> Data;
+    llvm::SmallVector<char, 0> Padding;
+  };
+  std::vector<CompressedFile> Compressed(Inputs.size());
+
+  bool Parallel = GzipThreads != 1 and Inputs.size() > 1;
+  auto Compress = [&](size_t Index) {
+    const Input &File = Inputs[Index];
+    CompressedFile &Output = Compressed[Index];
+
+    llvm::raw_svector_ostream HeaderOS(Output.Header);
+    writeFileHeader(HeaderOS, Compression, File.Name, File.Data.size());
+
+    // Don't start another pool from within this one's tasks
+    llvm::raw_svector_ostream DataOS(Output.Data);
+    compress(DataOS, Compression, File.Data, Parallel);
+
+    llvm::raw_svector_ostream PaddingOS(Output.Padding);
+    if (size_t Padding = computePadding(File.Data.size());
+        Padding % BlockSize != 0)
+      compressedPadding(PaddingOS, Compression, Padding);
+  };
+
+  if (not Parallel) {
+    for (size_t I = 0; I < Inputs.size(); ++I)
+      Compress(I);
+  } else {
+    llvm::ThreadPool Pool(llvm::hardware_concurrency(GzipThreads));
+    for (size_t I = 0; I < Inputs.size(); ++I)
+      Pool.async(Compress, I);
+    Pool.wait();
+  }
+
+  // Then write it out sequentially
+  std::vector<OffsetDescriptor> Result;
+  Result.reserve(Inputs.size());
+  for (auto &&[File, Output] : llvm::zip(Inputs, Compressed)) {
+    revng_assert(not Filenames.contains(File.Name));
+
+    OffsetDescriptor &Offsets = Result.emplace_back();
+    Offsets.Start = OS->tell();
+    OS->write(Output.Header.data(), Output.Header.size());
+
+    Offsets.DataStart = OS->tell();
+    OS->write(Output.Data.data(), Output.Data.size());
+
+    Offsets.PaddingStart = OS->tell();
+    OS->write(Output.Padding.data(), Output.Padding.size());
+
+    Offsets.End = OS->tell();
+    Filenames.insert(File.Name);
+  }
+
+  return Result;
+}
+
 void GzipTarWriter::close() {
   revng_assert(OS != nullptr);
   // The tar archive needs to be ended with two blocks of zeros
-  compressedPadding(*OS, BlockSize * 2);
+  compressedPadding(*OS, Compression, BlockSize * 2);
   OS->flush();
   OS = nullptr;
 }
 
-GzipTarReader::GzipTarReader(llvm::ArrayRef<char> Ref) {
-  Archive = archive_read_new();
+static llvm::Error archiveError(archive *Archive, const char *Default) {
+  const char *Message = archive_error_string(Archive);
+  if (Message == nullptr)
+    Message = Default;
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), Message);
+}
+
+/// \return whether \p EC, returned by a libarchive setup function, means the
+///         setup worked, possibly by falling back to an external program
+static bool isUsable(int EC) {
+  return EC == ARCHIVE_OK or EC == ARCHIVE_WARN;
+}
+
+static llvm::Expected<archive *> createReadArchive() {
+  archive *Archive = archive_read_new();
   revng_assert(Archive != NULL);
 
-  revng_assert(archive_read_support_filter_gzip(Archive) == ARCHIVE_OK);
-  revng_assert(archive_read_support_format_tar(Archive) == ARCHIVE_OK);
+  if (not isUsable(archive_read_support_filter_gzip(Archive))
+      or not isUsable(archive_read_support_filter_zstd(Archive))
+      or not isUsable(archive_read_support_format_tar(Archive))) {
+    llvm::Error Error = archiveError(Archive, "Cannot set up libarchive");
+    revng_assert(archive_read_free(Archive) == ARCHIVE_OK);
+    return Error;
+  }
 
-  int EC = archive_read_open_memory(Archive, Ref.data(), Ref.size());
-  revng_assert(EC == ARCHIVE_OK);
+  return Archive;
+}
+
+struct GzipTarReader::ReaderState {
+  ChunkReader Reader;
+  llvm::Error Error = llvm::Error::success();
+
+  ReaderState(ChunkReader Reader) : Reader(std::move(Reader)) {}
+  ~ReaderState() { llvm::consumeError(std::move(Error)); }
+
+  void fail(llvm::Error NewError) {
+    Error = llvm::joinErrors(std::move(Error), std::move(NewError));
+  }
+
+  static la_ssize_t
+  read(archive *Archive, void *ClientData, const void **Buffer) {
+    auto *State = static_cast<ReaderState *>(ClientData);
+    auto MaybeChunk = State->Reader();
+    if (not MaybeChunk) {
+      State->fail(MaybeChunk.takeError());
+      archive_set_error(Archive, EIO, "Could not read the archive");
+      return -1;
+    }
+
+    *Buffer = MaybeChunk->data();
+    return MaybeChunk->size();
+  }
+};
+
+GzipTarReader::GzipTarReader(llvm::ArrayRef<char> Ref) :
+  State(std::make_unique<ReaderState>(nullptr)) {
+  auto MaybeArchive = createReadArchive();
+  if (not MaybeArchive) {
+    State->fail(MaybeArchive.takeError());
+    return;
+  }
+
+  Archive = *MaybeArchive;
+  if (archive_read_open_memory(Archive, Ref.data(), Ref.size()) != ARCHIVE_OK)
+    State->fail(archiveError(Archive, "Cannot open the archive"));
+}
+
+GzipTarReader::GzipTarReader(ChunkReader Reader) :
+  State(std::make_unique<ReaderState>(std::move(Reader))) {
+  auto MaybeArchive = createReadArchive();
+  if (not MaybeArchive) {
+    State->fail(MaybeArchive.takeError());
+    return;
+  }
+
+  Archive = *MaybeArchive;
+  int EC = archive_read_open(Archive,
+                             State.get(),
+                             nullptr,
+                             &ReaderState::read,
+                             nullptr);
+
+  // Opening reads the first chunk to detect the compression
+  if (EC != ARCHIVE_OK and not State->Error)
+    State->fail(archiveError(Archive, "Cannot open the archive"));
 }
 
 GzipTarReader::~GzipTarReader() {
-  revng_assert(archive_read_free(Archive) == ARCHIVE_OK);
+  if (Archive != nullptr)
+    revng_assert(archive_read_free(Archive) == ARCHIVE_OK);
 }
 
 cppcoro::generator<ArchiveEntry> GzipTarReader::entries() {
+  // Opening the archive failed
+  if (State->Error)
+    co_return;
+
+  // Problems are reported through takeError rather than asserting, since they
+  // might be due to the network or to a corrupted file
+  auto Fail = [this]() {
+    if (not State->Error)
+      State->fail(archiveError(Archive, "Malformed archive"));
+  };
+
   archive_entry *Entry;
   while (true) {
     int Res = archive_read_next_header(Archive, &Entry);
     if (Res == ARCHIVE_EOF)
       co_return;
 
-    revng_assert(Res == ARCHIVE_OK);
+    if (Res != ARCHIVE_OK) {
+      Fail();
+      co_return;
+    }
+
     int64_t Size = archive_entry_size(Entry);
     revng_assert(Size >= 0);
 
     llvm::SmallVector<char, 0> Data;
     if (Size > 0) {
       Data.resize_for_overwrite(Size);
-      size_t SizeRead = archive_read_data(Archive, Data.data(), Size);
-      revng_assert(SizeRead == static_cast<size_t>(Size));
+      la_ssize_t SizeRead = archive_read_data(Archive, Data.data(), Size);
+      if (SizeRead != static_cast<la_ssize_t>(Size)) {
+        Fail();
+        co_return;
+      }
     }
 
     co_yield ArchiveEntry{ archive_entry_pathname(Entry), std::move(Data) };
   }
 }
 
+llvm::Error GzipTarReader::takeError() {
+  return std::move(State->Error);
+}
+
 } // namespace revng
@@ -9,18 +9,23 @@ extern "C" {
 #include "glob.h"
 }
 #include <map>
+#include <mutex>
+#include <set>
 #include <sstream>
 #include <vector>
 
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Object/Binary.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
 
-#include "revng/ADT/RecursiveCoroutine.h"
 #include "revng/ADT/STLExtras.h"
 #include "revng/Support/Debug.h"
 #include "revng/Support/Generator.h"
@@ -31,8 +36,45 @@ static Logger<> Log("lddtree");
 
 using namespace llvm;
 
+static cl::opt<unsigned> LDDTreeThreads("lddtree-threads",
+                                        cl::desc("Number of threads resolving "
+                                                 "the dependencies of each "
+                                                 "level of the tree (0 means "
+                                                 "all the available cores)"),
+                                        cl::init(0));
+
 constexpr unsigned MaxIncludeDepth = 5;
 
+/// A map from paths to values computed once per process, by the first thread
+/// asking for them
+template<typename T>
+class PathCache {
+private:
+  struct Entry {
+    std::once_flag Computed;
+    T Value;
+  };
+
+private:
+  std::mutex Mutex;
+  /// A std::map, so that entries never move
+  std::map<std::string, Entry> Entries;
+
+public:
+  template<typename CallableType>
+  const T &get(StringRef Path, const CallableType &Compute) {
+    Entry *Result = nullptr;
+    {
+      std::lock_guard Lock(Mutex);
+      Result = &Entries[Path.str()];
+    }
+
+    // Other paths can be computed concurrently
+    std::call_once(Result->Computed, [&] { Result->Value = Compute(Path); });
+    return Result->Value;
+  }
+};
+
 /// \see ldconfig.c from glibc
 class LdSoConfParser {
 private:
@@ -155,103 +197,6 @@ private:
   }
 };
 
-/// \see man ld.so
-static std::optional<std::string>
-findLibrary(StringRef ToImport,
-            StringRef ImporterPath,
-            bool Is64,
-            bool NoDefault,
-            uint16_t EMachine,
-            std::optional<StringRef> RPath,
-            std::optional<StringRef> RunPath) {
-  revng_log(Log, "Looking for " << ToImport);
-  LoggerIndent<> Indent(Log);
-
-  SmallVector<std::string, 16> SearchPaths;
-
-  // Process DT_RPATH
-  if (RPath and RPath->size())
-    for (StringRef Path : split(*RPath, ":"))
-      SearchPaths.push_back(Path.str());
-
-  // Process the `LD_LIBRARY_PATH`
-  if (auto MaybeLibraryPath = llvm::sys::Process::GetEnv("LD_LIBRARY_PATH"))
-    for (StringRef Path : split(*MaybeLibraryPath, ":"))
-      SearchPaths.push_back(Path.str());
-
-  // Process DT_RUNPATH
-  std::string Origin = llvm::sys::path::parent_path(ImporterPath).str();
-  std::string LibName = Is64 ? "lib64" : "lib";
-  if (RunPath and RunPath->size()) {
-    for (StringRef Path : split(*RunPath, ":")) {
-      std::string PathString = Path.str();
-      replaceAll(PathString, "$ORIGIN", Origin);
-      replaceAll(PathString, "${ORIGIN}", Origin);
-      replaceAll(PathString, "$LIB", LibName);
-      replaceAll(PathString, "${LIB}", LibName);
-      // TODO: handle PLATFORM
-      SearchPaths.push_back(PathString);
-    }
-  }
-
-  if (not NoDefault) {
-    LdSoConfParser(SearchPaths).parse();
-    SearchPaths.push_back("/" + LibName);
-    SearchPaths.push_back("/usr/" + LibName);
-  }
-
-  if (Log.isEnabled()) {
-    Log << "List of search paths:\n";
-    for (const std::string &SearchPath : SearchPaths)
-      Log << "  " << SearchPath << "\n";
-    Log << DoLog;
-  }
-
-  for (std::string SearchPath : SearchPaths) {
-    SmallString<128> Candidate;
-    sys::path::append(Candidate, SearchPath, ToImport);
-
-    if (not sys::fs::exists(Candidate)) {
-      revng_log(Log, Candidate.str() << " does not exist");
-      continue;
-    }
-
-    // Parse the binary
-    auto BinaryOrErr = object::createBinary(Candidate);
-    if (not BinaryOrErr) {
-      revng_log(Log,
-                "Can't create binary: " << toString(BinaryOrErr.takeError()));
-      llvm::consumeError(BinaryOrErr.takeError());
-      continue;
-    }
-
-    // Ensure it's an ELF
-    using namespace object;
-    auto *Elf = dyn_cast<ELFObjectFileBase>(BinaryOrErr->getBinary());
-    if (Elf == nullptr) {
-      revng_log(Log, "Found " << Candidate.str() << " but it's not an ELF.");
-      continue;
-    }
-
-    // Ensure it's the right machine
-    if (Elf->getEMachine() != EMachine) {
-      revng_log(Log,
-                "Found " << Candidate.str()
-                         << " but it has the wrong e_machine: "
-                         << Elf->getEMachine() << " (expected " << EMachine
-                         << ").");
-      continue;
-    }
-
-    revng_log(Log, "Found: " << Candidate.str());
-
-    return { Candidate.str().str() };
-  }
-
-  revng_log(Log, ToImport << " not found");
-  return std::nullopt;
-}
-
 template<class ELFT>
 std::optional<StringRef>
 getDynamicString(const llvm::object::ELFFile<ELFT> &TheELF,
@@ -337,24 +282,35 @@ getDynamicStringTable(const ELFT &ELFObjectFile,
   return {};
 }
 
+/// What resolving the dependencies of a binary needs to know about it
+struct DynamicInfo {
+  bool IsELF = false;
+  bool Is64 = false;
+  uint16_t EMachine = 0;
+  bool NoDefault = false;
+  std::optional<std::string> RPath;
+  std::optional<std::string> RunPath;
+  std::vector<std::string> Needed;
+};
+
 template<class ELFT>
-void lddtreeResolve(LDDTree &Dependencies,
-                    StringRef FileName,
-                    const ELFT &ELFObjectFile) {
+static void parseDynamic(DynamicInfo &Result, const ELFT &ELFObjectFile) {
   const auto &TheELF = ELFObjectFile.getELFFile();
 
+  Result.IsELF = true;
+  Result.Is64 = (std::is_same_v<ELFT, object::ELF64LEObjectFile>
+                 or std::is_same_v<ELFT, object::ELF64BEObjectFile>);
+  Result.EMachine = TheELF.getHeader().e_machine;
+
   auto MaybeDynamicEntries = TheELF.dynamicEntries();
   if (not MaybeDynamicEntries) {
     revng_log(Log, "No dynamic entries");
+    llvm::consumeError(MaybeDynamicEntries.takeError());
     return;
   }
   using Elf_Dyn_Range = ELFT::Elf_Dyn_Range;
   Elf_Dyn_Range DynamicEntries = *MaybeDynamicEntries;
 
-  std::optional<StringRef> RunPath;
-  std::optional<StringRef> RPath;
-  bool NoDefault = false;
-
   // Look for .dynstr
   StringRef DynamicStringTable;
   if (auto MaybeDynamicStringTable = getDynamicStringTable(ELFObjectFile,
@@ -366,88 +322,239 @@ void lddtreeResolve(LDDTree &Dependencies,
     return;
   }
 
-  // Look for DT_RPATH and DT_RUNPATH
+  auto ToString = [](std::optional<StringRef> String) {
+    return String ? std::optional(String->str()) : std::nullopt;
+  };
+
+  // Look for DT_RPATH, DT_RUNPATH and DT_NEEDED
   using Elf_Dyn = ELFT::Elf_Dyn;
   for (const Elf_Dyn &DynamicTag : DynamicEntries) {
     auto TheTag = DynamicTag.getTag();
     auto TheVal = DynamicTag.getVal();
     if (TheTag == llvm::ELF::DT_RUNPATH) {
-      RunPath = getDynamicString(TheELF, DynamicStringTable, TheVal);
+      Result.RunPath = ToString(getDynamicString(TheELF,
+                                                 DynamicStringTable,
+                                                 TheVal));
     } else if (TheTag == llvm::ELF::DT_RPATH) {
-      RPath = getDynamicString(TheELF, DynamicStringTable, TheVal);
+      Result.RPath = ToString(getDynamicString(TheELF,
+                                               DynamicStringTable,
+                                               TheVal));
     } else if (TheTag == llvm::ELF::DT_FLAGS_1) {
-      NoDefault = (TheVal & llvm::ELF::DF_1_NODEFLIB) != 0;
+      Result.NoDefault = (TheVal & llvm::ELF::DF_1_NODEFLIB) != 0;
+    } else if (TheTag == llvm::ELF::DT_NEEDED) {
+      auto LibName = getDynamicString(TheELF, DynamicStringTable, TheVal);
+      if (LibName)
+        Result.Needed.push_back(LibName->str());
+      else
+        revng_log(Log, "Unable to parse needed library name");
     }
   }
+}
 
-  bool Is64 = (std::is_same_v<ELFT, object::ELF64LEObjectFile>
-               or std::is_same_v<ELFT, object::ELF64BEObjectFile>);
+/// Binaries are parsed once per process: the same libraries appear many times
+/// in a dependency tree, and each search for a library parses its candidates
+static const DynamicInfo &parse(StringRef Path) {
+  static PathCache<DynamicInfo> Parsed;
+  return Parsed.get(Path, [](StringRef Path) {
+    revng_log(Log, "Parsing " << Path);
+    DynamicInfo Result;
 
-  for (const Elf_Dyn &DynamicTag : DynamicEntries) {
-    auto TheTag = DynamicTag.getTag();
-    auto TheVal = DynamicTag.getVal();
-    if (TheTag == llvm::ELF::DT_NEEDED) {
-      auto LibName = getDynamicString(TheELF, DynamicStringTable, TheVal);
-      if (!LibName) {
-        revng_log(Log, "Unable to parse needed library name");
-        continue;
-      }
+    using namespace object;
+    auto BinaryOrErr = createBinary(Path);
+    if (not BinaryOrErr) {
+      revng_log(Log,
+                "Can't create binary: " << toString(BinaryOrErr.takeError()));
+      llvm::consumeError(BinaryOrErr.takeError());
+      return Result;
+    }
+
+    auto *Binary = BinaryOrErr->getBinary();
+    if (auto *ELFObjectFile = dyn_cast<ELF32LEObjectFile>(Binary))
+      parseDynamic(Result, *ELFObjectFile);
+    else if (auto *ELFObjectFile = dyn_cast<ELF32BEObjectFile>(Binary))
+      parseDynamic(Result, *ELFObjectFile);
+    else if (auto *ELFObjectFile = dyn_cast<ELF64LEObjectFile>(Binary))
+      parseDynamic(Result, *ELFObjectFile);
+    else if (auto *ELFObjectFile = dyn_cast<ELF64BEObjectFile>(Binary))
+      parseDynamic(Result, *ELFObjectFile);
+    else
+      revng_log(Log, "Not an ELF.");
 
-      if (auto LocOfLib = findLibrary(*LibName,
-                                      FileName,
-                                      Is64,
-                                      NoDefault,
-                                      TheELF.getHeader().e_machine,
-                                      RPath,
-                                      RunPath))
-        Dependencies[FileName.str()].push_back(*LocOfLib);
+    return Result;
+  });
+}
+
+/// \return true if \p Directory contains an entry named \p Name.
+///
+/// Each search path is listed once per process, rather than probing it for
+/// each library.
+static bool directoryContains(StringRef Directory, StringRef Name) {
+  // Names with a slash are not simple directory entries
+  if (Name.contains('/')) {
+    SmallString<128> Path;
+    sys::path::append(Path, Directory, Name);
+    return sys::fs::exists(Path);
+  }
+
+  static PathCache<StringSet<>> Listings;
+  const StringSet<> &Entries = Listings.get(Directory, [](StringRef Directory) {
+    StringSet<> Result;
+    std::error_code EC;
+    for (sys::fs::directory_iterator It(Directory, EC), End;
+         not EC and It != End;
+         It.increment(EC))
+      Result.insert(sys::path::filename(It->path()));
+    return Result;
+  });
+
+  return Entries.contains(Name);
+}
+
+/// The search paths listed in ld.so.conf, parsed once per process
+static ArrayRef<std::string> systemSearchPaths() {
+  static const SmallVector<std::string, 16> SearchPaths = [] {
+    SmallVector<std::string, 16> Result;
+    LdSoConfParser(Result).parse();
+    return Result;
+  }();
+  return SearchPaths;
+}
+
+/// \see man ld.so
+static std::optional<std::string> findLibrary(StringRef ToImport,
+                                              StringRef ImporterPath,
+                                              const DynamicInfo &Importer) {
+  revng_log(Log, "Looking for " << ToImport);
+  LoggerIndent<> Indent(Log);
+
+  SmallVector<std::string, 16> SearchPaths;
+
+  // Process DT_RPATH
+  if (Importer.RPath and Importer.RPath->size())
+    for (StringRef Path : split(*Importer.RPath, ":"))
+      SearchPaths.push_back(Path.str());
+
+  // Process the `LD_LIBRARY_PATH`
+  if (auto MaybeLibraryPath = llvm::sys::Process::GetEnv("LD_LIBRARY_PATH"))
+    for (StringRef Path : split(*MaybeLibraryPath, ":"))
+      SearchPaths.push_back(Path.str());
+
+  // Process DT_RUNPATH
+  std::string Origin = llvm::sys::path::parent_path(ImporterPath).str();
+  std::string LibName = Importer.Is64 ? "lib64" : "lib";
+  if (Importer.RunPath and Importer.RunPath->size()) {
+    for (StringRef Path : split(*Importer.RunPath, ":")) {
+      std::string PathString = Path.str();
+      replaceAll(PathString, "$ORIGIN", Origin);
+      replaceAll(PathString, "${ORIGIN}", Origin);
+      replaceAll(PathString, "$LIB", LibName);
+      replaceAll(PathString, "${LIB}", LibName);
+      // TODO: handle PLATFORM
+      SearchPaths.push_back(PathString);
     }
   }
+
+  if (not Importer.NoDefault) {
+    llvm::append_range(SearchPaths, systemSearchPaths());
+    SearchPaths.push_back("/" + LibName);
+    SearchPaths.push_back("/usr/" + LibName);
+  }
+
+  if (Log.isEnabled()) {
+    Log << "List of search paths:\n";
+    for (const std::string &SearchPath : SearchPaths)
+      Log << "  " << SearchPath << "\n";
+    Log << DoLog;
+  }
+
+  for (const std::string &SearchPath : SearchPaths) {
+    SmallString<128> Candidate;
+    sys::path::append(Candidate, SearchPath, ToImport);
+
+    if (not directoryContains(SearchPath, ToImport)) {
+      revng_log(Log, Candidate.str() << " does not exist");
+      continue;
+    }
+
+    const DynamicInfo &Library = parse(Candidate);
+
+    // Ensure it's an ELF
+    if (not Library.IsELF) {
+      revng_log(Log, "Found " << Candidate.str() << " but it's not an ELF.");
+      continue;
+    }
+
+    // Ensure it's the right machine
+    if (Library.EMachine != Importer.EMachine) {
+      revng_log(Log,
+                "Found " << Candidate.str()
+                         << " but it has the wrong e_machine: "
+                         << Library.EMachine << " (expected "
+                         << Importer.EMachine << ").");
+      continue;
+    }
+
+    revng_log(Log, "Found: " << Candidate.str());
+
+    return { Candidate.str().str() };
+  }
+
+  revng_log(Log, ToImport << " not found");
+  return std::nullopt;
 }
 
-static RecursiveCoroutine<void> lddtreeHelper(LDDTree &Dependencies,
-                                              const std::string &Path,
-                                              unsigned CurrentLevel,
-                                              unsigned DepthLevel) {
+/// \return the paths of the libraries \p Path depends on
+static LDDTree::mapped_type resolve(const std::string &Path) {
   revng_log(Log, "lddtree for " << Path << "\n");
   LoggerIndent<> Ident(Log);
 
-  using namespace object;
-  auto BinaryOrErr = createBinary(Path);
-  if (not BinaryOrErr) {
-    revng_log(Log,
-              "Can't create binary: " << toString(BinaryOrErr.takeError()));
-    llvm::consumeError(BinaryOrErr.takeError());
-    rc_return;
-  }
+  LDDTree::mapped_type Result;
+  const DynamicInfo &Binary = parse(Path);
+  for (const std::string &Needed : Binary.Needed)
+    if (auto LocOfLib = findLibrary(Needed, Path, Binary))
+      Result.push_back(*LocOfLib);
 
-  auto *Binary = BinaryOrErr->getBinary();
-  if (auto *ELFObjectFile = dyn_cast<ELF32LEObjectFile>(Binary))
-    lddtreeResolve(Dependencies, Path, *ELFObjectFile);
-  else if (auto *ELFObjectFile = dyn_cast<ELF32BEObjectFile>(Binary))
-    lddtreeResolve(Dependencies, Path, *ELFObjectFile);
-  else if (auto *ELFObjectFile = dyn_cast<ELF64LEObjectFile>(Binary))
-    lddtreeResolve(Dependencies, Path, *ELFObjectFile);
-  else if (auto *ELFObjectFile = dyn_cast<ELF64BEObjectFile>(Binary))
-    lddtreeResolve(Dependencies, Path, *ELFObjectFile);
-  else
-    revng_log(Log, "Not an ELF.");
-
-  if (CurrentLevel == DepthLevel)
-    rc_return;
-
-  ++CurrentLevel;
-  for (auto &I : Dependencies) {
-    revng_log(Log, "Dependencies for " << I.first << ":\n");
-    for (auto &J : I.second)
-      if (!Dependencies.contains(J))
-        rc_recur lddtreeHelper(Dependencies, J, CurrentLevel, DepthLevel);
-  }
+  return Result;
 }
 
 void lddtree(LDDTree &Dependencies,
              const std::string &Path,
              unsigned DepthLevel) {
-  if (DepthLevel > 0)
-    lddtreeHelper(Dependencies, Path, 1, DepthLevel);
+  // Visit the tree one level at a time, resolving the libraries of the same
+  // level in parallel
+  std::set<std::string> Visited = { Path };
+  std::vector<std::string> Level = { Path };
+  for (unsigned CurrentLevel = 1;
+       CurrentLevel <= DepthLevel and not Level.empty();
+       ++CurrentLevel) {
+    std::vector<LDDTree::mapped_type> Resolved(Level.size());
+    auto Resolve = [&Level, &Resolved](size_t Index) {
+      Resolved[Index] = resolve(Level[Index]);
+    };
+
+    if (LDDTreeThreads == 1 or Level.size() <= 1) {
+      for (size_t Index = 0; Index < Level.size(); ++Index)
+        Resolve(Index);
+    } else {
+      ThreadPool Pool(hardware_concurrency(LDDTreeThreads));
+      for (size_t Index = 0; Index < Level.size(); ++Index)
+        Pool.async(Resolve, Index);
+      Pool.wait();
+    }
+
+    std::vector<std::string> NextLevel;
+    for (auto &&[File, Libraries] : llvm::zip(Level, Resolved)) {
+      if (Libraries.empty())
+        continue;
+
+      for (const std::string &Library : Libraries)
+        if (not Dependencies.contains(Library)
+            and Visited.insert(Library).second)
+          NextLevel.push_back(Library);
+
+      llvm::append_range(Dependencies[File], Libraries);
+    }
+
+    Level = std::move(NextLevel);
+  }
 }
@@ -0,0 +1,171 @@
+/// \file Metrics.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "llvm/Support/Format.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Metrics.h"
+
+using namespace llvm;
+
+namespace {
+
+struct Registry {
+  std::mutex Mutex;
+  std::vector<revng::MetricFamily *> Families;
+};
+
+} // namespace
+
+/// Never destroyed, since families might be destroyed after it otherwise
+static Registry &getRegistry() {
+  static Registry *Instance = new Registry;
+  return *Instance;
+}
+
+static void writeDouble(raw_ostream &OS, double Value) {
+  OS << format("%.9g", Value);
+}
+
+namespace revng {
+
+MetricFamily::MetricFamily(StringRef Name, StringRef Help, StringRef Label) :
+  Name(Name.str()), Help(Help.str()), Label(Label.str()) {
+  Registry &TheRegistry = getRegistry();
+  std::lock_guard Lock(TheRegistry.Mutex);
+  TheRegistry.Families.push_back(this);
+}
+
+MetricFamily::~MetricFamily() {
+  Registry &TheRegistry = getRegistry();
+  std::lock_guard Lock(TheRegistry.Mutex);
+  std::erase(TheRegistry.Families, this);
+}
+
+void MetricFamily::writeHeader(raw_ostream &OS, StringRef Type) const {
+  OS << "# TYPE " << Name << " " << Type << "\n";
+  if (StringRef(Name).ends_with("_seconds"))
+    OS << "# UNIT " << Name << " seconds\n";
+  OS << "# HELP " << Name << " " << Help << "\n";
+}
+
+void MetricFamily::writeLabel(raw_ostream &OS, StringRef Value) const {
+  OS << Label << "=\"";
+  for (char C : Value) {
+    if (C == '\\')
+      OS << "\\\\";
+    else if (C == '"')
+      OS << "\\\"";
+    else if (C == '\n')
+      OS << "\\n";
+    else
+      OS << C;
+  }
+  OS << "\"";
+}
+
+void CounterFamily::increment(StringRef LabelValue, uint64_t Value) {
+  Shards.update([LabelValue, Value](Container &Map) {
+    auto It = Map.find(LabelValue);
+    if (It == Map.end())
+      Map.emplace(LabelValue.str(), Value);
+    else
+      It->second += Value;
+  });
+}
+
+std::map<std::string, uint64_t> CounterFamily::aggregate() {
+  std::map<std::string, uint64_t> Result;
+  Shards.forEach([&Result](const Container &Map) {
+    for (const auto &[Key, Value] : Map)
+      Result[Key] += Value;
+  });
+  return Result;
+}
+
+void CounterFamily::writeOpenMetrics(raw_ostream &OS) {
+  writeHeader(OS, "counter");
+  for (const auto &[LabelValue, Value] : aggregate()) {
+    OS << Name << "_total{";
+    writeLabel(OS, LabelValue);
+    OS << "} " << Value << "\n";
+  }
+}
+
+using LHF = LatencyHistogramFamily;
+void LHF::Histogram::merge(const Histogram &Other) {
+  for (size_t I = 0; I < Buckets.size(); ++I)
+    Buckets[I] += Other.Buckets[I];
+  Count += Other.Count;
+  Sum += Other.Sum;
+}
+
+void LHF::record(StringRef LabelValue, double Seconds) {
+  auto Bucket = std::lower_bound(Bounds.begin(), Bounds.end(), Seconds)
+                - Bounds.begin();
+  Shards.update([LabelValue, Seconds, Bucket](Container &Map) {
+    auto It = Map.find(LabelValue);
+    if (It == Map.end())
+      It = Map.emplace(LabelValue.str(), Histogram()).first;
+
+    Histogram &Entry = It->second;
+    ++Entry.Buckets[Bucket];
+    ++Entry.Count;
+    Entry.Sum += Seconds;
+  });
+}
+
+std::map<std::string, LHF::Histogram> LHF::aggregate() {
+  std::map<std::string, Histogram> Result;
+  Shards.forEach([&Result](const Container &Map) {
+    for (const auto &[Key, Value] : Map)
+      Result[Key].merge(Value);
+  });
+  return Result;
+}
+
+void LHF::writeOpenMetrics(raw_ostream &OS) {
+  writeHeader(OS, "histogram");
+  for (const auto &[LabelValue, Entry] : aggregate()) {
+    uint64_t Cumulative = 0;
+    for (size_t I = 0; I < Entry.Buckets.size(); ++I) {
+      Cumulative += Entry.Buckets[I];
+      OS << Name << "_bucket{";
+      writeLabel(OS, LabelValue);
+      OS << ",le=\"";
+      if (I < Bounds.size())
+        writeDouble(OS, Bounds[I]);
+      else
+        OS << "+Inf";
+      OS << "\"} " << Cumulative << "\n";
+    }
+    revng_assert(Cumulative == Entry.Count);
+
+    OS << Name << "_count{";
+    writeLabel(OS, LabelValue);
+    OS << "} " << Entry.Count << "\n";
+
+    OS << Name << "_sum{";
+    writeLabel(OS, LabelValue);
+    OS << "} ";
+    writeDouble(OS, Entry.Sum);
+    OS << "\n";
+  }
+}
+
+void writeOpenMetrics(raw_ostream &OS) {
+  Registry &TheRegistry = getRegistry();
+  std::lock_guard Lock(TheRegistry.Mutex);
+  for (MetricFamily *Family : TheRegistry.Families)
+    Family->writeOpenMetrics(OS);
+  OS << "# EOF\n";
+}
+
+} // namespace revng
@@ -127,9 +127,54 @@ void ModuleStatistics::dump(llvm::raw_ostream &Output,
   EMIT(DebugGloblaVariablesCount);
   EMIT(DebugTypesCount);
 
+  EMIT(BasicBlocksCount);
+  EMIT(ArgumentsCount);
+  EMIT(OperandsCount);
+
 #undef EMIT
 }
 
+void ModuleStatistics::addFunction(const llvm::Function &F) {
+  using namespace FunctionTags;
+
+  AllFunctions.process(F);
+
+  for (const Tag *FunctionTag : TagsSet::from(&F))
+    TaggedFunctions[FunctionTag].process(F);
+
+  ArgumentsCount += F.arg_size();
+  for (const BasicBlock &BB : F) {
+    ++BasicBlocksCount;
+    for (const Instruction &I : BB)
+      OperandsCount += I.getNumOperands();
+  }
+}
+
+void ModuleStatistics::removeFunction(const llvm::Function &F) {
+  using namespace FunctionTags;
+
+  AllFunctions.remove(F);
+
+  for (const Tag *FunctionTag : TagsSet::from(&F)) {
+    auto It = TaggedFunctions.find(FunctionTag);
+    revng_assert(It != TaggedFunctions.end());
+    It->second.remove(F);
+    if (It->second.empty())
+      TaggedFunctions.erase(It);
+  }
+
+  revng_assert(ArgumentsCount >= F.arg_size());
+  ArgumentsCount -= F.arg_size();
+  for (const BasicBlock &BB : F) {
+    revng_assert(BasicBlocksCount > 0);
+    --BasicBlocksCount;
+    for (const Instruction &I : BB) {
+      revng_assert(OperandsCount >= I.getNumOperands());
+      OperandsCount -= I.getNumOperands();
+    }
+  }
+}
+
 ModuleStatistics ModuleStatistics::analyze(const llvm::Module &M) {
   using namespace FunctionTags;
 
@@ -156,12 +201,8 @@ ModuleStatistics ModuleStatistics::analyze(const llvm::Module &M) {
   }
 
   // Measure functions
-  for (const Function &F : M) {
-    Result.AllFunctions.process(F);
-
-    for (const Tag *FunctionTag : TagsSet::from(&F))
-      Result.TaggedFunctions[FunctionTag].process(F);
-  }
+  for (const Function &F : M)
+    Result.addFunction(F);
 
   // Measure types
   {
@@ -4,6 +4,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <map>
+
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/Support/ModRef.h"
@@ -780,6 +782,71 @@ void PCH::addCaseToDispatcher(SwitchInst *Root,
   ::addCase(AddressSwitch, MA.address(), BB);
 }
 
+/// Drops \p Case from \p Parent if the switch it leads to has no cases left
+///
+/// \return the iterator to the next case to visit
+static SwitchInst::CaseIt removeIfEmpty(SwitchInst *Parent,
+                                        SwitchInst::CaseIt Case) {
+  SwitchInst *Next = getNextSwitch(Case);
+  if (Next->getNumCases() != 0)
+    return std::next(Case);
+
+  BasicBlock *NextBB = Next->getParent();
+  auto Result = Parent->removeCase(Case);
+  eraseFromParent(NextBB);
+  return Result;
+}
+
+void PCH::updateDispatcher(SwitchInst *Root,
+                           const DispatcherTargets &Targets,
+                           optional<BlockType::Values> SetBlockType) const {
+  std::map<MetaAddress, BasicBlock *> Missing(Targets.begin(), Targets.end());
+
+  auto CaseValue = [](const SwitchInst::CaseHandle &Case) -> uint64_t {
+    return Case.getCaseValue()->getZExtValue();
+  };
+
+  // Visit the existing cases: keep those that are still required, drop the
+  // others along with the switches left empty
+  for (auto EpochIt = Root->case_begin(); EpochIt != Root->case_end();) {
+    SwitchInst *AddressSpaceSwitch = getNextSwitch(EpochIt);
+    auto AddressSpaceIt = AddressSpaceSwitch->case_begin();
+    while (AddressSpaceIt != AddressSpaceSwitch->case_end()) {
+      SwitchInst *TypeSwitch = getNextSwitch(AddressSpaceIt);
+      for (auto TypeIt = TypeSwitch->case_begin();
+           TypeIt != TypeSwitch->case_end();) {
+        SwitchInst *AddressSwitch = getNextSwitch(TypeIt);
+        auto Type = static_cast<MetaAddressType::Values>(CaseValue(*TypeIt));
+        auto AddressIt = AddressSwitch->case_begin();
+        while (AddressIt != AddressSwitch->case_end()) {
+          MetaAddress MA(CaseValue(*AddressIt),
+                         Type,
+                         CaseValue(*EpochIt),
+                         CaseValue(*AddressSpaceIt));
+          auto TargetIt = Missing.find(MA);
+          if (TargetIt != Missing.end()
+              and TargetIt->second == AddressIt->getCaseSuccessor()) {
+            Missing.erase(TargetIt);
+            ++AddressIt;
+          } else {
+            AddressIt = AddressSwitch->removeCase(AddressIt);
+          }
+        }
+
+        TypeIt = removeIfEmpty(TypeSwitch, TypeIt);
+      }
+
+      AddressSpaceIt = removeIfEmpty(AddressSpaceSwitch, AddressSpaceIt);
+    }
+
+    EpochIt = removeIfEmpty(Root, EpochIt);
+  }
+
+  // Add the new cases
+  for (const DispatcherTarget &Target : Missing)
+    addCaseToDispatcher(Root, Target, SetBlockType);
+}
+
 void PCH::destroyDispatcher(SwitchInst *Root) const {
   SwitchManager SM(Root, EpochCSV, AddressSpaceCSV, TypeCSV, AddressCSV, {});
   SM.destroy(Root);
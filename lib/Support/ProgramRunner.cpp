@@ -6,9 +6,21 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+extern "C" {
+#include "fcntl.h"
+#include "poll.h"
+#include "spawn.h"
+#include "sys/wait.h"
+#include "unistd.h"
+}
+
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <utility>
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/Program.h"
@@ -51,8 +63,7 @@ bool ProgramRunner::isProgramAvailable(llvm::StringRef ProgramName) {
   return true;
 }
 
-int ProgramRunner::run(llvm::StringRef ProgramName,
-                       ArrayRef<std::string> Args) {
+std::string ProgramRunner::findProgram(llvm::StringRef ProgramName) const {
   llvm::SmallVector<llvm::StringRef, 64> PathsRef;
   for (const std::string &Path : Paths)
     PathsRef.push_back(llvm::StringRef(Path));
@@ -63,18 +74,224 @@ int ProgramRunner::run(llvm::StringRef ProgramName,
                (ProgramName + " was not found in " + getenv("PATH"))
                  .str()
                  .c_str());
+  return *MaybeProgramPath;
+}
 
-  // Prepare actual arguments
-  std::vector<StringRef> StringRefs{ *MaybeProgramPath };
-  DILogger << "Running " << StringRefs[0].str()
-           << " with the following arguments:\n";
-  for (const std::string &Arg : Args) {
-    StringRefs.push_back(Arg);
+static void logInvocation(llvm::StringRef Path, ArrayRef<std::string> Args) {
+  DILogger << "Running " << Path.str() << " with the following arguments:\n";
+  for (const std::string &Arg : Args)
     DILogger << "  " << Arg << "\n";
-  }
   DILogger << DoLog;
+}
+
+int ProgramRunner::run(llvm::StringRef ProgramName,
+                       ArrayRef<std::string> Args) {
+  std::string ProgramPath = findProgram(ProgramName);
+
+  // Prepare actual arguments
+  std::vector<StringRef> StringRefs{ ProgramPath };
+  for (const std::string &Arg : Args)
+    StringRefs.push_back(Arg);
+  logInvocation(ProgramPath, Args);
 
   int ExitCode = llvm::sys::ExecuteAndWait(StringRefs[0], StringRefs);
 
   return ExitCode;
 }
+
+static void closeDescriptor(int &FD) {
+  if (FD != -1) {
+    ::close(FD);
+    FD = -1;
+  }
+}
+
+ProgramRunner::Process ProgramRunner::start(llvm::StringRef ProgramName,
+                                            ArrayRef<std::string> Args) {
+  std::string ProgramPath = findProgram(ProgramName);
+  logInvocation(ProgramPath, Args);
+
+  Process Result;
+  auto Fail = [&Result](llvm::StringRef What, int Error) {
+    Result.TheResult.StdErr = (What + ": " + strerror(Error)).str();
+    return std::move(Result);
+  };
+
+  // The pipes are closed on exec: the child only keeps the duplicates of its
+  // ends, and does not inherit the pipes of the other running programs
+  int OutPipe[2];
+  int ErrPipe[2];
+  if (pipe2(OutPipe, O_CLOEXEC) != 0)
+    return Fail("pipe2", errno);
+  if (pipe2(ErrPipe, O_CLOEXEC) != 0) {
+    int Error = errno;
+    ::close(OutPipe[0]);
+    ::close(OutPipe[1]);
+    return Fail("pipe2", Error);
+  }
+
+  std::vector<char *> Arguments{ ProgramPath.data() };
+  for (const std::string &Arg : Args)
+    Arguments.push_back(const_cast<char *>(Arg.c_str()));
+  Arguments.push_back(nullptr);
+
+  posix_spawn_file_actions_t Actions;
+  posix_spawn_file_actions_init(&Actions);
+  posix_spawn_file_actions_adddup2(&Actions, OutPipe[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&Actions, ErrPipe[1], STDERR_FILENO);
+
+  pid_t PID = -1;
+  int Error = posix_spawn(&PID,
+                          ProgramPath.c_str(),
+                          &Actions,
+                          nullptr,
+                          Arguments.data(),
+                          environ);
+  posix_spawn_file_actions_destroy(&Actions);
+  ::close(OutPipe[1]);
+  ::close(ErrPipe[1]);
+
+  if (Error != 0) {
+    ::close(OutPipe[0]);
+    ::close(ErrPipe[0]);
+    return Fail("posix_spawn", Error);
+  }
+
+  Result.PID = PID;
+  Result.StdOut = OutPipe[0];
+  Result.StdErr = ErrPipe[0];
+  return Result;
+}
+
+void ProgramRunner::Process::readOutput(llvm::ArrayRef<Process *> Processes) {
+  llvm::SmallVector<pollfd, 16> Descriptors;
+  llvm::SmallVector<std::pair<int *, std::string *>, 16> Targets;
+  auto Watch = [&Descriptors, &Targets](int &FD, std::string &Output) {
+    if (FD != -1) {
+      Descriptors.push_back({ FD, POLLIN, 0 });
+      Targets.emplace_back(&FD, &Output);
+    }
+  };
+  for (Process *P : Processes) {
+    Watch(P->StdOut, P->TheResult.StdOut);
+    Watch(P->StdErr, P->TheResult.StdErr);
+  }
+
+  if (Descriptors.empty())
+    return;
+
+  if (poll(Descriptors.data(), Descriptors.size(), -1) < 0) {
+    revng_assert(errno == EINTR);
+    return;
+  }
+
+  char Buffer[16 * 1024];
+  for (auto [Descriptor, Target] : llvm::zip(Descriptors, Targets)) {
+    if (Descriptor.revents == 0)
+      continue;
+
+    auto [FD, Output] = Target;
+    ssize_t Size = ::read(*FD, Buffer, sizeof(Buffer));
+    if (Size > 0)
+      Output->append(Buffer, Size);
+    else if (Size == 0 or errno != EINTR)
+      closeDescriptor(*FD);
+  }
+}
+
+void ProgramRunner::Process::reap() {
+  revng_assert(running() and outputClosed());
+
+  int Status = 0;
+  pid_t Waited = -1;
+  do {
+    Waited = waitpid(PID, &Status, 0);
+  } while (Waited == -1 and errno == EINTR);
+  revng_assert(Waited == PID);
+  PID = -1;
+
+  if (WIFEXITED(Status))
+    TheResult.ExitCode = WEXITSTATUS(Status);
+  else
+    TheResult.ExitCode = -2;
+}
+
+ProgramRunner::Result ProgramRunner::Process::wait() {
+  if (running()) {
+    // Output has to be read as it's produced, or the program might block on a
+    // full pipe
+    while (not outputClosed())
+      readOutput({ this });
+    reap();
+  }
+
+  return std::move(TheResult);
+}
+
+ProgramRunner::Process &ProgramRunner::Process::operator=(Process &&Other) {
+  if (this != &Other) {
+    if (running())
+      wait();
+    PID = std::exchange(Other.PID, -1);
+    StdOut = std::exchange(Other.StdOut, -1);
+    StdErr = std::exchange(Other.StdErr, -1);
+    TheResult = std::move(Other.TheResult);
+  }
+  return *this;
+}
+
+ProgramRunner::Process::~Process() {
+  if (running())
+    wait();
+}
+
+ProgramQueue::ProgramQueue(unsigned MaxJobs, ProgramRunner &TheRunner) :
+  TheRunner(TheRunner), MaxJobs(MaxJobs) {
+  revng_assert(MaxJobs > 0);
+}
+
+size_t ProgramQueue::enqueue(llvm::StringRef ProgramName,
+                             llvm::ArrayRef<std::string> Args) {
+  size_t Index = Results.size();
+  Results.emplace_back();
+  Pending.push_back({ Index, ProgramName.str(), Args.vec() });
+  startPending();
+  return Index;
+}
+
+void ProgramQueue::startPending() {
+  while (Running.size() < MaxJobs and not Pending.empty()) {
+    Job &Next = Pending.front();
+    auto Started = TheRunner.start(Next.ProgramName, Next.Args);
+    if (Started.running())
+      Running.emplace_back(Next.Index, std::move(Started));
+    else
+      Results[Next.Index] = Started.wait();
+    Pending.pop_front();
+  }
+}
+
+std::vector<ProgramRunner::Result> ProgramQueue::waitAll() {
+  startPending();
+  while (not Running.empty()) {
+    llvm::SmallVector<ProgramRunner::Process *, 16> Processes;
+    for (auto &[Index, Process] : Running)
+      Processes.push_back(&Process);
+    ProgramRunner::Process::readOutput(Processes);
+
+    // A program that closed its output is about to exit. Reaping it might
+    // block briefly, but the others cannot stall for long on a full pipe.
+    auto IsDone = [this](auto &Entry) {
+      auto &[Index, Process] = Entry;
+      if (not Process.outputClosed())
+        return false;
+      Results[Index] = Process.wait();
+      return true;
+    };
+    llvm::erase_if(Running, IsDone);
+
+    startPending();
+  }
+
+  return std::exchange(Results, {});
+}
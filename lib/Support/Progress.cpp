@@ -8,29 +8,128 @@
 #if defined(__linux__)
 extern "C" {
 #include "sys/ioctl.h"
+#include "sys/resource.h"
 }
 #endif
 
+#include <atomic>
 #include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
 
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/CommandLine.h"
-#include "llvm/Support/Mutex.h"
 #include "llvm/Support/Progress.h"
 #include "llvm/Support/Signals.h"
+#include "llvm/Support/Threading.h"
 
 #include "revng/Support/Assert.h"
 #include "revng/Support/Debug.h"
+#include "revng/Support/Progress.h"
+
+static std::atomic<bool> TracingTasks = false;
+
+using TraceArguments = llvm::SmallVector<std::pair<std::string, uint64_t>, 4>;
+
+/// Arguments to attach to the next span closed by this thread
+static thread_local TraceArguments PendingArguments;
+
+bool revng::isTracingTasks() {
+  return TracingTasks;
+}
+
+void revng::addTraceArgument(llvm::StringRef Name, uint64_t Value) {
+  if (TracingTasks)
+    PendingArguments.emplace_back(Name.str(), Value);
+}
+
+uint64_t revng::getPeakRSSKB() {
+#if defined(__linux__)
+  struct rusage Usage;
+  if (getrusage(RUSAGE_SELF, &Usage) == 0)
+    return Usage.ru_maxrss;
+#endif
+  return 0;
+}
+
+/// The innermost ProgressCallbackScope of this thread
+static thread_local revng::ProgressCallbackScope *CurrentCallbackScope = nullptr;
+
+void revng::ProgressCallbackScope::notify(const llvm::TaskStack &Stack) {
+  if (CurrentCallbackScope != nullptr)
+    CurrentCallbackScope->TheCallback(Stack);
+}
+
+/// Forwards the events of every thread to its ProgressCallbackScope
+class CallbackProgressListener : public llvm::ProgressListener {
+public:
+  static constexpr bool AllThreads = true;
+
+public:
+  void handleNewTask(const llvm::Task *T) override {
+    revng::ProgressCallbackScope::notify(T->stack());
+  }
+
+  void handleTaskCompleted(const llvm::Task *T) override {
+    revng::ProgressCallbackScope::notify(T->stack());
+  }
+
+  void handleTaskAdvancement(const llvm::Task *T,
+                             llvm::StringRef PreviousStepName) override {
+    revng::ProgressCallbackScope::notify(T->stack());
+  }
+};
+
+revng::ProgressCallbackScope::ProgressCallbackScope(Callback TheCallback) :
+  TheCallback(std::move(TheCallback)), Previous(CurrentCallbackScope) {
+  // Register the listener the first time it's needed, so that nobody pays for
+  // it otherwise
+  static bool Registered = [] {
+    llvm::ProgressReport->registerListener<CallbackProgressListener>();
+    return true;
+  }();
+  (void) Registered;
+
+  CurrentCallbackScope = this;
+}
+
+revng::ProgressCallbackScope::~ProgressCallbackScope() {
+  revng_assert(CurrentCallbackScope == this);
+  CurrentCallbackScope = Previous;
+}
 
 static void destroyTraceProgressListener(void *OpaqueListener);
 
+/// Writes the tasks of all the threads as a Chrome trace.
+///
+/// Each thread records its events in a buffer of its own, which is written out
+/// once it grows past FlushThreshold, so that threads only contend on the
+/// output every now and then. The events are tagged with the ID of the thread
+/// that emitted them, so that the trace shows what ran concurrently.
 class TraceProgressListener : public llvm::ProgressListener {
+private:
+  /// The events recorded by a thread, not written yet
+  struct ThreadBuffer {
+    std::mutex Mutex;
+    std::string Events;
+  };
+
+  static constexpr size_t FlushThreshold = 64 * 1024;
+
 private:
   std::error_code EC;
 
-  // TODO: consider buffering in thread-local buffers
-  llvm::sys::Mutex OutputMutex;
+  /// Lock after the mutex of a ThreadBuffer, never before
+  std::mutex OutputMutex;
   llvm::raw_fd_ostream Output;
-  bool Closed = false;
+  std::atomic<bool> Closed = false;
+
+  std::mutex BuffersMutex;
+  /// The buffers of all the threads that ever emitted an event. A deque, so
+  /// that they never move.
+  std::deque<ThreadBuffer> Buffers;
 
 public:
   static constexpr bool AllThreads = true;
@@ -42,44 +141,113 @@ public:
     llvm::sys::AddSignalHandler(destroyTraceProgressListener, this);
   }
 
-  ~TraceProgressListener() override { close("Graceful exit"); }
+  ~TraceProgressListener() override { close("Graceful exit", false); }
 
 public:
-  void close(llvm::StringRef ExitReason) {
-    if (not Closed) {
-      Closed = true;
-      emitEvent<false>(ExitReason, "task", "i");
-      Output << "]\n";
-      Output.flush();
+  /// Write all the pending events and terminate the trace.
+  ///
+  /// A signal might interrupt a thread while it holds one of the locks: when
+  /// \p FromSignal, locks are only tried, and what cannot be locked is
+  /// dropped, rather than deadlocking.
+  void close(llvm::StringRef ExitReason, bool FromSignal) {
+    if (Closed.exchange(true))
+      return;
+
+    auto Lock = [FromSignal](std::mutex &Mutex) {
+      if (FromSignal)
+        return std::unique_lock(Mutex, std::try_to_lock);
+      return std::unique_lock(Mutex);
+    };
+
+    if (auto BuffersLock = Lock(BuffersMutex)) {
+      for (ThreadBuffer &Buffer : Buffers) {
+        auto BufferLock = Lock(Buffer.Mutex);
+        if (not BufferLock)
+          continue;
+
+        auto OutputLock = Lock(OutputMutex);
+        if (not OutputLock)
+          return;
+
+        Output << Buffer.Events;
+        Buffer.Events.clear();
+      }
     }
+
+    auto OutputLock = Lock(OutputMutex);
+    if (not OutputLock)
+      return;
+
+    std::string Event;
+    llvm::raw_string_ostream Stream(Event);
+    writeEvent<false>(Stream, ExitReason, "task", "i");
+    Output << Event << "]\n";
+    Output.flush();
   }
 
 public:
   void handleNewTask(const llvm::Task *T) override {
-    llvm::sys::ScopedLock Lock(OutputMutex);
     emitEvent(T->name(), "task", "B");
   }
 
   void handleTaskCompleted(const llvm::Task *T) override {
-    llvm::sys::ScopedLock Lock(OutputMutex);
     if (T->stepIndex() != -1) {
-      emitEvent(T->stepName(), "task", "E");
+      emitEvent(T->stepName(), "task", "E", PendingArguments);
+      PendingArguments.clear();
     }
-    emitEvent(T->name(), "task", "E");
+    emitEvent(T->name(), "task", "E", PendingArguments);
+    PendingArguments.clear();
   }
 
   void handleTaskAdvancement(const llvm::Task *T,
                              llvm::StringRef PreviousStepName) override {
-    llvm::sys::ScopedLock Lock(OutputMutex);
-    if (T->stepIndex() != 0)
-      emitEvent(PreviousStepName, "task", "E");
+    if (T->stepIndex() != 0) {
+      emitEvent(PreviousStepName, "task", "E", PendingArguments);
+      PendingArguments.clear();
+    }
     emitEvent(T->stepName(), "task", "B");
   }
 
-  template<bool EmitTrailingComma = true>
+private:
+  ThreadBuffer &localBuffer() {
+    thread_local TraceProgressListener *Owner = nullptr;
+    thread_local ThreadBuffer *Local = nullptr;
+    if (Owner != this) {
+      std::lock_guard Lock(BuffersMutex);
+      Owner = this;
+      Local = &Buffers.emplace_back();
+    }
+    return *Local;
+  }
+
   void emitEvent(llvm::StringRef Name,
                  llvm::StringRef Category,
-                 llvm::StringRef Phase) {
+                 llvm::StringRef Phase,
+                 const TraceArguments &Arguments = {}) {
+    if (Closed)
+      return;
+
+    ThreadBuffer &Buffer = localBuffer();
+    std::lock_guard Lock(Buffer.Mutex);
+    llvm::raw_string_ostream Stream(Buffer.Events);
+    writeEvent(Stream, Name, Category, Phase, Arguments);
+    Stream.flush();
+
+    if (Buffer.Events.size() >= FlushThreshold) {
+      std::lock_guard OutputLock(OutputMutex);
+      // The trace might have been closed in the meantime
+      if (not Closed)
+        Output << Buffer.Events;
+      Buffer.Events.clear();
+    }
+  }
+
+  template<bool EmitTrailingComma = true>
+  static void writeEvent(llvm::raw_ostream &Output,
+                         llvm::StringRef Name,
+                         llvm::StringRef Category,
+                         llvm::StringRef Phase,
+                         const TraceArguments &Arguments = {}) {
     Output << "{";
     Output << "\"name\": \"" << Name.str() << "\", ";
     Output << "\"cat\": \"" << Category.str() << "\", ";
@@ -90,7 +258,18 @@ public:
     unsigned long long Timestamp = duration_cast<microseconds>(Epoch).count();
     Output << "\"ts\": " << Timestamp << ", ";
     Output << "\"pid\": " << getpid() << ", ";
-    Output << "\"tid\": " << getpid();
+    Output << "\"tid\": " << llvm::get_threadid();
+    if (not Arguments.empty()) {
+      Output << ", \"args\": {";
+      bool First = true;
+      for (const auto &[ArgumentName, Value] : Arguments) {
+        if (not First)
+          Output << ", ";
+        First = false;
+        Output << "\"" << ArgumentName << "\": " << Value;
+      }
+      Output << "}";
+    }
     Output << "}";
     if (EmitTrailingComma)
       Output << ",";
@@ -341,7 +520,7 @@ public:
 
 static void destroyTraceProgressListener(void *OpaqueListener) {
   auto *Listener = static_cast<TraceProgressListener *>(OpaqueListener);
-  Listener->close("Exit due to signal");
+  Listener->close("Exit due to signal", true);
 }
 
 using namespace llvm::cl;
@@ -349,6 +528,7 @@ using namespace llvm::cl;
 static auto RegisterTraceProgressListener = [](const std::string &Value) {
   if (Value.size() > 0) {
     llvm::ProgressReport->registerListener<TraceProgressListener>(Value);
+    TracingTasks = true;
   }
 };
 
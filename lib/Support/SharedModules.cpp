@@ -0,0 +1,95 @@
+/// \file SharedModules.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <mutex>
+
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Debug.h"
+#include "revng/Support/SharedModules.h"
+
+using namespace llvm;
+
+static Logger<> Log("shared-modules");
+
+namespace {
+
+struct SharedModule {
+  uint64_t Size = 0;
+  sys::TimePoint<> LastModification;
+
+  /// Shared, so that clearing the cache does not affect parsing in progress
+  std::shared_ptr<const std::string> Bitcode;
+};
+
+} // namespace
+
+static std::mutex SharedModulesLock;
+static StringMap<SharedModule> SharedModules;
+
+using SharedBitcode = std::shared_ptr<const std::string>;
+
+/// \return the bitcode of the module at \p Path, parsing it if it has not been
+///         parsed yet or if it has changed since then
+static SharedBitcode getBitcode(StringRef Path, SMDiagnostic &Error) {
+  sys::fs::file_status Status;
+  if (std::error_code EC = sys::fs::status(Path, Status)) {
+    Error = SMDiagnostic(Path, SourceMgr::DK_Error, EC.message());
+    return nullptr;
+  }
+
+  // Parsing happens under the lock: concurrent requests of the same module
+  // have to wait for it anyway
+  std::lock_guard Guard(SharedModulesLock);
+  SharedModule &Entry = SharedModules[Path];
+  if (Entry.Bitcode != nullptr and Entry.Size == Status.getSize()
+      and Entry.LastModification == Status.getLastModificationTime()) {
+    revng_log(Log, "Reusing " << Path);
+    return Entry.Bitcode;
+  }
+
+  revng_log(Log, "Parsing " << Path);
+  LLVMContext PrivateContext;
+  std::unique_ptr<Module> Parsed = parseIRFile(Path, Error, PrivateContext);
+  if (Parsed == nullptr) {
+    SharedModules.erase(Path);
+    return nullptr;
+  }
+
+  std::string Bitcode;
+  raw_string_ostream Stream(Bitcode);
+  WriteBitcodeToFile(*Parsed, Stream);
+  Stream.flush();
+
+  Entry.Size = Status.getSize();
+  Entry.LastModification = Status.getLastModificationTime();
+  Entry.Bitcode = std::make_shared<const std::string>(std::move(Bitcode));
+  return Entry.Bitcode;
+}
+
+std::unique_ptr<Module> revng::parseSharedIRFile(StringRef Path,
+                                                 SMDiagnostic &Error,
+                                                 LLVMContext &Context) {
+  SharedBitcode Bitcode = getBitcode(Path, Error);
+  if (Bitcode == nullptr)
+    return nullptr;
+
+  MemoryBufferRef Buffer(*Bitcode, Path);
+  return parseIR(Buffer, Error, Context);
+}
+
+void revng::clearSharedIRFiles() {
+  std::lock_guard Guard(SharedModulesLock);
+  SharedModules.clear();
+}
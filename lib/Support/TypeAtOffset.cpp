@@ -0,0 +1,109 @@
+/// \file TypeAtOffset.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Type.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/TypeAtOffset.h"
+
+using namespace llvm;
+
+std::pair<IntegerType *, unsigned>
+getTypeAtOffset(const DataLayout *TheLayout, Type *VarType, intptr_t Offset) {
+  static Logger<> Log("type-at-offset");
+
+  unsigned Depth = 0;
+  while (1) {
+    switch (VarType->getTypeID()) {
+    case llvm::Type::TypeID::PointerTyID:
+      // BEWARE: here we return { nullptr, 0 } as an intended workaround for
+      // a specific situation.
+      //
+      // We can't use assertions on pointers, as we do for all the other
+      // unhandled types, because they will be inevitably triggered during the
+      // execution. Indeed, all the other types are not present in QEMU
+      // CPUState and we can safely assert it. This is not true for pointers
+      // that are used in different places in QEMU CPUState.
+      //
+      // Given that we have ruled out assertions, we need to handle the
+      // pointer case so that it keeps working. This function is expected to
+      // return { nullptr, 0 } when the offset points to a memory location
+      // associated to padding space. In principle, pointers are not padding
+      // space, but the result of returning { nullptr, 0 } here is that load
+      // and store operations treat pointers like padding. This means that
+      // pointers cannot be read or written, and memcpy simply skips over them
+      // leaving them alone.
+      //
+      // This behavior is intended, because a pointer into the CPUState could
+      // be used to modify CPU registers indirectly, which is against all the
+      // assumption of the analysis necessary for the translation, and also
+      // against what really happens in a CPU, where CPU state cannot be
+      // addressed.
+      return { nullptr, 0 };
+
+    case llvm::Type::TypeID::IntegerTyID:
+      return { cast<IntegerType>(VarType), Offset };
+
+    case llvm::Type::TypeID::ArrayTyID:
+      VarType = VarType->getArrayElementType();
+      Offset %= TheLayout->getTypeAllocSize(VarType);
+      revng_log(Log,
+                std::string(Depth++ * 2, ' ')
+                  << " Is an Array. Offset in Element: " << Offset);
+      break;
+
+    case llvm::Type::TypeID::StructTyID: {
+      StructType *TheStruct = cast<StructType>(VarType);
+      const StructLayout *Layout = TheLayout->getStructLayout(TheStruct);
+      unsigned FieldIndex = Layout->getElementContainingOffset(Offset);
+      uint64_t FieldOffset = Layout->getElementOffset(FieldIndex);
+      VarType = TheStruct->getTypeAtIndex(FieldIndex);
+      intptr_t FieldEnd = FieldOffset + TheLayout->getTypeAllocSize(VarType);
+
+      revng_log(Log,
+                std::string(Depth++ * 2, ' ')
+                  << " Offset: " << Offset
+                  << " Struct Name: " << TheStruct->getName().str()
+                  << " Field Index: " << FieldIndex << " Field offset: "
+                  << FieldOffset << " Field end: " << FieldEnd);
+
+      if (Offset >= FieldEnd)
+        return { nullptr, 0 }; // It's padding
+
+      Offset -= FieldOffset;
+    } break;
+
+    default:
+      revng_abort("unexpected TypeID");
+    }
+  }
+}
+
+TypeAtOffsetCache::TypeAtOffsetCache(const DataLayout *Layout, Type *Root) :
+  Layout(Layout), Root(Root), Entries(Layout->getTypeAllocSize(Root)) {
+}
+
+void TypeAtOffsetCache::setDataLayout(const DataLayout *NewLayout) {
+  Layout = NewLayout;
+  for (Entry &E : Entries)
+    E.Computed = false;
+}
+
+std::pair<IntegerType *, unsigned> TypeAtOffsetCache::get(intptr_t Offset) {
+  if (not contains(Offset))
+    return getTypeAtOffset(Layout, Root, Offset);
+
+  Entry &E = Entries[Offset];
+  if (not E.Computed) {
+    std::tie(E.Type, E.Remaining) = getTypeAtOffset(Layout, Root, Offset);
+    E.Computed = true;
+  }
+
+  return { E.Type, E.Remaining };
+}
@@ -0,0 +1,129 @@
+/// \file YAMLSplitting.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/STLExtras.h"
+
+#include "revng/Support/YAMLSplitting.h"
+
+using namespace llvm;
+
+static size_t indentation(StringRef Line) {
+  size_t Result = Line.find_first_not_of(' ');
+  return Result == StringRef::npos ? Line.size() : Result;
+}
+
+/// \return true if \p Line does not affect the structure of the document
+static bool isBlankOrComment(StringRef Line) {
+  StringRef Trimmed = Line.ltrim(' ').rtrim();
+  return Trimmed.empty() or Trimmed.starts_with("#");
+}
+
+/// \return true if \p Line starts an item of a block sequence indented by
+///         \p Indentation
+static bool isItem(StringRef Line, size_t Indentation) {
+  if (indentation(Line) != Indentation)
+    return false;
+
+  StringRef Rest = Line.drop_front(Indentation);
+  return Rest.starts_with("-")
+         and (Rest.size() == 1 or Rest[1] == ' ' or Rest[1] == '\n'
+              or Rest[1] == '\r');
+}
+
+/// \return the key if \p Line is a top-level key with no value on the same
+///         line, an empty string otherwise
+static StringRef getTopLevelKey(StringRef Line) {
+  if (Line.empty() or Line[0] == ' ' or Line[0] == '-' or Line[0] == '#')
+    return {};
+
+  StringRef Trimmed = Line.rtrim();
+  if (not Trimmed.consume_back(":") or Trimmed.contains(':'))
+    return {};
+
+  return Trimmed;
+}
+
+std::optional<revng::SplitYAMLDocument>
+revng::splitTopLevelSequences(StringRef YAML,
+                              ArrayRef<StringRef> Keys,
+                              size_t ChunkSize) {
+  SplitYAMLDocument Result;
+  Result.Rest.reserve(YAML.size() / 4);
+
+  // Split the document in lines, including their terminator
+  std::vector<StringRef> Lines;
+  for (StringRef Remaining = YAML; not Remaining.empty();) {
+    size_t End = Remaining.find('\n');
+    End = End == StringRef::npos ? Remaining.size() : End + 1;
+    Lines.push_back(Remaining.take_front(End));
+    Remaining = Remaining.drop_front(End);
+  }
+
+  auto Offset = [&YAML](StringRef Line) -> size_t {
+    return Line.data() - YAML.data();
+  };
+
+  size_t I = 0;
+  while (I < Lines.size()) {
+    StringRef Line = Lines[I];
+    StringRef Key = getTopLevelKey(Line);
+    if (Key.empty() or not llvm::is_contained(Keys, Key)) {
+      Result.Rest += Line;
+      ++I;
+      continue;
+    }
+
+    // Find the first item, if the value is a block sequence at all
+    size_t First = I + 1;
+    while (First < Lines.size() and isBlankOrComment(Lines[First]))
+      ++First;
+    if (First == Lines.size()
+        or not isItem(Lines[First], indentation(Lines[First]))) {
+      Result.Rest += Line;
+      ++I;
+      continue;
+    }
+
+    // A key appearing twice would be rejected by the parser, let it do that
+    auto SameKey = [Key](const SplitYAMLDocument::Sequence &Sequence) {
+      return Sequence.Key == Key;
+    };
+    if (llvm::any_of(Result.Sequences, SameKey))
+      return std::nullopt;
+
+    // Collect the items, cutting a chunk each time one grows too large.
+    // Blank lines and comments belong to the item they are in.
+    size_t ItemIndentation = indentation(Lines[First]);
+    SplitYAMLDocument::Sequence &Sequence = Result.Sequences.emplace_back();
+    Sequence.Key = Key;
+    size_t ChunkStart = Offset(Lines[First]);
+    size_t End = First + 1;
+    for (; End < Lines.size(); ++End) {
+      StringRef Current = Lines[End];
+      if (isBlankOrComment(Current)
+          or indentation(Current) > ItemIndentation)
+        continue;
+
+      if (not isItem(Current, ItemIndentation))
+        break;
+
+      if (Offset(Current) - ChunkStart >= ChunkSize) {
+        Sequence.Chunks.push_back(YAML.slice(ChunkStart, Offset(Current)));
+        ChunkStart = Offset(Current);
+      }
+    }
+
+    size_t SequenceEnd = End == Lines.size() ? YAML.size() :
+                                               Offset(Lines[End]);
+    Sequence.Chunks.push_back(YAML.slice(ChunkStart, SequenceEnd));
+    I = End;
+  }
+
+  if (Result.Sequences.empty())
+    return std::nullopt;
+
+  return Result;
+}
@@ -0,0 +1,147 @@
+/// \file ZstdStream.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <thread>
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/ScopeExit.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/ZstdStream.h"
+
+#include "zstd.h"
+
+using namespace llvm::cl;
+
+static opt<unsigned> ZstdThreads("zstd-threads",
+                                 desc("Number of threads compressing large "
+                                      "buffers in zstd (0 means the number of "
+                                      "hardware threads)"),
+                                 cat(MainCategory),
+                                 init(0));
+
+/// Below this size, spawning the compression workers is not worth it
+constexpr size_t MultithreadingThreshold = 1024 * 1024;
+
+static void check(size_t RC) {
+  revng_assert(not ZSTD_isError(RC), ZSTD_getErrorName(RC));
+}
+
+/// \param Serially whether to compress on the calling thread regardless of
+///        the size of \p InputBuffer
+static void compress(llvm::raw_ostream &OutputOS,
+                     llvm::ArrayRef<uint8_t> InputBuffer,
+                     int CompressionLevel,
+                     bool Serially) {
+  revng_assert(CompressionLevel >= 1
+               and CompressionLevel <= ZSTD_maxCLevel());
+  ZSTD_CCtx *Context = ZSTD_createCCtx();
+  revng_assert(Context != nullptr);
+
+  check(ZSTD_CCtx_setParameter(Context,
+                               ZSTD_c_compressionLevel,
+                               CompressionLevel));
+  check(ZSTD_CCtx_setPledgedSrcSize(Context, InputBuffer.size()));
+
+  if (not Serially and InputBuffer.size() >= MultithreadingThreshold) {
+    unsigned Threads = ZstdThreads;
+    if (Threads == 0)
+      Threads = std::thread::hardware_concurrency();
+
+    // Fails if libzstd has been built without multithreading support, in which
+    // case we just compress on this thread
+    ZSTD_CCtx_setParameter(Context, ZSTD_c_nbWorkers, Threads);
+  }
+
+  llvm::SmallVector<char> OutBuffer;
+  OutBuffer.resize_for_overwrite(ZSTD_CStreamOutSize());
+
+  ZSTD_inBuffer Input = { InputBuffer.data(), InputBuffer.size(), 0 };
+  while (true) {
+    ZSTD_outBuffer Output = { OutBuffer.data(), OutBuffer.size(), 0 };
+    size_t Remaining = ZSTD_compressStream2(Context,
+                                            &Output,
+                                            &Input,
+                                            ZSTD_e_end);
+    check(Remaining);
+    OutputOS.write(OutBuffer.data(), Output.pos);
+
+    if (Remaining == 0)
+      break;
+  }
+
+  ZSTD_freeCCtx(Context);
+  OutputOS.flush();
+}
+
+void zstdCompress(llvm::raw_ostream &OutputOS,
+                  llvm::ArrayRef<uint8_t> InputBuffer,
+                  int CompressionLevel) {
+  compress(OutputOS, InputBuffer, CompressionLevel, false);
+}
+
+void zstdCompressSerially(llvm::raw_ostream &OutputOS,
+                          llvm::ArrayRef<uint8_t> InputBuffer,
+                          int CompressionLevel) {
+  compress(OutputOS, InputBuffer, CompressionLevel, true);
+}
+
+static llvm::Error malformed(size_t RC) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "Cannot decompress zstd data: %s",
+                                 ZSTD_getErrorName(RC));
+}
+
+llvm::Error zstdDecompress(llvm::raw_ostream &OutputOS,
+                           llvm::ArrayRef<uint8_t> InputBuffer) {
+  ZSTD_DCtx *Context = ZSTD_createDCtx();
+  revng_assert(Context != nullptr);
+  auto FreeContext = llvm::make_scope_exit([Context] {
+    ZSTD_freeDCtx(Context);
+  });
+
+  llvm::SmallVector<char> OutBuffer;
+  OutBuffer.resize_for_overwrite(ZSTD_DStreamOutSize());
+
+  ZSTD_inBuffer Input = { InputBuffer.data(), InputBuffer.size(), 0 };
+  size_t LastRC = 0;
+  while (Input.pos < Input.size) {
+    ZSTD_outBuffer Output = { OutBuffer.data(), OutBuffer.size(), 0 };
+    LastRC = ZSTD_decompressStream(Context, &Output, &Input);
+    if (ZSTD_isError(LastRC))
+      return malformed(LastRC);
+    OutputOS.write(OutBuffer.data(), Output.pos);
+  }
+
+  // Flush what is still buffered in the context
+  while (LastRC != 0) {
+    ZSTD_outBuffer Output = { OutBuffer.data(), OutBuffer.size(), 0 };
+    LastRC = ZSTD_decompressStream(Context, &Output, &Input);
+    if (ZSTD_isError(LastRC))
+      return malformed(LastRC);
+
+    if (Output.pos == 0) {
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "Truncated zstd frame");
+    }
+    OutputOS.write(OutBuffer.data(), Output.pos);
+  }
+
+  OutputOS.flush();
+  return llvm::Error::success();
+}
+
+bool isZstd(llvm::ArrayRef<char> Buffer) {
+  // Frames start with 0xFD2FB528, in little endian
+  static constexpr char Magic[] = { '\x28', '\xB5', '\x2F', '\xFD' };
+  return Buffer.size() >= sizeof(Magic)
+         and std::equal(std::begin(Magic), std::end(Magic), Buffer.begin());
+}
@@ -11,10 +11,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <deque>
 #include <limits>
+#include <numeric>
 
 #include "llvm/ADT/APInt.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/IR/AssemblyAnnotationWriter.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/Instruction.h"
@@ -266,32 +269,76 @@ uint32_t BitLivenessAnalysis::applyTransferFunction(DataFlowNode *L,
   }
 }
 
+/// A solver specialized for BitLivenessAnalysis, equivalent to
+/// `MFP::getMaximalFixedPoint`.
+///
+/// Since the lattice elements are integers and combining them is just `max`,
+/// the nodes are numbered once and the values are kept in plain vectors. A
+/// FIFO worklist is enough: the result is the same fixed point, and the lack
+/// of priorities is offset by not having to maintain a heap.
+static std::vector<MFP::MFPResult<uint32_t>>
+solve(const BitLivenessAnalysis &Analysis,
+      DataFlowGraph &Graph,
+      const llvm::DenseMap<DataFlowNode *, unsigned> &Indices) {
+  size_t Size = Graph.size();
+  std::vector<MFP::MFPResult<uint32_t>> Results(Size, { 0, 0 });
+  std::vector<DataFlowNode *> Nodes(Size, nullptr);
+  for (auto [Node, Index] : Indices) {
+    Nodes[Index] = Node;
+    if (isDataFlowSink(Node->Instruction))
+      Results[Index].InValue = Top;
+  }
+
+  // All the nodes need their out value to be computed at least once
+  llvm::BitVector InWorklist(Size, true);
+  std::deque<unsigned> Worklist(Size);
+  std::iota(Worklist.begin(), Worklist.end(), 0);
+
+  while (not Worklist.empty()) {
+    unsigned Index = Worklist.front();
+    Worklist.pop_front();
+    InWorklist.reset(Index);
+
+    DataFlowNode *Node = Nodes[Index];
+    auto &Result = Results[Index];
+    Result.OutValue = Analysis.applyTransferFunction(Node, Result.InValue);
+
+    for (DataFlowNode *Successor : Node->successors()) {
+      unsigned SuccessorIndex = Indices.lookup(Successor);
+      uint32_t &InValue = Results[SuccessorIndex].InValue;
+      if (Result.OutValue <= InValue)
+        continue;
+
+      InValue = Result.OutValue;
+      if (not InWorklist.test(SuccessorIndex)) {
+        InWorklist.set(SuccessorIndex);
+        Worklist.push_back(SuccessorIndex);
+      }
+    }
+  }
+
+  return Results;
+}
+
 BitLivenessPass::Result BitLivenessPass::run(llvm::Function &F,
                                              llvm::FunctionAnalysisManager &) {
   GenericGraph<DataFlowNode> DataFlowGraph = buildDataFlowGraph(F);
+  revng_assert(not DataFlowGraph.verify());
 
-  std::vector<DataFlowNode *> ExtremalLabels;
-  for (DataFlowNode *Node : DataFlowGraph.nodes()) {
-    if (isDataFlowSink(Node->Instruction)) {
-      ExtremalLabels.push_back(Node);
-    }
-  }
+  llvm::DenseMap<DataFlowNode *, unsigned> Indices;
+  Indices.reserve(DataFlowGraph.size());
+  for (DataFlowNode *Node : DataFlowGraph.nodes())
+    Indices.try_emplace(Node, Indices.size());
+
+  auto Results = solve(BitLivenessAnalysis{}, DataFlowGraph, Indices);
 
-  auto MFPRes = MFP::getMaximalFixedPoint<BitLivenessAnalysis>({},
-                                                               &DataFlowGraph,
-                                                               0,
-                                                               Top,
-                                                               ExtremalLabels);
   BitLivenessPass::Result Result;
-  for (auto &[Label, MFPResult] : MFPRes) {
-    auto &Entry = Result[Label->Instruction];
-    Entry.Result = MFPResult.InValue;
-    Entry.Operands = MFPResult.OutValue;
+  for (auto [Node, Index] : Indices) {
+    auto &Entry = Result[Node->Instruction];
+    Entry.Result = Results[Index].InValue;
+    Entry.Operands = Results[Index].OutValue;
   }
 
-  revng_assert(not DataFlowGraph.verify());
-  MFP::Graph<BitLivenessAnalysis> MFPGraph(&DataFlowGraph, MFPRes);
-
   return Result;
 }
 
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/SmallSet.h"
 #include "llvm/Analysis/LazyValueInfo.h"
 #include "llvm/IR/Dominators.h"
 #include "llvm/Support/GraphWriter.h"
@@ -18,7 +19,7 @@
 
 using namespace llvm;
 
-static Logger<> AVILogger("avi");
+static DebugLogger AVILogger("avi");
 
 inline RunningStatistics AVICFEGSizeStatitistics("avi-cfeg-size");
 
@@ -28,8 +29,7 @@ AdvancedValueInfoMFI::combineValues(const LatticeElement &LHS,
   LatticeElement Result = LHS;
 
   for (auto &[Key, Value] : RHS) {
-    auto &ResultEntry = Result[Key];
-    ResultEntry = ResultEntry.unionWith(Value);
+    Result[Key] |= Value;
   }
 
   return Result;
@@ -140,7 +140,7 @@ AdvancedValueInfoMFI::applyTransferFunction(Label L,
 
     auto It = Result.find(I);
     if (It != Result.end())
-      It->second = It->second.intersectWith(Range);
+      It->second &= Range;
     else
       Result[I] = Range;
   }
@@ -114,6 +114,7 @@ void DataFlowGraph::purgeUnreachable() {
   using namespace llvm;
 
   DenseSet<Node *> Reachable;
+  Reachable.reserve(size());
 
   for (Node *N : depth_first(this))
     Reachable.insert(N);
@@ -283,13 +284,23 @@ RecursiveCoroutine<std::optional<MaterializedValues>>
 DataFlowGraph::materializeImpl(DataFlowGraph::Node *N,
                                MemoryOracle &MO,
                                NodeValuesMap &Results) const {
-  using namespace llvm;
-  using Node = DataFlowGraph::Node;
-
+  // Nodes shared by multiple users are materialized only once per query
   auto It = Results.find(N);
   if (It != Results.end())
     rc_return It->second;
 
+  auto Result = rc_recur materializeNode(N, MO, Results);
+  Results[N] = Result;
+  rc_return Result;
+}
+
+RecursiveCoroutine<std::optional<MaterializedValues>>
+DataFlowGraph::materializeNode(DataFlowGraph::Node *N,
+                               MemoryOracle &MO,
+                               NodeValuesMap &Results) const {
+  using namespace llvm;
+  using Node = DataFlowGraph::Node;
+
   revng_log(Log, "Materializing " << N->valueToString());
   LoggerIndent<> Indent(Log);
 
@@ -0,0 +1,45 @@
+/// \file DisassemblerPool.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "revng/Support/Assert.h"
+#include "revng/Yield/Assembly/DisassemblerPool.h"
+
+DisassemblerPool &DisassemblerPool::get() {
+  static DisassemblerPool Instance;
+  return Instance;
+}
+
+using DP = DisassemblerPool;
+DP::Handle
+DP::checkOut(MetaAddressType::Values AddressType,
+             const model::DisassemblyConfiguration &Configuration) {
+  Key TheKey = makeKey(AddressType, Configuration);
+  {
+    std::lock_guard Lock(Mutex);
+    auto It = Available.find(TheKey);
+    if (It != Available.end() and not It->second.empty()) {
+      Instance Result = std::move(It->second.back());
+      It->second.pop_back();
+      return Handle(*this, TheKey, std::move(Result));
+    }
+  }
+
+  // Build the new instance without holding the lock, it's the expensive part
+  using DI = LLVMDisassemblerInterface;
+  auto Result = std::make_unique<DI>(AddressType, Configuration);
+  return Handle(*this, TheKey, std::move(Result));
+}
+
+void DP::checkIn(const Key &TheKey, Instance Disassembler) {
+  revng_assert(Disassembler != nullptr);
+  std::lock_guard Lock(Mutex);
+  Available[TheKey].push_back(std::move(Disassembler));
+}
+
+void DP::clear() {
+  std::lock_guard Lock(Mutex);
+  Available.clear();
+}
@@ -10,19 +10,24 @@
 #include "revng/Model/Function.h"
 #include "revng/Model/RawBinaryView.h"
 #include "revng/Support/Debug.h"
+#include "revng/Yield/Assembly/DecodedInstructionCache.h"
+#include "revng/Yield/Assembly/DisassemblerPool.h"
 #include "revng/Yield/Assembly/DisassemblyHelper.h"
 #include "revng/Yield/Assembly/LLVMDisassemblerInterface.h"
 
 namespace detail {
 
+/// The instances are checked out of the process-wide pool on first use and
+/// returned to it when the helper is destroyed
 class DissassemblyHelperImpl
-  : public std::map<MetaAddressType::Values, LLVMDisassemblerInterface> {};
+  : public std::map<MetaAddressType::Values, DisassemblerPool::Handle> {};
 
 } // namespace detail
 
 using DH = DissassemblyHelper;
-DH::DissassemblyHelper() :
-  Internal{ std::make_unique<detail::DissassemblyHelperImpl>() } {
+DH::DissassemblyHelper(DecodedInstructionCache *Decoded) :
+  Internal{ std::make_unique<detail::DissassemblyHelperImpl>() },
+  Decoded(Decoded) {
 }
 DH::~DissassemblyHelper() {
 }
@@ -103,16 +108,35 @@ static void analyzeBasicBlocks(yield::Function &Function,
   }
 }
 
+static LLVMDisassemblerInterface::Disassembled
+decode(LLVMDisassemblerInterface &Disassembler,
+       DecodedInstructionCache *Decoded,
+       const MetaAddress &Address,
+       llvm::ArrayRef<uint8_t> RawBytes,
+       const model::DisassemblyConfiguration &Configuration) {
+  if (Decoded == nullptr)
+    return Disassembler.instruction(Address, RawBytes);
+
+  if (auto Cached = Decoded->find(Address, RawBytes, Configuration))
+    return std::move(*Cached);
+
+  auto Result = Disassembler.instruction(Address, RawBytes);
+  Decoded->insert(Address, RawBytes, Configuration, Result);
+  return Result;
+}
+
 yield::Function DH::disassemble(const model::Function &Function,
                                 const efa::ControlFlowGraph &Metadata,
                                 const RawBinaryView &BinaryView,
                                 const model::Binary &Binary) {
+  const auto &Configuration = Binary.Configuration().Disassembly();
+
   yield::Function ResultFunction;
   ResultFunction.Entry() = Function.Entry();
   for (auto BasicBlockInserter = ResultFunction.Blocks().batch_insert();
        const efa::BasicBlock &BasicBlock : Metadata.Blocks()) {
     auto &Helper = getDisassemblerFor(BasicBlock.ID().start().type(),
-                                      Binary.Configuration().Disassembly());
+                                      Configuration);
 
     yield::BasicBlock ResultBasicBlock;
     ResultBasicBlock.ID() = BasicBlock.ID();
@@ -143,7 +167,11 @@ yield::Function DH::disassemble(const model::Function &Function,
       revng_assert(MaybeInstructionOffset.has_value());
       auto InstructionBytes = RawBytes->drop_front(*MaybeInstructionOffset);
 
-      auto Disassembled = Helper.instruction(CurrentAddress, InstructionBytes);
+      auto Disassembled = decode(Helper,
+                                 Decoded,
+                                 CurrentAddress,
+                                 InstructionBytes,
+                                 Configuration);
       revng_assert(Disassembled.Address.isValid());
 
       yield::Instruction Result;
@@ -204,11 +232,12 @@ DH::getDisassemblerFor(MetaAddressType::Values AddressType,
   revng_assert(Internal != nullptr);
 
   if (auto It = Internal->find(AddressType); It != Internal->end())
-    return It->second;
+    return *It->second;
 
-  using DI = LLVMDisassemblerInterface;
+  auto &Pool = DisassemblerPool::get();
   auto [R, Success] = Internal->try_emplace(AddressType,
-                                            DI(AddressType, Configuration));
+                                            Pool.checkOut(AddressType,
+                                                          Configuration));
   revng_assert(Success);
-  return R->second;
+  return *R->second;
 }
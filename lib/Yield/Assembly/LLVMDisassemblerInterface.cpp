@@ -5,6 +5,7 @@
 //
 
 #include <map>
+#include <mutex>
 #include <string>
 
 #include "llvm/ADT/StringRef.h"
@@ -17,16 +18,14 @@
 #include "revng/Yield/Assembly/LLVMDisassemblerInterface.h"
 #include "revng/Yield/Function.h"
 
-/// \note: this might cause multithreading problems.
 static void ensureDisassemblersWereInitializedOnce() {
-  static bool WereTheyInitialized = false;
-  if (!WereTheyInitialized) {
+  // Instances are created from multiple threads
+  static std::once_flag Flag;
+  std::call_once(Flag, []() {
     llvm::InitializeAllTargetInfos();
     llvm::InitializeAllTargetMCs();
     llvm::InitializeAllDisassemblers();
-
-    WereTheyInitialized = true;
-  }
+  });
 }
 
 using DI = LLVMDisassemblerInterface;
@@ -21,16 +21,10 @@ static Node *copyNode(yield::calls::PreLayoutGraph &Graph, const Node *Source) {
 /// \tparam NV local `NodeView` specialization
 /// \tparam INV inverted location `NodeView` specialization
 template<typename NV, typename INV>
-Graph makeTreeImpl(const Graph &Input, std::string_view SlicePointLocation) {
-  auto SlicePointPredicate = [&SlicePointLocation](const Node *Node) {
-    return Node->getLocationString() == SlicePointLocation;
-  };
-  auto Entry = llvm::find_if(Input.nodes(), SlicePointPredicate);
-  revng_assert(Entry != Input.nodes().end());
-
+Graph makeTreeImpl(const Node *Entry) {
   // Find the rank of each node, such that for any node its rank is equal to
   // the highest rank among its children plus one.
-  llvm::ReversePostOrderTraversal ReversePostOrder(NV{ *Entry });
+  llvm::ReversePostOrderTraversal ReversePostOrder(NV{ Entry });
   std::unordered_map<const Node *, size_t> Ranks;
   for (const Node *CurrentNode : ReversePostOrder) {
     uint64_t &CurrentRank = Ranks[CurrentNode];
@@ -85,10 +79,10 @@ Graph makeTreeImpl(const Graph &Input, std::string_view SlicePointLocation) {
   // Manually adding `Entry` to the result graphs guarantees that it's never
   // empty. Since we only ever iterate on edges, this will guarantee that the
   // produced graph is not empty even in the cases where `Entry` has no edges.
-  Result.setEntryNode(FindOrAddHelper(*Entry));
+  Result.setEntryNode(FindOrAddHelper(Entry));
 
   // Fill in the `Result` graph.
-  for (const Node *Node : llvm::breadth_first(NV{ *Entry })) {
+  for (const Node *Node : llvm::breadth_first(NV{ Entry })) {
     for (auto Neighbour : llvm::children<INV>(Node)) {
       if (Ranks.contains(Neighbour)) {
         auto *NewNeighbour = FindOrAddHelper(Neighbour);
@@ -108,18 +102,46 @@ Graph makeTreeImpl(const Graph &Input, std::string_view SlicePointLocation) {
   return Result;
 }
 
+static const Node *findSlicePoint(const Graph &Input,
+                                  std::string_view SlicePointLocation) {
+  auto SlicePointPredicate = [&SlicePointLocation](const Node *Node) {
+    return Node->getLocationString() == SlicePointLocation;
+  };
+  auto Entry = llvm::find_if(Input.nodes(), SlicePointPredicate);
+  revng_assert(Entry != Input.nodes().end());
+  return *Entry;
+}
+
+yield::calls::IndexedCallGraph::IndexedCallGraph(PreLayoutGraph &&Input) :
+  Graph(std::move(Input)) {
+  for (const PreLayoutNode *Node : Graph.nodes()) {
+    auto [_, Success] = Nodes.try_emplace(Node->getLocationString(), Node);
+    revng_assert(Success);
+  }
+}
+
 yield::calls::PreLayoutGraph
-yield::calls::makeCalleeTree(const PreLayoutGraph &Input,
-                             std::string_view SlicePoint) {
+yield::calls::makeCalleeTree(const PreLayoutNode &SlicePoint) {
   // Forwards direction, makes sure no successor relation ever gets lost.
   return makeTreeImpl<const PreLayoutNode *,
-                      llvm::Inverse<const PreLayoutNode *>>(Input, SlicePoint);
+                      llvm::Inverse<const PreLayoutNode *>>(&SlicePoint);
 }
 
 yield::calls::PreLayoutGraph
-yield::calls::makeCallerTree(const PreLayoutGraph &Input,
+yield::calls::makeCalleeTree(const PreLayoutGraph &Input,
                              std::string_view SlicePoint) {
+  return makeCalleeTree(*findSlicePoint(Input, SlicePoint));
+}
+
+yield::calls::PreLayoutGraph
+yield::calls::makeCallerTree(const PreLayoutNode &SlicePoint) {
   // Backwards direction, makes sure no predecessor relation ever gets lost.
   return makeTreeImpl<llvm::Inverse<const PreLayoutNode *>,
-                      const PreLayoutNode *>(Input, SlicePoint);
+                      const PreLayoutNode *>(&SlicePoint);
+}
+
+yield::calls::PreLayoutGraph
+yield::calls::makeCallerTree(const PreLayoutGraph &Input,
+                             std::string_view SlicePoint) {
+  return makeCallerTree(*findSlicePoint(Input, SlicePoint));
 }
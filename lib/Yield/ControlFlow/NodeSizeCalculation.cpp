@@ -56,7 +56,7 @@ textSize(const SortedVector<yield::TaggedString> &Tagged) {
   revng_assert(!Tagged.empty());
 
   size_t LineLength = 0;
-  for (yield::TaggedString String : Tagged)
+  for (const yield::TaggedString &String : Tagged)
     LineLength += textSize(String).W;
 
   return yield::layout::Size(LineLength, 1);
@@ -110,26 +110,57 @@ static yield::layout::Size &appendSize(yield::layout::Size &Original,
   return Original;
 }
 
+using TextSize = yield::Instruction::TextSize;
+
+static TextSize::Box box(const yield::layout::Size &Size) {
+  return TextSize::Box{ static_cast<size_t>(Size.W),
+                        static_cast<size_t>(Size.H) };
+}
+
+static yield::layout::Size size(const TextSize::Box &Box) {
+  return yield::layout::Size(Box.Width, Box.Lines);
+}
+
+static TextSize measure(const yield::Instruction &Instruction) {
+  yield::layout::Size Body = textSize(Instruction.Disassembled());
+  for (const auto &Directive : Instruction.PrecedingDirectives())
+    appendSize(Body, textSize(Directive.Tags()));
+  for (const auto &Directive : Instruction.FollowingDirectives())
+    appendSize(Body, textSize(Directive.Tags()));
+
+  TextSize Result;
+  Result.Body = box(Body);
+  Result.Comment = box(textSize(Instruction.Comment()));
+  Result.CommentFirstLine = firstLineSize(Instruction.Comment());
+  Result.Error = box(textSize(Instruction.Error()));
+  Result.Address = box(textSize(Instruction.Address().toString()));
+  return Result;
+}
+
+void yield::cfg::precomputeTextSizes(yield::Function &Function) {
+  for (yield::BasicBlock &BasicBlock : Function.Blocks())
+    for (yield::Instruction &Instruction : BasicBlock.Instructions())
+      Instruction.CachedTextSize = measure(Instruction);
+}
+
 static yield::layout::Size
 instructionSize(const yield::Instruction &Instruction,
                 const yield::cfg::Configuration &Configuration,
                 size_t CommentIndicatorSize,
                 bool IsInDelayedSlot = false) {
-  // Instruction body.
-  yield::layout::Size DisassembledSize = textSize(Instruction.Disassembled());
-  for (const auto &Directive : Instruction.PrecedingDirectives())
-    appendSize(DisassembledSize, textSize(Directive.Tags()));
-  for (const auto &Directive : Instruction.FollowingDirectives())
-    appendSize(DisassembledSize, textSize(Directive.Tags()));
+  const TextSize Text = Instruction.CachedTextSize.has_value() ?
+                          *Instruction.CachedTextSize :
+                          measure(Instruction);
 
-  yield::layout::Size Result = fontSize(std::move(DisassembledSize),
+  // Instruction body.
+  yield::layout::Size Result = fontSize(size(Text.Body),
                                         Configuration.InstructionFontSize,
                                         Configuration);
 
   // Comment and delayed slot notice.
   yield::layout::Size CommentSize;
   if (!Instruction.Comment().empty()) {
-    CommentSize = textSize(Instruction.Comment());
+    CommentSize = size(Text.Comment);
     revng_assert(CommentSize.H == 1, "Multi line comments are not supported.");
     CommentSize.W += CommentIndicatorSize + 1;
   }
@@ -144,7 +175,7 @@ instructionSize(const yield::Instruction &Instruction,
                                    Configuration.InstructionFontSize,
                                    Configuration);
   if (CommentSize.H > 1) {
-    Result.W = std::max(firstLineSize(Instruction.Comment()) + Result.W
+    Result.W = std::max(Text.CommentFirstLine + Result.W
                           + CommentIndicatorSize + 1,
                         CommentBlockSize.W);
     auto OneLine = fontSize(yield::layout::Size(1, 1),
@@ -159,7 +190,7 @@ instructionSize(const yield::Instruction &Instruction,
   // Error.
   if (!Instruction.Error().empty())
     appendSize(Result,
-               fontSize(textSize(Instruction.Error())
+               fontSize(size(Text.Error)
                           + yield::layout::Size(CommentIndicatorSize + 1, 0),
                         Configuration.CommentFontSize,
                         Configuration));
@@ -169,8 +200,7 @@ instructionSize(const yield::Instruction &Instruction,
   RawBytesLengthWithOffsets.W += Instruction.RawBytes().size() * 3;
   RawBytesLengthWithOffsets.W += CommentIndicatorSize + 5;
   appendSize(Result,
-             fontSize(textSize(Instruction.Address().toString())
-                        + RawBytesLengthWithOffsets,
+             fontSize(size(Text.Address) + RawBytesLengthWithOffsets,
                       Configuration.AnnotationFontSize,
                       Configuration));
 
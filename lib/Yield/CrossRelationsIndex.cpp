@@ -0,0 +1,230 @@
+/// \file CrossRelationsIndex.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <vector>
+
+#include "llvm/ADT/StringMap.h"
+
+#include "revng/Pipeline/Location.h"
+#include "revng/Pipes/Ranks.h"
+#include "revng/Yield/CrossRelations/CrossRelationsIndex.h"
+
+namespace CR = yield::crossrelations;
+
+using Index = CR::CrossRelationsIndex;
+
+static llvm::Error malformed() {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "Malformed cross relations index");
+}
+
+static std::optional<uint32_t>
+findLocation(const std::vector<std::string_view> &Sorted,
+             std::string_view Location) {
+  auto It = std::lower_bound(Sorted.begin(), Sorted.end(), Location);
+  if (It == Sorted.end() or *It != Location)
+    return std::nullopt;
+  return It - Sorted.begin();
+}
+
+void Index::write(const CrossRelations &Relations, llvm::raw_ostream &OS) {
+  namespace ranks = revng::ranks;
+  using pipeline::locationFromString;
+
+  // Relations are sorted by location already
+  std::vector<std::string_view> Nodes;
+  Nodes.reserve(Relations.Relations().size());
+  for (const RelationDescription &Relation : Relations.Relations())
+    Nodes.push_back(Relation.Location());
+
+  std::string Strings;
+  llvm::StringMap<uint32_t> StringOffsets;
+  auto Intern = [&Strings, &StringOffsets](llvm::StringRef String) {
+    auto [It, New] = StringOffsets.try_emplace(String, Strings.size());
+    if (New) {
+      char Size[sizeof(uint32_t)];
+      llvm::support::endian::write32le(Size, String.size());
+      Strings.append(Size, sizeof(Size));
+      Strings.append(String.data(), String.size());
+    }
+    return It->second;
+  };
+
+  struct RawEdge {
+    uint32_t CallSite = 0;
+    uint32_t Caller = 0;
+    uint32_t Callee = 0;
+  };
+
+  std::vector<uint32_t> NodeStrings;
+  NodeStrings.reserve(Nodes.size());
+  for (std::string_view Node : Nodes)
+    NodeStrings.push_back(Intern(Node));
+
+  // Collect the edges grouped by callee, which is the order of the callers
+  std::vector<RawEdge> Edges;
+  std::vector<uint32_t> CallerRanges;
+  CallerRanges.reserve(Nodes.size() + 1);
+  uint32_t Callee = 0;
+  for (const RelationDescription &Relation : Relations.Relations()) {
+    CallerRanges.push_back(Edges.size());
+    for (const std::string &CallSite : Relation.IsCalledFrom()) {
+      // This assumes all the call sites are represented as basic block
+      // locations, as `CrossRelations::toCallGraph` does
+      auto CallerLocation = locationFromString(ranks::BasicBlock, CallSite);
+      revng_assert(CallerLocation.has_value());
+      auto CallerFunction = convertLocation(ranks::Function, *CallerLocation);
+      auto Caller = findLocation(Nodes, CallerFunction.toString());
+      revng_assert(Caller.has_value());
+
+      Edges.push_back({ Intern(CallSite), *Caller, Callee });
+    }
+    ++Callee;
+  }
+  CallerRanges.push_back(Edges.size());
+
+  // Sort the same edges by caller, keeping them sorted by callee within the
+  // same caller
+  std::vector<uint32_t> CalleeRanges(Nodes.size() + 1, 0);
+  for (const RawEdge &Edge : Edges)
+    ++CalleeRanges[Edge.Caller + 1];
+  for (size_t I = 1; I < CalleeRanges.size(); ++I)
+    CalleeRanges[I] += CalleeRanges[I - 1];
+
+  std::vector<const RawEdge *> ByCaller(Edges.size());
+  std::vector<uint32_t> Next(CalleeRanges.begin(), CalleeRanges.end() - 1);
+  for (const RawEdge &Edge : Edges)
+    ByCaller[Next[Edge.Caller]++] = &Edge;
+
+  using namespace llvm::support;
+  endian::Writer Writer(OS, little);
+  OS << Magic;
+  Writer.write<uint32_t>(Version);
+  Writer.write<uint32_t>(Nodes.size());
+  Writer.write<uint32_t>(Edges.size());
+  Writer.write<uint32_t>(Strings.size());
+
+  for (uint32_t Offset : NodeStrings)
+    Writer.write<uint32_t>(Offset);
+
+  for (uint32_t Offset : CallerRanges)
+    Writer.write<uint32_t>(Offset);
+  for (const RawEdge &Edge : Edges) {
+    Writer.write<uint32_t>(Edge.CallSite);
+    Writer.write<uint32_t>(Edge.Caller);
+  }
+
+  for (uint32_t Offset : CalleeRanges)
+    Writer.write<uint32_t>(Offset);
+  for (const RawEdge *Edge : ByCaller) {
+    Writer.write<uint32_t>(Edge->CallSite);
+    Writer.write<uint32_t>(Edge->Callee);
+  }
+
+  OS << Strings;
+
+  // Only functions are targets, dynamic functions are not
+  for (std::string_view Node : Nodes) {
+    bool IsFunction = locationFromString(ranks::Function, Node).has_value();
+    OS << static_cast<char>(IsFunction ? 1 : 0);
+  }
+}
+
+llvm::Expected<Index> Index::fromBuffer(llvm::StringRef Buffer) {
+  if (Buffer.size() < HeaderSize or not Buffer.starts_with(Magic))
+    return malformed();
+
+  using namespace llvm::support;
+  const char *Header = Buffer.data() + Magic.size();
+  uint32_t FoundVersion = endian::read32le(Header);
+  if (FoundVersion != Version) {
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "Unsupported cross relations index "
+                                   "version %u",
+                                   FoundVersion);
+  }
+
+  Index Result;
+  Result.Buffer = Buffer;
+  Result.NodeCount = endian::read32le(Header + 4);
+  Result.EdgeCount = endian::read32le(Header + 8);
+  Result.StringsSize = endian::read32le(Header + 12);
+  if (Result.totalSize() != Buffer.size())
+    return malformed();
+
+  if (auto Error = Result.verify())
+    return Error;
+
+  return Result;
+}
+
+llvm::Error Index::verify() const {
+  auto IsValidString = [this](uint32_t Offset) {
+    if (Offset > StringsSize or StringsSize - Offset < sizeof(uint32_t))
+      return false;
+    return at(stringsOffset() + Offset, 0) <= StringsSize - Offset - 4;
+  };
+
+  auto IsValidRange = [this](size_t RangesOffset) {
+    if (at(RangesOffset, 0) != 0 or at(RangesOffset, NodeCount) != EdgeCount)
+      return false;
+    for (uint32_t Node = 0; Node < NodeCount; ++Node)
+      if (at(RangesOffset, Node) > at(RangesOffset, Node + 1))
+        return false;
+    return true;
+  };
+
+  auto AreValidEdges = [&](size_t EdgesOffset) {
+    for (uint32_t I = 0; I < EdgeCount; ++I)
+      if (not IsValidString(at(EdgesOffset, 2 * I))
+          or at(EdgesOffset, 2 * I + 1) >= NodeCount)
+        return false;
+    return true;
+  };
+
+  for (uint32_t Node = 0; Node < NodeCount; ++Node) {
+    if (not IsValidString(at(nodesOffset(), Node)))
+      return malformed();
+
+    // Lookups rely on the nodes being sorted
+    if (Node > 0 and location(Node - 1) >= location(Node))
+      return malformed();
+  }
+
+  if (not IsValidRange(callerRangesOffset())
+      or not AreValidEdges(callersOffset())
+      or not IsValidRange(calleeRangesOffset())
+      or not AreValidEdges(calleesOffset()))
+    return malformed();
+
+  return llvm::Error::success();
+}
+
+std::optional<uint32_t> Index::find(std::string_view Location) const {
+  auto Nodes = llvm::seq<uint32_t>(0, NodeCount);
+  auto It = llvm::partition_point(Nodes, [this, Location](uint32_t Node) {
+    return location(Node) < Location;
+  });
+  if (It == Nodes.end() or location(*It) != Location)
+    return std::nullopt;
+  return *It;
+}
+
+CR::CrossRelations Index::relationsOf(uint32_t Node) const {
+  CrossRelations Result;
+
+  auto &Self = Result.Relations()[std::string(location(Node))];
+  for (const Edge &Caller : callers(Node))
+    Self.IsCalledFrom().insert(std::string(Caller.CallSite));
+
+  for (const Edge &Callee : callees(Node)) {
+    auto &Relation = Result.Relations()[std::string(location(Callee.Node))];
+    Relation.IsCalledFrom().insert(std::string(Callee.CallSite));
+  }
+
+  return Result;
+}
@@ -4,8 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
-#include "boost/icl/interval_map.hpp"
+#include <stack>
+#include <vector>
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/Support/Error.h"
@@ -17,11 +20,12 @@
 #include "revng/PTML/Tag.h"
 #include "revng/Pipeline/AllRegistries.h"
 #include "revng/Pipeline/Location.h"
+#include "revng/Pipeline/LocationInterner.h"
 #include "revng/Pipes/FileContainer.h"
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/Ranks.h"
 #include "revng/Support/IRHelpers.h"
-#include "revng/Support/MetaAddress/IntervalContainers.h"
+#include "revng/Support/MetaAddress.h"
 
 using namespace llvm;
 
@@ -33,12 +37,125 @@ static FormattedNumber formatNumber(uint64_t Number, unsigned Width = 8) {
   return FormattedNumber(Number, 0, Width, true, false, false);
 };
 
+namespace {
+
+/// Sorted, disjoint ranges of addresses, each associated to the locations of
+/// all the instructions covering it. Memory is proportional to the number of
+/// instructions, while the location strings are interned.
+class LocationRanges {
+public:
+  struct Range {
+    MetaAddress Begin;
+    MetaAddress End;
+    uint32_t FirstLocation = 0;
+    uint32_t LocationCount = 0;
+  };
+
+private:
+  struct Annotation {
+    MetaAddress Begin;
+    MetaAddress End;
+    pipeline::InternedLocation Location;
+  };
+
+private:
+  std::vector<Annotation> Annotations;
+
+  std::vector<Range> Ranges;
+  std::vector<pipeline::InternedLocation> RangeLocations;
+
+public:
+  void add(MetaAddress Begin,
+           MetaAddress End,
+           pipeline::InternedLocation Location) {
+    Annotations.push_back({ Begin, End, Location });
+  }
+
+  /// Split the annotations added so far in disjoint ranges
+  void finalize();
+
+  const std::vector<Range> &ranges() const { return Ranges; }
+
+  auto locations(const Range &R) const {
+    auto Locations = llvm::ArrayRef(RangeLocations)
+                       .slice(R.FirstLocation, R.LocationCount);
+    return llvm::map_range(Locations, [](pipeline::InternedLocation L) {
+      return L.str();
+    });
+  }
+};
+
+} // namespace
+
+void LocationRanges::finalize() {
+  llvm::sort(Annotations, [](const Annotation &LHS, const Annotation &RHS) {
+    return LHS.Begin < RHS.Begin;
+  });
+
+  // All the addresses where the set of covering instructions might change
+  std::vector<MetaAddress> Points;
+  Points.reserve(Annotations.size() * 2);
+  for (const Annotation &A : Annotations) {
+    Points.push_back(A.Begin);
+    Points.push_back(A.End);
+  }
+  llvm::sort(Points);
+  Points.erase(std::unique(Points.begin(), Points.end()), Points.end());
+
+  // Sweep the points, tracking the annotations covering each of them
+  auto NextAnnotation = Annotations.begin();
+  llvm::SmallVector<const Annotation *, 4> Active;
+  llvm::SmallVector<pipeline::InternedLocation, 4> IDs;
+  for (size_t I = 0; I + 1 < Points.size(); ++I) {
+    const MetaAddress &Begin = Points[I];
+    const MetaAddress &End = Points[I + 1];
+
+    while (NextAnnotation != Annotations.end()
+           and NextAnnotation->Begin == Begin)
+      Active.push_back(&*NextAnnotation++);
+    llvm::erase_if(Active,
+                   [&Begin](const Annotation *A) { return A->End <= Begin; });
+    if (Active.empty())
+      continue;
+
+    // Emit the locations sorted and without duplicates
+    IDs.clear();
+    for (const Annotation *A : Active)
+      IDs.push_back(A->Location);
+    llvm::sort(IDs, pipeline::InternedLocation::lessByString);
+    IDs.erase(std::unique(IDs.begin(), IDs.end()), IDs.end());
+
+    // Extend the previous range, if it's adjacent and has the same locations
+    if (not Ranges.empty()) {
+      Range &Last = Ranges.back();
+      auto LastIDs = llvm::ArrayRef(RangeLocations)
+                       .take_back(Last.LocationCount);
+      if (Last.End == Begin and LastIDs == llvm::ArrayRef(IDs)) {
+        Last.End = End;
+        continue;
+      }
+    }
+
+    Ranges.push_back({ Begin,
+                       End,
+                       static_cast<uint32_t>(RangeLocations.size()),
+                       static_cast<uint32_t>(IDs.size()) });
+    RangeLocations.append(IDs.begin(), IDs.end());
+  }
+
+  Annotations = {};
+}
+
 static void outputHexDump(const TupleTree<model::Binary> &Binary,
                           const pipeline::LLVMContainer &ModuleContainer,
                           const CFGMap &CFGMap,
                           const BinaryFileContainer &SourceBinary,
                           StringRef OutputPath) {
-  auto BufferOrError = MemoryBuffer::getFileOrSTDIN(*SourceBinary.path());
+  // Let the binary be memory mapped, no matter its size
+  auto BufferOrError = MemoryBuffer::getFile(*SourceBinary.path(),
+                                             /* IsText = */ false,
+                                             /* RequiresNullTerminator = */
+                                             false);
   auto Buffer = cantFail(errorOrToExpected(std::move(BufferOrError)));
   RawBinaryView BinaryView(*Binary.get(), Buffer->getBuffer());
 
@@ -49,23 +166,10 @@ static void outputHexDump(const TupleTree<model::Binary> &Binary,
 
   ControlFlowGraphCache ControlFlowGraphCache(CFGMap);
 
-  using boost::icl::discrete_interval;
-  using boost::icl::inplace_plus;
-  using boost::icl::inter_section;
-  using boost::icl::interval_map;
-  using boost::icl::partial_absorber;
-  using IntervalType = discrete_interval<IntervalMetaAddress>;
-  using Map = interval_map<IntervalMetaAddress,
-                           std::set<std::string>,
-                           partial_absorber,
-                           std::less,
-                           inplace_plus,
-                           inter_section,
-                           IntervalType>;
-  Map Instructions;
+  LocationRanges Instructions;
   ptml::PTMLBuilder PTMLBuilder;
 
-  auto CreateTag = [&PTMLBuilder](const std::string &Location) -> ptml::Tag {
+  auto CreateTag = [&PTMLBuilder](llvm::StringRef Location) -> ptml::Tag {
     auto Tag = PTMLBuilder.getTag("span");
     Tag.addAttribute("data-location-definition", Location);
     return Tag;
@@ -90,27 +194,25 @@ static void outputHexDump(const TupleTree<model::Binary> &Binary,
         uint64_t Size = SizeValue->getZExtValue();
         MetaAddress Begin = Address.toGeneric();
         MetaAddress End = Begin + Size;
-        auto Interval = IntervalType::right_open(Begin, End);
-
-        std::string Str = serializedLocation(ranks::Instruction,
-                                             EntryAddress,
-                                             BasicBlockID,
-                                             Address);
 
-        std::set<std::string> Set{ Str };
-        Instructions.add(std::make_pair(Interval, Set));
+        Instructions.add(Begin,
+                         End,
+                         internedLocation(ranks::Instruction,
+                                          EntryAddress,
+                                          BasicBlockID,
+                                          Address));
       }
     }
   }
+  Instructions.finalize();
 
   ptml::Tag DivTag = PTMLBuilder.getTag("div");
 
   Output << DivTag.open();
 
-  MetaAddress CurrentAddress;
-  Map::const_iterator Current = Instructions.begin();
-  Map::const_iterator Next = std::next(Current);
-  const Map::const_iterator End = Instructions.end();
+  using Range = LocationRanges::Range;
+  auto Current = Instructions.ranges().begin();
+  const auto End = Instructions.ranges().end();
 
   std::stack<ptml::Tag> OpenedTags;
   for (const auto &[Segment, SegmentBinary] : BinaryView.segments()) {
@@ -121,12 +223,11 @@ static void outputHexDump(const TupleTree<model::Binary> &Binary,
     SmallString<16> PrintableChars;
 
     for (size_t Index = 0; Index < SegmentBinary.size(); ++Index) {
-      // If there is still some interval to process, set it to CurrentInterval.
-      // Otherwise, create invalid interval.
-      IntervalType CurrentInterval = (Current != End) ?
-                                       Current->first :
-                                       IntervalType{ IntervalMetaAddress{},
-                                                     IntervalMetaAddress{} };
+      // Skip the ranges that end before the current byte, such as those
+      // outside of any segment
+      while (Current != End and Current->End <= CurrentAddress)
+        ++Current;
+      const Range *CurrentRange = Current != End ? &*Current : nullptr;
 
       bool LineBegins = Index % BytesInLine == 0;
       if (LineBegins) {
@@ -134,30 +235,22 @@ static void outputHexDump(const TupleTree<model::Binary> &Binary,
         Output << formatNumber(CurrentAddress.address()) << "  ";
       }
 
-      // Open tags if this is beginning of next interval or line begins
-      bool IsIntervalValid = CurrentInterval.lower().isValid()
-                             and CurrentInterval.upper().isValid();
-      // Check if current byte is inside currently processed interval
-      bool AfterStart = CurrentInterval.lower() <= CurrentAddress;
-      // Check if current byte is before end of current interval
-      bool BeforeEnd = CurrentAddress < CurrentInterval.upper();
-      // If current interval is valid and current byte is after start and before
-      // end of interval, this byte belongs to some interval and should be
-      // wrapped with location tags.
-      bool IsInsideInterval = IsIntervalValid and AfterStart and BeforeEnd;
-      // Is current byte the first byte of interval?
-      bool AtStart = CurrentInterval.lower() == CurrentAddress;
-      // If interval is valid and current byte is the first byte, location tag
-      // should be printed before byte.
-      bool IsStartOfInterval = IsIntervalValid and AtStart;
+      // If there is a range left and the current byte is in it, this byte
+      // should be wrapped with location tags.
+      bool IsInsideInterval = CurrentRange != nullptr
+                              and CurrentRange->Begin <= CurrentAddress;
+      // If the current byte is the first byte of the range, location tags
+      // should be printed before it.
+      bool IsStartOfInterval = CurrentRange != nullptr
+                               and CurrentRange->Begin == CurrentAddress;
 
       // Tag opening is printed in two situations:
       //  1. new interval is beginning on current byte
       //  2. new line begins and previously opened (and closed on line end)
       //     interval is continued.
       if (IsStartOfInterval or (LineBegins and IsInsideInterval)) {
-        for (const std::string &Tag : Current->second) {
-          auto PTMLTag = CreateTag(Tag);
+        for (llvm::StringRef Location : Instructions.locations(*Current)) {
+          auto PTMLTag = CreateTag(Location);
           OpenedTags.push(PTMLTag);
           Output << PTMLTag.open();
         }
@@ -182,8 +275,8 @@ static void outputHexDump(const TupleTree<model::Binary> &Binary,
       const bool EndOfLine = Counter == BytesInLine;
       // If current byte (just printed) is in current interval, but next byte
       // isn't, this place is end of interval.
-      const bool EndOfInterval = CurrentAddress < CurrentInterval.upper()
-                                 and NextAddress >= CurrentInterval.upper();
+      const bool EndOfInterval = IsInsideInterval
+                                 and NextAddress >= CurrentRange->End;
 
       const bool EndOfSegment = Index + 1 == SegmentBinary.size();
 
@@ -221,15 +314,6 @@ static void outputHexDump(const TupleTree<model::Binary> &Binary,
         }
       }
 
-      // At the end of interval, we try to go to the next interval (if it
-      // exists).
-      if (EndOfInterval) {
-        Current = Next;
-        if (Next != End) {
-          Next = std::next(Next);
-        }
-      }
-
       CurrentAddress = NextAddress;
     }
 
@@ -0,0 +1,165 @@
+/// \file LayoutData.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Yield/CallGraphs/CallGraphSlices.h"
+#include "revng/Yield/CrossRelations/CrossRelations.h"
+#include "revng/Yield/LayoutData.h"
+
+#include "Layouts.h"
+
+namespace sugiyama = yield::layout::sugiyama;
+
+static constexpr unsigned Version = 1;
+
+static llvm::StringRef orientationName(sugiyama::Orientation Orientation) {
+  switch (Orientation) {
+  case sugiyama::Orientation::LeftToRight:
+    return "LeftToRight";
+  case sugiyama::Orientation::RightToLeft:
+    return "RightToLeft";
+  case sugiyama::Orientation::TopToBottom:
+    return "TopToBottom";
+  case sugiyama::Orientation::BottomToTop:
+    return "BottomToTop";
+  default:
+    revng_abort("Unknown orientation");
+  }
+}
+
+/// Emit \p Value with at most two decimal digits, which is as precise as the
+/// SVG version of the graph, and without the trailing zeros
+static void coordinate(llvm::json::OStream &JSON,
+                       yield::layout::Coordinate Value) {
+  std::string Result = llvm::formatv("{0:F2}", Value);
+  Result.erase(Result.find_last_not_of('0') + 1);
+  if (Result.back() == '.')
+    Result.pop_back();
+  if (Result == "-0")
+    Result = "0";
+  JSON.rawValue(Result);
+}
+
+static void emitNodeData(llvm::json::OStream &JSON,
+                         const yield::cfg::PostLayoutNode &Node) {
+  JSON.attribute("Location", Node.getLocationString());
+}
+
+static void emitNodeData(llvm::json::OStream &JSON,
+                         const yield::calls::PostLayoutNode &Node) {
+  JSON.attribute("Location", Node.getLocationString());
+  if (Node.IsShallow)
+    JSON.attribute("Shallow", true);
+}
+
+template<bool ShouldEmitEmptyNodes, typename GraphType>
+static std::string exportLayout(const yield::LaidOutGraph<GraphType> &Layout) {
+  const GraphType &Graph = Layout.Graph;
+
+  std::string Result;
+  llvm::raw_string_ostream Stream(Result);
+  llvm::json::OStream JSON(Stream);
+
+  JSON.objectBegin();
+  JSON.attribute("Version", Version);
+  JSON.attribute("Orientation", orientationName(Layout.Orientation));
+  JSON.attribute("OrthogonalBends", Layout.Configuration.UseOrthogonalBends);
+
+  if (Graph.size() != 0) {
+    yield::Viewbox Box = yield::calculateViewbox(Graph);
+    JSON.attributeArray("ViewBox", [&]() {
+      coordinate(JSON, Box.TopLeft.X);
+      coordinate(JSON, Box.TopLeft.Y);
+      coordinate(JSON, Box.BottomRight.X - Box.TopLeft.X);
+      coordinate(JSON, Box.BottomRight.Y - Box.TopLeft.Y);
+    });
+  }
+
+  // Export all the nodes, numbering them for the edges to refer to them.
+  using NodeType = typename GraphType::Node;
+  llvm::DenseMap<const NodeType *, unsigned> Indices;
+  JSON.attributeArray("Nodes", [&]() {
+    for (const NodeType *Node : Graph.nodes()) {
+      if (not ShouldEmitEmptyNodes and Node->isEmpty())
+        continue;
+
+      Indices.try_emplace(Node, Indices.size());
+      yield::Viewbox Box = yield::makeViewbox(Node);
+      JSON.object([&]() {
+        JSON.attributeBegin("X");
+        coordinate(JSON, Box.TopLeft.X);
+        JSON.attributeEnd();
+        JSON.attributeBegin("Y");
+        coordinate(JSON, Box.TopLeft.Y);
+        JSON.attributeEnd();
+        JSON.attributeBegin("W");
+        coordinate(JSON, Node->Size.W);
+        JSON.attributeEnd();
+        JSON.attributeBegin("H");
+        coordinate(JSON, Node->Size.H);
+        JSON.attributeEnd();
+        emitNodeData(JSON, *Node);
+      });
+    }
+  });
+
+  // Export all the edges between the nodes exported above.
+  JSON.attributeArray("Edges", [&]() {
+    for (const NodeType *From : Graph.nodes()) {
+      auto FromIt = Indices.find(From);
+      if (FromIt == Indices.end())
+        continue;
+
+      for (const auto [To, Edge] : From->successor_edges()) {
+        auto ToIt = Indices.find(To);
+        if (ToIt == Indices.end())
+          continue;
+
+        revng_assert(Edge != nullptr);
+        JSON.object([&]() {
+          JSON.attribute("From", FromIt->second);
+          JSON.attribute("To", ToIt->second);
+          llvm::StringRef Type = yield::edgeTypeAsString(*Edge);
+          JSON.attribute("Type", Type);
+          JSON.attributeArray("Path", [&]() {
+            for (const yield::layout::Point &Point : Edge->Path) {
+              coordinate(JSON, Point.X);
+              coordinate(JSON, -Point.Y);
+            }
+          });
+        });
+      }
+    }
+  });
+
+  JSON.objectEnd();
+  Stream.flush();
+  return Result;
+}
+
+std::string
+yield::layoutdata::controlFlowGraph(const yield::Function &InternalFunction,
+                                    const model::Binary &Binary) {
+  return exportLayout<true>(layOutControlFlowGraph(InternalFunction, Binary));
+}
+
+using CrossRelations = yield::crossrelations::CrossRelations;
+std::string yield::layoutdata::callGraph(const CrossRelations &Relations,
+                                         const model::Binary &Binary) {
+  return exportLayout<false>(layOutCallGraph(Relations, Binary));
+}
+
+std::string
+yield::layoutdata::callGraphSlice(std::string_view SlicePoint,
+                                  const calls::IndexedCallGraph &CallGraph,
+                                  const model::Binary &Binary) {
+  auto Layout = layOutCallGraphSlice(SlicePoint, CallGraph, Binary);
+  return exportLayout<false>(Layout);
+}
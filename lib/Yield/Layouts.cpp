@@ -0,0 +1,296 @@
+/// \file Layouts.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/DenseMap.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Support/GraphAlgorithms.h"
+#include "revng/Yield/CallGraphs/CallGraphSlices.h"
+#include "revng/Yield/ControlFlow/Extraction.h"
+#include "revng/Yield/ControlFlow/NodeSizeCalculation.h"
+#include "revng/Yield/CrossRelations/CrossRelations.h"
+#include "revng/Yield/Function.h"
+
+#include "Layouts.h"
+
+namespace yield::layout::sugiyama {
+
+/// A helper for invoking sugiyama style layouter with the configuration
+/// filled in based on the relevant cfg::Configuration.
+///
+/// \tparam Node The type of the data attached to each graph node
+/// \tparam Edge The type of the data attached to each graph edge
+///
+/// \param Graph An input graph
+/// \param CFG An object describing the desired CFG configuration
+/// \param LayoutOrientation The direction of the desired layout
+/// \param Ranking The ranking strategy
+/// \param UseSimpleTreeOptimization A flag deciding whether simple tree
+///        optimization should be used.
+///
+/// \return The laid out version of the graph corresponding to \ref Graph
+template<typename Node, typename Edge = Empty>
+inline std::optional<OutputGraph<Node, Edge>>
+compute(const InputGraph<Node, Edge> &Graph,
+        const cfg::Configuration &CFG,
+        Orientation LayoutOrientation = Orientation::TopToBottom,
+        RankingStrategy Ranking = RankingStrategy::DisjointDepthFirstSearch,
+        bool UseSimpleTreeOptimization = false) {
+  return compute(Graph,
+                 Configuration{
+                   .Ranking = Ranking,
+                   .Orientation = LayoutOrientation,
+                   .UseOrthogonalBends = CFG.UseOrthogonalBends,
+                   .PreserveLinearSegments = CFG.PreserveLinearSegments,
+                   .UseSimpleTreeOptimization = UseSimpleTreeOptimization,
+                   .VirtualNodeWeight = CFG.VirtualNodeWeight,
+                   .NodeMarginSize = CFG.ExternalNodeMarginSize,
+                   .EdgeMarginSize = CFG.EdgeMarginSize });
+}
+
+} // namespace yield::layout::sugiyama
+
+using namespace yield;
+
+std::string_view yield::edgeTypeAsString(const cfg::Edge &Edge) {
+  switch (Edge.Type) {
+  case cfg::EdgeType::Unconditional:
+    return "unconditional";
+  case cfg::EdgeType::Call:
+    return "call";
+  case cfg::EdgeType::Taken:
+    return "taken";
+  case cfg::EdgeType::Refused:
+    return "refused";
+  default:
+    revng_abort("Unknown edge type");
+  }
+}
+
+std::string_view yield::edgeTypeAsString(const calls::Edge &Edge) {
+  // TODO: we might want to use separate set of tags for call graphs.
+  return Edge.IsBackwards ? "refused" : "taken";
+}
+
+LaidOutGraph<cfg::PostLayoutGraph>
+yield::layOutControlFlowGraph(const yield::Function &InternalFunction,
+                              const model::Binary &Binary) {
+  constexpr auto Configuration = cfg::Configuration::getDefault();
+
+  using Pre = cfg::PreLayoutGraph;
+  Pre Graph = cfg::extractFromInternal(InternalFunction, Binary, Configuration);
+
+  cfg::calculateNodeSizes(Graph, InternalFunction, Binary, Configuration);
+
+  constexpr auto TopToBottom = layout::sugiyama::Orientation::TopToBottom;
+
+  using Post = std::optional<cfg::PostLayoutGraph>;
+  Post Result = layout::sugiyama::compute(Graph, Configuration, TopToBottom);
+  revng_assert(Result.has_value());
+
+  return { std::move(*Result), Configuration, TopToBottom };
+}
+
+static cfg::Configuration callGraphConfiguration() {
+  // TODO: make configuration accessible from outside.
+  auto Configuration = cfg::Configuration::getDefault();
+  Configuration.UseOrthogonalBends = false;
+  return Configuration;
+}
+
+static void computeSizes(yield::calls::PreLayoutGraph &Graph,
+                         const model::Binary &Binary,
+                         const cfg::Configuration &Configuration) {
+  for (auto *Node : Graph.nodes()) {
+    if (!Node->isEmpty()) {
+      // A normal node
+      size_t NameLength = 0;
+      if (std::optional<model::Function::Key> Key = Node->getFunction()) {
+        auto Iterator = Binary.Functions().find(std::get<0>(*Key));
+        revng_assert(Iterator != Binary.Functions().end());
+        NameLength = Iterator->name().size();
+      } else if (auto DynamicFunctionKey = Node->getDynamicFunction()) {
+        const std::string &Key = std::get<0>(*DynamicFunctionKey);
+        auto Iterator = Binary.ImportedDynamicFunctions().find(Key);
+        revng_assert(Iterator != Binary.ImportedDynamicFunctions().end());
+        NameLength = Iterator->name().size();
+      } else {
+        revng_abort("Unsupported node type.");
+      }
+
+      revng_assert(NameLength != 0);
+      Node->Size = yield::layout::Size{
+        NameLength * Configuration.LabelFontSize
+          * Configuration.HorizontalFontFactor,
+        1 * Configuration.LabelFontSize * Configuration.VerticalFontFactor
+      };
+    } else {
+      // An entry node.
+      Node->Size = yield::layout::Size{ 30, 30 };
+    }
+
+    Node->Size.W += Configuration.InternalNodeMarginSize * 2;
+    Node->Size.H += Configuration.InternalNodeMarginSize * 2;
+  }
+}
+
+using CrossRelations = yield::crossrelations::CrossRelations;
+LaidOutGraph<calls::PostLayoutGraph>
+yield::layOutCallGraph(const CrossRelations &Relations,
+                       const model::Binary &Binary) {
+  auto Configuration = callGraphConfiguration();
+  constexpr auto LeftToRight = layout::sugiyama::Orientation::LeftToRight;
+  constexpr auto BFS = layout::sugiyama::RankingStrategy::BreadthFirstSearch;
+
+  yield::calls::PreLayoutGraph Result = Relations.toYieldGraph();
+  auto EntryPoints = entryPoints(&Result);
+  revng_assert(!EntryPoints.empty());
+  if (EntryPoints.size() > 1) {
+    // Add an artificial "root" node to make sure there's a single entry point.
+    yield::calls::PreLayoutNode *Root = Result.addNode();
+    for (yield::calls::PreLayoutNode *Entry : EntryPoints)
+      Root->addSuccessor(Entry);
+    Result.setEntryNode(Root);
+  } else {
+    Result.setEntryNode(EntryPoints.front());
+  }
+
+  auto Tree = calls::makeCalleeTree(Result);
+  computeSizes(Tree, Binary, Configuration);
+
+  namespace sugiyama = layout::sugiyama;
+  auto LT = sugiyama::compute(Tree, Configuration, LeftToRight, BFS, true);
+  revng_assert(LT.has_value());
+
+  return { std::move(*LT), Configuration, LeftToRight };
+}
+
+static auto flipPoint(yield::layout::Point const &Point) {
+  return yield::layout::Point{ -Point.X, -Point.Y };
+};
+static auto calculateDelta(yield::layout::Point const &LHS,
+                           yield::layout::Point const &RHS) {
+  return yield::layout::Point{ RHS.X - LHS.X, RHS.Y - LHS.Y };
+}
+static auto translatePoint(yield::layout::Point const &Point,
+                           yield::layout::Point const &Delta) {
+  return yield::layout::Point{ Point.X + Delta.X, Point.Y + Delta.Y };
+}
+static auto convertPoint(yield::layout::Point const &Point,
+                         yield::layout::Point const &Delta) {
+  return translatePoint(flipPoint(Point), Delta);
+}
+
+static yield::calls::PostLayoutGraph
+combineHalvesHelper(std::string_view SlicePoint,
+                    yield::calls::PostLayoutGraph &&ForwardsSlice,
+                    yield::calls::PostLayoutGraph &&BackwardsSlice) {
+  revng_assert(ForwardsSlice.size() != 0 && BackwardsSlice.size() != 0);
+
+  auto IsSlicePoint = [&SlicePoint](const auto *Node) {
+    return Node->getLocationString() == SlicePoint;
+  };
+
+  auto ForwardsIterator = llvm::find_if(ForwardsSlice.nodes(), IsSlicePoint);
+  revng_assert(ForwardsIterator != ForwardsSlice.nodes().end());
+  auto *ForwardsSlicePoint = *ForwardsIterator;
+  revng_assert(ForwardsSlicePoint != nullptr);
+
+  auto BackwardsIterator = llvm::find_if(BackwardsSlice.nodes(), IsSlicePoint);
+  revng_assert(BackwardsIterator != BackwardsSlice.nodes().end());
+  auto *BackwardsSlicePoint = *BackwardsIterator;
+  revng_assert(BackwardsSlicePoint != nullptr);
+
+  // Find the distance all the nodes of one of the graphs need to be shifted so
+  // that the `SlicePoint`s overlap.
+  auto Delta = calculateDelta(flipPoint((*BackwardsIterator)->Center),
+                              (*ForwardsIterator)->Center);
+
+  // Ready the backwards part of the graph
+  for (auto *From : BackwardsSlice.nodes()) {
+    From->Center = convertPoint(From->Center, Delta);
+    for (auto [Neighbor, Label] : From->successor_edges())
+      for (auto &Point : Label->Path)
+        Point = convertPoint(Point, Delta);
+  }
+
+  // Define a map for faster node lookup.
+  using PostNode = yield::calls::PostLayoutGraph::Node;
+  llvm::DenseMap<PostNode *, PostNode *> Lookup;
+  auto AccessLookup = [&Lookup](PostNode *Key) {
+    auto Iterator = Lookup.find(Key);
+    revng_assert(Iterator != Lookup.end() && Iterator->second != nullptr);
+    return Iterator->second;
+  };
+
+  // Move the nodes from the backwards slice into the forwards one.
+  for (auto *Node : BackwardsSlice.nodes()) {
+    revng_assert(Node != nullptr);
+    if (Node != BackwardsSlicePoint) {
+      auto NewNode = ForwardsSlice.addNode(Node->moveData());
+      auto [Iterator, Success] = Lookup.try_emplace(Node, NewNode);
+      revng_assert(Success == true);
+    } else {
+      auto [Iterator, Success] = Lookup.try_emplace(BackwardsSlicePoint,
+                                                    ForwardsSlicePoint);
+      revng_assert(Success == true);
+    }
+  }
+
+  // Move all the edges while also inverting their direction.
+  for (auto *From : BackwardsSlice.nodes()) {
+    for (auto [To, Label] : From->successor_edges()) {
+      std::reverse(Label->Path.begin(), Label->Path.end());
+      AccessLookup(To)->addSuccessor(AccessLookup(From), std::move(*Label));
+    }
+  }
+
+  return std::move(ForwardsSlice);
+}
+
+LaidOutGraph<calls::PostLayoutGraph>
+yield::layOutCallGraphSlice(std::string_view SlicePoint,
+                            const calls::IndexedCallGraph &Graph,
+                            const model::Binary &Binary) {
+  const calls::PreLayoutNode *SlicePointNode = Graph.find(SlicePoint);
+  revng_assert(SlicePointNode != nullptr);
+
+  auto Configuration = callGraphConfiguration();
+  constexpr auto LeftToRight = layout::sugiyama::Orientation::LeftToRight;
+  constexpr auto BFS = layout::sugiyama::RankingStrategy::BreadthFirstSearch;
+
+  // Ready the forwards facing part of the slice
+  auto Forward = calls::makeCalleeTree(*SlicePointNode);
+  for (auto *From : Forward.nodes())
+    for (auto [To, Label] : From->successor_edges())
+      Label->IsBackwards = false;
+  computeSizes(Forward, Binary, Configuration);
+  auto LaidOutForwardsGraph = layout::sugiyama::compute(Forward,
+                                                        Configuration,
+                                                        LeftToRight,
+                                                        BFS,
+                                                        true);
+  revng_assert(LaidOutForwardsGraph.has_value());
+
+  // Ready the backwards facing part of the slice
+  auto Backwards = calls::makeCallerTree(*SlicePointNode);
+  for (auto *From : Backwards.nodes())
+    for (auto [To, Label] : From->successor_edges())
+      Label->IsBackwards = true;
+  computeSizes(Backwards, Binary, Configuration);
+  auto LaidOutBackwardsGraph = layout::sugiyama::compute(Backwards,
+                                                         Configuration,
+                                                         LeftToRight,
+                                                         BFS,
+                                                         true);
+  revng_assert(LaidOutBackwardsGraph.has_value());
+
+  // Consume the halves to produce a combined graph.
+  auto CombinedGraph = combineHalvesHelper(SlicePoint,
+                                           std::move(*LaidOutForwardsGraph),
+                                           std::move(*LaidOutBackwardsGraph));
+  return { std::move(CombinedGraph), Configuration, LeftToRight };
+}
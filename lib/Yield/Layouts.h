@@ -0,0 +1,128 @@
+#pragma once
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string_view>
+
+#include "revng/ADT/Concepts.h"
+#include "revng/GraphLayout/SugiyamaStyle/Compute.h"
+#include "revng/Support/Assert.h"
+#include "revng/Yield/CallGraphs/Graph.h"
+#include "revng/Yield/ControlFlow/Configuration.h"
+#include "revng/Yield/ControlFlow/Graph.h"
+
+namespace model {
+class Binary;
+}
+
+namespace yield {
+
+class Function;
+
+namespace calls {
+
+class IndexedCallGraph;
+
+} // namespace calls
+
+namespace crossrelations {
+
+class CrossRelations;
+
+} // namespace crossrelations
+
+/// A graph after the layout, together with what it was laid out with, which
+/// the exporters need to know in order to draw it.
+template<typename GraphType>
+struct LaidOutGraph {
+  GraphType Graph;
+  cfg::Configuration Configuration;
+  layout::sugiyama::Orientation Orientation;
+};
+
+/// The smallest rectangle containing a laid out graph, with some padding.
+///
+/// \note the Y axis of the layout points upwards, while the one of the
+///       result points downwards, as in SVG
+struct Viewbox {
+  layout::Point TopLeft = { -1, -1 };
+  layout::Point BottomRight = { +1, +1 };
+};
+
+template<typename NodeData, typename EdgeData = Empty>
+inline Viewbox makeViewbox(const layout::OutputNode<NodeData, EdgeData> *Node) {
+  layout::Size HalfSize{ Node->Size.W / 2, Node->Size.H / 2 };
+  layout::Point TopLeft{ Node->Center.X - HalfSize.W,
+                         -Node->Center.Y - HalfSize.H };
+  layout::Point BottomRight{ Node->Center.X + HalfSize.W,
+                             -Node->Center.Y + HalfSize.H };
+  return Viewbox{ .TopLeft = std::move(TopLeft),
+                  .BottomRight = std::move(BottomRight) };
+}
+
+inline void expandViewbox(Viewbox &LHS, const Viewbox &RHS) {
+  if (RHS.TopLeft.X < LHS.TopLeft.X)
+    LHS.TopLeft.X = RHS.TopLeft.X;
+  if (RHS.TopLeft.Y < LHS.TopLeft.Y)
+    LHS.TopLeft.Y = RHS.TopLeft.Y;
+  if (RHS.BottomRight.X > LHS.BottomRight.X)
+    LHS.BottomRight.X = RHS.BottomRight.X;
+  if (RHS.BottomRight.Y > LHS.BottomRight.Y)
+    LHS.BottomRight.Y = RHS.BottomRight.Y;
+}
+
+inline void expandViewbox(Viewbox &Box, const layout::Point &Point) {
+  if (Box.TopLeft.X > Point.X)
+    Box.TopLeft.X = Point.X;
+  if (Box.TopLeft.Y > -Point.Y)
+    Box.TopLeft.Y = -Point.Y;
+  if (Box.BottomRight.X < Point.X)
+    Box.BottomRight.X = Point.X;
+  if (Box.BottomRight.Y < -Point.Y)
+    Box.BottomRight.Y = -Point.Y;
+}
+
+template<SpecializationOf<layout::OutputGraph> GraphType>
+Viewbox calculateViewbox(const GraphType &Graph) {
+  revng_assert(Graph.size() != 0);
+
+  // Ensure every node fits.
+  Viewbox Result = makeViewbox(*Graph.nodes().begin());
+  for (const auto *Node : Graph.nodes())
+    expandViewbox(Result, makeViewbox(Node));
+
+  // Ensure every edge point fits.
+  for (const auto *From : Graph.nodes())
+    for (const auto [To, Label] : From->successor_edges())
+      for (const auto &Point : Label->Path)
+        expandViewbox(Result, Point);
+
+  // Add some extra padding for a good measure.
+  Result.TopLeft.X -= 50;
+  Result.TopLeft.Y -= 50;
+  Result.BottomRight.X += 50;
+  Result.BottomRight.Y += 50;
+
+  return Result;
+}
+
+/// \return the name of the type of \p Edge, as exposed to the clients
+std::string_view edgeTypeAsString(const cfg::Edge &Edge);
+std::string_view edgeTypeAsString(const calls::Edge &Edge);
+
+LaidOutGraph<cfg::PostLayoutGraph>
+layOutControlFlowGraph(const yield::Function &InternalFunction,
+                       const model::Binary &Binary);
+
+LaidOutGraph<calls::PostLayoutGraph>
+layOutCallGraph(const crossrelations::CrossRelations &Relations,
+                const model::Binary &Binary);
+
+LaidOutGraph<calls::PostLayoutGraph>
+layOutCallGraphSlice(std::string_view SlicePoint,
+                     const calls::IndexedCallGraph &CallGraph,
+                     const model::Binary &Binary);
+
+} // namespace yield
@@ -15,11 +15,14 @@
 #include "revng/PTML/Constants.h"
 #include "revng/PTML/Tag.h"
 #include "revng/Pipeline/Location.h"
+#include "revng/Pipeline/LocationInterner.h"
 #include "revng/Pipes/Ranks.h"
 #include "revng/Yield/ControlFlow/FallthroughDetection.h"
 #include "revng/Yield/Function.h"
 #include "revng/Yield/PTML.h"
 
+using pipeline::InternedLocation;
+using pipeline::internedLocation;
 using pipeline::serializedLocation;
 using ptml::PTMLBuilder;
 using ptml::Tag;
@@ -44,26 +47,27 @@ static constexpr auto Instruction = "asm.instruction";
 
 } // namespace scopes
 
-static std::string targetPath(const BasicBlockID &Target,
-                              const yield::Function &Function,
-                              const model::Binary &Binary) {
+/// The same targets are referenced over and over, intern them
+static InternedLocation targetPath(const BasicBlockID &Target,
+                                   const yield::Function &Function,
+                                   const model::Binary &Binary) {
   if (const auto *F = yield::tryGetFunction(Binary, Target)) {
     // The target is a function
-    return serializedLocation(ranks::Function, F->Entry());
+    return internedLocation(ranks::Function, F->Entry());
   } else if (auto Iterator = Function.Blocks().find(Target);
              Iterator != Function.Blocks().end()) {
     // The target is a basic block
-    return serializedLocation(ranks::BasicBlock,
-                              Function.Entry(),
-                              Iterator->ID());
+    return internedLocation(ranks::BasicBlock,
+                            Function.Entry(),
+                            Iterator->ID());
   } else if (Target.isValid()) {
     for (const auto &Block : Function.Blocks()) {
       if (Block.Instructions().contains(Target.start())) {
         // The target is an instruction
-        return serializedLocation(ranks::Instruction,
-                                  Function.Entry(),
-                                  Block.ID(),
-                                  Target.start());
+        return internedLocation(ranks::Instruction,
+                                Function.Entry(),
+                                Block.ID(),
+                                Target.start());
       }
     }
   }
@@ -71,29 +75,40 @@ static std::string targetPath(const BasicBlockID &Target,
   revng_abort(("Unknown target:\n" + serializeToString(Target)).c_str());
 }
 
-static std::set<std::string> targets(const yield::BasicBlock &BasicBlock,
-                                     const yield::Function &Function,
-                                     const model::Binary &Binary) {
-  std::set<std::string> Result;
+/// \return the serialized locations of the targets of \p BasicBlock, sorted
+static llvm::SmallVector<llvm::StringRef, 2>
+targets(const yield::BasicBlock &BasicBlock,
+        const yield::Function &Function,
+        const model::Binary &Binary) {
+  llvm::SmallVector<InternedLocation, 2> Targets;
   for (const auto &Edge : BasicBlock.Successors()) {
     auto [NextAddress, MaybeCall] = efa::parseSuccessor(*Edge,
                                                         BasicBlock.nextBlock(),
                                                         Binary);
     if (NextAddress.isValid())
-      Result.emplace(targetPath(NextAddress, Function, Binary));
+      Targets.push_back(targetPath(NextAddress, Function, Binary));
 
     if (MaybeCall.isValid())
-      Result.emplace(targetPath(BasicBlockID(MaybeCall), Function, Binary));
+      Targets.push_back(targetPath(BasicBlockID(MaybeCall), Function, Binary));
   }
 
+  llvm::sort(Targets);
+  Targets.erase(std::unique(Targets.begin(), Targets.end()), Targets.end());
+
   // Explicitly remove the next target if there is only a single other target,
   // i.e. it's a conditional jump, call, etc.
-  if (Result.size() == 2) {
+  if (Targets.size() == 2) {
     auto NextBlock = targetPath(BasicBlock.nextBlock(), Function, Binary);
-    if (auto Iterator = llvm::find(Result, NextBlock); Iterator != Result.end())
-      Result.erase(Iterator);
+    llvm::erase_if(Targets, [NextBlock](InternedLocation Target) {
+      return Target == NextBlock;
+    });
   }
 
+  llvm::SmallVector<llvm::StringRef, 2> Result;
+  for (InternedLocation Target : Targets)
+    Result.push_back(Target.str());
+  llvm::sort(Result);
+
   return Result;
 }
 
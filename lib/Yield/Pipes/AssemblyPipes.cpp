@@ -2,6 +2,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
 #include "revng/EarlyFunctionAnalysis/ControlFlowGraph.h"
 #include "revng/EarlyFunctionAnalysis/ControlFlowGraphCache.h"
 #include "revng/Lift/LoadBinaryPass.h"
@@ -14,16 +21,30 @@
 #include "revng/Pipeline/RegisterPipe.h"
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/ModelGlobal.h"
+#include "revng/Yield/Assembly/DecodedInstructionCache.h"
 #include "revng/Yield/Assembly/DisassemblyHelper.h"
+#include "revng/Yield/ControlFlow/NodeSizeCalculation.h"
 #include "revng/Yield/Function.h"
 #include "revng/Yield/PTML.h"
 #include "revng/Yield/Pipes/ProcessAssembly.h"
+#include "revng/Yield/Pipes/ProcessedAssemblyCache.h"
 #include "revng/Yield/Pipes/YieldAssembly.h"
 
 using ptml::PTMLBuilder;
 
+static llvm::cl::opt<unsigned>
+  ProcessAssemblyThreads("process-assembly-threads",
+                         llvm::cl::desc("Number of threads disassembling "
+                                        "functions (0 means all the "
+                                        "available cores)"),
+                         llvm::cl::init(1));
+
 namespace revng::pipes {
 
+ProcessAssembly::ProcessAssembly() :
+  Decoded(std::make_shared<DecodedInstructionCache>()) {
+}
+
 void ProcessAssembly::run(pipeline::ExecutionContext &Context,
                           const BinaryFileContainer &SourceBinary,
                           const CFGMap &CFGMap,
@@ -40,21 +61,65 @@ void ProcessAssembly::run(pipeline::ExecutionContext &Context,
   revng_assert(MaybeBinary);
   const RawBinaryView &BinaryView = MaybeBinary->first;
 
-  // Define the helper object to store the disassembly pipeline.
-  // This allows it to only be created once.
-  DissassemblyHelper Helper;
+  std::vector<std::pair<MetaAddress, const std::string *>> Entries;
+  for (const auto &[Key, Serialized] : CFGMap)
+    Entries.emplace_back(std::get<0>(Key), &Serialized);
 
-  ControlFlowGraphCache Cache(CFGMap);
-  for (const auto &[Key, _] : CFGMap) {
-    MetaAddress Address = std::get<0>(Key);
-    const auto &Metadata = Cache.getControlFlowGraph(Address);
+  auto Disassemble = [&](DissassemblyHelper &Helper,
+                         const MetaAddress &Address,
+                         const efa::ControlFlowGraph &Metadata) {
     auto ModelFunctionIterator = Model->Functions().find(Address);
     revng_assert(ModelFunctionIterator != Model->Functions().end());
 
     const auto &Func = *ModelFunctionIterator;
     auto Disassembled = Helper.disassemble(Func, Metadata, BinaryView, *Model);
-    Output.insert_or_assign(Func.Entry(), serializeToString(Disassembled));
+    yield::cfg::precomputeTextSizes(Disassembled);
+    using yield::Function;
+    auto Result = std::make_shared<const Function>(std::move(Disassembled));
+    std::string Serialized = serializeToString(*Result);
+    ProcessedAssemblyCache::get().record(std::move(Result), Serialized);
+    return Serialized;
+  };
+
+  auto Strategy = llvm::hardware_concurrency(ProcessAssemblyThreads);
+  size_t ChunksCount = std::min<size_t>(Strategy.compute_thread_count(),
+                                        Entries.size());
+  if (ProcessAssemblyThreads == 1 or ChunksCount <= 1
+      or Model->isBeingTracked()) {
+    // Define the helper object to store the disassembly pipeline.
+    // This allows it to only be created once.
+    DissassemblyHelper Helper(Decoded.get());
+
+    ControlFlowGraphCache Cache(CFGMap);
+    for (const auto &[Address, _] : Entries) {
+      const auto &Metadata = Cache.getControlFlowGraph(Address);
+      Output.insert_or_assign(Address, Disassemble(Helper, Address, Metadata));
+    }
+    return;
+  }
+
+  // The disassembly pipeline is not thread-safe: each chunk has its own helper
+  // and deserializes the CFGs it needs on its own
+  std::vector<std::string> Results(Entries.size());
+  size_t ChunkSize = (Entries.size() + ChunksCount - 1) / ChunksCount;
+  llvm::ThreadPool Pool(Strategy);
+  for (size_t Chunk = 0; Chunk < ChunksCount; ++Chunk) {
+    Pool.async([&, Chunk]() {
+      DissassemblyHelper Helper(Decoded.get());
+      size_t End = std::min((Chunk + 1) * ChunkSize, Entries.size());
+      for (size_t I = Chunk * ChunkSize; I < End; ++I) {
+        const auto &[Address, Serialized] = Entries[I];
+        using CFGTree = TupleTree<efa::ControlFlowGraph>;
+        auto MaybeMetadata = CFGTree::deserialize(*Serialized);
+        revng_assert(MaybeMetadata);
+        Results[I] = Disassemble(Helper, Address, **MaybeMetadata);
+      }
+    });
   }
+  Pool.wait();
+
+  for (size_t I = 0; I < Entries.size(); ++I)
+    Output.insert_or_assign(Entries[I].first, std::move(Results[I]));
 }
 
 void YieldAssembly::run(pipeline::ExecutionContext &Context,
@@ -64,10 +129,13 @@ void YieldAssembly::run(pipeline::ExecutionContext &Context,
   const auto &Model = getModelFromContext(Context);
 
   PTMLBuilder B;
+  auto &Processed = ProcessedAssemblyCache::get();
+
+  // Read fields are collected for the whole run, so the first function using
+  // a prototype records the dependency on it on behalf of the others too
+  ptml::FunctionCommentCache Comments;
   for (auto [Address, S] : Input) {
-    auto MaybeFunction = TupleTree<yield::Function>::deserialize(S);
-    revng_assert(MaybeFunction && MaybeFunction->verify());
-    revng_assert((*MaybeFunction)->Entry() == std::get<0>(Address));
+    auto Function = Processed.load(std::get<0>(Address), S);
 
     const model::Function &ModelFunction = Model->Functions()
                                              .at(std::get<0>(Address));
@@ -78,10 +146,18 @@ void YieldAssembly::run(pipeline::ExecutionContext &Context,
                                           *Model,
                                           CommentIndicator,
                                           0,
-                                          80);
-    R += yield::ptml::functionAssembly(B, **MaybeFunction, *Model);
-    R = B.getTag(ptml::tags::Div, std::move(R)).serialize();
-    Output.insert_or_assign((*MaybeFunction)->Entry(), std::move(R));
+                                          80,
+                                          &Comments);
+    R += yield::ptml::functionAssembly(B, *Function, *Model);
+
+    // Wrap it in a div without copying it into the tag first
+    std::string Wrapped;
+    llvm::raw_string_ostream OS(Wrapped);
+    {
+      auto Scope = B.getTag(ptml::tags::Div).scope(OS);
+      OS << R;
+    }
+    Output.insert_or_assign(Function->Entry(), std::move(Wrapped));
   }
 }
 
@@ -2,6 +2,13 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+#include <vector>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+
 #include "revng/Model/Binary.h"
 #include "revng/Pipeline/Pipe.h"
 #include "revng/Pipeline/RegisterContainerFactory.h"
@@ -9,30 +16,88 @@
 #include "revng/Pipes/Kinds.h"
 #include "revng/Pipes/ModelGlobal.h"
 #include "revng/Yield/Function.h"
+#include "revng/Yield/LayoutData.h"
+#include "revng/Yield/Pipes/ProcessedAssemblyCache.h"
 #include "revng/Yield/Pipes/YieldControlFlow.h"
 #include "revng/Yield/SVG.h"
 
 using ptml::PTMLBuilder;
 
+static llvm::cl::opt<unsigned>
+  YieldCFGThreads("yield-cfg-threads",
+                  llvm::cl::desc("Number of threads laying out and rendering "
+                                 "control-flow graphs (0 means all the "
+                                 "available cores)"),
+                  llvm::cl::init(1));
+
 namespace revng::pipes {
 
-void YieldControlFlow::run(pipeline::ExecutionContext &Context,
-                           const FunctionAssemblyStringMap &Input,
-                           FunctionControlFlowStringMap &Output) {
+/// Renders each of the functions in \p Input with \p Render, possibly on
+/// multiple threads (see `-yield-cfg-threads`), and stores the results into
+/// \p Output
+template<typename OutputType, typename RenderType>
+static void renderEach(pipeline::ExecutionContext &Context,
+                       const FunctionAssemblyStringMap &Input,
+                       OutputType &Output,
+                       RenderType &&Render) {
   // Access the model
   const auto &Model = revng::getModelFromContext(Context);
-  ptml::PTMLBuilder B;
 
-  for (auto [Address, S] : Input) {
-    auto MaybeFunction = TupleTree<yield::Function>::deserialize(S);
-    revng_assert(MaybeFunction && MaybeFunction->verify());
-    revng_assert((*MaybeFunction)->Entry() == std::get<0>(Address));
+  std::vector<std::pair<MetaAddress, const std::string *>> Entries;
+  for (const auto &[Key, Serialized] : Input)
+    Entries.emplace_back(std::get<0>(Key), &Serialized);
+
+  auto &Processed = ProcessedAssemblyCache::get();
+  auto RenderOne = [&](const PTMLBuilder &B, const MetaAddress &Address,
+                       llvm::StringRef Serialized) {
+    auto Function = Processed.load(Address, Serialized);
+    return Render(B, *Function, *Model);
+  };
+
+  auto Strategy = llvm::hardware_concurrency(YieldCFGThreads);
+  size_t ChunksCount = std::min<size_t>(Strategy.compute_thread_count(),
+                                        Entries.size());
+  if (YieldCFGThreads == 1 or ChunksCount <= 1 or Model->isBeingTracked()) {
+    PTMLBuilder B;
+    for (const auto &[Address, Serialized] : Entries)
+      Output.insert_or_assign(Address, RenderOne(B, Address, *Serialized));
+    return;
+  }
 
-    Output.insert_or_assign((*MaybeFunction)->Entry(),
-                            yield::svg::controlFlowGraph(B,
-                                                         **MaybeFunction,
-                                                         *Model));
+  // Each chunk has its own builder, the layouts are independent
+  std::vector<std::string> Results(Entries.size());
+  size_t ChunkSize = (Entries.size() + ChunksCount - 1) / ChunksCount;
+  llvm::ThreadPool Pool(Strategy);
+  for (size_t Chunk = 0; Chunk < ChunksCount; ++Chunk) {
+    Pool.async([&, Chunk]() {
+      PTMLBuilder B;
+      size_t End = std::min((Chunk + 1) * ChunkSize, Entries.size());
+      for (size_t I = Chunk * ChunkSize; I < End; ++I) {
+        const auto &[Address, Serialized] = Entries[I];
+        Results[I] = RenderOne(B, Address, *Serialized);
+      }
+    });
   }
+  Pool.wait();
+
+  for (size_t I = 0; I < Entries.size(); ++I)
+    Output.insert_or_assign(Entries[I].first, std::move(Results[I]));
+}
+
+void YieldControlFlow::run(pipeline::ExecutionContext &Context,
+                           const FunctionAssemblyStringMap &Input,
+                           FunctionControlFlowStringMap &Output) {
+  renderEach(Context, Input, Output, yield::svg::controlFlowGraph);
+}
+
+void YieldControlFlowLayout::run(pipeline::ExecutionContext &Context,
+                                 const FunctionAssemblyStringMap &Input,
+                                 FunctionControlFlowLayoutStringMap &Output) {
+  auto Render = [](const PTMLBuilder &, const yield::Function &Function,
+                   const model::Binary &Binary) {
+    return yield::layoutdata::controlFlowGraph(Function, Binary);
+  };
+  renderEach(Context, Input, Output, Render);
 }
 
 } // end namespace revng::pipes
@@ -41,5 +106,9 @@ using namespace revng::pipes;
 using namespace pipeline;
 static RegisterDefaultConstructibleContainer<FunctionControlFlowStringMap>
   GraphContainer;
+static RegisterDefaultConstructibleContainer<
+  FunctionControlFlowLayoutStringMap>
+  LayoutContainer;
 
 static pipeline::RegisterPipe<revng::pipes::YieldControlFlow> CFGPipe;
+static pipeline::RegisterPipe<revng::pipes::YieldControlFlowLayout> LayoutPipe;
@@ -3,7 +3,6 @@
 //
 
 #include "revng/EarlyFunctionAnalysis/ControlFlowGraph.h"
-#include "revng/EarlyFunctionAnalysis/ControlFlowGraphCache.h"
 #include "revng/Model/Binary.h"
 #include "revng/Pipeline/Location.h"
 #include "revng/Pipeline/Pipe.h"
@@ -14,9 +13,12 @@
 #include "revng/Pipes/StringMap.h"
 #include "revng/Pipes/TupleTreeContainer.h"
 #include "revng/TupleTree/TupleTree.h"
+#include "revng/Yield/CallGraphs/CallGraphSlices.h"
 #include "revng/Yield/CrossRelations/CrossRelations.h"
 #include "revng/Yield/Generated/ForwardDecls.h"
+#include "revng/Yield/Pipes/CrossRelationsIndexContainer.h"
 #include "revng/Yield/Pipes/ProcessCallGraph.h"
+#include "revng/Yield/Pipes/ProcessCrossRelationsIndex.h"
 #include "revng/Yield/Pipes/YieldCallGraph.h"
 #include "revng/Yield/Pipes/YieldCallGraphSlice.h"
 #include "revng/Yield/SVG.h"
@@ -44,6 +46,26 @@ void ProcessCallGraph::run(pipeline::ExecutionContext &Context,
   OutputFile.emplace(Metadata, *Model);
 }
 
+using CRFileContainer = CrossRelationsFileContainer;
+void ProcessCrossRelationsIndex::run(pipeline::ExecutionContext &Context,
+                                     const CFGMap &CFGMap,
+                                     const CRFileContainer &Relations,
+                                     CrossRelationsIndexContainer &Output) {
+  if (Relations.empty())
+    return;
+
+  Output.emplace(*Relations.get());
+
+  // Only expose the functions whose control-flow graph has been requested
+  pipeline::TargetsList Missing;
+  for (const pipeline::Target &Target : Output.enumerate()) {
+    auto Entry = MetaAddress::fromString(Target.getPathComponents().back());
+    if (not CFGMap.contains(Entry))
+      Missing.push_back(Target);
+  }
+  Output.remove(Missing);
+}
+
 void YieldCallGraph::run(pipeline::ExecutionContext &Context,
                          const CrossRelationsFileContainer &Relations,
                          CallGraphSVGFileContainer &Output) {
@@ -65,22 +87,21 @@ void YieldCallGraphSlice::run(pipeline::ExecutionContext &Context,
   // Access the model
   const auto &Model = revng::getModelFromContext(Context);
 
-  // Access the llvm module
   PTMLBuilder B;
 
-  ControlFlowGraphCache Cache(CFGMap);
+  // Build the call graph once, each slice only visits the part it needs
+  yield::calls::IndexedCallGraph CallGraph(Relations.get()->toYieldGraph());
   for (const auto &[Key, _] : CFGMap) {
     MetaAddress Address = std::get<0>(Key);
-    auto &Metadata = Cache.getControlFlowGraph(Address);
-    revng_assert(llvm::is_contained(Model->Functions(), Metadata.Entry()));
+    revng_assert(llvm::is_contained(Model->Functions(), Address));
 
     // Slice the graph for the current function and convert it to SVG
     auto SlicePoint = pipeline::serializedLocation(revng::ranks::Function,
-                                                   Metadata.Entry());
+                                                   Address);
     Output.insert_or_assign(Address,
                             yield::svg::callGraphSlice(B,
                                                        SlicePoint,
-                                                       *Relations.get(),
+                                                       CallGraph,
                                                        *Model));
   }
 }
@@ -90,11 +111,13 @@ using namespace pipeline;
 static RegisterDefaultConstructibleContainer<CrossRelationsFileContainer> X1;
 static RegisterDefaultConstructibleContainer<CallGraphSVGFileContainer> X2;
 static RegisterDefaultConstructibleContainer<CallGraphSliceSVGStringMap> X3;
+static RegisterDefaultConstructibleContainer<CrossRelationsIndexContainer> X4;
 
 static pipeline::RegisterRole Role("binary-cross-relations",
                                    kinds::BinaryCrossRelationsRole);
 
 static pipeline::RegisterPipe<ProcessCallGraph> ProcessPipe;
+static pipeline::RegisterPipe<ProcessCrossRelationsIndex> ProcessIndexPipe;
 static pipeline::RegisterPipe<YieldCallGraph> YieldPipe;
 static pipeline::RegisterPipe<YieldCallGraphSlice> YieldSlicePipe;
 
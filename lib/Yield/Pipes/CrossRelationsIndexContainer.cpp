@@ -0,0 +1,181 @@
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/Support/SmallVectorMemoryBuffer.h"
+
+#include "revng/Pipeline/Location.h"
+#include "revng/Pipes/Ranks.h"
+#include "revng/Storage/Path.h"
+#include "revng/Storage/ReadableFile.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/TupleTree/TupleTree.h"
+#include "revng/Yield/Pipes/CrossRelationsIndexContainer.h"
+
+namespace revng::pipes {
+
+namespace CR = yield::crossrelations;
+
+using IndexContainer = CrossRelationsIndexContainer;
+
+static pipeline::Target targetOf(const CR::CrossRelationsIndex &Index,
+                                 uint32_t Node) {
+  namespace ranks = revng::ranks;
+  auto Location = pipeline::locationFromString(ranks::Function,
+                                               Index.location(Node));
+  revng_assert(Location.has_value());
+  MetaAddress Entry = Location->at(ranks::Function);
+  return pipeline::Target(Entry.toString(), kinds::CrossRelationsIndex);
+}
+
+void IndexContainer::emplace(const CR::CrossRelations &Relations) {
+  llvm::SmallVector<char, 0> Serialized;
+  llvm::raw_svector_ostream OS(Serialized);
+  CrossRelationsIndex::write(Relations, OS);
+
+  using llvm::SmallVectorMemoryBuffer;
+  auto Buffer = std::make_shared<SmallVectorMemoryBuffer>(std::move(Serialized),
+                                                          false);
+  llvm::cantFail(setStorage(std::move(Buffer)));
+}
+
+llvm::Error
+IndexContainer::setStorage(std::shared_ptr<const llvm::MemoryBuffer> Buffer) {
+  auto MaybeIndex = CrossRelationsIndex::fromBuffer(Buffer->getBuffer());
+  if (not MaybeIndex)
+    return MaybeIndex.takeError();
+
+  Storage = std::move(Buffer);
+  Index = *MaybeIndex;
+  Available.clear();
+  Available.resize(Index.size());
+  for (uint32_t Node = 0; Node < Index.size(); ++Node)
+    if (Index.isAvailable(Node))
+      Available.set(Node);
+
+  return llvm::Error::success();
+}
+
+std::optional<uint32_t>
+IndexContainer::findNode(const pipeline::Target &T) const {
+  revng_check(&T.getKind() == &kinds::CrossRelationsIndex);
+  if (empty())
+    return std::nullopt;
+
+  auto Entry = MetaAddress::fromString(T.getPathComponents().back());
+  auto Location = pipeline::serializedLocation(revng::ranks::Function, Entry);
+  auto Node = Index.find(Location);
+  if (not Node or not Available.test(*Node))
+    return std::nullopt;
+
+  return Node;
+}
+
+std::unique_ptr<pipeline::ContainerBase>
+IndexContainer::cloneFiltered(const pipeline::TargetsList &Targets) const {
+  auto Clone = std::make_unique<IndexContainer>(*this);
+  for (unsigned Node : Available.set_bits())
+    if (not Targets.contains(targetOf(Index, Node)))
+      Clone->Available.reset(Node);
+
+  return Clone;
+}
+
+pipeline::TargetsList IndexContainer::enumerate() const {
+  pipeline::TargetsList::List Result;
+  for (unsigned Node : Available.set_bits())
+    Result.push_back(targetOf(Index, Node));
+
+  return Result;
+}
+
+bool IndexContainer::remove(const pipeline::TargetsList &Targets) {
+  bool Changed = false;
+  for (const pipeline::Target &T : Targets) {
+    if (auto Node = findNode(T)) {
+      Available.reset(*Node);
+      Changed = true;
+    }
+  }
+
+  return Changed;
+}
+
+void IndexContainer::clear() {
+  Storage.reset();
+  Index = CrossRelationsIndex();
+  Available.clear();
+}
+
+void IndexContainer::mergeBackImpl(IndexContainer &&Other) {
+  if (Other.empty())
+    return;
+
+  // The index of Other is the most recent one, but the targets available here
+  // must remain available
+  if (not empty()) {
+    for (unsigned Node : Available.set_bits())
+      if (auto NewNode = Other.Index.find(Index.location(Node)))
+        Other.Available.set(*NewNode);
+  }
+
+  *this = std::move(Other);
+}
+
+llvm::Error IndexContainer::serialize(llvm::raw_ostream &OS) const {
+  if (empty())
+    return llvm::Error::success();
+
+  Index.write(OS, [this](uint32_t Node) { return Available.test(Node); });
+  return llvm::Error::success();
+}
+
+llvm::Error IndexContainer::deserialize(const llvm::MemoryBuffer &Buffer) {
+  if (Buffer.getBufferSize() == 0) {
+    clear();
+    return llvm::Error::success();
+  }
+
+  llvm::StringRef Identifier = Buffer.getBufferIdentifier();
+  auto Copy = llvm::MemoryBuffer::getMemBufferCopy(Buffer.getBuffer(),
+                                                   Identifier);
+  return setStorage(std::move(Copy));
+}
+
+llvm::Error IndexContainer::load(const revng::FilePath &Path) {
+  auto MaybeExists = Path.exists();
+  if (not MaybeExists)
+    return MaybeExists.takeError();
+
+  if (not MaybeExists.get()) {
+    clear();
+    return llvm::Error::success();
+  }
+
+  auto MaybeFile = Path.getReadableFile();
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+
+  std::shared_ptr<revng::ReadableFile> File = std::move(MaybeFile.get());
+  if (File->buffer().getBufferSize() == 0) {
+    clear();
+    return llvm::Error::success();
+  }
+
+  // Query the file in place, keeping it alive as long as the index is used
+  using SharedBuffer = std::shared_ptr<const llvm::MemoryBuffer>;
+  return setStorage(SharedBuffer(File, &File->buffer()));
+}
+
+llvm::Error IndexContainer::extractOne(llvm::raw_ostream &OS,
+                                       const pipeline::Target &Target) const {
+  auto Node = findNode(Target);
+  revng_check(Node.has_value());
+
+  TupleTree<CR::CrossRelations> Result;
+  *Result = Index.relationsOf(*Node);
+  Result.serialize(OS);
+  return llvm::Error::success();
+}
+
+} // namespace revng::pipes
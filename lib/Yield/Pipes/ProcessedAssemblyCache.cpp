@@ -0,0 +1,74 @@
+/// \file ProcessedAssemblyCache.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include "llvm/ADT/Hashing.h"
+
+#include "revng/Support/Assert.h"
+#include "revng/Yield/ControlFlow/NodeSizeCalculation.h"
+#include "revng/Yield/Pipes/ProcessedAssemblyCache.h"
+
+namespace revng::pipes {
+
+ProcessedAssemblyCache &ProcessedAssemblyCache::get() {
+  static ProcessedAssemblyCache Instance;
+  return Instance;
+}
+
+using PAC = ProcessedAssemblyCache;
+void PAC::record(std::shared_ptr<const yield::Function> Function,
+                 llvm::StringRef Serialized) {
+  revng_assert(Function != nullptr);
+  MetaAddress Entry = Function->Entry();
+  uint64_t Hash = llvm::hash_value(Serialized);
+
+  CachedFunction New{ Hash, Serialized.str(), std::move(Function) };
+
+  std::lock_guard Lock(Mutex);
+  bool Inserted = Entries.insert_or_assign(Entry, std::move(New)).second;
+  if (not Inserted)
+    return;
+
+  InsertionOrder.push_back(Entry);
+  if (InsertionOrder.size() > MaximumSize) {
+    // Drop the oldest entry
+    size_t Erased = Entries.erase(InsertionOrder.front());
+    revng_assert(Erased == 1);
+    InsertionOrder.pop_front();
+  }
+}
+
+std::shared_ptr<const yield::Function>
+ProcessedAssemblyCache::load(const MetaAddress &Entry,
+                             llvm::StringRef Serialized) {
+  uint64_t Hash = llvm::hash_value(Serialized);
+  {
+    std::lock_guard Lock(Mutex);
+    auto It = Entries.find(Entry);
+    if (It != Entries.end() and It->second.Hash == Hash
+        and It->second.Serialized == Serialized) {
+      // It was verified before being recorded
+      return It->second.Function;
+    }
+  }
+
+  auto MaybeFunction = TupleTree<yield::Function>::deserialize(Serialized);
+  revng_assert(MaybeFunction && MaybeFunction->verify());
+  revng_assert((*MaybeFunction)->Entry() == Entry);
+
+  yield::cfg::precomputeTextSizes(**MaybeFunction);
+  using yield::Function;
+  auto Result = std::make_shared<const Function>(std::move(**MaybeFunction));
+  record(Result, Serialized);
+  return Result;
+}
+
+void ProcessedAssemblyCache::clear() {
+  std::lock_guard Lock(Mutex);
+  Entries.clear();
+  InsertionOrder.clear();
+}
+
+} // namespace revng::pipes
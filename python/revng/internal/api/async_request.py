@@ -0,0 +1,46 @@
+#
+# This file is distributed under the MIT License. See LICENSE.md for details.
+#
+
+import time
+from typing import Any, Callable, Generic, Optional, TypeVar
+
+from ._capi import _api
+from .errors import Error, Expected
+from .utils import make_python_string
+
+T = TypeVar("T")
+
+
+class AsyncRequest(Generic[T]):
+    """A request running in background. The manager that started it must not
+    be used until the request completes."""
+
+    def __init__(self, request, finalize: Callable[[Any], T]):
+        self._request = request
+        self._finalize = finalize
+        self._result: Optional[Expected[T]] = None
+
+    def cancel(self):
+        _api.rp_async_request_cancel(self._request)
+
+    def is_completed(self) -> bool:
+        return _api.rp_async_request_is_completed(self._request)
+
+    def progress(self) -> str:
+        return make_python_string(_api.rp_async_request_get_progress(self._request))
+
+    def wait(self, poll_interval: float = 0.1) -> Expected[T]:
+        # All the API calls share a lock: blocking in rp_async_request_wait
+        # would prevent other threads from cancelling the request
+        while not self.is_completed():
+            time.sleep(poll_interval)
+
+        if self._result is None:
+            error = Error()
+            if _api.rp_async_request_wait(self._request, error._error):
+                self._result = Expected(self._finalize(self._request), error)
+            else:
+                self._result = Expected(None, error)
+
+        return self._result
@@ -10,6 +10,7 @@ import yaml
 from revng.pipeline_description import YamlLoader  # type: ignore
 
 from ._capi import _api, ffi
+from .async_request import AsyncRequest
 from .errors import Error, Expected
 from .exceptions import RevngException
 from .invalidations import Invalidations, ResultWithInvalidations
@@ -55,6 +56,15 @@ class Manager:
     def save(self):
         return _api.rp_manager_save(self._manager)
 
+    def save_async(self):
+        return _api.rp_manager_save_async(self._manager)
+
+    def is_saving(self) -> bool:
+        return _api.rp_manager_is_saving(self._manager)
+
+    def wait_save(self):
+        return _api.rp_manager_wait_save(self._manager)
+
     # description utilities
 
     def kind_from_name(self, name: str):
@@ -123,6 +133,52 @@ class Manager:
         container_name: Optional[str] = None,
         only_if_ready=False,
     ) -> Dict[str, str | bytes] | Error:
+        _step, _container, targets = self._prepare_production(
+            step_name, target, container_name, only_if_ready
+        )
+        error = Error()
+        product = _api.rp_manager_produce_targets(
+            self._manager,
+            _step,
+            _container,
+            len(targets),
+            [t._target for t in targets],
+            error._error,
+        )
+
+        if product == ffi.NULL:
+            return error
+
+        return self._extract_targets(targets)
+
+    def produce_target_async(
+        self,
+        step_name: str,
+        target: None | str | List[str],
+        container_name: Optional[str] = None,
+        only_if_ready=False,
+    ) -> AsyncRequest[Dict[str, str | bytes]]:
+        """Like produce_target, but the production runs in background. The
+        manager must not be used until the returned request completes."""
+        _step, _container, targets = self._prepare_production(
+            step_name, target, container_name, only_if_ready
+        )
+        request = _api.rp_manager_produce_targets_async(
+            self._manager,
+            _step,
+            _container,
+            len(targets),
+            [t._target for t in targets],
+        )
+        return AsyncRequest(request, lambda _: self._extract_targets(targets))
+
+    def _prepare_production(
+        self,
+        step_name: str,
+        target: None | str | List[str],
+        container_name: Optional[str],
+        only_if_ready: bool,
+    ):
         step = self.step_from_name(step_name)
         if step is None:
             raise RevngException(f"Invalid step {step_name}")
@@ -151,19 +207,9 @@ class Manager:
             raise RevngException("Requested production of unready targets")
 
         _step, _container = self._get_step_container_ptr(step_name, container)
-        error = Error()
-        product = _api.rp_manager_produce_targets(
-            self._manager,
-            _step,
-            _container,
-            len(targets),
-            [t._target for t in targets],
-            error._error,
-        )
-
-        if product == ffi.NULL:
-            return error
+        return _step, _container, targets
 
+    def _extract_targets(self, targets: List[Target]) -> Dict[str, str | bytes]:
         result = {}
         for produced_target in targets:
             extracted_target = produced_target.extract()
@@ -172,6 +218,36 @@ class Manager:
             result[produced_target.serialize()] = extracted_target
         return result
 
+    def produce_targets(
+        self, requests: Mapping[str, Mapping[str, List[str]]]
+    ) -> Dict[str, Dict[str, Dict[str, str | bytes]]] | Error:
+        """Produce, at once, the serialized targets requested for each container
+        of each step, mapped as step -> container -> targets"""
+        batch = ffi.gc(_api.rp_production_batch_create(), _api.rp_production_batch_destroy)
+
+        targets: Dict[str, Dict[str, List[Target]]] = {}
+        for step_name, containers in requests.items():
+            for container_name, serialized_targets in containers.items():
+                _step, _container = self._get_step_container_ptr(step_name, container_name)
+                container_targets = targets.setdefault(step_name, {}).setdefault(
+                    container_name, []
+                )
+                for serialized_target in serialized_targets:
+                    target = self.create_target(step_name, container_name, serialized_target, False)
+                    _api.rp_production_batch_add(batch, _step, _container, target._target)
+                    container_targets.append(target)
+
+        error = Error()
+        if not _api.rp_manager_produce_batch(self._manager, batch, error._error):
+            return error
+
+        result: Dict[str, Dict[str, Dict[str, str | bytes]]] = {}
+        for step_name, containers_targets in targets.items():
+            for container_name, produced_targets in containers_targets.items():
+                step_result = result.setdefault(step_name, {})
+                step_result[container_name] = self._extract_targets(produced_targets)
+        return result
+
     def create_target(
         self, step_name: str, container_name: str, target_path: str, use_artifact_kind: bool
     ) -> Target:
@@ -318,6 +394,29 @@ class Manager:
             error,
         )
 
+    def run_analyses_list_async(
+        self, analyses_list_name: str, options: Mapping[str, str] | None = None
+    ) -> AsyncRequest[ResultWithInvalidations[Dict[str, str]]]:
+        """Like run_analyses_list, but the analyses run in background. The
+        manager must not be used until the returned request completes."""
+        if self.analyses_list_from_name(analyses_list_name) is None:
+            raise RevngException(f"Could not find analyses list {analyses_list_name}")
+
+        options_map = StringMap(options)
+        invalidations = Invalidations()
+        request = _api.rp_manager_run_analyses_list_async(
+            self._manager,
+            make_c_string(analyses_list_name),
+            options_map._string_map,
+            invalidations._invalidations,
+        )
+
+        def finalize(_request) -> ResultWithInvalidations[Dict[str, str]]:
+            diff_map = _api.rp_async_request_take_diff_map(_request)
+            return ResultWithInvalidations(self.parse_diff_map(diff_map), invalidations)
+
+        return AsyncRequest(request, finalize)
+
     def parse_diff_map(self, diff_map) -> Dict[str, str]:
         result = {}
         for global_name in self.description.Globals:
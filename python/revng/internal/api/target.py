@@ -54,7 +54,8 @@ class Target:
         return make_python_string(_serialized)
 
     def extract(self) -> str | bytes | None:
-        _buffer = _api.rp_container_extract_one(self._container, self._target)
+        # The buffer is consumed right away, so it can point into the container
+        _buffer = _api.rp_container_extract_one_view(self._container, self._target)
         if _buffer == ffi.NULL:
             return None
         size = _api.rp_buffer_size(_buffer)
@@ -62,6 +63,23 @@ class Target:
         _mime = _api.rp_container_get_mime(self._container)
         return convert_buffer(data, size, make_python_string(_mime))
 
+    def extract_lines(self, first_line: int, line_count: int) -> str | bytes | None:
+        """Extract only the given range of lines, for artifacts too large to be
+        fetched all at once"""
+        _buffer = _api.rp_container_extract_lines_view(
+            self._container, self._target, first_line, line_count
+        )
+        if _buffer == ffi.NULL:
+            return None
+        size = _api.rp_buffer_size(_buffer)
+        data = _api.rp_buffer_data(_buffer)
+        _mime = _api.rp_container_get_mime(self._container)
+        return convert_buffer(data, size, make_python_string(_mime))
+
+    @property
+    def line_count(self) -> int:
+        return _api.rp_container_get_line_count(self._container, self._target)
+
     def as_dict(self):
         return {
             "serialized": self.serialize(),
@@ -35,8 +35,9 @@ def convert_buffer(ptr: ffi.CData, size: int, mime: str) -> str | bytes:
     if ptr == ffi.NULL:
         return b""
 
-    data = ffi.unpack(ptr, size)
+    # Decode straight from the buffer, without an intermediate bytes object
+    data = ffi.buffer(ptr, size)
     if mime.startswith("text/") or mime == "image/svg":
-        return data.decode("utf-8")
+        return str(data, "utf-8")
     else:
-        return data
+        return data[:]
@@ -0,0 +1,182 @@
+#
+# This file is distributed under the MIT License. See LICENSE.md for details.
+#
+
+# This command runs the main stages of the pipeline over a corpus of binaries,
+# recording for each stage the wall time, the peak resident set size and the
+# size of what it produced. The results can be compared against the ones of a
+# previous run, in which case any metric that grew more than the threshold is
+# reported as a regression.
+
+import json
+import os
+import sys
+import time
+from dataclasses import dataclass, field
+from pathlib import Path
+from tempfile import TemporaryDirectory
+from typing import Dict, List
+
+from revng.internal.cli.commands_registry import Command, CommandsRegistry, Options
+from revng.internal.cli.support import build_command_with_loads, interleave, log_error, popen
+from revng.internal.support.collect import collect_pipelines
+
+
+@dataclass
+class Stage:
+    name: str
+    tool: str
+    target: str
+    arguments: List[str] = field(default_factory=list)
+
+
+# The stages are run in order on the same resume directory, each one building
+# on the results of the previous ones
+stages = [
+    Stage("import", "analyze", "import-binary"),
+    # The same import, parsing the DWARF compile units on all the cores
+    Stage("import-parallel-dwarf", "analyze", "import-binary", ["--dwarf-import-threads=0"]),
+    Stage("lift", "artifact", "lift"),
+    Stage("detect-abi", "analyze", "detect-abi"),
+    Stage("isolate", "artifact", "isolate"),
+    Stage("disassemble", "artifact", "disassemble"),
+    Stage("render-svg-cfg", "artifact", "render-svg-cfg"),
+]
+
+# Metrics below these values are too noisy to be compared
+noise_floor = {"wall-time": 0.5, "peak-rss-kb": 16 * 1024, "output-size": 0}
+
+Results = Dict[str, Dict[str, Dict[str, float]]]
+
+
+def collect_corpus(paths: List[str]) -> List[Path]:
+    result = []
+    for path in map(Path, paths):
+        if path.is_dir():
+            result += sorted(entry for entry in path.rglob("*") if entry.is_file())
+        else:
+            result.append(path)
+    return result
+
+
+def run_stage(stage: Stage, binary: Path, work_dir: Path, options: Options) -> Dict[str, float]:
+    output = work_dir / stage.name
+    pipelines = collect_pipelines(options.search_prefixes)
+    arguments = interleave(pipelines, "-P") + stage.arguments + [
+        f"--resume={work_dir / 'resume'}",
+        stage.target,
+        str(binary),
+        "-o",
+        str(output),
+    ]
+    command = build_command_with_loads(f"revng-{stage.tool}", arguments, options)
+
+    start = time.monotonic()
+    process = popen(command, options)
+    if isinstance(process, int):
+        return {}
+
+    # Use wait4 so that the peak RSS is the one of this process alone
+    _, status, usage = os.wait4(process.pid, 0)
+    wall_time = time.monotonic() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    if process.returncode != 0:
+        raise RuntimeError(f"{stage.name} failed on {binary} ({process.returncode})")
+
+    return {
+        "wall-time": wall_time,
+        "peak-rss-kb": usage.ru_maxrss,
+        "output-size": output.stat().st_size if output.exists() else 0,
+    }
+
+
+def run_binary(binary: Path, repetitions: int, options: Options) -> Dict[str, Dict[str, float]]:
+    result: Dict[str, Dict[str, float]] = {}
+    for _ in range(repetitions):
+        with TemporaryDirectory(prefix="revng-bench-") as work_dir:
+            for stage in stages:
+                metrics = run_stage(stage, binary, Path(work_dir), options)
+                if stage.name not in result:
+                    result[stage.name] = metrics
+                    continue
+
+                # Keep the best run, the others were slowed down by noise
+                best = result[stage.name]
+                for key, value in metrics.items():
+                    best[key] = min(best[key], value)
+    return result
+
+
+def compare(results: Results, baseline: Results, threshold: float) -> List[str]:
+    regressions = []
+    for binary, binary_stages in results.items():
+        for stage, metrics in binary_stages.items():
+            reference = baseline.get(binary, {}).get(stage, {})
+            for key, value in metrics.items():
+                if key not in reference or reference[key] < noise_floor.get(key, 0):
+                    continue
+
+                limit = reference[key] * (1 + threshold)
+                if value > limit:
+                    regressions.append(
+                        f"{binary}: {stage}: {key} went from {reference[key]:g} to {value:g}"
+                    )
+    return regressions
+
+
+class BenchCommand(Command):
+    def __init__(self):
+        super().__init__(("bench",), "Measure the main pipeline stages on a corpus of binaries")
+
+    def register_arguments(self, parser):
+        parser.add_argument(
+            "corpus", nargs="+", help="Binaries, or directories containing them, to run on."
+        )
+        parser.add_argument(
+            "-o", "--output", default="-", help="Where to write the results, as JSON."
+        )
+        parser.add_argument("--baseline", help="Results of a previous run to compare against.")
+        parser.add_argument(
+            "--threshold",
+            type=float,
+            default=0.1,
+            help="Relative growth of a metric reported as a regression (default: 0.1).",
+        )
+        parser.add_argument(
+            "--repetitions",
+            type=int,
+            default=1,
+            help="Run each binary this many times and keep the best figures.",
+        )
+
+    def run(self, options: Options):
+        args = options.parsed_args
+
+        results: Results = {}
+        for binary in collect_corpus(args.corpus):
+            log_error(f"Running on {binary}")
+            try:
+                results[str(binary)] = run_binary(binary, args.repetitions, options)
+            except RuntimeError as error:
+                log_error(str(error))
+                return 1
+
+        serialized = json.dumps({"binaries": results}, indent=2, sort_keys=True) + "\n"
+        if args.output == "-":
+            sys.stdout.write(serialized)
+        else:
+            Path(args.output).write_text(serialized)
+
+        if args.baseline is None:
+            return 0
+
+        baseline = json.loads(Path(args.baseline).read_text())["binaries"]
+        regressions = compare(results, baseline, args.threshold)
+        for regression in regressions:
+            log_error(regression)
+
+        return 1 if len(regressions) > 0 else 0
+
+
+def setup(commands_registry: CommandsRegistry):
+    commands_registry.register_command(BenchCommand())
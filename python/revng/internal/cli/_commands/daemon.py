@@ -35,6 +35,8 @@ REVNG_NOTIFY_FIFOS: list of fifo pipes to be notified of changes in the pipeline
 REVNG_ORIGINS: comma-separated list of allowed CORS origins
 REVNG_EXPOSE_HEADERS: comma-separated list of response headers to expose via CORS
 REVNG_C_API_TRACE_PATH: path to file to use to save api tracing, useful for debugging
+REVNG_C_API_TRACE_FORMAT: format of the api tracing, either yaml (default) or binary
+REVNG_C_API_METRICS: if set, /metrics also reports the duration of the api calls
 
 Persistence:
 If the REVNG_DATA_DIR environment variable is set, the the data is persisted across
@@ -2,11 +2,49 @@
 # This file is distributed under the MIT License. See LICENSE.md for details.
 #
 
+import os
+import socket
+import sys
+from typing import List, Optional
+
 from revng.internal.cli.commands_registry import Command, CommandsRegistry, Options
 from revng.internal.cli.support import build_command_with_loads, interleave, run
 from revng.internal.support.collect import collect_pipelines
 
 
+# Tools that revng-pipeline-server can run on behalf of the client
+server_tools = ("artifact", "analyze")
+
+# Exit code of revng-pipeline-server meaning that the tool must be run instead
+server_unsupported = 2
+
+
+def run_on_server(socket_path: str, tool: str, args: List[str]) -> Optional[int]:
+    """Run the tool on the revng-pipeline-server listening on socket_path.
+    Returns the exit code, or None if the tool must be run instead."""
+    fields = [tool, os.getcwd(), *args]
+    request = b"".join(field.encode("utf-8") + b"\0" for field in [str(len(fields)), *fields])
+
+    with socket.socket(socket.AF_UNIX, socket.SOCK_STREAM) as connection:
+        try:
+            connection.connect(socket_path)
+        except OSError:
+            return None
+
+        connection.sendall(request)
+        with connection.makefile("rb") as reply:
+            status = int(reply.readline())
+            output = reply.read()
+
+    if status == server_unsupported:
+        return None
+
+    stream = sys.stdout if status == 0 else sys.stderr
+    stream.buffer.write(output)
+    stream.flush()
+    return status
+
+
 class PipelineToolCommand(Command):
     def __init__(self, name: str, description: str):
         super().__init__((name,), description, False)
@@ -15,6 +53,15 @@ class PipelineToolCommand(Command):
         pass
 
     def run(self, options: Options):
+        server = os.environ.get("REVNG_PIPELINE_SERVER")
+        use_server = server is not None and self.name in server_tools
+        if use_server and not options.dry_run and len(options.command_prefix) == 0:
+            result = run_on_server(server, self.name, options.remaining_args)
+            if result is not None:
+                if result != 0:
+                    sys.exit(result)
+                return result
+
         pipelines = collect_pipelines(options.search_prefixes)
         pipelines_args = interleave(pipelines, "-P")
         command = build_command_with_loads(
@@ -30,3 +77,9 @@ def setup(commands_registry: CommandsRegistry):
     commands_registry.register_command(PipelineToolCommand("invalidate", "revng invalidate"))
     commands_registry.register_command(PipelineToolCommand("pipeline", "revng pipeline"))
     commands_registry.register_command(PipelineToolCommand("pipe", "revng pipe"))
+    commands_registry.register_command(
+        PipelineToolCommand(
+            "pipeline-server",
+            "revng pipeline server, set REVNG_PIPELINE_SERVER to its socket to use it",
+        )
+    )
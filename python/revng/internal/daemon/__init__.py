@@ -27,8 +27,10 @@ from ariadne.asgi.handlers import GraphQLHTTPHandler, GraphQLTransportWSHandler
 from ariadne.contrib.tracing.apollotracing import ApolloTracingExtension
 
 from revng.internal.api import Manager
+from revng.internal.api._capi import _api
 from revng.internal.api._capi import initialize as capi_initialize
 from revng.internal.api._capi import shutdown as capi_shutdown
+from revng.internal.api.utils import make_python_string
 
 from .event_manager import EventManager
 from .graphql import get_schema
@@ -147,6 +149,12 @@ def make_startlette() -> Starlette:
         else:
             return PlainTextResponse("KO", 503)
 
+    async def metrics(request):
+        return PlainTextResponse(
+            make_python_string(_api.rp_get_metrics()),
+            media_type="application/openmetrics-text; version=1.0.0; charset=utf-8",
+        )
+
     def generate_context(request: Request):
         return {
             "manager": manager,
@@ -161,6 +169,7 @@ def make_startlette() -> Starlette:
     routes = [
         Route("/", index_page, methods=["GET"]),
         Route("/status", status, methods=["GET"]),
+        Route("/metrics", metrics, methods=["GET"]),
         Mount(
             "/graphql",
             GraphQL(
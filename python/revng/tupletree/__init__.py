@@ -7,8 +7,8 @@ from collections.abc import MutableSequence
 from dataclasses import dataclass, fields
 from enum import Enum, EnumType
 from functools import lru_cache
-from typing import Any, Callable, Dict, Generic, List, Type, TypeVar, get_args, get_origin
-from typing import get_type_hints
+from typing import Any, Callable, Dict, Generic, List, Optional, Type, TypeVar, get_args
+from typing import get_origin, get_type_hints
 
 import yaml
 
@@ -29,14 +29,14 @@ if sys.version_info >= (3, 10, 0):
     dataclass_kwargs["kw_only"] = True
 
 
-def _create_instance(field_value, field_type):
+def _create_instance(field_value, field_type, lazy=False):
     # First we check if the value is already of the required type
     if isinstance(field_value, field_type):
         return field_value
     if isinstance(field_value, str) and issubclass(field_type, Enum):
         return field_type(field_value)
     if isinstance(field_value, dict) and issubclass(field_type, StructBase):
-        return field_type.from_dict(**field_value)
+        return field_type._from_mapping(field_value, lazy)
     if isinstance(field_value, str) and hasattr(field_type, "from_string"):
         return field_type.from_string(field_value)
 
@@ -50,15 +50,119 @@ def get_type_hint_cached(class_, name):
     return get_type_hints(class_)[name]
 
 
+# Must match include/revng/TupleTree/Binary.h
+BINARY_MAGIC = b"RVNGTTB"
+BINARY_VERSION = 1
+_TAG_FALSE, _TAG_TRUE, _TAG_UNSIGNED, _TAG_SIGNED = range(4)
+_TAG_STRING, _TAG_SEQUENCE, _TAG_MAPPING, _TAG_KIND = range(4, 8)
+
+
+def is_binary(data: bytes) -> bool:
+    """Returns True if data is a tuple tree in the binary format"""
+    return data.startswith(BINARY_MAGIC)
+
+
+def load_binary(data: bytes):
+    """Decodes a tuple tree in the binary format into the same dicts, lists and
+    scalars the YAML loader would produce"""
+    if not is_binary(data) or len(data) <= len(BINARY_MAGIC):
+        raise ValueError("Not a binary tuple tree")
+    if data[len(BINARY_MAGIC)] != BINARY_VERSION:
+        raise ValueError(f"Unsupported binary tuple tree version {data[len(BINARY_MAGIC)]}")
+
+    offset = len(BINARY_MAGIC) + 1
+    strings: List[str] = []
+
+    def read_leb128(signed: bool) -> int:
+        nonlocal offset
+        result = 0
+        shift = 0
+        while True:
+            if offset >= len(data):
+                raise ValueError("Unexpected end of the binary tuple tree")
+            byte = data[offset]
+            offset += 1
+            result |= (byte & 0x7F) << shift
+            shift += 7
+            if byte & 0x80 == 0:
+                break
+        if signed and byte & 0x40:
+            result -= 1 << shift
+        return result
+
+    def read_string() -> str:
+        nonlocal offset
+        index = read_leb128(False)
+        if index != 0:
+            if index > len(strings):
+                raise ValueError(f"Unknown string {index} at offset {offset}")
+            return strings[index - 1]
+        size = read_leb128(False)
+        if offset + size > len(data):
+            raise ValueError("String past the end of the binary tuple tree")
+        result = data[offset : offset + size].decode("utf-8")
+        offset += size
+        strings.append(result)
+        return result
+
+    def read_mapping() -> Dict[str, Any]:
+        result = {}
+        for _ in range(read_leb128(False)):
+            key = read_string()
+            result[key] = read_value()
+        return result
+
+    def read_value():
+        nonlocal offset
+        if offset >= len(data):
+            raise ValueError("Unexpected end of the binary tuple tree")
+        tag = data[offset]
+        offset += 1
+        if tag == _TAG_FALSE:
+            return False
+        if tag == _TAG_TRUE:
+            return True
+        if tag == _TAG_UNSIGNED:
+            return read_leb128(False)
+        if tag == _TAG_SIGNED:
+            return read_leb128(True)
+        if tag == _TAG_STRING:
+            return read_string()
+        if tag == _TAG_SEQUENCE:
+            return [read_value() for _ in range(read_leb128(False))]
+        if tag == _TAG_MAPPING:
+            return read_mapping()
+        if tag == _TAG_KIND:
+            # The mapping of a concrete type also carries its Kind field
+            read_string()
+            if offset >= len(data) or data[offset] != _TAG_MAPPING:
+                raise ValueError(f"Expected a mapping at offset {offset}")
+            offset += 1
+            return read_mapping()
+        raise ValueError(f"Unknown tag {tag} at offset {offset - 1}")
+
+    result = read_value()
+    if offset != len(data):
+        raise ValueError("Trailing data after the binary tuple tree")
+    return result
+
+
 @dataclass
 class StructBase:
     @classmethod
     def from_dict(cls, **kwargs):
         """Constructs an instance of the object using the values supplied as kwargs"""
+        return cls._from_mapping(kwargs, False)
+
+    @classmethod
+    def _from_mapping(cls, mapping, lazy):
+        """Constructs an instance of the object from a mapping of its fields. If lazy is True, the
+        elements of list fields are constructed upon first access to the list (see LazyTypedList)
+        """
         constructor_kwargs = {}
 
         # Iterate over all the fields defined in the dataclass
-        for field_name, field_value in kwargs.items():
+        for field_name, field_value in mapping.items():
             field_spec = cls.__dataclass_fields__.get(field_name)
             if field_spec is None:
                 raise ValueError(f"Field {field_name} is not allowed for type {cls.__name__}")
@@ -81,6 +185,10 @@ class StructBase:
                         + f"got {type(field_value)}"
                     )
 
+                if lazy:
+                    constructor_kwargs[field_name] = LazyTypedList(underlying_type, field_value)
+                    continue
+
                 instances = []
                 for v in field_value:
                     try:
@@ -108,6 +216,14 @@ class StructBase:
         instance = cls(**constructor_kwargs)
         return instance
 
+    @classmethod
+    def from_binary(cls, data: bytes, lazy: bool = False):
+        """Constructs an instance of the object from the binary format. If lazy is True, the
+        objects in a list (e.g., the TypeDefinitions of a Binary) are constructed only when the list
+        is first accessed, for scripts that only inspect part of a large tree. Errors in the
+        elements of a list are then raised upon access."""
+        return cls._from_mapping(load_binary(data), lazy)
+
     @classmethod
     def from_string(cls, s):
         raise NotImplementedError(f"from_string not implemented for {cls.__name__}")
@@ -146,6 +262,8 @@ class StructBase:
             field_hints = get_type_hint_cached(self.__class__, field.name)
             if field_value is no_default:
                 raise TypeError(f"__init__ missing 1 required argument: {field.name}")
+            if isinstance(field_value, LazyTypedList):
+                continue
             if get_origin(field_hints) is list:
                 new_field_value = TypedList(get_args(field_hints)[0])
                 new_field_value.extend(field_value)
@@ -162,18 +280,18 @@ class AbstractStructBase(StructBase):
     _children: Dict[str, Type] = {}
 
     @classmethod
-    def from_dict(cls, **kwargs):
-        if "Kind" not in kwargs:
+    def _from_mapping(cls, mapping, lazy):
+        if "Kind" not in mapping:
             raise ValueError("Upcastable types must have a Kind field")
 
-        child_cls = cls._children.get(kwargs["Kind"])
+        child_cls = cls._children.get(mapping["Kind"])
 
         if not child_cls:
-            raise ValueError(f"No class found to deserialize {kwargs['Kind']}")
+            raise ValueError(f"No class found to deserialize {mapping['Kind']}")
 
         if cls != child_cls:
-            return child_cls.from_dict(**kwargs)
-        return super().from_dict(**kwargs)
+            return child_cls._from_mapping(mapping, lazy)
+        return super()._from_mapping(mapping, lazy)
 
 
 class DefaultEnumType(EnumType):
@@ -318,7 +436,34 @@ class TypedList(MutableSequence):
             return self._data == other
 
 
+class LazyTypedList(TypedList):
+    """A TypedList holding the raw (dict) representation of its elements, which are constructed,
+    lazily as well, upon the first access to the list other than len()"""
+
+    def __init__(self, base_class: type, raw: List[Any]):
+        super().__init__(base_class)
+        self._raw: Optional[List[Any]] = raw
+
+    @property  # type: ignore
+    def _data(self) -> List[Any]:
+        if self._raw is not None:
+            self._materialized = [_create_instance(v, self._base_class, True) for v in self._raw]
+            self._raw = None
+        return self._materialized
+
+    @_data.setter
+    def _data(self, value: List[Any]):
+        self._raw = None
+        self._materialized = value
+
+    def __len__(self) -> int:
+        if self._raw is not None:
+            return len(self._raw)
+        return len(self._materialized)
+
+
 YamlDumper.add_representer(TypedList, TypedList.yaml_representer)
+YamlDumper.add_representer(LazyTypedList, TypedList.yaml_representer)
 
 
 def typedlist_factory(base_class: type) -> Callable[[], TypedList]:
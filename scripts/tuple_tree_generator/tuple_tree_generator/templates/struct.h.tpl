@@ -67,16 +67,23 @@ private:
   static_assert(Yamlizable</*= field | field_type =*/>);
   /**- endfor **/
 
+  /** if not struct.inherits -**/
+  /// Hash of this subtree, 0 if it has to be computed (see TupleTree/Hash.h)
+  mutable uint64_t CachedHash = 0;
+  /**- endif **/
+
   //
   // Tracking helpers
   //
   /**- if emit_tracking **/
-  /**- for field in struct.fields **/
-  mutable revng::AccessTracker /*= field.name =*/Tracker = revng::AccessTracker(false);
-  /**- endfor **/
+  mutable revng::FieldAccessTracker</*= struct.fields | list | length =*/> /*= struct.name =*/Tracker;
   /**- endif **/
 
 public:
+  /** if not struct.inherits -**/
+  uint64_t &cachedHash() const { return CachedHash; }
+  /**- endif **/
+
   //
   // Member accessors
   //
@@ -90,7 +97,7 @@ public:
 #ifdef TUPLE_TREE_GENERATOR_EMIT_TRACKING_DEBUG
     fieldAccessed("/*= field.name =*/" , "/*= struct | fullname =*/");
 #endif
-    /*= field.name =*/Tracker.access();
+    /*= struct.name =*/Tracker.access(/*= loop.index0 =*/);
     /** endif -**/
 
     /** endif -**/
@@ -104,6 +111,8 @@ public:
 
   /*= field.doc | docstring -=*/
   /*= field | field_type =*/ & /*= field.name =*/() {
+    // The caller might modify the field
+    cachedHash() = 0;
     return The/*= field.name =*/;
   }
   /**- endfor **/
@@ -226,12 +235,31 @@ public:
   /**- if emit_tracking **/
 private:
   // Tracking helpers
+  /**- if struct.inherits **/
+  /**- set inherited_count = struct.inherits.fields | list | length **/
+  /**- else **/
+  /**- set inherited_count = 0 **/
+  /**- endif **/
   template<size_t I>
-  revng::AccessTracker& getTracker() const {
+  bool isFieldRead() const {
     /**- for field in struct.all_fields **/
+    /**- if loop.index0 < inherited_count **/
+    if constexpr (I == /*= loop.index0 =*/)
+        return /*= struct.inherits.name =*/Tracker.isSet(/*= loop.index0 =*/);
+    /**- else **/
     if constexpr (I == /*= loop.index0 =*/)
-        return /*= field.name =*/Tracker;
+        return /*= struct.name =*/Tracker.isSet(/*= loop.index0 - inherited_count =*/);
+    /**- endif **/
     /**- endfor -**/
+    return false;
+  }
+
+  template<typename CallableType>
+  void visitTrackers(CallableType &&Callable) const {
+    /**- if struct.inherits **/
+    Callable(/*= struct.inherits.name =*/Tracker);
+    /**- endif **/
+    Callable(/*= struct.name =*/Tracker);
   }
   /** if upcastable **/
   /**- for child_type in upcastable|sort(attribute="user_fullname") **/
@@ -264,6 +292,9 @@ private:
   /** endif -**/
 public:
   bool localCompare(const /*= struct | user_fullname =*/ &Other) const;
+  /// \return a hash that is the same for objects that are equal according to
+  ///         localCompare
+  uint64_t localHash() const;
   void dump(llvm::raw_ostream &Stream) const;
   void dump(std::ostream &Stream) const {
     llvm::raw_os_ostream LLVMStreamAdapter(Stream);
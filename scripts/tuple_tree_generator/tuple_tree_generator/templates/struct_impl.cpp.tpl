@@ -9,6 +9,7 @@ The notice below applies to the generated files.
 /** if root_type **/
 #include "/*= user_include_path =*//*= root_type =*/.h"
 /** endif **/
+#include "revng/TupleTree/Hash.h"
 #include "revng/TupleTree/VisitsImpl.h"
 #include "revng/TupleTree/TupleTreeImpl.h"
 #include "revng/TupleTree/TrackingImpl.h"
@@ -141,6 +142,58 @@ bool /*= struct | fullname =*/::localCompare(const /*= struct | user_fullname =*
   /**- endif -**/
 }
 
+uint64_t /*= struct | fullname =*/::localHash() const {
+  /**- if struct.abstract **/
+
+  auto *This = static_cast<const /*= struct | user_fullname =*/ *>(this);
+  return upcast(This, [](const auto &Upcasted) -> uint64_t {
+    return Upcasted.localHash();
+  }, uint64_t(0));
+
+  /**- else -**/
+
+  // Hash exactly what localCompare compares
+  llvm::hash_code Result = llvm::hash_value(llvm::StringRef("/*= struct.name =*/"));
+
+  /** for field in struct.all_fields if not field.is_guid and field.__class__.__name__ != "ReferenceStructField" **/
+
+  /**- if field.__class__.__name__ == "SimpleStructField" **/
+
+  /**- if schema.get_definition_for(field.type).__class__.__name__ == "StructDefinition" -**/
+  /**- if field.upcastable -**/
+  if (not this->/*= field.name =*/().isEmpty())
+    Result = llvm::hash_combine(Result, this->/*= field.name =*/()->localHash());
+  /**- else -**/
+  Result = llvm::hash_combine(Result, this->/*= field.name =*/().localHash());
+  /**- endif -**/
+  /**- else -**/
+  Result = llvm::hash_combine(Result, tupletree::hash(this->/*= field.name =*/()));
+  /**- endif -**/
+
+  /**- elif field.__class__.__name__ == "SequenceStructField" -**/
+  Result = llvm::hash_combine(Result, this->/*= field.name =*/().size());
+
+  /**- if schema.get_definition_for(field.element_type).__class__.__name__ == "StructDefinition" -**/
+  for (const auto &Element : this->/*= field.name =*/()) {
+    /** if field.upcastable **/
+    Result = llvm::hash_combine(Result, Element->localHash());
+    /** else **/
+    Result = llvm::hash_combine(Result, Element.localHash());
+    /** endif **/
+  }
+
+  /**- else -**/
+  Result = llvm::hash_combine(Result, tupletree::hash(this->/*= field.name =*/()));
+  /**- endif -**/
+
+  /** else **//*= ERROR("unexpected field type") =*//** endif **/
+
+  /** endfor **/
+
+  return Result;
+  /**- endif -**/
+}
+
 void /*= struct | fullname =*/::dump(llvm::raw_ostream &Stream) const {
   auto *This = static_cast<const /*= struct | user_fullname =*/ *>(this);
 
@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+# This file is distributed under the MIT License. See LICENSE.md for details.
+#
+
+# Measures the throughput of S3StorageClient against a local MinIO server.
+# Usage: s3-throughput.sh [SIZE_MIB] [extra revng-storage-benchmark options]
+# e.g.: s3-throughput.sh 4096 -s3-part-size=32 -s3-concurrency=8
+
+set -euo pipefail
+
+SIZE="${1:-1024}"
+shift || true
+
+DATA_DIR="$(mktemp -d)"
+S3_PORT=$(python -c 'import socket; s=socket.socket(); s.bind(("127.0.0.1", 0)); print(s.getsockname()[1]); s.close()')
+
+mkdir "$DATA_DIR/benchmark"
+MINIO_ROOT_USER=minioadmin MINIO_ROOT_PASSWORD=minioadmin \
+  minio server "$DATA_DIR" --address "127.0.0.1:$S3_PORT" &>/dev/null &
+MINIO_PID=$!
+trap 'kill -9 $MINIO_PID; rm -rf "$DATA_DIR"' EXIT
+
+# Wait for the server to be up
+for _ in $(seq 50); do
+  if curl -sf "http://127.0.0.1:$S3_PORT/minio/health/live" >/dev/null; then
+    break
+  fi
+  sleep 0.1
+done
+
+revng-storage-benchmark \
+  --size="$SIZE" \
+  "$@" \
+  "s3://minioadmin:minioadmin@us-east-1+127.0.0.1:$S3_PORT/benchmark/run"
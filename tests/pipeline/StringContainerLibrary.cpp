@@ -54,7 +54,7 @@ public:
     ContainedStrings.insert(toString(Target));
   }
 
-  bool contains(const Target &Target) const {
+  bool contains(const Target &Target) const override {
     return ContainedStrings.contains(Target.getPathComponents().back());
   }
 
@@ -0,0 +1,112 @@
+/// \file CompileModule.cpp
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <set>
+#include <string>
+
+#define BOOST_TEST_MODULE CompileModule
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "llvm/CodeGen/CommandFlags.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/TargetSelect.h"
+
+#include "revng/Recompile/CompileModulePipe.h"
+#include "revng/Support/TemporaryFile.h"
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+static llvm::codegen::RegisterCodeGenFlags CodeGenFlags;
+
+/// A module with enough functions, calling each other and sharing a global,
+/// to be split in several partitions
+static std::string buildModuleText() {
+  std::string Result = "target triple = \"x86_64-pc-linux-gnu\"\n"
+                       "@counter = global i64 0\n"
+                       "declare i64 @opaque(i64)\n"
+                       "define i64 @f0(i64 %x) {\n"
+                       "  %r = call i64 @opaque(i64 %x)\n"
+                       "  ret i64 %r\n"
+                       "}\n";
+
+  for (unsigned I = 1; I < 16; ++I) {
+    std::string Index = std::to_string(I);
+    std::string Previous = std::to_string(I - 1);
+    Result += "define i64 @f" + Index + "(i64 %x) {\n"
+              + "  %old = load i64, i64* @counter\n"
+              + "  %new = add i64 %old, " + Index + "\n"
+              + "  store i64 %new, i64* @counter\n"
+              + "  %r = call i64 @f" + Previous + "(i64 %new)\n"
+              + "  ret i64 %r\n" + "}\n";
+  }
+
+  return Result;
+}
+
+static std::unique_ptr<Module> loadModule(LLVMContext &Context) {
+  std::string Text = buildModuleText();
+  SMDiagnostic Diagnostic;
+  auto Buffer = MemoryBuffer::getMemBuffer(Text);
+  std::unique_ptr<Module> Result = parseIR(Buffer->getMemBufferRef(),
+                                           Diagnostic,
+                                           Context);
+  revng_check(Result != nullptr);
+  return Result;
+}
+
+struct Symbols {
+  std::set<std::string> Defined;
+  std::set<std::string> Undefined;
+};
+
+static Symbols compile(unsigned Partitions) {
+  LLVMContext Context;
+  std::unique_ptr<Module> M = loadModule(Context);
+
+  TemporaryFile Object("revng-test-compile-module", "o");
+  using revng::pipes::compileToObjectFile;
+  cantFail(compileToObjectFile(*M, Object.path(), Partitions));
+
+  using object::ObjectFile;
+  auto Binary = cantFail(ObjectFile::createObjectFile(Object.path()));
+
+  Symbols Result;
+  for (const object::SymbolRef &Symbol : Binary.getBinary()->symbols()) {
+    uint32_t Flags = cantFail(Symbol.getFlags());
+    if (not(Flags & object::SymbolRef::SF_Global))
+      continue;
+
+    std::string Name = cantFail(Symbol.getName()).str();
+    if (Flags & object::SymbolRef::SF_Undefined)
+      Result.Undefined.insert(Name);
+    else
+      Result.Defined.insert(Name);
+  }
+
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(PartitionedMatchesSerial) {
+  InitializeNativeTarget();
+  InitializeNativeTargetAsmPrinter();
+
+  Symbols Serial = compile(1);
+  Symbols Partitioned = compile(4);
+
+  // All the functions and the global are there, and the references across
+  // partitions have been resolved by the link
+  BOOST_TEST(Serial.Defined.size() == 17U);
+  BOOST_TEST((Serial.Undefined == std::set<std::string>{ "opaque" }));
+  BOOST_TEST((Partitioned.Defined == Serial.Defined));
+  BOOST_TEST((Partitioned.Undefined == Serial.Undefined));
+}
@@ -69,3 +69,49 @@ BOOST_AUTO_TEST_CASE(TestEnumerate) {
     dbg << "\n";
   }
 }
+
+BOOST_AUTO_TEST_CASE(TestSetOperations) {
+  using CRS = ConstantRangeSet;
+
+  auto Range = [](uint32_t Start, uint32_t End) {
+    return CRS({ { 32, Start }, { 32, End } });
+  };
+
+  CRS Ranges = Range(10, 20).unionWith(Range(30, 40));
+  revng_check(Ranges.contains(llvm::APInt(32, 10)));
+  revng_check(Ranges.contains(llvm::APInt(32, 19)));
+  revng_check(not Ranges.contains(llvm::APInt(32, 20)));
+  revng_check(not Ranges.contains(llvm::APInt(32, 9)));
+  revng_check(Ranges.contains(llvm::APInt(32, 35)));
+  revng_check(not Ranges.contains(llvm::APInt(32, 40)));
+
+  revng_check(Ranges.contains(Range(12, 18)));
+  revng_check(Ranges.contains(Range(10, 20).unionWith(Range(35, 40))));
+  revng_check(not Ranges.contains(Range(15, 35)));
+  revng_check(not Range(12, 18).contains(Ranges));
+  revng_check(Ranges.contains(CRS(32, false)));
+  revng_check(CRS(32, true).contains(Ranges));
+
+  // In-place operators produce the same result as the non-mutating ones
+  CRS Union = Ranges;
+  Union |= Range(15, 35);
+  revng_check(Union == Range(10, 40));
+  revng_check(Union == Ranges.unionWith(Range(15, 35)));
+
+  CRS Intersection = Ranges;
+  Intersection &= Range(15, 35);
+  revng_check(Intersection == Range(15, 20).unionWith(Range(30, 35)));
+  revng_check(Intersection == Ranges.intersectWith(Range(15, 35)));
+
+  CRS Empty;
+  Empty |= Ranges;
+  revng_check(Empty == Ranges);
+  Empty &= CRS(32, false);
+  revng_check(Empty.isEmptySet());
+
+  CRS Full(32, true);
+  Full &= Ranges;
+  revng_check(Full == Ranges);
+  Full |= CRS(32, true);
+  revng_check(Full.isFullSet());
+}
@@ -0,0 +1,215 @@
+/// \file FunctionPass.cpp
+/// Tests for the parallel analysis phase of pipeline::FunctionPass.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Model/LoadModelPass.h"
+#include "revng/Pipeline/ContainerFactory.h"
+#include "revng/Pipeline/ContainerSet.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Contract.h"
+#include "revng/Pipeline/ExecutionContext.h"
+#include "revng/Pipeline/LLVMContainer.h"
+#include "revng/Pipeline/Step.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/FunctionPass.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/FunctionTags.h"
+#include "revng/Support/IRHelpers.h"
+#include "revng/Support/MetaAddress.h"
+
+#define BOOST_TEST_MODULE FunctionPass
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+static constexpr const char *CName = "module";
+static constexpr unsigned FunctionsCount = 16;
+
+/// Appends to each function as many calls to `marker` as the calls it had
+/// before the pass ran, as counted by the analysis phase
+class DuplicateCalls final : public pipeline::FunctionPassImpl {
+private:
+  struct CallsCount : public FunctionAnalysisResult {
+    unsigned Count = 0;
+  };
+
+private:
+  Function *Marker = nullptr;
+
+public:
+  DuplicateCalls(ModulePass &Pass, const model::Binary &, Module &M) :
+    pipeline::FunctionPassImpl(Pass) {
+    auto *VoidType = FunctionType::get(Type::getVoidTy(M.getContext()), false);
+    auto Callee = M.getOrInsertFunction("marker", VoidType);
+    Marker = cast<Function>(Callee.getCallee());
+  }
+
+public:
+  bool runOnFunction(const model::Function &, Function &F) final {
+    auto *Analysis = getAnalysisResult<CallsCount>();
+    revng_check(Analysis != nullptr);
+
+    IRBuilder<> Builder(F.getEntryBlock().getTerminator());
+    for (unsigned I = 0; I < Analysis->Count; ++I)
+      Builder.CreateCall(Marker);
+
+    return true;
+  }
+
+  bool isFunctionLocal() const final { return true; }
+
+  std::unique_ptr<FunctionAnalysisResult>
+  analyzeFunction(const Function &F) const final {
+    auto Result = std::make_unique<CallsCount>();
+    for (const Instruction &I : instructions(F))
+      if (isa<CallInst>(&I))
+        ++Result->Count;
+    return Result;
+  }
+
+  static void getAnalysisUsage(AnalysisUsage &AU) {}
+};
+
+template<>
+char pipeline::FunctionPass<DuplicateCalls>::ID = 0;
+
+struct DuplicateCallsPipe {
+  static constexpr auto Name = "duplicate-calls";
+
+  std::vector<pipeline::ContractGroup> getContract() const {
+    return { pipeline::ContractGroup(revng::kinds::Isolated) };
+  }
+
+  void run(pipeline::ExecutionContext &Ctx,
+           pipeline::LLVMContainer &ModuleContainer) {
+    legacy::PassManager Manager;
+    Manager.add(new pipeline::LoadExecutionContextPass(&Ctx,
+                                                       ModuleContainer.name()));
+    Manager.add(new LoadModelWrapperPass(revng::getModelFromContext(Ctx)));
+    Manager.add(new pipeline::FunctionPass<DuplicateCalls>());
+    Manager.run(ModuleContainer.getModule());
+  }
+
+  llvm::Error checkPrecondition(const pipeline::Context &Ctx) const {
+    return llvm::Error::success();
+  }
+};
+
+static MetaAddress entryOf(unsigned Index) {
+  return MetaAddress::fromGeneric(Triple::x86_64, 0x1000 + Index * 0x10);
+}
+
+/// Runs DuplicateCalls with \p Threads analysis threads on a fresh module
+/// whose i-th function performs i calls
+///
+/// \return the resulting module, printed
+static std::string runDuplicateCalls(unsigned Threads) {
+  auto &Options = cl::getRegisteredOptions();
+  cl::Option *Option = Options.lookup("function-pass-threads");
+  revng_check(Option != nullptr);
+  static_cast<cl::opt<unsigned> *>(Option)->setValue(Threads);
+
+  LLVMContext C;
+  pipeline::Context Ctx;
+  Ctx.addGlobal<revng::ModelGlobal>(revng::ModelGlobalName);
+  auto &Model = revng::getWritableModelFromContext(Ctx);
+  Model->Architecture() = model::Architecture::x86_64;
+
+  using pipeline::LLVMContainer;
+  auto Factory = pipeline::ContainerFactory::fromGlobal<LLVMContainer>(&Ctx,
+                                                                       &C);
+  pipeline::ContainerSet Input;
+  Input.add(CName, Factory, Factory(CName));
+  Module &M = cast<LLVMContainer>(Input[CName]).getModule();
+
+  auto *VoidType = FunctionType::get(Type::getVoidTy(C), false);
+  auto Helper = M.getOrInsertFunction("helper", VoidType);
+
+  pipeline::ContainerToTargetsMap Requested;
+  for (unsigned I = 0; I < FunctionsCount; ++I) {
+    MetaAddress Entry = entryOf(I);
+    Model->Functions()[Entry];
+
+    auto *F = Function::Create(VoidType,
+                               GlobalValue::ExternalLinkage,
+                               "f" + std::to_string(I),
+                               &M);
+    FunctionTags::Isolated.addTo(F);
+    setMetaAddressMetadata(F, FunctionEntryMDName, Entry);
+
+    IRBuilder<> Builder(BasicBlock::Create(C, "", F));
+    for (unsigned J = 0; J < I; ++J)
+      Builder.CreateCall(Helper);
+    Builder.CreateRetVoid();
+
+    Requested.add(CName, pipeline::Target(Entry.toString(),
+                                          revng::kinds::Isolated));
+  }
+
+  pipeline::ContainerSet Containers;
+  Containers.add(CName, Factory, Factory(CName));
+  pipeline::Step Step(Ctx,
+                      "step",
+                      "",
+                      std::move(Containers),
+                      pipeline::PipeWrapper::bind<DuplicateCallsPipe>(CName));
+
+  std::vector<pipeline::PipeExecutionEntry> Entries;
+  Entries.emplace_back(Requested, Requested);
+  cantFail(Step.run(std::move(Input), Entries));
+
+  const auto &Output = Step.containers().get<LLVMContainer>(CName);
+  std::string LastName = "f" + std::to_string(FunctionsCount - 1);
+  const Function *Last = Output.getModule().getFunction(LastName);
+  revng_check(Last != nullptr);
+  unsigned Calls = 0;
+  for (const Instruction &I : instructions(Last))
+    Calls += isa<CallInst>(&I) ? 1 : 0;
+  revng_check(Calls == 2 * (FunctionsCount - 1));
+
+  std::string Result;
+  raw_string_ostream Stream(Result);
+  Output.getModule().print(Stream, nullptr);
+  Stream.flush();
+  return Result;
+}
+
+struct Fixture {
+  Fixture() {
+    pipeline::Rank::init();
+    pipeline::Kind::init();
+  }
+};
+
+BOOST_AUTO_TEST_SUITE(FunctionPassTestSuite,
+                      *boost::unit_test::fixture<Fixture>())
+
+BOOST_AUTO_TEST_CASE(ParallelAnalysisMatchesSerial) {
+  std::string Serial = runDuplicateCalls(1);
+  std::string Parallel = runDuplicateCalls(4);
+  BOOST_TEST(Serial == Parallel);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
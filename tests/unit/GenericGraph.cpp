@@ -17,6 +17,7 @@ bool init_unit_test();
 #include "llvm/Support/raw_ostream.h"
 
 #include "revng/ADT/FilteredGraphTraits.h"
+#include "revng/ADT/FrozenGraph.h"
 #include "revng/ADT/GenericGraph.h"
 #include "revng/ADT/SerializableGraph.h"
 #include "revng/TupleTree/Introspection.h"
@@ -360,6 +361,46 @@ BOOST_AUTO_TEST_CASE(TestDominatorTree) {
   revng_check(not PDT.dominates(PDT.getNode(DG.Then), PDT.getNode(DG.Root)));
 }
 
+BOOST_AUTO_TEST_CASE(TestFrozenGraph) {
+  auto DG = createGraph<BidirectionalTestNode>();
+  auto Frozen = freeze(&DG.Graph);
+  using FrozenNode = decltype(Frozen)::Node;
+
+  revng_check(Frozen.size() == 4);
+  revng_check(Frozen.getEntryNode()->original() == DG.Root);
+  for (FrozenNode *Node : Frozen.nodes()) {
+    revng_check(Frozen.at(Node->index()) == Node);
+    revng_check(Frozen.find(Node->original()) == Node);
+    revng_check(Node->successorCount() == Node->original()->successorCount());
+    for (FrozenNode *Predecessor : Node->predecessors())
+      revng_check(Node->original()->hasPredecessor(Predecessor->original()));
+  }
+
+  std::vector<BidirectionalTestNode *> Expected;
+  using GraphPtr = decltype(&DG.Graph);
+  for (auto *Node : ReversePostOrderTraversal<GraphPtr>(&DG.Graph))
+    Expected.push_back(Node);
+  std::vector<BidirectionalTestNode *> Visited;
+  using FrozenPtr = decltype(&Frozen);
+  for (FrozenNode *Node : ReversePostOrderTraversal<FrozenPtr>(&Frozen))
+    Visited.push_back(Node->original());
+  revng_check(Visited == Expected);
+
+  FrozenNode *Root = Frozen.find(DG.Root);
+  FrozenNode *Then = Frozen.find(DG.Then);
+  FrozenNode *Final = Frozen.find(DG.Final);
+
+  DominatorTreeBase<FrozenNode, false> DT;
+  DT.recalculate(Frozen);
+  revng_check(DT.dominates(DT.getNode(Root), DT.getNode(Final)));
+  revng_check(not DT.dominates(DT.getNode(Then), DT.getNode(Final)));
+
+  DominatorTreeBase<FrozenNode, true> PDT;
+  PDT.recalculate(Frozen);
+  revng_check(PDT.dominates(PDT.getNode(Final), PDT.getNode(Root)));
+  revng_check(not PDT.dominates(PDT.getNode(Then), PDT.getNode(Root)));
+}
+
 BOOST_AUTO_TEST_CASE(TestSCC) {
   auto DG = createGraph<BidirectionalTestNode>();
   unsigned SCCCount = 0;
@@ -507,6 +548,37 @@ BOOST_AUTO_TEST_CASE(BasicMutableEdgeNodeTest) {
   revng_check(B->predecessorCount() == 1);
 }
 
+BOOST_AUTO_TEST_CASE(ArenaAllocatedNodesTest) {
+  using Graph = GenericGraph<MutableEdgeNode<std::string, double>>;
+
+  Graph G;
+  auto *A = G.addNode("A");
+  G.allocateNodesInArena();
+  auto *B = G.addNode("B");
+  auto *C = G.addNode(std::make_unique<Graph::Node>("C"));
+  G.insertNode(G.nodes().begin(), "D");
+
+  A->addSuccessor(B);
+  B->addSuccessor(C);
+  C->addSuccessor(A);
+  revng_check(G.size() == 4);
+  revng_check(*(*G.nodes().begin()) == "D");
+
+  G.removeNode(B);
+  revng_check(G.size() == 3);
+  revng_check(A->successorCount() == 0);
+  revng_check(C->successorCount() == 1);
+
+  // Moving the graph does not move the nodes
+  Graph Moved = std::move(G);
+  revng_check(Moved.hasNode(A) and Moved.hasNode(C));
+
+  Moved.clear();
+  revng_check(not Moved.hasNodes());
+  auto *E = Moved.addNode("E");
+  revng_check(Moved.size() == 1 and *E == "E");
+}
+
 using TestMutableEdgeNode = MutableEdgeNode<TestNodeData, TestEdgeLabel>;
 
 BOOST_AUTO_TEST_CASE(MutableEdgeNodeFilterGraphTraitsTest) {
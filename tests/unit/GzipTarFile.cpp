@@ -4,8 +4,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <algorithm>
+
 #include "revng/Support/GzipStream.h"
 #include "revng/Support/GzipTarFile.h"
+#include "revng/Support/ZstdStream.h"
 
 #define BOOST_TEST_MODULE GzipTarFile
 bool init_unit_test();
@@ -54,6 +57,7 @@ BOOST_AUTO_TEST_CASE(GzipTarFileTest) {
 
     cppcoro::generator<ArchiveEntry> Gen = Reader.entries();
     std::vector<ArchiveEntry> Entries(Gen.begin(), Gen.end());
+    BOOST_TEST(!Reader.takeError());
     BOOST_TEST(Entries.size() == 2ULL);
 
     llvm::StringRef RefData1(Entries[0].Data.data(), Entries[0].Data.size());
@@ -68,3 +72,222 @@ BOOST_AUTO_TEST_CASE(GzipTarFileTest) {
   checkOffset(Buffer, Offset1.DataStart, Offset1.dataSize(), "foo2");
   checkOffset(Buffer, Offset2.DataStart, Offset2.dataSize(), "bar2");
 }
+
+BOOST_AUTO_TEST_CASE(ZstdTarFileTest) {
+  using revng::ArchiveEntry;
+  using revng::OffsetDescriptor;
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+
+  revng::GzipTarWriter Writer(OS, revng::TarCompression::Zstd);
+
+  const char Data1[5] = "foo2";
+  OffsetDescriptor Offset1 = Writer.append("foo", { Data1, 4 });
+
+  // Large enough to be compressed by multiple threads
+  std::string Data2(4 * 1024 * 1024, 'x');
+  OffsetDescriptor Offset2 = Writer.append("bar",
+                                           { Data2.data(), Data2.size() });
+
+  Writer.close();
+
+  BOOST_TEST(isZstd(Buffer));
+  BOOST_TEST(Offset2.Start == Offset1.End);
+
+  {
+    revng::GzipTarReader Reader({ Buffer.data(), Buffer.size() });
+
+    cppcoro::generator<ArchiveEntry> Gen = Reader.entries();
+    std::vector<ArchiveEntry> Entries(Gen.begin(), Gen.end());
+    BOOST_TEST(!Reader.takeError());
+    BOOST_TEST(Entries.size() == 2ULL);
+
+    llvm::StringRef RefData1(Entries[0].Data.data(), Entries[0].Data.size());
+    BOOST_TEST(Entries[0].Filename == "foo");
+    BOOST_TEST(RefData1.str() == "foo2");
+
+    llvm::StringRef RefData2(Entries[1].Data.data(), Entries[1].Data.size());
+    BOOST_TEST(Entries[1].Filename == "bar");
+    BOOST_TEST(RefData2.str() == Data2);
+  }
+
+  // Each file can be decompressed by itself
+  auto Decompress = [&Buffer](const OffsetDescriptor &Offset) {
+    llvm::SmallString<128> Output;
+    llvm::raw_svector_ostream OS(Output);
+    llvm::ArrayRef<char> Compressed(Buffer.data() + Offset.DataStart,
+                                    Offset.PaddingStart - Offset.DataStart);
+    BOOST_TEST(!zstdDecompress(OS, Compressed));
+    return Output.str().str();
+  };
+  BOOST_TEST(Decompress(Offset1) == "foo2");
+  BOOST_TEST(Decompress(Offset2) == Data2);
+}
+
+BOOST_AUTO_TEST_CASE(CorruptedZstdTest) {
+  std::string Data(64 * 1024, 'x');
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  zstdCompress(OS, { Data.data(), Data.size() });
+
+  // Truncated
+  {
+    std::string Output;
+    llvm::raw_string_ostream OutputOS(Output);
+    llvm::ArrayRef<char> Truncated(Buffer);
+    llvm::Error Error = zstdDecompress(OutputOS,
+                                       Truncated.drop_back(Buffer.size() / 2));
+    BOOST_TEST(!!Error);
+    llvm::consumeError(std::move(Error));
+  }
+
+  // Garbage after the magic
+  {
+    llvm::SmallVector<char> Corrupted(Buffer.begin(), Buffer.begin() + 4);
+    Corrupted.append(64, '\xFF');
+    std::string Output;
+    llvm::raw_string_ostream OutputOS(Output);
+    llvm::Error Error = zstdDecompress(OutputOS, Corrupted);
+    BOOST_TEST(!!Error);
+    llvm::consumeError(std::move(Error));
+  }
+
+  // Archives with corrupted frames are reported as errors too
+  {
+    llvm::SmallVector<char> Archive;
+    llvm::raw_svector_ostream ArchiveOS(Archive);
+    revng::GzipTarWriter Writer(ArchiveOS, revng::TarCompression::Zstd);
+    Writer.append("foo", { Data.data(), Data.size() });
+    Writer.close();
+
+    std::fill(Archive.begin() + Archive.size() / 4,
+              Archive.begin() + Archive.size() / 2,
+              '\xFF');
+    revng::GzipTarReader Reader({ Archive.data(), Archive.size() });
+    for (revng::ArchiveEntry &Entry : Reader.entries())
+      (void) Entry;
+
+    llvm::Error Error = Reader.takeError();
+    BOOST_TEST(!!Error);
+    llvm::consumeError(std::move(Error));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(ParallelGzipTest) {
+  // Large enough to be split in multiple gzip members
+  std::string Data;
+  for (size_t I = 0; Data.size() < 5 * 1024 * 1024; ++I)
+    Data += std::to_string(I);
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  gzipCompress(OS, { Data.data(), Data.size() });
+
+  BOOST_TEST(gzipDecompress(Buffer) == Data);
+}
+
+BOOST_AUTO_TEST_CASE(GzipTarFileBatchAppendTest) {
+  using revng::ArchiveEntry;
+  using revng::GzipTarWriter;
+  using revng::OffsetDescriptor;
+
+  std::vector<std::string> Names;
+  std::vector<std::string> Contents;
+  for (size_t I = 0; I < 100; ++I) {
+    Names.push_back("file" + std::to_string(I));
+    Contents.push_back(std::string(I * 10, 'a' + I % 26));
+  }
+
+  std::vector<GzipTarWriter::Input> Inputs;
+  for (size_t I = 0; I < Names.size(); ++I)
+    Inputs.push_back({ Names[I], { Contents[I].data(), Contents[I].size() } });
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+  GzipTarWriter Writer(OS);
+  std::vector<OffsetDescriptor> Offsets = Writer.append(Inputs);
+  Writer.close();
+
+  BOOST_TEST(Offsets.size() == Names.size());
+  BOOST_TEST(Offsets[0].Start == 0ULL);
+  for (size_t I = 1; I < Offsets.size(); ++I)
+    BOOST_TEST(Offsets[I].Start == Offsets[I - 1].End);
+
+  revng::GzipTarReader Reader({ Buffer.data(), Buffer.size() });
+  size_t Index = 0;
+  for (ArchiveEntry &Entry : Reader.entries()) {
+    llvm::StringRef Data(Entry.Data.data(), Entry.Data.size());
+    BOOST_TEST(Entry.Filename == Names[Index]);
+    BOOST_TEST(Data.str() == Contents[Index]);
+    ++Index;
+  }
+  BOOST_TEST(!Reader.takeError());
+  BOOST_TEST(Index == Names.size());
+
+  for (size_t I = 0; I < Names.size(); ++I)
+    checkOffset(Buffer,
+                Offsets[I].DataStart,
+                Offsets[I].dataSize(),
+                Contents[I]);
+}
+
+BOOST_AUTO_TEST_CASE(GzipTarFileChunkedReadTest) {
+  using revng::ArchiveEntry;
+
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+
+  revng::GzipTarWriter Writer(OS);
+  const char Data1[5] = "foo2";
+  Writer.append("foo", { Data1, 4 });
+  const char Data2[5] = "bar2";
+  Writer.append("bar", { Data2, 4 });
+  Writer.close();
+
+  // Feed the archive a few bytes at a time
+  llvm::ArrayRef<char> Remaining(Buffer);
+  auto NextChunk = [&Remaining]() -> llvm::Expected<llvm::ArrayRef<char>> {
+    llvm::ArrayRef<char> Chunk = Remaining.take_front(7);
+    Remaining = Remaining.drop_front(Chunk.size());
+    return Chunk;
+  };
+  revng::GzipTarReader Reader(NextChunk);
+
+  cppcoro::generator<ArchiveEntry> Gen = Reader.entries();
+  std::vector<ArchiveEntry> Entries(Gen.begin(), Gen.end());
+  BOOST_TEST(!Reader.takeError());
+  BOOST_TEST(Entries.size() == 2ULL);
+  BOOST_TEST(Entries[0].Filename == "foo");
+  BOOST_TEST(Entries[1].Filename == "bar");
+
+  llvm::StringRef RefData2(Entries[1].Data.data(), Entries[1].Data.size());
+  BOOST_TEST(RefData2.str() == "bar2");
+}
+
+BOOST_AUTO_TEST_CASE(GzipTarFileChunkedReadFailureTest) {
+  llvm::SmallVector<char> Buffer;
+  llvm::raw_svector_ostream OS(Buffer);
+
+  revng::GzipTarWriter Writer(OS);
+  const char Data[5] = "foo2";
+  Writer.append("foo", { Data, 4 });
+  Writer.close();
+
+  // Fail after the first chunk
+  bool First = true;
+  revng::GzipTarReader Reader([&]() -> llvm::Expected<llvm::ArrayRef<char>> {
+    if (not First)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "network failure");
+    First = false;
+    return llvm::ArrayRef<char>(Buffer).take_front(16);
+  });
+
+  for (revng::ArchiveEntry &Entry : Reader.entries())
+    (void) Entry;
+
+  llvm::Error Error = Reader.takeError();
+  BOOST_TEST(!!Error);
+  llvm::consumeError(std::move(Error));
+}
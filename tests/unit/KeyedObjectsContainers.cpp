@@ -143,6 +143,18 @@ void testSet() {
   revng_check(Set[0x1100].value() == 0x2222);
   revng_check(Set[0x900].value() == 0x3333);
 
+  // Test batch_try_emplace
+  {
+    auto Inserter = Set.batch_try_emplace();
+    Inserter.try_emplace(0x1000, 0x4444).setValue(0x5555);
+    Inserter.try_emplace(0x800, 0x6666);
+    Inserter.try_emplace(0x700, 0x7777);
+    Inserter.try_emplace(0x800, 0x8888);
+  }
+  revng_check(Set[0x1000].value() == 0x2222);
+  revng_check(Set[0x800].value() == 0x6666);
+  revng_check(Set[0x700].value() == 0x7777);
+
   // Test clear
   Set.clear();
 
@@ -332,5 +344,37 @@ BOOST_AUTO_TEST_CASE(TrackingContainerPush) {
   testPush<MutableSet>();
 }
 
+template<template<typename...> class T>
+static void testStructuralGeneration() {
+  revng::StructuralGeneration First;
+  revng::StructuralGeneration Second;
+  T<int> OfFirst;
+  T<int> OfSecond;
+  OfFirst.attachGeneration(&First);
+  OfSecond.attachGeneration(&Second);
+
+  // Modifying a container doesn't affect the generations it's not attached to
+  auto Before = revng::getStructuralGeneration(&First);
+  OfSecond.insert(1);
+  OfSecond.erase(1);
+  revng_check(revng::getStructuralGeneration(&First) == Before);
+
+  OfFirst.insert(1);
+  OfFirst.erase(1);
+  revng_check(revng::getStructuralGeneration(&First) != Before);
+
+  // Copies are not attached, they might belong to any generation
+  Before = revng::getStructuralGeneration(&Second);
+  T<int> Copy = OfFirst;
+  Copy.insert(2);
+  Copy.erase(2);
+  revng_check(revng::getStructuralGeneration(&Second) != Before);
+}
+
+BOOST_AUTO_TEST_CASE(StructuralGeneration) {
+  testStructuralGeneration<SortedVector>();
+  testStructuralGeneration<MutableSet>();
+}
+
 static_assert(KeyedObjectContainer<TrackingSortedVector<int>>);
 static_assert(KeyedObjectContainer<revng::TrackingContainer<MutableSet<int>>>);
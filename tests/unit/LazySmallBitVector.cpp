@@ -158,6 +158,39 @@ BOOST_AUTO_TEST_CASE(TestBitwiseOperators) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(TestWordOperations) {
+  for (unsigned Start = 0; Start <= FirstLargeBit; Start += FirstLargeBit) {
+    LazySmallBitVector A;
+    LazySmallBitVector B;
+    BOOST_TEST(A.count() == 0U);
+    BOOST_TEST(A.findFirst() == 0U);
+    BOOST_TEST(A.isSubsetOf(B));
+
+    // Test or, reporting changes
+    A.set(Start + 1);
+    BOOST_TEST(B.orAndTestChanged(A));
+    BOOST_TEST(not B.orAndTestChanged(A));
+    BOOST_REQUIRE_EQUAL(A, B);
+
+    // Test subset
+    B.set(Start + 3);
+    BOOST_TEST(A.isSubsetOf(B));
+    BOOST_TEST(not B.isSubsetOf(A));
+
+    // Test large vectors against small ones
+    B.set(1000);
+    BOOST_TEST(A.isSubsetOf(B));
+    BOOST_TEST(not B.isSubsetOf(A));
+    BOOST_TEST(B.orAndTestChanged(A) == false);
+    BOOST_TEST(A.orAndTestChanged(B));
+    BOOST_REQUIRE_EQUAL(A, B);
+
+    // Test count and find first
+    BOOST_TEST(A.count() == 3U);
+    BOOST_TEST(A.findFirst() == Start + 2);
+  }
+}
+
 BOOST_AUTO_TEST_CASE(TestCopy) {
   for (unsigned Start = 0; Start <= FirstLargeBit; Start += FirstLargeBit) {
     LazySmallBitVector A;
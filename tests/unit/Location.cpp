@@ -8,6 +8,7 @@ bool init_unit_test();
 
 #include "revng/Model/Binary.h"
 #include "revng/Pipeline/Location.h"
+#include "revng/Pipeline/LocationInterner.h"
 #include "revng/Pipes/Ranks.h"
 #include "revng/Support/BasicBlockID.h"
 
@@ -145,4 +146,36 @@ BOOST_AUTO_TEST_CASE(Serialization) {
   }
 }
 
+BOOST_AUTO_TEST_CASE(Interning) {
+  namespace ranks = revng::ranks;
+  using pipeline::InternedLocation;
+  using pipeline::LocationInterner;
+
+  const auto A0 = MetaAddress::fromString("0x1:Generic64");
+  const auto A1 = BasicBlockID::fromString("0x2:Generic64");
+  const auto A2 = BasicBlockID::fromString("0x3:Generic64");
+
+  auto &Interner = LocationInterner::get();
+  InternedLocation First = pipeline::internedLocation(ranks::BasicBlock,
+                                                      A0,
+                                                      A2);
+  InternedLocation Second = pipeline::internedLocation(ranks::BasicBlock,
+                                                       A0,
+                                                       A1);
+  revng_check(First.isValid() and Second.isValid());
+  revng_check(First != Second);
+
+  // The same location always gets the same ID
+  auto Location = pipeline::location(ranks::BasicBlock, A0, A1);
+  revng_check(Interner.intern(Location) == Second);
+  revng_check(Interner.find(Location.toString()) == Second);
+  revng_check(Second.str() == Location.toString());
+
+  revng_check(not Interner.find("/function/0x4:Generic64").isValid());
+
+  // IDs are assigned in order, strings are sorted lexicographically
+  revng_check(First < Second);
+  revng_check(InternedLocation::lessByString(Second, First));
+}
+
 BOOST_AUTO_TEST_SUITE_END();
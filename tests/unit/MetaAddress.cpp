@@ -167,6 +167,21 @@ BOOST_AUTO_TEST_CASE(Comparison) {
   BOOST_TEST(A.addressGreaterThan(B));
 }
 
+BOOST_AUTO_TEST_CASE(Ordering) {
+  // Epoch, address space and type take precedence over the address
+  auto Low = MetaAddress::fromGeneric(Triple::x86, 0x2000);
+  auto Epoch = MetaAddress::fromGeneric(Triple::x86, 0x1000, 1);
+  auto AddressSpace = MetaAddress::fromGeneric(Triple::x86, 0x1000, 0, 1);
+  auto Code = MetaAddress::fromPC(Triple::x86, 0x1000);
+
+  BOOST_TEST(Low < Epoch);
+  BOOST_TEST(AddressSpace < Epoch);
+  BOOST_TEST(Low < AddressSpace);
+  BOOST_TEST(Low < Code);
+  BOOST_TEST(MetaAddress::invalid() < Code);
+  BOOST_TEST((Low <=> Low) == std::strong_ordering::equal);
+}
+
 BOOST_AUTO_TEST_CASE(Page) {
   BOOST_TEST(generic64(0x1234).pageStart() == generic64(0x1000));
   BOOST_TEST(generic64(0x1234).nextPageStart() == generic64(0x2000));
@@ -183,3 +198,21 @@ BOOST_AUTO_TEST_CASE(Map) {
 
   BOOST_TEST(Map.size() == size_t(5));
 }
+
+BOOST_AUTO_TEST_CASE(HashMap) {
+  MetaAddressMap<int> Map;
+
+  Map[generic64(0)] = 1;
+  Map[MetaAddress::invalid()] = 2;
+  Map[pc(0)] = 3;
+  Map[MetaAddress::fromPC(Triple::arm, 0)] = 4;
+  Map[MetaAddress::fromPC(Triple::arm, 1)] = 5;
+
+  BOOST_TEST(Map.size() == size_t(5));
+  BOOST_TEST(Map.lookup(MetaAddress::invalid()) == 2);
+  BOOST_TEST(Map.lookup(pc(0)) == 3);
+  BOOST_TEST(not Map.contains(pc(1)));
+
+  std::hash<MetaAddress> Hash;
+  BOOST_TEST(Hash(pc(0)) != Hash(pc(1)));
+}
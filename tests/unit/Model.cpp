@@ -11,10 +11,14 @@ bool init_unit_test();
 #include "revng/Model/Binary.h"
 #include "revng/Model/Pass/AllPasses.h"
 #include "revng/Model/Processing.h"
+#include "revng/Model/RawBinaryView.h"
+#include "revng/Model/TypeLayoutCache.h"
+#include "revng/Pipeline/Global.h"
 #include "revng/Support/MetaAddress.h"
 #include "revng/Support/MetaAddress/YAMLTraits.h"
 #include "revng/Support/YAMLTraits.h"
 #include "revng/TupleTree/DiffError.h"
+#include "revng/TupleTree/Hash.h"
 #include "revng/TupleTree/Introspection.h"
 #include "revng/TupleTree/Tracking.h"
 #include "revng/TupleTree/TupleTreeDiff.h"
@@ -111,6 +115,13 @@ BOOST_AUTO_TEST_CASE(TestStringPathConversion) {
   auto MaybePath = stringAsPath<Binary>("/Functions/:Invalid/CustomName");
   revng_check(MaybePath.value() == InvalidFunctionNamePath);
 
+  // Parsing a path again must give an independent copy of the same path
+  MaybePath->pop_back();
+  MaybePath = stringAsPath<Binary>("/Functions/:Invalid/CustomName");
+  revng_check(MaybePath.value() == InvalidFunctionNamePath);
+
+  revng_check(not stringAsPath<Binary>("/Functions/:Invalid/NotAField"));
+
   auto CheckRoundTrip = [](const char *String) {
     auto Path = stringAsPath<Binary>(String).value();
     auto StringAgain = pathAsString<Binary>(Path);
@@ -247,6 +258,275 @@ BOOST_AUTO_TEST_CASE(TestModelDeduplication) {
 
     revng_check(Dedup() == 2);
   }
+
+  // Several typedefs with the same name, only some of them equivalent
+  {
+    for (uint64_t Size : { 1, 2, 4, 8, 1, 2 }) {
+      auto Underlying = model::PrimitiveType::makeGeneric(Size);
+      auto &Typedef = Model->makeTypedefDefinition(std::move(Underlying)).first;
+      Typedef.OriginalName() = "MySizedInt";
+    }
+
+    revng_check(Dedup() == 2);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestBinarySerialization) {
+  TupleTree<model::Binary> Model;
+
+  auto [Struct, StructType] = Model->makeStructDefinition();
+  Struct.OriginalName() = "MyStruct";
+  Struct.Fields()[0].CustomName() = "Self";
+  Struct.Fields()[0].Type() = model::PointerType::make(std::move(StructType),
+                                                       8);
+
+  auto Int32 = model::PrimitiveType::makeSigned(4);
+  auto &Typedef = Model->makeTypedefDefinition(std::move(Int32)).first;
+  Typedef.OriginalName() = "MyInt32";
+
+  std::string Buffer;
+  llvm::raw_string_ostream Stream(Buffer);
+  Model.serializeBinary(Stream);
+  Stream.flush();
+
+  revng_check(tupletree::binary::isBinary(Buffer));
+
+  auto Expected = serializeToString(*Model);
+
+  auto MaybeBinary = TupleTree<model::Binary>::deserializeBinary(Buffer);
+  revng_check(static_cast<bool>(MaybeBinary));
+  revng_check(serializeToString(**MaybeBinary) == Expected);
+  revng_check((*MaybeBinary)->verify());
+
+  // The format is detected automatically
+  auto MaybeDetected = TupleTree<model::Binary>::deserialize(Buffer);
+  revng_check(static_cast<bool>(MaybeDetected));
+  revng_check(serializeToString(**MaybeDetected) == Expected);
+
+  // Truncated documents are rejected
+  auto Truncated = llvm::StringRef(Buffer).drop_back();
+  auto MaybeTruncated = TupleTree<model::Binary>::deserializeBinary(Truncated);
+  revng_check(not MaybeTruncated);
+  llvm::consumeError(MaybeTruncated.takeError());
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelYAMLDeserialization) {
+  TupleTree<model::Binary> Model;
+  for (uint64_t I = 0; I < 64; ++I) {
+    auto Address = MetaAddress::fromString("0x" + std::to_string(1000 + I)
+                                           + ":Code_x86_64");
+    Model->Functions()[Address].OriginalName() = "f" + std::to_string(I);
+    auto Int = model::PrimitiveType::makeSigned(4);
+    auto &Typedef = Model->makeTypedefDefinition(std::move(Int)).first;
+    Typedef.OriginalName() = "t" + std::to_string(I);
+  }
+
+  std::string Expected = serializeToString(*Model);
+
+  // Force the split in many small chunks
+  using tupletree::detail::deserializeYAML;
+  auto MaybeBinary = deserializeYAML<model::Binary>(Expected, 0, 64);
+  revng_check(static_cast<bool>(MaybeBinary));
+  revng_check(serializeToString(*MaybeBinary) == Expected);
+
+  // Errors in a chunk are reported as if the document was parsed as a whole
+  std::string Broken = Expected;
+  Broken.replace(Broken.find(" f42\n"), 4, " [");
+  auto MaybeBroken = deserializeYAML<model::Binary>(Broken, 0, 64);
+  revng_check(not MaybeBroken);
+  llvm::consumeError(MaybeBroken.takeError());
+}
+
+BOOST_AUTO_TEST_CASE(TestTupleTreeCopyOnWrite) {
+  TupleTree<model::Binary> Original;
+  Original->Functions()[MetaAddress::invalid()].OriginalName() = "original";
+
+  // Copies share the root until modified
+  TupleTree<model::Binary> Snapshot = Original;
+  const auto &ConstSnapshot = Snapshot;
+  BOOST_TEST(Snapshot.isShared());
+  BOOST_TEST(ConstSnapshot.get() == std::as_const(Original).get());
+
+  // Modifying the original leaves the snapshot untouched
+  Original->Functions()[MetaAddress::invalid()].OriginalName() = "modified";
+  BOOST_TEST(not Snapshot.isShared());
+  BOOST_TEST(ConstSnapshot.get() != std::as_const(Original).get());
+
+  const auto &Functions = ConstSnapshot->Functions();
+  BOOST_TEST(Functions.at(MetaAddress::invalid()).OriginalName()
+             == "original");
+  BOOST_TEST(Snapshot.verify());
+  BOOST_TEST(Original.verify());
+}
+
+BOOST_AUTO_TEST_CASE(TestTupleTreeCopyOnWriteCachedReferences) {
+  using Tree = TupleTree<model::Binary>;
+  Tree Original;
+  auto Key = Original->makeTypedefDefinition().first.key();
+  Tree Snapshot = Original;
+  uint64_t Copies = Tree::getDeepCopiesCount();
+
+  // Caching the references of either copy leaves the root shared
+  Snapshot.cacheReferences();
+  Original.cacheReferences();
+  BOOST_TEST(Snapshot.isShared());
+  BOOST_TEST(Tree::getDeepCopiesCount() == Copies);
+
+  // Modifying one of them copies the root once
+  Original.evictCachedReferences();
+  Original->makeTypedefDefinition();
+  BOOST_TEST(not Snapshot.isShared());
+  BOOST_TEST(Tree::getDeepCopiesCount() == Copies + 1);
+
+  // The copy does not point into the root of the snapshot
+  const model::Binary &ConstOriginal = *std::as_const(Original);
+  auto Reference = ConstOriginal.getDefinitionReference(Key);
+  BOOST_TEST(Reference.getConst()
+             != std::as_const(Snapshot)->TypeDefinitions().at(Key).get());
+  BOOST_TEST(Original.verify());
+  BOOST_TEST(Snapshot.verify());
+}
+
+BOOST_AUTO_TEST_CASE(TestTupleTreeCopiesDoNotShareTracking) {
+  TupleTree<model::Binary> Model;
+  auto Address = MetaAddress::fromPC(llvm::Triple::ArchType::x86_64, 0);
+  Model->Segments().insert(Segment(Address, 1000));
+  Segment::Key SegmentKey(Address, 1000);
+
+  // The copy held by the global shares the root, until tracking starts
+  pipeline::TupleTreeGlobal<model::Binary> Global("model.yml", Model);
+  BOOST_TEST(Model.isShared());
+  Global.clearAndResume();
+  BOOST_TEST(not Model.isShared());
+
+  std::set<TupleTreePath> Reads;
+  auto Collect = [&Global, &Reads]() {
+    Reads.clear();
+    Global.collectReadPaths([&Reads](const TupleTreePath &Path) {
+      Reads.insert(Path);
+    });
+  };
+
+  // Reads of the copy are not attributed to the global
+  std::as_const(Model)->Segments().at(SegmentKey).StartAddress();
+  Collect();
+  BOOST_TEST(Reads.empty());
+
+  std::as_const(Global.get())->Segments().at(SegmentKey).StartAddress();
+  Collect();
+  BOOST_TEST(Reads.size() == 1);
+
+  // Copies of a tree being tracked do not share its root either
+  TupleTree<model::Binary> Copy = Global.get();
+  BOOST_TEST(not Copy.isShared());
+  Global.stopTracking();
+}
+
+BOOST_AUTO_TEST_CASE(TestReferenceResolutionCache) {
+  TupleTree<model::Binary> Model;
+
+  auto &Typedef = Model->makeTypedefDefinition().first;
+  auto Reference = Model->getDefinitionReference(Typedef.key());
+  BOOST_TEST(Reference.get() == &Typedef);
+
+  // Inserting new definitions might move the existing ones around
+  for (int I = 0; I < 64; ++I)
+    Model->makeStructDefinition();
+
+  auto Key = Reference.get()->key();
+  const auto &Definitions = std::as_const(*Model).TypeDefinitions();
+  const model::TypeDefinition *Expected = Definitions.at(Key).get();
+  BOOST_TEST(Reference.get() == Expected);
+  BOOST_TEST(Reference.getConst() == Expected);
+
+  // Erasing the target is observed too
+  Model->TypeDefinitions().erase(Key);
+  BOOST_TEST(Reference.get() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(TestReferenceResolutionCacheOfInitializedTree) {
+  TupleTree<model::Binary> Model;
+  auto [Struct, StructType] = Model->makeStructDefinition();
+  auto StructKey = Struct.key();
+  auto &Typedef = Model->makeTypedefDefinition(std::move(StructType)).first;
+  Model.initializeReferences();
+
+  const model::Type &Underlying = *std::as_const(Typedef).UnderlyingType();
+  const auto &Defined = llvm::cast<model::DefinedType>(Underlying);
+  const auto &Reference = Defined.Definition();
+  BOOST_TEST(Reference.getConst() == &Struct);
+
+  // Modifying another tree doesn't affect it
+  TupleTree<model::Binary> Other;
+  Other.initializeReferences();
+  auto OtherKey = Other->makeStructDefinition().first.key();
+  Other->TypeDefinitions().erase(OtherKey);
+  BOOST_TEST(Reference.getConst() == &Struct);
+
+  // Erasing the target is observed
+  Model->TypeDefinitions().erase(StructKey);
+  BOOST_TEST(Reference.getConst() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(TestReferenceResolutionIsTracked) {
+  TupleTree<model::Binary> Model;
+  auto Key = Model->makeTypedefDefinition().first.key();
+  const model::Binary &ConstModel = *std::as_const(Model);
+  auto Reference = ConstModel.getDefinitionReference(Key);
+
+  // Resolve it before tracking starts, then again while tracking
+  const model::TypeDefinition *Expected = Reference.getConst();
+  revng::Tracking::clearAndResume(ConstModel);
+  BOOST_TEST(Reference.getConst() == Expected);
+
+  auto Collected = revng::Tracking::collect(ConstModel);
+  BOOST_TEST(Collected.Read.contains(Reference.path()));
+}
+
+BOOST_AUTO_TEST_CASE(TestIncrementalVerification) {
+  TupleTree<model::Binary> Model;
+  Model->Architecture() = model::Architecture::arm;
+  auto Int32 = model::PrimitiveType::makeSigned(4);
+  auto &Typedef = Model->makeTypedefDefinition(std::move(Int32)).first;
+  Typedef.CustomName() = "my_int";
+  revng_check(Model->verify());
+
+  // Adding a function only requires verifying the function itself
+  TupleTree<model::Binary> WithFunction = Model;
+  WithFunction->Functions()[ARM2000].CustomName() = "my_function";
+  auto Addition = diff(*Model, *WithFunction);
+  revng_check(WithFunction->verify(Addition));
+  revng_check(WithFunction->verify());
+
+  // Its name is still checked against the whole global namespace
+  TupleTree<model::Binary> Colliding = WithFunction;
+  Colliding->Functions()[ARM2000].CustomName() = "my_int";
+  auto Rename = diff(*WithFunction, *Colliding);
+  revng_check(not Colliding->verify(Rename));
+  revng_check(not Colliding->verify());
+}
+
+BOOST_AUTO_TEST_CASE(TestTypeLayoutCache) {
+  TupleTree<model::Binary> Model;
+  auto Int32 = model::PrimitiveType::makeSigned(4);
+  auto &Typedef = Model->makeTypedefDefinition(std::move(Int32)).first;
+
+  BOOST_TEST(model::TypeLayoutCache::current() == nullptr);
+  {
+    model::TypeLayoutCache Outer;
+    BOOST_TEST(model::TypeLayoutCache::current() == &Outer);
+    BOOST_TEST(*Typedef.size() == 4);
+    BOOST_TEST(Outer.sizes().size(Typedef).has_value());
+
+    {
+      model::TypeLayoutCache Inner;
+      BOOST_TEST(model::TypeLayoutCache::current() == &Inner);
+      BOOST_TEST(*Typedef.trySize() == 4);
+    }
+
+    BOOST_TEST(model::TypeLayoutCache::current() == &Outer);
+  }
+  BOOST_TEST(model::TypeLayoutCache::current() == nullptr);
 }
 
 BOOST_AUTO_TEST_CASE(TestTupleTreeDiff) {
@@ -255,6 +535,69 @@ BOOST_AUTO_TEST_CASE(TestTupleTreeDiff) {
   diff(Left, Right).dump();
 }
 
+BOOST_AUTO_TEST_CASE(TestTupleTreeDiffSkipsIdenticalSubtrees) {
+  model::Binary Left;
+  for (uint64_t I = 0; I < 16; ++I) {
+    MetaAddress Entry(0x1000 + I * 0x10, MetaAddressType::Code_aarch64);
+    Left.Functions()[Entry].OriginalName() = "function";
+  }
+
+  // Hashes are cached and survive copies
+  uint64_t InitialHash = tupletree::hash(Left);
+  model::Binary Right = Left;
+  BOOST_TEST(tupletree::hash(Right) == InitialHash);
+  BOOST_TEST(diff(Left, Right).Changes.empty());
+
+  // A change through the accessors invalidates the path to the root
+  MetaAddress Changed(0x1050, MetaAddressType::Code_aarch64);
+  Right.Functions().at(Changed).OriginalName() = "renamed";
+  BOOST_TEST(tupletree::hash(Right) != InitialHash);
+
+  auto Diff = diff(Left, Right);
+  BOOST_TEST(Diff.Changes.size() == 1U);
+
+  // Going back to the original content yields the original hash
+  Right.Functions().at(Changed).OriginalName() = "function";
+  BOOST_TEST(tupletree::hash(Right) == InitialHash);
+}
+
+BOOST_AUTO_TEST_CASE(TestTupleTreeDigestByPath) {
+  model::Binary Model;
+  MetaAddress First(0x1000, MetaAddressType::Code_aarch64);
+  MetaAddress Second(0x2000, MetaAddressType::Code_aarch64);
+  Model.Functions()[First].OriginalName() = "first";
+  Model.Functions()[Second].OriginalName() = "second";
+
+  using Visitor = pipeline::detail::DigestByPathVisitor;
+  auto DigestAt = [&Model](llvm::StringRef Path) -> std::optional<std::string> {
+    Visitor TheVisitor;
+    const model::Binary &AsConst = Model;
+    if (not callByPath(TheVisitor, *stringAsPath<model::Binary>(Path), AsConst))
+      return std::nullopt;
+    return TheVisitor.Result;
+  };
+
+  const char *FirstPath = "/Functions/0x1000:Code_aarch64";
+  const char *SecondPath = "/Functions/0x2000:Code_aarch64";
+  std::optional<std::string> FirstDigest = DigestAt(FirstPath);
+  std::optional<std::string> SecondDigest = DigestAt(SecondPath);
+  BOOST_TEST(FirstDigest.has_value());
+  BOOST_TEST(*FirstDigest == Visitor::digestOf(Model.Functions().at(First)));
+
+  // The digest only depends on the content, not on the object
+  model::Binary Copy = Model;
+  BOOST_TEST(Visitor::digestOf(Copy) == Visitor::digestOf(Model));
+
+  // Only the digests of the subtrees containing the change are affected
+  Model.Functions().at(First).OriginalName() = "renamed";
+  BOOST_TEST((DigestAt(FirstPath) != FirstDigest));
+  BOOST_TEST((DigestAt(SecondPath) == SecondDigest));
+
+  // Paths that lead nowhere have no digest
+  Model.Functions().erase(Second);
+  BOOST_TEST(not DigestAt(SecondPath).has_value());
+}
+
 BOOST_AUTO_TEST_CASE(TestTupleTreeDiffSerialization) {
   model::Binary Left;
   model::Binary Right;
@@ -406,3 +749,56 @@ BOOST_AUTO_TEST_CASE(CollectReadFieldsShouldCollectAllSegments) {
   };
   BOOST_TEST(Collected.ExactVectors == Paths);
 }
+
+BOOST_AUTO_TEST_CASE(RawBinaryViewResolvesAddressesAndOffsets) {
+  auto Generic = [](uint64_t Address) {
+    return MetaAddress::fromGeneric(llvm::Triple::x86_64, Address);
+  };
+
+  auto AddSegment = [&](Binary &Model,
+                        uint64_t Address,
+                        uint64_t Size,
+                        uint64_t Offset) {
+    Segment NewSegment(Generic(Address), Size);
+    NewSegment.StartOffset() = Offset;
+    NewSegment.FileSize() = Size;
+    Model.Segments().insert(std::move(NewSegment));
+  };
+
+  Binary Model;
+  Model.Architecture() = model::Architecture::x86_64;
+  AddSegment(Model, 0x1000, 0x100, 0x0);
+  AddSegment(Model, 0x2000, 0x100, 0x100);
+
+  // Overlaps the previous segment, both in the address and in the offset space
+  AddSegment(Model, 0x2080, 0x100, 0x180);
+
+  std::vector<uint8_t> Data(0x280);
+  for (size_t I = 0; I < Data.size(); ++I)
+    Data[I] = I;
+
+  RawBinaryView View(Model, Data);
+
+  // Sequential accesses within a segment
+  for (uint64_t I = 0; I < 0x100; ++I)
+    revng_check(View.addressToOffset(Generic(0x1000 + I)) == I);
+
+  revng_check(not View.addressToOffset(Generic(0x1100)));
+  revng_check(not View.addressToOffset(Generic(0x1000), 0x101));
+  revng_check(View.addressToOffset(Generic(0x2000)) == 0x100);
+  revng_check(View.addressToOffset(Generic(0x2100)) == 0x200);
+
+  // Addresses and offsets belonging to more than one segment are ambiguous
+  revng_check(not View.addressToOffset(Generic(0x2090)));
+  revng_check(not View.offsetToAddress(0x190).isValid());
+  revng_check(View.offsetToAddress(0x10) == Generic(0x1010));
+
+  revng_check(View.readInteger(Generic(0x1004), 1) == 4);
+
+  // Segments added afterwards are found, with or without reindexing
+  AddSegment(Model, 0x3000, 0x10, 0x0);
+  revng_check(View.addressToOffset(Generic(0x3008)) == 0x8);
+  View.reindexSegments();
+  revng_check(View.addressToOffset(Generic(0x3008)) == 0x8);
+  revng_check(not View.offsetToAddress(0x8).isValid());
+}
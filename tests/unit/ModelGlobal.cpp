@@ -0,0 +1,116 @@
+/// \file ModelGlobal.cpp
+/// Tests for the copies of the model made while running analyses.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+
+#include "revng/Model/Binary.h"
+#include "revng/Pipeline/Analysis.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/ExecutionContext.h"
+#include "revng/Pipeline/Kind.h"
+#include "revng/Pipeline/Runner.h"
+#include "revng/Pipeline/Step.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/TupleTree/TupleTree.h"
+
+#define BOOST_TEST_MODULE ModelGlobal
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+static constexpr const char *StepName = "first-step";
+
+static MetaAddress entry() {
+  return MetaAddress::fromGeneric(Triple::x86_64, 0x1000);
+}
+
+/// Reads the model, twice, without modifying it
+struct ReadModel {
+  static constexpr auto Name = "read-model";
+
+  std::vector<std::vector<pipeline::Kind *>> AcceptedKinds = {};
+
+  void run(pipeline::ExecutionContext &Ctx) {
+    for (unsigned I = 0; I < 2; ++I) {
+      const auto &Model = revng::getModelFromContext(Ctx);
+      revng_check(Model->Functions().count(entry()) == 1);
+    }
+  }
+};
+
+/// Renames the only function of the model
+struct RenameFunction {
+  static constexpr auto Name = "rename-function";
+
+  std::vector<std::vector<pipeline::Kind *>> AcceptedKinds = {};
+
+  void run(pipeline::ExecutionContext &Ctx) {
+    auto &Model = revng::getWritableModelFromContext(Ctx);
+    Model->Functions().at(entry()).CustomName() = "renamed";
+  }
+};
+
+/// \return the number of deep copies of a model performed while running
+///         \p AnalysisName on \p Pipeline
+static uint64_t copiesDuring(pipeline::Runner &Pipeline,
+                             llvm::StringRef AnalysisName) {
+  using Tree = TupleTree<model::Binary>;
+  uint64_t Before = Tree::getDeepCopiesCount();
+
+  pipeline::TargetInStepSet Invalidations;
+  cantFail(Pipeline.runAnalysis(AnalysisName, StepName, {}, Invalidations));
+
+  return Tree::getDeepCopiesCount() - Before;
+}
+
+struct Fixture {
+  Fixture() {
+    pipeline::Rank::init();
+    pipeline::Kind::init();
+  }
+};
+
+BOOST_AUTO_TEST_SUITE(ModelGlobalTestSuite,
+                      *boost::unit_test::fixture<Fixture>())
+
+BOOST_AUTO_TEST_CASE(AnalysesCopyTheModelOnlyIfTheyModifyIt) {
+  pipeline::Context Ctx;
+  Ctx.addGlobal<revng::ModelGlobal>(revng::ModelGlobalName);
+  revng::getWritableModelFromContext(Ctx)->Functions()[entry()];
+
+  pipeline::Runner Pipeline(Ctx);
+  pipeline::Step &Step = Pipeline.emplaceStep("", StepName, "");
+  using pipeline::AnalysisWrapper;
+  std::vector<std::string> NoContainers;
+  Step.addAnalysis(ReadModel::Name,
+                   AnalysisWrapper::make<ReadModel>(NoContainers));
+  Step.addAnalysis(RenameFunction::Name,
+                   AnalysisWrapper::make<RenameFunction>(NoContainers));
+
+  // Snapshotting the globals and reading the model share its root
+  BOOST_TEST(copiesDuring(Pipeline, ReadModel::Name) == 0);
+  BOOST_TEST(copiesDuring(Pipeline, ReadModel::Name) == 0);
+
+  // The first modification detaches the model from the snapshot, once
+  BOOST_TEST(copiesDuring(Pipeline, RenameFunction::Name) == 1);
+
+  const auto &Model = revng::getModelFromContext(Ctx);
+  BOOST_TEST(Model->Functions().at(entry()).CustomName() == "renamed");
+
+  BOOST_TEST(copiesDuring(Pipeline, ReadModel::Name) == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
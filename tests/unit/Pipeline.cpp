@@ -5,7 +5,10 @@
 //
 
 #include <algorithm>
+#include <atomic>
 #include <memory>
+#include <optional>
+#include <utility>
 
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallVector.h"
@@ -18,6 +21,7 @@
 #include "llvm/InitializePasses.h"
 #include "llvm/Pass.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -31,14 +35,18 @@
 #include "revng/Pipeline/Contract.h"
 #include "revng/Pipeline/Errors.h"
 #include "revng/Pipeline/GenericLLVMPipe.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
 #include "revng/Pipeline/Invokable.h"
 #include "revng/Pipeline/Kind.h"
+#include "revng/Pipeline/KindsRegistry.h"
 #include "revng/Pipeline/LLVMContainer.h"
 #include "revng/Pipeline/LLVMContainerFactory.h"
 #include "revng/Pipeline/LLVMKind.h"
 #include "revng/Pipeline/Loader.h"
+#include "revng/Pipeline/PathTargetBimap.h"
 #include "revng/Pipeline/Runner.h"
 #include "revng/Pipeline/Target.h"
+#include "revng/Storage/MemoryStorageClient.h"
 #include "revng/Support/Assert.h"
 
 #define BOOST_TEST_MODULE Pipeline
@@ -119,7 +127,7 @@ public:
     return { &FunctionKind, &RootKind };
   }
 
-  bool contains(const Target &T) const { return Map.contains(T); }
+  bool contains(const Target &T) const override { return Map.contains(T); }
 
   TargetsList enumerate() const final {
     TargetsList ToReturn;
@@ -274,6 +282,52 @@ BOOST_AUTO_TEST_CASE(PipeCanBeWrapper) {
   BOOST_TEST(Map.get({ {}, RootKind2 }) == 1);
 }
 
+BOOST_AUTO_TEST_CASE(TargetsListIsSortedAndUnique) {
+  TargetsList List;
+  List.push_back(Target("f2", FunctionKind));
+  List.push_back(Target("f1", FunctionKind));
+  List.push_back(Target("f2", FunctionKind));
+  BOOST_TEST(List.size() == 2U);
+  BOOST_TEST(std::is_sorted(List.begin(), List.end()));
+  BOOST_TEST(List.contains(Target("f1", FunctionKind)));
+  BOOST_TEST(not List.contains(Target("f3", FunctionKind)));
+
+  TargetsList Other;
+  Other.push_back(Target("f3", FunctionKind));
+  Other.push_back(Target("f1", FunctionKind));
+  List.merge(Other);
+  BOOST_TEST(List.size() == 3U);
+  BOOST_TEST(std::is_sorted(List.begin(), List.end()));
+
+  List.remove(Other);
+  BOOST_TEST(List.size() == 1U);
+  BOOST_TEST((List.front() == Target("f2", FunctionKind)));
+}
+
+BOOST_AUTO_TEST_CASE(KindsAreIndexed) {
+  KindsRegistry Registry({ &RootKind, &FunctionKind });
+  Registry.registerKind(RootKind3);
+  BOOST_TEST(Registry.size() == 3U);
+  BOOST_TEST(Registry.find("function-kind") == &FunctionKind);
+  BOOST_TEST(Registry.find("root-kind-3") == &RootKind3);
+  BOOST_TEST(Registry.find("root-kind-2") == nullptr);
+  BOOST_TEST(std::is_sorted(Registry.begin(),
+                            Registry.end(),
+                            [](const Kind &LHS, const Kind &RHS) {
+                              return LHS.name() < RHS.name();
+                            }));
+
+  BOOST_TEST(RootKind2.depth() == 0U);
+  BOOST_TEST(FunctionKind.depth() == 1U);
+
+  TargetsList List;
+  List.push_back(Target("f1", FunctionKind));
+  List.push_back(Target(RootKind3));
+  BOOST_TEST(List.containsKind(FunctionKind));
+  BOOST_TEST(List.containsKind(RootKind3));
+  BOOST_TEST(not List.containsKind(RootKind));
+}
+
 BOOST_AUTO_TEST_CASE(InputOutputContractExactPassForward) {
   ContainerToTargetsMap Targets;
   Targets[CName].emplace_back(Target({}, RootKind));
@@ -391,6 +445,52 @@ BOOST_AUTO_TEST_CASE(InputOutputContractExactExactFineGrainedForward) {
   BOOST_TEST((Targets[CName][0].getPathComponents().size() == 1));
 }
 
+class CountingFunctionKind : public SingleFunctionKind {
+public:
+  mutable size_t Enumerations = 0;
+
+public:
+  using SingleFunctionKind::SingleFunctionKind;
+
+  void appendAllTargets(const pipeline::Context &Ctx,
+                        pipeline::TargetsList &Out) const override {
+    ++Enumerations;
+    SingleFunctionKind::appendAllTargets(Ctx, Out);
+  }
+};
+static CountingFunctionKind CountingKind("counting-function-kind",
+                                         FunctionRank);
+
+BOOST_AUTO_TEST_CASE(MemoizedContractsEnumerateKindsOnce) {
+  Context Ctx;
+  ContractGroup Expand(RootKind, 0, CountingKind, 0);
+
+  ContainerToTargetsMap Root;
+  Root[CName].emplace_back(Target({}, RootKind));
+
+  ContainerToTargetsMap Expected = Root;
+  Expand.deduceResults(Ctx, Expected, { CName });
+  BOOST_TEST(Expected[CName].size() == 2U);
+  BOOST_TEST(CountingKind.Enumerations == 1U);
+
+  CountingKind.Enumerations = 0;
+  {
+    AllTargetsMemo Memo(Ctx);
+    BOOST_TEST(Ctx.getAllTargetsMemo() == &Memo);
+
+    for (int I = 0; I < 3; ++I) {
+      ContainerToTargetsMap Targets = Root;
+      Expand.deduceResults(Ctx, Targets, { CName });
+      BOOST_TEST((Targets[CName] == Expected[CName]));
+
+      auto Required = Expand.deduceRequirements(Ctx, Targets, { CName });
+      BOOST_TEST((Required[CName] == Root[CName]));
+    }
+  }
+  BOOST_TEST(CountingKind.Enumerations == 1U);
+  BOOST_TEST(Ctx.getAllTargetsMemo() == nullptr);
+}
+
 static void checkIfContains(auto &TargetRange, const Kind &K) {
   const auto ToFind = [&K](const Target &Target) {
     return &Target.getKind() == &K;
@@ -473,13 +573,40 @@ BOOST_AUTO_TEST_CASE(StepCanCloneAndRun) {
   auto Factory2 = getMapFactoryContainer();
   Containers.add(CName, Factory, Factory("dont-care"));
   cast<MapContainer>(Containers[CName]).get(Target({}, RootKind)) = 1;
-  auto Result = Step.run(std::move(Containers),
-                         std::vector({ PipeExecutionEntry({}, {}) }));
+  cantFail(Step.run(std::move(Containers),
+                    std::vector({ PipeExecutionEntry({}, {}) })));
 
-  auto &Cont = cast<MapContainer>(Result.at(CName));
+  auto &Cont = Step.containers().getOrCreate<MapContainer>(CName);
   BOOST_TEST(Cont.get(Target({}, RootKind2)) == 1);
 }
 
+BOOST_AUTO_TEST_CASE(CancelledStepIsNotMergedBack) {
+  Context Ctx;
+
+  ContainerSet Containers;
+  auto Factory = getMapFactoryContainer();
+  Containers.add(CName, Factory, Factory("dont-care"));
+  Step Step(Ctx,
+            "first-step",
+            "",
+            std::move(Containers),
+            PipeWrapper::bind<TestPipe>(CName, CName));
+
+  Containers = ContainerSet();
+  Containers.add(CName, Factory, Factory("dont-care"));
+  cast<MapContainer>(Containers[CName]).get(Target({}, RootKind)) = 1;
+
+  std::atomic<bool> Cancelled = true;
+  Ctx.setCancellationFlag(&Cancelled);
+  llvm::Error Error = Step.run(std::move(Containers),
+                               std::vector({ PipeExecutionEntry({}, {}) }));
+  Ctx.setCancellationFlag(nullptr);
+
+  BOOST_TEST(Error.isA<CancelledError>());
+  consumeError(std::move(Error));
+  BOOST_TEST(Step.containers().enumerate().empty());
+}
+
 BOOST_AUTO_TEST_CASE(PipelineCanBeManuallyExectued) {
   ContainerFactorySet Registry;
   Registry.registerDefaultConstructibleFactory<MapContainer>(CName);
@@ -496,12 +623,9 @@ BOOST_AUTO_TEST_CASE(PipelineCanBeManuallyExectued) {
   auto &C1 = Containers.getOrCreate<MapContainer>(CName);
   C1.get(Target(RootKind)) = 1;
 
-  auto
-    Res = Pip["first-step"]
-            .run(std::move(Containers),
-                 std::vector<PipeExecutionEntry>({ PipeExecutionEntry({},
-                                                                      {}) }));
-  BOOST_TEST(cast<MapContainer>(Res.at(CName)).get(Target(RootKind2)) == 1);
+  cantFail(Pip["first-step"].run(std::move(Containers),
+                                 std::vector<PipeExecutionEntry>(
+                                   { PipeExecutionEntry({}, {}) })));
   const auto &StartingContainer = Pip["first-step"]
                                     .containers()
                                     .getOrCreate<MapContainer>(CName);
@@ -541,6 +665,38 @@ BOOST_AUTO_TEST_CASE(SingleElementPipelineCanBeRunned) {
   BOOST_TEST(cast<MapContainer>(BC.at(CName)).get(Target(RootKind2)) == 1);
 }
 
+BOOST_AUTO_TEST_CASE(PipesWritingUnrequestedContainersAreSkipped) {
+  Context Ctx;
+  Runner Pipeline(Ctx);
+  const std::string OtherName = "other-container";
+  Pipeline.addDefaultConstructibleFactory<MapContainer>(CName);
+  Pipeline.addDefaultConstructibleFactory<MapContainer>(OtherName);
+
+  const std::string Name = "first-step";
+  Pipeline.emplaceStep("", Name, "");
+  Pipeline.emplaceStep(Name,
+                       "end",
+                       "",
+                       PipeWrapper::bind<TestPipe>(CName, CName),
+                       PipeWrapper::bind<TestPipe>(CName, OtherName));
+
+  auto &Container(Pipeline[Name].containers().getOrCreate<MapContainer>(CName));
+  Container.get(Target(RootKind)) = 1;
+
+  ContainerToTargetsMap Targets;
+  Targets[CName].emplace_back(Target(RootKind2));
+  auto Error = Pipeline.run("end", Targets);
+  BOOST_TEST(!Error);
+
+  ContainerSet &Containers = Pipeline["end"].containers();
+  BOOST_TEST(cast<MapContainer>(Containers.at(CName)).get(Target(RootKind2))
+             == 1);
+
+  // Nothing was requested from OtherName, the second pipe must not run
+  auto &Other = Containers.getOrCreate<MapContainer>(OtherName);
+  BOOST_TEST(Other.enumerate().empty());
+}
+
 class FineGrainPipe {
 
 public:
@@ -1056,6 +1212,343 @@ BOOST_AUTO_TEST_CASE(SingleElementPipelinestore) {
   BOOST_TEST(not Pipeline[Name].containers().contains(CName));
 }
 
+BOOST_AUTO_TEST_CASE(LoadedContainersAreDeserializedLazily) {
+  Context Ctx;
+  revng::DirectoryPath Path = getCurrentPath().getDirectory("lazy-load");
+  BOOST_TEST((!Path.create()));
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+  BOOST_TEST((!Containers.store(Path)));
+
+  // MapContainer does not write anything on its own, create the file that a
+  // real container would have written
+  auto MaybeFile = Path.getFile(CName).getWritableFile();
+  BOOST_TEST(!!MaybeFile);
+  BOOST_TEST((!MaybeFile.get()->commit()));
+
+  ContainerSet Loaded;
+  Loaded.add(CName, Factory);
+  BOOST_TEST((!Loaded.load(Ctx, Path)));
+
+  // Enumerating does not require deserializing the container
+  BOOST_TEST(Loaded.isPending(CName));
+  BOOST_TEST(Loaded.contains(CName));
+  BOOST_TEST(Loaded.enumerate(CName).contains(ExampleTarget));
+  BOOST_TEST(Loaded.isPending(CName));
+
+  // Accessing the container does
+  Loaded.at(CName);
+  BOOST_TEST(not Loaded.isPending(CName));
+}
+
+BOOST_AUTO_TEST_CASE(CloningPendingContainersKeepsThemPending) {
+  Context Ctx;
+  revng::DirectoryPath Path = getCurrentPath().getDirectory("lazy-clone");
+  BOOST_TEST((!Path.create()));
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+  BOOST_TEST((!Containers.store(Path)));
+
+  auto MaybeFile = Path.getFile(CName).getWritableFile();
+  BOOST_TEST(!!MaybeFile);
+  BOOST_TEST((!MaybeFile.get()->commit()));
+
+  ContainerSet Loaded;
+  Loaded.add(CName, Factory);
+  BOOST_TEST((!Loaded.load(Ctx, Path)));
+  BOOST_TEST(Loaded.isPending(CName));
+
+  TargetsList Requested({ ExampleTarget });
+  auto MaybeClone = Loaded.cloneFiltered(CName, Requested);
+  BOOST_TEST(!!MaybeClone);
+  BOOST_TEST(Loaded.isPending(CName));
+}
+
+BOOST_AUTO_TEST_CASE(RemovingFromPendingContainersSkipsLoading) {
+  Context Ctx;
+  revng::DirectoryPath Path = getCurrentPath().getDirectory("lazy-remove");
+  BOOST_TEST((!Path.create()));
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+  BOOST_TEST((!Containers.store(Path)));
+
+  auto MaybeFile = Path.getFile(CName).getWritableFile();
+  BOOST_TEST(!!MaybeFile);
+  BOOST_TEST((!MaybeFile.get()->commit()));
+
+  ContainerSet Loaded;
+  Loaded.add(CName, Factory);
+  BOOST_TEST((!Loaded.load(Ctx, Path)));
+
+  // Removing targets the container does not have leaves it on disk
+  ContainerToTargetsMap Missing;
+  Missing.add(CName, TargetsList({ Target("f1", FunctionKind) }));
+  auto Error = Loaded.remove(Missing);
+  BOOST_TEST(!!Error);
+  llvm::consumeError(std::move(Error));
+  BOOST_TEST(Loaded.isPending(CName));
+
+  // Removing all of them does not need its content at all
+  ContainerToTargetsMap All;
+  All.add(CName, TargetsList({ ExampleTarget }));
+  BOOST_TEST((!Loaded.remove(All)));
+  BOOST_TEST(not Loaded.isPending(CName));
+  BOOST_TEST(Loaded.contains(CName));
+  BOOST_TEST(Loaded.enumerate(CName).empty());
+}
+
+class PrefetchRecordingStorageClient : public revng::MemoryStorageClient {
+public:
+  std::vector<std::string> Prefetched;
+
+  void prefetch(llvm::ArrayRef<std::string> Paths) override {
+    llvm::append_range(Prefetched, Paths);
+  }
+};
+
+BOOST_AUTO_TEST_CASE(PrefetchOnlyRequestsPendingContainers) {
+  Context Ctx;
+  PrefetchRecordingStorageClient Storage;
+  revng::DirectoryPath Path = Storage.root();
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+  BOOST_TEST((!Containers.store(Path)));
+
+  auto MaybeFile = Path.getFile(CName).getWritableFile();
+  BOOST_TEST(!!MaybeFile);
+  BOOST_TEST((!MaybeFile.get()->commit()));
+
+  ContainerToTargetsMap Requested;
+  Requested.add(CName, TargetsList({ ExampleTarget }));
+
+  // Nothing to fetch for containers that are in memory already
+  Containers.prefetch(Requested);
+  BOOST_TEST(Storage.Prefetched.empty());
+
+  ContainerSet Loaded;
+  Loaded.add(CName, Factory);
+  BOOST_TEST((!Loaded.load(Ctx, Path)));
+
+  // Nor for pending containers nothing is requested from
+  Loaded.prefetch(ContainerToTargetsMap());
+  BOOST_TEST(Storage.Prefetched.empty());
+
+  Loaded.prefetch(Requested);
+  BOOST_TEST(Storage.Prefetched.size() == 1);
+  BOOST_TEST(Storage.Prefetched[0] == CName);
+  BOOST_TEST(Loaded.isPending(CName));
+}
+
+BOOST_AUTO_TEST_CASE(EvictedContainersAreLoadedBackOnAccess) {
+  revng::DirectoryPath Path = getCurrentPath().getDirectory("evict");
+  BOOST_TEST((!Path.create()));
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+  const auto *Entry = &*Containers.find(CName);
+
+  BOOST_TEST((!Containers.evict(CName, Path)));
+
+  // The entry stays valid and the targets can still be enumerated
+  BOOST_TEST(Containers.isPending(CName));
+  BOOST_TEST(Entry->second != nullptr);
+  BOOST_TEST(Containers.enumerate(CName).contains(ExampleTarget));
+  BOOST_TEST(Containers.memoryUsage(CName) == 0);
+
+  Containers.at(CName);
+  BOOST_TEST(not Containers.isPending(CName));
+  BOOST_TEST(Containers.getLastAccess(CName) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(StoreSkipsUnchangedContainers) {
+  revng::DirectoryPath Path = getCurrentPath().getDirectory("store-unchanged");
+  BOOST_TEST((!Path.create()));
+  revng::FilePath TargetsFile = Path.getFile(CName + ".targets");
+  auto TargetsFileExists = [&TargetsFile]() {
+    auto MaybeExists = TargetsFile.exists();
+    revng_check(!!MaybeExists);
+    return *MaybeExists;
+  };
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+  BOOST_TEST((!Containers.store(Path)));
+  BOOST_TEST(Containers.isStoredAt(CName, Path.getFile(CName)));
+
+  // Nothing has changed, nothing is written
+  BOOST_TEST((!TargetsFile.remove()));
+  std::as_const(Containers).at(CName);
+  BOOST_TEST((!Containers.store(Path)));
+  BOOST_TEST(not TargetsFileExists());
+
+  // Any non-const access is considered a change
+  Containers.get<MapContainer>(CName).get(ExampleTarget) = 2;
+  BOOST_TEST(not Containers.isStoredAt(CName, Path.getFile(CName)));
+  BOOST_TEST((!Containers.store(Path)));
+  BOOST_TEST(TargetsFileExists());
+}
+
+BOOST_AUTO_TEST_CASE(SnapshotIsNotAffectedByLaterChanges) {
+  revng::DirectoryPath Path = getCurrentPath().getDirectory("snapshot");
+  BOOST_TEST((!Path.create()));
+
+  auto Factory = getMapFactoryContainer();
+  ContainerSet Containers;
+  Containers.add(CName, Factory);
+  Containers.getOrCreate<MapContainer>(CName).get(ExampleTarget) = 1;
+
+  revng::MemoryStorageClient Memory;
+  auto MaybeSnapshot = Containers.snapshot(Path, Memory.root());
+  BOOST_TEST(!!MaybeSnapshot);
+  BOOST_TEST(Containers.isStoredAt(CName, Path.getFile(CName)));
+
+  // Changes after the snapshot do not end up in the execution directory
+  Containers.get<MapContainer>(CName).get(ExampleTarget) = 2;
+  BOOST_TEST((!Memory.writeTo(Path)));
+  BOOST_TEST((!MaybeSnapshot->store()));
+
+  Context Ctx;
+  ContainerSet Loaded;
+  Loaded.add(CName, Factory);
+  BOOST_TEST((!Loaded.load(Ctx, Path)));
+  BOOST_TEST(Loaded.get<MapContainer>(CName).get(ExampleTarget) == 1);
+}
+
+BOOST_AUTO_TEST_CASE(IdenticalFilesAreStoredOnce) {
+  llvm::SmallString<128> Root;
+  llvm::sys::fs::current_path(Root);
+  llvm::sys::path::append(Root, "deduplicated");
+  BOOST_TEST(!llvm::sys::fs::create_directories(Root));
+
+  auto MaybeClient = revng::StorageClient::fromPathOrURL(Root);
+  BOOST_TEST(!!MaybeClient);
+  revng::DirectoryPath Path(MaybeClient->get(), "");
+
+  auto Write = [&](llvm::StringRef Name, llvm::StringRef Content) {
+    auto MaybeFile = Path.getFile(Name).getWritableFile();
+    BOOST_TEST(!!MaybeFile);
+    MaybeFile.get()->os() << Content;
+    BOOST_TEST((!MaybeFile.get()->commit()));
+    BOOST_TEST((!MaybeClient.get()->commit()));
+  };
+
+  auto LinkCount = [&](llvm::StringRef Name) {
+    llvm::SmallString<128> FullPath(Root);
+    llvm::sys::path::append(FullPath, Name);
+    llvm::sys::fs::file_status Status;
+    BOOST_TEST(!llvm::sys::fs::status(FullPath, Status));
+    return Status.getLinkCount();
+  };
+
+  // Both paths and the blob are the same file
+  Write("first", "content");
+  Write("second", "content");
+  BOOST_TEST(LinkCount("first") == 3);
+
+  // Copies are links too
+  BOOST_TEST((!Path.getFile("first").copyTo(Path.getFile("third"))));
+  BOOST_TEST((!MaybeClient.get()->commit()));
+  BOOST_TEST(LinkCount("first") == 4);
+
+  // Writing a path does not affect the others
+  Write("first", "other content");
+  BOOST_TEST(LinkCount("first") == 2);
+  BOOST_TEST(LinkCount("second") == 3);
+  auto MaybeSecond = Path.getFile("second").getReadableFile();
+  BOOST_TEST(!!MaybeSecond);
+  BOOST_TEST(MaybeSecond.get()->buffer().getBuffer() == "content");
+
+  // Blobs nothing refers to are dropped on commit
+  BOOST_TEST((!Path.getFile("second").remove()));
+  BOOST_TEST((!Path.getFile("third").remove()));
+  BOOST_TEST((!MaybeClient.get()->commit()));
+  BOOST_TEST(LinkCount("first") == 2);
+  unsigned Blobs = 0;
+  std::error_code EC;
+  llvm::SmallString<128> BlobsPath(Root);
+  llvm::sys::path::append(BlobsPath, ".blobs");
+  for (llvm::sys::fs::directory_iterator It(BlobsPath, EC), End;
+       It != End and not EC;
+       It.increment(EC))
+    ++Blobs;
+  BOOST_TEST(Blobs == 1);
+}
+
+BOOST_AUTO_TEST_CASE(ChangesAreVisibleToOthersOnlyOnCommit) {
+  llvm::SmallString<128> Root;
+  llvm::sys::fs::current_path(Root);
+  llvm::sys::path::append(Root, "journaled");
+  llvm::sys::fs::remove_directories(Root);
+  BOOST_TEST(!llvm::sys::fs::create_directories(Root));
+
+  auto Open = [&]() {
+    auto MaybeClient = revng::StorageClient::fromPathOrURL(Root);
+    BOOST_TEST(!!MaybeClient);
+    return std::move(*MaybeClient);
+  };
+
+  auto Write = [](revng::StorageClient &Client,
+                  llvm::StringRef Name,
+                  llvm::StringRef Content) {
+    revng::DirectoryPath Path(&Client, "");
+    auto MaybeFile = Path.getFile(Name).getWritableFile();
+    BOOST_TEST(!!MaybeFile);
+    MaybeFile.get()->os() << Content;
+    BOOST_TEST((!MaybeFile.get()->commit()));
+  };
+
+  auto Read = [](revng::StorageClient &Client,
+                 llvm::StringRef Name) -> std::optional<std::string> {
+    revng::DirectoryPath Path(&Client, "");
+    auto MaybeExists = Path.getFile(Name).exists();
+    BOOST_TEST(!!MaybeExists);
+    if (not *MaybeExists)
+      return std::nullopt;
+
+    auto MaybeFile = Path.getFile(Name).getReadableFile();
+    BOOST_TEST(!!MaybeFile);
+    return MaybeFile.get()->buffer().getBuffer().str();
+  };
+
+  auto Writer = Open();
+  Write(*Writer, "file", "old");
+  BOOST_TEST((!Writer->commit()));
+
+  // The writer sees its own changes, the others only once committed
+  Write(*Writer, "file", "new");
+  Write(*Writer, "added", "content");
+  BOOST_TEST((!revng::FilePath(Writer.get(), "file").remove()));
+  BOOST_TEST((Read(*Writer, "file") == std::nullopt));
+  BOOST_TEST((Read(*Writer, "added") == "content"));
+  BOOST_TEST((Read(*Open(), "file") == "old"));
+  BOOST_TEST((Read(*Open(), "added") == std::nullopt));
+
+  BOOST_TEST((!Writer->commit()));
+  BOOST_TEST((Read(*Open(), "file") == std::nullopt));
+  BOOST_TEST((Read(*Open(), "added") == "content"));
+
+  // Changes which are never committed are lost
+  Write(*Writer, "added", "lost");
+  Writer.reset();
+  BOOST_TEST((Read(*Open(), "added") == "content"));
+}
+
 BOOST_AUTO_TEST_CASE(SingleElementPipelinestoreWithOverrides) {
   Context Ctx;
   Loader Loader(Ctx);
@@ -1282,6 +1775,34 @@ BOOST_AUTO_TEST_CASE(InspectorKindTest) {
   BOOST_TEST(Container->enumerate().contains(RootF));
 }
 
+BOOST_AUTO_TEST_CASE(LLVMContainerMergesBodiesInPlace) {
+  Context Ctx;
+  llvm::LLVMContext C;
+
+  using Cont = LLVMContainer;
+  auto Factory = ContainerFactory::fromGlobal<Cont>(&Ctx, &C);
+
+  auto Destination = Factory("destination");
+  llvm::Module &DestinationModule = cast<Cont>(*Destination).getModule();
+  makeF(DestinationModule, "root");
+  auto *VoidType = llvm::Type::getVoidTy(C);
+  DestinationModule.getOrInsertFunction("f1",
+                                        llvm::FunctionType::get(VoidType, {}));
+
+  auto Source = Factory("source");
+  makeF(cast<Cont>(*Source).getModule(), "f1");
+
+  Destination->mergeBack(std::move(*Source));
+
+  const llvm::Function *F1 = DestinationModule.getFunction("f1");
+  BOOST_TEST(F1 != nullptr);
+  BOOST_TEST(not F1->isDeclaration());
+  BOOST_TEST(DestinationModule.getFunction("root") != nullptr);
+
+  Target F1Target({ "f1" }, InspKindExample);
+  BOOST_TEST(Destination->enumerate().contains(F1Target));
+}
+
 BOOST_AUTO_TEST_CASE(MultiStepInvalidationTest) {
   Context Ctx;
   Runner Pipeline(Ctx);
@@ -1370,4 +1891,122 @@ BOOST_AUTO_TEST_CASE(PipeOptions) {
     BOOST_FAIL("unreachable");
 }
 
+BOOST_AUTO_TEST_CASE(CorruptedMetadataCountsAreRejected) {
+  InvalidationMetadataVector Metadata;
+  NamedPathTargetBimapVector &Model = Metadata.emplace_back();
+  Model.GlobalName = "model.yml";
+  auto &[Entry, Paths] = Model.Map.Data.emplace_back();
+  Entry.SerializedTarget = "f1:function-kind";
+  Entry.PipeName = "pipe";
+  Paths.push_back("/Functions");
+
+  std::string Buffer;
+  llvm::raw_string_ostream OS(Buffer);
+  writeBinaryInvalidationMetadata(OS, Metadata);
+  OS.flush();
+  BOOST_TEST(!!parseInvalidationMetadata(Buffer));
+
+  // Magic and version are followed by the number of strings, the buffer ends
+  // with the number of paths of the only entry and the only path
+  for (size_t Offset : { size_t(12), Buffer.size() - 8 }) {
+    std::string Corrupted = Buffer;
+    llvm::support::endian::write32le(Corrupted.data() + Offset, 0xFFFFFFFF);
+    auto MaybeParsed = parseInvalidationMetadata(Corrupted);
+    BOOST_TEST(not MaybeParsed);
+    llvm::consumeError(MaybeParsed.takeError());
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_CASE(PathTargetBimapBulkInsertion) {
+  auto MakePath = [](size_t Index) {
+    TupleTreePath Path;
+    Path.push_back(Index);
+    return Path;
+  };
+
+  std::vector<TargetInContainer> Targets;
+  Targets.emplace_back(Target("f1", FunctionKind), CName);
+  Targets.emplace_back(Target("f2", FunctionKind), CName);
+
+  PathTargetBimap OneByOne;
+  OneByOne.insert(Targets[0], MakePath(1));
+  OneByOne.insert(Targets[1], MakePath(0));
+  OneByOne.insert(Targets[1], MakePath(1));
+
+  // Out of order and with duplicates
+  PathTargetBimap::IndexedReads Reads;
+  Reads.emplace_back(MakePath(1), 1);
+  Reads.emplace_back(MakePath(1), 0);
+  Reads.emplace_back(MakePath(0), 1);
+  Reads.emplace_back(MakePath(1), 0);
+
+  PathTargetBimap Bulk;
+  Bulk.insert(Targets, std::move(Reads));
+
+  auto Dump = [](const PathTargetBimap &Bimap) {
+    std::vector<std::pair<TupleTreePath, TargetInContainer>> Result;
+    for (const auto &[Path, Located] : Bimap)
+      for (const TargetInContainer &Entry : Located)
+        Result.emplace_back(Path, Entry);
+    return Result;
+  };
+  BOOST_TEST((Dump(Bulk) == Dump(OneByOne)));
+
+  // Removing a target cleans up after the bulk insertion too
+  Bulk.remove(TargetsList::List{ Target("f2", FunctionKind) }, CName);
+  BOOST_TEST(not Bulk.contains(Targets[1]));
+  BOOST_TEST(Bulk.contains(Targets[0]));
+  BOOST_TEST((Bulk.find(MakePath(0)) == Bulk.end()));
+  BOOST_TEST(Bulk.find(MakePath(1))->second.size() == 1U);
+}
+
+BOOST_AUTO_TEST_CASE(PathTargetBimapExtraction) {
+  auto MakePath = [](size_t Index) {
+    TupleTreePath Path;
+    Path.push_back(Index);
+    return Path;
+  };
+
+  TargetInContainer F1(Target("f1", FunctionKind), CName);
+  TargetInContainer F2(Target("f2", FunctionKind), CName);
+  TargetInContainer Other(Target("f1", FunctionKind), CName + "2");
+
+  PathTargetBimap Bimap;
+  Bimap.insert(F1, MakePath(0));
+  Bimap.insert(F1, MakePath(1));
+  Bimap.insert(F2, MakePath(1));
+  Bimap.insert(Other, MakePath(2));
+
+  // Only what f1 in CName has been produced from is extracted
+  auto Extracted = Bimap.extract(TargetsList::List{ F1.getTarget() }, CName);
+  BOOST_TEST(Extracted.contains(F1));
+  BOOST_TEST(not Extracted.contains(F2));
+  BOOST_TEST(not Extracted.contains(Other));
+  BOOST_TEST(Extracted.find(MakePath(0))->second.size() == 1U);
+  BOOST_TEST(Extracted.find(MakePath(1))->second.size() == 1U);
+  BOOST_TEST((Extracted.find(MakePath(2)) == Extracted.end()));
+}
+
+BOOST_AUTO_TEST_CASE(ShardsPartitionTargets) {
+  TargetsList Targets;
+  for (size_t I = 0; I < 100; ++I)
+    Targets.push_back(Target("f" + std::to_string(I), FunctionKind));
+
+  constexpr unsigned ShardCount = 4;
+  TargetsList Merged;
+  size_t Total = 0;
+  for (unsigned Shard = 0; Shard < ShardCount; ++Shard) {
+    TargetsList ShardTargets = selectShard(Targets, Shard, ShardCount);
+    BOOST_TEST((ShardTargets == selectShard(Targets, Shard, ShardCount)));
+    Total += ShardTargets.size();
+    Merged.merge(ShardTargets);
+  }
+
+  // Each target ends up in exactly one shard
+  BOOST_TEST(Total == Targets.size());
+  BOOST_TEST((Merged == Targets));
+
+  BOOST_TEST((selectShard(Targets, 0, 1) == Targets));
+}
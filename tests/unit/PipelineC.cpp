@@ -5,6 +5,11 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
 #include "revng/PipelineC/PipelineC.h"
 
 #define BOOST_TEST_MODULE PipelineC
@@ -58,4 +63,87 @@ BOOST_AUTO_TEST_CASE(CAPILoadTest) {
   BOOST_TEST(rp_manager_get_kind_from_name(Manager, "root") != nullptr);
 }
 
+/// Produces f1 in strings-2 of first-step with a new manager working on
+/// \p Directory
+static std::string produceWithNewManager(llvm::StringRef Directory) {
+  const char *PipelineText[1] = { PipelineTextContent };
+  std::string DirectoryString = Directory.str();
+  rp_manager *Fresh = rp_manager_create_from_string(1,
+                                                    PipelineText,
+                                                    0,
+                                                    {},
+                                                    DirectoryString.c_str());
+  revng_check(Fresh != nullptr);
+
+  rp_step *Begin = rp_manager_get_step_from_name(Fresh, "begin");
+  revng_check(rp_manager_container_deserialize(Fresh,
+                                               Begin,
+                                               "strings-1",
+                                               "f1\n",
+                                               3,
+                                               nullptr));
+
+  rp_step *Step = rp_manager_get_step_from_name(Fresh, "first-step");
+  const rp_container_identifier
+    *Identifier = rp_manager_get_container_identifier_from_name(Fresh,
+                                                                "strings-2");
+  rp_container *Container = rp_step_get_container(Step, Identifier);
+  const rp_kind *Kind = rp_manager_get_kind_from_name(Fresh, "string-kind");
+  const char *Components[] = { "f1" };
+  rp_target *Target = rp_target_create(Kind, 1, Components);
+  const rp_target *Targets[] = { Target };
+
+  rp_buffer *Produced = rp_manager_produce_targets(Fresh,
+                                                   Step,
+                                                   Container,
+                                                   1,
+                                                   Targets,
+                                                   nullptr);
+  revng_check(Produced != nullptr);
+  std::string Result(rp_buffer_data(Produced), rp_buffer_size(Produced));
+
+  rp_buffer_destroy(Produced);
+  rp_target_destroy(Target);
+  rp_manager_destroy(Fresh);
+  return Result;
+}
+
+BOOST_AUTO_TEST_CASE(ArtifactCacheIsSharedAcrossManagers) {
+  auto &Options = llvm::cl::getRegisteredOptions();
+  llvm::cl::Option *Option = Options.lookup("artifact-cache");
+  revng_check(Option != nullptr);
+  auto *UseCache = static_cast<llvm::cl::opt<bool> *>(Option);
+  UseCache->setValue(true);
+
+  llvm::SmallString<128> Directory;
+  revng_check(not llvm::sys::fs::createUniqueDirectory("revng-artifact-cache",
+                                                       Directory));
+
+  auto CountCacheEntries = [&Directory]() {
+    llvm::SmallString<128> CacheDirectory(Directory);
+    llvm::sys::path::append(CacheDirectory, "artifact-cache");
+
+    size_t Result = 0;
+    std::error_code EC;
+    using llvm::sys::fs::directory_iterator;
+    for (directory_iterator It(CacheDirectory, EC), End; It != End and not EC;
+         It.increment(EC))
+      ++Result;
+    return Result;
+  };
+
+  // The list of reads and the artifact
+  std::string First = produceWithNewManager(Directory);
+  BOOST_TEST(CountCacheEntries() == 2U);
+
+  // A manager which has never seen the first one finds the same keys: had
+  // they changed, a new artifact would have been stored
+  std::string Second = produceWithNewManager(Directory);
+  BOOST_TEST(CountCacheEntries() == 2U);
+  BOOST_TEST(First == Second);
+
+  UseCache->setValue(false);
+  llvm::sys::fs::remove_directories(Directory);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -37,8 +37,8 @@ public:
   ~Fixture() { rp_shutdown(); }
 };
 
-static void verifyTrace(tracing::Trace &Trace) {
-  BOOST_TEST(Trace.Version == 1ULL);
+static void verifyTrace(tracing::Trace &Trace, uint64_t Version = 1) {
+  BOOST_TEST(Trace.Version == Version);
   BOOST_TEST(Trace.Commands.size() == 4ULL);
   BOOST_TEST(Trace.Commands[0].Name == "rp_manager_create");
   BOOST_TEST(Trace.Commands[1].Name == "rp_manager_get_step_from_name");
@@ -111,4 +111,52 @@ BOOST_AUTO_TEST_CASE(PipelineCTraceTest) {
   verifyTrace(Trace2);
 }
 
+BOOST_AUTO_TEST_CASE(PipelineCBinaryTraceTest) {
+  using tracing::TraceFormat;
+  llvm::ExitOnError AbortOnError;
+  std::string Buffer;
+
+  {
+    llvm::raw_string_ostream OS(Buffer);
+    tracing::setTracing(&OS, TraceFormat::Binary);
+
+    rp_manager *Manager = rp_manager_create(0, {}, "");
+    rp_manager_get_step_from_name(Manager, "begin");
+    rp_manager_get_step_from_name(Manager, "first-step");
+    rp_manager_destroy(Manager);
+
+    tracing::setTracing(nullptr);
+  }
+
+  auto MemoryBuffer = llvm::MemoryBuffer::getMemBuffer(Buffer);
+  auto MaybeTrace = tracing::Trace::fromBuffer(*MemoryBuffer);
+  BOOST_TEST(!!MaybeTrace);
+  tracing::Trace Trace = *MaybeTrace;
+  verifyTrace(Trace, 2);
+
+  // A trace cut short by a crash keeps its last, incomplete, command
+  Buffer.pop_back();
+  MemoryBuffer = llvm::MemoryBuffer::getMemBuffer(Buffer);
+  auto MaybeTruncated = tracing::Trace::fromBuffer(*MemoryBuffer);
+  BOOST_TEST(!!MaybeTruncated);
+  BOOST_TEST(MaybeTruncated->Commands.size() == 4ULL);
+  BOOST_TEST(MaybeTruncated->Commands[3].EndTime == 0ULL);
+
+  Buffer.clear();
+  {
+    llvm::raw_string_ostream OS(Buffer);
+    tracing::setTracing(&OS, TraceFormat::Binary);
+
+    AbortOnError(Trace.run());
+
+    tracing::setTracing(nullptr);
+  }
+
+  MemoryBuffer = llvm::MemoryBuffer::getMemBuffer(Buffer);
+  auto MaybeTrace2 = tracing::Trace::fromBuffer(*MemoryBuffer);
+  BOOST_TEST(!!MaybeTrace2);
+  tracing::Trace Trace2 = *MaybeTrace2;
+  verifyTrace(Trace2, 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
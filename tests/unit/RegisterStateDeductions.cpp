@@ -158,4 +158,25 @@ BOOST_AUTO_TEST_CASE(ForbiddenRegisterFail) {
   revng_check(not Result.has_value());
 }
 
+BOOST_AUTO_TEST_CASE(LookupTables) {
+  const auto &ABI = abi::Definition::get(model::ABI::Microsoft_x86_64);
+
+  auto Architecture = model::ABI::getRegisterArchitecture(ABI.ABI());
+  for (auto Register : model::Architecture::registers(Architecture)) {
+    bool IsArgument = llvm::is_contained(ABI.GeneralPurposeArgumentRegisters(),
+                                         Register)
+                      or llvm::is_contained(ABI.VectorArgumentRegisters(),
+                                            Register);
+    revng_check(ABI.isArgumentRegister(Register) == IsArgument);
+
+    bool IsCalleeSaved = llvm::is_contained(ABI.CalleeSavedRegisters(),
+                                            Register);
+    revng_check(ABI.isCalleeSavedRegister(Register) == IsCalleeSaved);
+  }
+
+  for (const abi::ScalarType &Scalar : ABI.ScalarTypes())
+    revng_check(ABI.scalarAlignment(Scalar.Size()) == Scalar.alignedAt());
+  revng_check(not ABI.scalarAlignment(3).has_value());
+}
+
 BOOST_AUTO_TEST_SUITE_END();
@@ -395,3 +395,32 @@ BOOST_AUTO_TEST_CASE(ReachingDefinitionsTest) {
                          { Operation(OperationType::Write, 0) });
   revng_assert(Result[0]);
 }
+
+BOOST_AUTO_TEST_CASE(DenseMaximalFixedPointTest) {
+  auto Graph = createLoop({ Operation(OperationType::Write, 0) },
+                          { Operation(OperationType::Read, 1) },
+                          { Operation(OperationType::Write, 1) },
+                          { Operation(OperationType::Read, 0) });
+  ReachingDefinitions RD(Graph.Function);
+  auto Dense = MFP::getDenseMaximalFixedPoint(RD,
+                                              &Graph.Function,
+                                              RD.defaultValue(),
+                                              RD.defaultValue(),
+                                              { Graph.Entry },
+                                              { Graph.Entry });
+  auto Map = MFP::getMaximalFixedPoint(RD,
+                                       &Graph.Function,
+                                       RD.defaultValue(),
+                                       RD.defaultValue(),
+                                       { Graph.Entry },
+                                       { Graph.Entry });
+
+  // Labels are numbered in reverse post order
+  revng_check(Dense.indexOf(Graph.Entry) == 0);
+
+  revng_check(Dense.size() == Map.size());
+  for (BlockNode *Node : Dense.labels()) {
+    revng_check(Dense.at(Node).InValue == Map.at(Node).InValue);
+    revng_check(Dense.at(Node).OutValue == Map.at(Node).OutValue);
+  }
+}
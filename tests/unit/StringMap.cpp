@@ -0,0 +1,108 @@
+/// \file StringMap.cpp
+/// Tests for the string map containers.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <string>
+
+#include "llvm/Support/Casting.h"
+
+#include "revng/Pipeline/ContainerFactory.h"
+#include "revng/Pipeline/ContainerSet.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Kind.h"
+#include "revng/Pipeline/Rank.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/Kinds.h"
+#include "revng/Pipes/StringMap.h"
+#include "revng/Storage/MemoryStorageClient.h"
+#include "revng/Support/MetaAddress.h"
+
+#define BOOST_TEST_MODULE StringMap
+bool init_unit_test();
+#include "boost/test/unit_test.hpp"
+
+#include "revng/UnitTestHelpers/UnitTestHelpers.h"
+
+using namespace llvm;
+
+inline constexpr char TestMapName[] = "test-string-map";
+inline constexpr char TestMapMIME[] = "text/plain+tar+gz";
+inline constexpr char TestMapSuffix[] = ".txt";
+
+using TestMap = revng::pipes::FunctionStringMap<&revng::kinds::CFG,
+                                                TestMapName,
+                                                TestMapMIME,
+                                                TestMapSuffix>;
+
+static constexpr const char *CName = "strings";
+static constexpr unsigned EntriesCount = 8;
+
+static MetaAddress entryOf(unsigned Index) {
+  return MetaAddress::fromGeneric(Triple::x86_64, 0x1000 + Index * 0x10);
+}
+
+static pipeline::Target targetOf(unsigned Index) {
+  return pipeline::Target(entryOf(Index).toString(), revng::kinds::CFG);
+}
+
+static std::string contentOf(unsigned Index) {
+  return "content of entry " + std::to_string(Index);
+}
+
+struct Fixture {
+  Fixture() {
+    pipeline::Rank::init();
+    pipeline::Kind::init();
+  }
+};
+
+BOOST_AUTO_TEST_SUITE(StringMapTestSuite,
+                      *boost::unit_test::fixture<Fixture>())
+
+BOOST_AUTO_TEST_CASE(FilteredLoadsReadOnlyTheRequestedEntries) {
+  revng::MemoryStorageClient Storage;
+  revng::DirectoryPath Path = Storage.root();
+
+  auto Factory = pipeline::ContainerFactory::create<TestMap>();
+  pipeline::ContainerSet Containers;
+  Containers.add(CName, Factory);
+  auto &Stored = Containers.getOrCreate<TestMap>(CName);
+  for (unsigned I = 0; I < EntriesCount; ++I)
+    Stored[entryOf(I)] = contentOf(I);
+  BOOST_TEST((!Containers.store(Path)));
+
+  pipeline::TargetsList Requested({ targetOf(1), targetOf(5) });
+
+  // Reading the container directly only decompresses the requested entries
+  TestMap Filtered(CName);
+  BOOST_TEST((!Filtered.loadCachedFiltered(Path.getFile(CName), Requested)));
+  BOOST_TEST((Filtered.enumerate() == Requested));
+  BOOST_TEST(Filtered.at(entryOf(1)) == contentOf(1));
+  BOOST_TEST(Filtered.at(entryOf(5)) == contentOf(5));
+
+  // Cloning a pending container goes through the same path, and leaves the
+  // container pending, with all of its entries still available
+  pipeline::Context Ctx;
+  pipeline::ContainerSet Loaded;
+  Loaded.add(CName, Factory);
+  BOOST_TEST((!Loaded.load(Ctx, Path)));
+  BOOST_TEST(Loaded.isPending(CName));
+
+  auto MaybeClone = Loaded.cloneFiltered(CName, Requested);
+  BOOST_TEST(!!MaybeClone);
+  const auto &Clone = llvm::cast<TestMap>(**MaybeClone);
+  BOOST_TEST((Clone.enumerate() == Requested));
+  BOOST_TEST(Clone.at(entryOf(5)) == contentOf(5));
+  BOOST_TEST(Loaded.isPending(CName));
+
+  const auto &Full = llvm::cast<TestMap>(Loaded.at(CName));
+  BOOST_TEST(not Loaded.isPending(CName));
+  BOOST_TEST(Full.enumerate().size() == EntriesCount);
+  for (unsigned I = 0; I < EntriesCount; ++I)
+    BOOST_TEST(Full.at(entryOf(I)) == contentOf(I));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
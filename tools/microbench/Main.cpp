@@ -0,0 +1,1006 @@
+/// \file Main.cpp
+/// \brief Measures the core data structures and algorithms in isolation
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Regex.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/ADT/GenericGraph.h"
+#include "revng/ADT/SortedVector.h"
+#include "revng/GraphLayout/Graphs.h"
+#include "revng/GraphLayout/SugiyamaStyle/Compute.h"
+#include "revng/MFP/MFP.h"
+#include "revng/MFP/SetLattices.h"
+#include "revng/Model/Binary.h"
+#include "revng/Pipeline/Context.h"
+#include "revng/Pipeline/Global.h"
+#include "revng/Pipeline/InvalidationMetadata.h"
+#include "revng/Pipeline/Kind.h"
+#include "revng/Pipeline/LLVMContainer.h"
+#include "revng/Pipeline/Rank.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/GzipTarFile.h"
+#include "revng/Support/InitRevng.h"
+#include "revng/Support/MetaAddress.h"
+#include "revng/Support/TypeAtOffset.h"
+#include "revng/Support/WordScan.h"
+#include "revng/TupleTree/TupleTree.h"
+#include "revng/TupleTree/TupleTreeDiff.h"
+
+using namespace llvm;
+using namespace llvm::cl;
+
+static opt<std::string> Filter("filter",
+                               desc("Run only the benchmarks whose name "
+                                    "matches this regular expression"),
+                               cat(MainCategory),
+                               init(".*"));
+
+static opt<bool> ListOnly("list",
+                          desc("List the benchmarks and exit"),
+                          cat(MainCategory));
+
+static opt<unsigned> MinTime("min-time",
+                             desc("Minimum duration, in milliseconds, of "
+                                  "each sample"),
+                             cat(MainCategory),
+                             init(100));
+
+static opt<unsigned> Samples("samples",
+                             desc("Number of samples taken for each "
+                                  "benchmark, the median is reported"),
+                             cat(MainCategory),
+                             init(5));
+
+static opt<std::string> Output("o",
+                               desc("Where to write the results, as JSON"),
+                               value_desc("filename"),
+                               cat(MainCategory),
+                               init("-"));
+
+static opt<std::string> Baseline("baseline",
+                                 desc("Results of a previous run to compare "
+                                      "against"),
+                                 value_desc("filename"),
+                                 cat(MainCategory));
+
+static opt<double> Threshold("threshold",
+                             desc("Relative growth of the time of a "
+                                  "benchmark reported as a regression"),
+                             cat(MainCategory),
+                             init(0.1));
+
+using Clock = std::chrono::steady_clock;
+
+/// Prevents the compiler from optimizing away the computation of \p Value
+template<typename T>
+static void doNotOptimize(const T &Value) {
+  asm volatile("" : : "r"(&Value) : "memory");
+}
+
+/// A benchmark: `Prepare` builds the inputs, which is not measured, and returns
+/// the operation to measure, which is run over and over on them.
+struct Benchmark {
+  std::string Name;
+  std::function<std::function<void()>()> Prepare;
+};
+
+struct Measurement {
+  std::string Name;
+  uint64_t Iterations = 0;
+  double MedianNs = 0;
+  double MinNs = 0;
+};
+
+static std::vector<Benchmark> &benchmarks() {
+  static std::vector<Benchmark> Benchmarks;
+  return Benchmarks;
+}
+
+template<typename... ArgTypes>
+static void add(ArgTypes &&...Args) {
+  benchmarks().push_back(Benchmark{ std::forward<ArgTypes>(Args)... });
+}
+
+static std::string nameOf(StringRef Name, uint64_t Size) {
+  return (Name + "/" + Twine(Size)).str();
+}
+
+//
+// SortedVector
+//
+
+static std::vector<uint64_t> randomKeys(size_t Count, uint64_t Seed = 42) {
+  std::mt19937_64 Generator(Seed);
+  std::vector<uint64_t> Result(Count);
+  for (uint64_t &Key : Result)
+    Key = Generator();
+  return Result;
+}
+
+static void registerSortedVector() {
+  for (size_t Size : { 1000, 10000 }) {
+    add(nameOf("sorted-vector/insert", Size), [Size] {
+      return [Keys = randomKeys(Size)] {
+        SortedVector<uint64_t> Vector;
+        for (uint64_t Key : Keys)
+          Vector.insert(Key);
+        doNotOptimize(Vector);
+      };
+    });
+  }
+
+  for (size_t Size : { 10000, 1000000 }) {
+    add(nameOf("sorted-vector/batch-insert", Size), [Size] {
+      return [Keys = randomKeys(Size)] {
+        SortedVector<uint64_t> Vector;
+        {
+          auto Inserter = Vector.batch_insert();
+          for (uint64_t Key : Keys)
+            Inserter.insert(Key);
+        }
+        doNotOptimize(Vector);
+      };
+    });
+
+    add(nameOf("sorted-vector/find", Size), [Size] {
+      std::vector<uint64_t> Keys = randomKeys(Size);
+      SortedVector<uint64_t> Vector;
+      {
+        auto Inserter = Vector.batch_insert();
+        for (uint64_t Key : Keys)
+          Inserter.insert(Key);
+      }
+
+      // Half of the lookups miss
+      std::vector<uint64_t> Lookups = randomKeys(Size / 2, 43);
+      Lookups.insert(Lookups.end(), Keys.begin(), Keys.begin() + Size / 2);
+      std::shuffle(Lookups.begin(), Lookups.end(), std::mt19937_64(44));
+      return [Vector = std::move(Vector), Lookups = std::move(Lookups)] {
+        size_t Found = 0;
+        for (uint64_t Key : Lookups)
+          Found += Vector.count(Key);
+        doNotOptimize(Found);
+      };
+    });
+  }
+}
+
+//
+// TupleTree
+//
+
+static TupleTree<model::Binary> syntheticModel(size_t FunctionCount) {
+  TupleTree<model::Binary> Result;
+  Result->Architecture() = model::Architecture::x86_64;
+  for (uint64_t I = 0; I < FunctionCount; ++I) {
+    MetaAddress Entry(0x400000 + I * 0x40, MetaAddressType::Code_x86_64);
+    model::Function &Function = Result->Functions()[Entry];
+    Function.OriginalName() = ("function_" + Twine(I)).str();
+    Function.Comment() = "A function with a comment";
+  }
+
+  return Result;
+}
+
+static void registerTupleTree() {
+  for (size_t Size : { 1000, 10000 }) {
+    add(nameOf("tuple-tree/serialize", Size), [Size] {
+      return [Model = syntheticModel(Size)] {
+        std::string Buffer;
+        Model.serialize(Buffer);
+        doNotOptimize(Buffer);
+      };
+    });
+
+    add(nameOf("tuple-tree/deserialize", Size), [Size] {
+      std::string Buffer;
+      syntheticModel(Size).serialize(Buffer);
+      return [Buffer = std::move(Buffer)] {
+        auto Model = TupleTree<model::Binary>::deserialize(Buffer);
+        revng_check(Model);
+        doNotOptimize(Model);
+      };
+    });
+
+    add(nameOf("tuple-tree/diff-one-change", Size), [Size] {
+      auto Left = syntheticModel(Size);
+      auto Right = syntheticModel(Size);
+      Right->Functions().begin()->OriginalName() = "renamed";
+      return [Left = std::move(Left), Right = std::move(Right)] {
+        auto Diff = diff(*Left, *Right);
+        doNotOptimize(Diff);
+      };
+    });
+
+    add(nameOf("tuple-tree/diff-all-changed", Size), [Size] {
+      auto Left = syntheticModel(Size);
+      auto Right = syntheticModel(Size);
+      for (model::Function &Function : Right->Functions())
+        Function.Comment() = "A different comment";
+      return [Left = std::move(Left), Right = std::move(Right)] {
+        auto Diff = diff(*Left, *Right);
+        doNotOptimize(Diff);
+      };
+    });
+  }
+}
+
+//
+// GzipTarFile
+//
+
+static std::string compressibleData(size_t Size) {
+  std::mt19937_64 Generator(42);
+  std::string Result;
+  Result.reserve(Size);
+  while (Result.size() < Size)
+    Result += ("line " + Twine(Generator() % 1000) + "\n").str();
+  Result.resize(Size);
+  return Result;
+}
+
+static SmallVector<char> writeArchive(const std::string &Data,
+                                      size_t EntryCount,
+                                      revng::TarCompression Compression) {
+  SmallVector<char> Buffer;
+  raw_svector_ostream OS(Buffer);
+  revng::GzipTarWriter Writer(OS, Compression);
+  for (size_t I = 0; I < EntryCount; ++I)
+    Writer.append(("entry-" + Twine(I)).str(), { Data.data(), Data.size() });
+  Writer.close();
+  return Buffer;
+}
+
+static void registerGzipTarFile() {
+  constexpr size_t EntryCount = 16;
+  constexpr size_t EntrySize = 256 * 1024;
+
+  using revng::TarCompression;
+  for (TarCompression Compression :
+       { TarCompression::Gzip, TarCompression::Zstd }) {
+    StringRef Name = Compression == TarCompression::Gzip ? "gzip" : "zstd";
+    std::string Prefix = ("tar-" + Name).str();
+    add(Prefix + "/write", [Compression] {
+      return [Compression, Data = compressibleData(EntrySize)] {
+        auto Buffer = writeArchive(Data, EntryCount, Compression);
+        doNotOptimize(Buffer);
+      };
+    });
+
+    add(Prefix + "/read", [Compression] {
+      std::string Data = compressibleData(EntrySize);
+      auto Buffer = writeArchive(Data, EntryCount, Compression);
+      return [Buffer = std::move(Buffer)] {
+        revng::GzipTarReader Reader({ Buffer.data(), Buffer.size() });
+        size_t Entries = 0;
+        for (revng::ArchiveEntry &Entry : Reader.entries()) {
+          doNotOptimize(Entry);
+          ++Entries;
+        }
+        revng_check(not Reader.takeError());
+        revng_check(Entries == EntryCount);
+      };
+    });
+  }
+}
+
+//
+// TargetsList
+//
+
+static auto RootRank = pipeline::defineRootRank<"microbench-root">();
+static auto FunctionRank = pipeline::defineRank<"microbench-function",
+                                                std::string>(RootRank);
+static pipeline::SingleElementKind FunctionKind("microbench-function",
+                                                FunctionRank,
+                                                {},
+                                                {});
+
+/// \return a list of \p Count targets, taking one in \p Stride addresses
+static pipeline::TargetsList targets(size_t Count, size_t Stride) {
+  pipeline::TargetsList::List Result;
+  for (uint64_t I = 0; I < Count; ++I) {
+    MetaAddress Entry(0x400000 + I * Stride * 0x40,
+                      MetaAddressType::Code_x86_64);
+    Result.emplace_back(Entry.toString(), FunctionKind);
+  }
+
+  return pipeline::TargetsList(std::move(Result));
+}
+
+static void registerTargetsList() {
+  for (size_t Size : { 1000, 100000 }) {
+    add(nameOf("targets-list/merge", Size), [Size] {
+      return [Left = targets(Size, 2), Right = targets(Size, 3)] {
+        pipeline::TargetsList Result = Left;
+        Result.merge(Right);
+        doNotOptimize(Result);
+      };
+    });
+
+    add(nameOf("targets-list/intersect", Size), [Size] {
+      return [Left = targets(Size, 2), Right = targets(Size, 3)] {
+        auto Result = Left.intersect(Right);
+        doNotOptimize(Result);
+      };
+    });
+
+    add(nameOf("targets-list/contains", Size), [Size] {
+      return [Left = targets(Size, 2), Right = targets(Size / 10, 3)] {
+        size_t Found = 0;
+        for (const pipeline::Target &Target : Right)
+          Found += Left.contains(Target);
+        doNotOptimize(Found);
+      };
+    });
+  }
+}
+
+//
+// Invalidation metadata
+//
+
+/// The invalidation metadata of \p TargetCount targets, each one having read
+/// \p PathsPerTarget paths out of a few thousands
+static pipeline::InvalidationMetadataVector
+syntheticInvalidationMetadata(size_t TargetCount, size_t PathsPerTarget) {
+  std::mt19937_64 Generator(42);
+  pipeline::InvalidationMetadataVector Result;
+  pipeline::NamedPathTargetBimapVector &Global = Result.emplace_back();
+  Global.GlobalName = "model.yml";
+  for (uint64_t I = 0; I < TargetCount; ++I) {
+    auto &[Target, Paths] = Global.Map.Data.emplace_back();
+    MetaAddress Entry(0x400000 + I * 0x40, MetaAddressType::Code_x86_64);
+    Target.SerializedTarget = Entry.toString() + ":isolated";
+    Target.PipeName = "isolate";
+    for (size_t J = 0; J < PathsPerTarget; ++J) {
+      MetaAddress Callee(0x400000 + Generator() % 4096 * 0x40,
+                         MetaAddressType::Code_x86_64);
+      Paths.push_back("/Functions/" + Callee.toString() + "/Prototype");
+    }
+  }
+
+  return Result;
+}
+
+static void registerInvalidationMetadata() {
+  for (size_t Size : { 1000, 10000 }) {
+    for (bool YAML : { false, true }) {
+      std::string Name = YAML ? "invalidation-metadata/load-yaml" :
+                                "invalidation-metadata/load-binary";
+      add(nameOf(Name, Size), [Size, YAML] {
+        auto Metadata = syntheticInvalidationMetadata(Size, 20);
+        std::string Buffer;
+        raw_string_ostream OS(Buffer);
+        if (YAML)
+          pipeline::writeYAMLInvalidationMetadata(OS, Metadata);
+        else
+          pipeline::writeBinaryInvalidationMetadata(OS, Metadata);
+        OS.flush();
+
+        return [Buffer = std::move(Buffer)] {
+          auto Parsed = pipeline::parseInvalidationMetadata(Buffer);
+          revng_check(static_cast<bool>(Parsed));
+          doNotOptimize(Parsed);
+        };
+      });
+    }
+  }
+}
+
+//
+// Read fields tracking
+//
+
+static void registerReadFieldsTracking() {
+  using pipeline::ReadFieldsTracking;
+  using ModelGlobal = pipeline::TupleTreeGlobal<model::Binary>;
+  static constexpr const char *GlobalName = "model.yml";
+
+  for (size_t Size : { 1000, 10000 }) {
+    for (ReadFieldsTracking Tracking :
+         { ReadFieldsTracking::Precise, ReadFieldsTracking::Coarse }) {
+      bool Precise = Tracking == ReadFieldsTracking::Precise;
+      std::string Name = Precise ? "read-fields-tracking/precise" :
+                                   "read-fields-tracking/coarse";
+      add(nameOf(Name, Size), [Size, Tracking] {
+        auto Ctx = std::make_shared<pipeline::Context>();
+        Ctx->setReadFieldsTracking(Tracking);
+        Ctx->addGlobal<ModelGlobal>(GlobalName);
+        ModelGlobal *Model = cantFail(Ctx->getGlobal<ModelGlobal>(GlobalName));
+        Model->get() = syntheticModel(Size);
+
+        // What a pipe producing a single target out of a tenth of the model
+        // goes through
+        return [Ctx, Model, Size] {
+          Ctx->clearAndResume();
+
+          const model::Binary &Binary = *std::as_const(Model->get());
+          size_t Read = 0;
+          for (const model::Function &Function : Binary.Functions()) {
+            if (Read++ == Size / 10)
+              break;
+            doNotOptimize(Function.OriginalName());
+          }
+
+          llvm::StringMap<pipeline::PathTargetBimap::IndexedReads> Reads;
+          Ctx->collectReadFields(0, Reads);
+          Ctx->stopTracking();
+          doNotOptimize(Reads);
+        };
+      });
+    }
+  }
+}
+
+//
+// LLVMContainer
+//
+
+/// Defines in \p M the functions from `f<Begin>` to `f<End>`, each one
+/// calling `helper` a few times
+static void syntheticFunctions(Module &M, size_t Begin, size_t End) {
+  LLVMContext &C = M.getContext();
+  auto *VoidType = FunctionType::get(Type::getVoidTy(C), false);
+  FunctionCallee Helper = M.getOrInsertFunction("helper", VoidType);
+  for (size_t I = Begin; I < End; ++I) {
+    auto *F = Function::Create(VoidType,
+                               GlobalValue::ExternalLinkage,
+                               "f" + Twine(I),
+                               &M);
+    IRBuilder<> Builder(BasicBlock::Create(C, "", F));
+    for (unsigned J = 0; J < 4; ++J)
+      Builder.CreateCall(Helper);
+    Builder.CreateRetVoid();
+  }
+}
+
+static void registerLLVMContainer() {
+  // The functions replaced by each merge. The time of a merge in place is
+  // expected not to grow with the size of the destination.
+  constexpr size_t Merged = 10;
+
+  for (size_t Size : { 1000, 10000 }) {
+    add(nameOf("llvm-container/merge-in-place", Size), [Size] {
+      struct State {
+        LLVMContext C;
+        pipeline::Context Ctx;
+        std::unique_ptr<pipeline::LLVMContainer> Destination;
+      };
+
+      auto S = std::make_shared<State>();
+      S->Destination = std::make_unique<pipeline::LLVMContainer>("module",
+                                                                 &S->Ctx,
+                                                                 &S->C);
+      syntheticFunctions(S->Destination->getModule(), 0, Size);
+
+      return [S, Size] {
+        // Building the module to merge is measured too, but its cost does not
+        // depend on Size either
+        pipeline::LLVMContainer Incoming("module", &S->Ctx, &S->C);
+        syntheticFunctions(Incoming.getModule(), Size / 2, Size / 2 + Merged);
+        S->Destination->mergeBack(std::move(Incoming));
+        doNotOptimize(*S->Destination);
+      };
+    });
+  }
+}
+
+//
+// Synthetic control flow graphs
+//
+
+/// Populates \p Graph with \p NodeCount nodes connected as the basic blocks of
+/// a function: mostly fallthroughs, with some forward branches and some loops.
+template<typename GraphType, typename AddNodeType>
+static void syntheticCFG(GraphType &Graph,
+                         size_t NodeCount,
+                         AddNodeType &&AddNode) {
+  using NodeType = typename GraphType::Node;
+  std::mt19937_64 Generator(42);
+  std::vector<NodeType *> Nodes;
+  for (size_t I = 0; I < NodeCount; ++I)
+    Nodes.push_back(AddNode(I));
+  Graph.setEntryNode(Nodes.front());
+
+  for (size_t I = 0; I + 1 < NodeCount; ++I) {
+    Nodes[I]->addSuccessor(Nodes[I + 1]);
+    switch (Generator() % 4) {
+    case 0: {
+      size_t Target = I + 2 + Generator() % 8;
+      if (Target < NodeCount)
+        Nodes[I]->addSuccessor(Nodes[Target]);
+    } break;
+    case 1:
+      Nodes[I]->addSuccessor(Nodes[I - std::min<size_t>(I, Generator() % 8)]);
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+//
+// Code pointers in global data
+//
+
+/// A data segment of \p Size bytes of 64-bit little endian words, a few of
+/// which point into [\p CodeStart, \p CodeEnd)
+static std::vector<unsigned char>
+syntheticData(size_t Size, uint64_t CodeStart, uint64_t CodeEnd) {
+  std::mt19937_64 Generator(42);
+  std::vector<unsigned char> Result(Size);
+  for (size_t Offset = 0; Offset + 8 <= Size; Offset += 8) {
+    uint64_t Word = Generator();
+    if (Word % 100 == 0)
+      Word = CodeStart + Word % (CodeEnd - CodeStart);
+    support::endian::write64le(Result.data() + Offset, Word);
+  }
+  return Result;
+}
+
+static void registerCodePointerScan() {
+  constexpr uint64_t CodeStart = 0x400000;
+  constexpr uint64_t CodeEnd = 0x500000;
+
+  struct Variant {
+    StringRef Name;
+    uint64_t Lowest;
+    uint64_t Highest;
+  };
+
+  // The unfiltered variant builds a MetaAddress out of every word, as the
+  // scan did before comparing them against the span of the code
+  const Variant Variants[] = {
+    { "filtered", CodeStart, CodeEnd },
+    { "unfiltered", 0, std::numeric_limits<uint64_t>::max() }
+  };
+
+  for (const Variant &V : Variants) {
+    std::string Prefix = ("code-pointer-scan/" + V.Name).str();
+    for (size_t Size : { 1 << 16, 1 << 20 }) {
+      add(nameOf(Prefix, Size), [Size, V] {
+        auto Data = syntheticData(Size, CodeStart, CodeEnd);
+        return [Data = std::move(Data), V] {
+          size_t Found = 0;
+          auto Handle = [&Found](uint64_t, uint64_t RawValue) {
+            auto Value = MetaAddress::fromPC(Triple::x86_64, RawValue);
+            if (Value.isValid() and Value.address() >= CodeStart
+                and Value.address() < CodeEnd)
+              ++Found;
+          };
+
+          using support::endianness;
+          const unsigned char *Begin = Data.data();
+          const unsigned char *End = Begin + Data.size();
+          forEachWordInRange<uint64_t, endianness::little>(Begin,
+                                                           End,
+                                                           0,
+                                                           V.Lowest,
+                                                           V.Highest,
+                                                           Handle);
+          doNotOptimize(Found);
+        };
+      });
+    }
+  }
+}
+
+//
+// Layout of the CPU state
+//
+
+/// The layout of an x86-64-like CPU state along with what owns it
+struct CPUState {
+  LLVMContext Context;
+  DataLayout Layout{ "e-m:e-i64:64-f80:128-n8:16:32:64-S128" };
+  StructType *Root = nullptr;
+
+  CPUState() {
+    auto *I8 = Type::getInt8Ty(Context);
+    auto *I16 = Type::getInt16Ty(Context);
+    auto *I32 = Type::getInt32Ty(Context);
+    auto *I64 = Type::getInt64Ty(Context);
+    auto *XMM = StructType::create({ ArrayType::get(I64, 2) }, "XMMReg");
+    auto *FPReg = StructType::create({ I64, I16 }, "FPReg");
+    Root = StructType::create({ ArrayType::get(I64, 16),
+                                I64,
+                                I32,
+                                I8,
+                                ArrayType::get(XMM, 32),
+                                ArrayType::get(FPReg, 8),
+                                PointerType::get(Context, 0),
+                                ArrayType::get(I32, 64) },
+                              "CPUX86State");
+  }
+};
+
+static void registerTypeAtOffset() {
+  // Go through the whole CPU state four times, as the lifter looks up the
+  // same offsets over and over
+  auto Visit = [](auto &&Get, uint64_t Size) {
+    unsigned Remaining = 0;
+    for (unsigned Round = 0; Round < 4; ++Round)
+      for (uint64_t Offset = 0; Offset < Size; ++Offset)
+        Remaining += Get(Offset).second;
+    doNotOptimize(Remaining);
+  };
+
+  add("type-at-offset/walk", [Visit] {
+    auto State = std::make_shared<CPUState>();
+    return [State, Visit] {
+      auto Get = [&State](intptr_t Offset) {
+        return getTypeAtOffset(&State->Layout, State->Root, Offset);
+      };
+      Visit(Get, State->Layout.getTypeAllocSize(State->Root));
+    };
+  });
+
+  add("type-at-offset/cache", [Visit] {
+    auto State = std::make_shared<CPUState>();
+    return [State, Visit] {
+      TypeAtOffsetCache Cache(&State->Layout, State->Root);
+      auto Get = [&Cache](intptr_t Offset) { return Cache.get(Offset); };
+      Visit(Get, Cache.size());
+    };
+  });
+}
+
+//
+// MFP
+//
+
+struct CFGNodeData {
+  CFGNodeData(unsigned Index) : Index(Index) {}
+  unsigned Index;
+};
+
+using CFGNode = ForwardNode<CFGNodeData>;
+using CFG = GenericGraph<CFGNode>;
+
+using Definitions = std::set<unsigned>;
+
+/// A reaching definitions analysis, where each node defines one of a few
+/// variables
+struct ReachingDefinitions : public SetUnionLattice<Definitions> {
+  using Label = CFGNode *;
+  using GraphType = CFG *;
+
+  static Definitions applyTransferFunction(Label Node, const Definitions &In) {
+    Definitions Result = In;
+    Result.insert(Node->Index % 64);
+    return Result;
+  }
+};
+
+/// A gen/kill analysis over a few hundred registers, which joins its elements
+/// creating new ones
+struct RegisterSets {
+  using LatticeElement = BitVector;
+  using Label = CFGNode *;
+  using GraphType = CFG *;
+
+  static constexpr unsigned RegistersCount = 256;
+
+  BitVector combineValues(const BitVector &LHS, const BitVector &RHS) const {
+    BitVector Result = LHS;
+    Result |= RHS;
+    return Result;
+  }
+
+  bool isLessOrEqual(const BitVector &LHS, const BitVector &RHS) const {
+    return not LHS.test(RHS);
+  }
+
+  BitVector applyTransferFunction(Label Node, const BitVector &In) const {
+    BitVector Result = In;
+    Result.set(Node->Index % RegistersCount);
+    Result.reset((Node->Index * 7) % RegistersCount);
+    return Result;
+  }
+};
+
+/// The same analysis, joining its elements in place
+struct InPlaceRegisterSets : public RegisterSets {
+  bool combineInto(BitVector &Destination, const BitVector &Source) const {
+    bool Changed = Source.test(Destination);
+    if (Changed)
+      Destination |= Source;
+    return Changed;
+  }
+};
+
+static_assert(not MFP::HasInPlaceCombine<RegisterSets>);
+static_assert(MFP::HasInPlaceCombine<InPlaceRegisterSets>);
+
+template<typename Instance>
+static void addRegisterSets(StringRef Name) {
+  for (size_t Size : { 100, 10000 }) {
+    add(nameOf(Name, Size), [Size] {
+      auto Graph = std::make_shared<CFG>();
+      syntheticCFG(*Graph, Size, [&](size_t I) { return Graph->addNode(I); });
+      return [Graph] {
+        BitVector Empty(RegisterSets::RegistersCount);
+        CFGNode *Entry = Graph->getEntryNode();
+        auto Result = MFP::getMaximalFixedPoint(Instance(),
+                                                Graph.get(),
+                                                Empty,
+                                                Empty,
+                                                { Entry },
+                                                { Entry });
+        doNotOptimize(Result);
+      };
+    });
+  }
+}
+
+static void registerMFP() {
+  addRegisterSets<RegisterSets>("mfp/register-sets/combine-values");
+  addRegisterSets<InPlaceRegisterSets>("mfp/register-sets/combine-into");
+
+  for (size_t Size : { 100, 10000 }) {
+    add(nameOf("mfp/reaching-definitions", Size), [Size] {
+      auto Graph = std::make_shared<CFG>();
+      syntheticCFG(*Graph, Size, [&](size_t I) { return Graph->addNode(I); });
+      return [Graph] {
+        ReachingDefinitions Instance;
+        CFGNode *Entry = Graph->getEntryNode();
+        auto Result = MFP::getMaximalFixedPoint(Instance,
+                                                Graph.get(),
+                                                {},
+                                                {},
+                                                { Entry },
+                                                { Entry });
+        doNotOptimize(Result);
+      };
+    });
+  }
+}
+
+//
+// Sugiyama layout
+//
+
+static void registerSugiyama() {
+  namespace sugiyama = yield::layout::sugiyama;
+  using InputGraph = yield::layout::InputGraph<Empty>;
+
+  for (size_t Size : { 20, 200 }) {
+    add(nameOf("sugiyama/layout", Size), [Size] {
+      return [Size] {
+        // Laid out graphs are cached, make sure each one is new
+        static uint64_t Counter = 0;
+        ++Counter;
+
+        InputGraph Graph;
+        syntheticCFG(Graph, Size, [&](size_t I) {
+          auto *Node = Graph.addNode();
+          Node->Size = { 50.0f + (I * 7 + Counter) % 200, 20.0f + I % 5 * 10 };
+          return Node;
+        });
+
+        sugiyama::Configuration Configuration{
+          .Ranking = sugiyama::RankingStrategy::DisjointDepthFirstSearch,
+          .Orientation = sugiyama::Orientation::TopToBottom,
+          .UseOrthogonalBends = true,
+          .PreserveLinearSegments = true,
+          .UseSimpleTreeOptimization = false,
+          .VirtualNodeWeight = 0.1f,
+          .NodeMarginSize = 20,
+          .EdgeMarginSize = 20
+        };
+        auto Result = sugiyama::compute(Graph, Configuration);
+        revng_check(Result.has_value());
+        doNotOptimize(Result);
+      };
+    });
+  }
+}
+
+//
+// Driver
+//
+
+static double elapsedNs(Clock::time_point Start) {
+  std::chrono::duration<double, std::nano> Elapsed = Clock::now() - Start;
+  return Elapsed.count();
+}
+
+static Measurement measure(const Benchmark &B) {
+  std::function<void()> Body = B.Prepare();
+
+  // Warm up, then find how many iterations fill a sample
+  Body();
+  double Target = MinTime * 1e6;
+  uint64_t Iterations = 1;
+  while (true) {
+    auto Start = Clock::now();
+    for (uint64_t I = 0; I < Iterations; ++I)
+      Body();
+    double Elapsed = elapsedNs(Start);
+    if (Elapsed >= Target)
+      break;
+
+    // Grow geometrically, aiming a bit past the target
+    double Factor = Elapsed > 0 ? 1.2 * Target / Elapsed : 10;
+    Iterations = std::max(Iterations + 1,
+                          uint64_t(Iterations * std::min(Factor, 10.0)));
+  }
+
+  std::vector<double> PerIteration;
+  for (unsigned S = 0; S < std::max(Samples.getValue(), 1U); ++S) {
+    auto Start = Clock::now();
+    for (uint64_t I = 0; I < Iterations; ++I)
+      Body();
+    PerIteration.push_back(elapsedNs(Start) / Iterations);
+  }
+
+  llvm::sort(PerIteration);
+  return Measurement{ .Name = B.Name,
+                      .Iterations = Iterations,
+                      .MedianNs = PerIteration[PerIteration.size() / 2],
+                      .MinNs = PerIteration.front() };
+}
+
+/// The results are laid out as the ones of Google Benchmark, so that its tools
+/// can be used on them too
+static json::Value toJSON(const std::vector<Measurement> &Results) {
+  json::Array Benchmarks;
+  for (const Measurement &R : Results) {
+    Benchmarks.push_back(json::Object{ { "name", R.Name },
+                                       { "iterations", int64_t(R.Iterations) },
+                                       { "real_time", R.MedianNs },
+                                       { "min_time", R.MinNs },
+                                       { "time_unit", "ns" } });
+  }
+
+  return json::Object{ { "benchmarks", std::move(Benchmarks) } };
+}
+
+static Expected<StringMap<double>> loadBaseline(StringRef Path) {
+  auto MaybeBuffer = MemoryBuffer::getFile(Path);
+  if (not MaybeBuffer)
+    return createStringError(MaybeBuffer.getError(),
+                             "Cannot read " + Path.str());
+
+  auto MaybeJSON = json::parse((*MaybeBuffer)->getBuffer());
+  if (not MaybeJSON)
+    return MaybeJSON.takeError();
+
+  StringMap<double> Result;
+  const json::Object *Root = MaybeJSON->getAsObject();
+  const json::Array *Benchmarks = Root ? Root->getArray("benchmarks") : nullptr;
+  if (Benchmarks == nullptr)
+    return createStringError(inconvertibleErrorCode(),
+                             Path + " does not contain benchmark results");
+
+  for (const json::Value &Entry : *Benchmarks) {
+    const json::Object *Benchmark = Entry.getAsObject();
+    if (Benchmark == nullptr)
+      continue;
+
+    auto Name = Benchmark->getString("name");
+    auto Time = Benchmark->getNumber("real_time");
+    if (Name and Time)
+      Result[*Name] = *Time;
+  }
+
+  return Result;
+}
+
+static Error run() {
+  registerSortedVector();
+  registerTupleTree();
+  registerGzipTarFile();
+  registerTargetsList();
+  registerInvalidationMetadata();
+  registerReadFieldsTracking();
+  registerLLVMContainer();
+  registerCodePointerScan();
+  registerTypeAtOffset();
+  registerMFP();
+  registerSugiyama();
+
+  Regex Matcher(Filter);
+  std::string RegexError;
+  if (not Matcher.isValid(RegexError))
+    return createStringError(inconvertibleErrorCode(),
+                             "Invalid filter: " + RegexError);
+
+  if (ListOnly) {
+    for (const Benchmark &B : benchmarks())
+      if (Matcher.match(B.Name))
+        outs() << B.Name << "\n";
+    return Error::success();
+  }
+
+  std::vector<Measurement> Results;
+  for (const Benchmark &B : benchmarks()) {
+    if (not Matcher.match(B.Name))
+      continue;
+
+    Results.push_back(measure(B));
+    const Measurement &R = Results.back();
+    errs() << format("%-40s %14.0f ns %12llu iterations\n",
+                     R.Name.c_str(),
+                     R.MedianNs,
+                     static_cast<unsigned long long>(R.Iterations));
+  }
+
+  std::error_code EC;
+  raw_fd_ostream OS(Output, EC, sys::fs::OF_Text);
+  if (EC)
+    return createStringError(EC, "Cannot open " + Output);
+  OS << formatv("{0:2}", toJSON(Results)) << "\n";
+
+  if (Baseline.empty())
+    return Error::success();
+
+  auto MaybeBaseline = loadBaseline(Baseline);
+  if (not MaybeBaseline)
+    return MaybeBaseline.takeError();
+
+  unsigned Regressions = 0;
+  for (const Measurement &R : Results) {
+    auto It = MaybeBaseline->find(R.Name);
+    if (It == MaybeBaseline->end())
+      continue;
+
+    double Reference = It->second;
+    if (R.MedianNs > Reference * (1 + Threshold)) {
+      errs() << R.Name << " went from " << format("%.0f", Reference)
+             << " ns to " << format("%.0f", R.MedianNs) << " ns\n";
+      ++Regressions;
+    }
+  }
+
+  if (Regressions != 0)
+    return createStringError(inconvertibleErrorCode(),
+                             Twine(Regressions) + " benchmarks regressed");
+
+  return Error::success();
+}
+
+int main(int argc, char *argv[]) {
+  revng::InitRevng X(argc, argv, "", { &MainCategory });
+  pipeline::Rank::init();
+  pipeline::Kind::init();
+
+  if (auto Error = run()) {
+    errs() << toString(std::move(Error)) << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <future>
 #include <string>
 
 #include "llvm/Support/CommandLine.h"
@@ -31,6 +32,10 @@ static cl::opt<std::string> DiffPath(cl::Positional,
                                      cl::init("-"),
                                      cl::value_desc("model"));
 
+static cl::opt<bool> Binary("binary",
+                            cl::desc("Emit the model in the binary format"),
+                            cl::cat(ThisToolCategory));
+
 static ModelOutputOptions<false> Options(ThisToolCategory);
 
 int main(int Argc, char *Argv[]) {
@@ -38,18 +43,25 @@ int main(int Argc, char *Argv[]) {
 
   ExitOnError ExitOnError;
 
+  // Parse the diff while the model is being loaded
+  using TypeDiff = TupleTreeDiff<model::Binary>;
+  auto LoadDiff = [] { return deserializeFileOrSTDIN<TypeDiff>(DiffPath); };
+  auto PendingDiff = std::async(std::launch::async, LoadDiff);
+
   using Type = TupleTree<model::Binary>;
   auto Model = llvm::errorOrToExpected(Type::fromFileOrSTDIN(PathModel));
+  auto MaybeDiff = PendingDiff.get();
   if (not Model)
     ExitOnError(Model.takeError());
 
-  using TypeDiff = TupleTreeDiff<model::Binary>;
-  auto Diff = ExitOnError(deserializeFileOrSTDIN<TypeDiff>(DiffPath));
+  auto Diff = ExitOnError(std::move(MaybeDiff));
 
   ExitOnError(Diff.apply(*Model));
 
-  auto DesiredOutput = Options.getDesiredOutput();
-  ExitOnError(Model->toFile(Options.getPath()));
+  if (Binary)
+    ExitOnError(Model->toBinaryFile(Options.getPath()));
+  else
+    ExitOnError(Model->toFile(Options.getPath()));
 
   return EXIT_SUCCESS;
 }
@@ -4,6 +4,7 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <future>
 #include <string>
 
 #include "llvm/Support/CommandLine.h"
@@ -45,13 +46,17 @@ int main(int Argc, char *Argv[]) {
 
   ExitOnError ExitOnError;
 
+  // Parsing dominates on large models: load the two sides concurrently
   using Model = TupleTree<model::Binary>;
-  auto
-    LeftModel = llvm::errorOrToExpected(Model::fromFileOrSTDIN(LeftModelPath));
+  auto LoadLeft = [] { return Model::fromFileOrSTDIN(LeftModelPath); };
+  auto PendingLeft = std::async(std::launch::async, LoadLeft);
+  auto MaybeRight = Model::fromFileOrSTDIN(RightModelPath);
+
+  auto LeftModel = llvm::errorOrToExpected(PendingLeft.get());
   if (not LeftModel)
     ExitOnError(LeftModel.takeError());
 
-  auto RightModel = errorOrToExpected(Model::fromFileOrSTDIN(RightModelPath));
+  auto RightModel = errorOrToExpected(std::move(MaybeRight));
   if (not RightModel)
     ExitOnError(RightModel.takeError());
 
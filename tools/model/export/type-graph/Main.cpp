@@ -2,6 +2,8 @@
 // This file is distributed under the MIT License. See LICENSE.md for details.
 //
 
+#include <optional>
+
 #include "llvm/Support/CommandLine.h"
 
 #include "revng/Model/ToolHelpers.h"
@@ -24,6 +26,22 @@ static cl::opt<std::string> InputModulePath(cl::Positional,
                                             cl::init("-"),
                                             cl::value_desc("module"));
 
+static cl::opt<std::string> RootType("root",
+                                     cl::cat(ThisToolCategory),
+                                     cl::desc("Only print the types reachable "
+                                              "from the type definition with "
+                                              "this path (e.g., "
+                                              "/TypeDefinitions/"
+                                              "1-StructDefinition)"),
+                                     cl::value_desc("path"));
+
+static cl::opt<unsigned> Depth("depth",
+                               cl::cat(ThisToolCategory),
+                               cl::desc("When -root is specified, only print "
+                                        "the types at most this many edges "
+                                        "away from it"),
+                               cl::value_desc("edges"));
+
 int main(int Argc, char *Argv[]) {
   revng::InitRevng X(Argc, Argv, "", { &ThisToolCategory });
 
@@ -39,8 +57,25 @@ int main(int Argc, char *Argv[]) {
   if (EC)
     revng_abort(EC.message().c_str());
 
+  const model::Binary &Binary = **MaybeModel;
+  if (RootType.empty()) {
+    TypeSystemPrinter TSPrinter(Out);
+    TSPrinter.print(Binary);
+    return EXIT_SUCCESS;
+  }
+
+  using model::DefinitionReference;
+  auto Root = DefinitionReference::fromString(&Binary, RootType);
+  if (not Root.isValid())
+    ExitOnError(createStringError(inconvertibleErrorCode(),
+                                  "Type definition not found: " + RootType));
+
+  std::optional<unsigned> MaxDepth;
+  if (Depth.getNumOccurrences() > 0)
+    MaxDepth = Depth;
+
   TypeSystemPrinter TSPrinter(Out);
-  TSPrinter.print(**MaybeModel);
+  TSPrinter.print(*Root.getConst(), MaxDepth);
 
   return EXIT_SUCCESS;
 }
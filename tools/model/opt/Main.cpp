@@ -27,6 +27,10 @@ static cl::opt<std::string> InputFilename(cl::Positional,
                                           cl::value_desc("filename"),
                                           cl::cat(ThisToolCategory));
 
+static cl::opt<bool> Binary("binary",
+                            cl::desc("Emit the model in the binary format"),
+                            cl::cat(ThisToolCategory));
+
 class PassName : public std::string {
 public:
   PassName() {}
@@ -83,5 +87,8 @@ int main(int Argc, char *Argv[]) {
   }
 
   // Serialize
-  ExitOnError(MaybeModel.toFile(Options.getPath()));
+  if (Binary)
+    ExitOnError(MaybeModel.toBinaryFile(Options.getPath()));
+  else
+    ExitOnError(MaybeModel.toFile(Options.getPath()));
 }
@@ -107,6 +107,35 @@ static alias A2("t",
                 aliasopt(PrintBuildableTargets),
                 cat(MainCategory));
 
+static opt<bool> MemoryReport("memory-report",
+                              desc("Print the estimated memory used by each "
+                                   "container and global at the end"),
+                              cat(MainCategory));
+
+static opt<unsigned> ShardCount("shard-count",
+                                desc("Split the targets requested with "
+                                     "--produce into this many shards, see "
+                                     "--shard-index and --merge-shards"),
+                                cat(MainCategory),
+                                init(1));
+
+static opt<unsigned> ShardIndex("shard-index",
+                                desc("Produce only this shard of the targets "
+                                     "requested with --produce and store it "
+                                     "in the execution directory, instead of "
+                                     "storing the whole execution directory. "
+                                     "Workers sharing the execution directory "
+                                     "can produce one shard each."),
+                                cat(MainCategory),
+                                init(0));
+
+static cl::list<string> MergeShards("merge-shards",
+                                    desc("<step>/<container> whose shards, "
+                                         "all --shard-count of them, have "
+                                         "been produced by the workers and "
+                                         "should be merged back"),
+                                    cat(MainCategory));
+
 static ToolCLOptions BaseOptions(MainCategory);
 
 static ExitOnError AbortOnError;
@@ -138,7 +167,36 @@ static void runAnalysis(Runner &Pipeline, llvm::StringRef Target) {
   AbortOnError(Pipeline.runAnalysis(AnalysisName, Step, ToProduce, Map));
 }
 
-static void runPipeline(Runner &Pipeline) {
+static bool isShardWorker() {
+  return ShardCount > 1 and MergeShards.empty();
+}
+
+static void produceShard(PipelineManager &Manager, const Runner::State &State) {
+  for (const auto &StepEntry : State) {
+    llvm::StringRef StepName = StepEntry.first();
+    Step &TheStep = Manager.getRunner().getStep(StepName);
+    for (const auto &ContainerEntry : StepEntry.second) {
+      llvm::StringRef ContainerName = ContainerEntry.first();
+      auto It = TheStep.containers().find(ContainerName);
+      if (It == TheStep.containers().end()) {
+        AbortOnError(createStringError(inconvertibleErrorCode(),
+                                       "No container named %s in step %s",
+                                       ContainerName.str().c_str(),
+                                       StepName.str().c_str()));
+      }
+
+      AbortOnError(Manager.produceShard(StepName,
+                                        *It,
+                                        ContainerEntry.second,
+                                        ShardIndex,
+                                        ShardCount));
+    }
+  }
+}
+
+static void runPipeline(PipelineManager &Manager) {
+  Runner &Pipeline = Manager.getRunner();
+
   // First run the requested analyses
   {
     Task T(Analyze.size(), "revng-pipeline analyses");
@@ -154,8 +212,38 @@ static void runPipeline(Runner &Pipeline) {
     T.advance(Entry, true);
     llvm::SmallVector<llvm::StringRef, 3> Targets;
     Entry.split(Targets, ",");
-    AbortOnError(Pipeline.run(parseProductionRequest(Pipeline, Targets)));
+    auto Request = parseProductionRequest(Pipeline, Targets);
+    if (isShardWorker())
+      produceShard(Manager, Request);
+    else
+      AbortOnError(Pipeline.run(Request));
+  }
+
+  // Finally merge the shards produced by the workers, if any
+  for (llvm::StringRef Entry : MergeShards) {
+    auto [StepName, ContainerName] = Entry.split("/");
+    AbortOnError(Manager.mergeShards(StepName, ContainerName, ShardCount));
+  }
+}
+
+static void printMemoryReport(const PipelineManager &Manager,
+                              llvm::raw_ostream &OS) {
+  OS << "Memory usage: " << Manager.memoryUsage() << " bytes\n";
+  for (const pipeline::Step &Step : Manager.getRunner()) {
+    const ContainerSet &Containers = Step.containers();
+    size_t StepTotal = Containers.memoryUsage();
+    if (StepTotal == 0)
+      continue;
+
+    OS << "  " << Step.getName() << ": " << StepTotal << " bytes\n";
+    for (const auto &Entry : Containers)
+      if (size_t Size = Containers.memoryUsage(Entry.first()); Size != 0)
+        OS << "    " << Entry.first() << ": " << Size << " bytes\n";
   }
+
+  OS << "Globals:\n";
+  for (const pipeline::Global *G : Manager.context().getGlobals())
+    OS << "  " << G->getName() << ": " << G->memoryUsage() << " bytes\n";
 }
 
 int main(int argc, char *argv[]) {
@@ -202,7 +290,13 @@ int main(int argc, char *argv[]) {
     AbortOnError(Manager.runAnalyses(AL, InvMap));
   }
 
-  runPipeline(Manager.getRunner());
+  if (ShardIndex >= ShardCount) {
+    AbortOnError(createStringError(inconvertibleErrorCode(),
+                                   "--shard-index must be less than "
+                                   "--shard-count"));
+  }
+
+  runPipeline(Manager);
 
   if (ProduceAllPossibleTargets)
     AbortOnError(Manager.produceAllPossibleTargets());
@@ -213,8 +307,16 @@ int main(int argc, char *argv[]) {
     AbortOnError(Manager.invalidateAllPossibleTargets());
   }
 
+  if (MemoryReport) {
+    llvm::raw_os_ostream OS(dbg);
+    printMemoryReport(Manager, OS);
+  }
+
   AbortOnError(Manager.store(StoresOverrides));
-  AbortOnError(Manager.store());
+
+  // Workers share the execution directory, they store their shard only
+  if (not isShardWorker())
+    AbortOnError(Manager.store());
 
   if (SaveModel.hasValue()) {
     auto Context = Manager.context();
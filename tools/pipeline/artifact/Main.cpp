@@ -11,6 +11,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/PluginLoader.h"
 #include "llvm/Support/raw_os_ostream.h"
 
@@ -58,6 +59,15 @@ static opt<bool> ListArtifacts("list",
                                cat(MainCategory),
                                init(false));
 
+static opt<string> Batch("batch",
+                         desc("Produce all the artifacts listed in the given "
+                              "file (- for stdin) in a single run. Each line "
+                              "has the form <artifact> <output> [TARGET "
+                              "[TARGET [...]]]. The only positional argument "
+                              "is then <binary>."),
+                         value_desc("file"),
+                         cat(MainCategory));
+
 static cl::list<string> AnalysesLists("analyses-list",
                                       desc("Analyses list to run"),
                                       cat(MainCategory));
@@ -82,6 +92,73 @@ printStringPair(const std::vector<std::pair<std::string, std::string>> &Pairs) {
               << "- " << Second << "\n";
 }
 
+/// An artifact to produce and where to store it
+struct ArtifactRequest {
+  Step *ArtifactStep;
+  FilePath Output;
+  /// All of them if empty
+  SmallVector<std::string, 2> Targets;
+};
+
+static Step &getArtifactStep(PipelineManager &Manager, StringRef Name) {
+  if (not Manager.getRunner().containsStep(Name)) {
+    AbortOnError(createStringError(inconvertibleErrorCode(),
+                                   "No known artifact named %s.\nUse `revng "
+                                   "artifact` with no arguments to list "
+                                   "available artifacts.",
+                                   Name.str().c_str()));
+  }
+
+  auto &Step = Manager.getRunner().getStep(Name);
+  if (not Step.getArtifactsContainer()) {
+    AbortOnError(createStringError(inconvertibleErrorCode(),
+                                   "The step %s is not associated to an "
+                                   "artifact.",
+                                   Name.str().c_str()));
+  }
+
+  return Step;
+}
+
+/// Parse the artifacts listed in \p Path, see -batch
+static std::vector<ArtifactRequest> parseBatch(PipelineManager &Manager,
+                                               StringRef Path) {
+  auto MaybeBuffer = MemoryBuffer::getFileOrSTDIN(Path);
+  if (not MaybeBuffer) {
+    AbortOnError(createStringError(MaybeBuffer.getError(),
+                                   "Could not read %s",
+                                   Path.str().c_str()));
+  }
+
+  std::vector<ArtifactRequest> Result;
+  SmallVector<StringRef, 8> Lines;
+  (*MaybeBuffer)->getBuffer().split(Lines, '\n', -1, false);
+  for (StringRef Line : Lines) {
+    SmallVector<StringRef, 4> Fields;
+    Line.split(Fields, ' ', -1, false);
+    if (Fields.empty())
+      continue;
+
+    if (Fields.size() < 2) {
+      AbortOnError(createStringError(inconvertibleErrorCode(),
+                                     "Expected <artifact> <output> [TARGET "
+                                     "[...]] in batch line: %s",
+                                     Line.str().c_str()));
+    }
+
+    ArtifactRequest Request = {
+      .ArtifactStep = &getArtifactStep(Manager, Fields[0]),
+      .Output = Fields[1] == "-" ? FilePath::stdout() :
+                                   FilePath::fromLocalStorage(Fields[1]),
+    };
+    for (StringRef Target : llvm::drop_begin(Fields, 2))
+      Request.Targets.push_back(Target.str());
+    Result.push_back(std::move(Request));
+  }
+
+  return Result;
+}
+
 int main(int argc, char *argv[]) {
   using revng::FilePath;
 
@@ -92,7 +169,8 @@ int main(int argc, char *argv[]) {
   auto Manager = AbortOnError(BaseOptions.makeManager());
 
   if (Arguments.size() == 0) {
-    std::cout << "USAGE: revng-artifact [options] <artifact> <binary>\n\n";
+    std::cout << "USAGE: revng-artifact [options] <artifact> <binary>\n";
+    std::cout << "       revng-artifact [options] -batch <file> <binary>\n\n";
     std::cout << "<artifact> can be one of:\n\n";
 
     std::vector<std::pair<std::string, std::string>> Pairs;
@@ -107,21 +185,30 @@ int main(int argc, char *argv[]) {
     return EXIT_SUCCESS;
   }
 
-  if (not Manager.getRunner().containsStep(Arguments[0])) {
+  bool IsBatch = Batch.getNumOccurrences() > 0;
+  if (IsBatch and (ListArtifacts or Output.getNumOccurrences() > 0)) {
     AbortOnError(createStringError(inconvertibleErrorCode(),
-                                   "No known artifact named %s.\nUse `revng "
-                                   "artifact` with no arguments to list "
-                                   "available artifacts.",
-                                   Arguments[0].c_str()));
+                                   "Cannot use --batch together with --list "
+                                   "or -o."));
   }
 
-  auto &Step = Manager.getRunner().getStep(Arguments[0]);
-  auto MaybeContainer = Step.getArtifactsContainer();
-  if (not MaybeContainer) {
+  if (IsBatch and Arguments.size() != 1) {
     AbortOnError(createStringError(inconvertibleErrorCode(),
-                                   "The step %s is not associated to an "
-                                   "artifact.",
-                                   Arguments[0].c_str()));
+                                   "Expected <binary> as the only positional "
+                                   "argument with --batch."));
+  }
+
+  std::vector<ArtifactRequest> Requests;
+  if (IsBatch) {
+    Requests = parseBatch(Manager, Batch);
+  } else {
+    ArtifactRequest Request = {
+      .ArtifactStep = &getArtifactStep(Manager, Arguments[0]),
+      .Output = *Output,
+    };
+    for (llvm::StringRef Argument : llvm::drop_begin(Arguments, 2))
+      Request.Targets.push_back(Argument.str());
+    Requests.push_back(std::move(Request));
   }
 
   if (Analyze && AnalysesLists.getNumOccurrences() > 0) {
@@ -130,16 +217,16 @@ int main(int argc, char *argv[]) {
                                    "together."));
   }
 
-  if (Arguments.size() == 1) {
+  if (not IsBatch and Arguments.size() == 1) {
     AbortOnError(createStringError(inconvertibleErrorCode(),
                                    "Expected any number of positional "
                                    "arguments different from 1."));
   }
 
+  StringRef BinaryPath = IsBatch ? Arguments[0] : Arguments[1];
   auto &InputContainer = Manager.getRunner().begin()->containers()["input"];
-  InputPath = Arguments[1];
-  AbortOnError(InputContainer.load(FilePath::fromLocalStorage(Arguments[1])));
-
+  InputPath = BinaryPath.str();
+  AbortOnError(InputContainer.load(FilePath::fromLocalStorage(BinaryPath)));
   TargetInStepSet InvMap;
   for (auto &AnalysesListName : AnalysesLists) {
     if (!Manager.getRunner().hasAnalysesList(AnalysesListName)) {
@@ -182,12 +269,13 @@ int main(int argc, char *argv[]) {
     AbortOnError(Manager.runAnalyses(AL, InvMap));
   }
 
-  T.advance("Produce artifact", true);
-
-  auto ContainerName = MaybeContainer->first();
-  auto *Kind = Step.getArtifactsKind();
+  T.advance("Produce artifacts", true);
 
   if (ListArtifacts) {
+    Step &Step = *Requests.front().ArtifactStep;
+    auto ContainerName = Step.getArtifactsContainer()->first();
+    auto *Kind = Step.getArtifactsKind();
+
     Manager.recalculateAllPossibleTargets();
     auto &StepState = *Manager.getLastState().find(Step.getName());
     auto State = StepState.second.find(ContainerName)->second.filter(*Kind);
@@ -199,25 +287,38 @@ int main(int argc, char *argv[]) {
     return EXIT_SUCCESS;
   }
 
-  ContainerToTargetsMap Map;
-  if (Arguments.size() == 2) {
-    Map.add(ContainerName, Kind->allTargets(Manager.context()));
-  } else {
-    for (llvm::StringRef Argument : llvm::drop_begin(Arguments, 2)) {
-      auto RequestedTarget = AbortOnError(Target::deserialize(Manager.context(),
-                                                              Argument));
-      Map.add(ContainerName, RequestedTarget);
+  // Plan all the artifacts together, so that what they have in common is
+  // produced only once
+  Runner::State ToProduce;
+  std::vector<TargetsList> RequestedTargets;
+  for (const ArtifactRequest &Request : Requests) {
+    Step &Step = *Request.ArtifactStep;
+    auto ContainerName = Step.getArtifactsContainer()->first();
+    auto *Kind = Step.getArtifactsKind();
+
+    TargetsList &Targets = RequestedTargets.emplace_back();
+    if (Request.Targets.empty()) {
+      Targets = Kind->allTargets(Manager.context());
+    } else {
+      for (llvm::StringRef Argument : Request.Targets) {
+        auto &Context = Manager.context();
+        Targets.push_back(AbortOnError(Target::deserialize(Context, Argument)));
+      }
     }
+
+    ContainerToTargetsMap &Map = ToProduce[Step.getName()];
+    for (const Target &Target : Targets)
+      Map.add(ContainerName, Target);
   }
-  AbortOnError(Manager.getRunner().run(Step.getName(), Map));
+  AbortOnError(Manager.getRunner().run(ToProduce));
 
   AbortOnError(Manager.store());
 
-  const TargetsList &Targets = Map.contains(ContainerName) ?
-                                 Map.at(ContainerName) :
-                                 TargetsList();
-  auto Produced = MaybeContainer->second->cloneFiltered(Targets);
-  AbortOnError(Produced->store(*Output));
+  for (const auto &[Request, Targets] : llvm::zip(Requests, RequestedTargets)) {
+    auto Container = Request.ArtifactStep->getArtifactsContainer();
+    auto Produced = Container->second->cloneFiltered(Targets);
+    AbortOnError(Produced->store(Request.Output));
+  }
 
   if (SaveModel.hasValue()) {
     auto Context = Manager.context();
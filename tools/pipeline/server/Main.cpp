@@ -0,0 +1,509 @@
+/// \file Main.cpp
+/// Resident server answering `revng artifact` and `revng analyze` requests,
+/// so that their startup cost is paid only once.
+///
+/// The server listens on a unix socket and handles one connection at a time.
+/// A connection carries a single request, made of a decimal count N followed
+/// by N strings, each terminated by a NUL byte:
+///
+/// * the name of the tool (`artifact`, `analyze` or `shutdown`);
+/// * the working directory of the client, relative paths are resolved
+///   against it;
+/// * the arguments of the tool.
+///
+/// The reply is a line holding the exit code, followed by what the tool would
+/// have printed on stdout (on success) or the error message (on failure), up
+/// to the end of the connection. The exit code `2` means the request uses
+/// options that the server does not support: run the tool instead.
+///
+/// A PipelineManager is kept alive for each execution directory (`--resume`)
+/// seen so far. The server must be the only process using them.
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/PluginLoader.h"
+
+#include "revng/Pipeline/AllRegistries.h"
+#include "revng/Pipeline/Target.h"
+#include "revng/Pipes/ModelGlobal.h"
+#include "revng/Pipes/PipelineManager.h"
+#include "revng/Storage/MemoryStorageClient.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/Debug.h"
+#include "revng/Support/InitRevng.h"
+
+using std::string;
+using namespace llvm;
+using namespace llvm::cl;
+using namespace pipeline;
+using namespace ::revng::pipes;
+
+static opt<string> SocketPath(Positional,
+                              Required,
+                              desc("<socket>"),
+                              cat(MainCategory));
+
+static cl::list<string> InputPipeline("P",
+                                      desc("<Pipeline>"),
+                                      cat(MainCategory));
+
+static cl::list<string> EnablingFlags("f",
+                                      desc("list of pipeline enabling flags"),
+                                      cat(MainCategory));
+
+static Logger<> Log("pipeline-server");
+
+static ExitOnError AbortOnError;
+
+namespace {
+
+/// Exit code of a request that must be handled by running the tool
+constexpr int Unsupported = 2;
+
+struct Request {
+  string Tool;
+  string WorkingDirectory;
+  std::vector<string> Arguments;
+};
+
+struct Reply {
+  int ExitCode = EXIT_SUCCESS;
+  string Output;
+};
+
+/// The subset of the command line of the tools the server understands
+struct ParsedArguments {
+  /// False if the arguments use an option the server does not know about
+  bool Supported = true;
+  string ExecutionDirectory;
+  string Output = "-";
+  std::vector<string> Positionals;
+};
+
+class Server {
+private:
+  std::vector<string> Pipelines;
+  llvm::StringMap<PipelineManager> Managers;
+
+public:
+  explicit Server(std::vector<string> &&Pipelines) :
+    Pipelines(std::move(Pipelines)) {}
+
+public:
+  Reply handle(const Request &Request);
+
+private:
+  llvm::Expected<PipelineManager *> getManager(llvm::StringRef Directory);
+  llvm::Expected<string> run(const Request &Request,
+                             const ParsedArguments &Arguments);
+  llvm::Expected<string> artifact(const ParsedArguments &Arguments);
+  llvm::Expected<string> analyze(const ParsedArguments &Arguments);
+};
+
+} // namespace
+
+static llvm::Error createError(const Twine &Message) {
+  return createStringError(inconvertibleErrorCode(), Message);
+}
+
+static string makeAbsolute(llvm::StringRef WorkingDirectory,
+                           llvm::StringRef Path) {
+  if (Path.empty() or Path == "-")
+    return Path.str();
+
+  SmallString<128> Result(Path);
+  sys::fs::make_absolute(WorkingDirectory, Result);
+  return Result.str().str();
+}
+
+static ParsedArguments parseArguments(const Request &Request) {
+  ParsedArguments Result;
+
+  auto Handle = [&](llvm::StringRef Name, llvm::StringRef Value) {
+    if (Name == "resume")
+      Result.ExecutionDirectory = makeAbsolute(Request.WorkingDirectory, Value);
+    else if (Name == "o")
+      Result.Output = makeAbsolute(Request.WorkingDirectory, Value);
+    else
+      return false;
+    return true;
+  };
+
+  const std::vector<string> &Arguments = Request.Arguments;
+  for (size_t I = 0; I < Arguments.size(); ++I) {
+    llvm::StringRef Argument = Arguments[I];
+    if (not Argument.starts_with("-") or Argument == "-") {
+      Result.Positionals.push_back(Argument.str());
+      continue;
+    }
+
+    llvm::StringRef Name = Argument.ltrim('-');
+    auto [Key, Value] = Name.split('=');
+    if (Key.size() != Name.size()) {
+      Result.Supported = Handle(Key, Value) and Result.Supported;
+    } else if (I + 1 < Arguments.size() and Handle(Name, Arguments[I + 1])) {
+      ++I;
+    } else {
+      Result.Supported = false;
+    }
+  }
+
+  // The tools print their usage when invoked without the required arguments
+  if (Result.Positionals.size() < 2)
+    Result.Supported = false;
+  else
+    Result.Positionals[1] = makeAbsolute(Request.WorkingDirectory,
+                                         Result.Positionals[1]);
+
+  return Result;
+}
+
+llvm::Expected<PipelineManager *>
+Server::getManager(llvm::StringRef Directory) {
+  // Without an execution directory nothing is preserved across requests
+  if (Directory.empty())
+    Managers.erase("");
+
+  auto It = Managers.find(Directory);
+  if (It != Managers.end()) {
+    revng_log(Log, "Reusing the manager of " << Directory);
+    return &It->second;
+  }
+
+  revng_log(Log, "Creating a manager for " << Directory);
+  auto MaybeManager = PipelineManager::createFromMemory(Pipelines,
+                                                        EnablingFlags,
+                                                        Directory);
+  if (not MaybeManager)
+    return MaybeManager.takeError();
+
+  auto Result = Managers.try_emplace(Directory, std::move(*MaybeManager));
+  return &Result.first->second;
+}
+
+/// Stores \p Write in the path requested in \p Arguments, or returns it if
+/// that's stdout
+static llvm::Expected<string>
+writeOutput(const ParsedArguments &Arguments,
+            llvm::function_ref<llvm::Error(const revng::FilePath &)> Write) {
+  if (Arguments.Output != "-") {
+    if (auto Error = Write(revng::FilePath::fromLocalStorage(Arguments.Output)))
+      return std::move(Error);
+    return string();
+  }
+
+  revng::MemoryStorageClient Memory;
+  revng::FilePath Path = Memory.root().getFile("output");
+  if (auto Error = Write(Path))
+    return std::move(Error);
+
+  auto MaybeFile = Path.getReadableFile();
+  if (not MaybeFile)
+    return MaybeFile.takeError();
+
+  return MaybeFile.get()->buffer().getBuffer().str();
+}
+
+static llvm::Error loadInput(PipelineManager &Manager, llvm::StringRef Path) {
+  auto &InputContainer = Manager.getRunner().begin()->containers()["input"];
+  InputPath = Path.str();
+  return InputContainer.load(revng::FilePath::fromLocalStorage(Path));
+}
+
+llvm::Expected<string> Server::artifact(const ParsedArguments &Arguments) {
+  const std::vector<string> &Positionals = Arguments.Positionals;
+  revng_assert(Positionals.size() >= 2);
+
+  auto MaybeManager = getManager(Arguments.ExecutionDirectory);
+  if (not MaybeManager)
+    return MaybeManager.takeError();
+  PipelineManager &Manager = **MaybeManager;
+
+  if (not Manager.getRunner().containsStep(Positionals[0]))
+    return createError("No known artifact named " + Positionals[0]);
+
+  auto &Step = Manager.getRunner().getStep(Positionals[0]);
+  auto MaybeContainer = Step.getArtifactsContainer();
+  if (not MaybeContainer)
+    return createError("The step " + Positionals[0]
+                       + " is not associated to an artifact");
+
+  if (auto Error = loadInput(Manager, Positionals[1]))
+    return std::move(Error);
+
+  auto ContainerName = MaybeContainer->first();
+  auto *Kind = Step.getArtifactsKind();
+
+  ContainerToTargetsMap Map;
+  if (Positionals.size() == 2) {
+    Map.add(ContainerName, Kind->allTargets(Manager.context()));
+  } else {
+    for (llvm::StringRef Argument : llvm::drop_begin(Positionals, 2)) {
+      auto MaybeTarget = Target::deserialize(Manager.context(), Argument);
+      if (not MaybeTarget)
+        return MaybeTarget.takeError();
+      Map.add(ContainerName, *MaybeTarget);
+    }
+  }
+
+  if (auto Error = Manager.getRunner().run(Step.getName(), Map))
+    return std::move(Error);
+
+  if (auto Error = Manager.store())
+    return std::move(Error);
+
+  const TargetsList &Targets = Map.contains(ContainerName) ?
+                                 Map.at(ContainerName) :
+                                 TargetsList();
+  auto Produced = MaybeContainer->second->cloneFiltered(Targets);
+  return writeOutput(Arguments, [&Produced](const revng::FilePath &Path) {
+    return Produced->store(Path);
+  });
+}
+
+llvm::Expected<string> Server::analyze(const ParsedArguments &Arguments) {
+  const std::vector<string> &Positionals = Arguments.Positionals;
+  if (Positionals.size() != 2)
+    return createError("Expected an analysis and a binary");
+
+  auto MaybeManager = getManager(Arguments.ExecutionDirectory);
+  if (not MaybeManager)
+    return MaybeManager.takeError();
+  PipelineManager &Manager = **MaybeManager;
+
+  if (auto Error = loadInput(Manager, Positionals[1]))
+    return std::move(Error);
+
+  auto &Runner = Manager.getRunner();
+  TargetInStepSet InvMap;
+  if (Runner.hasAnalysesList(Positionals[0])) {
+    AnalysesList AL = Runner.getAnalysesList(Positionals[0]);
+    if (auto MaybeDiffs = Manager.runAnalyses(AL, InvMap); not MaybeDiffs)
+      return MaybeDiffs.takeError();
+  } else {
+    auto StepHasAnalysis = [&Positionals](const pipeline::Step &Step) {
+      return Step.hasAnalysis(Positionals[0]);
+    };
+    auto It = llvm::find_if(Runner, StepHasAnalysis);
+    if (It == Runner.end())
+      return createError("No known analysis named " + Positionals[0]);
+
+    auto &Analysis = It->getAnalysis(Positionals[0]);
+    ContainerToTargetsMap Map;
+    for (const auto &Pair :
+         llvm::enumerate(Analysis->getRunningContainersNames())) {
+      auto Index = Pair.index();
+      const auto &ContainerName = Pair.value();
+      for (const auto &Kind : Analysis->getAcceptedKinds(Index))
+        Map.add(ContainerName, Kind->allTargets(Manager.context()));
+    }
+
+    auto MaybeDiffs = Manager.runAnalysis(Positionals[0],
+                                          It->getName(),
+                                          Map,
+                                          InvMap);
+    if (not MaybeDiffs)
+      return MaybeDiffs.takeError();
+  }
+
+  if (auto Error = Manager.store())
+    return std::move(Error);
+
+  const auto &Name = revng::ModelGlobalName;
+  auto MaybeModel = Manager.context().getGlobal<revng::ModelGlobal>(Name);
+  if (not MaybeModel)
+    return MaybeModel.takeError();
+
+  auto *Model = *MaybeModel;
+  return writeOutput(Arguments, [Model](const revng::FilePath &Path) {
+    return Model->store(Path);
+  });
+}
+
+llvm::Expected<string> Server::run(const Request &Request,
+                                  const ParsedArguments &Arguments) {
+  if (Request.Tool == "artifact")
+    return artifact(Arguments);
+  else if (Request.Tool == "analyze")
+    return analyze(Arguments);
+  else
+    revng_abort();
+}
+
+Reply Server::handle(const Request &Request) {
+  revng_log(Log, "Handling " << Request.Tool);
+
+  if (Request.Tool != "artifact" and Request.Tool != "analyze")
+    return { Unsupported, "Unsupported tool " + Request.Tool + "\n" };
+
+  ParsedArguments Arguments = parseArguments(Request);
+  if (not Arguments.Supported) {
+    // The tool is going to be run on the execution directory, forget what we
+    // know about it
+    Managers.erase(Arguments.ExecutionDirectory);
+    return { Unsupported, "Unsupported options\n" };
+  }
+
+  llvm::Expected<string> MaybeOutput = run(Request, Arguments);
+  if (not MaybeOutput)
+    return { EXIT_FAILURE, toString(MaybeOutput.takeError()) + "\n" };
+
+  return { EXIT_SUCCESS, std::move(*MaybeOutput) };
+}
+
+/// Reads a request from \p Socket, \return std::nullopt if it's malformed
+static std::optional<Request> readRequest(int Socket) {
+  string Buffer;
+  std::vector<string> Strings;
+  std::optional<size_t> Count;
+
+  char Chunk[4096];
+  while (not Count or Strings.size() < *Count + 1) {
+    ssize_t Read = read(Socket, Chunk, sizeof(Chunk));
+    if (Read < 0 and errno == EINTR)
+      continue;
+    if (Read <= 0)
+      return std::nullopt;
+
+    for (char Character : llvm::ArrayRef<char>(Chunk, Read)) {
+      if (Character != '\0') {
+        Buffer.push_back(Character);
+        continue;
+      }
+
+      Strings.push_back(std::move(Buffer));
+      Buffer.clear();
+
+      if (not Count) {
+        size_t Value = 0;
+        if (llvm::StringRef(Strings.front()).getAsInteger(10, Value)
+            or Value < 2)
+          return std::nullopt;
+        Count = Value;
+      }
+    }
+  }
+
+  if (Strings.size() != *Count + 1 or not Buffer.empty())
+    return std::nullopt;
+
+  Request Result;
+  Result.Tool = std::move(Strings[1]);
+  Result.WorkingDirectory = std::move(Strings[2]);
+  Result.Arguments.assign(std::make_move_iterator(Strings.begin() + 3),
+                          std::make_move_iterator(Strings.end()));
+  return Result;
+}
+
+static void writeAll(int Socket, llvm::StringRef Data) {
+  while (not Data.empty()) {
+    ssize_t Written = write(Socket, Data.data(), Data.size());
+    if (Written < 0 and errno == EINTR)
+      continue;
+    if (Written <= 0)
+      return;
+    Data = Data.drop_front(Written);
+  }
+}
+
+static std::vector<string> loadPipelines() {
+  std::vector<string> Paths(InputPipeline.begin(), InputPipeline.end());
+  llvm::sort(Paths, [](const string &LHS, const string &RHS) {
+    return sys::path::filename(LHS) < sys::path::filename(RHS);
+  });
+
+  std::vector<string> Result;
+  for (const string &Path : Paths) {
+    auto Buffer = AbortOnError(errorOrToExpected(MemoryBuffer::getFile(Path)));
+    Result.push_back(Buffer->getBuffer().str());
+  }
+
+  return Result;
+}
+
+static int listen(llvm::StringRef Path) {
+  sockaddr_un Address = {};
+  Address.sun_family = AF_UNIX;
+  if (Path.size() >= sizeof(Address.sun_path))
+    AbortOnError(createError("Socket path too long: " + Path));
+  std::memcpy(Address.sun_path, Path.data(), Path.size());
+
+  int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (Socket < 0)
+    AbortOnError(errorCodeToError(std::error_code(errno,
+                                                  std::generic_category())));
+
+  // Drop the socket left behind by a previous instance
+  ::unlink(Address.sun_path);
+
+  auto *GenericAddress = reinterpret_cast<sockaddr *>(&Address);
+  if (bind(Socket, GenericAddress, sizeof(Address)) != 0
+      or ::listen(Socket, 16) != 0)
+    AbortOnError(errorCodeToError(std::error_code(errno,
+                                                  std::generic_category())));
+
+  return Socket;
+}
+
+int main(int argc, char *argv[]) {
+  revng::InitRevng X(argc, argv, "", { &MainCategory });
+
+  Registry::runAllInitializationRoutines();
+
+  Server TheServer(loadPipelines());
+  int Socket = listen(SocketPath);
+
+  while (true) {
+    int Connection = accept(Socket, nullptr, nullptr);
+    if (Connection < 0) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    std::optional<Request> MaybeRequest = readRequest(Connection);
+    if (not MaybeRequest) {
+      writeAll(Connection, "1\nMalformed request\n");
+      close(Connection);
+      continue;
+    }
+
+    if (MaybeRequest->Tool == "shutdown") {
+      writeAll(Connection, "0\n");
+      close(Connection);
+      break;
+    }
+
+    Reply Reply = TheServer.handle(*MaybeRequest);
+    writeAll(Connection, std::to_string(Reply.ExitCode) + "\n");
+    writeAll(Connection, Reply.Output);
+    close(Connection);
+  }
+
+  close(Socket);
+  ::unlink(SocketPath.c_str());
+
+  return EXIT_SUCCESS;
+}
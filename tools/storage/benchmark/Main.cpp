@@ -0,0 +1,115 @@
+/// \file Main.cpp
+/// \brief Measures the write and read throughput of a StorageClient
+
+//
+// This file is distributed under the MIT License. See LICENSE.md for details.
+//
+
+#include <chrono>
+#include <cstring>
+#include <random>
+
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "revng/Storage/StorageClient.h"
+#include "revng/Support/CommandLine.h"
+#include "revng/Support/InitRevng.h"
+
+using namespace llvm;
+using namespace llvm::cl;
+
+static opt<std::string> URL(Positional,
+                            Required,
+                            desc("<path or URL of the storage>"),
+                            cat(MainCategory));
+
+static opt<unsigned> SizeMiB("size",
+                             desc("Size, in MiB, of the file to transfer"),
+                             cat(MainCategory),
+                             init(1024));
+
+static opt<unsigned> Iterations("iterations",
+                                desc("Number of times the file is written "
+                                     "and read back"),
+                                cat(MainCategory),
+                                init(3));
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point Start) {
+  std::chrono::duration<double> Elapsed = Clock::now() - Start;
+  return Elapsed.count();
+}
+
+static void report(StringRef What, uint64_t Size, double Seconds) {
+  double MiB = static_cast<double>(Size) / (1024 * 1024);
+  outs() << What << ": " << format("%.2f", Seconds) << " s, "
+         << format("%.2f", MiB / Seconds) << " MiB/s\n";
+}
+
+static Error run(revng::StorageClient &Client) {
+  uint64_t Size = uint64_t(SizeMiB) * 1024 * 1024;
+
+  // Random data, so that the figures do not depend on compression happening
+  // along the way
+  std::string Data(Size, '\0');
+  std::mt19937_64 Generator(sys::Process::GetRandomNumber());
+  for (size_t I = 0; I < Size; I += sizeof(uint64_t)) {
+    uint64_t Value = Generator();
+    std::memcpy(&Data[I], &Value, std::min(sizeof(Value), Size - I));
+  }
+
+  constexpr StringRef FileName = "storage-benchmark.bin";
+  for (unsigned I = 0; I < Iterations; I++) {
+    auto Start = Clock::now();
+    {
+      auto MaybeWritableFile = Client.getWritableFile(FileName,
+                                                      revng::ContentEncoding::
+                                                        None);
+      if (not MaybeWritableFile)
+        return MaybeWritableFile.takeError();
+
+      MaybeWritableFile.get()->os() << Data;
+      if (auto Error = MaybeWritableFile.get()->commit())
+        return Error;
+    }
+    report("write", Size, secondsSince(Start));
+
+    Start = Clock::now();
+    {
+      auto MaybeReadableFile = Client.getReadableFile(FileName);
+      if (not MaybeReadableFile)
+        return MaybeReadableFile.takeError();
+
+      StringRef Read = MaybeReadableFile.get()->buffer().getBuffer();
+      if (Read != Data)
+        return createStringError(inconvertibleErrorCode(),
+                                 "The file read back differs from the "
+                                 "one written");
+    }
+    report("read", Size, secondsSince(Start));
+  }
+
+  return Client.commit();
+}
+
+int main(int argc, char *argv[]) {
+  revng::InitRevng X(argc, argv, "", { &MainCategory });
+
+  auto MaybeClient = revng::StorageClient::fromPathOrURL(URL);
+  if (not MaybeClient) {
+    errs() << toString(MaybeClient.takeError()) << "\n";
+    return EXIT_FAILURE;
+  }
+
+  if (auto Error = run(**MaybeClient)) {
+    errs() << toString(std::move(Error)) << "\n";
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -7,6 +7,7 @@
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
 #include "llvm/Support/ToolOutputFile.h"
 
 #include "revng/PipelineC/Tracing/Trace.h"
@@ -34,6 +35,12 @@ static opt<bool> ListBuffers("list-buffers",
                              cat(ThisToolCategory),
                              init(false));
 
+static opt<unsigned> Slowest("slowest",
+                             desc("List the given number of commands that "
+                                  "took the longest when recorded"),
+                             cat(ThisToolCategory),
+                             init(0));
+
 static opt<string> ExtractBuffer("extract-buffer",
                                  cat(ThisToolCategory),
                                  desc("Buffer to extract"),
@@ -60,11 +67,27 @@ static llvm::ExitOnError AbortOnError;
 int main(int argc, char *argv[]) {
   revng::InitRevng X(argc, argv, "", { &Options::ThisToolCategory });
 
-  if (Options::ListBuffers xor Options::ExtractBuffer.empty()) {
-    dbg << "Please specify either --list-buffers or --extract-buffer\n";
+  unsigned Modes = (Options::ListBuffers ? 1 : 0)
+                   + (Options::ExtractBuffer.empty() ? 0 : 1)
+                   + (Options::Slowest == 0 ? 0 : 1);
+  if (Modes != 1) {
+    dbg << "Please specify one of --list-buffers, --extract-buffer or "
+           "--slowest\n";
     return EXIT_FAILURE;
   }
 
+  if (Options::Slowest != 0) {
+    Trace TheTrace = AbortOnError(Trace::fromFile(Options::Input));
+    for (size_t CommandI : TheTrace.slowestCommands(Options::Slowest)) {
+      const auto &Command = TheTrace.Commands[CommandI];
+      double Milliseconds = Command.wallTime() / 1000.0;
+      std::cout << "Command #" << CommandI << " (" << Command.Name
+                << "): " << llvm::formatv("{0:f3}", Milliseconds).str()
+                << " ms, peak RSS +" << Command.PeakRSSDeltaKB << " KB\n";
+    }
+    return EXIT_SUCCESS;
+  }
+
   if (Options::ListBuffers) {
     Trace TheTrace = AbortOnError(Trace::fromFile(Options::Input));
     std::vector<BufferLocation> Result = TheTrace.listBuffers();
@@ -5,14 +5,17 @@
 
 #include <iostream>
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Error.h"
+#include "llvm/Support/FormatVariadic.h"
 
 #include "revng/PipelineC/PipelineC.h"
 #include "revng/PipelineC/Tracing/Trace.h"
 #include "revng/Support/Assert.h"
 #include "revng/Support/CommandLine.h"
 
+using revng::tracing::CommandMeasurement;
 using revng::tracing::Trace;
 static llvm::ExitOnError AbortOnError;
 
@@ -72,6 +75,20 @@ static opt<std::string> Resume("trace-resume",
                                desc("Use the provided directory as a resume "
                                     "directory"));
 
+static opt<bool> ReportTimings("report-timings",
+                               init(false),
+                               cat(TraceRunToolCategory),
+                               desc("Measure each command and report the "
+                                    "ones slower, or using more memory, than "
+                                    "when the trace was recorded. Exits with "
+                                    "an error if there are any."));
+static opt<unsigned> RegressionThreshold("regression-threshold",
+                                         init(20),
+                                         cat(TraceRunToolCategory),
+                                         desc("Percentage above the recorded "
+                                              "values after which a command "
+                                              "is reported"));
+
 static alias SoftAssertsA("s",
                           desc("Alias for --soft-asserts"),
                           aliasopt(SoftAsserts),
@@ -95,6 +112,52 @@ static alias ResumeA("r",
 
 } // namespace Options
 
+// Differences below these are considered noise
+static constexpr uint64_t MinimumRegressionUS = 1000;
+static constexpr uint64_t MinimumRegressionKB = 1024;
+
+static std::string formatMS(uint64_t Microseconds) {
+  return llvm::formatv("{0:f3} ms", Microseconds / 1000.0).str();
+}
+
+static bool isRegression(uint64_t Recorded, uint64_t Replayed, uint64_t Noise) {
+  if (Recorded == 0 or Replayed <= Recorded or Replayed - Recorded < Noise)
+    return false;
+  return Replayed - Recorded > Recorded * Options::RegressionThreshold / 100;
+}
+
+/// \return the number of commands that regressed
+static size_t reportTimings(const Trace &TheTrace,
+                            llvm::ArrayRef<CommandMeasurement> Measurements) {
+  uint64_t TotalRecorded = 0;
+  uint64_t TotalReplayed = 0;
+  size_t Regressions = 0;
+  for (const CommandMeasurement &Measurement : Measurements) {
+    const auto &Command = TheTrace.Commands[Measurement.CommandNumber];
+    uint64_t Recorded = Command.wallTime();
+    TotalRecorded += Recorded;
+    TotalReplayed += Measurement.WallTime;
+
+    uint64_t RecordedKB = Command.PeakRSSDeltaKB;
+    uint64_t ReplayedKB = Measurement.PeakRSSDeltaKB;
+    if (not isRegression(Recorded, Measurement.WallTime, MinimumRegressionUS)
+        and not isRegression(RecordedKB, ReplayedKB, MinimumRegressionKB))
+      continue;
+
+    ++Regressions;
+    std::cout << "Command #" << Measurement.CommandNumber << " ("
+              << Command.Name << "): " << formatMS(Measurement.WallTime)
+              << " (recorded " << formatMS(Recorded) << "), peak RSS +"
+              << ReplayedKB << " KB (recorded +" << RecordedKB << " KB)\n";
+  }
+
+  std::cout << Measurements.size() << " commands replayed in "
+            << formatMS(TotalReplayed) << " (recorded "
+            << formatMS(TotalRecorded) << "), " << Regressions
+            << " regressions\n";
+  return Regressions;
+}
+
 int main(int argc, const char *argv[]) {
   // NOLINTNEXTLINE
   llvm::cl::HideUnrelatedOptions(Options::TraceRunToolCategory);
@@ -120,8 +183,14 @@ int main(int argc, const char *argv[]) {
     .TemporaryRoot = TemporaryRoot,
     .ResumeDirectory = Options::Resume,
   };
-  AbortOnError(TheTrace.run(Options));
+  std::vector<CommandMeasurement> Measurements;
+  AbortOnError(TheTrace.run(Options,
+                            Options::ReportTimings ? &Measurements : nullptr));
+
+  size_t Regressions = 0;
+  if (Options::ReportTimings)
+    Regressions = reportTimings(TheTrace, Measurements);
 
   rp_shutdown();
-  return EXIT_SUCCESS;
+  return Regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }